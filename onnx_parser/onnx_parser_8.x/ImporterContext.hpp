@@ -7,8 +7,10 @@
 #include "onnx2trt.hpp"
 #include "onnx2trt_utils.hpp"
 #include "onnxErrorRecorder.hpp"
+#include <common/ilogger.hpp>
 // #include "onnx/common/stl_backports.h"
 #include <list>
+#include <memory>
 #include <unordered_map>
 
 namespace onnx2trt
@@ -85,6 +87,7 @@ class ImporterContext final : public IImporterContext
     std::unordered_set<std::string> mUnsupportedShapeTensors; // Container to hold output tensor names of layers that produce shape tensor outputs but do not natively support them.
     StringMap<std::string> mLoopTensors; // Container to map subgraph tensors to their original outer graph names.
     std::string mOnnxFileLocation; // Keep track of the directory of the parsed ONNX file
+    StringMap<std::shared_ptr<iLogger::MappedFile>> mExternalFiles; // External data files, weights point into these mappings
     std::unique_ptr<ErrorRecorderWrapper> mErrorWrapper; // error recorder to control TRT errors
 
 public:
@@ -136,6 +139,21 @@ public:
     {
         return mOnnxFileLocation;
     }
+    void* mapExternalFile(std::string const& path, size_t* size) override
+    {
+        auto it = mExternalFiles.find(path);
+        if (it == mExternalFiles.end())
+        {
+            auto mapping = iLogger::map_file(path);
+            if (!mapping)
+            {
+                return nullptr;
+            }
+            it = mExternalFiles.emplace(path, mapping).first;
+        }
+        *size = it->second->size();
+        return it->second->data();
+    }
     // This actually handles weights as well, but is named this way to be consistent with the tensors()
     void registerTensor(TensorOrWeights tensor, const std::string& basename) override
     {
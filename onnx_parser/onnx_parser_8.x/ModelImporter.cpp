@@ -93,7 +93,8 @@ static std::string makeErrorExplanation(const std::exception& e, const std::stri
     return result.str();
 }
 
-Status parseGraph(IImporterContext* ctx, const ::onnx::GraphProto& graph, bool deserializingINetwork, int* currentNode)
+Status parseGraph(IImporterContext* ctx, const ::onnx::GraphProto& graph, bool deserializingINetwork, int* currentNode,
+    GraphIndex const* index)
 {
     // Import initializers.
     for (const ::onnx::TensorProto& initializer : graph.initializer())
@@ -104,8 +105,18 @@ Status parseGraph(IImporterContext* ctx, const ::onnx::GraphProto& graph, bool d
         ctx->registerTensor(TensorOrWeights{std::move(weights)}, initializer.name());
     }
 
-    std::vector<size_t> topoOrder;
-    ASSERT(toposort(graph.node(), &topoOrder) && "Failed to sort the model topologically.", ErrorCode::kINVALID_GRAPH);
+    GraphIndex localIndex;
+    if (!index)
+    {
+        if (!localIndex.build(graph.node()))
+        {
+            LOG_ERROR(localIndex.error);
+        }
+        ASSERT(localIndex.error.empty() && "Failed to sort the model topologically.", ErrorCode::kINVALID_GRAPH);
+        index = &localIndex;
+    }
+    ASSERT(index->num_nodes() == static_cast<size_t>(graph.node_size()) && "Graph index does not match the graph.", ErrorCode::kINVALID_GRAPH);
+    const std::vector<size_t>& topoOrder = index->order;
 
     const string_map<NodeImporter>& opImporters = getBuiltinOpImporterMap();
     for (const auto& nodeIndex : topoOrder)
@@ -348,6 +359,7 @@ bool ModelImporter::supportsModel(
     bool allSupported{true};
 
     // Parse the graph and see if we hit any parsing errors
+    _graph_index = GraphIndex();
     allSupported = parse(serialized_onnx_model, serialized_onnx_model_size);
 
     int error_node = -1;
@@ -410,12 +422,16 @@ bool ModelImporter::supportsModel(
 
     bool newSubGraph(true);
     // Sort and partition supported subgraphs
-    std::vector<size_t> topological_order;
-    if (!toposort(model.graph().node(), &topological_order))
+    // parse() above already indexed the same graph in importModel, only rebuild when it did not get that far
+    if (_graph_index.num_nodes() != static_cast<size_t>(model.graph().node_size()) || !_graph_index.error.empty())
     {
-        LOG_VERBOSE("Failed to sort model topologically, exiting ...");
-        return false;
+        if (!_graph_index.build(model.graph().node()))
+        {
+            LOG_VERBOSE("Failed to sort model topologically, exiting ... " << _graph_index.error);
+            return false;
+        }
     }
+    const std::vector<size_t>& topological_order = _graph_index.order;
 
     for (int node_idx : topological_order)
     {
@@ -567,7 +583,12 @@ Status ModelImporter::importModel(
 
     _current_node = -1;
     CHECK(importInputs(&_importer_ctx, graph, &_importer_ctx.tensors(), _input_dims));
-    CHECK(parseGraph(&_importer_ctx, graph, model.producer_name() == "TensorRT", &_current_node));
+    if (!_graph_index.build(graph.node()))
+    {
+        LOG_ERROR(_graph_index.error);
+    }
+    ASSERT(_graph_index.error.empty() && "Failed to sort the model topologically.", ErrorCode::kINVALID_GRAPH);
+    CHECK(parseGraph(&_importer_ctx, graph, model.producer_name() == "TensorRT", &_current_node, &_graph_index));
 
     _current_node = -1;
     // Mark outputs defined in the ONNX model (unless tensors are user-requested)
@@ -689,19 +710,46 @@ Status ModelImporter::importModel(
 bool ModelImporter::parseFromFile(const char* onnxModelFile, int32_t verbosity)
 {
     GOOGLE_PROTOBUF_VERIFY_VERSION;
-    ::onnx::ModelProto onnx_model;
     auto* ctx = &_importer_ctx;
 
-    const bool is_binary = ParseFromFile_WAR(&onnx_model, onnxModelFile);
-    if (!is_binary && !ParseFromTextFile(&onnx_model, onnxModelFile))
+    // The file is mapped and deserialized once, straight from the mapping
+    iLogger::MappedFile onnx_file;
+    if (!onnx_file.open(onnxModelFile))
     {
-        LOG_ERROR("Failed to parse ONNX model from file: " << onnxModelFile);
+        LOG_ERROR("Failed to read from file: " << onnxModelFile);
+        return false;
+    }
+
+    if (onnx_file.size() > static_cast<size_t>(std::numeric_limits<int>::max()))
+    {
+        LOG_ERROR("ONNX file " << onnxModelFile << " is " << onnx_file.size()
+                               << " bytes, protobuf can not parse more than 2GB. Export the model with external data instead.");
         return false;
     }
 
     // Keep track of the absolute path to the ONNX file.
     _importer_ctx.setOnnxFileLocation(onnxModelFile);
 
+    //...Deserialize the mapped file, protobuf copies what it needs so the mapping is released right after.
+    //...Files that are not binary protobuf are parsed as text format, like ParseFromTextFile did before.
+    _current_node = -1;
+    _onnx_models.emplace_back();
+    ::onnx::ModelProto& onnx_model = _onnx_models.back();
+    Status status = deserialize_onnx_model(onnx_file.data(), onnx_file.size(), false, &onnx_model);
+    if (status.is_error())
+    {
+        onnx_model.Clear();
+        status = deserialize_onnx_model(onnx_file.data(), onnx_file.size(), true, &onnx_model);
+    }
+    onnx_file.close();
+
+    if (status.is_error())
+    {
+        _errors.push_back(status);
+        LOG_ERROR("Failed to parse ONNX model from file: " << onnxModelFile);
+        return false;
+    }
+
     const int64_t opset_version = (onnx_model.opset_import().size() ? onnx_model.opset_import(0).version() : 0);
     LOG_INFO("----------------------------------------------------------------");
     LOG_INFO("Input filename:   " << onnxModelFile);
@@ -714,36 +762,29 @@ bool ModelImporter::parseFromFile(const char* onnxModelFile, int32_t verbosity)
     LOG_INFO("Doc string:       " << onnx_model.doc_string());
     LOG_INFO("----------------------------------------------------------------");
 
-    { //...Read input file, parse it
-        std::ifstream onnx_file(onnxModelFile, std::ios::binary | std::ios::ate);
-        const std::streamsize file_size = onnx_file.tellg();
-        onnx_file.seekg(0, std::ios::beg);
-        std::vector<char> onnx_buf(file_size);
-        if (!onnx_file.read(onnx_buf.data(), onnx_buf.size()))
-        {
-            LOG_ERROR("Failed to read from file: " << onnxModelFile);
-            return false;
-        }
-        if (!parse(onnx_buf.data(), onnx_buf.size()))
+    status = importModel(onnx_model);
+    if (status.is_error())
+    {
+        status.setNode(_current_node);
+        _errors.push_back(status);
+
+        const int32_t nerror = getNbErrors();
+        for (int32_t i = 0; i < nerror; ++i)
         {
-            const int32_t nerror = getNbErrors();
-            for (int32_t i = 0; i < nerror; ++i)
+            nvonnxparser::IParserError const* error = getError(i);
+            if (error->node() != -1 && error->node() < onnx_model.graph().node_size())
             {
-                nvonnxparser::IParserError const* error = getError(i);
-                if (error->node() != -1)
-                {
-                    ::onnx::NodeProto const& node = onnx_model.graph().node(error->node());
-                    LOG_ERROR("While parsing node number " << error->node() << " [" << node.op_type() << " -> \"" << node.output(0) << "\"" << "]:");
-                    LOG_ERROR("--- Begin node ---");
-                    LOG_ERROR(pretty_print_onnx_to_string(node));
-                    LOG_ERROR("--- End node ---");
-                }
-                LOG_ERROR("ERROR: " << error->file() << ":" << error->line() << " In function " << error->func() << ":\n"
-                     << "[" << static_cast<int>(error->code()) << "] " << error->desc());
+                ::onnx::NodeProto const& node = onnx_model.graph().node(error->node());
+                LOG_ERROR("While parsing node number " << error->node() << " [" << node.op_type() << " -> \"" << node.output(0) << "\"" << "]:");
+                LOG_ERROR("--- Begin node ---");
+                LOG_ERROR(pretty_print_onnx_to_string(node));
+                LOG_ERROR("--- End node ---");
             }
-            return false;
+            LOG_ERROR("ERROR: " << error->file() << ":" << error->line() << " In function " << error->func() << ":\n"
+                 << "[" << static_cast<int>(error->code()) << "] " << error->desc());
         }
-    } //...End Reading input file, parsing it
+        return false;
+    }
     return true;
 }
 
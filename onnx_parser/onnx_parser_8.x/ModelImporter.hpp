@@ -8,12 +8,15 @@
 #include "NvInferPlugin.h"
 #include "NvOnnxParser.h"
 #include "builtin_op_importers.hpp"
+#include "toposort.hpp"
 #include "utils.hpp"
 
 namespace onnx2trt
 {
 
-Status parseGraph(IImporterContext* ctx, const ::onnx::GraphProto& graph, bool deserializingINetwork = false, int* currentNode = nullptr);
+// index may carry a GraphIndex already built for graph.node(), otherwise one is built here
+Status parseGraph(IImporterContext* ctx, const ::onnx::GraphProto& graph, bool deserializingINetwork = false, int* currentNode = nullptr,
+    GraphIndex const* index = nullptr);
 
 class ModelImporter : public nvonnxparser::IParser
 {
@@ -27,6 +30,7 @@ private:
     int _current_node;
     std::vector<Status> _errors;
     std::vector<nvinfer1::Dims> _input_dims;
+    GraphIndex _graph_index; // Index of the top-level graph, shared by importModel and supportsModel
 
 public:
     ModelImporter(nvinfer1::INetworkDefinition* network, nvinfer1::ILogger* logger, const std::vector<nvinfer1::Dims>& input_dims)
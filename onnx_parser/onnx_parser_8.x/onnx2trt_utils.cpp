@@ -655,54 +655,41 @@ bool convertOnnxWeights(
             }
         }
 
-        // Buffer to hold the data read from the file
-        std::vector<char> dataBuf;
-        // Will update dataBuf and nbytes by reference.
-        if (!parseExternalWeights(ctx, location, ctx->getOnnxFileLocation(), offset, length, dataBuf, nbytes))
+        // Weights are referenced in place from the mapped external file, only types that need a conversion are copied.
+        if (!parseExternalWeights(ctx, location, ctx->getOnnxFileLocation(), offset, length, dataPtr, nbytes))
         {
             return false;
         }
         shape.nbDims = onnxTensor.dims().size();
         std::copy(onnxTensor.dims().begin(), onnxTensor.dims().end(), shape.d);
 
-        // For weights parsed from external files, createTempWeights is necessary to keep them in scope
-        ShapedWeights externalWeights;
-
         // Cast non-native TRT types to their corresponding proxy types
         if (onnxDtype == ::onnx::TensorProto::INT64)
         {
-            dataPtr = dataBuf.data();
             dataPtr = convertINT64(reinterpret_cast<const int64_t*>(dataPtr), shape, ctx);
             nbytes = nbytes / (sizeof(int64_t) / sizeof(int32_t));
             onnxDtype = ::onnx::TensorProto::INT32;
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
         else if (onnxDtype == ::onnx::TensorProto::UINT8)
         {
-            dataPtr = dataBuf.data();
             dataPtr = convertUINT8(reinterpret_cast<const uint8_t*>(dataPtr), shape, ctx);
             nbytes = nbytes * (sizeof(int32_t) / sizeof(uint8_t));
             onnxDtype = ::onnx::TensorProto::INT32;
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
         else if (onnxDtype == ::onnx::TensorProto::DOUBLE)
         {
-            dataPtr = dataBuf.data();
             dataPtr = convertDouble(reinterpret_cast<const double*>(dataPtr), shape, ctx);
             nbytes = nbytes / (sizeof(double) / sizeof(float));
             onnxDtype = ::onnx::TensorProto::FLOAT;
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataPtr, nbytes);
         }
-        // Copy weight values directly to externalWeights
-        else
+
+        onnx2trt::ShapedWeights externalWeights(onnxDtype, dataPtr, shape);
+        if (externalWeights.size_bytes() != nbytes)
         {
-            externalWeights = ctx->createTempWeights(onnxDtype, shape);
-            std::memcpy(externalWeights.values, dataBuf.data(), nbytes);
+            LOG_ERROR("Size mismatch when importing external initializer: " << onnxTensor.name() << ". Expected size: "
+                                                                         << nbytes << " , actual size: " << externalWeights.size_bytes());
+            return false;
         }
-
         *weights = externalWeights;
         return true;
     }
@@ -1589,7 +1576,7 @@ nvinfer1::Dims insertDimension(const nvinfer1::Dims& dims, const int axis, const
 }
 
 bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string path, int64_t offset, int64_t length,
-    std::vector<char>& weightsBuf, size_t& size)
+    void*& weightsPtr, size_t& size)
 {
     // The weight paths in the ONNX model are relative paths to the main ONNX file.
 #ifdef _MSC_VER
@@ -1605,23 +1592,26 @@ bool parseExternalWeights(IImporterContext* ctx, std::string file, std::string p
     {
         path = file;
     }
-    std::ifstream relPathFile(path, std::ios::binary | std::ios::ate);
-    if (!relPathFile)
+
+    size_t fileSize{0};
+    uint8_t* mapped = static_cast<uint8_t*>(ctx->mapExternalFile(path, &fileSize));
+    if (!mapped)
     {
         LOG_ERROR("Failed to open file: " << path);
         return false;
     }
-    std::streamsize fileSize = relPathFile.tellg();
-    relPathFile.seekg(offset, std::ios::beg);
-    int64_t weightsBufSize = length == 0 ? fileSize : length;
-    weightsBuf.resize(weightsBufSize);
-    LOG_VERBOSE("Reading weights from external file: " << path);
-    if (!relPathFile.read(weightsBuf.data(), weightsBuf.size()))
+
+    if (offset < 0 || length < 0 || static_cast<size_t>(offset) > fileSize
+        || static_cast<size_t>(length) > fileSize - static_cast<size_t>(offset))
     {
-        LOG_ERROR("Failed to read weights from external file: " << path);
+        LOG_ERROR("Failed to read weights from external file: " << path << ", offset = " << offset
+                                                               << ", length = " << length << ", file size = " << fileSize);
         return false;
     }
-    size = weightsBuf.size();
+
+    LOG_VERBOSE("Mapping weights from external file: " << path);
+    weightsPtr = mapped + offset;
+    size = length == 0 ? fileSize - offset : length;
     return true;
 }
 
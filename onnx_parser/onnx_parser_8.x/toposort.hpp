@@ -4,94 +4,245 @@
 
 #pragma once
 
+#include <string>
 #include <unordered_map>
 #include <vector>
 
-#include <iostream>
-using std::cout;
-using std::cerr;
-using std::endl;
-
-namespace
+// Index over the nodes of an onnx graph. Tensor names are interned to dense ids once,
+// after that producers / consumers / fan-out and the topological order are plain int arrays.
+// Nodes are sorted with an iterative Kahn's algorithm, so very deep graphs cannot overflow the stack.
+struct GraphIndex
 {
+    enum
+    {
+        kNoProducer = -1
+    };
 
-enum NodeState
-{
-    NODE_UNVISITED,
-    NODE_ACTIVE,
-    NODE_VISITED
+    // tensor id -> name, and the reverse mapping
+    std::vector<std::string> tensor_names;
+    std::unordered_map<std::string, int> tensor_ids;
+
+    // tensor id -> index of the node producing it, kNoProducer for graph inputs, initializers and outer scope tensors
+    std::vector<int> producers;
+
+    // consumers of tensor t are consumers[consumer_offsets[t] .. consumer_offsets[t + 1]), one entry per edge
+    std::vector<int> consumer_offsets;
+    std::vector<int> consumers;
+
+    // node inputs / outputs as tensor ids, in the same CSR layout. Empty (optional) inputs are -1
+    std::vector<int> node_input_offsets;
+    std::vector<int> node_inputs;
+    std::vector<int> node_output_offsets;
+    std::vector<int> node_outputs;
+
+    std::vector<size_t> order;
+    std::string error;
+
+    size_t num_nodes() const
+    {
+        return node_input_offsets.empty() ? 0 : node_input_offsets.size() - 1;
+    }
+
+    size_t num_tensors() const
+    {
+        return tensor_names.size();
+    }
+
+    int tensor_id(std::string const& name) const
+    {
+        auto it = tensor_ids.find(name);
+        return it == tensor_ids.end() ? -1 : it->second;
+    }
+
+    int fan_out(int tensor) const
+    {
+        return consumer_offsets[tensor + 1] - consumer_offsets[tensor];
+    }
+
+    int producer(std::string const& name) const
+    {
+        int id = tensor_id(name);
+        return id == -1 ? kNoProducer : producers[id];
+    }
+
+    template <class Container>
+    bool build(Container const& nodes);
+
+private:
+    int intern(std::string const& name)
+    {
+        auto result = tensor_ids.emplace(name, static_cast<int>(tensor_names.size()));
+        if (result.second)
+        {
+            tensor_names.push_back(name);
+            producers.push_back(kNoProducer);
+        }
+        return result.first->second;
+    }
+
+    bool sort();
 };
 
 template <class Container>
-bool get_post_order(size_t node_idx, Container const& nodes, std::unordered_map<std::string, size_t> const& node_map,
-    std::vector<NodeState>* node_states, std::vector<size_t>* order)
+bool GraphIndex::build(Container const& nodes)
 {
-    NodeState& node_state = node_states->at(node_idx);
-    if (node_state == NODE_ACTIVE)
+    *this = GraphIndex();
+
+    size_t num_nodes = nodes.size();
+    node_input_offsets.reserve(num_nodes + 1);
+    node_output_offsets.reserve(num_nodes + 1);
+    tensor_ids.reserve(num_nodes * 2);
+    node_input_offsets.push_back(0);
+    node_output_offsets.push_back(0);
+
+    // TODO: This .Get().input() is highly specific to protobuf, should
+    //       generalise it somehow.
+    for (size_t i = 0; i < num_nodes; ++i)
     {
-        // Cycle detected!
-        cerr << "ERROR: Graph contains a cycle" << endl;
-        return false;
+        auto const& node = nodes.Get(i);
+        for (auto const& output : node.output())
+        {
+            if (output.empty())
+            {
+                continue;
+            }
+
+            int id = intern(output);
+            if (producers[id] != kNoProducer)
+            {
+                error = "Output name is not unique: " + output;
+                return false;
+            }
+            producers[id] = static_cast<int>(i);
+            node_outputs.push_back(id);
+        }
+        node_output_offsets.push_back(static_cast<int>(node_outputs.size()));
     }
-    else if (node_state == NODE_VISITED)
+
+    for (size_t i = 0; i < num_nodes; ++i)
     {
-        return true;
+        for (auto const& input : nodes.Get(i).input())
+        {
+            node_inputs.push_back(input.empty() ? -1 : intern(input));
+        }
+        node_input_offsets.push_back(static_cast<int>(node_inputs.size()));
     }
-    else
+
+    // Counting sort of the edges by tensor id gives the consumer lists
+    consumer_offsets.assign(num_tensors() + 1, 0);
+    for (int tensor : node_inputs)
     {
-        node_state = NODE_ACTIVE;
-        // TODO: This .Get().input() is highly specific to protobuf, should
-        //       generalise it somehow.
-        for (auto const& input : nodes.Get(node_idx).input())
+        if (tensor != -1)
         {
-            if (!node_map.count(input))
+            consumer_offsets[tensor + 1]++;
+        }
+    }
+    for (size_t t = 0; t < num_tensors(); ++t)
+    {
+        consumer_offsets[t + 1] += consumer_offsets[t];
+    }
+
+    consumers.resize(consumer_offsets.back());
+    std::vector<int> cursor(consumer_offsets.begin(), consumer_offsets.end() - 1);
+    for (size_t i = 0; i < num_nodes; ++i)
+    {
+        for (int k = node_input_offsets[i]; k < node_input_offsets[i + 1]; ++k)
+        {
+            int tensor = node_inputs[k];
+            if (tensor != -1)
             {
-                // Input node not found in graph!
-                // cerr << "ERROR: Input node not found in graph: "
-                //     << input << endl;
-                // return false;
-                continue; // Skip missing input edges
+                consumers[cursor[tensor]++] = static_cast<int>(i);
             }
-            size_t input_node_idx = node_map.at(input);
-            if (!get_post_order(input_node_idx, nodes, node_map, node_states, order))
+        }
+    }
+    return sort();
+}
+
+inline bool GraphIndex::sort()
+{
+    size_t n = num_nodes();
+    order.clear();
+    order.reserve(n);
+
+    // Exported graphs are almost always sorted already, keep the original order in that case
+    bool sorted = true;
+    for (size_t i = 0; i < n && sorted; ++i)
+    {
+        for (int k = node_input_offsets[i]; k < node_input_offsets[i + 1]; ++k)
+        {
+            int tensor = node_inputs[k];
+            if (tensor != -1 && producers[tensor] >= static_cast<int>(i))
             {
-                return false;
+                sorted = false;
+                break;
             }
         }
-        node_state = NODE_VISITED;
-        order->push_back(node_idx);
     }
-    return true;
-}
 
-} // anonymous namespace
+    if (sorted)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            order.push_back(i);
+        }
+        return true;
+    }
 
-template <class Container>
-bool toposort(Container const& nodes, std::vector<size_t>* order)
-{
-    std::unordered_map<std::string, size_t> node_map;
-    for (size_t i = 0; i < (size_t) nodes.size(); ++i)
+    // Missing producers (graph inputs, initializers, outer scope) do not count as dependencies
+    std::vector<int> indegree(n, 0);
+    for (size_t i = 0; i < n; ++i)
     {
-        // TODO: This .Get().input() is highly specific to protobuf, should
-        //       generalise it somehow.
-        for (auto const& output : nodes.Get(i).output())
+        for (int k = node_input_offsets[i]; k < node_input_offsets[i + 1]; ++k)
         {
-            if (!node_map.emplace(output, i).second)
+            int tensor = node_inputs[k];
+            if (tensor != -1 && producers[tensor] != kNoProducer)
             {
-                // Output name appears more than once in graph!
-                cerr << "ERROR: Output name is not unique: " << output << endl;
-                return false;
+                indegree[i]++;
             }
         }
     }
-    order->reserve(nodes.size());
-    std::vector<NodeState> node_states(nodes.size(), NODE_UNVISITED);
-    for (size_t i = 0; i < (size_t) nodes.size(); ++i)
+
+    // order doubles as the FIFO queue
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (indegree[i] == 0)
+        {
+            order.push_back(i);
+        }
+    }
+
+    for (size_t head = 0; head < order.size(); ++head)
     {
-        if (!get_post_order(i, nodes, node_map, &node_states, order))
+        size_t node = order[head];
+        for (int k = node_output_offsets[node]; k < node_output_offsets[node + 1]; ++k)
         {
-            return false;
+            int tensor = node_outputs[k];
+            for (int c = consumer_offsets[tensor]; c < consumer_offsets[tensor + 1]; ++c)
+            {
+                if (--indegree[consumers[c]] == 0)
+                {
+                    order.push_back(consumers[c]);
+                }
+            }
         }
     }
+
+    if (order.size() != n)
+    {
+        error = "Graph contains a cycle";
+        return false;
+    }
+    return true;
+}
+
+template <class Container>
+bool toposort(Container const& nodes, std::vector<size_t>* order)
+{
+    GraphIndex index;
+    if (!index.build(nodes))
+    {
+        return false;
+    }
+    *order = std::move(index.order);
     return true;
 }
@@ -0,0 +1,43 @@
+import time
+import asyncio
+import concurrent.futures
+import numpy as np
+import trtpy as tp
+
+# 不需要GPU和模型，用MockDetector测试一个事件循环中同时等待大量请求
+# commit_async只在executor中提交，由C++线程等待结果，完成后唤醒事件循环，不需要轮询，等待期间不占用executor的线程
+# 对比使用run_in_executor等待get()的方式，同时等待的数量受线程池大小限制
+
+image = np.random.randint(0, 255, (120, 160, 3), dtype=np.uint8)
+
+async def run_async(num_requests):
+
+    detector = tp.MockDetector(max_batch_size=64, infer_ms=5.0, input_size=32)
+    tic = time.time()
+    results = await asyncio.gather(*[detector.commit_async(image, as_array=True) for _ in range(num_requests)])
+    elapsed = time.time() - tic
+    assert all(len(boxes) == 1 for boxes in results)
+    return num_requests / elapsed
+
+async def run_executor(num_requests, num_workers):
+
+    detector = tp.MockDetector(max_batch_size=64, infer_ms=5.0, input_size=32)
+    loop     = asyncio.get_event_loop()
+    executor = concurrent.futures.ThreadPoolExecutor(num_workers)
+    tic = time.time()
+    results = await asyncio.gather(*[
+        loop.run_in_executor(executor, lambda: detector.commit(image).get_array()) for _ in range(num_requests)
+    ])
+    elapsed = time.time() - tic
+    executor.shutdown()
+    assert all(len(boxes) == 1 for boxes in results)
+    return num_requests / elapsed
+
+async def main():
+    for num_requests in [1000, 5000, 20000]:
+        async_fps    = await run_async(num_requests)
+        executor_fps = await run_executor(num_requests, 16)
+        print(f"in flight {num_requests}: commit_async {async_fps:.1f} fps, run_in_executor(16 threads) {executor_fps:.1f} fps")
+
+loop = asyncio.get_event_loop()
+loop.run_until_complete(main())
@@ -0,0 +1,46 @@
+import time
+import threading
+import numpy as np
+import trtpy as tp
+
+# 不需要GPU和模型，用MockDetector测试python多线程提交的吞吐
+# release_gil=False等价于没有释放GIL的绑定，预处理和等待结果都被GIL串行化
+# 释放GIL后，多个线程的预处理可以并行，推理线程也能把多个线程的请求合并为一个batch
+
+image      = np.random.randint(0, 255, (720, 1280, 3), dtype=np.uint8)
+num_images = 400
+
+def run(num_threads, release_gil, batch=0):
+
+    detector = tp.MockDetector(max_batch_size=16, infer_ms=5.0, release_gil=release_gil)
+    per_thread = num_images // num_threads
+
+    def worker():
+        if batch > 0:
+            for _ in range(0, per_thread, batch):
+                for fut in detector.commits([image] * batch):
+                    fut.get_array()
+        else:
+            for _ in range(per_thread):
+                detector.commit(image).get_array()
+
+    threads = [threading.Thread(target=worker) for _ in range(num_threads)]
+    tic = time.time()
+    for t in threads:
+        t.start()
+
+    for t in threads:
+        t.join()
+
+    elapsed = time.time() - tic
+    return per_thread * num_threads / elapsed
+
+boxes = tp.MockDetector().commit(image).get_array()
+print(f"get_array: shape={boxes.shape}, dtype={boxes.dtype}")
+print(f"left={boxes['left']}, confidence={boxes['confidence']}")
+
+for num_threads in [1, 2, 4, 8]:
+    hold    = run(num_threads, release_gil=False)
+    release = run(num_threads, release_gil=True)
+    batched = run(num_threads, release_gil=True, batch=8)
+    print(f"threads={num_threads}: hold gil {hold:.1f} fps, release gil {release:.1f} fps, commits(8) {batched:.1f} fps")
@@ -4,6 +4,9 @@ import numpy as np
 import requests
 import os
 import platform
+import asyncio
+import weakref
+import itertools
 from enum import Enum
 
 List  = typing.List
@@ -79,6 +82,13 @@ class Tensor(object):
     def gpu_at(self, indexs : List[int])->DeviceFloatPointer: ...
     def reference_data(self, shape : List[int], cpu : int, cpu_size : int, gpu : int, gpu_size : int): ...
 
+    # np.asarray(tensor)不复制，数据在GPU上时先复制到内存
+    __array_interface__ : dict
+
+    # torch.from_dlpack(tensor)不复制，数据在GPU上时导出显存
+    def __dlpack__(self, stream=None): ...
+    def __dlpack_device__(self)->Tuple[int, int]: ...
+
 class Infer(object):
     stream         : int
     num_input      : int
@@ -87,7 +97,7 @@ class Infer(object):
     device         : int
     workspace      : MixMemory
     def __init__(self, file : str): ...
-    def forward(self, sync : bool=True): ...
+    def forward(self, sync : bool=True)->bool: ...
     def input(self, index : int = 0)->Tensor: ...
     def output(self, index : int = 0)->Tensor: ...
     def synchronize(self): ...
@@ -226,38 +236,67 @@ class YoloType(Enum):
     V5         : int  =  0
     X          : int  =  1
 
+# 图像为HxWx3的uint8数组，支持非owner的数组和ROI切片（image[y0:y1, x0:x1]）等，不需要image.copy()
+# 每行的像素不连续时（例如image[..., ::-1]）内部会复制一次
+
+# get_array返回的结构化数组的dtype，与C++的Box内存布局一致
+# object_box_dtype: left, top, right, bottom, confidence : float32, class_label : int32
+# face_box_dtype  : left, top, right, bottom, confidence : float32, landmark : float32 (5, 2)
+object_box_dtype : np.dtype
+face_box_dtype   : np.dtype
+
+# get、get_array等待结果时不持有GIL，其他python线程可以继续提交
 class SharedFutureFaceBoxArray(object):
     def get(self)->List[Box]: ...
+    def get_array(self)->np.ndarray: ...
+    def ready(self)->bool: ...
 
 class SharedFutureObjectBoxArray(object):
     def get(self)->List[Box]: ...
+    def get_array(self)->np.ndarray: ...
+    def ready(self)->bool: ...
 
 class Fall(object):
     valid : bool
     def __init__(self, engine : str, device_id : int = 0): ...
     def commit(self, keys : np.ndarray, box : List[int])->SharedFutureFallState: ...
+    def commits(self, keys : List[np.ndarray], boxes : List[List[int]])->List[SharedFutureFallState]: ...
+    def commit_async(self, keys : np.ndarray, box : List[int], as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, keys : List[np.ndarray], boxes : List[List[int]], as_array : bool = False)->asyncio.Future: ...
 
 class AlphaPose(object):
     valid : bool
     def __init__(self, engine : str, device_id : int = 0): ...
     def commit(self, image : np.ndarray, box : List[int])->SharedFutureAlphaPosePoints: ...
+    def commits(self, image : np.ndarray, boxes : List[List[int]])->List[SharedFutureAlphaPosePoints]: ...
+    def commit_async(self, image : np.ndarray, box : List[int], as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, image : np.ndarray, boxes : List[List[int]], as_array : bool = False)->asyncio.Future: ...
 
 class Arcface(object):
     valid : bool
     def __init__(self, engine : str, device_id : int = 0): ...
     def commit(self, image : np.ndarray, landmark : np.ndarray)->SharedFutureArcfaceFeature: ...
+    def commits(self, images : List[np.ndarray], landmarks : List[np.ndarray])->List[SharedFutureArcfaceFeature]: ...
+    def commit_async(self, image : np.ndarray, landmark : np.ndarray, as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, images : List[np.ndarray], landmarks : List[np.ndarray], as_array : bool = False)->asyncio.Future: ...
     def face_alignment(self, image : np.ndarray, landmark : np.ndarray)->np.ndarray: ...
 
 class Retinaface(object):
     valid : bool
     def __init__(self, engine : str, device_id : int = 0, confidence_threshold : float = 0.7, nms_threshold : float = 0.5): ...
     def commit(self, image : np.ndarray)->SharedFutureFaceBoxArray: ...
+    def commits(self, images : List[np.ndarray])->List[SharedFutureFaceBoxArray]: ...
+    def commit_async(self, image : np.ndarray, as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, images : List[np.ndarray], as_array : bool = False)->asyncio.Future: ...
     def crop_face_and_landmark(self, image : np.ndarray, Box : Box, scale_box : float = 1.5)->np.ndarray: ...
 
 class Scrfd(object):
     valid : bool
     def __init__(self, engine : str, device_id : int = 0, confidence_threshold : float = 0.7, nms_threshold : float = 0.5): ...
     def commit(self, image : np.ndarray)->SharedFutureFaceBoxArray: ...
+    def commits(self, images : List[np.ndarray])->List[SharedFutureFaceBoxArray]: ...
+    def commit_async(self, image : np.ndarray, as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, images : List[np.ndarray], as_array : bool = False)->asyncio.Future: ...
     def crop_face_and_landmark(self, image : np.ndarray, Box : Box, scale_box : float = 1.5)->np.ndarray: ...
 
 class Yolo(object):
@@ -271,6 +310,9 @@ class Yolo(object):
         nms_threshold : float = 0.5
     ): ...
     def commit(self, image : np.ndarray)->SharedFutureObjectBoxArray: ...
+    def commits(self, images : List[np.ndarray])->List[SharedFutureObjectBoxArray]: ...
+    def commit_async(self, image : np.ndarray, as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, images : List[np.ndarray], as_array : bool = False)->asyncio.Future: ...
     def crop_face_and_landmark(self, image : np.ndarray, Box : Box, scale_box : float = 1.5)->np.ndarray: ...
 
 class CenterNet(object):
@@ -283,8 +325,33 @@ class CenterNet(object):
         nms_threshold : float = 0.5
     ): ...
     def commit(self, image : np.ndarray)->SharedFutureObjectBoxArray: ...
+    def commits(self, images : List[np.ndarray])->List[SharedFutureObjectBoxArray]: ...
+    def commit_async(self, image : np.ndarray, as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, images : List[np.ndarray], as_array : bool = False)->asyncio.Future: ...
     def crop_face_and_landmark(self, image : np.ndarray, Box : Box, scale_box : float = 1.5)->np.ndarray: ...
 
+# asyncio的完成通知，一般不直接使用，见commit_async
+class AsyncNotifier(object):
+    def __init__(self, post): ...
+    def watch(self, lane : int, token : int, future): ...
+    def take(self)->List[int]: ...
+    def close(self): ...
+
+# 不需要GPU和模型的模拟检测器，用来测试python多线程的扩展性
+# release_gil=False时持有GIL完成预处理并等待结果，等价于没有释放GIL的绑定
+class MockDetector(object):
+    def __init__(
+        self, 
+        max_batch_size : int = 16, 
+        infer_ms : float = 5.0, 
+        input_size : int = 640, 
+        release_gil : bool = True
+    ): ...
+    def commit(self, image : np.ndarray)->SharedFutureObjectBoxArray: ...
+    def commits(self, images : List[np.ndarray])->List[SharedFutureObjectBoxArray]: ...
+    def commit_async(self, image : np.ndarray, as_array : bool = False)->asyncio.Future: ...
+    def commits_async(self, images : List[np.ndarray], as_array : bool = False)->asyncio.Future: ...
+
 
 def load_infer_file(file : str)->Infer: ...
 def load_infer_data(data : bytes)->Infer: ...
@@ -444,6 +511,118 @@ Infer.__call__ = infer__call__
 Infer.save     = infer_save
 
 
+class AsyncState(object):
+
+    # 每个事件循环一个AsyncNotifier，C++线程等待结果，完成后通过call_soon_threadsafe唤醒事件循环
+    def __init__(self, loop):
+        # 只弱引用loop和self，async_states的值不能让loop无法回收，也避免经过C++对象的循环引用
+        self.loop_ref = weakref.ref(loop)
+        self.pending  = {}
+        self.tokens   = itertools.count()
+
+        state_ref = weakref.ref(self)
+        def post():
+            state = state_ref()
+            loop  = state.loop_ref() if state is not None else None
+            if loop is not None and not loop.is_closed():
+                loop.call_soon_threadsafe(state.drain)
+
+        self.notifier = AsyncNotifier(post)
+
+    def watch(self, lane, result, as_array):
+        future = self.loop_ref().create_future()
+        token  = next(self.tokens)
+        self.pending[token] = (future, result, as_array)
+        try:
+            self.notifier.watch(lane, token, result)
+        except Exception:
+            del self.pending[token]
+            raise
+        return future
+
+    def drain(self):
+        for token in self.notifier.take():
+            item = self.pending.pop(token, None)
+            if item is None or item[0].done():
+                continue
+
+            future, result, as_array = item
+            try:
+                future.set_result(result.get_array() if as_array else result.get())
+            except Exception as e:
+                future.set_exception(e)
+
+    # 关闭后等待线程退出，没有通知到的future设置异常，避免await一直挂起。可以在任意线程调用
+    def close(self):
+        self.notifier.close()
+
+        loop = self.loop_ref()
+        if loop is None or loop.is_closed():
+            self.pending.clear()
+            return
+
+        loop.call_soon_threadsafe(self.fail_pending)
+
+    def fail_pending(self):
+        # 已经完成的先正常返回结果
+        self.drain()
+
+        pending, self.pending = self.pending, {}
+        for future, result, as_array in pending.values():
+            if not future.done():
+                future.set_exception(RuntimeError("AsyncNotifier is closed"))
+
+
+# 事件循环回收时对应的AsyncState一起回收
+async_states = weakref.WeakKeyDictionary()
+
+def get_async_state(loop=None)->AsyncState:
+    if loop is None:
+        loop = asyncio.get_event_loop()
+
+    state = async_states.get(loop)
+    if state is None:
+        state = AsyncState(loop)
+        async_states[loop] = state
+    return state
+
+
+# 关闭loop对应的AsyncState，之后的commit_async会创建新的AsyncState
+def close_async_state(loop=None):
+    if loop is None:
+        loop = asyncio.get_event_loop()
+
+    state = async_states.pop(loop, None)
+    if state is not None:
+        state.close()
+
+
+# 参数与commit相同，返回asyncio.Future，结果与get()相同，as_array=True时为get_array()（只对检测框有效）
+# commit在loop的默认executor中执行，显存池占满时阻塞的是executor的线程而不是事件循环
+# 因此返回时可能还没有提交，future完成之前不能修改传入的图像
+async def watch_submitted(state, lane, submitted, as_array):
+    result = await submitted
+    return await state.watch(lane, result, as_array)
+
+async def watch_submitted_list(state, lane, submitted, as_array):
+    results = await submitted
+    return await asyncio.gather(*[state.watch(lane, result, as_array) for result in results])
+
+def commit_async(self, *args, as_array=False):
+    loop      = asyncio.get_event_loop()
+    submitted = loop.run_in_executor(None, lambda: self.commit(*args))
+    return asyncio.ensure_future(watch_submitted(get_async_state(loop), id(self), submitted, as_array), loop=loop)
+
+def commits_async(self, *args, as_array=False):
+    loop      = asyncio.get_event_loop()
+    submitted = loop.run_in_executor(None, lambda: self.commits(*args))
+    return asyncio.ensure_future(watch_submitted_list(get_async_state(loop), id(self), submitted, as_array), loop=loop)
+
+for detector_class in [Yolo, CenterNet, Retinaface, Scrfd, Arcface, AlphaPose, Fall, MockDetector]:
+    detector_class.commit_async  = commit_async
+    detector_class.commits_async = commits_async
+
+
 def normalize_numpy(norm : Norm, image):
 
     if norm.channel_type == ChannelType.Invert:
@@ -11,6 +11,11 @@
 
 namespace AlphaPose{
 
+    void decode_kernel_invoker(
+        float* heatmaps, int batch_size, int num_joints, int batch_stride, int width, int height,
+        int refine, float* parray, cudaStream_t stream
+    );
+
     struct AffineMatrix{
         float i2d[6];       // image to dst(network), 2x3 matrix
         float d2i[6];       // dst to image, 2x3 matrix
@@ -62,7 +67,9 @@ namespace AlphaPose{
             stop();
         }
         
-        bool startup(const string& file, int gpuid){
+        bool startup(const string& file, int gpuid, Refine refine, bool gpu_decode){
+            refine_     = refine;
+            gpu_decode_ = gpu_decode;
             return ControllerImpl::startup(make_tuple(file, gpuid));
         }
     
@@ -85,6 +92,8 @@ namespace AlphaPose{
             auto input         = engine->input();
             auto output        = engine->output();
             int stride         = input->width() / output->width();
+            int begin_channel  = 17;
+            int num_joints     = output->channel() - begin_channel;
             input_width_       = input->width();
             input_height_      = input->height();
             gpu_               = gpuid;
@@ -93,6 +102,13 @@ namespace AlphaPose{
             result.set_value(true);
             input->resize_single_dim(0, max_batch_size);
 
+            // 每个关键点x, y, confidence，热图上的坐标
+            TRT::Tensor keypoints(TRT::DataType::Float);
+            keypoints.set_stream(stream_);
+            keypoints.resize(max_batch_size, num_joints * 3);
+            if(gpu_decode_)
+                keypoints.to_gpu();
+
             int n = 0;
             vector<Job> fetch_jobs;
             while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
@@ -106,27 +122,33 @@ namespace AlphaPose{
                     job.mono_tensor->release();
                 }
                 
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
+                if(gpu_decode_){
+                    keypoints.to_gpu(false);
+                    decode_kernel_invoker(
+                        output->gpu<float>(0, begin_channel), infer_batch_size, num_joints, output->count(1),
+                        output->width(), output->height(), (int)refine_, keypoints.gpu<float>(), stream_
+                    );
+                    keypoints.to_cpu();
+                }else{
+                    for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch)
+                        decode_heatmaps(output->cpu<float>(ibatch, begin_channel), num_joints, output->width(), output->height(), refine_, keypoints.cpu<float>(ibatch));
+                }
+
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
                     
                     auto& job                   = fetch_jobs[ibatch];
-                    float* image_based_output   = output->cpu<float>(ibatch);
+                    float* pkeypoints           = keypoints.cpu<float>(ibatch);
                     auto& image_based_keypoints = job.output;
-                    auto& affine_matrix         = job.additional;
-                    int begin_channel           = 17;
-                    int area                    = output->width() * output->height();
-                    image_based_keypoints.resize(output->channel() - begin_channel);
-
-                    for(int i = begin_channel; i < output->channel(); ++i){
-                        float* output_channel = output->cpu<float>(0, i);
-                        int location = std::max_element(output_channel, output_channel + area) - output_channel;
-                        float confidence = output_channel[location];
-                        float x = (location % output->width()) * stride;
-                        float y = (location / output->width()) * stride;
-                        auto& output_point = image_based_keypoints[i-begin_channel];
-
-                        output_point.z = confidence;
-                        tie(output_point.x, output_point.y) = affine_project(x, y, job.additional.d2i);
+                    image_based_keypoints.resize(num_joints);
+
+                    for(int i = 0; i < num_joints; ++i, pkeypoints += 3){
+                        auto& output_point = image_based_keypoints[i];
+                        output_point.z = pkeypoints[2];
+                        tie(output_point.x, output_point.y) = affine_project(pkeypoints[0] * stride, pkeypoints[1] * stride, job.additional.d2i);
                     }
                     job.pro->set_value(job.output);
                 }
@@ -175,7 +197,8 @@ namespace AlphaPose{
             uint8_t* gpu_workspace = (uint8_t*)workspace->gpu(size_image + size_matrix);
             float*   affine_matrix_device = (float*)gpu_workspace;
             uint8_t* image_device         = gpu_workspace + size_matrix;
-            checkCudaRuntime(cudaMemcpyAsync(image_device,         image.data,         size_image,                 cudaMemcpyHostToDevice, stream_));
+            // 按行复制，支持ROI等有行间距的图像
+            checkCudaRuntime(cudaMemcpy2DAsync(image_device, image.cols * 3, image.data, image.step, image.cols * 3, image.rows, cudaMemcpyHostToDevice, stream_));
             checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, job.additional.d2i, sizeof(job.additional.d2i), cudaMemcpyHostToDevice, stream_));
 
             auto normalize         = CUDAKernel::Norm::mean_std(mean, std, 1/255.0f, CUDAKernel::ChannelType::Invert);
@@ -192,12 +215,14 @@ namespace AlphaPose{
         int input_width_ = 0;
         int input_height_ = 0;
         int gpu_ = 0;
+        Refine refine_ = Refine::None;
+        bool gpu_decode_ = false;
         TRT::CUStream stream_ = nullptr;
     };
 
-    shared_ptr<Infer> create_infer(const string& engine_file, int gpuid){
+    shared_ptr<Infer> create_infer(const string& engine_file, int gpuid, Refine refine, bool gpu_decode){
         shared_ptr<InferImpl> instance(new InferImpl());
-        if(!instance->startup(engine_file, gpuid)){
+        if(!instance->startup(engine_file, gpuid, refine, gpu_decode)){
             instance.reset();
         }
         return instance;
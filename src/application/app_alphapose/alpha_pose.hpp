@@ -6,6 +6,7 @@
 #include <string>
 #include <future>
 #include <opencv2/opencv.hpp>
+#include "alpha_pose_decode.hpp"
 
 namespace AlphaPose{
 
@@ -20,7 +21,9 @@ namespace AlphaPose{
         virtual vector<shared_future<vector<Point3f>>> commits(const vector<Input>& inputs) = 0;
     };
 
-    shared_ptr<Infer> create_infer(const string& engine_file, int gpuid);
+    /* refine是热图关键点的亚像素修正方法，默认None与修正之前的结果一致
+       gpu_decode为true时在GPU上解码，只下载关键点，否则下载整个热图在CPU上解码 */
+    shared_ptr<Infer> create_infer(const string& engine_file, int gpuid, Refine refine = Refine::None, bool gpu_decode = false);
 
 }; // namespace AlphaPose
 
@@ -0,0 +1,192 @@
+
+#include "alpha_pose_decode.hpp"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ALPHA_POSE_SSE2
+#endif
+
+namespace AlphaPose{
+
+    // DARK使用的高斯核，与cv::GaussianBlur(ksize=11, sigma=0)相同，sigma = 0.3 * ((11 - 1) * 0.5 - 1) + 0.8 = 2
+    static const int DARK_KERNEL_RADIUS = 5;
+
+    struct DarkKernel{
+        float weights[DARK_KERNEL_RADIUS * 2 + 1];
+
+        DarkKernel(){
+            const float sigma = 2.0f;
+            float sum = 0;
+            for(int i = -DARK_KERNEL_RADIUS; i <= DARK_KERNEL_RADIUS; ++i){
+                weights[i + DARK_KERNEL_RADIUS] = std::exp(-(i * i) / (2 * sigma * sigma));
+                sum += weights[i + DARK_KERNEL_RADIUS];
+            }
+
+            for(auto& w : weights)
+                w /= sum;
+        }
+    };
+
+    const char* refine_string(Refine refine){
+        switch(refine){
+        case Refine::None:    return "None";
+        case Refine::Quarter: return "Quarter";
+        case Refine::Dark:    return "Dark";
+        default: return "Unknow";
+        }
+    }
+
+    int argmax(const float* data, int size, float* value){
+
+        if(size <= 0){
+            if(value) *value = 0;
+            return -1;
+        }
+
+        int i          = 0;
+        int best_index = 0;
+        float best     = data[0];
+
+#ifdef ALPHA_POSE_SSE2
+        if(size >= 8){
+            // 两组4路分别记录每一路第一次出现的最大值及位置，严格大于才更新
+            __m128 best0        = _mm_loadu_ps(data);
+            __m128 best1        = _mm_loadu_ps(data + 4);
+            __m128i index0      = _mm_setr_epi32(0, 1, 2, 3);
+            __m128i index1      = _mm_setr_epi32(4, 5, 6, 7);
+            __m128i best_index0 = index0;
+            __m128i best_index1 = index1;
+            const __m128i step  = _mm_set1_epi32(8);
+
+            for(i = 8; i + 8 <= size; i += 8){
+                index0 = _mm_add_epi32(index0, step);
+                index1 = _mm_add_epi32(index1, step);
+
+                __m128 v0    = _mm_loadu_ps(data + i);
+                __m128 v1    = _mm_loadu_ps(data + i + 4);
+                __m128 mask0 = _mm_cmpgt_ps(v0, best0);
+                __m128 mask1 = _mm_cmpgt_ps(v1, best1);
+                best0 = _mm_or_ps(_mm_and_ps(mask0, v0), _mm_andnot_ps(mask0, best0));
+                best1 = _mm_or_ps(_mm_and_ps(mask1, v1), _mm_andnot_ps(mask1, best1));
+
+                __m128i imask0 = _mm_castps_si128(mask0);
+                __m128i imask1 = _mm_castps_si128(mask1);
+                best_index0 = _mm_or_si128(_mm_and_si128(imask0, index0), _mm_andnot_si128(imask0, best_index0));
+                best_index1 = _mm_or_si128(_mm_and_si128(imask1, index1), _mm_andnot_si128(imask1, best_index1));
+            }
+
+            float values[8];
+            int indexs[8];
+            _mm_storeu_ps(values,     best0);
+            _mm_storeu_ps(values + 4, best1);
+            _mm_storeu_si128((__m128i*)indexs,       best_index0);
+            _mm_storeu_si128((__m128i*)(indexs + 4), best_index1);
+
+            // 8路合并，最大值相同时取位置小的
+            best       = values[0];
+            best_index = indexs[0];
+            for(int k = 1; k < 8; ++k){
+                if(values[k] > best || (values[k] == best && indexs[k] < best_index)){
+                    best       = values[k];
+                    best_index = indexs[k];
+                }
+            }
+        }
+#endif
+
+        for(; i < size; ++i){
+            if(data[i] > best){
+                best       = data[i];
+                best_index = i;
+            }
+        }
+
+        if(value) *value = best;
+        return best_index;
+    }
+
+    // 超出热图的位置按0处理，与DARK实现中先补0再平滑一致
+    static float dark_blurred(const float* heatmap, int width, int height, int x, int y, const DarkKernel& kernel){
+
+        float sum = 0;
+        for(int j = -DARK_KERNEL_RADIUS; j <= DARK_KERNEL_RADIUS; ++j){
+            int yy = y + j;
+            if(yy < 0 || yy >= height) continue;
+
+            const float* row = heatmap + yy * width;
+            float row_sum = 0;
+            for(int i = -DARK_KERNEL_RADIUS; i <= DARK_KERNEL_RADIUS; ++i){
+                int xx = x + i;
+                if(xx < 0 || xx >= width) continue;
+                row_sum += row[xx] * kernel.weights[i + DARK_KERNEL_RADIUS];
+            }
+            sum += row_sum * kernel.weights[j + DARK_KERNEL_RADIUS];
+        }
+
+        // 平滑后的缩放对取对数后的导数没有影响，省略DARK中恢复最大值的一步
+        return std::log(std::max(sum, 1e-10f));
+    }
+
+    static void refine_dark(const float* heatmap, int width, int height, int px, int py, float& x, float& y, const DarkKernel& kernel){
+
+        if(px <= 1 || px >= width - 2 || py <= 1 || py >= height - 2)
+            return;
+
+        auto h = [&](int dx, int dy){return dark_blurred(heatmap, width, height, px + dx, py + dy, kernel);};
+        float center = h(0, 0);
+        float dx     = 0.5f  * (h(1, 0) - h(-1, 0));
+        float dy     = 0.5f  * (h(0, 1) - h(0, -1));
+        float dxx    = 0.25f * (h(2, 0) - 2 * center + h(-2, 0));
+        float dyy    = 0.25f * (h(0, 2) - 2 * center + h(0, -2));
+        float dxy    = 0.25f * (h(1, 1) - h(1, -1) - h(-1, 1) + h(-1, -1));
+        float det    = dxx * dyy - dxy * dxy;
+        if(det == 0) return;
+
+        // offset = -H^-1 * gradient，平坦区域的偏移可能很大，限制在一个像素以内
+        float ox = -( dyy * dx - dxy * dy) / det;
+        float oy = -(-dxy * dx + dxx * dy) / det;
+        x += std::max(-1.0f, std::min(1.0f, ox));
+        y += std::max(-1.0f, std::min(1.0f, oy));
+    }
+
+    static void refine_quarter(const float* heatmap, int width, int height, int px, int py, float& x, float& y){
+
+        if(px <= 1 || px >= width - 1 || py <= 1 || py >= height - 1)
+            return;
+
+        const float* p = heatmap + py * width + px;
+        float diffx = p[1] - p[-1];
+        float diffy = p[width] - p[-width];
+        x += diffx > 0 ? 0.25f : (diffx < 0 ? -0.25f : 0.0f);
+        y += diffy > 0 ? 0.25f : (diffy < 0 ? -0.25f : 0.0f);
+    }
+
+    void decode_heatmaps(const float* heatmaps, int num_joints, int width, int height, Refine refine, float* output){
+
+        static const DarkKernel kernel;
+        int area = width * height;
+        for(int i = 0; i < num_joints; ++i){
+
+            const float* heatmap = heatmaps + (size_t)i * area;
+            float confidence = 0;
+            int location = argmax(heatmap, area, &confidence);
+            int px  = location % width;
+            int py  = location / width;
+            float x = px;
+            float y = py;
+
+            if(refine == Refine::Quarter)
+                refine_quarter(heatmap, width, height, px, py, x, y);
+            else if(refine == Refine::Dark)
+                refine_dark(heatmap, width, height, px, py, x, y, kernel);
+
+            float* pout = output + i * 3;
+            pout[0] = x;
+            pout[1] = y;
+            pout[2] = confidence;
+        }
+    }
+
+}; // namespace AlphaPose
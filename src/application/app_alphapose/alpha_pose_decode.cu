@@ -0,0 +1,136 @@
+
+
+#include <common/cuda_tools.hpp>
+
+namespace AlphaPose{
+
+    static const int DECODE_BLOCK_THREADS = 256;
+    static const int DARK_KERNEL_RADIUS   = 5;
+
+    // 与alpha_pose_decode.cpp中的DarkKernel相同，ksize=11，sigma=2
+    static __constant__ float dark_weights[DARK_KERNEL_RADIUS * 2 + 1] = {
+        0.008812229f, 0.027143577f, 0.065114057f, 0.121649073f, 0.176998357f, 0.200565414f,
+        0.176998357f, 0.121649073f, 0.065114057f, 0.027143577f, 0.008812229f
+    };
+
+    static __device__ float dark_blurred(const float* heatmap, int width, int height, int x, int y){
+
+        float sum = 0;
+        for(int j = -DARK_KERNEL_RADIUS; j <= DARK_KERNEL_RADIUS; ++j){
+            int yy = y + j;
+            if(yy < 0 || yy >= height) continue;
+
+            const float* row = heatmap + yy * width;
+            float row_sum = 0;
+            for(int i = -DARK_KERNEL_RADIUS; i <= DARK_KERNEL_RADIUS; ++i){
+                int xx = x + i;
+                if(xx < 0 || xx >= width) continue;
+                row_sum += row[xx] * dark_weights[i + DARK_KERNEL_RADIUS];
+            }
+            sum += row_sum * dark_weights[j + DARK_KERNEL_RADIUS];
+        }
+        return logf(fmaxf(sum, 1e-10f));
+    }
+
+    static __device__ void refine_dark(const float* heatmap, int width, int height, int px, int py, float* x, float* y){
+
+        if(px <= 1 || px >= width - 2 || py <= 1 || py >= height - 2)
+            return;
+
+        float center = dark_blurred(heatmap, width, height, px, py);
+        float dx     = 0.5f  * (dark_blurred(heatmap, width, height, px + 1, py) - dark_blurred(heatmap, width, height, px - 1, py));
+        float dy     = 0.5f  * (dark_blurred(heatmap, width, height, px, py + 1) - dark_blurred(heatmap, width, height, px, py - 1));
+        float dxx    = 0.25f * (dark_blurred(heatmap, width, height, px + 2, py) - 2 * center + dark_blurred(heatmap, width, height, px - 2, py));
+        float dyy    = 0.25f * (dark_blurred(heatmap, width, height, px, py + 2) - 2 * center + dark_blurred(heatmap, width, height, px, py - 2));
+        float dxy    = 0.25f * (
+            dark_blurred(heatmap, width, height, px + 1, py + 1) - dark_blurred(heatmap, width, height, px + 1, py - 1) -
+            dark_blurred(heatmap, width, height, px - 1, py + 1) + dark_blurred(heatmap, width, height, px - 1, py - 1)
+        );
+        float det = dxx * dyy - dxy * dxy;
+        if(det == 0) return;
+
+        float ox = -( dyy * dx - dxy * dy) / det;
+        float oy = -(-dxy * dx + dxx * dy) / det;
+        *x += fmaxf(-1.0f, fminf(1.0f, ox));
+        *y += fmaxf(-1.0f, fminf(1.0f, oy));
+    }
+
+    static __device__ void refine_quarter(const float* heatmap, int width, int height, int px, int py, float* x, float* y){
+
+        if(px <= 1 || px >= width - 1 || py <= 1 || py >= height - 1)
+            return;
+
+        const float* p = heatmap + py * width + px;
+        float diffx = p[1] - p[-1];
+        float diffy = p[width] - p[-width];
+        *x += diffx > 0 ? 0.25f : (diffx < 0 ? -0.25f : 0.0f);
+        *y += diffy > 0 ? 0.25f : (diffy < 0 ? -0.25f : 0.0f);
+    }
+
+    // 每个block处理一个关键点的热图：线程跨步求局部最大值，共享内存归约，最大值相同时取位置小的
+    static __global__ void decode_kernel(
+        float* heatmaps, int num_joints, int batch_stride, int width, int height, int refine, float* parray
+    ){
+        int ibatch = blockIdx.x / num_joints;
+        int joint  = blockIdx.x % num_joints;
+        int area   = width * height;
+        const float* heatmap = heatmaps + (size_t)ibatch * batch_stride + (size_t)joint * area;
+
+        __shared__ float shared_values[DECODE_BLOCK_THREADS];
+        __shared__ int   shared_indexs[DECODE_BLOCK_THREADS];
+
+        float best = -INFINITY;
+        int best_index = area;
+        for(int i = threadIdx.x; i < area; i += blockDim.x){
+            float value = heatmap[i];
+            if(value > best){
+                best       = value;
+                best_index = i;
+            }
+        }
+        shared_values[threadIdx.x] = best;
+        shared_indexs[threadIdx.x] = best_index;
+        __syncthreads();
+
+        for(int s = blockDim.x / 2; s > 0; s >>= 1){
+            if(threadIdx.x < s){
+                float other_value = shared_values[threadIdx.x + s];
+                int other_index   = shared_indexs[threadIdx.x + s];
+                if(other_value > shared_values[threadIdx.x] || (other_value == shared_values[threadIdx.x] && other_index < shared_indexs[threadIdx.x])){
+                    shared_values[threadIdx.x] = other_value;
+                    shared_indexs[threadIdx.x] = other_index;
+                }
+            }
+            __syncthreads();
+        }
+
+        if(threadIdx.x != 0)
+            return;
+
+        int location = min(shared_indexs[0], area - 1);
+        int px  = location % width;
+        int py  = location / width;
+        float x = px;
+        float y = py;
+        if(refine == 1)
+            refine_quarter(heatmap, width, height, px, py, &x, &y);
+        else if(refine == 2)
+            refine_dark(heatmap, width, height, px, py, &x, &y);
+
+        float* pout = parray + (ibatch * num_joints + joint) * 3;
+        pout[0] = x;
+        pout[1] = y;
+        pout[2] = heatmap[location];
+    }
+
+    void decode_kernel_invoker(
+        float* heatmaps, int batch_size, int num_joints, int batch_stride, int width, int height,
+        int refine, float* parray, cudaStream_t stream
+    ){
+        dim3 grid(batch_size * num_joints);
+        dim3 block(DECODE_BLOCK_THREADS);
+        checkCudaKernel(decode_kernel<<<grid, block, 0, stream>>>(
+            heatmaps, num_joints, batch_stride, width, height, refine, parray
+        ));
+    }
+}; // namespace AlphaPose
@@ -0,0 +1,28 @@
+
+
+#ifndef ALPHA_POSE_DECODE_HPP
+#define ALPHA_POSE_DECODE_HPP
+
+/* 热图关键点解码：每个通道取最大值位置，再做亚像素修正
+   CPU上用SSE2求argmax，结果与std::max_element相同（最大值相同时取第一个）
+   alpha_pose_decode.cu中有同样规则的GPU实现，只需要下载关键点而不是整个热图 */
+namespace AlphaPose{
+
+    enum class Refine : int{
+        None    = 0,    // 最大值所在的整数位置
+        Quarter = 1,    // 向相邻像素中较大的一侧偏移0.25，SimpleBaseline、AlphaPose的做法
+        Dark    = 2     // DARK，高斯平滑后的对数热图在最大值处做二阶泰勒展开
+    };
+
+    const char* refine_string(Refine refine);
+
+    // 返回最大值的位置，value不为nullptr时写入最大值
+    int argmax(const float* data, int size, float* value = nullptr);
+
+    /* heatmaps是num_joints个连续的height x width热图
+       output为num_joints x 3，每个关键点是x, y, confidence，坐标在热图上，confidence为热图的最大值 */
+    void decode_heatmaps(const float* heatmaps, int num_joints, int width, int height, Refine refine, float* output);
+
+}; // namespace AlphaPose
+
+#endif // ALPHA_POSE_DECODE_HPP
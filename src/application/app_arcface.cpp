@@ -6,7 +6,9 @@
 #include "app_arcface/arcface.hpp"
 #include "tools/deepsort.hpp"
 #include "tools/zmq_remote_show.hpp"
+#include "tools/face_pipeline.hpp"
 #include <unordered_map>
+#include <queue>
 
 using namespace std;
 using namespace cv;
@@ -185,44 +187,60 @@ int app_arcface_video(){
     //auto remote_show = create_zmq_remote_show();
     INFO("Use tools/show.py to remote show");
 
-    VideoCapture cap("exp/face_tracker.mp4");
-    Mat image;
-    while(cap.read(image)){
-        auto faces  = detector->commit(image).get();
-        vector<string> names(faces.size());
-        for(int i = 0; i < faces.size(); ++i){
-            Mat crop;
-            auto face = faces[i];
-            tie(crop, face) = Scrfd::crop_face_and_landmark(image, face);
-            
-            Arcface::landmarks landmarks;
-            memcpy(landmarks.points, face.landmark, sizeof(landmarks.points));
+    // 检测、对齐、特征提取流水线执行，保持若干帧在途，按提交顺序取结果
+    FacePipeline::Config config;
+    config.clone_image = false;
+    auto pipeline = FacePipeline::create_pipeline(
+        FacePipeline::detect_with(detector), FacePipeline::embed_with(arcface), config
+    );
 
-            auto out          = arcface->commit(make_tuple(crop, landmarks)).get();
-            auto scores       = Mat(get<0>(library) * out.t());
+    auto draw = [&](Mat& image, const FacePipeline::Result& result){
+        for(auto& item : result.faces){
+            auto& face        = item.box;
+            auto scores       = Mat(get<0>(library) * item.feature.t());
             float* pscore     = scores.ptr<float>(0);
             int label         = std::max_element(pscore, pscore + scores.rows) - pscore;
             float match_score = max(0.0f, pscore[label]);
 
+            string name = "Unknow";
+            auto color  = Scalar(0, 0, 255);
             if(match_score > 0.3f){
-                names[i] = iLogger::format("%s[%.3f]", get<1>(library)[label].c_str(), match_score);
-            }
-        }
-
-        for(int i = 0; i < faces.size(); ++i){
-            auto& face = faces[i];
-
-            auto color = Scalar(0, 255, 0);
-            if(names[i].empty()){
-                color = Scalar(0, 0, 255);
-                names[i] = "Unknow";
+                name  = iLogger::format("%s[%.3f]", get<1>(library)[label].c_str(), match_score);
+                color = Scalar(0, 255, 0);
             }
             
             rectangle(image, cv::Point(face.left, face.top), cv::Point(face.right, face.bottom), color, 3);
-            putText(image, names[i], cv::Point(face.left, face.top - 5), 0, 1, color, 1, 16);
+            putText(image, name, cv::Point(face.left, face.top - 5), 0, 1, color, 1, 16);
         }
         //remote_show->post(image);
+    };
+
+    VideoCapture cap("exp/face_tracker.mp4");
+    Mat image;
+    queue<tuple<Mat, shared_future<FacePipeline::Result>>> inflight;
+    while(cap.read(image)){
+
+        // cap.read会复用image的内存，复制一份用于提交和绘制
+        Mat frame = image.clone();
+        inflight.emplace(frame, pipeline->commit(frame));
+        if((int)inflight.size() < config.max_inflight) continue;
+
+        auto& front = inflight.front();
+        draw(get<0>(front), get<1>(front).get());
+        inflight.pop();
     }
+
+    while(!inflight.empty()){
+        auto& front = inflight.front();
+        draw(get<0>(front), get<1>(front).get());
+        inflight.pop();
+    }
+
+    auto statistics = pipeline->statistics();
+    INFO("%d frames, %d faces, %.1f FPS, average detect %.2f ms, align %.2f ms, embed %.2f ms",
+        (int)statistics.num_frames, (int)statistics.num_faces, statistics.fps,
+        statistics.average.detect, statistics.average.align, statistics.average.embed
+    );
     INFO("Done");
     return 0;
 }
@@ -9,28 +9,32 @@
 #include <common/preprocess_kernel.cuh>
 #include <common/monopoly_allocator.hpp>
 #include <common/cuda_tools.hpp>
+#include <common/image_copy.hpp>
 
 namespace Arcface{
     using namespace cv;
     using namespace std;
 
+    // 112 x 112分辨率时的标准人脸关键点（训练用的是这个）
+    // 96  x 112分辨率时的标准人脸关键点在下面基础上去掉x的偏移
+    // 来源于论文和公开代码中训练用到的
+    // https://github.com/wy1iu/sphereface/blob/f5cd440a2233facf46b6529bd13231bb82f23177/preprocess/code/face_align_demo.m
+    static const float standard_landmarks[] = {
+        30.2946 + 8, 51.6963,
+        65.5318 + 8, 51.5014,
+        48.0252 + 8, 71.7366,
+        33.5493 + 8, 92.3655,
+        62.7299 + 8, 92.2041
+    };
+
     struct AffineMatrix{
         float i2d[6];       // image to dst(network), 2x3 matrix
         float d2i[6];
 
         void compute(const landmarks& lands){
 
-            // 112 x 112分辨率时的标准人脸关键点（训练用的是这个）
-            // 96  x 112分辨率时的标准人脸关键点在下面基础上去掉x的偏移
-            // 来源于论文和公开代码中训练用到的
-            // https://github.com/wy1iu/sphereface/blob/f5cd440a2233facf46b6529bd13231bb82f23177/preprocess/code/face_align_demo.m
-            float Sdata[] = {
-                30.2946 + 8, 51.6963,
-                65.5318 + 8, 51.5014,
-                48.0252 + 8, 71.7366,
-                33.5493 + 8, 92.3655,
-                62.7299 + 8, 92.2041
-            };
+            float Sdata[10];
+            memcpy(Sdata, standard_landmarks, sizeof(Sdata));
 
             // 以下代码参考自：http://www.zifuture.com/archives/face-alignment
             float Qdata[] = {
@@ -126,7 +130,10 @@ namespace Arcface{
                     job.mono_tensor->release();
                 }
 
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
                 CUDAKernel::norm_feature(output->gpu<float>(), output->size(0), output->size(1), stream_);
 
                 output->to_cpu();
@@ -178,7 +185,7 @@ namespace Arcface{
 
             //checkCudaRuntime(cudaMemcpyAsync(image_host,   image.data, size_image, cudaMemcpyHostToHost,   stream_));
             // speed up
-            memcpy(image_host, image.data, size_image);
+            ImageCopy::copy_continuous(image, image_host);
             memcpy(affine_matrix_host, job.additional.d2i,   sizeof(job.additional.d2i));
             checkCudaRuntime(cudaMemcpyAsync(image_device, image_host, size_image, cudaMemcpyHostToDevice, stream_));
             checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, affine_matrix_host, sizeof(job.additional.d2i), cudaMemcpyHostToDevice, stream_));
@@ -210,12 +217,46 @@ namespace Arcface{
     };
 
     Mat face_alignment(const cv::Mat& image, const landmarks& landmark){
+        // 与批量版本相同的计算，单个和批量对齐的结果逐字节一致
+        return face_alignment(image, vector<landmarks>{landmark})[0];
+    }
+
+    vector<Mat> face_alignment(const cv::Mat& image, const vector<landmarks>& faces){
+
+        // 所有人脸拼成一张(112 * n) x 112的图，每一行按所属人脸的d2i计算原图坐标，一次remap完成全部对齐
+        // 每个人脸是其中112行的ROI，ROI本身也是连续的
         Size input_size(112, 112);
-        AffineMatrix am;
-        am.compute(landmark);
+        vector<Mat> output(faces.size());
+        if(faces.empty()) return output;
+
+        int rows = input_size.height * (int)faces.size();
+        Mat map_x(rows, input_size.width, CV_32F);
+        Mat map_y(rows, input_size.width, CV_32F);
+        for(size_t i = 0; i < faces.size(); ++i){
+            AffineMatrix am;
+            am.compute(faces[i]);
+
+            const float* m = am.d2i;
+            for(int y = 0; y < input_size.height; ++y){
+                float* px = map_x.ptr<float>((int)i * input_size.height + y);
+                float* py = map_y.ptr<float>((int)i * input_size.height + y);
+                for(int x = 0; x < input_size.width; ++x){
+                    px[x] = m[0] * x + m[1] * y + m[2];
+                    py[x] = m[3] * x + m[4] * y + m[5];
+                }
+            }
+        }
+
+        Mat batch;
+        remap(image, batch, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+        for(size_t i = 0; i < faces.size(); ++i)
+            output[i] = batch.rowRange((int)i * input_size.height, (int)(i + 1) * input_size.height);
+        return output;
+    }
 
-        Mat output;
-        warpAffine(image, output, Mat_<float>(2, 3, am.i2d), input_size, cv::INTER_LINEAR);
+    landmarks aligned_landmarks(){
+        landmarks output;
+        memcpy(output.points, standard_landmarks, sizeof(output.points));
         return output;
     }
 
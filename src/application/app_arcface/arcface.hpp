@@ -25,6 +25,12 @@ namespace Arcface{
     };
 
     cv::Mat face_alignment(const cv::Mat& image, const landmarks& landmark);
+
+    // 一帧中所有人脸一次对齐，输出的112x112图像共享一块连续内存
+    vector<cv::Mat> face_alignment(const cv::Mat& image, const vector<landmarks>& faces);
+
+    // 对齐后的112x112图像上的关键点，对齐后的图像配合它提交时，预处理的仿射变换为单位矩阵
+    landmarks aligned_landmarks();
     shared_ptr<Infer> create_infer(const string& engine_file, int gpuid=0);
 
 }; // namespace RetinaFace
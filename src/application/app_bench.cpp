@@ -0,0 +1,642 @@
+
+#include <common/ilogger.hpp>
+#include <common/json.hpp>
+#include <common/json_fast.hpp>
+#include <common/infer_controller.hpp>
+#include <common/trt_tensor.hpp>
+#include <common/tensor_diff.hpp>
+#include <onnxplugin/plugin_binary_io.hpp>
+#include "app_high_performance/high_performance.hpp"
+#include "app_alphapose/alpha_pose_decode.hpp"
+#include "app_fall_gcn/fall_tracker.hpp"
+#include "common/object_detector.hpp"
+#include "tools/deepsort.hpp"
+#include "tools/microbench.hpp"
+#include "tools/result_json.hpp"
+#include <algorithm>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+// 模拟的推理：每个输入乘2，只测InferController的提交、组batch、唤醒的开销
+class MockController : public InferController<int, int>{
+public:
+    virtual ~MockController(){
+        stop();
+    }
+
+    bool startup(int max_batch_size){
+        return InferController::startup(make_tuple(string(), max_batch_size));
+    }
+
+protected:
+    virtual void worker(promise<bool>& result) override{
+
+        int max_batch_size = get<1>(start_param_);
+        tensor_allocator_  = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2);
+        result.set_value(true);
+
+        vector<Job> fetch_jobs;
+        while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+            for(auto& job : fetch_jobs){
+                job.mono_tensor->release();
+                job.pro->set_value(job.input * 2);
+            }
+            fetch_jobs.clear();
+        }
+    }
+
+    virtual bool preprocess(Job& job, const int& input) override{
+        job.mono_tensor = tensor_allocator_->query();
+        if(job.mono_tensor == nullptr)
+            return false;
+
+        job.input = input;
+        return true;
+    }
+};
+
+// 参考实现，与GPU解码核函数相同的规则：同类别、IoU大于阈值时保留置信度高的框
+static ObjectDetector::BoxArray cpu_nms(ObjectDetector::BoxArray boxes, float nms_threshold){
+
+    std::sort(boxes.begin(), boxes.end(), [](ObjectDetector::Box& a, ObjectDetector::Box& b){
+        return a.confidence > b.confidence;
+    });
+
+    ObjectDetector::BoxArray output;
+    output.reserve(boxes.size());
+
+    vector<bool> removed(boxes.size(), false);
+    for(int i = 0; i < boxes.size(); ++i){
+        if(removed[i]) continue;
+
+        auto& a = boxes[i];
+        output.emplace_back(a);
+        float area_a = (a.right - a.left) * (a.bottom - a.top);
+        for(int j = i + 1; j < boxes.size(); ++j){
+            auto& b = boxes[j];
+            if(removed[j] || b.class_label != a.class_label) continue;
+
+            float cross_left   = std::max(a.left, b.left);
+            float cross_top    = std::max(a.top, b.top);
+            float cross_right  = std::min(a.right, b.right);
+            float cross_bottom = std::min(a.bottom, b.bottom);
+            float cross_area   = std::max(0.0f, cross_right - cross_left) * std::max(0.0f, cross_bottom - cross_top);
+            float union_area   = area_a + (b.right - b.left) * (b.bottom - b.top) - cross_area;
+            if(union_area > 0 && cross_area / union_area > nms_threshold)
+                removed[j] = true;
+        }
+    }
+    return output;
+}
+
+static ObjectDetector::BoxArray random_boxes(int num, int num_classes, mt19937& rng){
+
+    uniform_real_distribution<float> position(0, 1200);
+    uniform_real_distribution<float> size(20, 200);
+    uniform_real_distribution<float> confidence(0.25f, 1.0f);
+    uniform_int_distribution<int> label(0, num_classes - 1);
+
+    ObjectDetector::BoxArray boxes(num);
+    for(auto& box : boxes){
+        box.left        = position(rng);
+        box.top         = position(rng) * 0.6f;
+        box.right       = box.left + size(rng);
+        box.bottom      = box.top + size(rng);
+        box.confidence  = confidence(rng);
+        box.class_label = label(rng);
+    }
+    return boxes;
+}
+
+static void bench_allocator(MicroBench::Suite& suite){
+
+    const int num_query = 10000;
+    MonopolyAllocator<int> allocator(16);
+    suite.run("allocator.query_release", [&](){
+        for(int i = 0; i < num_query; ++i){
+            auto item = allocator.query();
+            if(item == nullptr) return false;
+            item->release();
+        }
+        return true;
+    }, num_query);
+
+    // 4个线程争用2个位置，包含等待和唤醒
+    MonopolyAllocator<int> contended(2);
+    suite.run("allocator.contended_4threads", [&](){
+        atomic<int> failed{0};
+        vector<thread> threads;
+        for(int t = 0; t < 4; ++t){
+            threads.emplace_back([&](){
+                for(int i = 0; i < num_query / 4; ++i){
+                    auto item = contended.query();
+                    if(item == nullptr){
+                        failed++;
+                        return;
+                    }
+                    item->release();
+                }
+            });
+        }
+        for(auto& t : threads) t.join();
+        return failed == 0;
+    }, num_query);
+}
+
+static void bench_infer_controller(MicroBench::Suite& suite){
+
+    MockController controller;
+    if(!controller.startup(16)){
+        INFOE("Startup mock controller failed");
+        return;
+    }
+
+    const int num_inputs = 256;
+    vector<int> inputs(num_inputs);
+    for(int i = 0; i < num_inputs; ++i)
+        inputs[i] = i;
+
+    suite.run("infer_controller.commit", [&](){
+        vector<shared_future<int>> futures;
+        futures.reserve(num_inputs);
+        for(auto input : inputs)
+            futures.emplace_back(controller.commit(input));
+
+        for(int i = 0; i < num_inputs; ++i){
+            if(futures[i].get() != inputs[i] * 2)
+                return false;
+        }
+        return true;
+    }, num_inputs);
+
+    suite.run("infer_controller.commits", [&](){
+        auto futures = controller.commits(inputs);
+        for(int i = 0; i < num_inputs; ++i){
+            if(futures[i].get() != inputs[i] * 2)
+                return false;
+        }
+        return true;
+    }, num_inputs);
+}
+
+static void bench_pipeline(MicroBench::Suite& suite){
+
+    using namespace HighPerformance;
+    const int num_datas = 1000;
+    suite.run("pipeline.input_to_output", [&](){
+
+        promise<int> done;
+        int received = 0;
+        InputNode input;
+        OutputNode output;
+        connect(input, output);
+
+        output.startup([&](vector<shared_ptr<Data>>& datas){
+            if(++received == num_datas)
+                done.set_value(received);
+        });
+
+        input.startup([&](vector<shared_ptr<Pipeline>>& outputs){
+            for(int i = 0; i < num_datas; ++i){
+                auto data = make_data_future(make_shared<IntData>(i));
+                for(auto& o : outputs)
+                    o->commit(data);
+            }
+        });
+
+        bool ok = done.get_future().get() == num_datas;
+        input.stop();
+        output.stop();
+        return ok;
+    }, num_datas);
+}
+
+static void bench_deepsort(MicroBench::Suite& suite){
+
+    // num_objects个目标匀速运动，每帧都被检测到
+    const int num_objects = 50;
+    const int num_frames  = 100;
+    mt19937 rng(7);
+    uniform_real_distribution<float> position(0, 1600);
+    uniform_real_distribution<float> velocity(-5, 5);
+
+    vector<DeepSORT::Box> starts(num_objects);
+    vector<cv::Point2f> velocities(num_objects);
+    for(int i = 0; i < num_objects; ++i){
+        float x = position(rng), y = position(rng) * 0.5f;
+        starts[i]     = DeepSORT::Box(x, y, x + 60, y + 150);
+        velocities[i] = cv::Point2f(velocity(rng), velocity(rng));
+    }
+
+    vector<DeepSORT::BBoxes> frames(num_frames);
+    for(int f = 0; f < num_frames; ++f){
+        for(int i = 0; i < num_objects; ++i){
+            auto box = starts[i];
+            box.left  += velocities[i].x * f;  box.right  += velocities[i].x * f;
+            box.top   += velocities[i].y * f;  box.bottom += velocities[i].y * f;
+            frames[f].emplace_back(box);
+        }
+    }
+
+    suite.run("deepsort.update_50objects", [&](){
+        auto tracker = DeepSORT::create_tracker();
+        if(tracker == nullptr) return false;
+
+        for(auto& boxes : frames)
+            tracker->update(boxes);
+        return !tracker->get_objects().empty();
+    }, num_frames);
+
+    for(int size : {16, 64}){
+        uniform_real_distribution<double> cost(0, 100);
+        vector<vector<double>> cost_matrix(size, vector<double>(size));
+        for(auto& row : cost_matrix)
+            for(auto& value : row)
+                value = cost(rng);
+
+        vector<int> assignment;
+        suite.run(iLogger::format("hungarian.%dx%d", size, size), [&](){
+            DeepSORT::hungarian_assignment(cost_matrix, assignment);
+            return assignment.size() == size;
+        });
+    }
+}
+
+static void bench_tensor(MicroBench::Suite& suite){
+
+    // Tensor的CPU内存是cudaMallocHost分配的页锁定内存，需要CUDA运行时，但转换本身在CPU上
+    TRT::Tensor tensor(1, 3, 640, 640);
+    tensor.set_to(0.5f);
+    int numel = tensor.numel();
+    suite.run("tensor.float_half_roundtrip", [&](){
+        tensor.to_half();
+        tensor.to_float();
+        return tensor.type() == TRT::DataType::Float;
+    }, numel);
+}
+
+static void bench_tensor_diff(MicroBench::Suite& suite){
+
+    // 模拟FP16引擎与FP32引擎输出的比较
+    const size_t numel = 4 << 20;
+    mt19937 rng(17);
+    normal_distribution<float> value(0, 2), noise(0, 1e-3f);
+    vector<float> reference(numel), output(numel);
+    for(size_t i = 0; i < numel; ++i){
+        reference[i] = value(rng);
+        output[i]    = reference[i] + noise(rng);
+    }
+
+    vector<TRT::float16> half(numel);
+    for(size_t i = 0; i < numel; ++i)
+        half[i] = TRT::float_to_float16(output[i]);
+
+    TensorDiff::Config config;
+    suite.run("tensor_diff.float_4M", [&](){
+        auto result = TensorDiff::compare(output.data(), TensorDiff::DataType::Float, reference.data(), TensorDiff::DataType::Float, numel, config);
+        return result.error.empty() && result.topk.size() == config.topk;
+    }, numel);
+
+    suite.run("tensor_diff.half_vs_float_4M", [&](){
+        auto result = TensorDiff::compare(half.data(), TensorDiff::DataType::Float16, reference.data(), TensorDiff::DataType::Float, numel, config);
+        return result.error.empty() && result.cosine > 0.999;
+    }, numel);
+}
+
+static void bench_logger(MicroBench::Suite& suite){
+
+    const int num_logs = 10000;
+    size_t total = 0;
+    suite.run("ilogger.format", [&](){
+        for(int i = 0; i < num_logs; ++i)
+            total += iLogger::format("frame %d, %d boxes, %.3f ms", i, i % 100, i * 0.01f).size();
+        return total > 0;
+    }, num_logs);
+
+    suite.run("ilogger.time_now", [&](){
+        for(int i = 0; i < num_logs; ++i)
+            total += iLogger::time_now().size();
+        return total > 0;
+    }, num_logs);
+
+    // 低于当前等级的日志应该几乎没有开销
+    auto level = iLogger::get_log_level();
+    iLogger::set_log_level(iLogger::LogLevel::Info);
+    suite.run("ilogger.filtered_verbose", [&](){
+        for(int i = 0; i < num_logs; ++i)
+            INFOV("frame %d, %d boxes, %.3f ms", i, i % 100, i * 0.01f);
+        return true;
+    }, num_logs);
+    iLogger::set_log_level(level);
+}
+
+static void bench_binio(MicroBench::Suite& suite){
+
+    const int num_weights = 1000;
+    vector<float> weight(256);
+    for(int i = 0; i < weight.size(); ++i)
+        weight[i] = i * 0.1f;
+
+    string serialized;
+    suite.run("binio.write", [&](){
+        Plugin::BinIO out;
+        out << num_weights;
+        for(int i = 0; i < num_weights; ++i){
+            out << vector<int>{(int)weight.size()};
+            out.write(weight.data(), weight.size() * sizeof(float));
+        }
+        serialized = out.releaseMemory();
+        return out.opstate();
+    }, num_weights);
+
+    suite.run("binio.read_span", [&](){
+        Plugin::BinIO in(serialized.data(), serialized.size());
+        int num = 0;
+        in >> num;
+        for(int i = 0; i < num; ++i){
+            vector<int> dims;
+            in >> dims;
+            if(!in.opstate() || dims.size() != 1 || in.readSpan(dims[0] * sizeof(float)) == nullptr)
+                return false;
+        }
+        return num == num_weights && in.eof();
+    }, num_weights);
+}
+
+static void bench_json(MicroBench::Suite& suite){
+
+    // 与推理服务返回的格式类似：每个框一个对象
+    const int num_boxes = 1000;
+    mt19937 rng(11);
+    auto boxes = random_boxes(num_boxes, 80, rng);
+
+    auto build_tree = [&](){
+        Json::Value root(Json::objectValue);
+        root["image"] = "street.jpg";
+        auto& jboxes = root["boxes"] = Json::Value(Json::arrayValue);
+        for(auto& box : boxes){
+            Json::Value item(Json::objectValue);
+            item["left"]        = box.left;
+            item["top"]         = box.top;
+            item["right"]       = box.right;
+            item["bottom"]      = box.bottom;
+            item["confidence"]  = box.confidence;
+            item["class_label"] = box.class_label;
+            jboxes.append(item);
+        }
+        return root;
+    };
+
+    Json::Value root = build_tree();
+    string text = Json::FastWriter().write(root);
+    suite.run("json.parse_1000boxes", [&](){
+        Json::Value value;
+        Json::Reader reader;
+        return reader.parse(text, value) && value["boxes"].size() == num_boxes;
+    }, num_boxes);
+
+    suite.run("json.write_1000boxes", [&](){
+        return !Json::FastWriter().write(root).empty();
+    }, num_boxes);
+
+    // 每帧导出结果时的实际开销：构建Json::Value树再写出
+    suite.run("json.build_write_1000boxes", [&](){
+        return !Json::FastWriter().write(build_tree()).empty();
+    }, num_boxes);
+
+    // FastJson解析同样的文本，Document在多次解析之间复用节点和缓冲区
+    FastJson::Document doc;
+    ObjectDetector::BoxArray parsed;
+    suite.run("json.fast_parse_1000boxes", [&](){
+        return doc.parse(text) && doc.root()["boxes"].size() == num_boxes;
+    }, num_boxes);
+
+    suite.run("json.fast_parse_read_1000boxes", [&](){
+        return doc.parse(text) && ResultJson::read(doc.root()["boxes"], parsed) && parsed.size() == num_boxes;
+    }, num_boxes);
+
+    FastJson::Writer writer;
+    suite.run("json.fast_write_1000boxes", [&](){
+        return !ResultJson::frame_to_json(writer, 0, boxes).empty();
+    }, num_boxes);
+
+    FaceDetector::BoxArray faces(num_boxes);
+    for(int i = 0; i < num_boxes; ++i){
+        auto& face = faces[i];
+        face.left       = boxes[i].left;
+        face.top        = boxes[i].top;
+        face.right      = boxes[i].right;
+        face.bottom     = boxes[i].bottom;
+        face.confidence = boxes[i].confidence;
+        for(int j = 0; j < 10; ++j)
+            face.landmark[j] = j % 2 == 0 ? face.left + j * 3.1f : face.top + j * 4.7f;
+    }
+
+    suite.run("json.fast_write_1000faces", [&](){
+        writer.clear();
+        ResultJson::write(writer, faces);
+        return writer.complete();
+    }, num_boxes);
+}
+
+static void bench_nms(MicroBench::Suite& suite){
+
+    mt19937 rng(13);
+    for(int num_boxes : {1000, 4000}){
+        auto boxes = random_boxes(num_boxes, 80, rng);
+        suite.run(iLogger::format("nms.cpu_%dboxes", num_boxes), [&](){
+            return !cpu_nms(boxes, 0.5f).empty();
+        }, num_boxes);
+    }
+}
+
+// 模拟的跌倒识别模型：记录每次commit_sequences的batch大小，检查序列长度
+class MockFallInfer : public FallGCN::Infer{
+public:
+    MockFallInfer(int window_size) : window_size_(window_size){}
+
+    virtual shared_future<tuple<FallGCN::FallState, float>> commit(const FallGCN::Input& input) override{
+        return commit_sequences({FallGCN::Sequence{input}})[0];
+    }
+
+    virtual vector<shared_future<tuple<FallGCN::FallState, float>>> commits(const vector<FallGCN::Input>& inputs) override{
+        vector<FallGCN::Sequence> sequences;
+        for(auto& input : inputs)
+            sequences.emplace_back(FallGCN::Sequence{input});
+        return commit_sequences(sequences);
+    }
+
+    virtual vector<shared_future<tuple<FallGCN::FallState, float>>> commit_sequences(const vector<FallGCN::Sequence>& sequences) override{
+        num_commits++;
+        vector<shared_future<tuple<FallGCN::FallState, float>>> output;
+        for(auto& sequence : sequences){
+            if(sequence.empty() || (int)sequence.size() > window_size_)
+                num_invalid++;
+
+            promise<tuple<FallGCN::FallState, float>> pro;
+            pro.set_value(make_tuple(FallGCN::FallState::Stand, 0.9f));
+            output.emplace_back(pro.get_future().share());
+        }
+        return output;
+    }
+
+    virtual int window_size() const override{
+        return window_size_;
+    }
+
+    int window_size_  = 1;
+    size_t num_commits = 0;
+    size_t num_invalid = 0;
+};
+
+static void bench_fall_tracker(MicroBench::Suite& suite){
+
+    // 20个人，一半站着不动（关键点只有微小抖动），一半在走动，框都在平移
+    const int num_tracks = 20, num_frames = 300, num_keys = 16;
+    mt19937 rng(23);
+    uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+    vector<vector<FallGCN::TrackInput>> frames(num_frames);
+    for(int f = 0; f < num_frames; ++f){
+        for(int t = 0; t < num_tracks; ++t){
+            cv::Rect box(t * 60 + f, 100, 80, 200);
+            vector<cv::Point3f> keys(num_keys);
+            for(int k = 0; k < num_keys; ++k){
+                float swing = t % 2 == 0 ? 0 : 30 * std::sin(f * 0.2f + k);
+                keys[k] = cv::Point3f(box.x + 40 + swing + jitter(rng), box.y + k * 12 + jitter(rng), 0.9f);
+            }
+            frames[f].emplace_back(t, keys, box);
+        }
+    }
+
+    auto infer = make_shared<MockFallInfer>(8);
+    suite.run("fall_tracker.update_20tracks", [&](){
+        auto tracker = FallGCN::create_tracker(infer);
+        if(tracker == nullptr) return false;
+
+        size_t commits_before = infer->num_commits;
+        for(auto& tracks : frames){
+            auto results = tracker->update(tracks);
+            for(auto& item : results){
+                if(!item.result.valid()) return false;
+            }
+        }
+
+        // 每帧最多一次提交，站着不动的人大部分帧跳过
+        auto statistics = tracker->statistics();
+        return infer->num_commits - commits_before <= num_frames && infer->num_invalid == 0 &&
+            statistics.num_skipped > num_frames * num_tracks / 4 && statistics.num_histories == num_tracks;
+    }, num_frames);
+
+    auto tracker = FallGCN::create_tracker(infer);
+    for(auto& tracks : frames)
+        tracker->update(tracks);
+
+    auto statistics = tracker->statistics();
+    INFO("Fall tracker, %d frames x %d tracks, inferred %d, skipped %d",
+        num_frames, num_tracks, (int)statistics.num_inferred, (int)statistics.num_skipped
+    );
+}
+
+static void bench_alphapose_decode(MicroBench::Suite& suite){
+
+    // 64x48的热图，每个关键点是以亚像素位置为中心的高斯分布，sigma=2与训练时的目标相同，叠加少量噪声
+    const int batch_size = 16, num_joints = 26, width = 48, height = 64;
+    const int area       = width * height;
+    const int num_maps   = batch_size * num_joints;
+    mt19937 rng(19);
+    uniform_real_distribution<float> center_x(4, width - 5), center_y(4, height - 5), noise(0, 0.01f);
+
+    vector<float> heatmaps((size_t)num_maps * area);
+    vector<cv::Point2f> centers(num_maps);
+    for(int i = 0; i < num_maps; ++i){
+        float cx = center_x(rng), cy = center_y(rng);
+        float* heatmap = heatmaps.data() + (size_t)i * area;
+        centers[i] = cv::Point2f(cx, cy);
+        for(int y = 0; y < height; ++y){
+            for(int x = 0; x < width; ++x){
+                float d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                heatmap[y * width + x] = 0.9f * std::exp(-d2 / (2 * 2.0f * 2.0f)) + noise(rng);
+            }
+        }
+    }
+
+    vector<int> locations(num_maps);
+    suite.run("alphapose.argmax_std_16x26", [&](){
+        for(int i = 0; i < num_maps; ++i){
+            float* heatmap = heatmaps.data() + (size_t)i * area;
+            locations[i] = std::max_element(heatmap, heatmap + area) - heatmap;
+        }
+        return true;
+    }, num_maps);
+
+    // 与std::max_element的位置必须完全相同
+    suite.run("alphapose.argmax_simd_16x26", [&](){
+        for(int i = 0; i < num_maps; ++i){
+            if(AlphaPose::argmax(heatmaps.data() + (size_t)i * area, area) != locations[i])
+                return false;
+        }
+        return true;
+    }, num_maps);
+
+    vector<float> keypoints(num_maps * 3);
+    auto mean_error = [&](){
+        double sum = 0;
+        for(int i = 0; i < num_maps; ++i)
+            sum += std::sqrt(std::pow(keypoints[i * 3 + 0] - centers[i].x, 2) + std::pow(keypoints[i * 3 + 1] - centers[i].y, 2));
+        return sum / num_maps;
+    };
+
+    auto decode = [&](AlphaPose::Refine refine){
+        for(int ibatch = 0; ibatch < batch_size; ++ibatch){
+            AlphaPose::decode_heatmaps(
+                heatmaps.data() + (size_t)ibatch * num_joints * area, num_joints, width, height, refine,
+                keypoints.data() + ibatch * num_joints * 3
+            );
+        }
+    };
+
+    double errors[3] = {0};
+    const char* names[] = {"none", "quarter", "dark"};
+    for(auto refine : {AlphaPose::Refine::None, AlphaPose::Refine::Quarter, AlphaPose::Refine::Dark}){
+        auto name = iLogger::format("alphapose.decode_%s_16x26", names[(int)refine]);
+        suite.run(name, [&](){
+            decode(refine);
+            return true;
+        }, num_maps);
+
+        decode(refine);
+        errors[(int)refine] = mean_error();
+        INFO("Refine %s, mean error %.4f pixels on heatmap", AlphaPose::refine_string(refine), errors[(int)refine]);
+    }
+
+    // 亚像素修正必须比整数位置更准
+    suite.run("alphapose.decode_accuracy", [&](){
+        return errors[1] < errors[0] && errors[2] < errors[1];
+    });
+}
+
+int app_bench(){
+
+    // 所有case都在CPU上运行，结果保存到bench.result.json，使用tools/compare_bench.py与基线比较
+    MicroBench::Suite suite("tensorRT_Pro");
+    bench_allocator(suite);
+    bench_infer_controller(suite);
+    bench_pipeline(suite);
+    bench_deepsort(suite);
+    bench_tensor(suite);
+    bench_tensor_diff(suite);
+    bench_logger(suite);
+    bench_binio(suite);
+    bench_json(suite);
+    bench_nms(suite);
+    bench_alphapose_decode(suite);
+    bench_fall_tracker(suite);
+
+    const char* file = "bench.result.json";
+    if(suite.save_json(file))
+        INFO("%d cases, %d failed, save to %s", (int)suite.results().size(), suite.num_failed(), file);
+    return suite.num_failed() == 0 ? 0 : 1;
+}
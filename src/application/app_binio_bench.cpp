@@ -0,0 +1,131 @@
+
+#include <common/ilogger.hpp>
+#include <onnxplugin/plugin_binary_io.hpp>
+#include <functional>
+
+using namespace std;
+
+// 与LayerConfig::serialize相同的布局：数量，然后每个权重为dims、type、数据
+static void write_weights(Plugin::BinIO& out, const vector<vector<float>>& weights){
+    out << (int)weights.size();
+    for(auto& w : weights){
+        out << vector<int>{(int)w.size()};
+        out << (int)0;
+        out.write(w.data(), w.size() * sizeof(float));
+    }
+}
+
+// copy = true时复制到独立的vector（原来的方式），否则通过readSpan直接引用
+static double read_weights(Plugin::BinIO& in, bool copy){
+
+    int num = 0;
+    in >> num;
+    if(!in.checkLength(num, sizeof(int))) return 0;
+
+    double checksum = 0;
+    vector<float> buffer;
+    for(int i = 0; i < num; ++i){
+        vector<int> dims;
+        int type = 0;
+        in >> dims >> type;
+        if(!in.opstate() || dims.size() != 1) return 0;
+
+        size_t bytes = (size_t)dims[0] * sizeof(float);
+        const float* values = nullptr;
+        if(copy){
+            buffer.resize(dims[0]);
+            if(in.read(buffer.data(), bytes) != bytes) return 0;
+            values = buffer.data();
+        }else{
+            values = (const float*)in.readSpan(bytes);
+            if(values == nullptr) return 0;
+        }
+
+        for(int j = 0; j < dims[0]; j += 1024)
+            checksum += values[j];
+    }
+    return checksum;
+}
+
+static void run_case(const char* name, size_t total_bytes, const function<bool()>& func){
+    auto tic = iLogger::timestamp_now_float();
+    bool ok = func();
+    double elapsed = iLogger::timestamp_now_float() - tic;
+    if(!ok){
+        INFOE("%s failed", iLogger::align_blank(name, 28).c_str());
+        return;
+    }
+    INFO("%s %.2f ms, %.2f GB/s", iLogger::align_blank(name, 28).c_str(), elapsed, total_bytes / (elapsed / 1000.0) / 1024.0 / 1024.0 / 1024.0);
+}
+
+int app_binio_bench(){
+
+    const int num_weights = 12;
+    const int weight_mb   = 32;
+    size_t numel = (size_t)weight_mb * 1024 * 1024 / sizeof(float);
+    vector<vector<float>> weights(num_weights, vector<float>(numel));
+    for(int i = 0; i < num_weights; ++i){
+        for(size_t j = 0; j < numel; ++j)
+            weights[i][j] = i + j * 1e-6f;
+    }
+
+    size_t total_bytes = (size_t)num_weights * numel * sizeof(float);
+    INFO("Synthetic weights, %d x %d MB = %.2f MB", num_weights, weight_mb, total_bytes / 1024.0f / 1024.0f);
+
+    string serialized;
+    INFO("==================== serialize ====================");
+    run_case("append + copy (old)", total_bytes, [&](){
+        Plugin::BinIO out;
+        write_weights(out, weights);
+        string data = out.writedMemory();
+        return out.opstate() && !data.empty();
+    });
+
+    run_case("reserve + release", total_bytes, [&](){
+        Plugin::BinIO out;
+        out.reserve(total_bytes + 4096);
+        write_weights(out, weights);
+        serialized = out.releaseMemory();
+        return out.opstate() && !serialized.empty();
+    });
+
+    string file = "binio_bench.bin";
+    run_case("file stream write", total_bytes, [&](){
+        Plugin::BinIO out;
+        if(!out.openFileWrite(file)) return false;
+        write_weights(out, weights);
+        out.close();
+        return out.opstate();
+    });
+
+    INFO("==================== deserialize ====================");
+    run_case("memory read + copy (old)", total_bytes, [&](){
+        Plugin::BinIO in(serialized.data(), serialized.size());
+        return read_weights(in, true) != 0 && in.eof();
+    });
+
+    run_case("memory readSpan", total_bytes, [&](){
+        Plugin::BinIO in(serialized.data(), serialized.size());
+        return read_weights(in, false) != 0 && in.eof();
+    });
+
+    run_case("file stream read", total_bytes, [&](){
+        Plugin::BinIO in;
+        if(!in.openFileRead(file)) return false;
+        return read_weights(in, false) != 0 && in.eof();
+    });
+
+    run_case("mmap readSpan", total_bytes, [&](){
+        Plugin::BinIO in;
+        if(!in.openMappedRead(file)) return false;
+        return read_weights(in, false) != 0 && in.eof();
+    });
+
+    // 截断的数据应该进入错误状态，而不是越界读取
+    Plugin::BinIO truncated(serialized.data(), serialized.size() / 2);
+    read_weights(truncated, false);
+    INFO("Truncated input, opstate = %s, error = %s", truncated.opstate() ? "true" : "false", truncated.error().c_str());
+
+    iLogger::delete_file(file);
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include <common/preprocess_kernel.cuh>
 #include <common/monopoly_allocator.hpp>
 #include <common/cuda_tools.hpp>
+#include <common/image_copy.hpp>
 
 
 namespace CenterNet{
@@ -123,7 +124,10 @@ namespace CenterNet{
                     job.mono_tensor->release();
                 }
 
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
 
                 output_array_device.to_gpu(false);
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
@@ -203,7 +207,7 @@ namespace CenterNet{
             float* affine_matrix_host     = (float*)cpu_workspace;
             uint8_t* image_host           = size_matrix + cpu_workspace;
 
-            memcpy(image_host, image.data, size_image);
+            ImageCopy::copy_continuous(image, image_host);
             memcpy(affine_matrix_host, job.additional.d2i, sizeof(job.additional.d2i));
             checkCudaRuntime(cudaMemcpyAsync(image_device, image_host, size_image, cudaMemcpyHostToDevice, stream_));
             checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, affine_matrix_host, sizeof(job.additional.d2i), cudaMemcpyHostToDevice, stream_));
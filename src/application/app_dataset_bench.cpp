@@ -0,0 +1,73 @@
+
+#include <common/ilogger.hpp>
+#include "tools/dataset_loader.hpp"
+#include <functional>
+
+using namespace std;
+
+static void run_case(const char* name, int num_images, const function<int()>& func){
+    auto tic = iLogger::timestamp_now_float();
+    int num_loaded = func();
+    double elapsed = iLogger::timestamp_now_float() - tic;
+    INFO("%s %.2f ms, %.1f images/s, loaded %d / %d", iLogger::align_blank(name, 28).c_str(), elapsed, num_images / (elapsed / 1000.0), num_loaded, num_images);
+}
+
+int app_dataset_bench(){
+
+    const char* directory = "inference";
+    auto tic = iLogger::timestamp_now_float();
+    auto found = iLogger::find_files(directory, Dataset::ImageFilter, false, true);
+    double find_files_ms = iLogger::timestamp_now_float() - tic;
+
+    tic = iLogger::timestamp_now_float();
+    auto files = Dataset::find_images(directory);
+    double find_images_ms = iLogger::timestamp_now_float() - tic;
+    INFO("find_files %d files %.2f ms, find_images %d files %.2f ms", (int)found.size(), find_files_ms, (int)files.size(), find_images_ms);
+
+    if(files.empty()){
+        INFOE("No image in %s", directory);
+        return 0;
+    }
+
+    // 测试图片很少，重复到足够的数量
+    vector<string> dataset;
+    while(dataset.size() < 256)
+        dataset.insert(dataset.end(), files.begin(), files.end());
+
+    int num_images = dataset.size();
+    run_case("sequential imread", num_images, [&](){
+        int loaded = 0;
+        for(auto& file : dataset)
+            loaded += !cv::imread(file).empty();
+        return loaded;
+    });
+
+    for(auto order : {Dataset::Order::Sequential, Dataset::Order::Completion}){
+        Dataset::LoaderConfig config;
+        config.order = order;
+        run_case(order == Dataset::Order::Sequential ? "loader, sequential" : "loader, completion", num_images, [&](){
+            auto loader = Dataset::create_loader(dataset, config);
+            Dataset::Item item;
+            int loaded = 0;
+            while(loader->next(item))
+                loaded += !item.image.empty();
+            return loaded;
+        });
+    }
+
+    Dataset::LoaderConfig config;
+    config.cache_file = "dataset_bench.cache";
+    iLogger::delete_file(config.cache_file);
+    for(auto name : {"loader, build cache", "loader, from cache"}){
+        run_case(name, num_images, [&](){
+            auto loader = Dataset::create_loader(dataset, config);
+            Dataset::Item item;
+            int loaded = 0;
+            while(loader->next(item))
+                loaded += !item.image.empty();
+            return loaded;
+        });
+    }
+    iLogger::delete_file(config.cache_file);
+    return 0;
+}
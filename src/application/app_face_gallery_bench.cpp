@@ -0,0 +1,126 @@
+
+#include <common/ilogger.hpp>
+#include "tools/face_gallery.hpp"
+#include <thread>
+#include <atomic>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+static const int DIM          = 512;
+static const int GALLERY_SIZE = 100000;
+static const int NUM_APPEND   = 10000;
+static const int NUM_QUERIES  = 64;
+static const char* DIRECTORY  = "face_gallery_bench";
+
+static void random_feature(mt19937& rng, float* output){
+    normal_distribution<float> normal(0, 1);
+    for(int i = 0; i < DIM; ++i)
+        output[i] = normal(rng);
+}
+
+static double search_qps(const shared_ptr<FaceGallery::Gallery>& gallery, const vector<float>& queries){
+    auto tic = iLogger::timestamp_now_float();
+    gallery->search(queries.data(), NUM_QUERIES, 5);
+    return NUM_QUERIES / ((iLogger::timestamp_now_float() - tic) / 1000.0);
+}
+
+int app_face_gallery_bench(){
+
+    iLogger::rmtree(DIRECTORY, true);
+
+    FaceGallery::Config config;
+    config.dim = DIM;
+
+    mt19937 rng(1234);
+    vector<float> features((size_t)GALLERY_SIZE * DIM);
+    for(int i = 0; i < GALLERY_SIZE; ++i)
+        random_feature(rng, features.data() + (size_t)i * DIM);
+
+    vector<float> queries(features.begin(), features.begin() + (size_t)NUM_QUERIES * DIM);
+    auto writer = FaceGallery::open_gallery(DIRECTORY, FaceGallery::Mode::Write, config);
+    if(writer == nullptr){
+        INFOE("Open gallery %s failed", DIRECTORY);
+        return 0;
+    }
+
+    auto tic = iLogger::timestamp_now_float();
+    for(int i = 0; i < GALLERY_SIZE; ++i)
+        writer->add(i, features.data() + (size_t)i * DIM, iLogger::format("person_%d", i));
+    double append_ms = iLogger::timestamp_now_float() - tic;
+    INFO("Append %d records, %.1f records/s, log %.1f MB", GALLERY_SIZE, GALLERY_SIZE / (append_ms / 1000.0), writer->info().log_bytes / 1024.0 / 1024.0);
+
+    tic = iLogger::timestamp_now_float();
+    writer.reset();
+    writer = FaceGallery::open_gallery(DIRECTORY, FaceGallery::Mode::Write, config);
+    INFO("Open with %d log records (replay), %.2f ms", GALLERY_SIZE, iLogger::timestamp_now_float() - tic);
+
+    tic = iLogger::timestamp_now_float();
+    writer->compact();
+    INFO("Compact, %.2f ms", iLogger::timestamp_now_float() - tic);
+
+    // 冷启动只映射快照，不读取特征
+    tic = iLogger::timestamp_now_float();
+    auto reader = FaceGallery::open_gallery(DIRECTORY, FaceGallery::Mode::Read, config);
+    double open_ms = iLogger::timestamp_now_float() - tic;
+    if(reader == nullptr){
+        INFOE("Open gallery %s for read failed", DIRECTORY);
+        return 0;
+    }
+    INFO("Open compacted gallery of %d, %.3f ms", (int)reader->size(), open_ms);
+
+    tic = iLogger::timestamp_now_float();
+    bool verified = reader->verify();
+    INFO("Verify checksum %s, %.2f ms", verified ? "ok" : "failed", iLogger::timestamp_now_float() - tic);
+
+    auto results = reader->search(queries.data(), NUM_QUERIES, 5);
+    int num_correct = 0;
+    for(int i = 0; i < NUM_QUERIES; ++i)
+        num_correct += !results[i].empty() && results[i][0].id == i && reader->name(i) == iLogger::format("person_%d", i);
+    INFO("Search %.1f QPS (batch %d, top5), top1 correct %d / %d", search_qps(reader, queries), NUM_QUERIES, num_correct, NUM_QUERIES);
+
+    // 写者追加的同时读者持续refresh和搜索
+    atomic<bool> writing(true);
+    atomic<int> num_searches(0);
+    thread reader_thread([&](){
+        while(writing){
+            reader->refresh();
+            reader->search(queries.data(), 1, 5);
+            num_searches++;
+        }
+        reader->refresh();
+    });
+
+    vector<float> feature(DIM);
+    tic = iLogger::timestamp_now_float();
+    for(int i = 0; i < NUM_APPEND; ++i){
+        random_feature(rng, feature.data());
+        writer->add(GALLERY_SIZE + i, feature.data(), iLogger::format("new_%d", i));
+    }
+    for(int i = 0; i < NUM_APPEND; ++i)
+        writer->remove(i);
+
+    double concurrent_ms = iLogger::timestamp_now_float() - tic;
+    writing = false;
+    reader_thread.join();
+    INFO("Append %d and remove %d while reading, %.2f ms, reader did %d searches, reader size %d, writer size %d",
+        NUM_APPEND, NUM_APPEND, concurrent_ms, num_searches.load(), (int)reader->size(), (int)writer->size()
+    );
+    INFO("Search with %d log records %.1f QPS", (int)reader->info().num_log, search_qps(reader, queries));
+
+    tic = iLogger::timestamp_now_float();
+    writer->compact();
+    double compact_ms = iLogger::timestamp_now_float() - tic;
+
+    tic = iLogger::timestamp_now_float();
+    reader->refresh();
+    INFO("Compact %.2f ms, reader refresh to generation %d in %.3f ms, size %d",
+        compact_ms, (int)reader->info().generation, iLogger::timestamp_now_float() - tic, (int)reader->size()
+    );
+
+    reader.reset();
+    writer.reset();
+    iLogger::rmtree(DIRECTORY, true);
+    return 0;
+}
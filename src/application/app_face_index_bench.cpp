@@ -0,0 +1,153 @@
+
+#include <common/ilogger.hpp>
+#include "tools/face_index.hpp"
+#include <unordered_set>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+static const int DIM              = 512;
+static const int NUM_IDENTITIES   = 10000;          // 每人10张，topk都是同一个人
+static const int GALLERY_SIZE     = 100000;
+static const int NUM_QUERIES      = 256;
+static const int TOPK             = 10;
+
+// 模拟Arcface特征：每个人一个随机中心，同一个人的多张照片在中心附近
+static void make_features(vector<float>& gallery, vector<float>& queries){
+
+    mt19937 rng(1234);
+    normal_distribution<float> normal(0, 1);
+
+    vector<float> centers((size_t)NUM_IDENTITIES * DIM);
+    for(auto& v : centers) v = normal(rng);
+
+    auto sample = [&](float* output, int identity){
+        const float* center = centers.data() + (size_t)identity * DIM;
+        double norm = 0;
+        for(int i = 0; i < DIM; ++i){
+            output[i] = center[i] + 0.6f * normal(rng);
+            norm += output[i] * output[i];
+        }
+
+        float scale = 1.0f / std::sqrt(norm);
+        for(int i = 0; i < DIM; ++i)
+            output[i] *= scale;
+    };
+
+    gallery.resize((size_t)GALLERY_SIZE * DIM);
+    for(int i = 0; i < GALLERY_SIZE; ++i)
+        sample(gallery.data() + (size_t)i * DIM, i % NUM_IDENTITIES);
+
+    queries.resize((size_t)NUM_QUERIES * DIM);
+    uniform_int_distribution<int> identity(0, NUM_IDENTITIES - 1);
+    for(int i = 0; i < NUM_QUERIES; ++i)
+        sample(queries.data() + (size_t)i * DIM, identity(rng));
+}
+
+static shared_ptr<FaceIndex::Index> build_index(const FaceIndex::Config& config, const vector<float>& gallery){
+
+    auto index = FaceIndex::create_index(config);
+    if(index == nullptr) return nullptr;
+
+    auto tic = iLogger::timestamp_now_float();
+    if(!index->train(gallery.data(), GALLERY_SIZE)) return nullptr;
+    double train_ms = iLogger::timestamp_now_float() - tic;
+
+    tic = iLogger::timestamp_now_float();
+    for(int i = 0; i < GALLERY_SIZE; ++i)
+        index->add(i, gallery.data() + (size_t)i * DIM);
+    double add_ms = iLogger::timestamp_now_float() - tic;
+
+    INFO("Build index, train %.2f ms, add %.1f features/s, memory %.1f MB",
+        train_ms, GALLERY_SIZE / (add_ms / 1000.0), index->memory_bytes() / 1024.0 / 1024.0
+    );
+    return index;
+}
+
+static void run_case(const char* name, const shared_ptr<FaceIndex::Index>& index, const vector<float>& queries, const vector<vector<FaceIndex::Match>>& exact){
+
+    // 单个query逐个搜索，以及整批一起搜索
+    auto tic = iLogger::timestamp_now_float();
+    vector<vector<FaceIndex::Match>> results;
+    for(int i = 0; i < NUM_QUERIES; ++i)
+        results.emplace_back(index->search(queries.data() + (size_t)i * DIM, 1, TOPK)[0]);
+    double single_ms = iLogger::timestamp_now_float() - tic;
+
+    tic = iLogger::timestamp_now_float();
+    auto batch_results = index->search(queries.data(), NUM_QUERIES, TOPK);
+    double batch_ms = iLogger::timestamp_now_float() - tic;
+
+    double recall_1 = 0, recall_k = 0;
+    for(int i = 0; i < NUM_QUERIES; ++i){
+        if(results[i].empty()) continue;
+
+        recall_1 += results[i][0].id == exact[i][0].id;
+        unordered_set<int64_t> truth;
+        for(auto& item : exact[i]) truth.insert(item.id);
+        for(auto& item : batch_results[i]) recall_k += truth.count(item.id);
+    }
+
+    INFO("%s single %8.1f QPS, batch %8.1f QPS, recall@1 %.4f, recall@%d %.4f",
+        iLogger::align_blank(name, 26).c_str(),
+        NUM_QUERIES / (single_ms / 1000.0), NUM_QUERIES / (batch_ms / 1000.0),
+        recall_1 / NUM_QUERIES, TOPK, recall_k / (NUM_QUERIES * TOPK)
+    );
+}
+
+int app_face_index_bench(){
+
+    vector<float> gallery, queries;
+    make_features(gallery, queries);
+    INFO("Gallery %d x %d, %d queries, top%d", GALLERY_SIZE, DIM, NUM_QUERIES, TOPK);
+
+    FaceIndex::Config config;
+    config.dim = DIM;
+
+    auto exact_index = build_index(config, gallery);
+    if(exact_index == nullptr){
+        INFOE("Build index failed");
+        return 0;
+    }
+
+    // 精确搜索的结果作为召回率的参考
+    auto exact = exact_index->search(queries.data(), NUM_QUERIES, TOPK);
+    run_case("flat float32", exact_index, queries, exact);
+    exact_index.reset();
+
+    for(auto storage : {FaceIndex::Storage::Float16, FaceIndex::Storage::Int8}){
+        config.storage = storage;
+        auto index = build_index(config, gallery);
+        run_case(storage == FaceIndex::Storage::Float16 ? "flat float16" : "flat int8", index, queries, exact);
+    }
+
+    config.type  = FaceIndex::Type::IVF;
+    config.nlist = 512;
+    for(auto storage : {FaceIndex::Storage::Float32, FaceIndex::Storage::Int8}){
+        config.storage = storage;
+        auto index = build_index(config, gallery);
+        if(index == nullptr) continue;
+
+        for(int nprobe : {4, 16, 64}){
+            index->set_nprobe(nprobe);
+            auto name = iLogger::format("ivf%d %s nprobe=%d", config.nlist, storage == FaceIndex::Storage::Float32 ? "float32" : "int8", nprobe);
+            run_case(name.c_str(), index, queries, exact);
+        }
+
+        // 增量删除一半，被删除的id不应该再出现
+        auto tic = iLogger::timestamp_now_float();
+        for(int i = 0; i < GALLERY_SIZE; i += 2)
+            index->remove(i);
+        double remove_ms = iLogger::timestamp_now_float() - tic;
+
+        int num_removed_found = 0;
+        for(auto& result : index->search(queries.data(), NUM_QUERIES, TOPK)){
+            for(auto& item : result)
+                num_removed_found += item.id % 2 == 0;
+        }
+        INFO("Remove %d features, %.1f features/s, size %d, removed ids in results %d",
+            GALLERY_SIZE / 2, (GALLERY_SIZE / 2) / (remove_ms / 1000.0), (int)index->size(), num_removed_found
+        );
+    }
+    return 0;
+}
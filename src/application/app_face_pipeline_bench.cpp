@@ -0,0 +1,219 @@
+
+#include <common/ilogger.hpp>
+#include "tools/face_pipeline.hpp"
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <condition_variable>
+#include <cmath>
+
+using namespace std;
+
+static const int NUM_FRAMES          = 100;
+static const int FACES_PER_FRAME     = 8;
+static const int FEATURE_LENGTH      = 512;
+static const int DETECT_MS           = 8;       // 模拟检测模型每帧的耗时
+static const float EMBED_BATCH_MS    = 3;       // 模拟特征模型每次推理的固定开销
+static const float EMBED_FACE_MS     = 0.3f;    // 以及每个人脸的耗时
+
+// 模拟GPU上的模型，一个线程按提交顺序执行
+class MockDevice{
+public:
+    MockDevice(){
+        worker_ = thread([this](){
+            function<void()> task;
+            while(true){
+                {
+                    unique_lock<mutex> l(lock_);
+                    cond_.wait(l, [&](){return !run_ || !tasks_.empty();});
+                    if(tasks_.empty()) return;
+                    task = tasks_.front();
+                    tasks_.pop();
+                }
+                task();
+            }
+        });
+    }
+
+    virtual ~MockDevice(){
+        {
+            unique_lock<mutex> l(lock_);
+            run_ = false;
+        }
+        cond_.notify_one();
+        worker_.join();
+    }
+
+    void submit(const function<void()>& task){
+        {
+            unique_lock<mutex> l(lock_);
+            tasks_.push(task);
+        }
+        cond_.notify_one();
+    }
+
+private:
+    mutex lock_;
+    condition_variable cond_;
+    queue<function<void()>> tasks_;
+    thread worker_;
+    bool run_ = true;
+};
+
+static void busy_sleep(float ms){
+    this_thread::sleep_for(chrono::microseconds((int)(ms * 1000)));
+}
+
+// 人脸排成一行，位置随帧号变化，关键点来自标准人脸按框缩放
+static FaceDetector::BoxArray mock_detect(const cv::Mat& image){
+
+    int frame = image.at<cv::Vec3b>(0, 0)[0];
+    auto standard = Arcface::aligned_landmarks();
+    FaceDetector::BoxArray boxes;
+    for(int i = 0; i < FACES_PER_FRAME; ++i){
+        FaceDetector::Box box;
+        float size      = 100 + (i * 13 + frame) % 40;
+        box.left        = 20 + i * 150 + (frame % 10);
+        box.top         = 100 + (i % 3) * 150;
+        box.right       = box.left + size;
+        box.bottom      = box.top + size;
+        box.confidence  = 0.9f - i * 0.01f;
+        for(int j = 0; j < 5; ++j){
+            box.landmark[j * 2 + 0] = box.left + standard.points[j * 2 + 0] / 112.0f * size;
+            box.landmark[j * 2 + 1] = box.top  + standard.points[j * 2 + 1] / 112.0f * size;
+        }
+        boxes.emplace_back(box);
+    }
+    return boxes;
+}
+
+// 特征由对齐后的像素决定，用于检查流水线与逐个处理的结果一致
+static Arcface::feature mock_embed(const cv::Mat& face){
+
+    Arcface::feature output(1, FEATURE_LENGTH);
+    float* pfeature = output.ptr<float>(0);
+    size_t bytes    = face.total() * face.elemSize();
+    size_t chunk    = bytes / FEATURE_LENGTH;
+    const uint8_t* pixels = face.ptr<uint8_t>(0);
+
+    double norm = 0;
+    for(int i = 0; i < FEATURE_LENGTH; ++i){
+        float sum = 1;
+        for(size_t j = 0; j < chunk; ++j)
+            sum += pixels[i * chunk + j];
+        pfeature[i] = sum;
+        norm += sum * sum;
+    }
+
+    for(int i = 0; i < FEATURE_LENGTH; ++i)
+        pfeature[i] /= std::sqrt(norm);
+    return output;
+}
+
+static FacePipeline::DetectFunction mock_detector(shared_ptr<MockDevice> device){
+    return [device](const cv::Mat& image){
+        auto pro = make_shared<promise<FaceDetector::BoxArray>>();
+        device->submit([pro, image](){
+            busy_sleep(DETECT_MS);
+            pro->set_value(mock_detect(image));
+        });
+        return pro->get_future().share();
+    };
+}
+
+static FacePipeline::EmbedFunction mock_embedder(shared_ptr<MockDevice> device){
+    return [device](const vector<Arcface::commit_input>& faces){
+        vector<shared_ptr<promise<Arcface::feature>>> pros(faces.size());
+        vector<shared_future<Arcface::feature>> output(faces.size());
+        for(size_t i = 0; i < faces.size(); ++i){
+            pros[i]   = make_shared<promise<Arcface::feature>>();
+            output[i] = pros[i]->get_future().share();
+        }
+
+        // 一批人脸一次推理
+        device->submit([pros, faces](){
+            busy_sleep(EMBED_BATCH_MS + EMBED_FACE_MS * faces.size());
+            for(size_t i = 0; i < faces.size(); ++i)
+                pros[i]->set_value(mock_embed(get<0>(faces[i])));
+        });
+        return output;
+    };
+}
+
+static bool same_feature(const Arcface::feature& a, const Arcface::feature& b){
+    return a.cols == b.cols && memcmp(a.ptr<float>(0), b.ptr<float>(0), sizeof(float) * a.cols) == 0;
+}
+
+int app_face_pipeline_bench(){
+
+    vector<cv::Mat> frames(NUM_FRAMES);
+    cv::RNG rng(1234);
+    for(int i = 0; i < NUM_FRAMES; ++i){
+        frames[i].create(720, 1280, CV_8UC3);
+        rng.fill(frames[i], cv::RNG::UNIFORM, 0, 256);
+        frames[i].at<cv::Vec3b>(0, 0)[0] = i;
+    }
+
+    auto detect_device = make_shared<MockDevice>();
+    auto embed_device  = make_shared<MockDevice>();
+    auto detect = mock_detector(detect_device);
+    auto embed  = mock_embedder(embed_device);
+
+    // 逐个处理：检测、等待，每个人脸单独对齐、提交、等待，与app_arcface中的写法相同
+    vector<vector<Arcface::feature>> reference(NUM_FRAMES);
+    auto standard = Arcface::aligned_landmarks();
+    auto tic = iLogger::timestamp_now_float();
+    for(int i = 0; i < NUM_FRAMES; ++i){
+        auto faces = detect(frames[i]).get();
+        for(auto& face : faces){
+            Arcface::landmarks landmarks;
+            memcpy(landmarks.points, face.landmark, sizeof(landmarks.points));
+            auto crop = Arcface::face_alignment(frames[i], landmarks);
+            reference[i].emplace_back(embed({make_tuple(crop, standard)})[0].get());
+        }
+    }
+    double sequential_ms = iLogger::timestamp_now_float() - tic;
+    INFO("Sequential, %d frames x %d faces, %.2f ms, %.1f FPS", NUM_FRAMES, FACES_PER_FRAME, sequential_ms, NUM_FRAMES / (sequential_ms / 1000.0));
+
+    auto pipeline = FacePipeline::create_pipeline(detect, embed);
+    auto results  = pipeline->commits(frames);
+
+    int num_mismatch = 0;
+    for(int i = 0; i < NUM_FRAMES; ++i){
+        auto result = results[i].get();
+        if(result.faces.size() != reference[i].size()){
+            num_mismatch++;
+            continue;
+        }
+
+        for(size_t j = 0; j < result.faces.size(); ++j)
+            num_mismatch += !same_feature(result.faces[j].feature, reference[i][j]);
+    }
+
+    auto statistics = pipeline->statistics();
+    INFO("Pipeline,   %d frames x %d faces, %.1f FPS, %.2fx, mismatch %d", NUM_FRAMES, FACES_PER_FRAME, statistics.fps, statistics.fps / (NUM_FRAMES / (sequential_ms / 1000.0)), num_mismatch);
+    INFO("Per frame average, detect %.2f ms, align %.2f ms, embed %.2f ms, total %.2f ms",
+        statistics.average.detect, statistics.average.align, statistics.average.embed, statistics.average.total
+    );
+
+    // 单独测量一帧所有人脸的对齐：批量与逐个
+    auto faces = mock_detect(frames[0]);
+    vector<Arcface::landmarks> landmarks(faces.size());
+    for(size_t i = 0; i < faces.size(); ++i)
+        memcpy(landmarks[i].points, faces[i].landmark, sizeof(landmarks[i].points));
+
+    const int repeat = 200;
+    tic = iLogger::timestamp_now_float();
+    for(int n = 0; n < repeat; ++n){
+        for(auto& landmark : landmarks)
+            Arcface::face_alignment(frames[0], landmark);
+    }
+    double single_ms = (iLogger::timestamp_now_float() - tic) / repeat;
+
+    tic = iLogger::timestamp_now_float();
+    for(int n = 0; n < repeat; ++n)
+        Arcface::face_alignment(frames[0], landmarks);
+    double batch_ms = (iLogger::timestamp_now_float() - tic) / repeat;
+    INFO("Align %d faces, one by one %.3f ms, batched %.3f ms", (int)landmarks.size(), single_ms, batch_ms);
+    return 0;
+}
@@ -32,9 +32,11 @@ namespace FallGCN{
             p[i] /= total;
     }
 
+    static const int NUM_KEYPOINTS = 16;
+
     using ControllerImpl = InferController
     <
-        Input,                     // input
+        Sequence,                  // input
         tuple<FallState, float>,   // output
         tuple<string, int>         // start param
     >;
@@ -68,7 +70,14 @@ namespace FallGCN{
             int max_batch_size = engine->get_max_batch_size();
             auto input         = engine->input();
             auto output        = engine->output();
+            int sample_size    = input->count(1);
+            if(sample_size % (NUM_KEYPOINTS * 3) != 0){
+                INFOE("Input size %d is not a multiple of %d x 3", sample_size, NUM_KEYPOINTS);
+                result.set_value(false);
+                return;
+            }
 
+            window_size_      = sample_size / (NUM_KEYPOINTS * 3);
             tensor_allocator_ = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2);
             stream_           = engine->get_stream();
             result.set_value(true);
@@ -85,7 +94,10 @@ namespace FallGCN{
                     input->copy_from_gpu(input->offset(ibatch), job.mono_tensor->data()->gpu(), input->count(1));
                     job.mono_tensor->release();
                 }
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
 
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
                     
@@ -105,25 +117,42 @@ namespace FallGCN{
         }
 
         virtual shared_future<tuple<FallState, float>> commit(const Input& input) override{
-            return ControllerImpl::commit(input);
+            return ControllerImpl::commit(Sequence{input});
         }
 
         virtual vector<shared_future<tuple<FallState, float>>> commits(const vector<Input>& inputs) override{
-            return ControllerImpl::commits(inputs);
+            vector<Sequence> sequences;
+            sequences.reserve(inputs.size());
+            for(auto& input : inputs)
+                sequences.emplace_back(Sequence{input});
+            return ControllerImpl::commits(sequences);
         }
 
-        virtual bool preprocess(Job& job, const Input& input) override{
+        virtual vector<shared_future<tuple<FallState, float>>> commit_sequences(const vector<Sequence>& sequences) override{
+            return ControllerImpl::commits(sequences);
+        }
 
-            job.mono_tensor = tensor_allocator_->query();
-            if(job.mono_tensor == nullptr){
-                INFOE("Tensor allocator query failed.");
+        virtual int window_size() const override{
+            return window_size_;
+        }
+
+        virtual bool preprocess(Job& job, const Sequence& sequence) override{
+
+            if(sequence.empty()){
+                INFOE("Sequence is empty");
                 return false;
             }
 
-            auto& keys = get<0>(input);
-            auto& box  = get<1>(input);
-            if(keys.size() != 16){
-                INFOE("keys.size()[%d] != 16", keys.size());
+            for(auto& frame : sequence){
+                if(get<0>(frame).size() != NUM_KEYPOINTS){
+                    INFOE("keys.size()[%d] != %d", (int)get<0>(frame).size(), NUM_KEYPOINTS);
+                    return false;
+                }
+            }
+
+            job.mono_tensor = tensor_allocator_->query();
+            if(job.mono_tensor == nullptr){
+                INFOE("Tensor allocator query failed.");
                 return false;
             }
 
@@ -134,18 +163,25 @@ namespace FallGCN{
                 tensor->set_workspace(make_shared<TRT::MixMemory>());
             }
 
-            int num_points = keys.size();
             tensor->set_stream(stream_);
-            tensor->resize(1, num_points, 3);
+            tensor->resize(1, window_size_ * NUM_KEYPOINTS, 3);
 
             tensor->to_cpu(false);
             float* inptr = tensor->cpu<float>();
-            int box_max_line = max(box.width, box.height);
-            for(int i = 0; i < num_points; ++i, inptr += 3){
-                auto& point = keys[i];
-                inptr[0] = (point.x - box.x) / box_max_line - 0.5f;
-                inptr[1] = (point.y - box.y) / box_max_line - 0.5f;
-                inptr[2] = point.z;
+            int num_frames = sequence.size();
+            for(int t = 0; t < window_size_; ++t){
+
+                // 取最后window_size_帧，不足时前面重复最早的一帧
+                int iframe       = std::max(0, num_frames - window_size_ + t);
+                auto& keys       = get<0>(sequence[iframe]);
+                auto& box        = get<1>(sequence[iframe]);
+                int box_max_line = max(box.width, box.height);
+                for(int i = 0; i < NUM_KEYPOINTS; ++i, inptr += 3){
+                    auto& point = keys[i];
+                    inptr[0] = (point.x - box.x) / box_max_line - 0.5f;
+                    inptr[1] = (point.y - box.y) / box_max_line - 0.5f;
+                    inptr[2] = point.z;
+                }
             }
             tensor->to_gpu();
             return true;
@@ -153,6 +189,7 @@ namespace FallGCN{
 
     private:
         int gpuid_ = 0;
+        int window_size_ = 1;
         TRT::CUStream stream_ = nullptr;
     };
 
@@ -14,6 +14,9 @@ namespace FallGCN{
 
     typedef tuple<vector<Point3f>, Rect> Input;
 
+    // 一个人连续若干帧的姿态，按时间从早到晚，每帧的关键点用各自的框归一化
+    typedef vector<Input> Sequence;
+
     enum class FallState : int{
         Fall      = 0,
         Stand     = 1,
@@ -26,6 +29,11 @@ namespace FallGCN{
     public:
         virtual shared_future<tuple<FallState, float>> commit(const Input& input) = 0;
         virtual vector<shared_future<tuple<FallState, float>>> commits(const vector<Input>& inputs) = 0;
+
+        /* 模型一次输入的帧数为window_size()，由引擎输入的大小决定（window_size x 16 x 3）
+           序列不足window_size帧时用最早的一帧补齐，超过时取最后window_size帧 */
+        virtual vector<shared_future<tuple<FallState, float>>> commit_sequences(const vector<Sequence>& sequences) = 0;
+        virtual int window_size() const = 0;
     };
 
     shared_ptr<Infer> create_infer(const string& engine_file, int gpuid);
@@ -0,0 +1,175 @@
+
+#include "fall_tracker.hpp"
+#include <common/ilogger.hpp>
+#include <unordered_map>
+#include <cmath>
+
+namespace FallGCN{
+
+    // 固定大小的环形缓冲，保存一个轨迹最近的window帧
+    struct History{
+        vector<Input> frames;
+        int head  = 0;          // 最早一帧的位置
+        int count = 0;
+
+        vector<Point3f> inferred_keys;   // 上次推理时的关键点和框
+        Rect inferred_box;
+        shared_future<tuple<FallState, float>> result;
+        int skipped     = 0;
+        size_t last_seen = 0;
+
+        void push(const Input& input, int window){
+            if((int)frames.size() != window){
+                frames.resize(window);
+                head = count = 0;
+            }
+
+            if(count < window){
+                frames[(head + count) % window] = input;
+                count++;
+            }else{
+                frames[head] = input;
+                head = (head + 1) % window;
+            }
+        }
+
+        Sequence sequence() const{
+            Sequence output;
+            output.reserve(count);
+            for(int i = 0; i < count; ++i)
+                output.emplace_back(frames[(head + i) % frames.size()]);
+            return output;
+        }
+    };
+
+    class TrackerImpl : public Tracker{
+    public:
+        bool startup(const shared_ptr<Infer>& infer, const TrackerConfig& config){
+
+            if(infer == nullptr){
+                INFOE("Infer is nullptr");
+                return false;
+            }
+
+            infer_  = infer;
+            config_ = config;
+            window_ = std::max(1, infer->window_size());
+            return true;
+        }
+
+        virtual vector<TrackResult> update(const vector<TrackInput>& tracks) override{
+
+            frame_index_++;
+            vector<TrackResult> output(tracks.size());
+            vector<Sequence> sequences;
+            vector<int> inferred_index;
+            sequences.reserve(tracks.size());
+            inferred_index.reserve(tracks.size());
+
+            for(size_t i = 0; i < tracks.size(); ++i){
+                int id      = get<0>(tracks[i]);
+                auto& keys  = get<1>(tracks[i]);
+                auto& box   = get<2>(tracks[i]);
+                auto& item  = histories_[id];
+                item.last_seen = frame_index_;
+                item.push(make_tuple(keys, box), window_);
+                output[i].id = id;
+
+                if(item.result.valid() && item.skipped < config_.max_skip_frames && !moved(item, keys, box)){
+                    item.skipped++;
+                    output[i].skipped = true;
+                    output[i].result  = item.result;
+                    num_skipped_++;
+                    continue;
+                }
+
+                item.skipped       = 0;
+                item.inferred_keys = keys;
+                item.inferred_box  = box;
+                inferred_index.emplace_back(i);
+                sequences.emplace_back(item.sequence());
+            }
+
+            if(!sequences.empty()){
+                auto results = infer_->commit_sequences(sequences);
+                for(size_t i = 0; i < inferred_index.size(); ++i){
+                    int index = inferred_index[i];
+                    output[index].result = results[i];
+                    histories_[output[index].id].result = results[i];
+                }
+                num_inferred_ += sequences.size();
+            }
+
+            // 删除长时间没有出现的轨迹
+            for(auto iter = histories_.begin(); iter != histories_.end();){
+                if(frame_index_ - iter->second.last_seen > (size_t)config_.max_missing_frames)
+                    iter = histories_.erase(iter);
+                else
+                    ++iter;
+            }
+            return output;
+        }
+
+        virtual void clear() override{
+            histories_.clear();
+        }
+
+        virtual int window_size() const override{
+            return window_;
+        }
+
+        virtual TrackerStatistics statistics() const override{
+            TrackerStatistics output;
+            output.num_frames    = frame_index_;
+            output.num_inferred  = num_inferred_;
+            output.num_skipped   = num_skipped_;
+            output.num_histories = histories_.size();
+            return output;
+        }
+
+    private:
+        // 两帧的关键点分别用各自的框归一化后比较，框的平移和缩放不算作姿态变化
+        bool moved(const History& item, const vector<Point3f>& keys, const Rect& box) const{
+
+            if(config_.motion_threshold <= 0 || keys.size() != item.inferred_keys.size())
+                return true;
+
+            auto& last_box    = item.inferred_box;
+            float scale       = 1.0f / std::max(1, std::max(box.width, box.height));
+            float last_scale  = 1.0f / std::max(1, std::max(last_box.width, last_box.height));
+            float total       = 0;
+            int num_points    = 0;
+            for(size_t i = 0; i < keys.size(); ++i){
+                auto& a = keys[i];
+                auto& b = item.inferred_keys[i];
+                if(a.z < config_.min_confidence || b.z < config_.min_confidence) continue;
+
+                float dx = (a.x - box.x) * scale - (b.x - last_box.x) * last_scale;
+                float dy = (a.y - box.y) * scale - (b.y - last_box.y) * last_scale;
+                total += std::sqrt(dx * dx + dy * dy);
+                num_points++;
+            }
+
+            if(num_points == 0)
+                return true;
+            return total / num_points >= config_.motion_threshold;
+        }
+
+    private:
+        shared_ptr<Infer> infer_;
+        TrackerConfig config_;
+        int window_ = 1;
+        size_t frame_index_  = 0;
+        size_t num_inferred_ = 0;
+        size_t num_skipped_  = 0;
+        unordered_map<int, History> histories_;
+    };
+
+    shared_ptr<Tracker> create_tracker(const shared_ptr<Infer>& infer, const TrackerConfig& config){
+        shared_ptr<TrackerImpl> instance(new TrackerImpl());
+        if(!instance->startup(infer, config)){
+            instance.reset();
+        }
+        return instance;
+    }
+};
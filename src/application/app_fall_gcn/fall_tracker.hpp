@@ -0,0 +1,56 @@
+
+
+#ifndef FALL_TRACKER_HPP
+#define FALL_TRACKER_HPP
+
+#include "fall_gcn.hpp"
+
+/* 按DeepSORT的轨迹id保存每个人最近window_size帧的姿态
+   每帧调用一次update，传入这一帧所有确认的轨迹，需要推理的轨迹通过一次commit_sequences提交，组成一个batch
+   姿态与上次推理时相比几乎没有变化的轨迹跳过推理，直接返回上次的结果 */
+namespace FallGCN{
+
+    // DeepSORT的轨迹id，这一帧的关键点和框
+    typedef tuple<int, vector<Point3f>, Rect> TrackInput;
+
+    struct TrackerConfig{
+        // 关键点相对上次推理时的平均位移（以框的长边为1）小于它时跳过推理，<= 0时不跳过
+        float motion_threshold = 0.02f;
+
+        // 连续跳过这么多帧后强制推理一次
+        int max_skip_frames    = 10;
+
+        // 关键点置信度低于它时不参与位移的计算
+        float min_confidence   = 0.05f;
+
+        // 轨迹这么多帧没有出现在update中时删除它的历史
+        int max_missing_frames = 30;
+    };
+
+    struct TrackResult{
+        int id = 0;
+        bool skipped = false;   // 为true时result是上次推理的结果
+        shared_future<tuple<FallState, float>> result;
+    };
+
+    struct TrackerStatistics{
+        size_t num_frames    = 0;
+        size_t num_inferred  = 0;
+        size_t num_skipped   = 0;
+        size_t num_histories = 0;
+    };
+
+    class Tracker{
+    public:
+        // 返回与tracks一一对应的结果，所有需要推理的轨迹在一次commit_sequences中提交
+        virtual vector<TrackResult> update(const vector<TrackInput>& tracks) = 0;
+        virtual void clear() = 0;
+        virtual int window_size() const = 0;
+        virtual TrackerStatistics statistics() const = 0;
+    };
+
+    shared_ptr<Tracker> create_tracker(const shared_ptr<Infer>& infer, const TrackerConfig& config = TrackerConfig());
+
+}; // namespace FallGCN
+
+#endif // FALL_TRACKER_HPP
@@ -3,12 +3,14 @@
 #include <string.h>
 #include <opencv2/opencv.hpp>
 #include <builder/trt_builder.hpp>
+#include <builder/trt_compile_service.hpp>
 #include <infer/trt_infer.hpp>
 #include <common/ilogger.hpp>
 
 #include "app_yolo/yolo.hpp"
 #include "app_alphapose/alpha_pose.hpp"
 #include "app_fall_gcn/fall_gcn.hpp"
+#include "app_fall_gcn/fall_tracker.hpp"
 #include "tools/zmq_remote_show.hpp"
 #include "tools/deepsort.hpp"
 
@@ -21,26 +23,34 @@ static bool compile_models(){
 
     TRT::set_device(0);
     const char* onnx_files[]{"yolox_m", "sppe", "fall_bp"};
-    for(auto& name : onnx_files){
+
+    // 每帧所有人的姿态估计和跌倒识别各组成一个batch
+    const int max_batch_sizes[]{1, 16, 16};
+
+    // 三个模型并行编译，共享的timing cache保存在fall_recognize.timing.cache，再次编译时可以跳过tactic测速
+    auto service = TRT::create_compile_service(3, "fall_recognize.timing.cache");
+    if(service == nullptr) return false;
+
+    for(int i = 0; i < 3; ++i){
+        auto name = onnx_files[i];
         if(not requires(name))
             return false;
 
         string onnx_file = iLogger::format("%s.onnx", name);
         string model_file = iLogger::format("%s.FP32.trtmodel", name);
-        int test_batch_size = 1; 
+        int test_batch_size = max_batch_sizes[i]; 
         
         if(not iLogger::exists(model_file)){
-            bool ok = TRT::compile(
-                TRT::Mode::FP32,            // FP32、FP16、INT8
-                test_batch_size,            // max batch size
-                onnx_file,                  // source 
-                model_file                  // save to
-            );
-
-            if(!ok) return false;
+            TRT::CompileJob job;
+            job.name         = name;
+            job.mode         = TRT::Mode::FP32;     // FP32、FP16、INT8
+            job.maxBatchSize = test_batch_size;     // max batch size
+            job.source       = onnx_file;           // source
+            job.saveto       = model_file;          // save to
+            service->submit(job);
         }
     }
-    return true;
+    return service->wait_all();
 }
 
 int app_fall_recognize(){
@@ -57,6 +67,11 @@ int app_fall_recognize(){
     auto pose_model     = AlphaPose::create_infer(pose_model_file, 0);
     auto detector_model = Yolo::create_infer(detector_model_file, Yolo::Type::X, 0, 0.4f);
     auto gcn_model      = FallGCN::create_infer(gcn_model_file, 0);
+    auto fall_tracker   = FallGCN::create_tracker(gcn_model);
+    if(fall_tracker == nullptr){
+        INFOE("Create fall tracker failed");
+        return 0;
+    }
 
     Mat image;
     VideoCapture cap("exp/fall_video.mp4");
@@ -100,30 +115,42 @@ int app_fall_recognize(){
         }
         tracker->update(boxes);
 
-        auto final_objects = tracker->get_objects();
-        for(int i = 0; i < final_objects.size(); ++i){
-            auto& person = final_objects[i];
+        // 这一帧确认的轨迹一次提交姿态估计，再一次提交跌倒识别
+        vector<DeepSORT::TrackObject*> persons;
+        vector<AlphaPose::Input> pose_inputs;
+        for(auto& person : tracker->get_objects()){
             if(person->time_since_update() == 0 && person->state() == DeepSORT::State::Confirmed){
-                Rect box = DeepSORT::convert_box_to_rect(person->last_position());
-                auto keys   = pose_model->commit(make_tuple(image, box)).get();
-                auto statev = gcn_model->commit(make_tuple(keys, box)).get();
-
-                FallGCN::FallState state = get<0>(statev);
-                float confidence         = get<1>(statev);
-                const char* label_name   = FallGCN::state_name(state);
-                rectangle(image, DeepSORT::convert_box_to_rect(person->predict_box()), Scalar(0, 255, 0), 1);
-                rectangle(image, box, Scalar(0, 255, 255), 1);
-
-                auto line = person->trace_line();
-                for(int j = 0; j < (int)line.size() - 1; ++j){
-                    auto& p = line[j];
-                    auto& np = line[j + 1];
-                    cv::line(image, p, np, Scalar(255, 128, 60), 2, 16);
-                }
-
-                putText(image, iLogger::format("%d. [%s] %.2f %%", person->id(), label_name, confidence * 100), box.tl(), 0, 1, Scalar(0, 255, 0), 2, 16);
-                //INFO("Predict is [%s], %.2f %%", label_name, confidence * 100);
-           }
+                persons.emplace_back(person);
+                pose_inputs.emplace_back(image, DeepSORT::convert_box_to_rect(person->last_position()));
+            }
+        }
+
+        auto poses = pose_model->commits(pose_inputs);
+        vector<FallGCN::TrackInput> track_inputs(persons.size());
+        for(int i = 0; i < persons.size(); ++i)
+            track_inputs[i] = make_tuple(persons[i]->id(), poses[i].get(), get<1>(pose_inputs[i]));
+
+        auto states = fall_tracker->update(track_inputs);
+        for(int i = 0; i < persons.size(); ++i){
+            auto& person = persons[i];
+            Rect box     = get<1>(pose_inputs[i]);
+            auto statev  = states[i].result.get();
+
+            FallGCN::FallState state = get<0>(statev);
+            float confidence         = get<1>(statev);
+            const char* label_name   = FallGCN::state_name(state);
+            rectangle(image, DeepSORT::convert_box_to_rect(person->predict_box()), Scalar(0, 255, 0), 1);
+            rectangle(image, box, Scalar(0, 255, 255), 1);
+
+            auto line = person->trace_line();
+            for(int j = 0; j < (int)line.size() - 1; ++j){
+                auto& p = line[j];
+                auto& np = line[j + 1];
+                cv::line(image, p, np, Scalar(255, 128, 60), 2, 16);
+            }
+
+            putText(image, iLogger::format("%d. [%s] %.2f %%", person->id(), label_name, confidence * 100), box.tl(), 0, 1, Scalar(0, 255, 0), 2, 16);
+            //INFO("Predict is [%s], %.2f %%", label_name, confidence * 100);
         }
         //remote_show->post(image);
         //writer.write(image);
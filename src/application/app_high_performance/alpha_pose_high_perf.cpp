@@ -101,7 +101,10 @@ namespace AlphaPoseHighPerf{
                     job.mono_tensor->release();
                 }
                 
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
 
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
                     
@@ -175,7 +175,10 @@ namespace YoloHighPerf{
                     job.mono_tensor->release();
                 }
 
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
 
                 output_array_device.to_gpu(false);
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
@@ -0,0 +1,135 @@
+
+#include <common/ilogger.hpp>
+#include <onnx_optimizer/onnx_analyzer.hpp>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+using namespace std;
+
+static void print_usage(){
+    printf(
+        "Usage: ./pro onnx_analyze <model.onnx> [options]\n"
+        "    --sort by            order, flops, activation, weight or intensity, default flops\n"
+        "    --top N              print the top N nodes, <= 0 for all, default 20\n"
+        "    --json [file.json]   output JSON instead of text, nodes in --sort order, saved to file.json if given\n"
+        "    --batch N            batch size for dim 0 of the inputs, default 1\n"
+        "    --shape name=1,3,640,640\n"
+        "                         full shape of an input with other dynamic dims, can be repeated\n"
+    );
+}
+
+static bool parse_sort(const string& value, ONNXOptimizer::SortBy& by){
+
+    static const ONNXOptimizer::SortBy all_sorts[]{
+        ONNXOptimizer::SortBy::Order, ONNXOptimizer::SortBy::FLOPs, ONNXOptimizer::SortBy::Activation,
+        ONNXOptimizer::SortBy::Weight, ONNXOptimizer::SortBy::Intensity
+    };
+
+    for(auto item : all_sorts){
+        if(value == ONNXOptimizer::sort_by_name(item)){
+            by = item;
+            return true;
+        }
+    }
+    INFOE("Unknown sort %s", value.c_str());
+    return false;
+}
+
+static bool parse_shape(const string& value, ONNXOptimizer::AnalyzeOptions& options){
+
+    auto p = value.rfind('=');
+    if(p == string::npos || p == 0){
+        INFOE("Invalid shape %s, expect name=1,3,640,640", value.c_str());
+        return false;
+    }
+
+    vector<int64_t> dims;
+    for(auto& item : iLogger::split_string(value.substr(p + 1), ",")){
+        if(item.empty()) continue;
+
+        int64_t d = atoll(item.c_str());
+        if(d <= 0){
+            INFOE("Invalid dim %s in shape %s", item.c_str(), value.c_str());
+            return false;
+        }
+        dims.push_back(d);
+    }
+
+    if(dims.empty()){
+        INFOE("Empty shape %s", value.c_str());
+        return false;
+    }
+    options.input_shapes[value.substr(0, p)] = dims;
+    return true;
+}
+
+// 编译之前估计模型的FLOPs、激活和融合问题，返回0表示成功
+int app_onnx_analyze(int argc, char** argv){
+
+    vector<string> paths;
+    ONNXOptimizer::AnalyzeOptions options;
+    ONNXOptimizer::SortBy sort = ONNXOptimizer::SortBy::FLOPs;
+    int top          = 20;
+    bool json        = false;
+    string json_file;
+
+    for(int i = 0; i < argc; ++i){
+        const char* arg = argv[i];
+        bool has_value  = i + 1 < argc;
+        if(strcmp(arg, "--sort") == 0 && has_value){
+            if(!parse_sort(argv[++i], sort)){
+                print_usage();
+                return 2;
+            }
+        }
+        else if(strcmp(arg, "--shape") == 0 && has_value){
+            if(!parse_shape(argv[++i], options)){
+                print_usage();
+                return 2;
+            }
+        }
+        else if(strcmp(arg, "--top") == 0 && has_value)    top = atoi(argv[++i]);
+        else if(strcmp(arg, "--batch") == 0 && has_value)  options.batch_size = atoi(argv[++i]);
+        else if(strcmp(arg, "--json") == 0){
+            json = true;
+            if(has_value && argv[i + 1][0] != '-' && iLogger::end_with(argv[i + 1], ".json"))
+                json_file = argv[++i];
+        }
+        else if(arg[0] != '-')                             paths.emplace_back(arg);
+        else{
+            INFOE("Unknown option %s", arg);
+            print_usage();
+            return 2;
+        }
+    }
+
+    if(paths.size() != 1 || options.batch_size < 1){
+        print_usage();
+        return 2;
+    }
+
+    ONNXOptimizer::AnalysisReport report;
+    if(!ONNXOptimizer::analyze_file(paths[0], report, options)){
+        INFOE("Analyze %s failed", paths[0].c_str());
+        return 1;
+    }
+
+    if(!json){
+        printf("%s\n", report.text(sort, top).c_str());
+        return 0;
+    }
+
+    auto output = report.json(sort);
+    if(json_file.empty()){
+        printf("%s\n", output.c_str());
+        return 0;
+    }
+
+    if(!iLogger::save_file(json_file, output)){
+        INFOE("Save %s failed", json_file.c_str());
+        return 1;
+    }
+    INFO("Save report to %s", json_file.c_str());
+    return 0;
+}
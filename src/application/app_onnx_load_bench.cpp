@@ -0,0 +1,174 @@
+
+#include <common/ilogger.hpp>
+#include <onnx/onnx_pb.h>
+#include <NvInfer.h>
+#include <onnx_parser/NvOnnxParser.h>
+#include <functional>
+#include <memory>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// 构造num_weights个权重、每个weight_mb大小的模型，external = true时权重写入独立的weights.bin
+static bool make_synthetic_model(const string& onnx_file, int num_weights, int weight_mb, bool external){
+
+    onnx::ModelProto model;
+    model.set_ir_version(7);
+    model.add_opset_import()->set_version(11);
+
+    auto graph = model.mutable_graph();
+    size_t numel = (size_t)weight_mb * 1024 * 1024 / sizeof(float);
+    auto input = graph->add_input();
+    input->set_name("input");
+    auto input_type = input->mutable_type()->mutable_tensor_type();
+    input_type->set_elem_type(onnx::TensorProto::FLOAT);
+    input_type->mutable_shape()->add_dim()->set_dim_value(numel);
+
+    string weights_file = iLogger::directory(onnx_file) + "/weights.bin";
+    FILE* fweights = external ? fopen(weights_file.c_str(), "wb") : nullptr;
+    if(external && fweights == nullptr){
+        INFOE("Can not open %s", weights_file.c_str());
+        return false;
+    }
+
+    vector<float> values(numel);
+    string previous = "input";
+    for(int i = 0; i < num_weights; ++i){
+        for(size_t j = 0; j < numel; ++j)
+            values[j] = i + j * 1e-6f;
+
+        auto name = iLogger::format("w%d", i);
+        auto tensor = graph->add_initializer();
+        tensor->set_name(name);
+        tensor->set_data_type(onnx::TensorProto::FLOAT);
+        tensor->add_dims(numel);
+
+        if(external){
+            auto offset = ftell(fweights);
+            fwrite(values.data(), sizeof(float), numel, fweights);
+
+            tensor->set_data_location(onnx::TensorProto::EXTERNAL);
+            auto entry = tensor->add_external_data();
+            entry->set_key("location");
+            entry->set_value("weights.bin");
+            entry = tensor->add_external_data();
+            entry->set_key("offset");
+            entry->set_value(to_string(offset));
+            entry = tensor->add_external_data();
+            entry->set_key("length");
+            entry->set_value(to_string(numel * sizeof(float)));
+        }else{
+            tensor->set_raw_data(values.data(), numel * sizeof(float));
+        }
+
+        auto node = graph->add_node();
+        node->set_op_type("Add");
+        node->add_input(previous);
+        node->add_input(name);
+        node->add_output(iLogger::format("t%d", i));
+        previous = node->output(0);
+    }
+    graph->add_output()->set_name(previous);
+
+    if(fweights) fclose(fweights);
+
+    string data;
+    if(!model.SerializeToString(&data)) return false;
+    return iLogger::save_file(onnx_file, data);
+}
+
+class BenchLogger : public nvinfer1::ILogger{
+public:
+    virtual void log(Severity severity, const char* msg) noexcept override{
+        if(severity <= Severity::kERROR)
+            INFOE("NVInfer: %s", msg);
+    }
+};
+
+// 通过ModelImporter导入到network，与TRT::compile中的解析过程相同
+static bool import_model(const string& file, const vector<uint8_t>* data){
+
+    BenchLogger logger;
+    shared_ptr<nvinfer1::IBuilder> builder(nvinfer1::createInferBuilder(logger), [](nvinfer1::IBuilder* p){p->destroy();});
+    if(builder == nullptr) return false;
+
+    const auto explicit_batch = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
+    shared_ptr<nvinfer1::INetworkDefinition> network(builder->createNetworkV2(explicit_batch), [](nvinfer1::INetworkDefinition* p){p->destroy();});
+    shared_ptr<nvonnxparser::IParser> parser(nvonnxparser::createParser(*network, logger), [](nvonnxparser::IParser* p){p->destroy();});
+    if(parser == nullptr) return false;
+
+    bool ok = data ? parser->parseFromData(data->data(), data->size(), 1) : parser->parseFromFile(file.c_str(), 1);
+    return ok && network->getNbLayers() > 0;
+}
+
+// 每种方式在独立的子进程中运行，这样可以分别得到峰值内存，耗时通过管道传回
+static void run_case(const char* name, const function<bool()>& func){
+
+    int fds[2];
+    if(pipe(fds) != 0){
+        INFOE("Create pipe failed.");
+        return;
+    }
+
+    pid_t pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        auto tic = iLogger::timestamp_now_float();
+        double elapsed = func() ? iLogger::timestamp_now_float() - tic : -1;
+        write(fds[1], &elapsed, sizeof(elapsed));
+        _exit(0);
+    }
+
+    close(fds[1]);
+    double elapsed = -1;
+    read(fds[0], &elapsed, sizeof(elapsed));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    if(elapsed < 0){
+        INFOE("%s failed", iLogger::align_blank(name, 28).c_str());
+        return;
+    }
+    INFO("%s %.2f ms, peak rss = %.2f MB", iLogger::align_blank(name, 28).c_str(), elapsed, usage.ru_maxrss / 1024.0f);
+}
+
+int app_onnx_load_bench(){
+
+    string directory = "onnx_load_bench";
+    iLogger::mkdirs(directory);
+
+    const int num_weights = 16;
+    const int weight_mb   = 32;
+    string embedded_file  = directory + "/embedded.onnx";
+    string external_file  = directory + "/external.onnx";
+    if(!make_synthetic_model(embedded_file, num_weights, weight_mb, false) || !make_synthetic_model(external_file, num_weights, weight_mb, true)){
+        INFOE("Make synthetic model failed.");
+        return 0;
+    }
+
+    INFO("Synthetic model, %d weights x %d MB, embedded.onnx = %.2f MB, external.onnx = %.2f KB",
+        num_weights, weight_mb, iLogger::file_size(embedded_file) / 1024.0f / 1024.0f, iLogger::file_size(external_file) / 1024.0f
+    );
+
+    // 外部权重由parser直接引用映射，只有构建引擎时才会读入，峰值内存与权重大小无关
+    for(auto& file : {embedded_file, external_file}){
+        INFO("==================== %s ====================", file.c_str());
+        if(file == embedded_file){
+            run_case("load_file + parseFromData", [&](){
+                auto data = iLogger::load_file(file);
+                return import_model(file, &data);
+            });
+        }
+
+        run_case("parseFromFile (mmap)", [&](){
+            return import_model(file, nullptr);
+        });
+    }
+
+    iLogger::rmtree(directory);
+    return 0;
+}
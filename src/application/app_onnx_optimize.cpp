@@ -0,0 +1,93 @@
+
+#include <common/ilogger.hpp>
+#include <onnx_optimizer/onnx_optimizer.hpp>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+static void print_usage(){
+    printf(
+        "Usage: ./pro onnx_optimize <input.onnx> [output.onnx] [options]\n"
+        "    output               default is input with .opt.onnx suffix, e.g. yolox_s.opt.onnx\n"
+        "    --passes a,b,...     passes to run in order, default all:\n"
+        "                         ExporterCleanup,ConstantFolding,EliminateIdentity,ShapeSimplify,DeadNodeElimination\n"
+        "    --iterations N       max iterations, default 8\n"
+        "    --static-batch       treat dim 0 as static, only when the engine is compiled with a fixed batch\n"
+        "    --keep-doc-string    do not strip doc_string\n"
+    );
+}
+
+static bool parse_passes(const string& value, vector<ONNXOptimizer::Pass>& passes){
+
+    static const ONNXOptimizer::Pass all_passes[]{
+        ONNXOptimizer::Pass::ExporterCleanup, ONNXOptimizer::Pass::ConstantFolding, ONNXOptimizer::Pass::EliminateIdentity,
+        ONNXOptimizer::Pass::ShapeSimplify, ONNXOptimizer::Pass::DeadNodeElimination
+    };
+
+    passes.clear();
+    for(auto& name : iLogger::split_string(value, ",")){
+        if(name.empty()) continue;
+
+        bool found = false;
+        for(auto pass : all_passes){
+            if(iLogger::pattern_match(ONNXOptimizer::pass_name(pass), name.c_str())){
+                passes.push_back(pass);
+                found = true;
+                break;
+            }
+        }
+
+        if(!found){
+            INFOE("Unknown pass %s", name.c_str());
+            return false;
+        }
+    }
+    return !passes.empty();
+}
+
+// 优化后的onnx可以直接交给TRT::compile，返回0表示成功
+int app_onnx_optimize(int argc, char** argv){
+
+    vector<string> paths;
+    ONNXOptimizer::Options options;
+    for(int i = 0; i < argc; ++i){
+        const char* arg = argv[i];
+        bool has_value  = i + 1 < argc;
+        if(strcmp(arg, "--passes") == 0 && has_value){
+            if(!parse_passes(argv[++i], options.passes)){
+                print_usage();
+                return 2;
+            }
+        }
+        else if(strcmp(arg, "--iterations") == 0 && has_value)  options.max_iterations = atoi(argv[++i]);
+        else if(strcmp(arg, "--static-batch") == 0)             options.dynamic_batch = false;
+        else if(strcmp(arg, "--keep-doc-string") == 0)          options.strip_doc_string = false;
+        else if(arg[0] != '-')                                  paths.emplace_back(arg);
+        else{
+            INFOE("Unknown option %s", arg);
+            print_usage();
+            return 2;
+        }
+    }
+
+    if(paths.empty() || paths.size() > 2){
+        print_usage();
+        return 2;
+    }
+
+    string input  = paths[0];
+    string output = paths.size() > 1 ? paths[1] : iLogger::file_name(input, false) + ".opt.onnx";
+    if(paths.size() == 1){
+        auto p = input.rfind('/');
+        if(p != string::npos)
+            output = input.substr(0, p + 1) + output;
+    }
+
+    ONNXOptimizer::Report report;
+    if(!ONNXOptimizer::optimize_file(input, output, &report, options)){
+        INFOE("Optimize %s failed", input.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -11,16 +11,113 @@
 #include <app_alphapose/alpha_pose.hpp>
 #include <app_fall_gcn/fall_gcn.hpp>
 #include <app_centernet/centernet.hpp>
+#include <tools/mock_detector.hpp>
 #include <builder/trt_builder.hpp>
+#include <builder/trt_calibration_loader.hpp>
 #include <common/preprocess_kernel.cuh>
 #include <common/ilogger.hpp>
 #include <common/trt_tensor.hpp>
 #include <string>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <stddef.h>
 
 using namespace std;
 using namespace cv;
 namespace py = pybind11;
 
+// 通过buffer协议引用图像的数据，不复制。支持非owner的数组和ROI切片等行之间有间隔的数组，只要每行的像素是连续的
+// 像素不连续时（例如image[:, ::2]、image[..., ::-1]）复制为连续的数组
+// holder持有实际引用的数组，需要在持有GIL时调用。预处理在commit返回前已经把数据复制走，holder存活到commit返回即可
+static cv::Mat py_image_to_mat(const py::array& image, py::array& holder){
+
+	if(image.ndim() != 3 || image.shape(2) != 3 || !py::isinstance<py::array_t<unsigned char>>(image))
+		throw py::value_error("Image must be HxWx3 dtype=uint8 ndarray");
+
+	holder = image;
+	if(image.strides(2) != 1 || image.strides(1) != 3 || image.strides(0) < image.shape(1) * 3){
+		holder = py::array_t<unsigned char, py::array::c_style>::ensure(image);
+		if(!holder)
+			throw py::error_already_set();
+	}
+	return cv::Mat(holder.shape(0), holder.shape(1), CV_8UC3, (unsigned char*)holder.data(), (size_t)holder.strides(0));
+}
+
+// holder持有每个数组的引用，释放GIL期间其他线程修改list也不会释放图像的数据
+static vector<cv::Mat> py_images_to_mats(const py::list& images, vector<py::array>& holder){
+
+	vector<cv::Mat> output;
+	holder.resize(images.size());
+	output.reserve(images.size());
+	for(int i = 0; i < images.size(); ++i){
+		auto image = py::array::ensure(images[i]);
+		if(!image)
+			throw py::type_error("Images must be list of ndarray or buffer");
+
+		output.emplace_back(py_image_to_mat(image, holder[i]));
+	}
+	return output;
+}
+
+static Rect py_box_to_rect(const py::list& box){
+
+	if(box.size() != 4)
+		throw py::value_error("Box must be 4 number, left, top, right, bottom");
+
+	int left   = box[0].cast<float>();
+	int top    = box[1].cast<float>();
+	int right  = box[2].cast<float>();
+	int bottom = box[3].cast<float>();
+	return Rect(left, top, right-left, bottom-top);
+}
+
+// 释放GIL等待结果，等待期间其他python线程可以继续提交和处理
+template<typename _T>
+static _T wait_future(const shared_future<_T>& fut){
+	py::gil_scoped_release release;
+	return fut.get();
+}
+
+// 与ObjectDetector::Box的内存布局一致，BoxArray直接复制为一个结构化数组
+// dtype在解释器退出时可能已经无法释放，所以不析构
+static const py::dtype& object_box_dtype(){
+	typedef ObjectDetector::Box Box;
+	static py::dtype* dtype = new py::dtype(
+		py::list(py::make_tuple("left", "top", "right", "bottom", "confidence", "class_label")),
+		py::list(py::make_tuple("<f4", "<f4", "<f4", "<f4", "<f4", "<i4")),
+		py::list(py::make_tuple(
+			offsetof(Box, left), offsetof(Box, top), offsetof(Box, right), offsetof(Box, bottom), 
+			offsetof(Box, confidence), offsetof(Box, class_label)
+		)),
+		sizeof(Box)
+	);
+	return *dtype;
+}
+
+// 与FaceDetector::Box的内存布局一致，landmark为5x2
+static const py::dtype& face_box_dtype(){
+	typedef FaceDetector::Box Box;
+	static py::dtype* dtype = new py::dtype(
+		py::list(py::make_tuple("left", "top", "right", "bottom", "confidence", "landmark")),
+		py::list(py::make_tuple("<f4", "<f4", "<f4", "<f4", "<f4", "(5,2)<f4")),
+		py::list(py::make_tuple(
+			offsetof(Box, left), offsetof(Box, top), offsetof(Box, right), offsetof(Box, bottom), 
+			offsetof(Box, confidence), offsetof(Box, landmark)
+		)),
+		sizeof(Box)
+	);
+	return *dtype;
+}
+
+template<typename _BoxArray>
+static py::array boxes_to_array(const _BoxArray& boxes, const py::dtype& dtype){
+	return py::array(dtype, vector<int>{(int)boxes.size()}, boxes.data());
+}
+
 class YoloInfer { 
 public:
 	YoloInfer(string engine, Yolo::Type type, int device_id, float confidence_threshold, float nms_threshold){
@@ -43,13 +140,23 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
-
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
+		py::gil_scoped_release release;
 		return instance_->commit(cvimage);
 	}
 
+	vector<shared_future<ObjectDetector::BoxArray>> commits(const py::list& images){
+
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
+
+		vector<py::array> holder;
+		auto cvimages = py_images_to_mats(images, holder);
+		py::gil_scoped_release release;
+		return instance_->commits(cvimages);
+	}
+
 private:
 	shared_ptr<Yolo::Infer> instance_;
 }; 
@@ -75,13 +182,23 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
-
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
+		py::gil_scoped_release release;
 		return instance_->commit(cvimage);
 	}
 
+	vector<shared_future<ObjectDetector::BoxArray>> commits(const py::list& images){
+
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
+
+		vector<py::array> holder;
+		auto cvimages = py_images_to_mats(images, holder);
+		py::gil_scoped_release release;
+		return instance_->commits(cvimages);
+	}
+
 private:
 	shared_ptr<CenterNet::Infer> instance_;
 }; 
@@ -107,19 +224,27 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
-
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
+		py::gil_scoped_release release;
 		return instance_->commit(cvimage);
 	}
 
-	py::tuple crop_face_and_landmark(const py::array& image, const FaceDetector::Box& box, float scale_box){
+	vector<shared_future<FaceDetector::BoxArray>> commits(const py::list& images){
+
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
+
+		vector<py::array> holder;
+		auto cvimages = py_images_to_mats(images, holder);
+		py::gil_scoped_release release;
+		return instance_->commits(cvimages);
+	}
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
+	py::tuple crop_face_and_landmark(const py::array& image, const FaceDetector::Box& box, float scale_box){
 
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
 		auto output  = RetinaFace::crop_face_and_landmark(cvimage, box, scale_box);
 		auto crop    = get<0>(output);
 		auto py_crop = py::array(py::dtype("uint8"), vector<int>{crop.rows, crop.cols, 3}, crop.ptr<unsigned char>(0));
@@ -151,19 +276,27 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
-
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
+		py::gil_scoped_release release;
 		return instance_->commit(cvimage);
 	}
 
-	py::tuple crop_face_and_landmark(const py::array& image, const FaceDetector::Box& box, float scale_box){
+	vector<shared_future<FaceDetector::BoxArray>> commits(const py::list& images){
+
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
+		vector<py::array> holder;
+		auto cvimages = py_images_to_mats(images, holder);
+		py::gil_scoped_release release;
+		return instance_->commits(cvimages);
+	}
+
+	py::tuple crop_face_and_landmark(const py::array& image, const FaceDetector::Box& box, float scale_box){
 
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
 		auto output  = Scrfd::crop_face_and_landmark(cvimage, box, scale_box);
 		auto crop    = get<0>(output);
 		auto py_crop = py::array(py::dtype("uint8"), vector<int>{crop.rows, crop.cols, 3}, crop.ptr<unsigned char>(0));
@@ -193,30 +326,49 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(landmark.size() != 10)
-			throw py::buffer_error("landmark must 10 elements, x, y, x, y, x, y");
+		py::array holder;
+		auto input = make_tuple(py_image_to_mat(image, holder), to_landmarks(landmark));
+		py::gil_scoped_release release;
+		return instance_->commit(input);
+	}
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
+	vector<shared_future<Arcface::feature>> commits(const py::list& images, const py::list& landmarks){
 
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
-		Arcface::landmarks lmk;
-		memcpy(lmk.points, landmark.data(0), 10 * sizeof(float));
-		return instance_->commit(make_tuple(cvimage, lmk));
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
+
+		if(images.size() != landmarks.size())
+			throw py::value_error("Images and landmarks must have the same length");
+
+		vector<py::array> holder;
+		auto cvimages = py_images_to_mats(images, holder);
+		vector<Arcface::commit_input> inputs(cvimages.size());
+		for(int i = 0; i < cvimages.size(); ++i)
+			inputs[i] = make_tuple(cvimages[i], to_landmarks(landmarks[i].cast<py::array>()));
+
+		py::gil_scoped_release release;
+		return instance_->commits(inputs);
 	}
 
 	py::array face_alignment(const py::array& image, const py::array& landmark){
-		if(landmark.size() != 10)
-			throw py::buffer_error("landmark must 10 elements, x, y, x, y, x, y");
+		auto lmk = to_landmarks(landmark);
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
+		auto output = Arcface::face_alignment(cvimage, lmk);
+		return py::array(py::dtype("uint8"), vector<int>{output.rows, output.cols, 3}, output.ptr<unsigned char>(0));
+	}
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
+private:
+	// 切片、转置或者非float32的landmark先转换成连续的float32再拷贝
+	static Arcface::landmarks to_landmarks(const py::array& landmark){
+
+		auto contiguous = py::array_t<float, py::array::c_style | py::array::forcecast>::ensure(landmark);
+		if(!contiguous || contiguous.size() != 10)
+			throw py::buffer_error("landmark must 10 elements, x, y, x, y, x, y");
 
 		Arcface::landmarks lmk;
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
-		memcpy(lmk.points, landmark.data(0), 10 * sizeof(float));
-		auto output = Arcface::face_alignment(cvimage, lmk);
-		return py::array(py::dtype("uint8"), vector<int>{output.rows, output.cols, 3}, output.ptr<unsigned char>(0));
+		memcpy(lmk.points, contiguous.data(), 10 * sizeof(float));
+		return lmk;
 	}
 
 private:
@@ -242,20 +394,27 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(box.size() != 4)
-			throw py::value_error("Box must be 4 number, left, top, right, bottom");
+		py::array holder;
+		auto input = make_tuple(py_image_to_mat(image, holder), py_box_to_rect(box));
+		py::gil_scoped_release release;
+		return instance_->commit(input);
+	}
 
-		if(!image.owndata())
-			throw py::buffer_error("Image muse be owner, slice is unsupport, use image.copy() inside, image[1:-1, 1:-1] etc.");
+	// 同一张图上的多个人体框
+	vector<shared_future<vector<Point3f>>> commits(const py::array& image, const py::list& boxes){
 
-		cv::Mat cvimage(image.shape(0), image.shape(1), CV_8UC3, (unsigned char*)image.data(0));
-		int left   = box[0].cast<float>();
-		int top    = box[1].cast<float>();
-		int right  = box[2].cast<float>();
-		int bottom = box[3].cast<float>();
-		return instance_->commit(make_tuple(cvimage, Rect(
-			left, top, right-left, bottom-top
-		)));
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
+
+		py::array holder;
+		auto cvimage = py_image_to_mat(image, holder);
+		vector<AlphaPose::Input> inputs;
+		inputs.reserve(boxes.size());
+		for(auto box : boxes)
+			inputs.emplace_back(cvimage, py_box_to_rect(box.cast<py::list>()));
+
+		py::gil_scoped_release release;
+		return instance_->commits(inputs);
 	}
 
 private:
@@ -281,10 +440,32 @@ public:
 		if(!valid())
 			throw py::buffer_error("Invalid engine instance, please makesure your construct");
 
-		if(box.size() != 4)
-			throw py::value_error("Box must be 4 number, left, top, right, bottom");
+		auto input = make_tuple(to_points(keys), py_box_to_rect(box));
+		py::gil_scoped_release release;
+		return instance_->commit(input);
+	}
+
+	vector<shared_future<tuple<FallGCN::FallState, float>>> commits(const py::list& keys, const py::list& boxes){
+
+		if(!valid())
+			throw py::buffer_error("Invalid engine instance, please makesure your construct");
+
+		if(keys.size() != boxes.size())
+			throw py::value_error("Keys and boxes must have the same length");
+
+		vector<FallGCN::Input> inputs;
+		inputs.reserve(keys.size());
+		for(int i = 0; i < keys.size(); ++i)
+			inputs.emplace_back(to_points(keys[i].cast<py::array>()), py_box_to_rect(boxes[i].cast<py::list>()));
+
+		py::gil_scoped_release release;
+		return instance_->commits(inputs);
+	}
 
-		if(keys.size() != 16*3 || keys.shape(0) != 16 || keys.shape(1) != 3 || keys.dtype() != py::dtype::of<float>())
+private:
+	static vector<Point3f> to_points(const py::array& keys){
+
+		if(keys.ndim() != 2 || keys.shape(0) != 16 || keys.shape(1) != 3 || keys.dtype() != py::dtype::of<float>())
 			throw py::value_error("Keys must be 16x3 dtype=float32 ndarray");
 
 		vector<Point3f> points;
@@ -294,18 +475,167 @@ public:
 			float z = *(float*)keys.data(i, 2);
 			points.emplace_back(x, y, z);
 		}
-
-		int left   = box[0].cast<float>();
-		int top    = box[1].cast<float>();
-		int right  = box[2].cast<float>();
-		int bottom = box[3].cast<float>();
-		return instance_->commit(make_tuple(points, Rect(left, top, right-left, bottom-top)));
+		return points;
 	}
 
 private:
 	shared_ptr<FallGCN::Infer> instance_;
 }; 
 
+// asyncio的完成通知。C++线程等待shared_future，完成后通过post（loop.call_soon_threadsafe）唤醒事件循环，不需要轮询
+// 每个lane（一个检测器）一个等待线程，按提交顺序等待。检测器的worker按顺序完成任务，所以后面的任务不会被前面的阻塞太久
+// 一段时间内完成的任务只post一次，事件循环调用take取走所有完成的token。lane空闲时线程退出，下次watch时重新创建
+class AsyncNotifier { 
+public:
+	AsyncNotifier(const py::function& post):post_(post){}
+
+	virtual ~AsyncNotifier(){
+		close();
+	}
+
+	template<typename _T>
+	void watch(int64_t lane, int64_t token, const shared_future<_T>& fut){
+		push(lane, token, [fut](){fut.wait();});
+	}
+
+	vector<int64_t> take(){
+		unique_lock<mutex> l(lock_);
+		vector<int64_t> output;
+		output.swap(done_);
+		posted_ = false;
+		return output;
+	}
+
+	// 已经在等待的任务完成后等待线程退出，还没有开始等待的任务不再通知，由python的AsyncState.close给对应的future设置异常
+	void close(){
+		{
+			unique_lock<mutex> l(lock_);
+			if(closed_) return;
+			closed_ = true;
+		};
+
+		// 等待线程post时需要GIL
+		py::gil_scoped_release release;
+		for(auto& item : lanes_){
+			if(item.second->worker.joinable())
+				item.second->worker.join();
+		}
+	}
+
+private:
+	struct Lane{
+		queue<tuple<int64_t, function<void()>>> jobs;
+		bool running = false;
+		thread worker;
+	};
+
+	void push(int64_t lane, int64_t token, const function<void()>& wait){
+
+		unique_lock<mutex> l(lock_);
+		if(closed_)
+			throw py::value_error("AsyncNotifier is closed");
+
+		auto& item = lanes_[lane];
+		if(item == nullptr)
+			item.reset(new Lane());
+
+		item->jobs.emplace(token, wait);
+		if(!item->running){
+
+			// 上一个线程已经把running置为false，不会再访问lock_，可以直接join
+			if(item->worker.joinable())
+				item->worker.join();
+
+			item->running = true;
+			item->worker  = thread(&AsyncNotifier::lane_worker, this, item.get());
+		}
+	}
+
+	void lane_worker(Lane* lane){
+
+		while(true){
+			tuple<int64_t, function<void()>> job;
+			{
+				unique_lock<mutex> l(lock_);
+				if(lane->jobs.empty() || closed_){
+					lane->running = false;
+					return;
+				}
+
+				job = std::move(lane->jobs.front());
+				lane->jobs.pop();
+			};
+
+			get<1>(job)();
+			notify(get<0>(job));
+		}
+	}
+
+	void notify(int64_t token){
+
+		{
+			unique_lock<mutex> l(lock_);
+			done_.emplace_back(token);
+			if(posted_) return;
+			posted_ = true;
+		};
+
+		py::gil_scoped_acquire acquire;
+		try{
+			post_();
+		}catch(py::error_already_set& e){
+			INFOW("Post to event loop failed: %s", e.what());
+		}
+	}
+
+private:
+	py::function post_;
+	mutex lock_;
+	map<int64_t, shared_ptr<Lane>> lanes_;
+	vector<int64_t> done_;
+	bool posted_ = false;
+	bool closed_ = false;
+}; 
+
+// 不需要GPU和模型的模拟检测器（tools/mock_detector.hpp），用来测试python多线程调用时的扩展性
+// release_gil = false时持有GIL完成预处理并等待结果，等价于没有释放GIL的绑定
+class MockDetectorInfer { 
+public:
+	MockDetectorInfer(int max_batch_size, float infer_ms, int input_size, bool release_gil)
+	:release_gil_(release_gil){
+		instance_ = MockDetector::create_infer(max_batch_size, infer_ms, input_size);
+	}
+
+	shared_future<ObjectDetector::BoxArray> commit(const py::array& image){
+		py::array holder;
+		return submit({py_image_to_mat(image, holder)})[0];
+	}
+
+	vector<shared_future<ObjectDetector::BoxArray>> commits(const py::list& images){
+		vector<py::array> holder;
+		return submit(py_images_to_mats(images, holder));
+	}
+
+private:
+	// commits返回前完成预处理，之后不再访问holder引用的数据
+	vector<shared_future<ObjectDetector::BoxArray>> submit(const vector<cv::Mat>& images){
+
+		if(release_gil_){
+			py::gil_scoped_release release;
+			return instance_->commits(images);
+		}
+
+		auto output = instance_->commits(images);
+		for(auto& fut : output)
+			fut.wait();
+		return output;
+	}
+
+private:
+	shared_ptr<MockDetector::Infer> instance_;
+	bool release_gil_ = true;
+}; 
+
 static TRT::Int8Process g_int8_process_func;
 static bool compileTRT(
 	unsigned int max_batch_size,
@@ -403,17 +733,25 @@ static bool compileTRT(
 		tensor->synchronize();
 	};
 
+	// python的预处理函数需要GIL，不能在标定数据的预处理线程中调用
+	auto calibration_config = TRT::get_int8_calibration_config();
 	if(g_int8_process_func){
 		INFOV("Usage new process func");
 		int8process = g_int8_process_func;
+
+		auto sync_config = calibration_config;
+		sync_config.num_threads = 0;
+		TRT::set_thread_int8_calibration_config(&sync_config);
 	}
 
 	TRT::set_device(device_id);
-	return TRT::compile(
+	bool ok = TRT::compile(
 		mode, max_batch_size, source, saveto, trt_inputs_dims, 
 		int8process, int8_image_directory, 
 		int8_entropy_calibrator_file
 	);
+	TRT::set_thread_int8_calibration_config(nullptr);
+	return ok;
 }
 
 static void set_compile_hook_reshape_layer(const py::function& func){
@@ -464,6 +802,91 @@ template <class T, ptr_base base=ptr_base::host> class ptr_wrapper{
         T* ptr;
 };
 
+// DLPack的ABI（https://github.com/dmlc/dlpack），只定义用到的部分
+namespace DLPack{
+	enum DeviceType : int32_t{
+		CPU  = 1,
+		CUDA = 2
+	};
+
+	enum TypeCode : uint8_t{
+		Float = 2
+	};
+
+	struct Device{
+		int32_t device_type;
+		int32_t device_id;
+	};
+
+	struct DataType{
+		uint8_t code;
+		uint8_t bits;
+		uint16_t lanes;
+	};
+
+	struct Tensor{
+		void* data;
+		Device device;
+		int32_t ndim;
+		DataType dtype;
+		int64_t* shape;
+		int64_t* strides;
+		uint64_t byte_offset;
+	};
+
+	struct ManagedTensor{
+		Tensor dl_tensor;
+		void* manager_ctx;
+		void (*deleter)(ManagedTensor* self);
+	};
+};
+
+// 导出的DLPack张量持有TRT::Tensor的引用，直到消费者调用deleter
+struct DLPackContext{
+	shared_ptr<TRT::Tensor> tensor;
+	vector<int64_t> shape;
+	DLPack::ManagedTensor managed;
+};
+
+static bool tensor_on_device(const TRT::Tensor& tensor){
+	return tensor.head() == TRT::DataHead::Device;
+}
+
+// 数据在GPU上时导出显存，否则导出内存，不复制
+static py::capsule tensor_to_dlpack(const shared_ptr<TRT::Tensor>& tensor){
+
+	bool on_device = tensor_on_device(*tensor);
+	void* data     = on_device ? tensor->gpu() : tensor->cpu();
+
+	// DLPack不表达数据所在的流，导出前同步tensor的流
+	tensor->synchronize();
+
+	auto ctx    = new DLPackContext();
+	ctx->tensor = tensor;
+	ctx->shape.assign(tensor->dims().begin(), tensor->dims().end());
+
+	auto& dl       = ctx->managed.dl_tensor;
+	dl.data        = data;
+	dl.device      = {on_device ? DLPack::CUDA : DLPack::CPU, on_device ? TRT::get_device() : 0};
+	dl.ndim        = ctx->shape.size();
+	dl.dtype       = {DLPack::Float, (uint8_t)(tensor->element_size() * 8), 1};
+	dl.shape       = ctx->shape.data();
+	dl.strides     = nullptr;
+	dl.byte_offset = 0;
+	ctx->managed.manager_ctx = ctx;
+	ctx->managed.deleter     = [](DLPack::ManagedTensor* self){
+		delete (DLPackContext*)self->manager_ctx;
+	};
+
+	// 被消费后capsule会改名为used_dltensor，只有没被消费时才在这里释放
+	return py::capsule(&ctx->managed, "dltensor", [](PyObject* capsule){
+		if(PyCapsule_IsValid(capsule, "dltensor")){
+			auto managed = (DLPack::ManagedTensor*)PyCapsule_GetPointer(capsule, "dltensor");
+			managed->deleter(managed);
+		}
+	});
+}
+
 PYBIND11_MODULE(libtrtpyc, m) {
 	py::class_<ObjectDetector::Box>(m, "ObjectBox")
 		.def_property("left",        [](ObjectDetector::Box& self){return self.left;}, [](ObjectDetector::Box& self, float nv){self.left = nv;})
@@ -499,21 +922,37 @@ PYBIND11_MODULE(libtrtpyc, m) {
 			);	
 		});
 
+	// get返回Box对象的list，get_array返回一个结构化数组，等待结果时都不持有GIL
+	m.attr("object_box_dtype") = object_box_dtype();
+	m.attr("face_box_dtype")   = face_box_dtype();
+
 	py::class_<shared_future<ObjectDetector::BoxArray>>(m, "SharedFutureObjectBoxArray")
-		.def("get", &shared_future<ObjectDetector::BoxArray>::get);
+		.def("get", [](shared_future<ObjectDetector::BoxArray>& self){return wait_future(self);})
+		.def("get_array", [](shared_future<ObjectDetector::BoxArray>& self){
+			return boxes_to_array(wait_future(self), object_box_dtype());
+		})
+		.def("ready", [](shared_future<ObjectDetector::BoxArray>& self){
+			return self.wait_for(chrono::seconds(0)) == future_status::ready;
+		});
 
 	py::class_<shared_future<FaceDetector::BoxArray>>(m, "SharedFutureFaceBoxArray")
-		.def("get", &shared_future<FaceDetector::BoxArray>::get);
+		.def("get", [](shared_future<FaceDetector::BoxArray>& self){return wait_future(self);})
+		.def("get_array", [](shared_future<FaceDetector::BoxArray>& self){
+			return boxes_to_array(wait_future(self), face_box_dtype());
+		})
+		.def("ready", [](shared_future<FaceDetector::BoxArray>& self){
+			return self.wait_for(chrono::seconds(0)) == future_status::ready;
+		});
 
 	py::class_<shared_future<Arcface::feature>>(m, "SharedFutureArcfaceFeature")
 		.def("get", [](shared_future<Arcface::feature>& self){
-			auto feat = self.get();
+			auto feat = wait_future(self);
 			return py::array(py::dtype("float32"), vector<int>{1, feat.cols}, feat.ptr<float>(0));
 		});
 
 	py::class_<shared_future<vector<Point3f>>>(m, "SharedFutureAlphaPosePoints")
 		.def("get", [](shared_future<vector<Point3f>>& self){
-			auto points = self.get();
+			auto points = wait_future(self);
 			return py::array(py::dtype("float32"), vector<int>{(int)points.size(), 3}, (float*)points.data());
 		});
 
@@ -524,7 +963,7 @@ PYBIND11_MODULE(libtrtpyc, m) {
 
 	py::class_<shared_future<tuple<FallGCN::FallState, float>>>(m, "SharedFutureFallState")
 		.def("get", [](shared_future<tuple<FallGCN::FallState, float>>& self){
-			auto state = self.get();
+			auto state = wait_future(self);
 			return py::make_tuple(get<0>(state), get<1>(state));
 		});
 
@@ -587,7 +1026,8 @@ PYBIND11_MODULE(libtrtpyc, m) {
 			py::arg("nms_threshold")=0.5f
 		)
 		.def_property_readonly("valid", &YoloInfer::valid, "Infer is valid")
-		.def("commit", &YoloInfer::commit, py::arg("image"));
+		.def("commit", &YoloInfer::commit, py::arg("image"))
+		.def("commits", &YoloInfer::commits, py::arg("images"));
 
 	py::class_<CenterNetInfer>(m, "CenterNet")
 		.def(py::init<string, int, float, float>(), 
@@ -597,7 +1037,8 @@ PYBIND11_MODULE(libtrtpyc, m) {
 			py::arg("nms_threshold")=0.5f
 		)
 		.def_property_readonly("valid", &CenterNetInfer::valid, "Infer is valid")
-		.def("commit", &CenterNetInfer::commit, py::arg("image"));
+		.def("commit", &CenterNetInfer::commit, py::arg("image"))
+		.def("commits", &CenterNetInfer::commits, py::arg("images"));
 
 	py::class_<RetinafaceInfer>(m, "Retinaface")
 		.def(py::init<string, int, float, float>(), 
@@ -608,6 +1049,7 @@ PYBIND11_MODULE(libtrtpyc, m) {
 		)
 		.def_property_readonly("valid", &RetinafaceInfer::valid, "Infer is valid")
 		.def("commit", &RetinafaceInfer::commit, py::arg("image"))
+		.def("commits", &RetinafaceInfer::commits, py::arg("images"))
 		.def("crop_face_and_landmark", &RetinafaceInfer::crop_face_and_landmark, py::arg("image"), py::arg("Box"), py::arg("scale_box")=1.5f);
 
 	py::class_<ScrfdInfer>(m, "Scrfd")
@@ -619,6 +1061,7 @@ PYBIND11_MODULE(libtrtpyc, m) {
 		)
 		.def_property_readonly("valid", &ScrfdInfer::valid, "Infer is valid")
 		.def("commit", &ScrfdInfer::commit, py::arg("image"))
+		.def("commits", &ScrfdInfer::commits, py::arg("images"))
 		.def("crop_face_and_landmark", &ScrfdInfer::crop_face_and_landmark, py::arg("image"), py::arg("Box"), py::arg("scale_box")=1.5f);
 
 	py::class_<ArcfaceInfer>(m, "Arcface")
@@ -628,6 +1071,7 @@ PYBIND11_MODULE(libtrtpyc, m) {
 		)
 		.def_property_readonly("valid", &ArcfaceInfer::valid, "Infer is valid")
 		.def("commit", &ArcfaceInfer::commit, py::arg("image"), py::arg("landmark"))
+		.def("commits", &ArcfaceInfer::commits, py::arg("images"), py::arg("landmarks"))
 		.def("face_alignment", &ArcfaceInfer::face_alignment, py::arg("image"), py::arg("landmark"));
 
 	py::class_<AlphaPoseInfer>(m, "AlphaPose")
@@ -636,7 +1080,8 @@ PYBIND11_MODULE(libtrtpyc, m) {
 			py::arg("device_id")=0
 		)
 		.def_property_readonly("valid", &AlphaPoseInfer::valid, "Infer is valid")
-		.def("commit", &AlphaPoseInfer::commit, py::arg("image"), py::arg("box"));
+		.def("commit", &AlphaPoseInfer::commit, py::arg("image"), py::arg("box"))
+		.def("commits", &AlphaPoseInfer::commits, py::arg("image"), py::arg("boxes"));
 
 	py::class_<FallInfer>(m, "Fall")
 		.def(py::init<string, int>(), 
@@ -644,7 +1089,28 @@ PYBIND11_MODULE(libtrtpyc, m) {
 			py::arg("device_id")=0
 		)
 		.def_property_readonly("valid", &FallInfer::valid, "Infer is valid")
-		.def("commit", &FallInfer::commit, py::arg("keys"), py::arg("box"));
+		.def("commit", &FallInfer::commit, py::arg("keys"), py::arg("box"))
+		.def("commits", &FallInfer::commits, py::arg("keys"), py::arg("boxes"));
+
+	py::class_<MockDetectorInfer>(m, "MockDetector")
+		.def(py::init<int, float, int, bool>(), 
+			py::arg("max_batch_size")=16, 
+			py::arg("infer_ms")=5.0f, 
+			py::arg("input_size")=640, 
+			py::arg("release_gil")=true
+		)
+		.def("commit", &MockDetectorInfer::commit, py::arg("image"))
+		.def("commits", &MockDetectorInfer::commits, py::arg("images"));
+
+	py::class_<AsyncNotifier>(m, "AsyncNotifier")
+		.def(py::init<py::function>(), py::arg("post"))
+		.def("watch", &AsyncNotifier::watch<ObjectDetector::BoxArray>,             py::arg("lane"), py::arg("token"), py::arg("future"))
+		.def("watch", &AsyncNotifier::watch<FaceDetector::BoxArray>,               py::arg("lane"), py::arg("token"), py::arg("future"))
+		.def("watch", &AsyncNotifier::watch<Arcface::feature>,                     py::arg("lane"), py::arg("token"), py::arg("future"))
+		.def("watch", &AsyncNotifier::watch<vector<Point3f>>,                      py::arg("lane"), py::arg("token"), py::arg("future"))
+		.def("watch", &AsyncNotifier::watch<tuple<FallGCN::FallState, float>>,     py::arg("lane"), py::arg("token"), py::arg("future"))
+		.def("take", &AsyncNotifier::take)
+		.def("close", &AsyncNotifier::close);
 
 	py::enum_<TRT::ModelSourceType>(m, "ModelSourceType")
 		.value("OnnX", TRT::ModelSourceType::OnnX)
@@ -771,6 +1237,25 @@ PYBIND11_MODULE(libtrtpyc, m) {
 			self.reference_data(shape, (void*)cpu, cpu_size, (void*)gpu, gpu_size, TRT::DataType::Float);
 		})
 		.def_property_readonly("dtype", [](TRT::Tensor& self){return self.type();})
+
+		// numpy.asarray(tensor)不复制，数据在GPU上时先复制到内存
+		.def_property_readonly("__array_interface__", [](TRT::Tensor& self){
+			py::dict output;
+			output["shape"]   = py::tuple(py::cast(self.dims()));
+			output["typestr"] = py::str(self.type() == TRT::DataType::Float16 ? "<f2" : "<f4");
+			output["data"]    = py::make_tuple((uint64_t)self.cpu(), false);
+			output["version"] = 3;
+			return output;
+		})
+
+		// torch.from_dlpack(tensor)等不复制，数据留在原来的设备上
+		.def("__dlpack__", [](shared_ptr<TRT::Tensor>& self, py::object stream){
+			return tensor_to_dlpack(self);
+		}, py::arg("stream")=py::none())
+		.def("__dlpack_device__", [](TRT::Tensor& self){
+			bool on_device = tensor_on_device(self);
+			return py::make_tuple((int)(on_device ? DLPack::CUDA : DLPack::CPU), on_device ? TRT::get_device() : 0);
+		})
 		.def("__repr__", [](TRT::Tensor& self){
 			return iLogger::format(
 				"<Tensor shape=%s, head=%s, dtype=%s, this=%p>", 
@@ -0,0 +1,131 @@
+
+#include <builder/trt_builder.hpp>
+#include <builder/trt_engine_cache.hpp>
+#include <infer/trt_infer.hpp>
+#include <common/ilogger.hpp>
+#include "app_yolo/yolo.hpp"
+#include "tools/zmq_remote_infer.hpp"
+#include "tools/mock_detector.hpp"
+#include <thread>
+#include <mutex>
+#include <algorithm>
+
+using namespace std;
+
+bool requires(const char* name);
+
+static double percentile(const vector<double>& sorted_values, float p){
+    if(sorted_values.empty()) return 0;
+    int index = std::min((int)sorted_values.size() - 1, (int)(sorted_values.size() * p));
+    return sorted_values[index];
+}
+
+// num_clients个客户端各自在独立的线程中提交，每个客户端同时有inflight个请求，统计客户端看到的延迟
+static void run_case(const char* name, RemoteInfer::Encoding encoding, int num_clients, int inflight, int requests_per_client){
+
+    const char* url = "tcp://127.0.0.1:15561";
+    auto detector   = MockDetector::create_infer(16, 5.0f, 640);
+    auto server     = RemoteInfer::create_server(url, detector, 4);
+    if(server == nullptr){
+        INFOE("Create server failed");
+        return;
+    }
+
+    cv::Mat image(720, 1280, CV_8UC3, cv::Scalar(0, 128, 255));
+    mutex latency_lock;
+    vector<double> latencies;
+    int num_wrong = 0;
+
+    auto client_thread = [&](){
+
+        auto client = RemoteInfer::create_client(url, encoding);
+        if(client == nullptr){
+            INFOE("Create client failed");
+            return;
+        }
+
+        vector<double> local;
+        int local_wrong = 0;
+        for(int i = 0; i < requests_per_client; i += inflight){
+            vector<double> ticks;
+            vector<shared_future<ObjectDetector::BoxArray>> futures;
+            for(int j = 0; j < inflight; ++j){
+                ticks.push_back(iLogger::timestamp_now_float());
+                futures.emplace_back(client->commit(image));
+            }
+
+            for(int j = 0; j < inflight; ++j){
+                auto boxes = futures[j].get();
+                local.push_back(iLogger::timestamp_now_float() - ticks[j]);
+                if(boxes.size() != 1 || boxes[0].right != image.cols || boxes[0].bottom != image.rows)
+                    local_wrong++;
+            }
+        }
+
+        unique_lock<mutex> l(latency_lock);
+        latencies.insert(latencies.end(), local.begin(), local.end());
+        num_wrong += local_wrong;
+    };
+
+    auto tic = iLogger::timestamp_now_float();
+    vector<thread> clients;
+    for(int i = 0; i < num_clients; ++i)
+        clients.emplace_back(client_thread);
+
+    for(auto& t : clients)
+        t.join();
+    double elapsed = iLogger::timestamp_now_float() - tic;
+
+    std::sort(latencies.begin(), latencies.end());
+    INFO(
+        "%s %.0f req/s, latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms, max batch %d, wrong %d, failed %d",
+        iLogger::align_blank(name, 28).c_str(), latencies.size() / (elapsed / 1000.0),
+        percentile(latencies, 0.5f), percentile(latencies, 0.9f), percentile(latencies, 0.99f), percentile(latencies, 1.0f),
+        detector->max_batch(), num_wrong, (int)server->num_failed()
+    );
+}
+
+int app_remote_infer_bench(){
+
+    // 不需要GPU，服务端使用CPU模拟的检测器，推理一个batch耗时5ms
+    run_case("1 client, raw", RemoteInfer::Encoding::Raw, 1, 1, 300);
+    run_case("8 clients, raw", RemoteInfer::Encoding::Raw, 8, 1, 300);
+    run_case("8 clients x 4 inflight, raw", RemoteInfer::Encoding::Raw, 8, 4, 300);
+    run_case("8 clients, jpeg", RemoteInfer::Encoding::Jpeg, 8, 1, 300);
+    return 0;
+}
+
+// 服务端进程加载一次engine，其它进程通过RemoteInfer::create_client使用
+int app_remote_infer_server(){
+
+    int deviceid = 0;
+    const char* name = "yolox_s";
+    if(not requires(name))
+        return 0;
+
+    TRT::set_device(deviceid);
+    auto engine_cache = TRT::create_engine_cache("engine_cache", 4ull << 30, TRT::current_platform(deviceid));
+    if(engine_cache == nullptr)
+        return 0;
+
+    string model_file = engine_cache->get_or_compile(TRT::Mode::FP32, 16, iLogger::format("%s.onnx", name));
+    if(model_file.empty()){
+        INFOE("Compile %s failed.", name);
+        return 0;
+    }
+
+    auto yolo = Yolo::create_infer(model_file, Yolo::Type::X, deviceid, 0.25f, 0.5f);
+    if(yolo == nullptr){
+        INFOE("Engine is nullptr");
+        return 0;
+    }
+
+    auto server = RemoteInfer::create_server("tcp://0.0.0.0:15560", yolo);
+    if(server == nullptr)
+        return 0;
+
+    INFO("Remote infer server started at tcp://0.0.0.0:15560, press Ctrl+C to exit");
+    iLogger::while_loop();
+    INFO("Served %d requests, %d failed", (int)server->num_requests(), (int)server->num_failed());
+    return 0;
+}
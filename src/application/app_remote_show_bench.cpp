@@ -0,0 +1,82 @@
+
+#include <common/ilogger.hpp>
+#include "tools/zmq_remote_show.hpp"
+#include "tools/zmq_u.hpp"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+// 模拟推理循环以最快速度post，接收端每帧耗时display_ms（模拟显示），统计调用方的耗时和丢帧
+static void run_case(const char* name, float scale, float display_ms, int num_frames){
+
+    // inproc地址在socket关闭后异步释放，每个case使用不同的地址
+    static int index = 0;
+    auto url = iLogger::format("inproc://remote_show_bench%d", index++);
+    auto remote_show = create_zmq_remote_show(url.c_str(), 90, scale);
+    if(remote_show == nullptr){
+        INFOE("Create remote show failed");
+        return;
+    }
+
+    zmq::socket_t receiver(zmq_shared_context(), zmq::socket_type::sub);
+    receiver.set(zmq::sockopt::subscribe, "");
+    receiver.set(zmq::sockopt::rcvtimeo, 100);
+    receiver.connect(url);
+
+    // 等待订阅生效，否则开始的几帧会被PUB丢弃
+    this_thread::sleep_for(chrono::milliseconds(100));
+
+    atomic<bool> run{true};
+    size_t num_received = 0, received_bytes = 0;
+    thread receive_thread([&](){
+        while(run){
+            zmq::message_t message;
+            if(!receiver.recv(message)) continue;
+
+            num_received++;
+            received_bytes += message.size();
+            this_thread::sleep_for(chrono::microseconds((int)(display_ms * 1000)));
+        }
+    });
+
+    vector<cv::Mat> images(4);
+    for(size_t i = 0; i < images.size(); ++i)
+        images[i] = cv::Mat(720, 1280, CV_8UC3, cv::Scalar(i * 60, 128, 255 - i * 60));
+
+    double total_post_ms = 0, max_post_ms = 0;
+    auto begin = iLogger::timestamp_now_float();
+    for(int i = 0; i < num_frames; ++i){
+
+        // 推理耗时约2ms
+        this_thread::sleep_for(chrono::milliseconds(2));
+
+        auto tic = iLogger::timestamp_now_float();
+        remote_show->post(images[i % images.size()]);
+        double post_ms = iLogger::timestamp_now_float() - tic;
+        total_post_ms += post_ms;
+        max_post_ms    = std::max(max_post_ms, post_ms);
+    }
+    double elapsed = iLogger::timestamp_now_float() - begin;
+
+    this_thread::sleep_for(chrono::milliseconds(300));
+    run = false;
+    receive_thread.join();
+
+    INFO(
+        "%s loop %.2f fps, post avg %.3f ms, max %.3f ms, sent %d, dropped %d, received %d, %.1f KB/frame",
+        iLogger::align_blank(name, 24).c_str(), num_frames / (elapsed / 1000.0), total_post_ms / num_frames, max_post_ms,
+        (int)remote_show->num_sent(), (int)remote_show->num_dropped(), (int)num_received,
+        num_received > 0 ? received_bytes / (double)num_received / 1024.0 : 0.0
+    );
+}
+
+int app_remote_show_bench(){
+
+    int num_frames = 500;
+    run_case("fast receiver", 1.0f, 0, num_frames);
+    run_case("slow receiver 30ms", 1.0f, 30, num_frames);
+    run_case("slow receiver, scale 0.5", 0.5f, 30, num_frames);
+    return 0;
+}
@@ -0,0 +1,133 @@
+
+#include <common/ilogger.hpp>
+#include "tools/zmq_result_stream.hpp"
+#include "tools/zmq_remote_show.hpp"
+#include "tools/zmq_u.hpp"
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+struct FrameResults{
+    ObjectDetector::BoxArray objects;
+    FaceDetector::BoxArray faces;
+    vector<DeepSORT::TrackObject*> tracks;
+    vector<vector<cv::Point3f>> poses;
+    vector<int> pose_owners;
+};
+
+// 接收端统计收到的帧数、按frame_id统计丢失的帧，并检查内容与发送的一致
+static void run_case(const char* name, const char* url, ResultStream::Mode mode, const FrameResults& results, int num_frames){
+
+    auto publisher = ResultStream::create_publisher(url, 1000, mode);
+    if(publisher == nullptr){
+        INFOE("Create publisher failed");
+        return;
+    }
+
+    auto type = mode == ResultStream::Mode::Push ? zmq::socket_type::pull : zmq::socket_type::sub;
+    zmq::socket_t receiver(zmq_shared_context(), type);
+    if(mode == ResultStream::Mode::Publish)
+        receiver.set(zmq::sockopt::subscribe, "");
+    receiver.set(zmq::sockopt::rcvhwm, 1000);
+    receiver.set(zmq::sockopt::rcvtimeo, 200);
+    receiver.connect(url);
+
+    // 等待连接和订阅生效
+    this_thread::sleep_for(chrono::milliseconds(200));
+
+    atomic<bool> run{true};
+    int num_received = 0, num_invalid = 0, num_lost = 0;
+    double receive_ms = 0;
+    thread receive_thread([&](){
+        ResultStream::Frame frame;
+        int64_t last_frame_id = -1;
+        double first_tick = 0;
+        while(run){
+            zmq::message_t message;
+            if(!receiver.recv(message)) continue;
+
+            if(num_received == 0) first_tick = iLogger::timestamp_now_float();
+            num_received++;
+            receive_ms = iLogger::timestamp_now_float() - first_tick;
+
+            if(!ResultStream::parse(message.data(), message.size(), frame) ||
+                frame.objects.size() != results.objects.size() ||
+                frame.faces.size() != results.faces.size() ||
+                frame.pose_owners.size() != results.poses.size() ||
+                frame.objects[0].class_label != results.objects[0].class_label){
+                num_invalid++;
+                continue;
+            }
+
+            if(last_frame_id != -1)
+                num_lost += frame.frame_id - last_frame_id - 1;
+            last_frame_id = frame.frame_id;
+        }
+    });
+
+    auto tic = iLogger::timestamp_now_float();
+    for(int i = 0; i < num_frames; ++i){
+        publisher->begin_frame(i);
+        publisher->add(results.objects);
+        publisher->add(results.faces);
+        publisher->add(results.tracks);
+        publisher->add(results.poses, results.pose_owners);
+        publisher->end_frame();
+    }
+    double publish_ms = iLogger::timestamp_now_float() - tic;
+
+    this_thread::sleep_for(chrono::milliseconds(500));
+    run = false;
+    receive_thread.join();
+
+    size_t num_sent = publisher->num_sent();
+    INFO(
+        "%s publish %.0f msg/s, %d bytes/frame, sent %d, dropped %d | received %d, lost %d, invalid %d, %.0f msg/s",
+        iLogger::align_blank(name, 16).c_str(), num_frames / (publish_ms / 1000.0),
+        num_sent > 0 ? (int)(publisher->num_bytes() / num_sent) : 0, (int)num_sent, (int)publisher->num_dropped(),
+        num_received, num_lost, num_invalid, receive_ms > 0 ? num_received / (receive_ms / 1000.0) : 0.0
+    );
+}
+
+int app_result_stream_bench(){
+
+    // 典型的一帧：32个目标、4个人脸、16个跟踪目标及其17点姿态
+    FrameResults results;
+    DeepSORT::BBoxes track_boxes;
+    for(int i = 0; i < 32; ++i){
+        float x = i * 30, y = i * 10;
+        results.objects.emplace_back(x, y, x + 50, y + 120, 0.9f, i % 4);
+        if(i < 16)
+            track_boxes.emplace_back(x, y, x + 50, y + 120);
+    }
+
+    for(int i = 0; i < 4; ++i){
+        FaceDetector::Box face;
+        face.left = i * 100; face.top = 50; face.right = i * 100 + 80; face.bottom = 150; face.confidence = 0.95f;
+        for(int j = 0; j < 10; ++j)
+            face.landmark[j] = i * 100 + j * 8;
+        results.faces.push_back(face);
+    }
+
+    // 连续更新几帧，让跟踪目标进入确认状态
+    auto tracker = DeepSORT::create_tracker();
+    for(int i = 0; i < 5; ++i)
+        tracker->update(track_boxes);
+
+    results.tracks = tracker->get_objects();
+    for(auto& track : results.tracks){
+        auto box = track->last_position();
+        vector<cv::Point3f> pose;
+        for(int j = 0; j < 17; ++j)
+            pose.emplace_back(box.left + j, box.top + j * 6, 0.8f);
+        results.poses.push_back(pose);
+        results.pose_owners.push_back(track->id());
+    }
+
+    int num_frames = 100000;
+    run_case("inproc pub", "inproc://result_stream_bench", ResultStream::Mode::Publish, results, num_frames);
+    run_case("tcp pub", "tcp://127.0.0.1:15558", ResultStream::Mode::Publish, results, num_frames);
+    run_case("tcp push", "tcp://127.0.0.1:15559", ResultStream::Mode::Push, results, num_frames);
+    return 0;
+}
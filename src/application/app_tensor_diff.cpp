@@ -0,0 +1,98 @@
+
+#include <common/ilogger.hpp>
+#include <common/tensor_diff.hpp>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static bool is_directory(const string& path){
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void print_usage(){
+    printf(
+        "Usage: ./pro tensor_diff <a> <b> [options]\n"
+        "    a, b                 tensor files saved by Tensor::save_to_file, or directories of them (paired by relative path)\n"
+        "                         b is the reference, e.g. the FP32 engine output\n"
+        "    --topk N             number of largest errors to report, default 10\n"
+        "    --atol x --rtol y    element mismatches when |a - b| > atol + rtol * |b|, default 1e-3, 1e-3\n"
+        "    --max-abs x          fail when max abs error > x\n"
+        "    --min-cosine x       fail when cosine similarity < x\n"
+        "    --max-mismatch x     fail when mismatch rate > x\n"
+        "    --filter pattern     file filter in directory mode, default *\n"
+        "    --threads N          default number of CPU cores\n"
+        "    --json file          save the report as json\n"
+    );
+}
+
+// 返回0表示全部通过，可以直接作为CI中精度门禁的退出码
+int app_tensor_diff(int argc, char** argv){
+
+    vector<string> paths;
+    TensorDiff::Config config;
+    string filter = "*";
+    string json_file;
+
+    for(int i = 0; i < argc; ++i){
+        const char* arg = argv[i];
+        bool has_value  = i + 1 < argc;
+        if(strcmp(arg, "--topk") == 0 && has_value)             config.topk = atoi(argv[++i]);
+        else if(strcmp(arg, "--atol") == 0 && has_value)        config.atol = atof(argv[++i]);
+        else if(strcmp(arg, "--rtol") == 0 && has_value)        config.rtol = atof(argv[++i]);
+        else if(strcmp(arg, "--max-abs") == 0 && has_value)     config.max_abs_error = atof(argv[++i]);
+        else if(strcmp(arg, "--min-cosine") == 0 && has_value)  config.min_cosine = atof(argv[++i]);
+        else if(strcmp(arg, "--max-mismatch") == 0 && has_value)config.max_mismatch_rate = atof(argv[++i]);
+        else if(strcmp(arg, "--threads") == 0 && has_value)     config.num_threads = atoi(argv[++i]);
+        else if(strcmp(arg, "--filter") == 0 && has_value)      filter = argv[++i];
+        else if(strcmp(arg, "--json") == 0 && has_value)        json_file = argv[++i];
+        else if(arg[0] != '-')                                  paths.emplace_back(arg);
+        else{
+            INFOE("Unknown option %s", arg);
+            print_usage();
+            return 2;
+        }
+    }
+
+    if(paths.size() != 2){
+        print_usage();
+        return 2;
+    }
+
+    bool dir_a = is_directory(paths[0]);
+    bool dir_b = is_directory(paths[1]);
+    if(dir_a != dir_b){
+        INFOE("%s and %s must both be files or both be directories", paths[0].c_str(), paths[1].c_str());
+        return 2;
+    }
+
+    auto tic = iLogger::timestamp_now_float();
+    vector<TensorDiff::Result> results;
+    if(dir_a)
+        results = TensorDiff::compare_directories(paths[0], paths[1], config, filter);
+    else
+        results.emplace_back(TensorDiff::compare_files(paths[0], paths[1], config));
+    double elapsed = iLogger::timestamp_now_float() - tic;
+
+    if(results.empty()){
+        INFOE("No tensor file found");
+        return 2;
+    }
+
+    printf("%s\n", TensorDiff::summary(results).c_str());
+    INFO("Compared in %.2f ms", elapsed);
+
+    if(!json_file.empty()){
+        if(iLogger::save_file(json_file, TensorDiff::to_json(results)))
+            INFO("Save report to %s", json_file.c_str());
+        else
+            INFOE("Save report to %s failed", json_file.c_str());
+    }
+
+    for(auto& result : results){
+        if(!result.pass) return 1;
+    }
+    return 0;
+}
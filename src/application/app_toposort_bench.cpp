@@ -0,0 +1,84 @@
+
+#include <common/ilogger.hpp>
+#include <onnx/onnx_pb.h>
+#include <onnx_parser/toposort.hpp>
+#include <algorithm>
+
+using namespace std;
+
+// 构造一个深度为num_nodes的链式图，每个节点额外连接前面第skip个节点的输出（类似残差结构）
+static void make_chain_graph(onnx::GraphProto& graph, int num_nodes, int skip, bool reverse){
+
+    graph.Clear();
+    graph.add_input()->set_name("input");
+    for(int i = 0; i < num_nodes; ++i){
+        auto node = graph.add_node();
+        node->set_op_type("Add");
+        node->set_name(iLogger::format("node%d", i));
+        node->add_input(i == 0 ? "input" : iLogger::format("t%d", i - 1));
+        node->add_input(i < skip ? "input" : iLogger::format("t%d", i - skip));
+        node->add_output(iLogger::format("t%d", i));
+    }
+    graph.add_output()->set_name(iLogger::format("t%d", num_nodes - 1));
+
+    // 逆序存放时不能直接使用原有顺序，会走Kahn排序的路径
+    if(reverse){
+        auto nodes = graph.mutable_node();
+        for(int i = 0, j = nodes->size() - 1; i < j; ++i, --j)
+            nodes->SwapElements(i, j);
+    }
+}
+
+static bool check_order(const onnx::GraphProto& graph, const vector<size_t>& order){
+
+    if((int)order.size() != graph.node_size()) return false;
+
+    vector<int> position(graph.node_size(), -1);
+    for(size_t i = 0; i < order.size(); ++i)
+        position[order[i]] = i;
+
+    GraphIndex index;
+    index.build(graph.node());
+    for(int i = 0; i < graph.node_size(); ++i){
+        for(auto& input : graph.node(i).input()){
+            int producer = index.producer(input);
+            if(producer != GraphIndex::kNoProducer && position[producer] >= position[i])
+                return false;
+        }
+    }
+    return true;
+}
+
+static void bench(int num_nodes, int skip, bool reverse){
+
+    onnx::GraphProto graph;
+    make_chain_graph(graph, num_nodes, skip, reverse);
+
+    const int ntest = 10;
+    GraphIndex index;
+    bool ok = index.build(graph.node());
+
+    auto tic = iLogger::timestamp_now_float();
+    for(int i = 0; i < ntest; ++i)
+        ok = ok && index.build(graph.node());
+    float build_ms = (iLogger::timestamp_now_float() - tic) / ntest;
+
+    int max_fan_out = 0;
+    for(size_t t = 0; t < index.num_tensors(); ++t)
+        max_fan_out = std::max(max_fan_out, index.fan_out(t));
+
+    INFO("nodes = %d, skip = %d, %s, build = %.3f ms, tensors = %d, max fan-out = %d, valid = %s",
+        num_nodes, skip, reverse ? "reversed" : "sorted", build_ms, (int)index.num_tensors(), max_fan_out,
+        ok && check_order(graph, index.order) ? "true" : "false"
+    );
+}
+
+int app_toposort_bench(){
+
+    for(int num_nodes : {10000, 50000, 100000}){
+        bench(num_nodes, 1, false);
+        bench(num_nodes, 2, false);
+        bench(num_nodes, 2, true);
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+
+// ./pro unit_test [filter]，返回失败的测试个数，可以直接作为CI的退出码
+int app_unit_test(int argc, char** argv){
+
+    const char* filter = argc > 0 ? argv[0] : "*";
+    return UnitTest::run_all(filter);
+}
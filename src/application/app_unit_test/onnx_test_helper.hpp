@@ -0,0 +1,73 @@
+#ifndef ONNX_TEST_HELPER_HPP
+#define ONNX_TEST_HELPER_HPP
+
+#include <string>
+#include <vector>
+#include <onnx/onnx_pb.h>
+#include <onnx_optimizer/onnx_graph.hpp>
+
+/* onnx_optimizer、onnx_analyzer的单元测试共用的构造模型的函数 */
+namespace OnnxTestHelper{
+
+    // 节点名与第一个输出相同
+    inline onnx::NodeProto* add_node(onnx::GraphProto* graph, const char* op, const std::vector<std::string>& inputs, const std::vector<std::string>& outputs){
+        auto node = graph->add_node();
+        node->set_op_type(op);
+        node->set_name(outputs[0]);
+        for(auto& input : inputs)   node->add_input(input);
+        for(auto& output : outputs) node->add_output(output);
+        return node;
+    }
+
+    inline void add_int_attribute(onnx::NodeProto* node, const char* name, int64_t value){
+        auto attribute = node->add_attribute();
+        attribute->set_name(name);
+        attribute->set_type(onnx::AttributeProto::INT);
+        attribute->set_i(value);
+    }
+
+    inline void add_ints_attribute(onnx::NodeProto* node, const char* name, const std::vector<int64_t>& values){
+        auto attribute = node->add_attribute();
+        attribute->set_name(name);
+        attribute->set_type(onnx::AttributeProto::INTS);
+        for(auto& value : values)
+            attribute->add_ints(value);
+    }
+
+    // 小于0的维度是动态的batch
+    inline void add_input(onnx::GraphProto* graph, const std::string& name, const ONNXOptimizer::Shape& dims){
+        auto input = graph->add_input();
+        input->set_name(name);
+        auto type = input->mutable_type()->mutable_tensor_type();
+        type->set_elem_type(onnx::TensorProto::FLOAT);
+        for(auto& d : dims){
+            if(d < 0) type->mutable_shape()->add_dim()->set_dim_param("batch");
+            else      type->mutable_shape()->add_dim()->set_dim_value(d);
+        }
+    }
+
+    inline void add_initializer(onnx::GraphProto* graph, const std::string& name, int dtype, const ONNXOptimizer::Shape& dims, const std::vector<double>& values){
+        ONNXOptimizer::Constant value;
+        value.dtype = dtype;
+        value.dims  = dims;
+        if(value.is_integer()) value.ints.assign(values.begin(), values.end());
+        else                   value.floats = values;
+        ONNXOptimizer::constant_to_tensor(value, name, *graph->add_initializer());
+    }
+
+    // 全部为0.5的float权重，只关心尺寸时使用
+    inline void add_initializer(onnx::GraphProto* graph, const std::string& name, const ONNXOptimizer::Shape& dims){
+        ONNXOptimizer::Constant value;
+        value.dims = dims;
+        add_initializer(graph, name, onnx::TensorProto::FLOAT, dims, std::vector<double>(value.numel(), 0.5));
+    }
+
+    inline onnx::ModelProto make_model(int64_t ir_version = 7){
+        onnx::ModelProto model;
+        model.set_ir_version(ir_version);
+        model.add_opset_import()->set_version(13);
+        return model;
+    }
+};
+
+#endif // ONNX_TEST_HELPER_HPP
@@ -0,0 +1,133 @@
+
+#include "app_alphapose/alpha_pose_decode.hpp"
+#include "tools/unit_test.hpp"
+#include <common/ilogger.hpp>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+// 标量的参考实现，最大值相同时取第一个
+static int reference_argmax(const vector<float>& data){
+    return std::max_element(data.begin(), data.end()) - data.begin();
+}
+
+static vector<float> gaussian_heatmap(int width, int height, float cx, float cy, float sigma = 2.0f){
+    vector<float> output(width * height);
+    for(int y = 0; y < height; ++y){
+        for(int x = 0; x < width; ++x){
+            float dx = x - cx, dy = y - cy;
+            output[y * width + x] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+        }
+    }
+    return output;
+}
+
+UNIT_TEST(alpha_pose_argmax){
+
+    // 覆盖小于8、8的倍数和有尾部的长度，值只有4种，存在大量相同的最大值
+    mt19937 rng(7);
+    uniform_int_distribution<int> level(0, 3);
+    for(int size = 1; size <= 80; ++size){
+        for(int repeat = 0; repeat < 20; ++repeat){
+            vector<float> data(size);
+            for(auto& v : data) v = level(rng);
+
+            float value = -1;
+            int index   = AlphaPose::argmax(data.data(), size, &value);
+            int expect  = reference_argmax(data);
+            if(index != expect)
+                UnitTest::report_failure(__FILE__, __LINE__, iLogger::format("size %d, argmax %d, expect %d", size, index, expect).c_str());
+            UNIT_CHECK(value == data[expect]);
+        }
+    }
+
+    // 最大值在开头、结尾、SIMD部分与尾部的交界处
+    for(int size : {8, 15, 16, 17, 64, 67}){
+        for(int peak : {0, 7, 8, size / 2, size - 8, size - 1}){
+            if(peak < 0 || peak >= size) continue;
+
+            vector<float> data(size, -5.0f);
+            data[peak] = -1.0f;
+            UNIT_CHECK(AlphaPose::argmax(data.data(), size) == peak);
+
+            // 后面出现相同的最大值时仍然返回第一个
+            for(int i = peak + 1; i < size; i += 3)
+                data[i] = -1.0f;
+            UNIT_CHECK(AlphaPose::argmax(data.data(), size) == peak);
+        }
+    }
+
+    // 全部相同
+    vector<float> flat(37, 0.5f);
+    UNIT_CHECK(AlphaPose::argmax(flat.data(), flat.size()) == 0);
+
+    float value = 1;
+    UNIT_CHECK(AlphaPose::argmax(flat.data(), 0, &value) == -1 && value == 0);
+}
+
+UNIT_TEST(alpha_pose_refine_gaussian){
+
+    const int width = 48, height = 64;
+    const float centers[][2] = {{20.3f, 30.7f}, {10.4f, 10.6f}, {30.0f, 45.0f}, {25.8f, 12.1f}};
+
+    for(auto& center : centers){
+        float cx = center[0], cy = center[1];
+        auto heatmap = gaussian_heatmap(width, height, cx, cy);
+
+        float none[3], quarter[3], dark[3];
+        AlphaPose::decode_heatmaps(heatmap.data(), 1, width, height, AlphaPose::Refine::None,    none);
+        AlphaPose::decode_heatmaps(heatmap.data(), 1, width, height, AlphaPose::Refine::Quarter, quarter);
+        AlphaPose::decode_heatmaps(heatmap.data(), 1, width, height, AlphaPose::Refine::Dark,    dark);
+
+        // None是最近的整数位置
+        UNIT_CHECK(none[0] == std::round(cx) && none[1] == std::round(cy));
+        UNIT_CHECK(std::fabs(none[2] - heatmap[(int)none[1] * width + (int)none[0]]) < 1e-6f);
+
+        // Quarter向真实位置偏移0.25，误差不超过0.25
+        UNIT_CHECK(std::fabs(quarter[0] - cx) <= 0.25f + 1e-5f && std::fabs(quarter[1] - cy) <= 0.25f + 1e-5f);
+
+        // 高斯的对数是二次函数，DARK的二阶展开几乎可以精确恢复中心
+        if(std::fabs(dark[0] - cx) > 0.02f || std::fabs(dark[1] - cy) > 0.02f){
+            UnitTest::report_failure(__FILE__, __LINE__,
+                iLogger::format("dark (%f, %f), expect (%f, %f)", dark[0], dark[1], cx, cy).c_str()
+            );
+        }
+        UNIT_CHECK(dark[2] == none[2] && quarter[2] == none[2]);
+    }
+}
+
+UNIT_TEST(alpha_pose_refine_border){
+
+    // 最大值在边界附近时没有足够的邻域，不做修正
+    // 与参考实现一致，Quarter要求1 < px < width - 1，DARK要求1 < px < width - 2
+    const int width = 16, height = 12;
+    const int peaks[][2] = {{0, 0}, {width - 1, height - 1}, {1, 5}, {7, 1}, {width - 2, 5}, {7, height - 2}};
+    for(int i = 0; i < 6; ++i){
+        auto heatmap = gaussian_heatmap(width, height, peaks[i][0] + 0.3f, peaks[i][1] - 0.3f);
+
+        float output[3];
+        AlphaPose::decode_heatmaps(heatmap.data(), 1, width, height, AlphaPose::Refine::Dark, output);
+        UNIT_CHECK(output[0] == peaks[i][0] && output[1] == peaks[i][1]);
+
+        AlphaPose::decode_heatmaps(heatmap.data(), 1, width, height, AlphaPose::Refine::Quarter, output);
+        if(i < 4){
+            UNIT_CHECK(output[0] == peaks[i][0] && output[1] == peaks[i][1]);
+        }else{
+            UNIT_CHECK(output[0] == peaks[i][0] + 0.25f && output[1] == peaks[i][1] - 0.25f);
+        }
+    }
+
+    // 多个关键点的输出依次存放
+    auto first  = gaussian_heatmap(width, height, 3, 4);
+    auto second = gaussian_heatmap(width, height, 10, 8);
+    first.insert(first.end(), second.begin(), second.end());
+
+    float output[6];
+    AlphaPose::decode_heatmaps(first.data(), 2, width, height, AlphaPose::Refine::None, output);
+    UNIT_CHECK(output[0] == 3 && output[1] == 4 && output[2] == 1);
+    UNIT_CHECK(output[3] == 10 && output[4] == 8 && output[5] == 1);
+
+    UNIT_CHECK(string(AlphaPose::refine_string(AlphaPose::Refine::Dark)) == "Dark");
+}
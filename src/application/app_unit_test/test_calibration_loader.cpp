@@ -0,0 +1,254 @@
+
+#include <builder/trt_calibration_loader.hpp>
+#include <common/trt_tensor.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <set>
+
+using namespace std;
+
+// 只使用内存的设备，tensor引用这里分配的内存，不会调用cuda
+class HostCalibrationDevice : public TRT::CalibrationDevice{
+public:
+    virtual shared_ptr<TRT::Tensor> create_tensor(const vector<int>& dims) override{
+        size_t numel = 1;
+        for(auto& d : dims) numel *= d;
+
+        buffers.emplace_back(new vector<float>(numel));
+        auto& buffer = *buffers.back();
+        auto memory  = make_shared<TRT::MixMemory>(buffer.data(), buffer.size() * sizeof(float), nullptr, 0);
+        return make_shared<TRT::Tensor>(dims, TRT::DataType::Float, memory);
+    }
+
+    virtual void bind_thread() override{}
+    virtual void upload(const shared_ptr<TRT::Tensor>& tensor) override{num_uploads++;}
+
+    vector<shared_ptr<vector<float>>> buffers;
+    atomic<int> num_uploads{0};
+};
+
+// 每个文件预处理成它的编号，记录调用线程、并发数和预处理的batch
+struct StubProcess{
+    atomic<int> running{0};
+    atomic<int> peak{0};
+    atomic<int> num_calls{0};
+    atomic<int> requested{0};       // builder线程正在请求的batch
+    atomic<bool> ring_overflow{false};
+    int ring = 1;
+    int sleep_ms = 0;
+    mutex lock;
+    set<thread::id> threads;
+
+    TRT::Int8Process function(){
+        return [this](int current, int count, const vector<string>& files, shared_ptr<TRT::Tensor>& tensor){
+            int current_running = ++running;
+            int expected = peak;
+            while(current_running > expected && !peak.compare_exchange_weak(expected, current_running));
+            num_calls++;
+            {
+                unique_lock<mutex> l(lock);
+                threads.insert(this_thread::get_id());
+            }
+
+            // ring中只有ring个位置，预处理不能超过正在请求的batch太多
+            int ibatch = current / (int)files.size() - 1;
+            if(ibatch >= requested + ring)
+                ring_overflow = true;
+
+            if(sleep_ms > 0)
+                iLogger::sleep(sleep_ms);
+
+            float* ptr = tensor->cpu<float>();
+            int per_image = tensor->count(1);
+            for(size_t i = 0; i < files.size(); ++i){
+                float value = atoi(iLogger::file_name(files[i], false).c_str());
+                std::fill(ptr + i * per_image, ptr + (i + 1) * per_image, value);
+            }
+            --running;
+        };
+    }
+};
+
+static vector<string> make_files(int count){
+    vector<string> files;
+    for(int i = 0; i < count; ++i){
+        auto file = UnitTest::temp_directory() + iLogger::format("%03d.jpg", i);
+        iLogger::save_file(file, string(10 + i, 'x'));
+        files.emplace_back(file);
+    }
+    return files;
+}
+
+// 逐个读取batch并检查数据，返回读到的batch数量
+static int consume(const shared_ptr<TRT::CalibrationLoader>& loader, const vector<string>& files, int batch_size, StubProcess* process = nullptr, int max_batches = -1){
+
+    int ibatch = 0;
+    while(max_batches < 0 || ibatch < max_batches){
+        if(process) process->requested = ibatch;
+        auto tensor = loader->next();
+        if(tensor == nullptr) break;
+
+        const float* ptr = tensor->cpu<float>();
+        int per_image = tensor->count(1);
+        for(int i = 0; i < batch_size; ++i){
+            float expected = atoi(iLogger::file_name(files[ibatch * batch_size + i], false).c_str());
+            if(ptr[i * per_image] != expected || ptr[(i + 1) * per_image - 1] != expected){
+                UnitTest::report_failure(__FILE__, __LINE__, iLogger::format("batch %d image %d mismatch", ibatch, i).c_str());
+                return ibatch;
+            }
+        }
+        ibatch++;
+    }
+    return ibatch;
+}
+
+UNIT_TEST(calibration_loader_default_sync){
+
+    UNIT_CHECK(TRT::Int8CalibrationConfig().num_threads == 0);
+
+    auto files  = make_files(10);
+    auto device = make_shared<HostCalibrationDevice>();
+    StubProcess process;
+    TRT::Int8CalibrationConfig config;
+
+    UNIT_CHECK(TRT::create_calibration_loader(files, {}, process.function(), config, device) == nullptr);
+    UNIT_CHECK(TRT::create_calibration_loader(files, {4, 3, 2, 2}, nullptr, config, device) == nullptr);
+
+    // 10张图片只能组成2个batch，多余的被忽略
+    auto loader = TRT::create_calibration_loader(files, {4, 3, 2, 2}, process.function(), config, device);
+    UNIT_ASSERT(loader != nullptr);
+    UNIT_CHECK(loader->num_batches() == 2);
+    UNIT_CHECK(!loader->from_cache());
+    UNIT_CHECK(consume(loader, files, 4) == 2);
+    UNIT_CHECK(loader->next() == nullptr);
+
+    // 默认不开线程，Int8Process只在调用next的线程中执行
+    UNIT_CHECK(process.num_calls == 2);
+    UNIT_CHECK(process.peak == 1);
+    UNIT_CHECK(process.threads.size() == 1 && *process.threads.begin() == this_thread::get_id());
+    UNIT_CHECK(device->num_uploads >= 2);
+    UNIT_CHECK(device->buffers.size() == 1);
+}
+
+UNIT_TEST(calibration_loader_prefetch){
+
+    auto files  = make_files(48);
+    auto device = make_shared<HostCalibrationDevice>();
+    StubProcess process;
+    process.ring     = 3;
+    process.sleep_ms = 10;
+
+    TRT::Int8CalibrationConfig config;
+    config.num_threads = 3;
+    config.prefetch    = 2;
+
+    auto loader = TRT::create_calibration_loader(files, {2, 3, 4, 4}, process.function(), config, device);
+    UNIT_ASSERT(loader != nullptr);
+    UNIT_CHECK(loader->num_batches() == 24);
+    UNIT_CHECK(device->buffers.size() == 3);
+
+    // 数据按顺序返回，预处理并行，并且不超过ring的大小
+    UNIT_CHECK(consume(loader, files, 2, &process) == 24);
+    UNIT_CHECK(loader->next() == nullptr);
+    UNIT_CHECK(process.num_calls == 24);
+    UNIT_CHECK(process.peak > 1);
+    UNIT_CHECK(process.peak <= 3);
+    UNIT_CHECK(!process.ring_overflow);
+    UNIT_CHECK(process.threads.count(this_thread::get_id()) == 0);
+    UNIT_CHECK(device->num_uploads >= 24);
+
+    // 没有读完就释放，工作线程正常退出
+    StubProcess partial;
+    partial.ring = 3;
+    loader = TRT::create_calibration_loader(files, {2, 3, 4, 4}, partial.function(), config, device);
+    UNIT_ASSERT(loader != nullptr);
+    UNIT_CHECK(consume(loader, files, 2, &partial, 5) == 5);
+    loader.reset();
+    UNIT_CHECK(partial.num_calls <= 5 + 3);
+}
+
+UNIT_TEST(calibration_loader_cache){
+
+    auto directory  = UnitTest::temp_directory();
+    auto cache_file = directory + "cache/calib.tensor";
+    auto files      = make_files(12);
+    auto device     = make_shared<HostCalibrationDevice>();
+    vector<int> dims{4, 3, 8, 8};
+
+    TRT::Int8CalibrationConfig config;
+    config.num_threads = 2;
+    config.cache_file  = cache_file;
+
+    // 没有读完时不保存cache
+    {
+        StubProcess process;
+        auto loader = TRT::create_calibration_loader(files, dims, process.function(), config, device);
+        UNIT_ASSERT(loader != nullptr);
+        UNIT_CHECK(consume(loader, files, 4, nullptr, 1) == 1);
+    }
+    UNIT_CHECK(!iLogger::exists(cache_file));
+    UNIT_CHECK(!UnitTest::has_temp_file(directory + "cache"));
+
+    {
+        StubProcess process;
+        auto loader = TRT::create_calibration_loader(files, dims, process.function(), config, device);
+        UNIT_ASSERT(loader != nullptr);
+        UNIT_CHECK(!loader->from_cache());
+        UNIT_CHECK(consume(loader, files, 4) == 3);
+        UNIT_CHECK(loader->next() == nullptr);
+    }
+    UNIT_CHECK(iLogger::exists(cache_file));
+    UNIT_CHECK(!UnitTest::has_temp_file(directory + "cache"));
+
+    // 读完一遍后cache对应new_files和new_dims
+    auto run = [&](const vector<string>& new_files, const vector<int>& new_dims, bool expect_cache){
+        StubProcess process;
+        auto loader = TRT::create_calibration_loader(new_files, new_dims, process.function(), config, device);
+        UNIT_ASSERT(loader != nullptr);
+        UNIT_CHECK(loader->from_cache() == expect_cache);
+        UNIT_CHECK(consume(loader, new_files, new_dims[0]) == loader->num_batches());
+        UNIT_CHECK(process.num_calls == (expect_cache ? 0 : loader->num_batches()));
+    };
+
+    // 文件列表相同时直接读取cache，不再预处理
+    run(files, dims, true);
+
+    // 尺寸、文件顺序或者文件大小变化时cache失效
+    run(files, {4, 3, 4, 4}, false);
+    run(files, dims, false);
+
+    auto reordered = files;
+    std::swap(reordered[0], reordered[11]);
+    run(reordered, dims, false);
+    run(files, dims, false);
+
+    UNIT_ASSERT(iLogger::save_file(files[5], string(100, 'y')));
+    run(files, dims, false);
+    run(files, dims, true);
+}
+
+UNIT_TEST(calibration_subsample){
+
+    vector<string> files;
+    for(int i = 0; i < 100; ++i)
+        files.emplace_back(iLogger::format("images/%03d.jpg", (i * 37) % 100));
+
+    // 不抽样时只排序
+    auto sorted = TRT::subsample_calibration_files(files, 0);
+    UNIT_CHECK(sorted.size() == 100);
+    UNIT_CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+    UNIT_CHECK(TRT::subsample_calibration_files(files, 200) == sorted);
+
+    // 结果与输入顺序无关，并且保持排序
+    auto a = TRT::subsample_calibration_files(files, 10, 1);
+    auto b = TRT::subsample_calibration_files(sorted, 10, 1);
+    UNIT_CHECK(a.size() == 10);
+    UNIT_CHECK(a == b);
+    UNIT_CHECK(std::is_sorted(a.begin(), a.end()));
+    UNIT_CHECK(std::unique(a.begin(), a.end()) == a.end());
+    UNIT_CHECK(TRT::subsample_calibration_files(files, 10, 2) != a);
+}
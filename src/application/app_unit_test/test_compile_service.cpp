@@ -0,0 +1,257 @@
+
+#include <builder/trt_compile_service.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// 不访问GPU的后端：timing cache是排好序的字节集合，每个模型贡献名字的首字母作为它的"tactic"
+// cache中已经有这个tactic时编译更快，用来检查cache是否在任务之间共享
+class StubCompileBackend : public TRT::CompileBackend{
+public:
+    virtual bool compile(const TRT::CompileJob& job, TRT::CompileOutput& output, vector<uint8_t>& timing_cache) override{
+
+        int current = ++running;
+        int expected = peak;
+        while(current > expected && !peak.compare_exchange_weak(expected, current)){}
+
+        {
+            unique_lock<mutex> l(lock);
+            names.emplace_back(job.name);
+            if(job.int8CalibrationConfig)
+                calibration_threads.emplace_back(job.int8CalibrationConfig->num_threads);
+            cond.wait(l, [&](){return !blocked;});
+        }
+
+        bool cached = std::find(timing_cache.begin(), timing_cache.end(), (uint8_t)job.name[0]) != timing_cache.end();
+        if(cached) num_cached++;
+        iLogger::sleep(cached ? 1 : 50);
+        --running;
+
+        if(job.name == "bad")
+            return false;
+
+        timing_cache.push_back(job.name[0]);
+        output.set_data(vector<uint8_t>(16, job.name[0]));
+        return true;
+    }
+
+    virtual bool merge_timing_cache(vector<uint8_t>& dst, const vector<uint8_t>& src) override{
+        dst.insert(dst.end(), src.begin(), src.end());
+        std::sort(dst.begin(), dst.end());
+        dst.erase(std::unique(dst.begin(), dst.end()), dst.end());
+        return true;
+    }
+
+    void block(bool value){
+        {
+            unique_lock<mutex> l(lock);
+            blocked = value;
+        }
+        cond.notify_all();
+    }
+
+    // 等待有count个任务进入compile
+    void wait_entered(size_t count){
+        while(true){
+            {
+                unique_lock<mutex> l(lock);
+                if(names.size() >= count) return;
+            }
+            iLogger::sleep(1);
+        }
+    }
+
+    atomic<int> running{0};
+    atomic<int> peak{0};
+    atomic<int> num_cached{0};
+    mutex lock;
+    condition_variable cond;
+    bool blocked = false;
+    vector<string> names;
+    vector<int> calibration_threads;
+};
+
+static TRT::CompileJob make_job(const string& name, const string& saveto = ""){
+    TRT::CompileJob job;
+    job.name = name;
+    if(!saveto.empty())
+        job.saveto = saveto.c_str();
+    return job;
+}
+
+UNIT_TEST(compile_service_scheduling){
+
+    auto backend = make_shared<StubCompileBackend>();
+    vector<string> progress;
+    mutex progress_lock;
+    auto service = TRT::create_compile_service(3, "", [&](const TRT::CompileTask& task, int finished, int total){
+        unique_lock<mutex> l(progress_lock);
+        progress.emplace_back(iLogger::format("%s %s %d/%d", task.job().name.c_str(), TRT::compile_state_string(task.state()), finished, total));
+    }, backend);
+    UNIT_ASSERT(service != nullptr);
+    UNIT_CHECK(TRT::create_compile_service(0, "", nullptr, backend) == nullptr);
+
+    auto output_directory = UnitTest::temp_directory() + "engines/";
+    UNIT_ASSERT(iLogger::mkdirs(output_directory));
+
+    vector<shared_ptr<TRT::CompileTask>> tasks;
+    for(auto name : {"a", "b", "c", "d", "e", "f"})
+        tasks.emplace_back(service->submit(make_job(name, output_directory + name + ".trtmodel")));
+    tasks.emplace_back(service->submit(make_job("memory")));
+
+    UNIT_CHECK(service->wait_all());
+    UNIT_CHECK(backend->peak == 3);
+    UNIT_CHECK(backend->names.size() == tasks.size());
+
+    for(auto& task : tasks){
+        UNIT_CHECK(task->state() == TRT::CompileState::Succeeded);
+        UNIT_CHECK(task->wait());
+        UNIT_CHECK(task->data().size() == 16);
+    }
+    UNIT_CHECK(iLogger::load_file(output_directory + "a.trtmodel") == vector<uint8_t>(16, 'a'));
+    UNIT_CHECK(iLogger::exists(output_directory + "f.trtmodel"));
+
+    // 开始和结束各回调一次，最后一次回调时所有任务都已结束
+    UNIT_CHECK(progress.size() == tasks.size() * 2);
+    UNIT_CHECK(std::count_if(progress.begin(), progress.end(), [&](const string& item){
+        return item.find(iLogger::format("Succeeded %d/%d", (int)tasks.size(), (int)tasks.size())) != string::npos;
+    }) == 1);
+
+    auto cache = service->timing_cache();
+    UNIT_CHECK(string(cache.begin(), cache.end()) == "abcdefm");
+}
+
+UNIT_TEST(compile_service_failed_job){
+
+    auto backend = make_shared<StubCompileBackend>();
+    auto service = TRT::create_compile_service(2, "", nullptr, backend);
+    UNIT_ASSERT(service != nullptr);
+
+    auto good = service->submit(make_job("good"));
+    auto bad  = service->submit(make_job("bad"));
+    UNIT_CHECK(!service->wait_all());
+    UNIT_CHECK(good->state() == TRT::CompileState::Succeeded);
+    UNIT_CHECK(bad->state() == TRT::CompileState::Failed);
+    UNIT_CHECK(!bad->wait());
+
+    // 失败任务的cache不合并
+    auto cache = service->timing_cache();
+    UNIT_CHECK(string(cache.begin(), cache.end()) == "g");
+}
+
+UNIT_TEST(compile_service_cancel){
+
+    auto backend = make_shared<StubCompileBackend>();
+    auto service = TRT::create_compile_service(1, "", nullptr, backend);
+    UNIT_ASSERT(service != nullptr);
+
+    backend->block(true);
+    auto running = service->submit(make_job("running"));
+    auto pending = service->submit(make_job("pending"));
+    backend->wait_entered(1);
+
+    // 等待中的任务立即结束，正在编译的任务在编译结束后丢弃结果
+    pending->cancel();
+    UNIT_CHECK(pending->state() == TRT::CompileState::Cancelled);
+    UNIT_CHECK(!pending->wait());
+
+    running->cancel();
+    UNIT_CHECK(running->state() == TRT::CompileState::Running);
+    backend->block(false);
+    UNIT_CHECK(!running->wait());
+    UNIT_CHECK(running->state() == TRT::CompileState::Cancelled);
+
+    UNIT_CHECK(!service->wait_all());
+    UNIT_CHECK(backend->names == vector<string>{"running"});
+    UNIT_CHECK(service->timing_cache().empty());
+
+    // 取消后的service可以继续提交
+    auto next = service->submit(make_job("next"));
+    UNIT_CHECK(next->wait());
+}
+
+UNIT_TEST(compile_service_cache_persistence){
+
+    auto directory  = UnitTest::temp_directory();
+    auto cache_file = directory + "models.timing.cache";
+
+    {
+        auto backend = make_shared<StubCompileBackend>();
+        auto service = TRT::create_compile_service(2, cache_file, nullptr, backend);
+        UNIT_ASSERT(service != nullptr);
+        for(auto name : {"x", "y", "z"})
+            service->submit(make_job(name));
+        UNIT_CHECK(service->wait_all());
+        UNIT_CHECK(backend->num_cached == 0);
+    }
+
+    auto saved = iLogger::load_file(cache_file);
+    UNIT_CHECK(string(saved.begin(), saved.end()) == "xyz");
+    UNIT_CHECK(!UnitTest::has_temp_file(directory));
+
+    // 第二次启动时加载cache，同样的模型全部命中
+    auto backend = make_shared<StubCompileBackend>();
+    auto service = TRT::create_compile_service(2, cache_file, nullptr, backend);
+    UNIT_ASSERT(service != nullptr);
+    UNIT_CHECK(service->timing_cache() == saved);
+    for(auto name : {"x", "y", "z", "w"})
+        service->submit(make_job(name));
+    UNIT_CHECK(service->wait_all());
+    UNIT_CHECK(backend->num_cached == 3);
+
+    saved = iLogger::load_file(cache_file);
+    UNIT_CHECK(string(saved.begin(), saved.end()) == "wxyz");
+}
+
+UNIT_TEST(compile_service_shared_cache_file){
+
+    // 两个service同时保存同一个cache文件，临时文件不能冲突
+    auto directory  = UnitTest::temp_directory();
+    auto cache_file = directory + "shared.timing.cache";
+    auto backend    = make_shared<StubCompileBackend>();
+    auto s1 = TRT::create_compile_service(4, cache_file, nullptr, backend);
+    auto s2 = TRT::create_compile_service(4, cache_file, nullptr, backend);
+    UNIT_ASSERT(s1 != nullptr && s2 != nullptr);
+
+    for(int i = 0; i < 8; ++i){
+        s1->submit(make_job(string(1, (char)('a' + i))));
+        s2->submit(make_job(string(1, (char)('A' + i))));
+    }
+    UNIT_CHECK(s1->wait_all());
+    UNIT_CHECK(s2->wait_all());
+    UNIT_CHECK(s1->save_timing_cache());
+    UNIT_CHECK(s2->save_timing_cache());
+    UNIT_CHECK(!UnitTest::has_temp_file(directory));
+
+    auto saved = iLogger::load_file(cache_file);
+    UNIT_CHECK(saved == s2->timing_cache());
+}
+
+UNIT_TEST(compile_service_job_config){
+
+    auto backend = make_shared<StubCompileBackend>();
+    auto service = TRT::create_compile_service(1, "", nullptr, backend);
+    UNIT_ASSERT(service != nullptr);
+
+    // 线程级的标定配置在submit时取到任务中，工作线程不受调用线程后续修改的影响
+    auto config = TRT::get_int8_calibration_config();
+    config.num_threads = 5;
+    TRT::set_thread_int8_calibration_config(&config);
+    auto task = service->submit(make_job("thread"));
+    TRT::set_thread_int8_calibration_config(nullptr);
+    UNIT_CHECK(task->job().int8CalibrationConfig != nullptr);
+    UNIT_CHECK(task->job().int8CalibrationConfig->num_threads == 5);
+
+    auto job = make_job("explicit");
+    config.num_threads = 7;
+    job.int8CalibrationConfig = make_shared<TRT::Int8CalibrationConfig>(config);
+    service->submit(job);
+
+    UNIT_CHECK(service->wait_all());
+    UNIT_CHECK(backend->calibration_threads == vector<int>({5, 7}));
+}
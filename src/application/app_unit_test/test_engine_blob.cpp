@@ -0,0 +1,111 @@
+
+#include <infer/trt_engine_blob.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <stdio.h>
+
+#if defined(U_OS_WINDOWS)
+#   include <sys/utime.h>
+#else
+#   include <utime.h>
+#endif
+
+using namespace std;
+
+// 与engine的写入方一样先写临时文件再rename，旧的映射不受影响
+static bool replace_file(const string& file, const string& data){
+    string temp_file = file + ".tmp";
+    if(!iLogger::save_file(temp_file, data))
+        return false;
+#if defined(U_OS_WINDOWS)
+    ::remove(file.c_str());
+#endif
+    return ::rename(temp_file.c_str(), file.c_str()) == 0;
+}
+
+static bool set_modify_time(const string& file, time_t modify){
+    struct utimbuf times;
+    times.actime  = modify;
+    times.modtime = modify;
+    return utime(file.c_str(), &times) == 0;
+}
+
+static char first_byte(const shared_ptr<iLogger::MappedFile>& mapping){
+    return ((const char*)mapping->data())[0];
+}
+
+UNIT_TEST(engine_blob_dedup){
+
+    auto file = UnitTest::temp_directory() + "a.engine";
+    UNIT_ASSERT(iLogger::save_file(file, string(4096, 'a')));
+    UNIT_CHECK(TRT::acquire_engine_blob(UnitTest::temp_directory() + "missing.engine") == nullptr);
+
+    int base = TRT::num_engine_blobs();
+    auto a = TRT::acquire_engine_blob(file);
+    auto b = TRT::acquire_engine_blob(file);
+    UNIT_ASSERT(a != nullptr);
+    UNIT_CHECK(a.get() == b.get());
+    UNIT_CHECK(a->size() == 4096);
+    UNIT_CHECK(first_byte(a) == 'a');
+    UNIT_CHECK(TRT::num_engine_blobs() == base + 1);
+
+    // 不同的路径各自映射
+    auto other_file = UnitTest::temp_directory() + "b.engine";
+    UNIT_ASSERT(iLogger::save_file(other_file, string(4096, 'b')));
+    auto c = TRT::acquire_engine_blob(other_file);
+    UNIT_ASSERT(c != nullptr);
+    UNIT_CHECK(c.get() != a.get());
+    UNIT_CHECK(first_byte(c) == 'b');
+    UNIT_CHECK(TRT::num_engine_blobs() == base + 2);
+}
+
+UNIT_TEST(engine_blob_changed_file){
+
+    auto file = UnitTest::temp_directory() + "model.engine";
+    UNIT_ASSERT(iLogger::save_file(file, string(4096, 'x')));
+    auto old_mapping = TRT::acquire_engine_blob(file);
+    UNIT_ASSERT(old_mapping != nullptr);
+
+    // 大小变化时重新映射，旧的映射仍然可以访问原来的数据
+    UNIT_ASSERT(replace_file(file, string(8192, 'y')));
+    auto new_mapping = TRT::acquire_engine_blob(file);
+    UNIT_ASSERT(new_mapping != nullptr);
+    UNIT_CHECK(new_mapping.get() != old_mapping.get());
+    UNIT_CHECK(new_mapping->size() == 8192);
+    UNIT_CHECK(first_byte(new_mapping) == 'y');
+    UNIT_CHECK(old_mapping->size() == 4096);
+    UNIT_CHECK(first_byte(old_mapping) == 'x');
+
+    // 大小相同、修改时间不同时也重新映射
+    UNIT_ASSERT(replace_file(file, string(8192, 'z')));
+    UNIT_ASSERT(set_modify_time(file, iLogger::last_modify(file) + 10));
+    auto same_size = TRT::acquire_engine_blob(file);
+    UNIT_ASSERT(same_size != nullptr);
+    UNIT_CHECK(same_size.get() != new_mapping.get());
+    UNIT_CHECK(first_byte(same_size) == 'z');
+    UNIT_CHECK(TRT::acquire_engine_blob(file).get() == same_size.get());
+}
+
+UNIT_TEST(engine_blob_release){
+
+    auto file = UnitTest::temp_directory() + "release.engine";
+    UNIT_ASSERT(iLogger::save_file(file, string(4096, 'r')));
+
+    int base = TRT::num_engine_blobs();
+    auto a = TRT::acquire_engine_blob(file);
+    auto b = TRT::acquire_engine_blob(file);
+    UNIT_CHECK(TRT::num_engine_blobs() == base + 1);
+
+    // 所有使用者释放后映射解除，再次获取时重新映射
+    a.reset();
+    UNIT_CHECK(TRT::num_engine_blobs() == base + 1);
+    b.reset();
+    UNIT_CHECK(TRT::num_engine_blobs() == base);
+
+    // 没有使用者时可以原地改写文件
+    UNIT_ASSERT(iLogger::save_file(file, string(2048, 's')));
+    auto c = TRT::acquire_engine_blob(file);
+    UNIT_ASSERT(c != nullptr);
+    UNIT_CHECK(c->size() == 2048);
+    UNIT_CHECK(first_byte(c) == 's');
+}
@@ -0,0 +1,238 @@
+
+#include <builder/trt_engine_cache.hpp>
+#include <common/ilogger.hpp>
+#include <common/json.hpp>
+#include "tools/unit_test.hpp"
+#include <algorithm>
+
+using namespace std;
+
+// 测试中不访问GPU，platform直接指定
+static const char* TEST_PLATFORM = "sm0.0-test";
+
+static bool has_entry(const vector<TRT::EngineCacheEntry>& entries, const string& key){
+    for(auto& entry : entries)
+        if(entry.key == key) return true;
+    return false;
+}
+
+static uint64_t manifest_access(const string& directory, const string& key){
+    auto manifest = Json::parse_file(directory + "/manifest.json");
+    return manifest["engines"][key].get("last_access", 0).asLargestUInt();
+}
+
+UNIT_TEST(engine_cache_make_key){
+
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto onnx_file = UnitTest::temp_directory() + "model.onnx";
+    UNIT_ASSERT(iLogger::save_file(onnx_file, string("fake onnx model")));
+
+    auto cache = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    UNIT_ASSERT(cache != nullptr);
+
+    auto source = TRT::ModelSource::onnx(onnx_file);
+    auto k1 = cache->make_key(source, TRT::Mode::FP32, 16);
+    UNIT_ASSERT(!k1.empty());
+    UNIT_CHECK(k1.find("model-FP32-") == 0);
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::FP32, 16) == k1);
+
+    vector<string> keys{
+        k1,
+        cache->make_key(source, TRT::Mode::FP16, 16),
+        cache->make_key(source, TRT::Mode::FP32, 8),
+        cache->make_key(source, TRT::Mode::FP32, 16, {TRT::InputDims({1, 3, 640, 640})}),
+        cache->make_key(source, TRT::Mode::FP32, 16, {TRT::InputDims({1, 3, 320, 320})}),
+        TRT::create_engine_cache(directory, 0, "sm9.9-test")->make_key(source, TRT::Mode::FP32, 16)
+    };
+    std::sort(keys.begin(), keys.end());
+    UNIT_CHECK(std::unique(keys.begin(), keys.end()) == keys.end());
+
+    // 内存中的onnx数据按内容计算hash
+    string data = "fake onnx model";
+    auto kdata = cache->make_key(TRT::ModelSource::onnx_data(data.data(), data.size()), TRT::Mode::FP32, 16);
+    UNIT_CHECK(kdata.find("data-FP32-") == 0);
+    UNIT_CHECK(kdata.substr(kdata.rfind('-')) == k1.substr(k1.rfind('-')));
+
+    // onnx修改后key变化
+    UNIT_ASSERT(iLogger::save_file(onnx_file, string("modified onnx model, longer")));
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::FP32, 16) != k1);
+    UNIT_CHECK(cache->make_key(TRT::ModelSource::onnx(UnitTest::temp_directory() + "missing.onnx"), TRT::Mode::FP32, 16).empty());
+}
+
+UNIT_TEST(engine_cache_same_size_rewrite){
+
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto onnx_file = UnitTest::temp_directory() + "model.onnx";
+    UNIT_ASSERT(iLogger::save_file(onnx_file, string("model version 1")));
+
+    auto cache = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    UNIT_ASSERT(cache != nullptr);
+
+    auto source = TRT::ModelSource::onnx(onnx_file);
+    auto k1 = cache->make_key(source, TRT::Mode::FP32, 16);
+    UNIT_ASSERT(!k1.empty());
+
+    // 大小不变、同一秒内的重写，只有纳秒精度的修改时间能区分
+    iLogger::sleep(20);
+    UNIT_ASSERT(iLogger::save_file(onnx_file, string("model version 2")));
+    auto k2 = cache->make_key(source, TRT::Mode::FP32, 16);
+    UNIT_CHECK(!k2.empty() && k2 != k1);
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::FP32, 16) == k2);
+}
+
+UNIT_TEST(engine_cache_int8_key){
+
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto onnx_file = UnitTest::temp_directory() + "model.onnx";
+    auto image_directory = UnitTest::temp_directory() + "images";
+    auto entropy_file = UnitTest::temp_directory() + "entropy.cache";
+    UNIT_ASSERT(iLogger::save_file(onnx_file, string("fake onnx model")));
+    UNIT_ASSERT(iLogger::mkdirs(image_directory));
+    UNIT_ASSERT(iLogger::save_file(image_directory + "/a.jpg", string("image a")));
+
+    auto cache = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    UNIT_ASSERT(cache != nullptr);
+
+    auto source = TRT::ModelSource::onnx(onnx_file);
+    auto kimages = cache->make_key(source, TRT::Mode::INT8, 16, {}, image_directory, entropy_file);
+    UNIT_ASSERT(!kimages.empty());
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::INT8, 16, {}, image_directory, entropy_file) == kimages);
+
+    // 标定图片增加后key变化
+    UNIT_ASSERT(iLogger::save_file(image_directory + "/b.png", string("image b")));
+    auto kmore = cache->make_key(source, TRT::Mode::INT8, 16, {}, image_directory, entropy_file);
+    UNIT_CHECK(!kmore.empty() && kmore != kimages);
+
+    // entropy文件存在时由它的内容决定，与图片无关
+    UNIT_ASSERT(iLogger::save_file(entropy_file, string("entropy v1")));
+    auto kentropy = cache->make_key(source, TRT::Mode::INT8, 16, {}, image_directory, entropy_file);
+    UNIT_CHECK(!kentropy.empty() && kentropy != kmore);
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::INT8, 16, {}, "", entropy_file) == kentropy);
+
+    UNIT_ASSERT(iLogger::save_file(entropy_file, string("entropy v2, longer")));
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::INT8, 16, {}, image_directory, entropy_file) != kentropy);
+
+    // 非INT8时忽略标定参数
+    UNIT_CHECK(cache->make_key(source, TRT::Mode::FP16, 16, {}, image_directory, entropy_file) == cache->make_key(source, TRT::Mode::FP16, 16));
+}
+
+UNIT_TEST(engine_cache_lookup_store){
+
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto cache = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    UNIT_ASSERT(cache != nullptr);
+
+    UNIT_CHECK(cache->lookup("a").empty());
+    UNIT_CHECK(!cache->store("", vector<uint8_t>(10)));
+    UNIT_CHECK(!cache->store("a", vector<uint8_t>()));
+    UNIT_ASSERT(cache->store("a", vector<uint8_t>(100, 1), "engine a"));
+
+    auto file = cache->lookup("a");
+    UNIT_CHECK(file == directory + "/a.trtmodel");
+    UNIT_CHECK(iLogger::load_file(file) == vector<uint8_t>(100, 1));
+    UNIT_CHECK(cache->total_bytes() == 100);
+
+    auto entries = cache->entries();
+    UNIT_ASSERT(entries.size() == 1);
+    UNIT_CHECK(entries[0].key == "a" && entries[0].bytes == 100 && entries[0].descript == "engine a");
+
+    // engine文件被删除后，lookup不再命中
+    iLogger::delete_file(file);
+    UNIT_CHECK(cache->lookup("a").empty());
+    UNIT_CHECK(cache->entries().empty());
+
+    UNIT_ASSERT(cache->store("b", vector<uint8_t>(10)));
+    UNIT_CHECK(cache->remove("b"));
+    UNIT_CHECK(!cache->remove("b"));
+    UNIT_CHECK(!iLogger::exists(directory + "/b.trtmodel"));
+}
+
+UNIT_TEST(engine_cache_deferred_access){
+
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto cache = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    UNIT_ASSERT(cache != nullptr && cache->store("a", vector<uint8_t>(100)));
+
+    // 命中只更新内存中的访问时间，不写manifest
+    auto manifest = iLogger::load_file(directory + "/manifest.json");
+    uint64_t stored = manifest_access(directory, "a");
+    iLogger::sleep(5);
+    for(int i = 0; i < 100; ++i)
+        UNIT_CHECK(!cache->lookup("a").empty());
+    UNIT_CHECK(iLogger::load_file(directory + "/manifest.json") == manifest);
+    UNIT_CHECK(cache->entries()[0].last_access > stored);
+
+    UNIT_CHECK(cache->flush());
+    UNIT_CHECK(manifest_access(directory, "a") > stored);
+
+    // 析构时写入
+    uint64_t flushed = manifest_access(directory, "a");
+    iLogger::sleep(5);
+    cache->lookup("a");
+    cache.reset();
+    UNIT_CHECK(manifest_access(directory, "a") > flushed);
+}
+
+UNIT_TEST(engine_cache_evict_lru){
+
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto cache = TRT::create_engine_cache(directory, 2500, TEST_PLATFORM);
+    UNIT_ASSERT(cache != nullptr);
+
+    UNIT_ASSERT(cache->store("a", vector<uint8_t>(1000)));
+    iLogger::sleep(5);
+    UNIT_ASSERT(cache->store("b", vector<uint8_t>(1000)));
+    iLogger::sleep(5);
+
+    // a最近被访问过，写入c超出大小时淘汰b
+    UNIT_CHECK(!cache->lookup("a").empty());
+    iLogger::sleep(5);
+    UNIT_ASSERT(cache->store("c", vector<uint8_t>(1000)));
+
+    auto entries = cache->entries();
+    UNIT_CHECK(entries.size() == 2);
+    UNIT_CHECK(has_entry(entries, "a") && has_entry(entries, "c") && !has_entry(entries, "b"));
+    UNIT_CHECK(!iLogger::exists(directory + "/b.trtmodel"));
+    UNIT_CHECK(cache->total_bytes() == 2000);
+
+    // 刚写入的engine即使超出max_bytes也不会被淘汰
+    UNIT_ASSERT(cache->store("d", vector<uint8_t>(3000)));
+    entries = cache->entries();
+    UNIT_CHECK(entries.size() == 1 && entries[0].key == "d");
+
+    // 主动淘汰时没有保留的engine
+    UNIT_CHECK(cache->evict() == 1);
+    UNIT_CHECK(cache->entries().empty() && cache->total_bytes() == 0);
+}
+
+UNIT_TEST(engine_cache_shared_directory){
+
+    // 两个实例模拟共享同一个目录的两个进程，各自的写入都不会覆盖对方的记录
+    auto directory = UnitTest::temp_directory() + "cache";
+    auto c1 = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    auto c2 = TRT::create_engine_cache(directory, 0, TEST_PLATFORM);
+    UNIT_ASSERT(c1 != nullptr && c2 != nullptr);
+
+    UNIT_ASSERT(c1->store("a", vector<uint8_t>(10)));
+    UNIT_ASSERT(c2->store("b", vector<uint8_t>(20)));
+    UNIT_ASSERT(c1->store("c", vector<uint8_t>(30)));
+
+    auto entries = c1->entries();
+    UNIT_CHECK(entries.size() == 3);
+    UNIT_CHECK(has_entry(entries, "a") && has_entry(entries, "b") && has_entry(entries, "c"));
+    UNIT_CHECK(c1->total_bytes() == 60);
+
+    // c2的延迟访问时间在flush时合并，不会丢掉c1写入的c
+    uint64_t stored = manifest_access(directory, "a");
+    iLogger::sleep(5);
+    UNIT_CHECK(!c2->lookup("a").empty());
+    UNIT_CHECK(c2->flush());
+    UNIT_CHECK(manifest_access(directory, "a") > stored);
+    entries = c2->entries();
+    UNIT_CHECK(entries.size() == 3 && entries[0].key == "a");
+
+    UNIT_CHECK(c2->remove("c"));
+    UNIT_ASSERT(c1->store("d", vector<uint8_t>(40)));
+    entries = c1->entries();
+    UNIT_CHECK(entries.size() == 3 && !has_entry(entries, "c"));
+}
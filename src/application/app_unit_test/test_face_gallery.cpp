@@ -0,0 +1,247 @@
+
+#include "tools/face_gallery.hpp"
+#include "tools/unit_test.hpp"
+#include <common/ilogger.hpp>
+#include <random>
+#include <cmath>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const int DIM = 64;
+
+static vector<float> random_features(int num, unsigned seed){
+    mt19937 rng(seed);
+    normal_distribution<float> normal;
+    vector<float> output((size_t)num * DIM);
+    for(auto& v : output) v = normal(rng);
+    return output;
+}
+
+static int64_t file_size(const string& file){
+    struct stat st;
+    if(stat(file.c_str(), &st) != 0) return -1;
+    return st.st_size;
+}
+
+static FaceGallery::Config gallery_config(){
+    FaceGallery::Config config;
+    config.dim         = DIM;
+    config.num_threads = 2;
+    return config;
+}
+
+// 自身检索的第一个结果
+static int64_t nearest(const shared_ptr<FaceGallery::Gallery>& gallery, const float* feature){
+    auto matches = gallery->search(feature, 1, 1);
+    if(matches[0].empty()) return -1;
+    return matches[0][0].id;
+}
+
+UNIT_TEST(face_gallery_crc32c){
+
+    // crc32c的标准测试向量
+    UNIT_CHECK(FaceGallery::crc32c("123456789", 9) == 0xE3069283);
+    UNIT_CHECK(FaceGallery::crc32c("", 0) == 0);
+
+    // 分段计算与一次计算一致
+    string data = "The quick brown fox jumps over the lazy dog";
+    uint32_t crc = FaceGallery::crc32c(data.data(), 10);
+    UNIT_CHECK(FaceGallery::crc32c(data.data() + 10, data.size() - 10, crc) == FaceGallery::crc32c(data.data(), data.size()));
+}
+
+UNIT_TEST(face_gallery_log_replay){
+
+    auto directory = UnitTest::temp_directory() + "gallery";
+    auto features  = random_features(4, 1);
+    {
+        auto gallery = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+        UNIT_ASSERT(gallery != nullptr);
+        UNIT_CHECK(gallery->size() == 0);
+        for(int i = 0; i < 3; ++i)
+            UNIT_ASSERT(gallery->add(i, features.data() + i * DIM, iLogger::format("person%d", i)));
+
+        UNIT_CHECK(gallery->remove(1));
+        UNIT_CHECK(!gallery->remove(1));
+        UNIT_CHECK(gallery->add(2, features.data() + 3 * DIM, "renamed"));
+        UNIT_CHECK(gallery->size() == 2);
+    }
+
+    // 重新打开时重放日志，得到相同的状态
+    auto gallery = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+    UNIT_ASSERT(gallery != nullptr);
+    auto info = gallery->info();
+    UNIT_CHECK(info.generation == 1 && info.num_base == 0 && info.num_log == 5);
+    UNIT_CHECK(info.size == 2);
+    UNIT_CHECK(gallery->contains(0) && !gallery->contains(1) && gallery->contains(2));
+    UNIT_CHECK(gallery->name(0) == "person0");
+    UNIT_CHECK(gallery->name(2) == "renamed");
+    UNIT_CHECK(nearest(gallery, features.data() + 3 * DIM) == 2);
+    UNIT_CHECK(nearest(gallery, features.data()) == 0);
+
+    // 读者看到相同的内容，但不能写
+    auto reader = FaceGallery::open_gallery(directory, FaceGallery::Mode::Read, gallery_config());
+    UNIT_ASSERT(reader != nullptr);
+    UNIT_CHECK(reader->size() == 2 && reader->name(2) == "renamed");
+    UNIT_CHECK(!reader->add(5, features.data(), "reader"));
+    UNIT_CHECK(!reader->compact());
+
+    // 维度不一致时打开失败
+    auto config = gallery_config();
+    config.dim  = DIM * 2;
+    UNIT_CHECK(FaceGallery::open_gallery(directory, FaceGallery::Mode::Read, config) == nullptr);
+}
+
+UNIT_TEST(face_gallery_torn_tail){
+
+    auto directory = UnitTest::temp_directory() + "gallery";
+    auto log_file  = directory + "/gallery.log";
+    auto features  = random_features(3, 2);
+
+    int64_t complete_size = 0, full_size = 0;
+    {
+        auto gallery = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+        UNIT_ASSERT(gallery != nullptr);
+        UNIT_ASSERT(gallery->add(10, features.data(), "a"));
+        UNIT_ASSERT(gallery->add(11, features.data() + DIM, "b"));
+        complete_size = file_size(log_file);
+        UNIT_ASSERT(gallery->add(12, features.data() + 2 * DIM, "c"));
+        full_size = file_size(log_file);
+        UNIT_CHECK(gallery->info().log_bytes == (size_t)full_size);
+    }
+
+    // 模拟写最后一条记录时崩溃
+    UNIT_ASSERT(truncate(log_file.c_str(), full_size - 5) == 0);
+
+    // 读者忽略不完整的记录，但不修改文件
+    auto reader = FaceGallery::open_gallery(directory, FaceGallery::Mode::Read, gallery_config());
+    UNIT_ASSERT(reader != nullptr);
+    UNIT_CHECK(reader->size() == 2 && !reader->contains(12));
+    UNIT_CHECK(file_size(log_file) == full_size - 5);
+    reader.reset();
+
+    // 写者打开时截断到最后一条完整的记录，之后的追加是有效的
+    {
+        auto gallery = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+        UNIT_ASSERT(gallery != nullptr);
+        UNIT_CHECK(gallery->size() == 2 && gallery->contains(11) && !gallery->contains(12));
+        UNIT_CHECK(file_size(log_file) == complete_size);
+        UNIT_ASSERT(gallery->add(13, features.data() + 2 * DIM, "d"));
+    }
+
+    auto gallery = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+    UNIT_ASSERT(gallery != nullptr);
+    UNIT_CHECK(gallery->size() == 3 && gallery->name(13) == "d");
+
+    // crc错误的记录与之后的记录都被丢弃
+    int64_t before_last = file_size(log_file);
+    UNIT_ASSERT(gallery->add(14, features.data(), "e"));
+    gallery.reset();
+
+    auto data = iLogger::load_file(log_file);
+    UNIT_ASSERT((int64_t)data.size() > before_last + 32);
+    data[before_last + 32] ^= 0x5A;
+    UNIT_ASSERT(iLogger::save_file(log_file, data));
+
+    gallery = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+    UNIT_ASSERT(gallery != nullptr);
+    UNIT_CHECK(gallery->size() == 3 && !gallery->contains(14));
+    UNIT_CHECK(file_size(log_file) == before_last);
+}
+
+UNIT_TEST(face_gallery_single_writer){
+
+    auto directory = UnitTest::temp_directory() + "gallery";
+    auto features  = random_features(1, 3);
+
+    auto writer = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+    UNIT_ASSERT(writer != nullptr);
+    UNIT_ASSERT(writer->add(1, features.data(), "a"));
+
+    // 同一时间只能有一个写者，读者不受影响
+    UNIT_CHECK(FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config()) == nullptr);
+    auto reader = FaceGallery::open_gallery(directory, FaceGallery::Mode::Read, gallery_config());
+    UNIT_ASSERT(reader != nullptr);
+    UNIT_CHECK(reader->contains(1));
+
+    // 写者关闭后释放锁
+    writer.reset();
+    writer = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+    UNIT_ASSERT(writer != nullptr);
+    UNIT_CHECK(writer->contains(1));
+
+    // 读模式下目录不存在时失败
+    UNIT_CHECK(FaceGallery::open_gallery(UnitTest::temp_directory() + "missing", FaceGallery::Mode::Read, gallery_config()) == nullptr);
+}
+
+UNIT_TEST(face_gallery_compact_refresh){
+
+    const int num  = 200;
+    auto directory = UnitTest::temp_directory() + "gallery";
+    auto features  = random_features(num + 1, 4);
+
+    auto writer = FaceGallery::open_gallery(directory, FaceGallery::Mode::Write, gallery_config());
+    UNIT_ASSERT(writer != nullptr);
+    auto reader = FaceGallery::open_gallery(directory, FaceGallery::Mode::Read, gallery_config());
+    UNIT_ASSERT(reader != nullptr);
+    UNIT_CHECK(reader->size() == 0);
+
+    for(int i = 0; i < num; ++i)
+        UNIT_ASSERT(writer->add(i, features.data() + i * DIM, iLogger::format("id%d", i)));
+
+    // 读者refresh后读到新追加的记录
+    UNIT_CHECK(reader->size() == 0);
+    UNIT_ASSERT(reader->refresh());
+    UNIT_CHECK(reader->size() == num);
+    UNIT_CHECK(nearest(reader, features.data() + 7 * DIM) == 7);
+
+    // compact后日志为空，记录都在快照中
+    UNIT_ASSERT(writer->remove(3));
+    UNIT_ASSERT(writer->compact());
+    auto info = writer->info();
+    UNIT_CHECK(info.generation == 2);
+    UNIT_CHECK(info.num_log == 0 && info.num_base == num - 1 && info.size == num - 1);
+    UNIT_CHECK(writer->verify());
+
+    // 快照被替换，读者重新加载
+    UNIT_ASSERT(reader->refresh());
+    info = reader->info();
+    UNIT_CHECK(info.generation == 2 && info.num_base == num - 1 && info.num_log == 0);
+    UNIT_CHECK(!reader->contains(3) && reader->name(150) == "id150");
+    UNIT_CHECK(nearest(reader, features.data() + 150 * DIM) == 150);
+
+    vector<float> feature(DIM);
+    string name;
+    UNIT_ASSERT(reader->get(9, feature.data(), &name));
+    double dot = 0, norm = 0;
+    for(int i = 0; i < DIM; ++i){
+        dot  += feature[i] * features[9 * DIM + i];
+        norm += features[9 * DIM + i] * features[9 * DIM + i];
+    }
+    UNIT_CHECK(name == "id9" && std::fabs(dot / std::sqrt(norm) - 1) < 1e-4);
+
+    // 快照之后的修改在日志中，覆盖快照中的记录
+    UNIT_ASSERT(writer->add(5, features.data() + num * DIM, "replaced"));
+    UNIT_ASSERT(writer->remove(6));
+    UNIT_ASSERT(reader->refresh());
+    UNIT_CHECK(reader->size() == num - 2);
+    UNIT_CHECK(reader->name(5) == "replaced" && !reader->contains(6));
+    UNIT_CHECK(nearest(reader, features.data() + num * DIM) == 5);
+    UNIT_CHECK(nearest(reader, features.data() + 5 * DIM) != 5);
+
+    // 没有变化时refresh不做任何事
+    UNIT_ASSERT(reader->refresh());
+    UNIT_CHECK(reader->info().num_log == 2);
+
+    // 再次compact，重新打开后与之前一致
+    UNIT_ASSERT(writer->compact());
+    writer.reset();
+
+    auto config   = gallery_config();
+    config.verify = true;
+    auto reopened = FaceGallery::open_gallery(directory, FaceGallery::Mode::Read, config);
+    UNIT_ASSERT(reopened != nullptr);
+    UNIT_CHECK(reopened->info().generation == 3 && reopened->size() == num - 2);
+    UNIT_CHECK(reopened->name(5) == "replaced" && !reopened->contains(6) && !reopened->contains(3));
+}
@@ -0,0 +1,204 @@
+
+#include "tools/face_index.hpp"
+#include "tools/unit_test.hpp"
+#include <common/ilogger.hpp>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+static const int DIM         = 100;     // 不是16的倍数，覆盖补零的尾部
+static const int NUM_FEATURE = 2000;
+
+static vector<float> random_features(int num, int dim, unsigned seed){
+    mt19937 rng(seed);
+    normal_distribution<float> normal;
+    vector<float> output((size_t)num * dim);
+    for(auto& v : output) v = normal(rng);
+    return output;
+}
+
+static int64_t id_of(int row){
+    return row * 10 + 3;
+}
+
+static float tolerance(FaceIndex::Storage storage){
+    switch(storage){
+        case FaceIndex::Storage::Float32: return 1e-4f;
+        case FaceIndex::Storage::Float16: return 2e-3f;
+        default: return 2e-2f;
+    }
+}
+
+static shared_ptr<FaceIndex::Index> build_index(FaceIndex::Type type, FaceIndex::Storage storage, const vector<float>& features){
+
+    FaceIndex::Config config;
+    config.dim         = DIM;
+    config.type        = type;
+    config.storage     = storage;
+    config.nlist       = 16;
+    config.nprobe      = 2;
+    config.num_threads = 4;
+    auto index = FaceIndex::create_index(config);
+    if(index == nullptr) return nullptr;
+
+    if(!index->train(features.data(), NUM_FEATURE)) return nullptr;
+    for(int i = 0; i < NUM_FEATURE; ++i){
+        if(!index->add(id_of(i), features.data() + (size_t)i * DIM))
+            return nullptr;
+    }
+    return index;
+}
+
+static void check_index(FaceIndex::Type type, FaceIndex::Storage storage){
+
+    auto features = random_features(NUM_FEATURE, DIM, 17);
+    auto index    = build_index(type, storage, features);
+    UNIT_ASSERT(index != nullptr);
+    UNIT_CHECK(index->is_trained());
+    UNIT_CHECK(index->size() == NUM_FEATURE);
+    UNIT_CHECK(index->memory_bytes() > 0);
+
+    // 自身检索，IVF中query与添加时落在同一个簇，nprobe较小时召回也是100%
+    const int num_query = 256;
+    float eps = tolerance(storage);
+    auto results = index->search(features.data(), num_query, 5);
+    UNIT_ASSERT(results.size() == num_query);
+
+    int hit = 0;
+    for(int i = 0; i < num_query; ++i){
+        auto& matches = results[i];
+        if(matches.empty()) continue;
+        if(matches[0].id == id_of(i) && std::fabs(matches[0].score - 1.0f) < eps) hit++;
+
+        for(size_t j = 1; j < matches.size(); ++j)
+            UNIT_CHECK(matches[j - 1].score >= matches[j].score);
+    }
+    UNIT_CHECK(hit == num_query);
+
+    // 取回的特征与归一化后的原始特征一致
+    vector<float> feature(DIM);
+    UNIT_ASSERT(index->get(id_of(5), feature.data()));
+    double norm = 0, dot = 0;
+    for(int i = 0; i < DIM; ++i) norm += features[5 * DIM + i] * features[5 * DIM + i];
+    for(int i = 0; i < DIM; ++i) dot  += feature[i] * features[5 * DIM + i] / std::sqrt(norm);
+    UNIT_CHECK(std::fabs(dot - 1) < eps);
+
+    // 删除
+    UNIT_CHECK(index->contains(id_of(3)));
+    UNIT_CHECK(index->remove(id_of(3)));
+    UNIT_CHECK(!index->contains(id_of(3)));
+    UNIT_CHECK(!index->remove(id_of(3)));
+    UNIT_CHECK(!index->get(id_of(3), feature.data()));
+    UNIT_CHECK(index->size() == NUM_FEATURE - 1);
+    UNIT_CHECK(index->ids().size() == NUM_FEATURE - 1);
+
+    auto removed = index->search(features.data() + 3 * DIM, 1, 5);
+    UNIT_ASSERT(removed.size() == 1);
+    for(auto& match : removed[0])
+        UNIT_CHECK(match.id != id_of(3));
+
+    // 删除时与最后一行交换，被移动的特征仍然可以检索到
+    auto moved = index->search(features.data() + (NUM_FEATURE - 1) * DIM, 1, 1);
+    UNIT_CHECK(moved[0].size() == 1 && moved[0][0].id == id_of(NUM_FEATURE - 1));
+
+    // 已有的id再次添加时替换原来的特征
+    UNIT_ASSERT(index->add(id_of(7), features.data() + 8 * DIM));
+    UNIT_CHECK(index->size() == NUM_FEATURE - 1);
+
+    auto replaced = index->search(features.data() + 8 * DIM, 1, 2);
+    UNIT_ASSERT(replaced[0].size() == 2);
+    UNIT_CHECK(std::fabs(replaced[0][0].score - 1.0f) < eps && std::fabs(replaced[0][1].score - 1.0f) < eps);
+    UNIT_CHECK((replaced[0][0].id == id_of(7) && replaced[0][1].id == id_of(8)) || (replaced[0][0].id == id_of(8) && replaced[0][1].id == id_of(7)));
+
+    auto old_feature = index->search(features.data() + 7 * DIM, 1, 1);
+    UNIT_CHECK(old_feature[0].empty() || old_feature[0][0].id != id_of(7));
+
+    // topk为0或者num为0
+    auto no_topk = index->search(features.data(), 3, 0);
+    UNIT_CHECK(no_topk.size() == 3);
+    for(auto& matches : no_topk)
+        UNIT_CHECK(matches.empty());
+
+    UNIT_CHECK(index->search(features.data(), 0, 5).empty());
+    UNIT_CHECK(index->search(nullptr, 0, 5).empty());
+}
+
+UNIT_TEST(face_index_flat){
+    check_index(FaceIndex::Type::Flat, FaceIndex::Storage::Float32);
+    check_index(FaceIndex::Type::Flat, FaceIndex::Storage::Float16);
+    check_index(FaceIndex::Type::Flat, FaceIndex::Storage::Int8);
+}
+
+UNIT_TEST(face_index_ivf){
+    check_index(FaceIndex::Type::IVF, FaceIndex::Storage::Float32);
+    check_index(FaceIndex::Type::IVF, FaceIndex::Storage::Float16);
+    check_index(FaceIndex::Type::IVF, FaceIndex::Storage::Int8);
+}
+
+UNIT_TEST(face_index_small){
+
+    FaceIndex::Config config;
+    config.dim  = DIM;
+    config.type = FaceIndex::Type::IVF;
+    config.nlist = 4;
+
+    // IVF训练之前不能添加和检索，样本数少于nlist时训练失败
+    auto features = random_features(8, DIM, 3);
+    auto index = FaceIndex::create_index(config);
+    UNIT_ASSERT(index != nullptr);
+    UNIT_CHECK(!index->is_trained());
+    UNIT_CHECK(!index->add(1, features.data()));
+    UNIT_CHECK(index->search(features.data(), 1, 1)[0].empty());
+    UNIT_CHECK(!index->train(features.data(), 3));
+    UNIT_ASSERT(index->train(features.data(), 8));
+
+    // topk超过底库大小时返回全部
+    for(int i = 0; i < 3; ++i)
+        UNIT_ASSERT(index->add(i, features.data() + i * DIM));
+
+    index->set_nprobe(config.nlist);
+    auto results = index->search(features.data(), 1, 10);
+    UNIT_CHECK(results[0].size() == 3 && results[0][0].id == 0);
+
+    config.dim = 0;
+    UNIT_CHECK(FaceIndex::create_index(config) == nullptr);
+}
+
+UNIT_TEST(face_index_rows){
+
+    const int num = 100;
+    int stride    = FaceIndex::aligned_dim(DIM);
+    UNIT_CHECK(stride == 112);
+
+    auto features = random_features(num, DIM, 5);
+    vector<float> rows((size_t)num * stride, 0);
+    vector<int64_t> ids(num);
+    vector<uint8_t> valid(num, 1);
+    for(int i = 0; i < num; ++i){
+        double norm = 0;
+        for(int j = 0; j < DIM; ++j) norm += features[i * DIM + j] * features[i * DIM + j];
+        for(int j = 0; j < DIM; ++j) rows[(size_t)i * stride + j] = features[i * DIM + j] / std::sqrt(norm);
+        ids[i] = id_of(i);
+    }
+    valid[4] = 0;
+
+    FaceIndex::RowView view;
+    view.features = rows.data();
+    view.ids      = ids.data();
+    view.valid    = valid.data();
+    view.num_rows = num;
+    view.stride   = stride;
+
+    FaceIndex::Config config;
+    config.dim = DIM;
+    auto results = FaceIndex::search_rows(view, config, features.data(), 5, 1);
+    UNIT_ASSERT(results.size() == 5);
+    UNIT_CHECK(results[0][0].id == id_of(0) && results[3][0].id == id_of(3));
+    UNIT_CHECK(results[4].empty() || results[4][0].id != id_of(4));
+    UNIT_CHECK(FaceIndex::search_rows(view, config, features.data(), 2, 0)[1].empty());
+
+    // stride不是16的倍数
+    view.stride = DIM;
+    UNIT_CHECK(FaceIndex::search_rows(view, config, features.data(), 1, 1)[0].empty());
+}
@@ -0,0 +1,232 @@
+
+#include "tools/face_pipeline.hpp"
+#include "tools/unit_test.hpp"
+#include <common/ilogger.hpp>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+// 帧号写在像素中，第frame帧有frame % 4个人脸
+static cv::Mat make_frame(int frame){
+    return cv::Mat(8, 8, CV_8UC3, cv::Scalar(frame, frame, frame));
+}
+
+static int frame_of(const cv::Mat& image){
+    return image.ptr<uint8_t>(0)[0];
+}
+
+// 人脸i的大小为20 + 10 * i，置信度随i增大，landmark[0]记录帧号和人脸序号
+static FaceDetector::BoxArray mock_detect(int frame){
+    FaceDetector::BoxArray boxes(frame % 4);
+    for(size_t i = 0; i < boxes.size(); ++i){
+        auto& box      = boxes[i];
+        box.left       = 10 * i;
+        box.top        = 0;
+        box.right      = box.left + 20 + 10 * i;
+        box.bottom     = box.top  + 20 + 10 * i;
+        box.confidence = 0.5f + 0.1f * i;
+        memset(box.landmark, 0, sizeof(box.landmark));
+        box.landmark[0] = frame * 100 + i;
+    }
+    return boxes;
+}
+
+static FacePipeline::DetectFunction mock_detector(){
+    return [](const cv::Mat& image){
+        int frame = frame_of(image);
+        return std::async(std::launch::async, [frame](){
+            this_thread::sleep_for(chrono::milliseconds(1));
+            return mock_detect(frame);
+        }).share();
+    };
+}
+
+// 对齐后的“图像”是1x1的float，保存landmark[0]，记录每次调用的人脸数
+class MockAlign{
+public:
+    FacePipeline::AlignFunction function(int drop = 0){
+        return [this, drop](const cv::Mat& image, const vector<Arcface::landmarks>& faces){
+            {
+                unique_lock<mutex> l(lock_);
+                batch_sizes.emplace_back(faces.size());
+            }
+
+            vector<cv::Mat> output;
+            for(size_t i = 0; i + drop < faces.size(); ++i){
+                cv::Mat face(1, 1, CV_32F);
+                face.ptr<float>(0)[0] = faces[i].points[0];
+                output.emplace_back(face);
+            }
+            return output;
+        };
+    }
+
+    mutex lock_;
+    vector<size_t> batch_sizes;
+};
+
+// 特征的第0维是对齐后的值，第1维是这一批的人脸数。hold为true时特征在release之后才返回
+class MockEmbed{
+public:
+    MockEmbed(bool hold = false):hold_(hold){}
+
+    FacePipeline::EmbedFunction function(){
+        return [this](const vector<Arcface::commit_input>& faces){
+            vector<shared_future<Arcface::feature>> output;
+            unique_lock<mutex> l(lock_);
+            num_calls++;
+            for(auto& face : faces){
+                Arcface::feature feature(1, 2);
+                feature(0, 0) = get<0>(face).ptr<float>(0)[0];
+                feature(0, 1) = faces.size();
+
+                auto pro = make_shared<promise<Arcface::feature>>();
+                output.emplace_back(pro->get_future().share());
+                if(hold_){
+                    pending_.emplace_back(pro, feature);
+                }else{
+                    pro->set_value(feature);
+                }
+            }
+            return output;
+        };
+    }
+
+    void release(){
+        unique_lock<mutex> l(lock_);
+        for(auto& item : pending_)
+            item.first->set_value(item.second);
+        pending_.clear();
+    }
+
+    int num_calls = 0;
+
+private:
+    bool hold_ = false;
+    mutex lock_;
+    vector<pair<shared_ptr<promise<Arcface::feature>>, Arcface::feature>> pending_;
+};
+
+UNIT_TEST(face_pipeline_order){
+
+    MockAlign align;
+    MockEmbed embed;
+    auto pipeline = FacePipeline::create_pipeline(mock_detector(), embed.function(), FacePipeline::Config(), align.function());
+    UNIT_ASSERT(pipeline != nullptr);
+
+    const int num_frames = 20;
+    vector<cv::Mat> frames;
+    for(int i = 0; i < num_frames; ++i)
+        frames.emplace_back(make_frame(i));
+
+    // 结果按提交顺序返回，每个人脸的框与特征对应
+    auto results = pipeline->commits(frames);
+    UNIT_ASSERT(results.size() == num_frames);
+
+    size_t num_faces = 0;
+    for(int frame = 0; frame < num_frames; ++frame){
+        auto result = results[frame].get();
+        UNIT_ASSERT(result.faces.size() == (size_t)(frame % 4));
+        for(size_t i = 0; i < result.faces.size(); ++i){
+            auto& face = result.faces[i];
+            UNIT_CHECK(face.box.landmark[0] == frame * 100 + i);
+            UNIT_CHECK(face.feature(0, 0) == frame * 100 + i);
+            UNIT_CHECK(face.feature(0, 1) == result.faces.size());
+        }
+        UNIT_CHECK(result.timing.total >= result.timing.detect);
+        num_faces += result.faces.size();
+    }
+
+    // 每帧所有人脸一次对齐、一次提交特征提取，没有人脸的帧不调用
+    UNIT_CHECK(embed.num_calls == num_frames / 4 * 3);
+    UNIT_CHECK(align.batch_sizes.size() == num_frames / 4 * 3);
+    for(auto size : align.batch_sizes)
+        UNIT_CHECK(size >= 1 && size <= 3);
+
+    auto statistics = pipeline->statistics();
+    UNIT_CHECK(statistics.num_frames == num_frames);
+    UNIT_CHECK(statistics.num_faces == num_faces);
+    UNIT_CHECK(statistics.average.total > 0);
+
+    pipeline->reset_statistics();
+    UNIT_CHECK(pipeline->statistics().num_frames == 0);
+}
+
+UNIT_TEST(face_pipeline_select){
+
+    MockAlign align;
+    MockEmbed embed;
+    FacePipeline::Config config;
+    config.max_faces     = 1;
+    config.min_face_size = 25;
+    auto pipeline = FacePipeline::create_pipeline(mock_detector(), embed.function(), config, align.function());
+    UNIT_ASSERT(pipeline != nullptr);
+
+    // 第3帧的人脸大小为20、30、40，丢弃20之后保留置信度最高的一个
+    auto result = pipeline->commit(make_frame(3)).get();
+    UNIT_ASSERT(result.faces.size() == 1);
+    UNIT_CHECK(result.faces[0].box.landmark[0] == 302);
+
+    // 只有一个太小的人脸
+    result = pipeline->commit(make_frame(1)).get();
+    UNIT_CHECK(result.faces.empty());
+    UNIT_CHECK(align.batch_sizes.size() == 1);
+}
+
+UNIT_TEST(face_pipeline_inflight){
+
+    MockAlign align;
+    MockEmbed embed(true);
+    FacePipeline::Config config;
+    config.max_inflight = 2;
+    auto pipeline = FacePipeline::create_pipeline(mock_detector(), embed.function(), config, align.function());
+    UNIT_ASSERT(pipeline != nullptr);
+
+    // 特征没有返回时，第3帧的commit阻塞
+    auto first  = pipeline->commit(make_frame(1));
+    auto second = pipeline->commit(make_frame(2));
+
+    atomic<bool> committed(false);
+    shared_future<FacePipeline::Result> third;
+    thread t([&](){
+        third = pipeline->commit(make_frame(3));
+        committed = true;
+    });
+
+    this_thread::sleep_for(chrono::milliseconds(100));
+    UNIT_CHECK(!committed);
+    UNIT_CHECK(first.wait_for(chrono::seconds(0)) != future_status::ready);
+
+    // 释放之后第3帧提交，再次释放后全部完成
+    embed.release();
+    UNIT_CHECK(first.get().faces.size() == 1);
+    UNIT_CHECK(second.get().faces.size() == 2);
+
+    while(!committed){
+        embed.release();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    t.join();
+
+    while(third.wait_for(chrono::milliseconds(1)) != future_status::ready)
+        embed.release();
+    UNIT_CHECK(third.get().faces.size() == 3);
+}
+
+UNIT_TEST(face_pipeline_mismatch){
+
+    // 对齐少返回一个人脸时，结果只保留对齐成功的人脸，不会阻塞
+    MockAlign align;
+    MockEmbed embed;
+    auto pipeline = FacePipeline::create_pipeline(mock_detector(), embed.function(), FacePipeline::Config(), align.function(1));
+    UNIT_ASSERT(pipeline != nullptr);
+
+    auto result = pipeline->commit(make_frame(3)).get();
+    UNIT_ASSERT(result.faces.size() == 2);
+    UNIT_CHECK(result.faces[1].feature(0, 0) == 301);
+
+    UNIT_CHECK(FacePipeline::create_pipeline(nullptr, embed.function()) == nullptr);
+    UNIT_CHECK(FacePipeline::create_pipeline(mock_detector(), nullptr) == nullptr);
+}
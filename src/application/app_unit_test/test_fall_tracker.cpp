@@ -0,0 +1,177 @@
+
+#include "app_fall_gcn/fall_tracker.hpp"
+#include "tools/unit_test.hpp"
+#include <common/ilogger.hpp>
+
+using namespace std;
+
+// 记录每次commit_sequences提交的序列，结果的score是序列最后一帧第0个关键点的y
+class MockInfer : public FallGCN::Infer{
+public:
+    MockInfer(int window):window_(window){}
+
+    virtual shared_future<tuple<FallGCN::FallState, float>> commit(const FallGCN::Input& input) override{
+        return commit_sequences({FallGCN::Sequence{input}})[0];
+    }
+
+    virtual vector<shared_future<tuple<FallGCN::FallState, float>>> commits(const vector<FallGCN::Input>& inputs) override{
+        vector<shared_future<tuple<FallGCN::FallState, float>>> output;
+        for(auto& input : inputs)
+            output.emplace_back(commit(input));
+        return output;
+    }
+
+    virtual vector<shared_future<tuple<FallGCN::FallState, float>>> commit_sequences(const vector<FallGCN::Sequence>& sequences) override{
+        calls.emplace_back(sequences);
+
+        vector<shared_future<tuple<FallGCN::FallState, float>>> output;
+        for(auto& sequence : sequences){
+            promise<tuple<FallGCN::FallState, float>> pro;
+            pro.set_value(make_tuple(FallGCN::FallState::Stand, get<0>(sequence.back())[0].y));
+            output.emplace_back(pro.get_future().share());
+        }
+        return output;
+    }
+
+    virtual int window_size() const override{
+        return window_;
+    }
+
+    vector<vector<FallGCN::Sequence>> calls;
+
+private:
+    int window_ = 1;
+};
+
+// 框内的4个关键点，x方向偏移offset（以框宽为单位），第0个关键点的y记录轨迹id
+static FallGCN::TrackInput make_track(int id, float offset = 0, int box_x = 100, float confidence = 1.0f){
+    cv::Rect box(box_x, 200, 50, 100);
+    vector<cv::Point3f> keys;
+    keys.emplace_back(box_x + 10 + offset * 100, id, confidence);
+    for(int i = 1; i < 4; ++i)
+        keys.emplace_back(box_x + 10 * i + offset * 100, 250 + 10 * i, confidence);
+    return make_tuple(id, keys, box);
+}
+
+static float score_of(const FallGCN::TrackResult& result){
+    return get<1>(result.result.get());
+}
+
+UNIT_TEST(fall_tracker_ring){
+
+    auto infer = make_shared<MockInfer>(4);
+    FallGCN::TrackerConfig config;
+    config.motion_threshold = 0;
+    auto tracker = FallGCN::create_tracker(infer, config);
+    UNIT_ASSERT(tracker != nullptr);
+    UNIT_CHECK(tracker->window_size() == 4);
+
+    // 每帧框的x为frame，序列中按时间从早到晚，超过窗口后覆盖最早的一帧
+    for(int frame = 0; frame < 7; ++frame){
+        auto results = tracker->update({make_track(1, 0, frame)});
+        UNIT_ASSERT(results.size() == 1 && !results[0].skipped);
+        UNIT_ASSERT(infer->calls.size() == (size_t)frame + 1);
+
+        auto& sequences = infer->calls.back();
+        UNIT_ASSERT(sequences.size() == 1);
+        auto& sequence = sequences[0];
+        UNIT_ASSERT(sequence.size() == (size_t)std::min(frame + 1, 4));
+
+        int first = std::max(0, frame - 3);
+        for(size_t i = 0; i < sequence.size(); ++i)
+            UNIT_CHECK(get<1>(sequence[i]).x == first + (int)i);
+    }
+
+    auto statistics = tracker->statistics();
+    UNIT_CHECK(statistics.num_frames == 7 && statistics.num_inferred == 7 && statistics.num_skipped == 0);
+    UNIT_CHECK(FallGCN::create_tracker(nullptr) == nullptr);
+}
+
+UNIT_TEST(fall_tracker_skip){
+
+    auto infer = make_shared<MockInfer>(4);
+    FallGCN::TrackerConfig config;
+    config.motion_threshold = 0.02f;
+    config.max_skip_frames  = 3;
+    auto tracker = FallGCN::create_tracker(infer, config);
+    UNIT_ASSERT(tracker != nullptr);
+
+    // 第一帧推理，之后姿态不变时跳过，连续跳过max_skip_frames帧后强制推理
+    auto first = tracker->update({make_track(1)});
+    UNIT_CHECK(!first[0].skipped);
+    for(int i = 0; i < 3; ++i){
+        auto result = tracker->update({make_track(1)});
+        UNIT_CHECK(result[0].skipped && result[0].id == 1);
+        UNIT_CHECK(score_of(result[0]) == 1);
+    }
+    UNIT_CHECK(!tracker->update({make_track(1)})[0].skipped);
+    UNIT_CHECK(infer->calls.size() == 2);
+
+    // 框和关键点一起平移不算姿态变化
+    UNIT_CHECK(tracker->update({make_track(1, 0, 300)})[0].skipped);
+
+    // 平均位移低于阈值时跳过，达到阈值时推理
+    UNIT_CHECK(tracker->update({make_track(1, 0.01f)})[0].skipped);
+    UNIT_CHECK(!tracker->update({make_track(1, 0.03f)})[0].skipped);
+
+    // 置信度低的关键点不参与比较，全部低于min_confidence时总是推理
+    UNIT_CHECK(!tracker->update({make_track(1, 0.03f, 100, 0.01f)})[0].skipped);
+    UNIT_CHECK(!tracker->update({make_track(1, 0.03f, 100, 0.01f)})[0].skipped);
+
+    auto statistics = tracker->statistics();
+    UNIT_CHECK(statistics.num_inferred == 5 && statistics.num_skipped == 5);
+
+    // 阈值<= 0时不跳过
+    config.motion_threshold = 0;
+    auto always = FallGCN::create_tracker(infer, config);
+    always->update({make_track(1)});
+    UNIT_CHECK(!always->update({make_track(1)})[0].skipped);
+}
+
+UNIT_TEST(fall_tracker_batch){
+
+    auto infer = make_shared<MockInfer>(4);
+    FallGCN::TrackerConfig config;
+    config.max_skip_frames    = 100;
+    config.max_missing_frames = 2;
+    auto tracker = FallGCN::create_tracker(infer, config);
+    UNIT_ASSERT(tracker != nullptr);
+
+    // 一帧中需要推理的轨迹在一次commit_sequences中提交，结果与输入的顺序一一对应
+    auto results = tracker->update({make_track(7), make_track(3), make_track(5)});
+    UNIT_ASSERT(results.size() == 3 && infer->calls.size() == 1);
+    UNIT_CHECK(infer->calls[0].size() == 3);
+    UNIT_CHECK(results[0].id == 7 && results[1].id == 3 && results[2].id == 5);
+    UNIT_CHECK(score_of(results[0]) == 7 && score_of(results[1]) == 3 && score_of(results[2]) == 5);
+
+    // 只有移动的轨迹被提交，跳过的轨迹使用自己上次的结果
+    results = tracker->update({make_track(3), make_track(5, 0.1f), make_track(7)});
+    UNIT_ASSERT(infer->calls.size() == 2 && infer->calls[1].size() == 1);
+    UNIT_CHECK(get<0>(infer->calls[1][0].back())[0].y == 5);
+    UNIT_CHECK(results[0].skipped && score_of(results[0]) == 3);
+    UNIT_CHECK(!results[1].skipped && score_of(results[1]) == 5);
+    UNIT_CHECK(results[2].skipped && score_of(results[2]) == 7);
+
+    // 新的轨迹与跳过的轨迹在同一帧
+    results = tracker->update({make_track(3), make_track(9), make_track(5, 0.1f)});
+    UNIT_ASSERT(infer->calls.size() == 3 && infer->calls[2].size() == 1);
+    UNIT_CHECK(results[1].id == 9 && !results[1].skipped && score_of(results[1]) == 9);
+
+    // 全部跳过时不提交
+    tracker->update({make_track(3), make_track(9)});
+    UNIT_CHECK(infer->calls.size() == 3);
+    UNIT_CHECK(tracker->update({}).empty());
+
+    // 超过max_missing_frames帧没有出现的轨迹被删除，再次出现时重新开始，7在最后3帧中都没有出现
+    UNIT_CHECK(tracker->statistics().num_histories == 3);
+    tracker->update({make_track(3)});
+    tracker->update({make_track(3)});
+    UNIT_CHECK(tracker->statistics().num_histories == 1);
+
+    results = tracker->update({make_track(7)});
+    UNIT_CHECK(!results[0].skipped);
+    UNIT_CHECK(infer->calls.back()[0].size() == 1);
+
+    tracker->clear();
+    UNIT_CHECK(tracker->statistics().num_histories == 0);
+}
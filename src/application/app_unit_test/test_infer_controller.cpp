@@ -0,0 +1,247 @@
+
+#include <common/infer_controller.hpp>
+#include <infer/trt_profile.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <algorithm>
+
+using namespace std;
+
+static TRT::ProfileShape make_shape(const vector<int>& min, const vector<int>& opt, const vector<int>& max){
+    TRT::ProfileShape shape;
+    shape.min = min;
+    shape.opt = opt;
+    shape.max = max;
+    return shape;
+}
+
+// 不做推理的controller，job的bucket为input / 100，-1时不区分。worker在start之后才开始取job，便于一次看到所有排队的job
+class BucketController : public InferController<int, int>{
+public:
+    virtual ~BucketController(){
+        stop();
+    }
+
+    bool startup(int max_batch_size, bool use_bucket){
+        use_bucket_ = use_bucket;
+        return InferController::startup(make_tuple(string(), max_batch_size));
+    }
+
+    void start(){
+        start_.set_value();
+    }
+
+    vector<vector<int>> batches;
+
+protected:
+    virtual void worker(promise<bool>& result) override{
+
+        int max_batch_size = get<1>(start_param_);
+        tensor_allocator_  = make_shared<MonopolyAllocator<TRT::Tensor>>(64);
+        result.set_value(true);
+        start_.get_future().wait();
+
+        vector<Job> fetch_jobs;
+        while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+            vector<int> batch;
+            for(auto& job : fetch_jobs){
+                batch.emplace_back(job.input);
+                job.mono_tensor->release();
+            }
+            batches.emplace_back(batch);
+
+            for(auto& job : fetch_jobs)
+                job.pro->set_value(job.input);
+            fetch_jobs.clear();
+        }
+    }
+
+    virtual bool preprocess(Job& job, const int& input) override{
+        job.mono_tensor = tensor_allocator_->query();
+        if(job.mono_tensor == nullptr)
+            return false;
+
+        job.input = input;
+        return true;
+    }
+
+    virtual int job_bucket(const Job& job) override{
+        return use_bucket_ ? job.input / 100 : -1;
+    }
+
+private:
+    bool use_bucket_ = false;
+    promise<void> start_;
+};
+
+// 模拟InferImpl::forward按输入尺寸选择profile：input为图片的边长，batch没有profile能容纳时forward失败
+class ProfileController : public InferController<int, int>{
+public:
+    virtual ~ProfileController(){
+        stop();
+    }
+
+    bool startup(const TRT::ProfileTable& profiles, int max_batch_size){
+        profiles_ = profiles;
+        return InferController::startup(make_tuple(string(), max_batch_size));
+    }
+
+protected:
+    virtual void worker(promise<bool>& result) override{
+
+        int max_batch_size = get<1>(start_param_);
+        tensor_allocator_  = make_shared<MonopolyAllocator<TRT::Tensor>>(64);
+        result.set_value(true);
+
+        vector<Job> fetch_jobs;
+        while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
+            int size = fetch_jobs[0].input;
+            if(TRT::select_profile(profiles_, {{(int)fetch_jobs.size(), 3, size, size}}) == -1){
+                fail_jobs(fetch_jobs);
+                continue;
+            }
+
+            for(auto& job : fetch_jobs){
+                job.mono_tensor->release();
+                job.pro->set_value(job.input);
+            }
+            fetch_jobs.clear();
+        }
+    }
+
+    virtual bool preprocess(Job& job, const int& input) override{
+        job.mono_tensor = tensor_allocator_->query();
+        if(job.mono_tensor == nullptr)
+            return false;
+
+        job.input = input;
+        return true;
+    }
+
+    virtual int job_bucket(const Job& job) override{
+        return job.input;
+    }
+
+private:
+    TRT::ProfileTable profiles_;
+};
+
+static vector<vector<int>> run_controller(const vector<int>& inputs, int max_batch_size, bool use_bucket){
+
+    BucketController controller;
+    if(!controller.startup(max_batch_size, use_bucket))
+        return {};
+
+    auto results = controller.commits(inputs);
+    controller.start();
+    for(size_t i = 0; i < inputs.size(); ++i){
+        if(results[i].get() != inputs[i])
+            UnitTest::report_failure(__FILE__, __LINE__, iLogger::format("result %d mismatch", (int)i).c_str());
+    }
+    return controller.batches;
+}
+
+UNIT_TEST(profile_contains){
+
+    auto shape = make_shape({1, 3, 320, 320}, {4, 3, 320, 640}, {8, 3, 640, 640});
+    UNIT_CHECK(shape.contains({1, 3, 320, 320}));
+    UNIT_CHECK(shape.contains({8, 3, 640, 480}));
+    UNIT_CHECK(!shape.contains({9, 3, 640, 640}));
+    UNIT_CHECK(!shape.contains({1, 3, 160, 320}));
+    UNIT_CHECK(!shape.contains({1, 3, 320}));
+    UNIT_CHECK(shape.max_volume() == 8 * 3 * 640 * 640);
+}
+
+UNIT_TEST(select_profile){
+
+    // 0: 大尺寸，1: 小尺寸，2: 横向的矩形
+    TRT::ProfileTable profiles{
+        {make_shape({1, 3, 320, 320}, {8, 3, 640, 640}, {16, 3, 640, 640})},
+        {make_shape({1, 3, 320, 320}, {8, 3, 320, 320}, {16, 3, 320, 320})},
+        {make_shape({1, 3, 384, 640}, {8, 3, 384, 640}, {16, 3, 384, 640})}
+    };
+
+    UNIT_CHECK(TRT::select_profile(profiles, {{4, 3, 320, 320}}) == 1);
+    UNIT_CHECK(TRT::select_profile(profiles, {{4, 3, 384, 640}}) == 2);
+    UNIT_CHECK(TRT::select_profile(profiles, {{4, 3, 640, 640}}) == 0);
+    UNIT_CHECK(TRT::select_profile(profiles, {{4, 3, 480, 480}}) == 0);
+    UNIT_CHECK(TRT::select_profile(profiles, {{32, 3, 320, 320}}) == -1);
+    UNIT_CHECK(TRT::select_profile(profiles, {{4, 3, 800, 800}}) == -1);
+
+    // 输入个数不一致的profile不参与选择
+    UNIT_CHECK(TRT::select_profile(profiles, {{4, 3, 320, 320}, {4, 10}}) == -1);
+    UNIT_CHECK(TRT::select_profile({}, {{1, 3, 320, 320}}) == -1);
+
+    // 多个输入时按所有输入的max尺寸之和比较，相同时取序号小的
+    TRT::ProfileTable two_inputs{
+        {make_shape({1, 8}, {1, 8}, {1, 64}), make_shape({1, 4}, {1, 4}, {1, 64})},
+        {make_shape({1, 8}, {1, 8}, {1, 16}), make_shape({1, 4}, {1, 4}, {1, 16})},
+        {make_shape({1, 8}, {1, 8}, {1, 16}), make_shape({1, 4}, {1, 4}, {1, 16})}
+    };
+    UNIT_CHECK(TRT::select_profile(two_inputs, {{1, 10}, {1, 10}}) == 1);
+    UNIT_CHECK(TRT::select_profile(two_inputs, {{1, 10}, {1, 20}}) == 0);
+}
+
+UNIT_TEST(infer_controller_no_bucket){
+
+    // 不区分bucket时按顺序每max_batch_size个组成一个batch
+    vector<int> inputs{1, 101, 2, 102, 3, 201, 4};
+    auto batches = run_controller(inputs, 3, false);
+    UNIT_ASSERT(batches.size() == 3);
+    UNIT_CHECK(batches[0] == vector<int>({1, 101, 2}));
+    UNIT_CHECK(batches[1] == vector<int>({102, 3, 201}));
+    UNIT_CHECK(batches[2] == vector<int>({4}));
+}
+
+UNIT_TEST(infer_controller_bucket){
+
+    vector<int> inputs{1, 101, 2, 102, 3, 201, 4, 5, 103, 6};
+    auto batches = run_controller(inputs, 3, true);
+
+    // 每个batch取队首job的bucket，其余bucket的job保持原来的顺序留在队列中
+    vector<vector<int>> expected{
+        {1, 2, 3},
+        {101, 102, 103},
+        {201},
+        {4, 5, 6}
+    };
+    UNIT_CHECK(batches == expected);
+
+    // 所有job都被处理，同一个bucket内的顺序不变
+    vector<int> flatten;
+    for(auto& batch : batches){
+        UNIT_CHECK(!batch.empty() && (int)batch.size() <= 3);
+        for(auto& value : batch){
+            UNIT_CHECK(value / 100 == batch[0] / 100);
+            flatten.emplace_back(value);
+        }
+    }
+    std::sort(flatten.begin(), flatten.end());
+    auto sorted_inputs = inputs;
+    std::sort(sorted_inputs.begin(), sorted_inputs.end());
+    UNIT_CHECK(flatten == sorted_inputs);
+}
+
+UNIT_TEST(infer_controller_no_profile){
+
+    TRT::ProfileTable profiles{
+        {make_shape({1, 3, 320, 320}, {4, 3, 320, 320}, {4, 3, 320, 320})},
+        {make_shape({1, 3, 640, 640}, {4, 3, 640, 640}, {4, 3, 640, 640})}
+    };
+
+    ProfileController controller;
+    UNIT_ASSERT(controller.startup(profiles, 4));
+
+    // 800超出所有profile，这些job返回空的结果，不影响其他尺寸的job
+    vector<int> inputs{320, 800, 640, 800, 320};
+    auto results = controller.commits(inputs);
+    UNIT_ASSERT(results.size() == inputs.size());
+    for(size_t i = 0; i < inputs.size(); ++i){
+        int expected = inputs[i] == 800 ? 0 : inputs[i];
+        UNIT_CHECK(results[i].get() == expected);
+    }
+
+    // 失败的job释放了tensor，之后的job仍然可以提交
+    UNIT_CHECK(controller.commit(640).get() == 640);
+    UNIT_CHECK(controller.commit(800).get() == 0);
+}
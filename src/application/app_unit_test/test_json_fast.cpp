@@ -0,0 +1,159 @@
+
+#include <common/json_fast.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <limits>
+
+using namespace std;
+
+// 计数的SAX handler，不保存值
+class CountHandler : public FastJson::Handler{
+public:
+    virtual bool null() override{return ++values, true;}
+    virtual bool boolean(bool) override{return ++values, true;}
+    virtual bool number(double, int64_t, bool) override{return ++values, true;}
+    virtual bool string(const char*, size_t) override{return ++values, true;}
+    virtual bool key(const char*, size_t) override{return ++keys, true;}
+    virtual bool start_object() override{return true;}
+    virtual bool end_object(size_t) override{return true;}
+    virtual bool start_array() override{return true;}
+    virtual bool end_array(size_t) override{return true;}
+
+    int values = 0;
+    int keys   = 0;
+};
+
+static std::string nested_arrays(int depth){
+    return std::string(depth, '[') + std::string(depth, ']');
+}
+
+UNIT_TEST(json_fast_malformed){
+
+    const char* inputs[] = {
+        "", " ", "{", "[", "[1,", "[1,]", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{a:1}",
+        "\"abc", "\"\\x\"", "\"\\u12\"", "tru", "nul", "falsey", "01x", "-", "1.", "1e", "+1",
+        "[1 2]", "{\"a\":1 \"b\":2}", "1 2", "]", "\"a\nb\""
+    };
+
+    FastJson::Document doc;
+    for(auto input : inputs){
+        bool ok = doc.parse(input, strlen(input));
+        if(ok) UnitTest::report_failure(__FILE__, __LINE__, iLogger::format("parsed malformed input: %s", input).c_str());
+        UNIT_CHECK(!doc.error().empty());
+    }
+
+    // 错误信息包含出错的位置
+    UNIT_CHECK(!doc.parse("[1, 2, x]"));
+    UNIT_CHECK(doc.error().find("offset 7") != std::string::npos);
+
+    // 失败之后可以继续解析
+    UNIT_ASSERT(doc.parse("{\"a\": [1, 2]}"));
+    UNIT_CHECK(doc.root()["a"].size() == 2);
+
+    std::string text = "[1, {\"a\": }]";
+    CountHandler handler;
+    std::string error;
+    UNIT_CHECK(!FastJson::parse_sax(&text[0], text.size(), handler, &error));
+    UNIT_CHECK(!error.empty());
+}
+
+UNIT_TEST(json_fast_depth_limit){
+
+    FastJson::Document doc;
+    UNIT_CHECK(doc.parse(nested_arrays(512)));
+    UNIT_CHECK(!doc.parse(nested_arrays(513)));
+    UNIT_CHECK(doc.error().find("nesting too deep") != std::string::npos);
+
+    // 很深的输入不会导致栈溢出
+    UNIT_CHECK(!doc.parse(nested_arrays(100000)));
+
+    std::string objects;
+    for(int i = 0; i < 600; ++i) objects += "{\"a\":";
+    objects += "1";
+    objects += std::string(600, '}');
+    UNIT_CHECK(!doc.parse(objects));
+    UNIT_CHECK(doc.error().find("nesting too deep") != std::string::npos);
+}
+
+UNIT_TEST(json_fast_round_trip){
+
+    FastJson::Writer writer;
+    writer.begin_object();
+    writer.member("int", 42);
+    writer.member("negative", (int64_t)-9007199254740993ll);
+    writer.member("double", 0.1);
+    writer.member("float", 1.5f);
+    writer.member("text", "quote\" backslash\\ newline\n tab\t ctrl\x01 utf8 中文");
+    writer.member("yes", true);
+    writer.key("none").null();
+    writer.key("list").begin_array();
+    for(int i = 0; i < 3; ++i) writer.value(i);
+    writer.begin_object().end_object();
+    writer.begin_array().end_array();
+    writer.end_array();
+    writer.end_object();
+    UNIT_ASSERT(writer.complete());
+
+    FastJson::Document doc;
+    UNIT_ASSERT(doc.parse(writer.str()));
+    auto root = doc.root();
+    UNIT_CHECK(root.is_object() && root.size() == 8);
+    UNIT_CHECK(root["int"].as_int() == 42);
+    UNIT_CHECK(root["negative"].as_int64() == -9007199254740993ll);
+    UNIT_CHECK(root["double"].as_double() == 0.1);
+    UNIT_CHECK(root["float"].as_float() == 1.5f);
+    UNIT_CHECK(root["text"].as_string() == "quote\" backslash\\ newline\n tab\t ctrl\x01 utf8 中文");
+    UNIT_CHECK(root["yes"].as_bool());
+    UNIT_CHECK(root["none"].is_null());
+
+    auto list = root["list"];
+    UNIT_ASSERT(list.is_array() && list.size() == 5);
+    UNIT_CHECK(list[2].as_int() == 2);
+    UNIT_CHECK(list[3].is_object() && list[3].size() == 0);
+    UNIT_CHECK(list[4].is_array() && list[4].size() == 0);
+    UNIT_CHECK(!list[5].valid());
+    UNIT_CHECK(!root["missing"].valid() && root["missing"].as_int(7) == 7);
+
+    // 再次写出的结果与第一次相同
+    FastJson::Writer again;
+    again.begin_object();
+    for(auto member = root.first_child(); member.valid(); member = member.next()){
+        again.key(member.name());
+        if(member.is_string()) again.value(member.as_string());
+        else if(member.is_number()){
+            auto name = std::string(member.name());
+            if(name == "int" || name == "negative") again.value(member.as_int64());
+            else if(name == "float") again.value(member.as_float());
+            else again.value(member.as_double());
+        }
+        else if(member.is_bool()) again.value(member.as_bool());
+        else if(member.is_null()) again.null();
+        else{
+            again.begin_array();
+            for(int i = 0; i < 3; ++i) again.value(member[i].as_int());
+            again.begin_object().end_object();
+            again.begin_array().end_array();
+            again.end_array();
+        }
+    }
+    again.end_object();
+    UNIT_CHECK(again.str() == writer.str());
+}
+
+UNIT_TEST(json_fast_integer_range){
+
+    FastJson::Document doc;
+    UNIT_ASSERT(doc.parse("[3.7, -3.7, 1e300, -1e300, 1e999, 99999999999999999999, 9223372036854775807, 1e10, -1e10, \"1\"]"));
+    auto root = doc.root();
+    UNIT_CHECK(root[0].as_int64() == 3);
+    UNIT_CHECK(root[1].as_int64() == -3);
+    UNIT_CHECK(root[2].as_int64() == numeric_limits<int64_t>::max());
+    UNIT_CHECK(root[3].as_int64() == numeric_limits<int64_t>::min());
+    UNIT_CHECK(root[4].as_int64() == numeric_limits<int64_t>::max());
+    UNIT_CHECK(root[5].as_int64() == numeric_limits<int64_t>::max());
+    UNIT_CHECK(root[6].as_int64() == numeric_limits<int64_t>::max());
+    UNIT_CHECK(root[7].as_int() == numeric_limits<int>::max());
+    UNIT_CHECK(root[8].as_int() == numeric_limits<int>::min());
+    UNIT_CHECK(root[7].as_int64() == 10000000000ll);
+    UNIT_CHECK(root[9].as_int64(5) == 5);
+}
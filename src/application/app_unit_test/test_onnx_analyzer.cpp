@@ -0,0 +1,149 @@
+#include <onnx/onnx_pb.h>
+#include <onnx_optimizer/onnx_analyzer.hpp>
+#include <onnx_optimizer/onnx_graph.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include "onnx_test_helper.hpp"
+
+using namespace std;
+using namespace ONNXOptimizer;
+using namespace OnnxTestHelper;
+
+// x[batch,3,8,8] -> Conv(pads 1) -> c1，c1同时给Relu和Add使用
+// Add(c1, Relu(c1)) -> BatchNormalization -> Erf -> Flatten -> Gemm(transB) -> out[batch,10]
+static onnx::ModelProto make_tiny_model(){
+    auto model = make_model();
+    auto graph = model.mutable_graph();
+    graph->set_name("tiny");
+    add_input(graph, "x", {-1, 3, 8, 8});
+    graph->add_output()->set_name("out");
+
+    add_initializer(graph, "w1", {4, 3, 3, 3});
+    add_initializer(graph, "b1", {4});
+    add_ints_attribute(add_node(graph, "Conv", {"x", "w1", "b1"}, {"c1"}), "pads", {1, 1, 1, 1});
+    add_node(graph, "Relu", {"c1"}, {"r1"});
+    add_node(graph, "Add", {"c1", "r1"}, {"a"});
+
+    for(auto name : {"scale", "bias", "mean", "var"})
+        add_initializer(graph, name, {4});
+    add_node(graph, "BatchNormalization", {"a", "scale", "bias", "mean", "var"}, {"bn"});
+    add_node(graph, "Erf", {"bn"}, {"y"});
+    add_node(graph, "Flatten", {"y"}, {"f"});
+
+    add_initializer(graph, "fc", {10, 256});
+    add_int_attribute(add_node(graph, "Gemm", {"f", "fc"}, {"out"}), "transB", 1);
+    return model;
+}
+
+static const NodeCost* find_node(const AnalysisReport& report, const string& op_type){
+    for(auto& node : report.nodes)
+        if(node.op_type == op_type) return &node;
+    return nullptr;
+}
+
+UNIT_TEST(onnx_analyzer_flops){
+
+    auto report = analyze(make_tiny_model());
+    UNIT_CHECK(report.graph_name == "tiny");
+    UNIT_ASSERT(report.num_nodes == 7 && report.nodes.size() == 7);
+    UNIT_CHECK(report.num_unknown_shapes == 0);
+
+    // Conv: 2 * 输出元素数 * 每个输出的MAC + bias，Gemm: 2 * M * N * K，BN按每个元素一次乘加
+    struct Expected{const char* op_type; double flops; Shape shape;};
+    vector<Expected> expected{
+        {"Conv", 2.0 * 256 * 27 + 256, {1, 4, 8, 8}},
+        {"Relu", 256, {1, 4, 8, 8}},
+        {"Add", 256, {1, 4, 8, 8}},
+        {"BatchNormalization", 512, {1, 4, 8, 8}},
+        {"Erf", 256, {1, 4, 8, 8}},
+        {"Flatten", 0, {1, 256}},
+        {"Gemm", 2.0 * 10 * 256, {1, 10}}
+    };
+
+    double total = 0;
+    for(size_t i = 0; i < expected.size(); ++i){
+        auto& node = report.nodes[i];
+        UNIT_CHECK(node.index == (int)i);
+        UNIT_CHECK(node.op_type == expected[i].op_type);
+        UNIT_CHECK(node.flops == expected[i].flops);
+        UNIT_CHECK(node.shape_known);
+        UNIT_CHECK(node.output_shape == shape_string(expected[i].shape));
+        total += expected[i].flops;
+    }
+    UNIT_CHECK(report.total_flops == total);
+    UNIT_CHECK(report.nodes[0].weight_bytes == (4 * 27 + 4) * sizeof(float));
+    UNIT_CHECK(report.nodes[6].weight_bytes == 10 * 256 * sizeof(float));
+    UNIT_CHECK(report.total_weight_bytes == (4 * 27 + 4 + 4 * 4 + 10 * 256) * sizeof(float));
+
+    auto sorted = report.sorted(SortBy::FLOPs);
+    UNIT_ASSERT(sorted.size() == 7);
+    UNIT_CHECK(sorted[0].op_type == "Conv");
+    UNIT_CHECK(sorted[1].op_type == "Gemm");
+    UNIT_CHECK(sorted.back().op_type == "Flatten");
+    UNIT_CHECK(!report.ops.empty() && report.ops[0].op_type == "Conv");
+
+    // batch作用在动态的第0维，FLOPs按batch线性增加
+    AnalyzeOptions options;
+    options.batch_size = 2;
+    auto batch2 = analyze(make_tiny_model(), options);
+    UNIT_ASSERT(batch2.nodes.size() == 7);
+    UNIT_CHECK(batch2.nodes[0].output_shape == shape_string({2, 4, 8, 8}));
+    UNIT_CHECK(batch2.total_flops == total * 2);
+}
+
+UNIT_TEST(onnx_analyzer_activation){
+
+    auto report = analyze(make_tiny_model());
+    const size_t feature = 256 * sizeof(float);
+
+    // 所有节点输出之和：5个4x8x8的特征、Flatten的输出和10个输出
+    UNIT_CHECK(report.total_activation_bytes == feature * 6 + 10 * sizeof(float));
+
+    // Add执行时x已经释放，c1、r1、a同时存在，是最大值
+    UNIT_CHECK(report.peak_activation_bytes == feature * 3);
+    UNIT_CHECK(report.nodes[2].input_bytes == feature * 2);
+    UNIT_CHECK(report.nodes[2].output_bytes == feature);
+    UNIT_CHECK(report.sorted(SortBy::Activation).size() == 7);
+}
+
+UNIT_TEST(onnx_analyzer_fusion_hints){
+
+    auto report = analyze(make_tiny_model());
+    UNIT_CHECK(report.num_fusion_hints == 3);
+
+    // c1有两个使用者，Relu无法融合进Conv
+    auto conv = find_node(report, "Conv");
+    UNIT_ASSERT(conv != nullptr && conv->fusion_hints.size() == 1);
+    UNIT_CHECK(conv->fusion_hints[0].find("2 consumers") != string::npos);
+
+    // BN的输入来自Add，无法折叠进Conv
+    auto bn = find_node(report, "BatchNormalization");
+    UNIT_ASSERT(bn != nullptr);
+    UNIT_CHECK(bn->fusion_hints.size() == 1);
+
+    auto erf = find_node(report, "Erf");
+    UNIT_ASSERT(erf != nullptr);
+    UNIT_CHECK(erf->fusion_hints.size() == 1);
+
+    for(auto op_type : {"Relu", "Add", "Flatten", "Gemm"})
+        UNIT_CHECK(find_node(report, op_type)->fusion_hints.empty());
+}
+
+UNIT_TEST(onnx_analyzer_file){
+
+    auto file = UnitTest::temp_directory() + "tiny.onnx";
+    string data;
+    UNIT_ASSERT(make_tiny_model().SerializeToString(&data));
+    UNIT_ASSERT(iLogger::save_file(file, data));
+
+    AnalysisReport report;
+    UNIT_ASSERT(analyze_file(file, report));
+    UNIT_CHECK(report.num_nodes == 7);
+    UNIT_CHECK(report.total_flops == analyze(make_tiny_model()).total_flops);
+    UNIT_CHECK(!analyze_file(UnitTest::temp_directory() + "missing.onnx", report));
+
+    auto json = report.json(SortBy::FLOPs);
+    for(auto field : {"\"total_flops\"", "\"peak_activation_bytes\"", "\"fusion_hints\"", "\"Conv\""})
+        UNIT_CHECK(json.find(field) != string::npos);
+    UNIT_CHECK(report.text(SortBy::FLOPs, 3).find("Conv") != string::npos);
+}
@@ -0,0 +1,245 @@
+
+#include <onnx/onnx_pb.h>
+#include <onnx_optimizer/onnx_optimizer.hpp>
+#include <onnx_optimizer/onnx_graph.hpp>
+#include "tools/unit_test.hpp"
+#include "onnx_test_helper.hpp"
+
+using namespace std;
+using namespace ONNXOptimizer;
+using namespace OnnxTestHelper;
+
+static Options single_pass(Pass pass){
+    Options options;
+    options.passes = {pass};
+    options.max_iterations = 1;
+    return options;
+}
+
+static const onnx::TensorProto* find_initializer(const onnx::GraphProto& graph, const string& name){
+    for(auto& tensor : graph.initializer())
+        if(tensor.name() == name) return &tensor;
+    return nullptr;
+}
+
+static bool has_input(const onnx::GraphProto& graph, const string& name){
+    for(auto& input : graph.input())
+        if(input.name() == name) return true;
+    return false;
+}
+
+static int count_op(const onnx::GraphProto& graph, const string& op){
+    int count = 0;
+    for(auto& node : graph.node())
+        count += node.op_type() == op;
+    return count;
+}
+
+// x -> Dropout -> Relu(Add(x1, c)) -> y，c来自Constant节点，w0和w1内容相同
+static onnx::ModelProto make_exporter_model(int64_t ir_version){
+    auto model = make_model(ir_version);
+    auto graph = model.mutable_graph();
+    add_input(graph, "x", {1, 4});
+    graph->add_output()->set_name("y");
+
+    auto constant  = add_node(graph, "Constant", {}, {"c"});
+    auto attribute = constant->add_attribute();
+    attribute->set_name("value_float");
+    attribute->set_type(onnx::AttributeProto::FLOAT);
+    attribute->set_f(2.0f);
+    constant->set_doc_string("exported by torch");
+
+    add_node(graph, "Dropout", {"x"}, {"x1"});
+    add_node(graph, "Add", {"x1", "c"}, {"a"});
+    add_node(graph, "Mul", {"a", "w0"}, {"b"});
+    add_node(graph, "Mul", {"b", "w1"}, {"y"});
+    add_initializer(graph, "w0", onnx::TensorProto::FLOAT, {4}, {1, 2, 3, 4});
+    add_initializer(graph, "w1", onnx::TensorProto::FLOAT, {4}, {1, 2, 3, 4});
+    add_input(graph, "w0", {4});
+    add_input(graph, "w1", {4});
+    return model;
+}
+
+UNIT_TEST(onnx_optimizer_exporter_cleanup){
+
+    auto model  = make_exporter_model(7);
+    auto graph  = model.mutable_graph();
+    auto report = optimize(model, single_pass(Pass::ExporterCleanup));
+    UNIT_CHECK(report.passes.size() == 1 && report.passes[0].num_changes > 0);
+
+    UNIT_CHECK(count_op(*graph, "Constant") == 0);
+    UNIT_CHECK(count_op(*graph, "Dropout") == 0);
+    UNIT_CHECK(find_initializer(*graph, "c") != nullptr);
+    UNIT_CHECK(!has_input(*graph, "w0") && !has_input(*graph, "w1"));
+    UNIT_ASSERT(graph->node_size() == 3);
+    UNIT_CHECK(graph->node(0).input(0) == "x");
+    UNIT_CHECK(graph->node(2).input(1) == "w0");   // 相同的initializer合并
+    for(auto& node : graph->node())
+        UNIT_CHECK(node.doc_string().empty());
+}
+
+UNIT_TEST(onnx_optimizer_exporter_cleanup_ir3_keeps_inputs){
+
+    // ir_version < 4时initializer必须出现在graph.input中
+    auto model = make_exporter_model(3);
+    auto graph = model.mutable_graph();
+    optimize(model);
+
+    UNIT_CHECK(has_input(*graph, "x"));
+    UNIT_CHECK(has_input(*graph, "w0"));
+    UNIT_CHECK(!has_input(*graph, "w1"));          // 合并后不再使用，与initializer一起删除
+    UNIT_CHECK(find_initializer(*graph, "w1") == nullptr);
+    for(auto& tensor : graph->initializer())
+        UNIT_CHECK(has_input(*graph, tensor.name()));
+}
+
+UNIT_TEST(onnx_optimizer_constant_folding){
+
+    auto model = make_model();
+    auto graph = model.mutable_graph();
+    add_input(graph, "x", {1, 3});
+    graph->add_output()->set_name("y");
+    add_initializer(graph, "a", onnx::TensorProto::FLOAT, {3}, {1, 2, 3});
+    add_initializer(graph, "b", onnx::TensorProto::FLOAT, {3}, {10, 20, 30});
+    add_node(graph, "Add", {"a", "b"}, {"ab"});
+    add_node(graph, "Mul", {"ab", "b"}, {"c"});
+    add_node(graph, "Add", {"x", "c"}, {"y"});
+
+    auto options = single_pass(Pass::ConstantFolding);
+    options.max_iterations = 4;
+    optimize(model, options);
+
+    UNIT_ASSERT(graph->node_size() == 1);
+    UNIT_CHECK(graph->node(0).input(0) == "x");
+
+    auto tensor = find_initializer(*graph, graph->node(0).input(1));
+    UNIT_ASSERT(tensor != nullptr);
+
+    Constant value;
+    UNIT_ASSERT(tensor_to_constant(*tensor, value));
+    UNIT_ASSERT(value.numel() == 3);
+    UNIT_CHECK(value.float_at(0) == 110 && value.float_at(1) == 440 && value.float_at(2) == 990);
+}
+
+UNIT_TEST(onnx_optimizer_eliminate_identity){
+
+    auto model = make_model();
+    auto graph = model.mutable_graph();
+    add_input(graph, "x", {1, 3, 4});
+    graph->add_output()->set_name("y");
+    add_initializer(graph, "s1", onnx::TensorProto::INT64, {2}, {3, 4});
+    add_initializer(graph, "s2", onnx::TensorProto::INT64, {1}, {12});
+    add_node(graph, "Identity", {"x"}, {"x1"});
+    add_node(graph, "Reshape", {"x1", "s1"}, {"r1"});
+    add_node(graph, "Reshape", {"r1", "s2"}, {"r2"});
+    add_node(graph, "Relu", {"r2"}, {"y"});
+
+    optimize(model, single_pass(Pass::EliminateIdentity));
+
+    // 第一个Reshape不再被使用，由DeadNodeElimination删除
+    UNIT_CHECK(count_op(*graph, "Identity") == 0);
+    UNIT_ASSERT(graph->node_size() == 3);
+    UNIT_CHECK(graph->node(0).input(0) == "x");
+    UNIT_CHECK(graph->node(1).input(0) == "x" && graph->node(1).input(1) == "s2");
+    UNIT_CHECK(graph->node(2).input(0) == "r2");
+}
+
+UNIT_TEST(onnx_optimizer_shape_simplify){
+
+    auto model = make_model();
+    auto graph = model.mutable_graph();
+    add_input(graph, "x", {1, 3, 8, 8});
+    graph->add_output()->set_name("y");
+    add_initializer(graph, "i1", onnx::TensorProto::INT64, {}, {1});
+    add_initializer(graph, "i0", onnx::TensorProto::INT64, {}, {0});
+    add_node(graph, "Shape", {"x"}, {"s"});
+    add_int_attribute(add_node(graph, "Gather", {"s", "i1"}, {"c"}), "axis", 0);
+    add_int_attribute(add_node(graph, "Gather", {"s", "i0"}, {"n"}), "axis", 0);
+    add_node(graph, "Mul", {"c", "n"}, {"y"});
+
+    optimize(model, single_pass(Pass::ShapeSimplify));
+
+    // 通道数是静态的，替换为常量；第0维看作动态batch，保留
+    UNIT_CHECK(count_op(*graph, "Shape") == 1);
+    UNIT_CHECK(count_op(*graph, "Gather") == 1);
+
+    Constant value;
+    auto tensor = find_initializer(*graph, "c");
+    UNIT_ASSERT(tensor != nullptr && tensor_to_constant(*tensor, value));
+    UNIT_CHECK(value.numel() == 1 && value.int_at(0) == 3);
+    UNIT_CHECK(find_initializer(*graph, "n") == nullptr);
+}
+
+UNIT_TEST(onnx_optimizer_dead_node_elimination){
+
+    auto model = make_model();
+    auto graph = model.mutable_graph();
+    add_input(graph, "x", {1, 3});
+    graph->add_output()->set_name("y");
+    add_initializer(graph, "unused", onnx::TensorProto::FLOAT, {3}, {1, 2, 3});
+    add_node(graph, "Relu", {"x"}, {"y"});
+    add_node(graph, "Sigmoid", {"x"}, {"dead0"});
+    add_node(graph, "Add", {"dead0", "unused"}, {"dead1"});
+    auto info = graph->add_value_info();
+    info->set_name("dead1");
+
+    auto report = optimize(model, single_pass(Pass::DeadNodeElimination));
+
+    UNIT_CHECK(report.num_nodes_before == 3 && report.num_nodes_after == 1);
+    UNIT_ASSERT(graph->node_size() == 1);
+    UNIT_CHECK(graph->node(0).op_type() == "Relu");
+    UNIT_CHECK(graph->initializer_size() == 0);
+    UNIT_CHECK(graph->value_info_size() == 0);
+    UNIT_CHECK(has_input(*graph, "x"));
+}
+
+UNIT_TEST(onnx_optimizer_all_passes){
+
+    // x.reshape(-1, x.shape[1])，所有pass组合后Reshape的shape成为常量
+    auto model = make_model();
+    auto graph = model.mutable_graph();
+    add_input(graph, "x", {1, 3, 8, 8});
+    graph->add_output()->set_name("y");
+    add_initializer(graph, "idx", onnx::TensorProto::INT64, {}, {1});
+    add_initializer(graph, "zero", onnx::TensorProto::INT64, {1}, {0});
+    add_initializer(graph, "m1", onnx::TensorProto::INT64, {1}, {-1});
+    add_node(graph, "Identity", {"x"}, {"x1"});
+    add_node(graph, "Shape", {"x1"}, {"s"});
+    add_int_attribute(add_node(graph, "Gather", {"s", "idx"}, {"ch"}), "axis", 0);
+    add_node(graph, "Unsqueeze", {"ch", "zero"}, {"chu"});
+    add_int_attribute(add_node(graph, "Concat", {"m1", "chu"}, {"shape"}), "axis", 0);
+    add_node(graph, "Reshape", {"x1", "shape"}, {"r"});
+    add_node(graph, "Relu", {"r"}, {"y"});
+    add_node(graph, "Relu", {"x"}, {"dead"});
+
+    auto report = optimize(model);
+    UNIT_CHECK(report.num_iterations >= 2);
+
+    UNIT_ASSERT(graph->node_size() == 2);
+    auto& reshape = graph->node(0);
+    UNIT_ASSERT(reshape.op_type() == "Reshape");
+    UNIT_CHECK(reshape.input(0) == "x");
+
+    Constant shape;
+    auto tensor = find_initializer(*graph, reshape.input(1));
+    UNIT_ASSERT(tensor != nullptr && tensor_to_constant(*tensor, shape));
+    UNIT_CHECK(shape.numel() == 2 && shape.int_at(0) == -1 && shape.int_at(1) == 3);
+    UNIT_CHECK(graph->initializer_size() == 1);
+}
+
+UNIT_TEST(onnx_optimizer_data_roundtrip){
+
+    auto model = make_exporter_model(7);
+    string data, output;
+    UNIT_ASSERT(model.SerializeToString(&data));
+
+    Report report;
+    UNIT_ASSERT(optimize_data(data.data(), data.size(), output, &report));
+    UNIT_CHECK(report.model_bytes_after < report.model_bytes_before);
+
+    onnx::ModelProto optimized;
+    UNIT_ASSERT(optimized.ParseFromString(output));
+    UNIT_CHECK(optimized.ir_version() == 7);
+    UNIT_CHECK(optimized.graph().node_size() == report.num_nodes_after);
+    UNIT_CHECK(!optimize_data(nullptr, 0, output));
+}
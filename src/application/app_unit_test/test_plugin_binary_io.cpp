@@ -0,0 +1,175 @@
+
+#include <onnxplugin/plugin_binary_io.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <limits>
+
+using namespace std;
+
+static string make_data(const function<void(Plugin::BinIO&)>& writer){
+    Plugin::BinIO out;
+    writer(out);
+    return out.releaseMemory();
+}
+
+UNIT_TEST(binio_round_trip){
+
+    vector<int> dims{1, 3, 4};
+    vector<string> names{"a", "", "conv.weight"};
+    auto data = make_data([&](Plugin::BinIO& out){
+        out << 7 << 1.5f << string("hello") << "world" << dims << names;
+        out.write("raw", 3);
+    });
+
+    Plugin::BinIO in(data.data(), data.size());
+    string hello, world;
+    vector<int> rdims;
+    vector<string> rnames;
+    UNIT_CHECK(in.readInt() == 7);
+    UNIT_CHECK(in.readFloat() == 1.5f);
+    in >> hello >> world >> rdims >> rnames;
+    UNIT_CHECK(hello == "hello" && world == "world");
+    UNIT_CHECK(rdims == dims);
+    UNIT_CHECK(rnames == names);
+    UNIT_CHECK(in.readData(3) == "raw");
+    UNIT_CHECK(in.opstate() && in.eof());
+
+    // 文件的流式读写与内存一致
+    auto file = UnitTest::temp_directory() + "binio.bin";
+    Plugin::BinIO fout;
+    UNIT_ASSERT(fout.openFileWrite(file));
+    fout.writeData(data);
+    fout.close();
+    UNIT_CHECK(fout.opstate());
+
+    Plugin::BinIO fin;
+    UNIT_ASSERT(fin.openFileRead(file));
+    UNIT_CHECK(fin.size() == data.size());
+    UNIT_CHECK(fin.readInt() == 7);
+    UNIT_CHECK(fin.readFloat() == 1.5f);
+    auto span = (const char*)fin.readSpan(sizeof(int) + 5);
+    UNIT_ASSERT(span != nullptr);
+    UNIT_CHECK(string(span + sizeof(int), 5) == "hello");
+
+    Plugin::BinIO min;
+    UNIT_ASSERT(min.openMappedRead(file));
+    UNIT_CHECK(min.readInt() == 7);
+}
+
+UNIT_TEST(binio_short_read){
+
+    auto data = make_data([](Plugin::BinIO& out){
+        out << 1;
+        out.write("ab", 2);
+    });
+
+    Plugin::BinIO in(data.data(), data.size());
+    UNIT_CHECK(in.readInt() == 1);
+
+    char buffer[8] = {0};
+    UNIT_CHECK(in.read(buffer, 4) == 2);
+    UNIT_CHECK(string(buffer, 2) == "ab");
+    UNIT_CHECK(!in.opstate() && !in.error().empty());
+
+    Plugin::BinIO span_in(data.data(), data.size());
+    UNIT_CHECK(span_in.readSpan(data.size() + 1) == nullptr);
+    UNIT_CHECK(!span_in.opstate());
+    UNIT_CHECK(span_in.tell() == 0);
+}
+
+UNIT_TEST(binio_length_prefix){
+
+    // 字符串的长度前缀超过剩余的数据，不会按前缀分配内存
+    auto huge_string = make_data([](Plugin::BinIO& out){
+        out << numeric_limits<int>::max();
+        out.write("abc", 3);
+    });
+    Plugin::BinIO in(huge_string.data(), huge_string.size());
+    string value = "x";
+    in >> value;
+    UNIT_CHECK(value.empty() && !in.opstate());
+
+    auto huge_vector = make_data([](Plugin::BinIO& out){
+        out << (numeric_limits<int>::max() / 4 + 1);
+        out << 1 << 2;
+    });
+    Plugin::BinIO vin(huge_vector.data(), huge_vector.size());
+    vector<int> values{1};
+    vin >> values;
+    UNIT_CHECK(values.empty() && !vin.opstate());
+
+    auto negative = make_data([](Plugin::BinIO& out){
+        out << -1;
+    });
+    Plugin::BinIO nin(negative.data(), negative.size());
+    vector<string> names{"a"};
+    nin >> names;
+    UNIT_CHECK(names.empty() && !nin.opstate());
+
+    // 每个字符串至少有4字节的长度前缀
+    auto too_many = make_data([](Plugin::BinIO& out){
+        out << 3 << 0 << 0;
+    });
+    Plugin::BinIO tin(too_many.data(), too_many.size());
+    tin >> names;
+    UNIT_CHECK(names.empty() && !tin.opstate());
+}
+
+UNIT_TEST(binio_check_shape){
+
+    string data(64, '\0');
+    Plugin::BinIO in(data.data(), data.size());
+    UNIT_CHECK(in.checkShape({2, 2, 4}, sizeof(float)));
+    UNIT_CHECK(in.checkShape({}, sizeof(float)));
+    UNIT_CHECK(in.checkShape({0, 1000000}, sizeof(float)));
+    UNIT_CHECK(in.opstate());
+
+    Plugin::BinIO too_large(data.data(), data.size());
+    UNIT_CHECK(!too_large.checkShape({2, 2, 5}, sizeof(float)));
+    UNIT_CHECK(!too_large.opstate());
+
+    // 乘积超过size_t时也能正确拒绝
+    Plugin::BinIO overflow(data.data(), data.size());
+    UNIT_CHECK(!overflow.checkShape({65536, 65536, 65536, 65536, 65536}, sizeof(float)));
+    UNIT_CHECK(!overflow.opstate());
+
+    Plugin::BinIO negative(data.data(), data.size());
+    UNIT_CHECK(!negative.checkShape({2, -1}, sizeof(float)));
+    UNIT_CHECK(!negative.opstate());
+
+    Plugin::BinIO invalid_type(data.data(), data.size());
+    UNIT_CHECK(!invalid_type.checkShape({1}, 0));
+}
+
+UNIT_TEST(binio_sticky_error){
+
+    auto data = make_data([](Plugin::BinIO& out){
+        out << 1 << 2;
+    });
+
+    Plugin::BinIO in(data.data(), data.size());
+    UNIT_CHECK(in.readSpan(100) == nullptr);
+    auto error = in.error();
+    UNIT_CHECK(!error.empty());
+
+    // 错误之后的读取不再进行，只保留第一个错误
+    UNIT_CHECK(in.readInt() == 0);
+    UNIT_CHECK(in.readData(4).empty());
+    UNIT_CHECK(in.tell() == 0);
+    UNIT_CHECK(in.eof());
+    UNIT_CHECK(in.error() == error);
+
+    // 重新打开后恢复
+    UNIT_ASSERT(in.openMemoryRead(data.data(), data.size()));
+    UNIT_CHECK(in.opstate() && in.error().empty());
+    UNIT_CHECK(in.readInt() == 1);
+
+    // 写入的错误同样是持续的
+    Plugin::BinIO out;
+    out << string(10, 'a');
+    UNIT_CHECK(out.opstate());
+    UNIT_ASSERT(out.openMemoryRead(data.data(), data.size()));
+    out << 1;
+    UNIT_CHECK(!out.opstate());
+    UNIT_CHECK(out.write("a", 1) == 0);
+}
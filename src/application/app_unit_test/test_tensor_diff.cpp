@@ -0,0 +1,162 @@
+
+#include <common/tensor_diff.hpp>
+#include <common/ilogger.hpp>
+#include "tools/unit_test.hpp"
+#include <cmath>
+#include <string.h>
+
+using namespace std;
+
+// 与Tensor::save_to_file相同的格式
+static bool save_tensor(const string& file, const vector<int>& dims, const vector<float>& values){
+    unsigned int head[3] = {0xFCCFE2E2, (unsigned int)dims.size(), (unsigned int)TensorDiff::DataType::Float};
+    string data((const char*)head, sizeof(head));
+    data.append((const char*)dims.data(), dims.size() * sizeof(int));
+    data.append((const char*)values.data(), values.size() * sizeof(float));
+    return iLogger::save_file(file, data);
+}
+
+static bool near(double a, double b, double eps = 1e-9){
+    return std::fabs(a - b) <= eps;
+}
+
+UNIT_TEST(tensor_diff_statistics){
+
+    // 误差为0, 0.5, 0, 2, 0, 0.25, 0, 0, 1
+    vector<float> a{1, 2.5f, 3, 6, 5, -1.25f, 7, 8, 10};
+    vector<float> b{1, 2,    3, 4, 5, -1,     7, 8, 9};
+
+    TensorDiff::Config config;
+    config.atol = 0.3f;
+    config.rtol = 0;
+    config.topk = 3;
+    auto result = TensorDiff::compare(a.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, a.size(), config);
+
+    UNIT_CHECK(result.numel == 9);
+    UNIT_CHECK(near(result.max_abs_error, 2));
+    UNIT_CHECK(result.max_index == 3);
+    UNIT_CHECK(near(result.mean_abs_error, 3.75 / 9));
+    UNIT_CHECK(near(result.rmse, std::sqrt((0.25 + 4 + 0.0625 + 1) / 9)));
+    UNIT_CHECK(result.num_mismatch == 3);
+    UNIT_CHECK(result.num_nan == 0);
+
+    double dot = 0, na = 0, nb = 0;
+    for(size_t i = 0; i < a.size(); ++i){
+        dot += a[i] * b[i];
+        na  += a[i] * a[i];
+        nb  += b[i] * b[i];
+    }
+    UNIT_CHECK(near(result.cosine, dot / std::sqrt(na * nb)));
+
+    // topk按误差从大到小
+    UNIT_ASSERT(result.topk.size() == 3);
+    UNIT_CHECK(result.topk[0].index == 3 && result.topk[0].a == 6 && result.topk[0].b == 4);
+    UNIT_CHECK(result.topk[1].index == 8);
+    UNIT_CHECK(result.topk[2].index == 1);
+
+    // 相同的输入
+    auto same = TensorDiff::compare(b.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, b.size());
+    UNIT_CHECK(same.max_abs_error == 0 && same.num_mismatch == 0 && near(same.cosine, 1) && same.pass);
+    UNIT_CHECK(same.topk.empty());
+
+    // 判定条件
+    config.max_mismatch_rate = 0.5;
+    UNIT_CHECK(TensorDiff::compare(a.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, a.size(), config).pass);
+    config.max_abs_error = 1;
+    UNIT_CHECK(!TensorDiff::compare(a.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, a.size(), config).pass);
+}
+
+UNIT_TEST(tensor_diff_nan_and_half){
+
+    vector<float> a{1, NAN, 3, INFINITY, 5};
+    vector<float> b{1, 2,   3, 4,        5};
+    auto result = TensorDiff::compare(a.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, a.size());
+    UNIT_CHECK(result.num_nan == 2);
+    UNIT_CHECK(result.num_mismatch == 2);
+    UNIT_CHECK(result.max_abs_error == 0);
+    UNIT_CHECK(!result.pass);
+
+    // float16：1.0 = 0x3C00，-2.0 = 0xC000，0.5 = 0x3800，与float比较
+    vector<uint16_t> half{0x3C00, 0xC000, 0x3800};
+    vector<float> full{1, -2, 0.75f};
+    auto mixed = TensorDiff::compare(half.data(), TensorDiff::DataType::Float16, full.data(), TensorDiff::DataType::Float, half.size());
+    UNIT_CHECK(near(mixed.max_abs_error, 0.25));
+    UNIT_CHECK(mixed.max_index == 2);
+    UNIT_CHECK(mixed.num_mismatch == 1);
+}
+
+UNIT_TEST(tensor_diff_threads){
+
+    // 超过每个线程的最小元素数，分段统计后合并的结果与单线程一致
+    size_t numel = (1 << 20) * 3 + 17;
+    vector<float> a(numel), b(numel);
+    for(size_t i = 0; i < numel; ++i){
+        a[i] = std::sin(i * 0.001f);
+        b[i] = a[i] + ((i % 1000) == 7 ? 0.01f : 0.0f);
+    }
+    a[numel - 1] += 5;
+    a[12345] -= 3;
+
+    TensorDiff::Config config;
+    config.topk = 5;
+    auto single = TensorDiff::compare(a.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, numel, config, 1);
+    auto multi  = TensorDiff::compare(a.data(), TensorDiff::DataType::Float, b.data(), TensorDiff::DataType::Float, numel, config, 4);
+
+    UNIT_CHECK(single.max_index == numel - 1 && multi.max_index == numel - 1);
+    UNIT_CHECK(single.max_abs_error == multi.max_abs_error);
+    UNIT_CHECK(single.num_mismatch == multi.num_mismatch);
+    UNIT_CHECK(near(single.mean_abs_error, multi.mean_abs_error, 1e-12));
+    UNIT_CHECK(near(single.cosine, multi.cosine, 1e-12));
+    UNIT_ASSERT(single.topk.size() == 5 && multi.topk.size() == 5);
+    UNIT_CHECK(multi.topk[0].index == numel - 1);
+    UNIT_CHECK(multi.topk[1].index == 12345);
+    for(int i = 0; i < 5; ++i)
+        UNIT_CHECK(single.topk[i].abs_error == multi.topk[i].abs_error);
+}
+
+UNIT_TEST(tensor_diff_files_and_report){
+
+    UNIT_CHECK(TensorDiff::shape_string({1, 3, 4}) == "1x3x4");
+    UNIT_CHECK(TensorDiff::shape_string({}) == "scalar");
+    UNIT_CHECK(TensorDiff::index_string(0, {2, 3, 4}) == "[0,0,0]");
+    UNIT_CHECK(TensorDiff::index_string(23, {2, 3, 4}) == "[1,2,3]");
+    UNIT_CHECK(TensorDiff::index_string(13, {2, 3, 4}) == "[1,0,1]");
+
+    auto dir_a = UnitTest::temp_directory() + "a/";
+    auto dir_b = UnitTest::temp_directory() + "b/";
+    UNIT_ASSERT(iLogger::mkdirs(dir_a) && iLogger::mkdirs(dir_b));
+
+    vector<float> values(24);
+    for(int i = 0; i < 24; ++i) values[i] = i;
+    auto changed = values;
+    changed[13] += 1;
+
+    UNIT_ASSERT(save_tensor(dir_a + "out.tensor", {2, 3, 4}, values));
+    UNIT_ASSERT(save_tensor(dir_b + "out.tensor", {2, 3, 4}, changed));
+    UNIT_ASSERT(save_tensor(dir_a + "shape.tensor", {2, 12}, values));
+    UNIT_ASSERT(save_tensor(dir_b + "shape.tensor", {4, 6}, values));
+    UNIT_ASSERT(save_tensor(dir_a + "only_a.tensor", {1}, {0}));
+    UNIT_ASSERT(iLogger::save_file(dir_b + "broken.tensor", string("not a tensor")));
+    UNIT_ASSERT(iLogger::save_file(dir_a + "broken.tensor", string("not a tensor")));
+
+    TensorDiff::Config config;
+    config.max_abs_error = 0.5;
+    auto results = TensorDiff::compare_directories(dir_a, dir_b, config);
+    UNIT_ASSERT(results.size() == 4);
+    UNIT_CHECK(results[0].name == "broken.tensor" && results[0].error.find("not a tensor file") != string::npos);
+    UNIT_CHECK(results[1].name == "only_a.tensor" && results[1].error.find("Only in") == 0);
+    UNIT_CHECK(results[2].name == "out.tensor" && results[2].error.empty());
+    UNIT_CHECK(results[2].max_index == 13 && near(results[2].max_abs_error, 1));
+    UNIT_CHECK(results[3].name == "shape.tensor");
+    UNIT_CHECK(results[3].error == "Shape mismatch, 2x12 vs 4x6");
+
+    // 报告中最大误差的位置按坐标输出
+    auto text = TensorDiff::summary(results);
+    UNIT_CHECK(text.find("2x3x4") != string::npos);
+    UNIT_CHECK(text.find("[1,0,1] a = 13, b = 14") != string::npos);
+    UNIT_CHECK(text.find("4 files, 0 passed, 4 failed") != string::npos);
+
+    auto json = TensorDiff::to_json(results);
+    UNIT_CHECK(json.find("\"max_index\":\"[1,0,1]\"") != string::npos);
+    UNIT_CHECK(json.find("\"error\":\"Shape mismatch, 2x12 vs 4x6\"") != string::npos);
+}
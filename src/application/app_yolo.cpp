@@ -1,8 +1,10 @@
 
 #include <builder/trt_builder.hpp>
+#include <builder/trt_engine_cache.hpp>
 #include <infer/trt_infer.hpp>
 #include <common/ilogger.hpp>
 #include "app_yolo/yolo.hpp"
+#include "tools/dataset_loader.hpp"
 
 using namespace std;
 
@@ -43,12 +45,8 @@ static void inference_and_performance(int deviceid, const string& engine_file, T
         return;
     }
 
-    auto files = iLogger::find_files("inference", "*.jpg;*.jpeg;*.png;*.gif;*.tif");
-    vector<cv::Mat> images;
-    for(int i = 0; i < files.size(); ++i){
-        auto image = cv::imread(files[i]);
-        images.emplace_back(image);
-    }
+    auto files  = Dataset::find_images("inference", "*.jpg;*.jpeg;*.png;*.gif;*.tif", false);
+    auto images = Dataset::load_images(files);
 
     // warmup
     vector<shared_future<Yolo::BoxArray>> boxes_array;
@@ -111,10 +109,10 @@ static void test(Yolo::Type type, TRT::Mode mode, const string& model){
 
         INFO("Int8 %d / %d", current, count);
 
-        for(int i = 0; i < files.size(); ++i){
-            auto image = cv::imread(files[i]);
-            Yolo::image_to_tensor(image, tensor, type, i);
-        }
+        // 并行解码一个batch，image_to_tensor仍然按顺序调用
+        auto images = Dataset::load_calibration_batch(files);
+        for(int i = 0; i < images.size(); ++i)
+            Yolo::image_to_tensor(images[i], tensor, type, i);
     };
 
     const char* name = model.c_str();
@@ -124,19 +122,25 @@ static void test(Yolo::Type type, TRT::Mode mode, const string& model){
         return;
 
     string onnx_file = iLogger::format("%s.onnx", name);
-    string model_file = iLogger::format("%s.%s.trtmodel", name, mode_name);
     int test_batch_size = 16;
-    
-    if(not iLogger::exists(model_file)){
-        TRT::compile(
-            mode,                       // FP32、FP16、INT8
-            test_batch_size,            // max batch size
-            onnx_file,                  // source 
-            model_file,                 // save to
-            {},
-            int8process,
-            "inference"
-        );
+
+    // onnx、mode、batch、GPU或者TensorRT版本变化时，engine_cache会重新编译，否则直接使用缓存的engine
+    auto engine_cache = TRT::create_engine_cache("engine_cache", 4ull << 30, TRT::current_platform(deviceid));
+    if(engine_cache == nullptr)
+        return;
+
+    string model_file = engine_cache->get_or_compile(
+        mode,                       // FP32、FP16、INT8
+        test_batch_size,            // max batch size
+        onnx_file,                  // source 
+        {},
+        int8process,
+        "inference"
+    );
+
+    if(model_file.empty()){
+        INFOE("Compile %s failed.", onnx_file.c_str());
+        return;
     }
 
     inference_and_performance(deviceid, model_file, mode, type, name);
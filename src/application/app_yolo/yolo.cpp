@@ -1,5 +1,7 @@
 #include "yolo.hpp"
 #include <atomic>
+#include <algorithm>
+#include <cmath>
 #include <mutex>
 #include <queue>
 #include <condition_variable>
@@ -9,6 +11,7 @@
 #include <common/preprocess_kernel.cuh>
 #include <common/monopoly_allocator.hpp>
 #include <common/cuda_tools.hpp>
+#include <common/image_copy.hpp>
 
 namespace Yolo{
     using namespace cv;
@@ -91,12 +94,33 @@ namespace Yolo{
         }
     };
 
+    struct JobAdditional{
+        AffineMatrix affine;
+        int size_index = 0;     // input_sizes_中的序号
+    };
+
+    // 选择宽高比与图片最接近的输入尺寸，letterbox填充的部分最少，相同时取面积小的
+    static int select_input_size(const vector<Size>& sizes, const Size& image){
+
+        int selected = 0;
+        float selected_diff = 0;
+        float image_ratio = std::log(image.width / (float)std::max(1, image.height));
+        for(int i = 0; i < (int)sizes.size(); ++i){
+            float diff = std::fabs(std::log(sizes[i].width / (float)sizes[i].height) - image_ratio);
+            if(i == 0 || diff < selected_diff || (diff == selected_diff && sizes[i].area() < sizes[selected].area())){
+                selected = i;
+                selected_diff = diff;
+            }
+        }
+        return selected;
+    }
+
     using ControllerImpl = InferController
     <
         Mat,                    // input
         BoxArray,         // output
         tuple<string, int>,     // start param
-        AffineMatrix            // additional
+        JobAdditional           // additional
     >;
     class InferImpl : public Infer, public ControllerImpl{
     public:
@@ -150,6 +174,29 @@ namespace Yolo{
 
             input_width_       = input->size(3);
             input_height_      = input->size(2);
+
+            // engine有多个optimization profile时，每种opt尺寸作为一种输入尺寸，按图片的宽高比选择
+            // 同一个尺寸的图片才能组成一个batch，batch size不超过所有尺寸中最小的max batch
+            input_sizes_.clear();
+            if(engine->num_profiles() > 1){
+                vector<int> size_max_batch;
+                for(auto& profile : engine->get_profiles()){
+                    auto& shape = profile[0];
+                    Size size(shape.opt[3], shape.opt[2]);
+                    auto iter = std::find(input_sizes_.begin(), input_sizes_.end(), size);
+                    if(iter == input_sizes_.end()){
+                        input_sizes_.emplace_back(size);
+                        size_max_batch.emplace_back(shape.max[0]);
+                    }else{
+                        auto& value = size_max_batch[iter - input_sizes_.begin()];
+                        value = std::max(value, shape.max[0]);
+                    }
+                }
+                max_batch_size = std::min(max_batch_size, *std::min_element(size_max_batch.begin(), size_max_batch.end()));
+            }else{
+                input_sizes_.emplace_back(input_width_, input_height_);
+            }
+
             tensor_allocator_  = make_shared<MonopolyAllocator<TRT::Tensor>>(max_batch_size * 2);
             stream_            = engine->get_stream();
             gpu_               = gpuid;
@@ -168,7 +215,8 @@ namespace Yolo{
             while(get_jobs_and_wait(fetch_jobs, max_batch_size)){
 
                 int infer_batch_size = fetch_jobs.size();
-                input->resize_single_dim(0, infer_batch_size);
+                auto& first_tensor   = fetch_jobs[0].mono_tensor->data();
+                input->resize(infer_batch_size, 3, first_tensor->size(2), first_tensor->size(3));
 
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
                     auto& job  = fetch_jobs[ibatch];
@@ -178,7 +226,10 @@ namespace Yolo{
                     job.mono_tensor->release();
                 }
 
-                engine->forward(false);
+                if(!engine->forward(false)){
+                    fail_jobs(fetch_jobs);
+                    continue;
+                }
                 output_array_device.to_gpu(false);
                 for(int ibatch = 0; ibatch < infer_batch_size; ++ibatch){
                     
@@ -226,14 +277,16 @@ namespace Yolo{
                 tensor->set_workspace(make_shared<TRT::MixMemory>());
             }
 
-            Size input_size(input_width_, input_height_);
-            job.additional.compute(image.size(), input_size);
+            job.additional.size_index = select_input_size(input_sizes_, image.size());
+            Size input_size = input_sizes_[job.additional.size_index];
+            auto& affine    = job.additional.affine;
+            affine.compute(image.size(), input_size);
             
             tensor->set_stream(stream_);
-            tensor->resize(1, 3, input_height_, input_width_);
+            tensor->resize(1, 3, input_size.height, input_size.width);
 
             size_t size_image      = image.cols * image.rows * 3;
-            size_t size_matrix     = iLogger::upbound(sizeof(job.additional.d2i), 32);
+            size_t size_matrix     = iLogger::upbound(sizeof(affine.d2i), 32);
             auto workspace         = tensor->get_workspace();
             uint8_t* gpu_workspace        = (uint8_t*)workspace->gpu(size_matrix + size_image);
             float*   affine_matrix_device = (float*)gpu_workspace;
@@ -245,20 +298,25 @@ namespace Yolo{
 
             //checkCudaRuntime(cudaMemcpyAsync(image_host,   image.data, size_image, cudaMemcpyHostToHost,   stream_));
             // speed up
-            memcpy(image_host, image.data, size_image);
-            memcpy(affine_matrix_host, job.additional.d2i, sizeof(job.additional.d2i));
+            ImageCopy::copy_continuous(image, image_host);
+            memcpy(affine_matrix_host, affine.d2i, sizeof(affine.d2i));
             checkCudaRuntime(cudaMemcpyAsync(image_device, image_host, size_image, cudaMemcpyHostToDevice, stream_));
-            checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, affine_matrix_host, sizeof(job.additional.d2i), cudaMemcpyHostToDevice, stream_));
+            checkCudaRuntime(cudaMemcpyAsync(affine_matrix_device, affine_matrix_host, sizeof(affine.d2i), cudaMemcpyHostToDevice, stream_));
 
             CUDAKernel::warp_affine_bilinear_and_normalize_plane(
                 image_device,         image.cols * 3,       image.cols,       image.rows, 
-                tensor->gpu<float>(), input_width_,         input_height_, 
+                tensor->gpu<float>(), input_size.width,     input_size.height, 
                 affine_matrix_device, 114, 
                 normalize_, stream_
             );
             return true;
         }
 
+        // 只有一种输入尺寸时不区分bucket
+        virtual int job_bucket(const Job& job) override{
+            return input_sizes_.size() > 1 ? job.additional.size_index : -1;
+        }
+
         virtual vector<shared_future<BoxArray>> commits(const vector<Mat>& images) override{
             return ControllerImpl::commits(images);
         }
@@ -270,6 +328,7 @@ namespace Yolo{
     private:
         int input_width_            = 0;
         int input_height_           = 0;
+        vector<Size> input_sizes_;
         int gpu_                    = 0;
         float confidence_threshold_ = 0;
         float nms_threshold_        = 0;
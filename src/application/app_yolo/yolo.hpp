@@ -31,6 +31,7 @@ namespace Yolo{
         virtual vector<shared_future<BoxArray>> commits(const vector<cv::Mat>& images) = 0;
     };
 
+    // engine有多个optimization profile（TRT::compile的shapeBuckets）时，每张图片按宽高比选择最接近的profile尺寸，同一尺寸的图片组成batch
     shared_ptr<Infer> create_infer(const string& engine_file, Type type, int gpuid, float confidence_threshold=0.25f, float nms_threshold=0.5f);
     const char* type_name(Type type);
 
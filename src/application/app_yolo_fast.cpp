@@ -3,6 +3,7 @@
 #include <infer/trt_infer.hpp>
 #include <common/ilogger.hpp>
 #include "app_yolo_fast/yolo_fast.hpp"
+#include "tools/dataset_loader.hpp"
 
 using namespace std;
 
@@ -53,12 +54,8 @@ static void inference_and_performance(int deviceid, const string& engine_file, T
         return;
     }
 
-    auto files = iLogger::find_files("inference", "*.jpg;*.jpeg;*.png;*.gif;*.tif");
-    vector<cv::Mat> images;
-    for(int i = 0; i < files.size(); ++i){
-        auto image = cv::imread(files[i]);
-        images.emplace_back(image);
-    }
+    auto files  = Dataset::find_images("inference", "*.jpg;*.jpeg;*.png;*.gif;*.tif", false);
+    auto images = Dataset::load_images(files);
 
     // warmup
     vector<shared_future<YoloFast::BoxArray>> boxes_array;
@@ -121,10 +118,10 @@ static void test(YoloFast::Type type, TRT::Mode mode, const string& model){
 
         INFO("Int8 %d / %d", current, count);
 
-        for(int i = 0; i < files.size(); ++i){
-            auto image = cv::imread(files[i]);
-            YoloFast::image_to_tensor(image, tensor, type, i);
-        }
+        // 并行解码一个batch，image_to_tensor仍然按顺序调用
+        auto images = Dataset::load_calibration_batch(files);
+        for(int i = 0; i < images.size(); ++i)
+            YoloFast::image_to_tensor(images[i], tensor, type, i);
     };
 
     const char* name = model.c_str();
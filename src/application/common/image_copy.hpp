@@ -0,0 +1,19 @@
+#ifndef IMAGE_COPY_HPP
+#define IMAGE_COPY_HPP
+
+#include <string.h>
+#include <opencv2/opencv.hpp>
+
+namespace ImageCopy{
+
+    // 把image复制到连续的dst中，dst至少有rows * cols * elemSize字节
+    // 连续的图像直接memcpy，ROI等有行间距的图像逐行复制
+    inline void copy_continuous(const cv::Mat& image, void* dst){
+        if(image.isContinuous())
+            memcpy(dst, image.data, image.total() * image.elemSize());
+        else
+            image.copyTo(cv::Mat(image.rows, image.cols, image.type(), dst));
+    }
+};
+
+#endif // IMAGE_COPY_HPP
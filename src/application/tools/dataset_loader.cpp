@@ -0,0 +1,442 @@
+
+#include "dataset_loader.hpp"
+#include <common/ilogger.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(U_OS_LINUX)
+#   include <dirent.h>
+#   include <sys/stat.h>
+#endif
+
+using namespace std;
+
+namespace Dataset{
+
+    static int default_threads(int num_threads, size_t num_tasks){
+        if(num_threads <= 0)
+            num_threads = std::max(1u, thread::hardware_concurrency());
+        return std::max(1, std::min(num_threads, (int)num_tasks));
+    }
+
+#if defined(U_OS_LINUX)
+    static void scan_directory(const string& path, const string& filter, bool include_subdirectory, vector<string>& files, vector<string>& directories){
+
+        DIR* handle = opendir(path.c_str());
+        if(handle == nullptr)
+            return;
+
+        struct dirent* entry = nullptr;
+        while((entry = readdir(handle)) != nullptr){
+            if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            // 部分文件系统不提供d_type，这时才需要lstat
+            bool is_directory = entry->d_type == DT_DIR;
+            if(entry->d_type == DT_UNKNOWN){
+                struct stat file_stat;
+                if(lstat((path + entry->d_name).c_str(), &file_stat) < 0)
+                    continue;
+                is_directory = S_ISDIR(file_stat.st_mode);
+            }
+
+            if(is_directory){
+                if(include_subdirectory)
+                    directories.push_back(path + entry->d_name + "/");
+            }else if(iLogger::pattern_match(entry->d_name, filter.c_str())){
+                files.push_back(path + entry->d_name);
+            }
+        }
+        closedir(handle);
+    }
+#endif
+
+    vector<string> find_images(const string& directory, const string& filter, bool include_subdirectory, int num_threads){
+
+        string realpath = directory;
+        if(realpath.empty())
+            realpath = "./";
+
+        char backchar = realpath.back();
+        if(backchar != '\\' && backchar != '/')
+            realpath += "/";
+
+#if defined(U_OS_WINDOWS)
+        auto output = iLogger::find_files(realpath, filter, false, include_subdirectory);
+#else
+        vector<string> output;
+        deque<string> pending{realpath};
+        int active = 0;
+        mutex lock;
+        condition_variable cond;
+
+        // 每个线程取一个目录遍历，发现的子目录放回队列，队列为空且没有线程在遍历时结束
+        auto worker = [&](){
+            vector<string> files, directories;
+            while(true){
+                string path;
+                {
+                    unique_lock<mutex> l(lock);
+                    cond.wait(l, [&](){return !pending.empty() || active == 0;});
+                    if(pending.empty()) break;
+
+                    path = std::move(pending.front());
+                    pending.pop_front();
+                    active++;
+                };
+
+                files.clear();
+                directories.clear();
+                scan_directory(path, filter, include_subdirectory, files, directories);
+                {
+                    unique_lock<mutex> l(lock);
+                    output.insert(output.end(), files.begin(), files.end());
+                    pending.insert(pending.end(), directories.begin(), directories.end());
+                    active--;
+                };
+                cond.notify_all();
+            }
+        };
+
+        vector<thread> threads;
+        for(int i = 1; i < std::max(1, num_threads); ++i)
+            threads.emplace_back(worker);
+
+        worker();
+        for(auto& t : threads)
+            t.join();
+#endif
+        std::sort(output.begin(), output.end());
+        return output;
+    }
+
+    const unsigned int kCacheMagic   = 0x43495344;  // "DSIC"
+    const unsigned int kCacheVersion = 1;
+
+    // 缓存文件：CacheHeader + CacheEntry[count] + 按64字节对齐的像素数据
+    struct CacheHeader{
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        int32_t count;
+        int32_t imread_flags;
+    };
+
+    struct CacheEntry{
+        uint64_t offset;
+        int32_t rows, cols, type;
+        int32_t reserved;
+    };
+
+    class LoaderImpl : public Loader{
+    public:
+        virtual ~LoaderImpl(){
+            {
+                unique_lock<mutex> l(lock_);
+                run_ = false;
+            };
+            space_cond_.notify_all();
+            for(auto& worker : workers_)
+                worker.join();
+
+            // 没有取完全部图像，丢弃不完整的缓存
+            if(cache_writer_ != nullptr){
+                fclose(cache_writer_);
+                cache_writer_ = nullptr;
+                iLogger::delete_file(cache_temp_file_);
+            }
+        }
+
+        bool startup(const vector<string>& files, const LoaderConfig& config){
+
+            files_  = files;
+            config_ = config;
+            config_.max_prefetch = std::max(1, config_.max_prefetch);
+
+            if(!config_.cache_file.empty()){
+                cache_key_ = make_cache_key();
+                if(open_cache()){
+                    INFO("Using decoded image cache[%d images]: %s", (int)files_.size(), config_.cache_file.c_str());
+                    return true;
+                }
+
+                if(!create_cache_writer())
+                    INFOW("Can not create decoded image cache: %s", config_.cache_file.c_str());
+            }
+
+            int num_threads = default_threads(config_.num_threads, files_.size());
+            for(int i = 0; i < num_threads && !files_.empty(); ++i)
+                workers_.emplace_back(&LoaderImpl::worker, this);
+            return true;
+        }
+
+        virtual bool next(Item& item) override{
+
+            if(cache_mapping_ != nullptr)
+                return next_from_cache(item);
+
+            {
+                // 可能有多个线程同时调用next，每次唤醒后重新检查
+                unique_lock<mutex> l(lock_);
+                int count = files_.size();
+                if(config_.order == Order::Sequential){
+                    ready_cond_.wait(l, [&](){return consumed_ >= count || ready_.find(consumed_) != ready_.end();});
+                    if(consumed_ >= count) return false;
+
+                    auto iter = ready_.find(consumed_);
+                    item = std::move(iter->second);
+                    ready_.erase(iter);
+                }else{
+                    ready_cond_.wait(l, [&](){return consumed_ >= count || !completed_.empty();});
+                    if(consumed_ >= count) return false;
+
+                    item = std::move(completed_.front());
+                    completed_.pop_front();
+                }
+                consumed_++;
+            };
+            space_cond_.notify_all();
+            ready_cond_.notify_all();
+
+            if(!config_.cache_file.empty())
+                write_cache(item);
+            return true;
+        }
+
+        virtual int size() const override{
+            return files_.size();
+        }
+
+        virtual bool from_cache() const override{
+            return cache_mapping_ != nullptr;
+        }
+
+    private:
+        void worker(){
+
+            while(true){
+                int index = 0;
+                {
+                    unique_lock<mutex> l(lock_);
+                    space_cond_.wait(l, [&](){
+                        return !run_ || next_index_ >= (int)files_.size() || next_index_ - consumed_ < config_.max_prefetch;
+                    });
+
+                    if(!run_ || next_index_ >= (int)files_.size()) break;
+                    index = next_index_++;
+                };
+
+                Item item;
+                item.index = index;
+                item.file  = files_[index];
+                item.image = cv::imread(item.file, config_.imread_flags);
+                if(item.image.empty())
+                    INFOW("Load image %s failed", item.file.c_str());
+
+                {
+                    unique_lock<mutex> l(lock_);
+                    if(config_.order == Order::Sequential)
+                        ready_[index] = std::move(item);
+                    else
+                        completed_.emplace_back(std::move(item));
+                };
+                ready_cond_.notify_all();
+            }
+        }
+
+        bool next_from_cache(Item& item){
+
+            int index = cache_cursor_++;
+            if(index >= (int)files_.size())
+                return false;
+
+            auto& entry = cache_entries_[index];
+            item.index  = index;
+            item.file   = files_[index];
+            item.image  = cv::Mat();
+            if(entry.rows > 0)
+                item.image = cv::Mat(entry.rows, entry.cols, entry.type, (unsigned char*)cache_mapping_->data() + entry.offset);
+            return true;
+        }
+
+        uint64_t make_cache_key() const{
+
+            string config = iLogger::format("%d", config_.imread_flags);
+            for(auto& file : files_)
+                config += iLogger::format("|%s:%lld", file.c_str(), (long long)iLogger::file_size(file));
+            return iLogger::hash64(config.data(), config.size());
+        }
+
+        CacheHeader make_header() const{
+            CacheHeader header;
+            header.magic        = kCacheMagic;
+            header.version      = kCacheVersion;
+            header.key          = cache_key_;
+            header.count        = files_.size();
+            header.imread_flags = config_.imread_flags;
+            return header;
+        }
+
+        bool open_cache(){
+
+            if(!iLogger::exists(config_.cache_file) || files_.empty()) return false;
+
+            auto mapping = iLogger::map_file(config_.cache_file);
+            if(mapping == nullptr) return false;
+
+            auto header = make_header();
+            size_t table_bytes = sizeof(header) + files_.size() * sizeof(CacheEntry);
+            if(mapping->size() < table_bytes || memcmp(mapping->data(), &header, sizeof(header)) != 0){
+                INFO("Decoded image cache %s is outdated, rebuild it.", config_.cache_file.c_str());
+                return false;
+            }
+
+            cache_entries_.resize(files_.size());
+            memcpy(cache_entries_.data(), (unsigned char*)mapping->data() + sizeof(header), files_.size() * sizeof(CacheEntry));
+            for(auto& entry : cache_entries_){
+                size_t bytes = (size_t)entry.rows * entry.cols * CV_ELEM_SIZE(entry.type);
+                if(entry.offset > mapping->size() || bytes > mapping->size() - entry.offset){
+                    INFOW("Decoded image cache %s is broken, rebuild it.", config_.cache_file.c_str());
+                    cache_entries_.clear();
+                    return false;
+                }
+            }
+
+            // 通常是从头到尾顺序读取
+            mapping->advise(iLogger::MapAdvice::Sequential);
+            cache_mapping_ = mapping;
+            return true;
+        }
+
+        bool create_cache_writer(){
+
+            if(files_.empty()) return false;
+
+            string directory = iLogger::directory(config_.cache_file);
+            if(!directory.empty() && directory != "." && !iLogger::mkdirs(directory))
+                return false;
+
+            cache_temp_file_ = config_.cache_file + ".tmp";
+            cache_writer_    = fopen(cache_temp_file_.c_str(), "wb");
+            if(cache_writer_ == nullptr) return false;
+
+            // 先写入空的索引，全部写完后回填
+            auto header = make_header();
+            cache_entries_.assign(files_.size(), CacheEntry{0, 0, 0, 0, 0});
+            cache_offset_ = sizeof(header) + cache_entries_.size() * sizeof(CacheEntry);
+            if(fwrite(&header, sizeof(header), 1, cache_writer_) != 1 ||
+                fwrite(cache_entries_.data(), sizeof(CacheEntry), cache_entries_.size(), cache_writer_) != cache_entries_.size()){
+                fclose(cache_writer_);
+                cache_writer_ = nullptr;
+                iLogger::delete_file(cache_temp_file_);
+                return false;
+            }
+            return true;
+        }
+
+        void write_cache(const Item& item){
+
+            unique_lock<mutex> l(cache_lock_);
+            if(cache_writer_ == nullptr) return;
+
+            bool ok = true;
+            auto& entry = cache_entries_[item.index];
+            if(!item.image.empty()){
+                cv::Mat image = item.image.isContinuous() ? item.image : item.image.clone();
+                size_t padding = (64 - cache_offset_ % 64) % 64;
+                size_t bytes   = image.total() * image.elemSize();
+                static const char zeros[64] = {0};
+
+                entry.offset = cache_offset_ + padding;
+                entry.rows   = image.rows;
+                entry.cols   = image.cols;
+                entry.type   = image.type();
+                ok = fwrite(zeros, 1, padding, cache_writer_) == padding && fwrite(image.data, 1, bytes, cache_writer_) == bytes;
+                cache_offset_ += padding + bytes;
+            }
+
+            if(ok && ++cache_written_ == (int)files_.size()){
+                ok = fseek(cache_writer_, sizeof(CacheHeader), SEEK_SET) == 0 &&
+                    fwrite(cache_entries_.data(), sizeof(CacheEntry), cache_entries_.size(), cache_writer_) == cache_entries_.size();
+                finish_cache(ok);
+                return;
+            }
+
+            if(!ok) finish_cache(false);
+        }
+
+        void finish_cache(bool ok){
+
+            ok = fclose(cache_writer_) == 0 && ok;
+            cache_writer_ = nullptr;
+#if defined(U_OS_WINDOWS)
+            if(ok) ::remove(config_.cache_file.c_str());
+#endif
+            if(!ok || ::rename(cache_temp_file_.c_str(), config_.cache_file.c_str()) != 0){
+                INFOW("Save decoded image cache failed: %s", config_.cache_file.c_str());
+                iLogger::delete_file(cache_temp_file_);
+                return;
+            }
+            INFO("Save decoded image cache[%d images] to: %s", (int)files_.size(), config_.cache_file.c_str());
+        }
+
+    private:
+        vector<string> files_;
+        LoaderConfig config_;
+        vector<thread> workers_;
+        mutex lock_;
+        condition_variable space_cond_;
+        condition_variable ready_cond_;
+        map<int, Item> ready_;
+        deque<Item> completed_;
+        bool run_        = true;
+        int next_index_  = 0;
+        int consumed_    = 0;
+
+        uint64_t cache_key_ = 0;
+        shared_ptr<iLogger::MappedFile> cache_mapping_;
+        atomic<int> cache_cursor_{0};
+        vector<CacheEntry> cache_entries_;
+        mutex cache_lock_;
+        FILE* cache_writer_  = nullptr;
+        string cache_temp_file_;
+        size_t cache_offset_ = 0;
+        int cache_written_   = 0;
+    };
+
+    shared_ptr<Loader> create_loader(const vector<string>& files, const LoaderConfig& config){
+
+        shared_ptr<LoaderImpl> instance(new LoaderImpl());
+        if(!instance->startup(files, config)){
+            instance.reset();
+        }
+        return instance;
+    }
+
+    vector<cv::Mat> load_images(const vector<string>& files, int num_threads, int imread_flags){
+
+        LoaderConfig config;
+        config.num_threads  = num_threads;
+        config.max_prefetch = files.size();
+        config.order        = Order::Completion;
+        config.imread_flags = imread_flags;
+
+        vector<cv::Mat> images(files.size());
+        auto loader = create_loader(files, config);
+        Item item;
+        while(loader->next(item))
+            images[item.index] = item.image;
+        return images;
+    }
+
+    vector<cv::Mat> load_calibration_batch(const vector<string>& files){
+        return load_images(files, CalibrationDecodeThreads);
+    }
+};
@@ -0,0 +1,65 @@
+
+
+#ifndef DATASET_LOADER_HPP
+#define DATASET_LOADER_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+/* 测试集、标定集的并行加载
+   图像的解码（imread）远比遍历目录慢，Loader用一组线程解码，按顺序或者按完成的先后返回
+   已经解码但还没有被取走的图像不超过max_prefetch，内存占用有上限 */
+namespace Dataset{
+
+    const char* const ImageFilter = "*.jpg;*.jpeg;*.png;*.bmp;*.gif;*.tif;*.tiff";
+
+    // 匹配规则与iLogger::find_files相同，返回排序后的路径，结果与目录的遍历顺序无关
+    // 使用readdir的d_type判断文件类型，不需要对每个文件lstat，多个子目录由num_threads个线程并行遍历
+    std::vector<std::string> find_images(
+        const std::string& directory, const std::string& filter = ImageFilter, bool include_subdirectory = true, int num_threads = 4
+    );
+
+    enum class Order : int{
+        Sequential = 0,     // 与files的顺序一致
+        Completion = 1      // 先解码完成的先返回，index为在files中的位置
+    };
+
+    /* cache_file不为空时，解码后的像素保存到cache_file，下次文件列表（路径和大小）一致时直接映射cache_file，不再解码
+       缓存只在所有图像都被next取走后才写入，中途退出不会留下不完整的缓存 */
+    struct LoaderConfig{
+        int num_threads  = 0;       // <= 0时使用CPU核数
+        int max_prefetch = 32;
+        Order order      = Order::Sequential;
+        int imread_flags = cv::IMREAD_COLOR;
+        std::string cache_file;
+    };
+
+    struct Item{
+        int index = -1;
+        std::string file;
+        cv::Mat image;              // 读取失败时为空。来自缓存时引用映射的内存，Loader释放后失效，需要保存时clone
+    };
+
+    class Loader{
+    public:
+        // 所有图像都已经返回时返回false
+        virtual bool next(Item& item) = 0;
+        virtual int size() const = 0;
+        virtual bool from_cache() const = 0;
+    };
+
+    std::shared_ptr<Loader> create_loader(const std::vector<std::string>& files, const LoaderConfig& config = LoaderConfig());
+
+    // 并行读取全部图像，顺序与files一致，例如Int8Process中读取一个batch
+    std::vector<cv::Mat> load_images(const std::vector<std::string>& files, int num_threads = 0, int imread_flags = cv::IMREAD_COLOR);
+
+    // 标定时解码一个batch的线程数。每个batch都会创建解码线程，不使用默认的CPU核数，标定开启num_threads时也不会创建过多线程
+    const int CalibrationDecodeThreads = 4;
+
+    // Int8Process中并行解码一个batch，顺序与files一致
+    std::vector<cv::Mat> load_calibration_batch(const std::vector<std::string>& files);
+};
+
+#endif // DATASET_LOADER_HPP
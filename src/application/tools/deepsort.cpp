@@ -975,4 +975,13 @@ namespace DeepSORT {
         ));
         return tracker_ptr;
     }
+
+    double hungarian_assignment(std::vector<std::vector<double>>& cost_matrix, std::vector<int>& assignment){
+        assignment.clear();
+        if(cost_matrix.empty() || cost_matrix[0].empty())
+            return 0;
+
+        HungarianAlgorithm HungAlgo;
+        return HungAlgo.Solve(cost_matrix, assignment);
+    }
 };
\ No newline at end of file
@@ -86,6 +86,9 @@ std::shared_ptr<Tracker> create_tracker(
     const TrackerConfig& config = TrackerConfig()
 );
 
+// 匈牙利算法求最小代价的匹配，assignment[i]为第i行匹配的列，没有匹配时为-1，返回总代价
+double hungarian_assignment(std::vector<std::vector<double>>& cost_matrix, std::vector<int>& assignment);
+
 }
 
 #endif // DEEPSORT_HPP
\ No newline at end of file
@@ -0,0 +1,844 @@
+
+#include "face_gallery.hpp"
+#include <common/ilogger.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define FACE_GALLERY_SSE42
+#endif
+
+namespace FaceGallery{
+
+    using namespace std;
+
+    static const uint32_t BASE_MAGIC    = 0x4C414746;   // "FGAL"
+    static const uint32_t LOG_MAGIC     = 0x474F4C46;   // "FLOG"
+    static const uint32_t RECORD_MAGIC  = 0x43455246;   // "FREC"
+    static const uint32_t VERSION       = 1;
+    static const uint64_t SECTION_ALIGN = 64;
+
+    enum RecordType : uint32_t{
+        RecordAdd    = 1,
+        RecordRemove = 2
+    };
+
+    struct BaseHeader{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t dim;
+        uint32_t stride;                // FaceIndex::aligned_dim(dim)
+        uint64_t generation;
+        uint64_t count;
+        uint64_t features_offset;       // count x stride个float，已经归一化
+        uint64_t ids_offset;            // count个int64
+        uint64_t index_offset;          // count个IndexEntry，按id排序，用于二分查找
+        uint64_t names_offset;          // count + 1个uint64的偏移，然后是名字
+        uint64_t names_size;
+        uint64_t file_size;
+        uint32_t features_crc;
+        uint32_t ids_crc;
+        uint32_t index_crc;
+        uint32_t names_crc;
+        uint32_t reserved;
+        uint32_t header_crc;            // 前面所有字段的crc
+    };
+
+    struct IndexEntry{
+        int64_t id;
+        int64_t row;
+    };
+
+    struct LogHeader{
+        uint32_t magic;
+        uint32_t version;
+        uint32_t dim;
+        uint32_t reserved;
+        uint64_t generation;            // 与快照一致时日志才有效
+    };
+
+    // 每条记录按8字节对齐，add后面是dim个float和名字
+    struct RecordHeader{
+        uint32_t magic;
+        uint32_t crc;                   // type开始到记录结束的crc
+        uint32_t type;
+        uint32_t name_length;
+        int64_t id;
+    };
+
+    static uint64_t align_up(uint64_t value, uint64_t alignment){
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+#ifndef FACE_GALLERY_SSE42
+    static const uint32_t* crc32c_table(){
+
+        // slicing-by-8
+        static vector<uint32_t> table = [](){
+            vector<uint32_t> output(8 * 256);
+            for(uint32_t i = 0; i < 256; ++i){
+                uint32_t crc = i;
+                for(int j = 0; j < 8; ++j)
+                    crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+                output[i] = crc;
+            }
+
+            for(uint32_t i = 0; i < 256; ++i){
+                for(int k = 1; k < 8; ++k)
+                    output[k * 256 + i] = (output[(k - 1) * 256 + i] >> 8) ^ output[output[(k - 1) * 256 + i] & 0xFF];
+            }
+            return output;
+        }();
+        return table.data();
+    }
+#endif
+
+    uint32_t crc32c(const void* data, size_t size, uint32_t crc){
+
+        const uint8_t* p = (const uint8_t*)data;
+        crc = ~crc;
+#ifdef FACE_GALLERY_SSE42
+        uint64_t crc64 = crc;
+        for(; size >= 8; size -= 8, p += 8){
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            crc64 = _mm_crc32_u64(crc64, value);
+        }
+
+        crc = (uint32_t)crc64;
+        for(; size > 0; --size, ++p)
+            crc = _mm_crc32_u8(crc, *p);
+#else
+        const uint32_t* table = crc32c_table();
+        for(; size >= 8; size -= 8, p += 8){
+            uint32_t low, high;
+            memcpy(&low, p, sizeof(low));
+            memcpy(&high, p + 4, sizeof(high));
+            low ^= crc;
+            crc = table[7 * 256 + (low & 0xFF)]         ^ table[6 * 256 + ((low >> 8) & 0xFF)] ^
+                  table[5 * 256 + ((low >> 16) & 0xFF)] ^ table[4 * 256 + (low >> 24)] ^
+                  table[3 * 256 + (high & 0xFF)]        ^ table[2 * 256 + ((high >> 8) & 0xFF)] ^
+                  table[1 * 256 + ((high >> 16) & 0xFF)] ^ table[0 * 256 + (high >> 24)];
+        }
+
+        for(; size > 0; --size, ++p)
+            crc = (crc >> 8) ^ table[(crc ^ *p) & 0xFF];
+#endif
+        return ~crc;
+    }
+
+    static bool read_at(int fd, void* data, size_t size, uint64_t offset){
+        uint8_t* p = (uint8_t*)data;
+        while(size > 0){
+            ssize_t n = pread(fd, p, size, offset);
+            if(n <= 0) return false;
+            p += n; size -= n; offset += n;
+        }
+        return true;
+    }
+
+    static bool write_at(int fd, const void* data, size_t size, uint64_t offset){
+        const uint8_t* p = (const uint8_t*)data;
+        while(size > 0){
+            ssize_t n = pwrite(fd, p, size, offset);
+            if(n <= 0) return false;
+            p += n; size -= n; offset += n;
+        }
+        return true;
+    }
+
+    static bool inode_of(const string& path, ino_t& inode){
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0) return false;
+        inode = st.st_ino;
+        return true;
+    }
+
+    // rename之后需要fsync目录，保证目录项落盘
+    static void sync_directory(const string& directory){
+        int fd = ::open(directory.c_str(), O_RDONLY);
+        if(fd != -1){
+            fsync(fd);
+            ::close(fd);
+        }
+    }
+
+    // 写入一个段，同时计算crc，不足对齐的部分补零
+    class SectionWriter{
+    public:
+        SectionWriter(FILE* f):f_(f){}
+
+        void write(const void* data, size_t size){
+            if(size == 0) return;
+            crc_ = crc32c(data, size, crc_);
+            ok_ = ok_ && fwrite(data, 1, size, f_) == size;
+            offset_ += size;
+        }
+
+        uint32_t finish(uint64_t next_offset){
+            static const char zeros[SECTION_ALIGN] = {0};
+            uint32_t crc = crc_;
+            if(next_offset > offset_){
+                ok_ = ok_ && fwrite(zeros, 1, next_offset - offset_, f_) == next_offset - offset_;
+                offset_ = next_offset;
+            }
+            crc_ = 0;
+            return crc;
+        }
+
+        bool ok() const{return ok_;}
+
+    private:
+        FILE* f_       = nullptr;
+        uint64_t offset_ = sizeof(BaseHeader);
+        uint32_t crc_  = 0;
+        bool ok_       = true;
+    };
+
+    // 写快照，feature(i, output)取第i行归一化后的特征，output长度为stride
+    static bool write_base(
+        const string& file, int dim, uint64_t generation, const vector<int64_t>& ids, const vector<string>& names,
+        const function<void(size_t i, float* output)>& feature
+    ){
+        int stride     = FaceIndex::aligned_dim(dim);
+        uint64_t count = ids.size();
+
+        BaseHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic      = BASE_MAGIC;
+        header.version    = VERSION;
+        header.dim        = dim;
+        header.stride     = stride;
+        header.generation = generation;
+        header.count      = count;
+
+        uint64_t names_bytes = 0;
+        for(auto& name : names) names_bytes += name.size();
+
+        header.features_offset = align_up(sizeof(BaseHeader), SECTION_ALIGN);
+        header.ids_offset      = align_up(header.features_offset + count * stride * sizeof(float), SECTION_ALIGN);
+        header.index_offset    = align_up(header.ids_offset + count * sizeof(int64_t), SECTION_ALIGN);
+        header.names_offset    = align_up(header.index_offset + count * sizeof(IndexEntry), SECTION_ALIGN);
+        header.names_size      = (count + 1) * sizeof(uint64_t) + names_bytes;
+        header.file_size       = header.names_offset + header.names_size;
+
+        FILE* f = fopen(file.c_str(), "wb");
+        if(f == nullptr){
+            INFOE("Open %s failed", file.c_str());
+            return false;
+        }
+
+        SectionWriter writer(f);
+        bool ok = fwrite(&header, 1, sizeof(header), f) == sizeof(header);
+        writer.finish(header.features_offset);
+
+        vector<float> row(stride);
+        for(size_t i = 0; i < count; ++i){
+            feature(i, row.data());
+            writer.write(row.data(), sizeof(float) * stride);
+        }
+        header.features_crc = writer.finish(header.ids_offset);
+
+        writer.write(ids.data(), sizeof(int64_t) * count);
+        header.ids_crc = writer.finish(header.index_offset);
+
+        vector<IndexEntry> index(count);
+        for(size_t i = 0; i < count; ++i)
+            index[i] = {ids[i], (int64_t)i};
+
+        std::sort(index.begin(), index.end(), [](const IndexEntry& a, const IndexEntry& b){return a.id < b.id;});
+        writer.write(index.data(), sizeof(IndexEntry) * count);
+        header.index_crc = writer.finish(header.names_offset);
+
+        vector<uint64_t> offsets(count + 1, 0);
+        for(size_t i = 0; i < count; ++i)
+            offsets[i + 1] = offsets[i] + names[i].size();
+
+        writer.write(offsets.data(), sizeof(uint64_t) * offsets.size());
+        for(auto& name : names)
+            writer.write(name.data(), name.size());
+        header.names_crc  = writer.finish(header.file_size);
+        header.header_crc = crc32c(&header, offsetof(BaseHeader, header_crc));
+
+        ok = ok && writer.ok() && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, 1, sizeof(header), f) == sizeof(header);
+        ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+        fclose(f);
+
+        if(!ok)
+            INFOE("Write %s failed", file.c_str());
+        return ok;
+    }
+
+    // 写临时文件后rename，读者通过inode变化发现新的日志
+    static bool write_empty_log(const string& file, int dim, uint64_t generation){
+
+        LogHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic      = LOG_MAGIC;
+        header.version    = VERSION;
+        header.dim        = dim;
+        header.generation = generation;
+
+        string tmp = file + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd == -1){
+            INFOE("Open %s failed", tmp.c_str());
+            return false;
+        }
+
+        bool ok = write_at(fd, &header, sizeof(header), 0) && fsync(fd) == 0;
+        ::close(fd);
+        ok = ok && rename(tmp.c_str(), file.c_str()) == 0;
+        if(!ok){
+            INFOE("Write %s failed", file.c_str());
+            iLogger::delete_file(tmp);
+        }
+        return ok;
+    }
+
+    class GalleryImpl : public Gallery{
+    public:
+        virtual ~GalleryImpl(){
+            close_log();
+            if(lock_fd_ != -1)
+                ::close(lock_fd_);
+        }
+
+        bool startup(const string& directory, Mode mode, const Config& config){
+
+            if(config.dim <= 0){
+                INFOE("Invalid dim %d", config.dim);
+                return false;
+            }
+
+            config_    = config;
+            mode_      = mode;
+            directory_ = directory;
+            base_path_ = directory + "/gallery.base";
+            log_path_  = directory + "/gallery.log";
+            stride_    = FaceIndex::aligned_dim(config.dim);
+
+            if(mode == Mode::Write){
+                if(!iLogger::mkdirs(directory)){
+                    INFOE("Create directory %s failed", directory.c_str());
+                    return false;
+                }
+
+                string lock_path = directory + "/gallery.lock";
+                lock_fd_ = ::open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+                if(lock_fd_ == -1 || flock(lock_fd_, LOCK_EX | LOCK_NB) != 0){
+                    INFOE("Gallery %s is opened by another writer", directory.c_str());
+                    return false;
+                }
+
+                if(!iLogger::exists(base_path_)){
+                    if(!write_base(base_path_, config.dim, 1, vector<int64_t>(), vector<string>(), nullptr) ||
+                       !write_empty_log(log_path_, config.dim, 1))
+                        return false;
+                    sync_directory(directory);
+                }
+            }
+            return load();
+        }
+
+        virtual bool add(int64_t id, const float* feature, const string& name) override{
+
+            unique_lock<mutex> l(lock_);
+            if(mode_ != Mode::Write){
+                INFOE("Gallery is opened in read mode");
+                return false;
+            }
+            return append(RecordAdd, id, feature, name);
+        }
+
+        virtual bool remove(int64_t id) override{
+
+            unique_lock<mutex> l(lock_);
+            if(mode_ != Mode::Write){
+                INFOE("Gallery is opened in read mode");
+                return false;
+            }
+
+            if(!contains_locked(id)) return false;
+            return append(RecordRemove, id, nullptr, "");
+        }
+
+        virtual bool compact() override{
+
+            unique_lock<mutex> l(lock_);
+            if(mode_ != Mode::Write){
+                INFOE("Gallery is opened in read mode");
+                return false;
+            }
+
+            // 快照中有效的行在前，日志中的记录在后
+            vector<int64_t> rows;
+            vector<int64_t> ids;
+            vector<string> names;
+            for(uint64_t row = 0; row < base_->count; ++row){
+                if(!base_valid(row)) continue;
+                rows.emplace_back(row);
+                ids.emplace_back(base_ids_[row]);
+                names.emplace_back(base_name(row));
+            }
+
+            size_t num_base_rows = rows.size();
+            for(auto id : delta_->ids()){
+                ids.emplace_back(id);
+                names.emplace_back(delta_names_[id]);
+            }
+
+            uint64_t generation = base_->generation + 1;
+            string base_tmp = base_path_ + ".tmp";
+            bool ok = write_base(base_tmp, config_.dim, generation, ids, names, [&](size_t i, float* output){
+                if(i < num_base_rows){
+                    memcpy(output, base_features_ + rows[i] * stride_, sizeof(float) * stride_);
+                }else{
+                    memset(output, 0, sizeof(float) * stride_);
+                    delta_->get(ids[i], output);
+                }
+            });
+
+            // 先替换快照再替换日志，两次rename之间崩溃时，旧日志的generation小于快照，打开时会被忽略
+            ok = ok && rename(base_tmp.c_str(), base_path_.c_str()) == 0;
+            if(!ok){
+                INFOE("Compact gallery %s failed", directory_.c_str());
+                iLogger::delete_file(base_tmp);
+                return false;
+            }
+
+            ok = write_empty_log(log_path_, config_.dim, generation);
+            sync_directory(directory_);
+            return load() && ok;
+        }
+
+        virtual bool refresh() override{
+
+            unique_lock<mutex> l(lock_);
+            ino_t base_inode = 0, log_inode = 0;
+            if(!inode_of(base_path_, base_inode)){
+                INFOE("Gallery %s not found", base_path_.c_str());
+                return false;
+            }
+
+            // 快照或者日志被替换时重新打开，被忽略的旧日志也记录了inode，不会反复加载
+            bool has_log = inode_of(log_path_, log_inode);
+            if(base_inode != base_inode_ || (has_log && log_inode != log_inode_))
+                return load();
+
+            if(log_fd_ != -1)
+                replay_log();
+            return true;
+        }
+
+        virtual bool verify() override{
+            unique_lock<mutex> l(lock_);
+            return verify_locked();
+        }
+
+        virtual vector<vector<FaceIndex::Match>> search(const float* features, int num, int topk) override{
+
+            vector<vector<FaceIndex::Match>> output(std::max(0, num));
+            if(num <= 0 || topk <= 0) return output;
+
+            unique_lock<mutex> l(lock_);
+            if(base_live_ > 0){
+                FaceIndex::RowView view;
+                view.features = base_features_;
+                view.ids      = base_ids_;
+                view.valid    = base_valid_.empty() ? nullptr : base_valid_.data();
+                view.num_rows = base_->count;
+                view.stride   = stride_;
+                output = FaceIndex::search_rows(view, index_config(), features, num, topk);
+            }
+
+            if(delta_->size() > 0){
+                auto delta = delta_->search(features, num, topk);
+                for(int i = 0; i < num; ++i){
+                    auto& merged = output[i];
+                    merged.insert(merged.end(), delta[i].begin(), delta[i].end());
+                    std::sort(merged.begin(), merged.end(), [](const FaceIndex::Match& a, const FaceIndex::Match& b){
+                        return a.score > b.score || (a.score == b.score && a.id < b.id);
+                    });
+
+                    if((int)merged.size() > topk)
+                        merged.resize(topk);
+                }
+            }
+            return output;
+        }
+
+        virtual bool contains(int64_t id) const override{
+            unique_lock<mutex> l(lock_);
+            return contains_locked(id);
+        }
+
+        virtual bool get(int64_t id, float* feature, string* name) const override{
+
+            unique_lock<mutex> l(lock_);
+            auto iter = delta_names_.find(id);
+            if(iter != delta_names_.end()){
+                if(feature) delta_->get(id, feature);
+                if(name) *name = iter->second;
+                return true;
+            }
+
+            int64_t row = find_base(id);
+            if(row < 0 || !base_valid(row)) return false;
+
+            if(feature) memcpy(feature, base_features_ + row * stride_, sizeof(float) * config_.dim);
+            if(name) *name = base_name(row);
+            return true;
+        }
+
+        virtual string name(int64_t id) const override{
+            string output;
+            get(id, nullptr, &output);
+            return output;
+        }
+
+        virtual size_t size() const override{
+            unique_lock<mutex> l(lock_);
+            return base_live_ + delta_->size();
+        }
+
+        virtual Info info() const override{
+            unique_lock<mutex> l(lock_);
+            Info output;
+            output.generation = base_->generation;
+            output.num_base   = base_->count;
+            output.num_log    = num_log_;
+            output.size       = base_live_ + delta_->size();
+            output.log_bytes  = log_offset_;
+            return output;
+        }
+
+        virtual const Config& config() const override{
+            return config_;
+        }
+
+    private:
+        FaceIndex::Config index_config() const{
+            FaceIndex::Config config;
+            config.dim         = config_.dim;
+            config.num_threads = config_.num_threads;
+            config.normalize   = true;
+            return config;
+        }
+
+        // 重新打开快照和日志，打开后立即可用，不读取特征数据
+        bool load(){
+
+            close_log();
+            base_file_.reset();
+            base_ = nullptr;
+            base_valid_.clear();
+            delta_names_.clear();
+            num_log_ = 0;
+            delta_   = FaceIndex::create_index(index_config());
+            if(delta_ == nullptr) return false;
+
+            if(!open_base()) return false;
+            if(!open_log()) return false;
+            return true;
+        }
+
+        bool open_base(){
+
+            base_file_ = iLogger::map_file(base_path_);
+            if(base_file_ == nullptr || base_file_->size() < sizeof(BaseHeader)){
+                INFOE("Open gallery %s failed", base_path_.c_str());
+                base_file_.reset();
+                return false;
+            }
+
+            auto header = (const BaseHeader*)base_file_->data();
+            uint64_t count = header->count;
+            bool valid = header->magic == BASE_MAGIC && header->version == VERSION &&
+                header->header_crc == crc32c(header, offsetof(BaseHeader, header_crc)) &&
+                header->file_size == base_file_->size() &&
+                header->features_offset + count * header->stride * sizeof(float) <= header->ids_offset &&
+                header->ids_offset + count * sizeof(int64_t) <= header->index_offset &&
+                header->index_offset + count * sizeof(IndexEntry) <= header->names_offset &&
+                header->names_offset + header->names_size <= header->file_size &&
+                (count + 1) * sizeof(uint64_t) <= header->names_size;
+
+            if(!valid){
+                INFOE("Invalid or corrupted gallery %s", base_path_.c_str());
+                base_file_.reset();
+                return false;
+            }
+
+            if((int)header->dim != config_.dim || (int)header->stride != stride_){
+                INFOE("Gallery %s has dim %d, expect %d", base_path_.c_str(), header->dim, config_.dim);
+                base_file_.reset();
+                return false;
+            }
+
+            const uint8_t* data = (const uint8_t*)base_file_->data();
+            base_              = header;
+            base_features_     = (const float*)(data + header->features_offset);
+            base_ids_          = (const int64_t*)(data + header->ids_offset);
+            base_index_        = (const IndexEntry*)(data + header->index_offset);
+            base_name_offsets_ = (const uint64_t*)(data + header->names_offset);
+            base_names_        = (const char*)(base_name_offsets_ + count + 1);
+            base_live_         = count;
+            inode_of(base_path_, base_inode_);
+
+            if(config_.verify && !verify_locked()){
+                base_file_.reset();
+                base_ = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+        bool open_log(){
+
+            log_offset_ = sizeof(LogHeader);
+            log_inode_  = 0;
+            log_fd_ = ::open(log_path_.c_str(), mode_ == Mode::Write ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+            if(log_fd_ == -1){
+                if(mode_ == Mode::Write){
+                    INFOE("Open %s failed", log_path_.c_str());
+                    return false;
+                }
+
+                // 读者没有日志时只使用快照，refresh时再检查
+                return true;
+            }
+
+            struct stat st;
+            fstat(log_fd_, &st);
+            log_inode_ = st.st_ino;
+
+            LogHeader header;
+            bool has_header = (size_t)st.st_size >= sizeof(header) && read_at(log_fd_, &header, sizeof(header), 0);
+            if(has_header && (header.magic != LOG_MAGIC || header.version != VERSION || (int)header.dim != config_.dim)){
+                INFOE("Invalid gallery log %s", log_path_.c_str());
+                close_log();
+                return false;
+            }
+
+            // compact在两次rename之间中断时，日志比快照旧，其中的记录已经合并到快照中
+            if(!has_header || header.generation != base_->generation){
+                if(mode_ == Mode::Read){
+                    close_log();
+                    return true;
+                }
+
+                if(has_header)
+                    INFOW("Discard gallery log of generation %lld, gallery is generation %lld", (long long)header.generation, (long long)base_->generation);
+
+                close_log();
+                log_inode_ = 0;
+                if(!write_empty_log(log_path_, config_.dim, base_->generation)) return false;
+                return open_log();
+            }
+
+            replay_log();
+            if(mode_ == Mode::Write && (uint64_t)st.st_size > log_offset_){
+                // 最后一条记录没有写完整，例如写入时崩溃
+                INFOW("Truncate %lld bytes of incomplete record in %s", (long long)(st.st_size - log_offset_), log_path_.c_str());
+                if(ftruncate(log_fd_, log_offset_) != 0){
+                    INFOE("Truncate %s failed", log_path_.c_str());
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void close_log(){
+            if(log_fd_ != -1){
+                ::close(log_fd_);
+                log_fd_ = -1;
+            }
+        }
+
+        // 读取log_offset_之后完整的记录，不完整或者crc错误的记录留到下次
+        void replay_log(){
+
+            struct stat st;
+            if(fstat(log_fd_, &st) != 0 || (uint64_t)st.st_size <= log_offset_) return;
+
+            vector<uint8_t> buffer(st.st_size - log_offset_);
+            if(!read_at(log_fd_, buffer.data(), buffer.size(), log_offset_)) return;
+
+            size_t feature_bytes = sizeof(float) * config_.dim;
+            size_t offset = 0;
+            while(offset + sizeof(RecordHeader) <= buffer.size()){
+
+                RecordHeader header;
+                memcpy(&header, buffer.data() + offset, sizeof(header));
+                if(header.magic != RECORD_MAGIC || (header.type != RecordAdd && header.type != RecordRemove)) break;
+
+                size_t payload = (header.type == RecordAdd ? feature_bytes : 0) + header.name_length;
+                size_t size    = align_up(sizeof(RecordHeader) + payload, 8);
+                if(offset + size > buffer.size()) break;
+
+                const uint8_t* record = buffer.data() + offset;
+                uint32_t crc = crc32c(record + offsetof(RecordHeader, type), size - offsetof(RecordHeader, type));
+                if(crc != header.crc) break;
+
+                const uint8_t* pdata = record + sizeof(RecordHeader);
+                if(header.type == RecordAdd){
+                    vector<float> feature(config_.dim);
+                    memcpy(feature.data(), pdata, feature_bytes);
+                    apply(RecordAdd, header.id, feature.data(), string((const char*)pdata + feature_bytes, header.name_length));
+                }else{
+                    apply(RecordRemove, header.id, nullptr, string());
+                }
+
+                offset += size;
+                num_log_++;
+            }
+            log_offset_ += offset;
+        }
+
+        bool append(RecordType type, int64_t id, const float* feature, const string& name){
+
+            size_t feature_bytes = type == RecordAdd ? sizeof(float) * config_.dim : 0;
+            size_t size = align_up(sizeof(RecordHeader) + feature_bytes + name.size(), 8);
+            vector<uint8_t> record(size, 0);
+
+            RecordHeader header;
+            header.magic       = RECORD_MAGIC;
+            header.crc         = 0;
+            header.type        = type;
+            header.name_length = name.size();
+            header.id          = id;
+            memcpy(record.data(), &header, sizeof(header));
+            if(feature_bytes > 0)
+                memcpy(record.data() + sizeof(header), feature, feature_bytes);
+            if(!name.empty())
+                memcpy(record.data() + sizeof(header) + feature_bytes, name.data(), name.size());
+
+            header.crc = crc32c(record.data() + offsetof(RecordHeader, type), size - offsetof(RecordHeader, type));
+            memcpy(record.data() + offsetof(RecordHeader, crc), &header.crc, sizeof(header.crc));
+
+            // 一次写入整条记录，读者可能读到一半，由crc过滤
+            if(!write_at(log_fd_, record.data(), size, log_offset_) || (config_.sync && fdatasync(log_fd_) != 0)){
+                INFOE("Append to %s failed", log_path_.c_str());
+                return false;
+            }
+
+            log_offset_ += size;
+            num_log_++;
+            apply(type, id, feature, name);
+            return true;
+        }
+
+        void apply(RecordType type, int64_t id, const float* feature, const string& name){
+
+            // 快照中的同一个id被覆盖或者删除
+            int64_t row = find_base(id);
+            if(row >= 0 && base_valid(row)){
+                if(base_valid_.empty())
+                    base_valid_.assign(base_->count, 1);
+
+                base_valid_[row] = 0;
+                base_live_--;
+            }
+
+            if(type == RecordAdd){
+                delta_->add(id, feature);
+                delta_names_[id] = name;
+            }else{
+                delta_->remove(id);
+                delta_names_.erase(id);
+            }
+        }
+
+        int64_t find_base(int64_t id) const{
+            const IndexEntry* begin = base_index_;
+            const IndexEntry* end   = base_index_ + base_->count;
+            auto iter = std::lower_bound(begin, end, id, [](const IndexEntry& a, int64_t id){return a.id < id;});
+            if(iter == end || iter->id != id) return -1;
+            return iter->row;
+        }
+
+        bool base_valid(int64_t row) const{
+            return base_valid_.empty() || base_valid_[row];
+        }
+
+        string base_name(int64_t row) const{
+            return string(base_names_ + base_name_offsets_[row], base_name_offsets_[row + 1] - base_name_offsets_[row]);
+        }
+
+        bool contains_locked(int64_t id) const{
+            if(delta_names_.find(id) != delta_names_.end()) return true;
+            int64_t row = find_base(id);
+            return row >= 0 && base_valid(row);
+        }
+
+        bool verify_locked() const{
+
+            const uint8_t* data = (const uint8_t*)base_file_->data();
+            struct Section{
+                const char* name;
+                uint64_t offset, size;
+                uint32_t crc;
+            } sections[] = {
+                {"features", base_->features_offset, base_->count * base_->stride * sizeof(float), base_->features_crc},
+                {"ids",      base_->ids_offset,      base_->count * sizeof(int64_t),              base_->ids_crc},
+                {"index",    base_->index_offset,    base_->count * sizeof(IndexEntry),           base_->index_crc},
+                {"names",    base_->names_offset,    base_->names_size,                           base_->names_crc}
+            };
+
+            base_file_->advise(iLogger::MapAdvice::Sequential);
+            for(auto& section : sections){
+                if(crc32c(data + section.offset, section.size) != section.crc){
+                    INFOE("Gallery %s is corrupted, checksum of %s mismatch", base_path_.c_str(), section.name);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        Config config_;
+        Mode mode_ = Mode::Read;
+        string directory_, base_path_, log_path_;
+        int stride_  = 0;
+        int lock_fd_ = -1;
+
+        // 快照
+        shared_ptr<iLogger::MappedFile> base_file_;
+        const BaseHeader* base_           = nullptr;
+        const float* base_features_       = nullptr;
+        const int64_t* base_ids_          = nullptr;
+        const IndexEntry* base_index_     = nullptr;
+        const uint64_t* base_name_offsets_= nullptr;
+        const char* base_names_           = nullptr;
+        vector<uint8_t> base_valid_;      // 为空表示全部有效，第一次删除或覆盖时才分配
+        size_t base_live_                 = 0;
+        ino_t base_inode_                 = 0;
+
+        // 日志，其中的记录放在delta_
+        int log_fd_          = -1;
+        ino_t log_inode_     = 0;
+        uint64_t log_offset_ = 0;
+        size_t num_log_      = 0;
+        shared_ptr<FaceIndex::Index> delta_;
+        unordered_map<int64_t, string> delta_names_;
+        mutable mutex lock_;
+    };
+
+    shared_ptr<Gallery> open_gallery(const string& directory, Mode mode, const Config& config){
+        shared_ptr<GalleryImpl> instance(new GalleryImpl());
+        if(!instance->startup(directory, mode, config)){
+            instance.reset();
+        }
+        return instance;
+    }
+};
@@ -0,0 +1,82 @@
+
+
+#ifndef FACE_GALLERY_HPP
+#define FACE_GALLERY_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "face_index.hpp"
+
+/* 持久化的人脸底库，目录下三个文件：
+   gallery.base  不可变的快照，特征按64字节对齐连续存放，直接mmap后搜索，打开时间与底库大小无关
+                 另有按id排序的索引、id数组和名字表，每一段都有crc32c
+   gallery.log   追加日志，add/remove每条记录一个crc32c，打开时重放到内存中的FaceIndex
+   gallery.lock  写者互斥，同一时间只能有一个写者
+
+   compact把快照与日志合并为新的快照，写临时文件后rename替换，中途崩溃不会损坏底库
+   读者（其他进程或者另外打开的Gallery）调用refresh读取新追加的记录，或者在compact后重新加载 */
+namespace FaceGallery{
+
+    enum class Mode : int{
+        Read  = 0,
+        Write = 1      // 目录或者文件不存在时创建
+    };
+
+    struct Config{
+        int dim         = 512;
+        int num_threads = 0;        // 搜索的线程数，<= 0时使用CPU核数
+        bool verify     = false;    // 打开时校验快照所有段的crc，需要读完整个文件
+        bool sync       = false;    // 每次追加后fdatasync，掉电也不丢失记录
+    };
+
+    struct Info{
+        uint64_t generation = 0;    // 每次compact加1
+        size_t num_base     = 0;    // 快照中的记录数，包括被删除或覆盖的
+        size_t num_log      = 0;    // 日志中的记录数
+        size_t size         = 0;    // 当前有效的特征数
+        size_t log_bytes    = 0;
+    };
+
+    // 同一个对象的各个方法之间互斥，多个线程可以共享
+    class Gallery{
+    public:
+        // 写模式下可用，id已经存在时覆盖，feature为dim个float
+        virtual bool add(int64_t id, const float* feature, const std::string& name) = 0;
+        virtual bool remove(int64_t id) = 0;
+        virtual bool compact() = 0;
+
+        // 读模式下加载其他进程新追加的记录，快照被compact替换时重新打开
+        virtual bool refresh() = 0;
+
+        // 完整校验快照各个段的crc
+        virtual bool verify() = 0;
+
+        virtual std::vector<std::vector<FaceIndex::Match>> search(const float* features, int num, int topk) = 0;
+        virtual bool contains(int64_t id) const = 0;
+        virtual bool get(int64_t id, float* feature, std::string* name) const = 0;
+        virtual std::string name(int64_t id) const = 0;
+        virtual size_t size() const = 0;
+        virtual Info info() const = 0;
+        virtual const Config& config() const = 0;
+
+        bool add(int64_t id, const cv::Mat& feature, const std::string& name){
+            if(feature.empty() || feature.type() != CV_32F || !feature.isContinuous() || feature.rows != 1 || feature.cols != config().dim) return false;
+            return add(id, feature.ptr<float>(0), name);
+        }
+
+        std::vector<FaceIndex::Match> search(const cv::Mat& feature, int topk){
+            if(feature.empty() || feature.type() != CV_32F || !feature.isContinuous() || feature.rows != 1 || feature.cols != config().dim)
+                return std::vector<FaceIndex::Match>();
+            return search(feature.ptr<float>(0), 1, topk)[0];
+        }
+    };
+
+    std::shared_ptr<Gallery> open_gallery(const std::string& directory, Mode mode, const Config& config = Config());
+
+    // crc32c (Castagnoli)，支持SSE4.2时使用crc32指令
+    uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+};
+
+#endif // FACE_GALLERY_HPP
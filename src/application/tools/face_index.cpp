@@ -0,0 +1,790 @@
+
+#include "face_index.hpp"
+#include <common/ilogger.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <functional>
+#include <cmath>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FACE_INDEX_SSE2
+#endif
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+namespace FaceIndex{
+
+    using namespace std;
+
+    static const int DIM_ALIGN              = 16;       // 每行补零到16的倍数，SIMD不需要处理尾部
+    static const size_t TASK_ROWS           = 16384;    // 每个扫描任务的行数
+    static const size_t BLOCK_ROWS          = 64;       // 一个块的特征被多个query复用，留在L1/L2中
+    static const size_t MIN_WORK_PER_THREAD = 1 << 18;  // 行数 x query数，小于这个值不开线程
+    static const int KMEANS_ITERATIONS      = 10;
+    static const int KMEANS_MAX_SAMPLES_PER_LIST = 64;
+    static const float INT16_QUERY_MAX      = 4095.0f;  // query量化到12位，int8 x int16累加512维不会溢出int32
+
+    static int resolve_threads(int num_threads){
+        if(num_threads > 0) return num_threads;
+        return std::max(1, (int)thread::hardware_concurrency());
+    }
+
+    static uint32_t as_uint(float f){uint32_t u; memcpy(&u, &f, sizeof(u)); return u;}
+    static float as_float(uint32_t u){float f; memcpy(&f, &u, sizeof(f)); return f;}
+
+    // round to nearest even
+    static uint16_t float_to_half(float value){
+
+        const uint32_t f32_infinity = 255 << 23;
+        const uint32_t f16_max      = (127 + 16) << 23;
+        const uint32_t denorm_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+        uint32_t x    = as_uint(value);
+        uint32_t sign = x & 0x80000000u;
+        uint32_t o    = 0;
+        x ^= sign;
+
+        if(x >= f16_max){
+            o = x > f32_infinity ? 0x7E00 : 0x7C00;
+        }else if(x < (113u << 23)){
+            o = as_uint(as_float(x) + as_float(denorm_magic)) - denorm_magic;
+        }else{
+            uint32_t mantissa_odd = (x >> 13) & 1;
+            x += ((uint32_t)(15 - 127) << 23) + 0xFFF;
+            x += mantissa_odd;
+            o = x >> 13;
+        }
+        return (uint16_t)(o | (sign >> 16));
+    }
+
+#ifndef FACE_INDEX_SSE2
+    static float half_to_float(uint16_t h){
+
+        const uint32_t shifted_exponent = 0x7C00 << 13;
+        uint32_t o        = (h & 0x7FFF) << 13;
+        uint32_t exponent = o & shifted_exponent;
+        o += (127 - 15) << 23;
+
+        if(exponent == shifted_exponent){
+            o += (128 - 16) << 23;
+        }else if(exponent == 0){
+            o += 1 << 23;
+            o = as_uint(as_float(o) - as_float(113 << 23));
+        }
+        return as_float(o | ((h & 0x8000) << 16));
+    }
+#endif
+
+#ifdef FACE_INDEX_SSE2
+    static inline float horizontal_sum(__m128 v){
+        __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 sums = _mm_add_ps(v, shuf);
+        shuf        = _mm_movehl_ps(shuf, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+    }
+
+    // 4个float16（每个占32位的低16位）转float，非规格化数和inf/nan的处理与标量版本一致
+    static inline __m128 half4_to_float(__m128i h){
+
+        // 指数乘以2^112完成偏移，非规格化数也由乘法处理，inf/nan单独修正
+        const __m128i mask_nosign = _mm_set1_epi32(0x7FFF);
+        const __m128 magic        = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+        const __m128 infinity     = _mm_castsi128_ps(_mm_set1_epi32((127 + 16) << 23));
+        const __m128i exponent    = _mm_set1_epi32(255 << 23);
+
+        __m128 o     = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, mask_nosign), 13)), magic);
+        __m128i bits = _mm_or_si128(_mm_castps_si128(o), _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(o, infinity)), exponent));
+        return _mm_castsi128_ps(_mm_or_si128(bits, _mm_slli_epi32(_mm_andnot_si128(mask_nosign, h), 16)));
+    }
+
+    // 8个float16转float，编译时开启-mf16c则使用vcvtph2ps
+    static inline void half8_to_float(__m128i h, __m128& low, __m128& high){
+#ifdef __F16C__
+        low  = _mm_cvtph_ps(h);
+        high = _mm_cvtph_ps(_mm_unpackhi_epi64(h, h));
+#else
+        const __m128i zero = _mm_setzero_si128();
+        low  = half4_to_float(_mm_unpacklo_epi16(h, zero));
+        high = half4_to_float(_mm_unpackhi_epi16(h, zero));
+#endif
+    }
+#endif
+
+    // n为DIM_ALIGN的倍数
+    static float dot_float32(const float* a, const float* b, int n){
+#ifdef FACE_INDEX_SSE2
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        for(int i = 0; i < n; i += 16){
+            s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i + 0),  _mm_loadu_ps(b + i + 0)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),  _mm_loadu_ps(b + i + 4)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a + i + 8),  _mm_loadu_ps(b + i + 8)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+        }
+        return horizontal_sum(_mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+#else
+        float s = 0;
+        for(int i = 0; i < n; ++i) s += a[i] * b[i];
+        return s;
+#endif
+    }
+
+    static float dot_float16(const float* a, const uint16_t* b, int n){
+#ifdef FACE_INDEX_SSE2
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        __m128 b0, b1, b2, b3;
+        for(int i = 0; i < n; i += 16){
+            half8_to_float(_mm_loadu_si128((const __m128i*)(b + i)),     b0, b1);
+            half8_to_float(_mm_loadu_si128((const __m128i*)(b + i + 8)), b2, b3);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i + 0),  b0));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),  b1));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a + i + 8),  b2));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), b3));
+        }
+        return horizontal_sum(_mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+#else
+        float s = 0;
+        for(int i = 0; i < n; ++i) s += a[i] * half_to_float(b[i]);
+        return s;
+#endif
+    }
+
+    static void decode_half(const uint16_t* input, float* output, int n){
+#ifdef FACE_INDEX_SSE2
+        __m128 low, high;
+        for(int i = 0; i < n; i += 8){
+            half8_to_float(_mm_loadu_si128((const __m128i*)(input + i)), low, high);
+            _mm_storeu_ps(output + i, low);
+            _mm_storeu_ps(output + i + 4, high);
+        }
+#else
+        for(int i = 0; i < n; ++i) output[i] = half_to_float(input[i]);
+#endif
+    }
+
+    static int32_t dot_int8(const int16_t* a, const int8_t* b, int n){
+#ifdef FACE_INDEX_SSE2
+        __m128i s0 = _mm_setzero_si128(), s1 = _mm_setzero_si128();
+        for(int i = 0; i < n; i += 16){
+            __m128i v  = _mm_loadu_si128((const __m128i*)(b + i));
+
+            // SSE2没有cvtepi8，把字节放到高8位再算术右移完成符号扩展
+            __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+            __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+            s0 = _mm_add_epi32(s0, _mm_madd_epi16(lo, _mm_loadu_si128((const __m128i*)(a + i))));
+            s1 = _mm_add_epi32(s1, _mm_madd_epi16(hi, _mm_loadu_si128((const __m128i*)(a + i + 8))));
+        }
+        __m128i s = _mm_add_epi32(s0, s1);
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(s);
+#else
+        int32_t s = 0;
+        for(int i = 0; i < n; ++i) s += (int32_t)a[i] * b[i];
+        return s;
+#endif
+    }
+
+    // 保留得分最高的k个，堆顶是其中最小的
+    class TopK{
+    public:
+        TopK(int k = 0):k_(k){}
+
+        void push(int64_t id, float score){
+            if((int)heap_.size() < k_){
+                heap_.emplace_back(id, score);
+                push_heap(heap_.begin(), heap_.end(), compare);
+            }else if(k_ > 0 && score > heap_.front().score){
+                pop_heap(heap_.begin(), heap_.end(), compare);
+                heap_.back() = Match(id, score);
+                push_heap(heap_.begin(), heap_.end(), compare);
+            }
+        }
+
+        void merge(const TopK& other){
+            for(auto& item : other.heap_)
+                push(item.id, item.score);
+        }
+
+        vector<Match> sorted() const{
+            vector<Match> output = heap_;
+            std::sort(output.begin(), output.end(), [](const Match& a, const Match& b){
+                return a.score > b.score || (a.score == b.score && a.id < b.id);
+            });
+            return output;
+        }
+
+    private:
+        static bool compare(const Match& a, const Match& b){return a.score > b.score;}
+
+        int k_ = 0;
+        vector<Match> heap_;
+    };
+
+    // 扫描任务，某个簇（或者外部特征）中的一段连续行
+    struct Task{
+        int list;
+        size_t begin, end;
+    };
+
+    // 任务分给多个线程，每个线程独立的topk，最后合并，避免加锁
+    static vector<vector<Match>> run_tasks(
+        const vector<Task>& tasks, size_t total_work, int max_threads, int num, int topk,
+        const function<void(const Task& task, vector<TopK>& topks)>& func
+    ){
+        int num_threads = (int)std::min<size_t>(
+            std::min<size_t>(max_threads, tasks.size()),
+            std::max<size_t>(1, total_work / MIN_WORK_PER_THREAD)
+        );
+        num_threads = std::max(1, num_threads);
+
+        vector<vector<TopK>> partial(num_threads, vector<TopK>(num, TopK(topk)));
+        atomic<size_t> next_task(0);
+        auto worker = [&](int ithread){
+            size_t itask;
+            while((itask = next_task.fetch_add(1)) < tasks.size())
+                func(tasks[itask], partial[ithread]);
+        };
+
+        if(num_threads == 1){
+            worker(0);
+        }else{
+            vector<thread> threads;
+            for(int i = 0; i < num_threads; ++i)
+                threads.emplace_back(worker, i);
+
+            for(auto& t : threads)
+                t.join();
+        }
+
+        vector<vector<Match>> output(num);
+        for(int i = 0; i < num; ++i){
+            for(int ithread = 1; ithread < num_threads; ++ithread)
+                partial[0][i].merge(partial[ithread][i]);
+            output[i] = partial[0][i].sorted();
+        }
+        return output;
+    }
+
+    // 补零到stride，按需归一化
+    static void prepare_feature(const float* feature, int dim, int stride, bool normalize, vector<float>& output){
+
+        output.assign(stride, 0);
+        memcpy(output.data(), feature, sizeof(float) * dim);
+        if(!normalize) return;
+
+        double norm = 0;
+        for(int i = 0; i < dim; ++i)
+            norm += (double)output[i] * output[i];
+
+        if(norm > 0){
+            float scale = (float)(1.0 / std::sqrt(norm));
+            for(int i = 0; i < dim; ++i)
+                output[i] *= scale;
+        }
+    }
+
+    struct InvertedList{
+        vector<uint8_t> codes;      // size() x code_size，连续存放
+        vector<float> scales;       // Int8时每行的反量化系数
+        vector<int64_t> ids;
+    };
+
+    // 预处理后的query，补零并归一化，Int8时额外量化为int16
+    struct Query{
+        vector<float> feature;
+        vector<int16_t> quantized;
+        float scale = 0;
+    };
+
+    class IndexImpl : public Index{
+    public:
+        bool startup(const Config& config){
+
+            if(config.dim <= 0){
+                INFOE("Invalid dim %d", config.dim);
+                return false;
+            }
+
+            if(config.type == Type::IVF && config.nlist <= 0){
+                INFOE("Invalid nlist %d", config.nlist);
+                return false;
+            }
+
+            config_      = config;
+            config_.nprobe = std::max(1, config_.nprobe);
+            num_threads_ = resolve_threads(config.num_threads);
+            stride_      = aligned_dim(config.dim);
+
+            switch(config.storage){
+                case Storage::Float32: code_size_ = stride_ * sizeof(float);    break;
+                case Storage::Float16: code_size_ = stride_ * sizeof(uint16_t); break;
+                case Storage::Int8:    code_size_ = stride_ * sizeof(int8_t);   break;
+                default:
+                    INFOE("Unsupported storage %d", (int)config.storage);
+                    return false;
+            }
+
+            if(config.type == Type::Flat){
+                lists_.resize(1);
+                trained_ = true;
+            }else{
+                lists_.resize(config.nlist);
+                trained_ = false;
+            }
+            return true;
+        }
+
+        virtual bool train(const float* samples, int num_samples) override{
+
+            if(config_.type == Type::Flat) return true;
+
+            unique_lock<mutex> l(lock_);
+            if(num_samples < config_.nlist){
+                INFOE("IVF train requires at least %d samples, got %d", config_.nlist, num_samples);
+                return false;
+            }
+
+            // 重新训练时，已有的特征按新的聚类中心重新分配
+            vector<int64_t> old_ids;
+            vector<float> old_features;
+            for(auto& list : lists_){
+                for(size_t row = 0; row < list.ids.size(); ++row){
+                    old_ids.emplace_back(list.ids[row]);
+                    old_features.resize(old_features.size() + stride_);
+                    decode(list, row, old_features.data() + old_features.size() - stride_);
+                }
+            }
+
+            kmeans(samples, num_samples);
+            lists_.assign(config_.nlist, InvertedList());
+            location_.clear();
+            trained_ = true;
+
+            for(size_t i = 0; i < old_ids.size(); ++i)
+                add_locked(old_ids[i], old_features.data() + i * stride_);
+            return true;
+        }
+
+        virtual bool is_trained() const override{
+            return trained_;
+        }
+
+        virtual bool add(int64_t id, const float* feature) override{
+
+            unique_lock<mutex> l(lock_);
+            if(!trained_){
+                INFOE("IVF index is not trained, call train first");
+                return false;
+            }
+
+            vector<float> padded;
+            prepare(feature, padded);
+            add_locked(id, padded.data());
+            return true;
+        }
+
+        virtual bool remove(int64_t id) override{
+            unique_lock<mutex> l(lock_);
+            return remove_locked(id);
+        }
+
+        virtual bool contains(int64_t id) const override{
+            unique_lock<mutex> l(lock_);
+            return location_.find(id) != location_.end();
+        }
+
+        virtual bool get(int64_t id, float* feature) const override{
+
+            unique_lock<mutex> l(lock_);
+            auto iter = location_.find(id);
+            if(iter == location_.end()) return false;
+
+            vector<float> padded(stride_);
+            decode(lists_[iter->second.first], iter->second.second, padded.data());
+            memcpy(feature, padded.data(), sizeof(float) * config_.dim);
+            return true;
+        }
+
+        virtual vector<int64_t> ids() const override{
+            unique_lock<mutex> l(lock_);
+            vector<int64_t> output;
+            output.reserve(location_.size());
+            for(auto& list : lists_)
+                output.insert(output.end(), list.ids.begin(), list.ids.end());
+            return output;
+        }
+
+        virtual size_t size() const override{
+            unique_lock<mutex> l(lock_);
+            return location_.size();
+        }
+
+        virtual size_t memory_bytes() const override{
+            unique_lock<mutex> l(lock_);
+            size_t bytes = centroids_.capacity() * sizeof(float);
+            for(auto& list : lists_)
+                bytes += list.codes.capacity() + list.scales.capacity() * sizeof(float) + list.ids.capacity() * sizeof(int64_t);
+
+            // unordered_map每个节点的近似开销
+            bytes += location_.size() * (sizeof(int64_t) + sizeof(pair<int, int>) + 2 * sizeof(void*));
+            return bytes;
+        }
+
+        virtual vector<vector<Match>> search(const float* features, int num, int topk) override{
+
+            vector<vector<Match>> output(std::max(0, num));
+            if(num <= 0 || topk <= 0) return output;
+
+            unique_lock<mutex> l(lock_);
+            if(!trained_){
+                INFOE("IVF index is not trained, call train first");
+                return output;
+            }
+
+            vector<Query> queries(num);
+            for(int i = 0; i < num; ++i)
+                prepare_query(features + (size_t)i * config_.dim, queries[i]);
+
+            // 每个簇需要扫描的query，同一个簇中的特征被这些query共享
+            vector<vector<int>> probes(lists_.size());
+            if(config_.type == Type::Flat){
+                probes[0].resize(num);
+                for(int i = 0; i < num; ++i) probes[0][i] = i;
+            }else{
+                vector<int> nearest;
+                for(int i = 0; i < num; ++i){
+                    nearest_lists(queries[i].feature.data(), std::min(config_.nprobe, config_.nlist), nearest);
+                    for(int ilist : nearest)
+                        probes[ilist].emplace_back(i);
+                }
+            }
+
+            vector<Task> tasks;
+            size_t total_work = 0;
+            for(size_t ilist = 0; ilist < lists_.size(); ++ilist){
+                size_t rows = lists_[ilist].ids.size();
+                if(rows == 0 || probes[ilist].empty()) continue;
+
+                total_work += rows * probes[ilist].size();
+                for(size_t begin = 0; begin < rows; begin += TASK_ROWS)
+                    tasks.push_back({(int)ilist, begin, std::min(rows, begin + TASK_ROWS)});
+            }
+
+            return run_tasks(tasks, total_work, num_threads_, num, topk, [&](const Task& task, vector<TopK>& topks){
+                scan(lists_[task.list], task.begin, task.end, probes[task.list], queries, topks);
+            });
+        }
+
+        virtual void set_nprobe(int nprobe) override{
+            unique_lock<mutex> l(lock_);
+            config_.nprobe = std::max(1, nprobe);
+        }
+
+        virtual const Config& config() const override{
+            return config_;
+        }
+
+    private:
+        void prepare(const float* feature, vector<float>& output) const{
+            prepare_feature(feature, config_.dim, stride_, config_.normalize, output);
+        }
+
+        void prepare_query(const float* feature, Query& query) const{
+
+            prepare(feature, query.feature);
+            if(config_.storage != Storage::Int8) return;
+
+            float max_value = 0;
+            for(float v : query.feature)
+                max_value = std::max(max_value, std::fabs(v));
+
+            query.scale = max_value > 0 ? max_value / INT16_QUERY_MAX : 1.0f;
+            query.quantized.resize(stride_);
+            for(int i = 0; i < stride_; ++i)
+                query.quantized[i] = (int16_t)std::lrint(query.feature[i] / query.scale);
+        }
+
+        void encode(const float* feature, uint8_t* code, float& scale) const{
+
+            scale = 1;
+            if(config_.storage == Storage::Float32){
+                memcpy(code, feature, sizeof(float) * stride_);
+            }else if(config_.storage == Storage::Float16){
+                uint16_t* pcode = (uint16_t*)code;
+                for(int i = 0; i < stride_; ++i)
+                    pcode[i] = float_to_half(feature[i]);
+            }else{
+                // 对称量化，每行一个系数
+                float max_value = 0;
+                for(int i = 0; i < stride_; ++i)
+                    max_value = std::max(max_value, std::fabs(feature[i]));
+
+                scale = max_value > 0 ? max_value / 127.0f : 1.0f;
+                int8_t* pcode = (int8_t*)code;
+                for(int i = 0; i < stride_; ++i)
+                    pcode[i] = (int8_t)std::max(-127L, std::min(127L, std::lrint(feature[i] / scale)));
+            }
+        }
+
+        void decode(const InvertedList& list, size_t row, float* feature) const{
+
+            const uint8_t* code = list.codes.data() + row * code_size_;
+            if(config_.storage == Storage::Float32){
+                memcpy(feature, code, sizeof(float) * stride_);
+            }else if(config_.storage == Storage::Float16){
+                decode_half((const uint16_t*)code, feature, stride_);
+            }else{
+                const int8_t* pcode = (const int8_t*)code;
+                float scale = list.scales[row];
+                for(int i = 0; i < stride_; ++i)
+                    feature[i] = pcode[i] * scale;
+            }
+        }
+
+        float score(const InvertedList& list, size_t row, const Query& query) const{
+
+            const uint8_t* code = list.codes.data() + row * code_size_;
+            switch(config_.storage){
+                case Storage::Float32: return dot_float32(query.feature.data(), (const float*)code, stride_);
+                case Storage::Float16: return dot_float16(query.feature.data(), (const uint16_t*)code, stride_);
+                default:
+                    return dot_int8(query.quantized.data(), (const int8_t*)code, stride_) * query.scale * list.scales[row];
+            }
+        }
+
+        void scan(const InvertedList& list, size_t begin, size_t end, const vector<int>& query_indexs, const vector<Query>& queries, vector<TopK>& topks) const{
+
+            // 多个query时Float16先把整块转为float，转换只做一次
+            vector<float> block_features;
+            bool decode_block = config_.storage == Storage::Float16 && query_indexs.size() > 1;
+            if(decode_block)
+                block_features.resize(BLOCK_ROWS * stride_);
+
+            for(size_t block = begin; block < end; block += BLOCK_ROWS){
+                size_t block_end = std::min(end, block + BLOCK_ROWS);
+                if(decode_block){
+                    for(size_t row = block; row < block_end; ++row)
+                        decode_half((const uint16_t*)(list.codes.data() + row * code_size_), block_features.data() + (row - block) * stride_, stride_);
+
+                    for(int iquery : query_indexs){
+                        auto& query = queries[iquery];
+                        auto& topk  = topks[iquery];
+                        for(size_t row = block; row < block_end; ++row)
+                            topk.push(list.ids[row], dot_float32(query.feature.data(), block_features.data() + (row - block) * stride_, stride_));
+                    }
+                    continue;
+                }
+
+                for(int iquery : query_indexs){
+                    auto& query = queries[iquery];
+                    auto& topk  = topks[iquery];
+                    for(size_t row = block; row < block_end; ++row)
+                        topk.push(list.ids[row], score(list, row, query));
+                }
+            }
+        }
+
+        void add_locked(int64_t id, const float* padded){
+
+            remove_locked(id);
+
+            int ilist = 0;
+            if(config_.type == Type::IVF){
+                vector<int> nearest;
+                nearest_lists(padded, 1, nearest);
+                ilist = nearest[0];
+            }
+
+            auto& list = lists_[ilist];
+            float scale = 1;
+            list.codes.resize(list.codes.size() + code_size_);
+            encode(padded, list.codes.data() + list.codes.size() - code_size_, scale);
+            if(config_.storage == Storage::Int8)
+                list.scales.emplace_back(scale);
+
+            location_[id] = make_pair(ilist, (int)list.ids.size());
+            list.ids.emplace_back(id);
+        }
+
+        // 与最后一行交换后删除，保持特征连续
+        bool remove_locked(int64_t id){
+
+            auto iter = location_.find(id);
+            if(iter == location_.end()) return false;
+
+            auto& list = lists_[iter->second.first];
+            size_t row  = iter->second.second;
+            size_t last = list.ids.size() - 1;
+            if(row != last){
+                memcpy(list.codes.data() + row * code_size_, list.codes.data() + last * code_size_, code_size_);
+                if(!list.scales.empty())
+                    list.scales[row] = list.scales[last];
+
+                list.ids[row] = list.ids[last];
+                location_[list.ids[row]].second = (int)row;
+            }
+
+            list.codes.resize(last * code_size_);
+            if(!list.scales.empty())
+                list.scales.resize(last);
+
+            list.ids.resize(last);
+            location_.erase(iter);
+            return true;
+        }
+
+        void nearest_lists(const float* feature, int n, vector<int>& output) const{
+
+            int nlist = (int)(centroids_.size() / stride_);
+            vector<pair<float, int>> scores(nlist);
+            for(int i = 0; i < nlist; ++i)
+                scores[i] = make_pair(dot_float32(feature, centroids_.data() + (size_t)i * stride_, stride_), i);
+
+            n = std::min(n, nlist);
+            partial_sort(scores.begin(), scores.begin() + n, scores.end(), [](const pair<float, int>& a, const pair<float, int>& b){
+                return a.first > b.first;
+            });
+
+            output.resize(n);
+            for(int i = 0; i < n; ++i)
+                output[i] = scores[i].second;
+        }
+
+        // 球面k-means，聚类中心归一化后用内积分配
+        void kmeans(const float* samples, int num_samples){
+
+            int nlist = config_.nlist;
+            mt19937 rng(1234);
+
+            vector<int> indexs(num_samples);
+            for(int i = 0; i < num_samples; ++i) indexs[i] = i;
+            shuffle(indexs.begin(), indexs.end(), rng);
+            indexs.resize(std::min(num_samples, nlist * KMEANS_MAX_SAMPLES_PER_LIST));
+
+            int n = (int)indexs.size();
+            vector<float> points((size_t)n * stride_);
+            vector<float> padded;
+            for(int i = 0; i < n; ++i){
+                prepare(samples + (size_t)indexs[i] * config_.dim, padded);
+                memcpy(points.data() + (size_t)i * stride_, padded.data(), sizeof(float) * stride_);
+            }
+
+            centroids_.assign(points.begin(), points.begin() + (size_t)nlist * stride_);
+
+            vector<int> assign(n);
+            int num_threads = std::max(1, std::min(num_threads_, n / 1024));
+            for(int iter = 0; iter < KMEANS_ITERATIONS; ++iter){
+
+                auto assign_range = [&](int begin, int end){
+                    vector<int> nearest;
+                    for(int i = begin; i < end; ++i){
+                        nearest_lists(points.data() + (size_t)i * stride_, 1, nearest);
+                        assign[i] = nearest[0];
+                    }
+                };
+
+                if(num_threads == 1){
+                    assign_range(0, n);
+                }else{
+                    vector<thread> threads;
+                    int per_thread = (n + num_threads - 1) / num_threads;
+                    for(int i = 0; i < num_threads; ++i)
+                        threads.emplace_back(assign_range, std::min(n, i * per_thread), std::min(n, (i + 1) * per_thread));
+
+                    for(auto& t : threads)
+                        t.join();
+                }
+
+                vector<double> sums((size_t)nlist * stride_, 0);
+                vector<int> counts(nlist, 0);
+                for(int i = 0; i < n; ++i){
+                    double* psum = sums.data() + (size_t)assign[i] * stride_;
+                    const float* ppoint = points.data() + (size_t)i * stride_;
+                    for(int j = 0; j < stride_; ++j)
+                        psum[j] += ppoint[j];
+                    counts[assign[i]]++;
+                }
+
+                for(int ilist = 0; ilist < nlist; ++ilist){
+                    float* pcentroid = centroids_.data() + (size_t)ilist * stride_;
+                    if(counts[ilist] == 0){
+                        // 空簇重新随机选一个样本
+                        int sample = uniform_int_distribution<int>(0, n - 1)(rng);
+                        memcpy(pcentroid, points.data() + (size_t)sample * stride_, sizeof(float) * stride_);
+                        continue;
+                    }
+
+                    const double* psum = sums.data() + (size_t)ilist * stride_;
+                    double norm = 0;
+                    for(int j = 0; j < stride_; ++j)
+                        norm += psum[j] * psum[j];
+
+                    double scale = norm > 0 ? 1.0 / std::sqrt(norm) : 0;
+                    for(int j = 0; j < stride_; ++j)
+                        pcentroid[j] = (float)(psum[j] * scale);
+                }
+            }
+        }
+
+    private:
+        Config config_;
+        int num_threads_  = 1;
+        int stride_       = 0;
+        size_t code_size_ = 0;
+        bool trained_     = false;
+        vector<float> centroids_;       // nlist x stride_
+        vector<InvertedList> lists_;    // Flat时只有一个
+        unordered_map<int64_t, pair<int, int>> location_;  // id -> (list, row)
+        mutable mutex lock_;
+    };
+
+    int aligned_dim(int dim){
+        return (dim + DIM_ALIGN - 1) / DIM_ALIGN * DIM_ALIGN;
+    }
+
+    vector<vector<Match>> search_rows(const RowView& rows, const Config& config, const float* features, int num, int topk){
+
+        if(num <= 0 || topk <= 0) return vector<vector<Match>>(std::max(0, num));
+        if(rows.stride < config.dim || rows.stride % DIM_ALIGN != 0){
+            INFOE("Invalid stride %d for dim %d", rows.stride, config.dim);
+            return vector<vector<Match>>(num);
+        }
+
+        vector<vector<float>> queries(num);
+        for(int i = 0; i < num; ++i)
+            prepare_feature(features + (size_t)i * config.dim, config.dim, rows.stride, config.normalize, queries[i]);
+
+        vector<Task> tasks;
+        for(size_t begin = 0; begin < rows.num_rows; begin += TASK_ROWS)
+            tasks.push_back({0, begin, std::min(rows.num_rows, begin + TASK_ROWS)});
+
+        return run_tasks(tasks, rows.num_rows * num, resolve_threads(config.num_threads), num, topk, [&](const Task& task, vector<TopK>& topks){
+            for(size_t block = task.begin; block < task.end; block += BLOCK_ROWS){
+                size_t block_end = std::min(task.end, block + BLOCK_ROWS);
+                for(int iquery = 0; iquery < num; ++iquery){
+                    auto& topk = topks[iquery];
+                    for(size_t row = block; row < block_end; ++row){
+                        if(rows.valid != nullptr && !rows.valid[row]) continue;
+                        topk.push(rows.ids[row], dot_float32(queries[iquery].data(), rows.features + row * rows.stride, rows.stride));
+                    }
+                }
+            }
+        });
+    }
+
+    shared_ptr<Index> create_index(const Config& config){
+        shared_ptr<IndexImpl> instance(new IndexImpl());
+        if(!instance->startup(config)){
+            instance.reset();
+        }
+        return instance;
+    }
+};
@@ -0,0 +1,123 @@
+
+
+#ifndef FACE_INDEX_HPP
+#define FACE_INDEX_HPP
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+
+/* Arcface特征的检索，替代每个应用自己写的 library * feature.t()
+   特征连续存放，批量计算内积（特征已经L2归一化，内积即余弦相似度）并取topk，使用SSE2
+   Flat：精确搜索。IVF：先用k-means把特征分到nlist个簇，搜索时只访问最近的nprobe个簇，用于百万级的底库
+   存储支持Float32、Float16（内存减半）、Int8（每个特征一个缩放系数，内存为1/4） */
+namespace FaceIndex{
+
+    enum class Storage : int{
+        Float32 = 0,
+        Float16 = 1,
+        Int8    = 2
+    };
+
+    enum class Type : int{
+        Flat = 0,
+        IVF  = 1
+    };
+
+    struct Config{
+        int dim         = 512;
+        Storage storage = Storage::Float32;
+        Type type       = Type::Flat;
+        int nlist       = 1024;     // IVF的簇个数，通常取sqrt(底库大小)的1~4倍
+        int nprobe      = 16;       // 搜索时访问的簇个数，越大召回越高、越慢
+        int num_threads = 0;        // <= 0时使用CPU核数
+        bool normalize  = true;     // 添加和搜索时对特征做L2归一化
+    };
+
+    struct Match{
+        int64_t id  = -1;
+        float score = 0;            // 余弦相似度
+
+        Match() = default;
+        Match(int64_t id, float score):id(id), score(score){}
+    };
+
+    // add/remove与search之间互斥，可以在多个线程中调用
+    class Index{
+    public:
+        // IVF需要先训练得到聚类中心，samples为n x dim，n不少于nlist。Flat直接返回true
+        virtual bool train(const float* samples, int num_samples) = 0;
+        virtual bool is_trained() const = 0;
+
+        // id已经存在时覆盖原来的特征
+        virtual bool add(int64_t id, const float* feature) = 0;
+        virtual bool remove(int64_t id) = 0;
+        virtual bool contains(int64_t id) const = 0;
+
+        // 取回（反量化后的）特征
+        virtual bool get(int64_t id, float* feature) const = 0;
+        virtual std::vector<int64_t> ids() const = 0;
+        virtual size_t size() const = 0;
+        virtual size_t memory_bytes() const = 0;
+
+        // features为num x dim，返回每个特征的topk，按相似度从大到小
+        virtual std::vector<std::vector<Match>> search(const float* features, int num, int topk) = 0;
+
+        virtual void set_nprobe(int nprobe) = 0;
+        virtual const Config& config() const = 0;
+
+        // cv::Mat的版本，feature为CV_32F，每行一个特征（Arcface::feature是1 x dim）
+        bool train(const cv::Mat& samples){
+            return check(samples) && train(samples.ptr<float>(0), samples.rows);
+        }
+
+        bool add(int64_t id, const cv::Mat& feature){
+            return check(feature) && feature.rows == 1 && add(id, feature.ptr<float>(0));
+        }
+
+        // 返回成功添加的个数
+        int add(const std::vector<int64_t>& ids, const cv::Mat& features){
+            if(!check(features) || features.rows != (int)ids.size()) return 0;
+
+            int num_added = 0;
+            for(int i = 0; i < features.rows; ++i)
+                num_added += add(ids[i], features.ptr<float>(i));
+            return num_added;
+        }
+
+        std::vector<Match> search(const cv::Mat& feature, int topk){
+            if(!check(feature) || feature.rows != 1) return std::vector<Match>();
+            return search(feature.ptr<float>(0), 1, topk)[0];
+        }
+
+        std::vector<std::vector<Match>> search_batch(const cv::Mat& features, int topk){
+            if(!check(features)) return std::vector<std::vector<Match>>();
+            return search(features.ptr<float>(0), features.rows, topk);
+        }
+
+    private:
+        bool check(const cv::Mat& m) const{
+            return !m.empty() && m.type() == CV_32F && m.isContinuous() && m.cols == config().dim;
+        }
+    };
+
+    std::shared_ptr<Index> create_index(const Config& config = Config());
+
+    // 外部内存中连续存放的float特征，例如mmap的底库文件
+    struct RowView{
+        const float* features = nullptr;    // num_rows x stride，每行已经归一化
+        const int64_t* ids    = nullptr;
+        const uint8_t* valid  = nullptr;    // 可选，每行一个字节，0表示已删除
+        size_t num_rows       = 0;
+        int stride            = 0;          // aligned_dim(dim)
+    };
+
+    // 每行补零后的长度，SIMD不需要处理尾部
+    int aligned_dim(int dim);
+
+    // 对RowView做精确搜索，使用config中的dim、normalize和num_threads
+    std::vector<std::vector<Match>> search_rows(const RowView& rows, const Config& config, const float* features, int num, int topk);
+};
+
+#endif // FACE_INDEX_HPP
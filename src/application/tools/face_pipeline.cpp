@@ -0,0 +1,297 @@
+
+#include "face_pipeline.hpp"
+#include <common/ilogger.hpp>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <condition_variable>
+#include <string.h>
+
+namespace FacePipeline{
+
+    using namespace std;
+
+    struct Job{
+        cv::Mat image;
+        shared_future<FaceDetector::BoxArray> detection;
+        shared_ptr<promise<Result>> pro;
+        double commit_time = 0;
+        double embed_time  = 0;
+
+        Result result;
+        vector<shared_future<Arcface::feature>> features;
+    };
+
+    typedef shared_ptr<Job> JobPtr;
+
+    // 简单的阻塞队列，stop后get返回false
+    class JobQueue{
+    public:
+        void push(const JobPtr& job){
+            {
+                unique_lock<mutex> l(lock_);
+                jobs_.push(job);
+            }
+            cond_.notify_one();
+        }
+
+        bool get(JobPtr& job){
+            unique_lock<mutex> l(lock_);
+            cond_.wait(l, [&](){return !run_ || !jobs_.empty();});
+            if(jobs_.empty()) return false;
+
+            job = jobs_.front();
+            jobs_.pop();
+            return true;
+        }
+
+        // 队列中剩余的任务处理完以后get才返回false
+        void stop(){
+            {
+                unique_lock<mutex> l(lock_);
+                run_ = false;
+            }
+            cond_.notify_all();
+        }
+
+    private:
+        mutex lock_;
+        condition_variable cond_;
+        queue<JobPtr> jobs_;
+        bool run_ = true;
+    };
+
+    class PipelineImpl : public Pipeline{
+    public:
+        virtual ~PipelineImpl(){
+            align_queue_.stop();
+            if(align_thread_.joinable())
+                align_thread_.join();
+
+            collect_queue_.stop();
+            if(collect_thread_.joinable())
+                collect_thread_.join();
+        }
+
+        bool startup(const DetectFunction& detect, const EmbedFunction& embed, const Config& config, const AlignFunction& align){
+
+            if(detect == nullptr || embed == nullptr){
+                INFOE("Detect and embed function must be set");
+                return false;
+            }
+
+            detect_ = detect;
+            embed_  = embed;
+            config_ = config;
+            config_.max_inflight = std::max(1, config.max_inflight);
+
+            if(align){
+                align_ = align;
+            }else{
+                align_ = [](const cv::Mat& image, const vector<Arcface::landmarks>& faces){
+                    return Arcface::face_alignment(image, faces);
+                };
+            }
+
+            align_thread_   = thread(&PipelineImpl::align_worker, this);
+            collect_thread_ = thread(&PipelineImpl::collect_worker, this);
+            return true;
+        }
+
+        virtual shared_future<Result> commit(const cv::Mat& image) override{
+
+            {
+                unique_lock<mutex> l(inflight_lock_);
+                inflight_cond_.wait(l, [&](){return num_inflight_ < config_.max_inflight;});
+                num_inflight_++;
+            }
+
+            JobPtr job = make_shared<Job>();
+            job->pro         = make_shared<promise<Result>>();
+            job->image       = config_.clone_image ? image.clone() : image;
+            job->commit_time = iLogger::timestamp_now_float();
+            {
+                unique_lock<mutex> l(statistics_lock_);
+                if(first_commit_time_ == 0)
+                    first_commit_time_ = job->commit_time;
+            }
+
+            // 检测立即提交，与前面帧的对齐和特征提取同时进行
+            job->detection = detect_(job->image);
+            align_queue_.push(job);
+            return job->pro->get_future().share();
+        }
+
+        virtual vector<shared_future<Result>> commits(const vector<cv::Mat>& images) override{
+            vector<shared_future<Result>> output;
+            output.reserve(images.size());
+            for(auto& image : images)
+                output.emplace_back(commit(image));
+            return output;
+        }
+
+        virtual Statistics statistics() const override{
+
+            unique_lock<mutex> l(statistics_lock_);
+            Statistics output;
+            output.num_frames = num_frames_;
+            output.num_faces  = num_faces_;
+            if(num_frames_ > 0){
+                output.average.detect = sum_.detect / num_frames_;
+                output.average.align  = sum_.align  / num_frames_;
+                output.average.embed  = sum_.embed  / num_frames_;
+                output.average.total  = sum_.total  / num_frames_;
+                if(last_finish_time_ > first_commit_time_)
+                    output.fps = num_frames_ / ((last_finish_time_ - first_commit_time_) / 1000.0);
+            }
+            return output;
+        }
+
+        virtual void reset_statistics() override{
+            unique_lock<mutex> l(statistics_lock_);
+            num_frames_ = num_faces_ = 0;
+            sum_ = Timing();
+            first_commit_time_ = last_finish_time_ = 0;
+        }
+
+    private:
+        // 按置信度保留max_faces个，丢弃过小的人脸
+        FaceDetector::BoxArray select_faces(const FaceDetector::BoxArray& boxes) const{
+
+            FaceDetector::BoxArray output;
+            output.reserve(boxes.size());
+            for(auto& box : boxes){
+                if(box.width() < config_.min_face_size || box.height() < config_.min_face_size) continue;
+                output.emplace_back(box);
+            }
+
+            if(config_.max_faces > 0 && (int)output.size() > config_.max_faces){
+                std::stable_sort(output.begin(), output.end(), [](const FaceDetector::Box& a, const FaceDetector::Box& b){
+                    return a.confidence > b.confidence;
+                });
+                output.resize(config_.max_faces);
+            }
+            return output;
+        }
+
+        void align_worker(){
+
+            JobPtr job;
+            while(align_queue_.get(job)){
+
+                auto boxes = select_faces(job->detection.get());
+                double tic = iLogger::timestamp_now_float();
+                job->result.timing.detect = tic - job->commit_time;
+
+                vector<Arcface::landmarks> landmarks(boxes.size());
+                for(size_t i = 0; i < boxes.size(); ++i)
+                    memcpy(landmarks[i].points, boxes[i].landmark, sizeof(landmarks[i].points));
+
+                vector<cv::Mat> aligned;
+                if(!boxes.empty())
+                    aligned = align_(job->image, landmarks);
+
+                double toc = iLogger::timestamp_now_float();
+                job->result.timing.align = toc - tic;
+
+                if(aligned.size() != boxes.size()){
+                    INFOE("Align function returned %d faces, expect %d", (int)aligned.size(), (int)boxes.size());
+                    boxes.resize(std::min(aligned.size(), boxes.size()));
+                }
+
+                job->result.faces.resize(boxes.size());
+                vector<Arcface::commit_input> inputs(boxes.size());
+                auto standard = Arcface::aligned_landmarks();
+                for(size_t i = 0; i < boxes.size(); ++i){
+                    job->result.faces[i].box = boxes[i];
+                    inputs[i] = make_tuple(aligned[i], standard);
+                }
+
+                // 对齐完成后原图不再需要
+                job->image.release();
+                job->embed_time = toc;
+                if(!inputs.empty())
+                    job->features = embed_(inputs);
+
+                collect_queue_.push(job);
+            }
+        }
+
+        void collect_worker(){
+
+            JobPtr job;
+            while(collect_queue_.get(job)){
+
+                auto& result = job->result;
+                if(job->features.size() != result.faces.size()){
+                    INFOE("Embed function returned %d features, expect %d", (int)job->features.size(), (int)result.faces.size());
+                    result.faces.resize(std::min(job->features.size(), result.faces.size()));
+                }
+
+                for(size_t i = 0; i < result.faces.size(); ++i)
+                    result.faces[i].feature = job->features[i].get();
+
+                double now = iLogger::timestamp_now_float();
+                result.timing.embed = result.faces.empty() ? 0 : now - job->embed_time;
+                result.timing.total = now - job->commit_time;
+                {
+                    unique_lock<mutex> l(statistics_lock_);
+                    num_frames_++;
+                    num_faces_        += result.faces.size();
+                    sum_.detect       += result.timing.detect;
+                    sum_.align        += result.timing.align;
+                    sum_.embed        += result.timing.embed;
+                    sum_.total        += result.timing.total;
+                    last_finish_time_  = now;
+                }
+
+                job->pro->set_value(result);
+                {
+                    unique_lock<mutex> l(inflight_lock_);
+                    num_inflight_--;
+                }
+                inflight_cond_.notify_one();
+            }
+        }
+
+    private:
+        Config config_;
+        DetectFunction detect_;
+        EmbedFunction embed_;
+        AlignFunction align_;
+
+        JobQueue align_queue_, collect_queue_;
+        thread align_thread_, collect_thread_;
+
+        mutex inflight_lock_;
+        condition_variable inflight_cond_;
+        int num_inflight_ = 0;
+
+        mutable mutex statistics_lock_;
+        size_t num_frames_ = 0, num_faces_ = 0;
+        Timing sum_;
+        double first_commit_time_ = 0, last_finish_time_ = 0;
+    };
+
+    shared_ptr<Pipeline> create_pipeline(const DetectFunction& detect, const EmbedFunction& embed, const Config& config, const AlignFunction& align){
+        shared_ptr<PipelineImpl> instance(new PipelineImpl());
+        if(!instance->startup(detect, embed, config, align)){
+            instance.reset();
+        }
+        return instance;
+    }
+
+    DetectFunction detect_with(const shared_ptr<Scrfd::Infer>& infer){
+        return [infer](const cv::Mat& image){return infer->commit(image);};
+    }
+
+    DetectFunction detect_with(const shared_ptr<RetinaFace::Infer>& infer){
+        return [infer](const cv::Mat& image){return infer->commit(image);};
+    }
+
+    EmbedFunction embed_with(const shared_ptr<Arcface::Infer>& infer){
+        return [infer](const vector<Arcface::commit_input>& faces){return infer->commits(faces);};
+    }
+};
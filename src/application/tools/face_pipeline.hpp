@@ -0,0 +1,80 @@
+
+
+#ifndef FACE_PIPELINE_HPP
+#define FACE_PIPELINE_HPP
+
+#include <memory>
+#include <vector>
+#include <future>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include <common/face_detector.hpp>
+#include <app_arcface/arcface.hpp>
+#include <app_scrfd/scrfd.hpp>
+#include <app_retinaface/retinaface.hpp>
+
+/* 人脸识别流水线：检测 -> 对齐 -> 特征提取，一次commit得到每个人脸的框、关键点和特征
+   commit时立即提交检测，对齐线程等待检测结果后一次对齐该帧的所有人脸并批量提交特征提取，收集线程等待特征
+   因此第N+1帧的检测、对齐与第N帧的特征提取同时进行，结果按提交顺序返回
+   检测、对齐、特征提取都是函数，可以替换为CPU上的模拟实现用于测试 */
+namespace FacePipeline{
+
+    typedef std::function<std::shared_future<FaceDetector::BoxArray>(const cv::Mat& image)> DetectFunction;
+
+    // faces中的图像是对齐后的112x112人脸，关键点为Arcface::aligned_landmarks()
+    typedef std::function<std::vector<std::shared_future<Arcface::feature>>(const std::vector<Arcface::commit_input>& faces)> EmbedFunction;
+
+    // 默认是Arcface::face_alignment的批量版本
+    typedef std::function<std::vector<cv::Mat>(const cv::Mat& image, const std::vector<Arcface::landmarks>& faces)> AlignFunction;
+
+    struct Face{
+        FaceDetector::Box box;          // 包括landmark
+        Arcface::feature feature;       // 1 x 512，已经归一化
+    };
+
+    // 单位ms
+    struct Timing{
+        double detect = 0;              // 提交检测到拿到结果，包括在检测器中排队的时间
+        double align  = 0;
+        double embed  = 0;              // 提交特征提取到所有特征返回
+        double total  = 0;              // commit到结果可用
+    };
+
+    struct Result{
+        std::vector<Face> faces;
+        Timing timing;
+    };
+
+    struct Statistics{
+        size_t num_frames = 0;
+        size_t num_faces  = 0;
+        Timing average;                 // 每帧的平均值
+        double fps        = 0;          // 第一次commit到最后一帧完成
+    };
+
+    struct Config{
+        int max_faces       = 0;        // 每帧按置信度最多提取特征的人脸数，<= 0不限制
+        float min_face_size = 0;        // 宽或者高小于它的人脸直接丢弃
+        int max_inflight    = 4;        // 已提交未完成的帧数上限，达到时commit阻塞
+        bool clone_image    = true;     // 调用者会复用图像内存时（例如VideoCapture::read）必须为true
+    };
+
+    class Pipeline{
+    public:
+        virtual std::shared_future<Result> commit(const cv::Mat& image) = 0;
+        virtual std::vector<std::shared_future<Result>> commits(const std::vector<cv::Mat>& images) = 0;
+        virtual Statistics statistics() const = 0;
+        virtual void reset_statistics() = 0;
+    };
+
+    std::shared_ptr<Pipeline> create_pipeline(
+        const DetectFunction& detect, const EmbedFunction& embed,
+        const Config& config = Config(), const AlignFunction& align = nullptr
+    );
+
+    DetectFunction detect_with(const std::shared_ptr<Scrfd::Infer>& infer);
+    DetectFunction detect_with(const std::shared_ptr<RetinaFace::Infer>& infer);
+    EmbedFunction embed_with(const std::shared_ptr<Arcface::Infer>& infer);
+};
+
+#endif // FACE_PIPELINE_HPP
@@ -0,0 +1,117 @@
+
+
+#include "microbench.hpp"
+#include <common/ilogger.hpp>
+#include <common/json.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+
+namespace MicroBench{
+
+    using namespace std;
+
+    static double percentile(const vector<double>& sorted_values, double p){
+        if(sorted_values.empty()) return 0;
+        int index = std::min((int)sorted_values.size() - 1, (int)(sorted_values.size() * p));
+        return sorted_values[index];
+    }
+
+    Suite::Suite(const string& name, const Options& options){
+        name_    = name;
+        options_ = options;
+
+        const char* filter = getenv("BENCH_FILTER");
+        if(filter) filter_ = filter;
+
+        const char* repeat = getenv("BENCH_REPEAT");
+        if(repeat) repeat_override_ = atoi(repeat);
+    }
+
+    const Result* Suite::run(const string& name, const function<bool()>& func, double items){
+        return run(name, options_, func, items);
+    }
+
+    const Result* Suite::run(const string& name, const Options& options, const function<bool()>& func, double items){
+
+        if(!filter_.empty() && !iLogger::pattern_match(name.c_str(), filter_.c_str()))
+            return nullptr;
+
+        int repeat = repeat_override_ > 0 ? repeat_override_ : options.repeat;
+        for(int i = 0; i < options.warmup; ++i){
+            if(!func()){
+                INFOE("%s failed", iLogger::align_blank(name, 32).c_str());
+                num_failed_++;
+                return nullptr;
+            }
+        }
+
+        vector<double> times(std::max(1, repeat));
+        for(auto& t : times){
+            auto tic = iLogger::timestamp_now_float();
+            if(!func()){
+                INFOE("%s failed", iLogger::align_blank(name, 32).c_str());
+                num_failed_++;
+                return nullptr;
+            }
+            t = iLogger::timestamp_now_float() - tic;
+        }
+
+        Result result;
+        result.name   = name;
+        result.repeat = times.size();
+        result.items  = items;
+
+        double sum = 0;
+        for(auto t : times) sum += t;
+        result.mean = sum / times.size();
+
+        double var = 0;
+        for(auto t : times) var += (t - result.mean) * (t - result.mean);
+        result.stddev = std::sqrt(var / times.size());
+
+        std::sort(times.begin(), times.end());
+        result.min = times.front();
+        result.p50 = percentile(times, 0.5);
+        result.p90 = percentile(times, 0.9);
+        result.p99 = percentile(times, 0.99);
+        result.max = times.back();
+
+        INFO(
+            "%s p50 %.4f ms, p90 %.4f ms, p99 %.4f ms, mean %.4f ms, %.1f items/s",
+            iLogger::align_blank(name, 32).c_str(), result.p50, result.p90, result.p99, result.mean, result.throughput()
+        );
+        results_.emplace_back(result);
+        return &results_.back();
+    }
+
+    bool Suite::save_json(const string& file) const{
+
+        Json::Value root(Json::objectValue);
+        root["suite"]     = name_;
+        root["timestamp"] = iLogger::time_now();
+
+        auto& jresults = root["results"] = Json::Value(Json::arrayValue);
+        for(auto& result : results_){
+            Json::Value item(Json::objectValue);
+            item["name"]       = result.name;
+            item["repeat"]     = result.repeat;
+            item["items"]      = result.items;
+            item["mean_ms"]    = result.mean;
+            item["stddev_ms"]  = result.stddev;
+            item["min_ms"]     = result.min;
+            item["p50_ms"]     = result.p50;
+            item["p90_ms"]     = result.p90;
+            item["p99_ms"]     = result.p99;
+            item["max_ms"]     = result.max;
+            item["throughput"] = result.throughput();
+            jresults.append(item);
+        }
+
+        if(!iLogger::save_file(file, root.toStyledString())){
+            INFOE("Save %s failed", file.c_str());
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,59 @@
+
+
+#ifndef MICROBENCH_HPP
+#define MICROBENCH_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+/* CPU上可以运行的组件的微基准测试
+   每个case先预热warmup次，再计时repeat次，统计每次的耗时分布，结果保存为json，由tools/compare_bench.py与基线比较
+   环境变量BENCH_FILTER可以只运行名字匹配的case（规则与iLogger::pattern_match相同），BENCH_REPEAT覆盖重复次数 */
+namespace MicroBench{
+
+    struct Options{
+        int warmup = 3;
+        int repeat = 20;
+    };
+
+    // 时间的单位都是ms
+    struct Result{
+        std::string name;
+        int repeat    = 0;
+        double items  = 1;          // 每次调用处理的数量，例如框的个数、图像的张数
+        double mean   = 0;
+        double stddev = 0;
+        double min    = 0;
+        double p50    = 0;
+        double p90    = 0;
+        double p99    = 0;
+        double max    = 0;
+
+        // items / s，以p50计算，不受偶发的调度抖动影响
+        double throughput() const{return p50 > 0 ? items / (p50 / 1000.0) : 0;}
+    };
+
+    class Suite{
+    public:
+        Suite(const std::string& name, const Options& options = Options());
+
+        // func返回false表示case失败，不记录结果。被过滤时返回nullptr
+        const Result* run(const std::string& name, const std::function<bool()>& func, double items = 1);
+        const Result* run(const std::string& name, const Options& options, const std::function<bool()>& func, double items = 1);
+
+        const std::vector<Result>& results() const{return results_;}
+        int num_failed() const{return num_failed_;}
+        bool save_json(const std::string& file) const;
+
+    private:
+        std::string name_;
+        std::string filter_;
+        Options options_;
+        int repeat_override_ = 0;
+        int num_failed_ = 0;
+        std::vector<Result> results_;
+    };
+};
+
+#endif // MICROBENCH_HPP
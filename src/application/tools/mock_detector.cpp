@@ -0,0 +1,110 @@
+#include "mock_detector.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <algorithm>
+
+using namespace std;
+
+namespace MockDetector{
+
+    class InferImpl : public Infer{
+    public:
+        InferImpl(int max_batch_size, float infer_ms, int input_size)
+        :max_batch_size_(std::max(1, max_batch_size)), infer_ms_(infer_ms), input_size_(std::max(1, input_size)){
+            worker_ = thread(&InferImpl::worker, this);
+        }
+
+        virtual ~InferImpl(){
+            {
+                unique_lock<mutex> l(lock_);
+                run_ = false;
+            };
+            cond_.notify_one();
+            if(worker_.joinable())
+                worker_.join();
+        }
+
+        virtual shared_future<ObjectDetector::BoxArray> commit(const cv::Mat& image) override{
+            return commits({image})[0];
+        }
+
+        virtual vector<shared_future<ObjectDetector::BoxArray>> commits(const vector<cv::Mat>& images) override{
+
+            vector<shared_future<ObjectDetector::BoxArray>> output;
+            for(auto& image : images){
+                Job job;
+                job.width  = image.cols;
+                job.height = image.rows;
+                job.pro    = make_shared<promise<ObjectDetector::BoxArray>>();
+                cv::resize(image, job.input, cv::Size(input_size_, input_size_));
+                job.input.convertTo(job.input, CV_32F, 1 / 255.0);
+                output.emplace_back(job.pro->get_future());
+
+                {
+                    unique_lock<mutex> l(lock_);
+                    jobs_.emplace_back(std::move(job));
+                };
+                cond_.notify_one();
+            }
+            return output;
+        }
+
+        virtual int max_batch() override{
+            return max_batch_;
+        }
+
+    private:
+        struct Job{
+            cv::Mat input;
+            int width = 0, height = 0;
+            shared_ptr<promise<ObjectDetector::BoxArray>> pro;
+        };
+
+        void worker(){
+
+            vector<Job> batch;
+            while(true){
+                {
+                    unique_lock<mutex> l(lock_);
+                    cond_.wait(l, [&](){return !run_ || !jobs_.empty();});
+
+                    // 退出前处理完已经提交的任务
+                    if(jobs_.empty()) break;
+
+                    while(!jobs_.empty() && (int)batch.size() < max_batch_size_){
+                        batch.emplace_back(std::move(jobs_.front()));
+                        jobs_.pop_front();
+                    }
+                };
+
+                if((int)batch.size() > max_batch_)
+                    max_batch_ = batch.size();
+
+                this_thread::sleep_for(chrono::microseconds((int64_t)(infer_ms_ * 1000)));
+                for(auto& job : batch){
+                    float confidence = cv::mean(job.input)[0];
+                    job.pro->set_value({ObjectDetector::Box(0, 0, job.width, job.height, confidence, 0)});
+                }
+                batch.clear();
+            }
+        }
+
+    private:
+        int max_batch_size_ = 16;
+        float infer_ms_ = 5;
+        int input_size_ = 640;
+        atomic<int> max_batch_{0};
+        thread worker_;
+        mutex lock_;
+        condition_variable cond_;
+        deque<Job> jobs_;
+        bool run_ = true;
+    };
+
+    shared_ptr<Infer> create_infer(int max_batch_size, float infer_ms, int input_size){
+        return make_shared<InferImpl>(max_batch_size, infer_ms, input_size);
+    }
+};
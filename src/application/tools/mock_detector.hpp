@@ -0,0 +1,28 @@
+#ifndef MOCK_DETECTOR_HPP
+#define MOCK_DETECTOR_HPP
+
+#include <memory>
+#include <vector>
+#include <future>
+#include <opencv2/opencv.hpp>
+#include <common/object_detector.hpp>
+
+/* 不需要GPU和模型的模拟检测器，用于测试服务端、python绑定等调用方式的扩展性
+   与InferController一样在commit中完成预处理（resize到input_size并归一化），commit返回后不再访问image
+   推理线程把排队的任务合并为batch，每个batch休眠infer_ms毫秒，每张图返回一个覆盖整张图的框，用于检查结果与请求对应 */
+namespace MockDetector{
+
+    class Infer{
+    public:
+        virtual std::shared_future<ObjectDetector::BoxArray> commit(const cv::Mat& image) = 0;
+        virtual std::vector<std::shared_future<ObjectDetector::BoxArray>> commits(const std::vector<cv::Mat>& images) = 0;
+
+        // 到目前为止合并出的最大batch
+        virtual int max_batch() = 0;
+    };
+
+    // 析构时处理完已经提交的任务
+    std::shared_ptr<Infer> create_infer(int max_batch_size = 16, float infer_ms = 5.0f, int input_size = 640);
+};
+
+#endif // MOCK_DETECTOR_HPP
@@ -0,0 +1,112 @@
+
+#include "result_json.hpp"
+
+namespace ResultJson{
+
+    using namespace std;
+
+    static const int COORD_DECIMALS      = 2;
+    static const int CONFIDENCE_DECIMALS = 4;
+
+    static void write_rect(FastJson::Writer& writer, float left, float top, float right, float bottom, float confidence){
+        writer.member("left",       left,       COORD_DECIMALS);
+        writer.member("top",        top,        COORD_DECIMALS);
+        writer.member("right",      right,      COORD_DECIMALS);
+        writer.member("bottom",     bottom,     COORD_DECIMALS);
+        writer.member("confidence", confidence, CONFIDENCE_DECIMALS);
+    }
+
+    void write(FastJson::Writer& writer, const ObjectDetector::BoxArray& boxes){
+
+        writer.begin_array();
+        for(auto& box : boxes){
+            writer.begin_object();
+            write_rect(writer, box.left, box.top, box.right, box.bottom, box.confidence);
+            writer.member("class_label", box.class_label);
+            writer.end_object();
+        }
+        writer.end_array();
+    }
+
+    void write(FastJson::Writer& writer, const FaceDetector::BoxArray& boxes){
+
+        writer.begin_array();
+        for(auto& box : boxes){
+            writer.begin_object();
+            write_rect(writer, box.left, box.top, box.right, box.bottom, box.confidence);
+            writer.key("landmark").begin_array();
+            for(int i = 0; i < 10; ++i)
+                writer.value(box.landmark[i], COORD_DECIMALS);
+            writer.end_array();
+            writer.end_object();
+        }
+        writer.end_array();
+    }
+
+    const string& frame_to_json(FastJson::Writer& writer, int64_t frame_index, const ObjectDetector::BoxArray& boxes){
+
+        writer.clear();
+        writer.begin_object();
+        writer.member("frame", frame_index);
+        writer.key("boxes");
+        write(writer, boxes);
+        writer.end_object();
+        return writer.str();
+    }
+
+    static bool read_rect(const FastJson::Value& item, float& left, float& top, float& right, float& bottom, float& confidence){
+
+        auto jleft   = item["left"];
+        auto jtop    = item["top"];
+        auto jright  = item["right"];
+        auto jbottom = item["bottom"];
+        auto jconf   = item["confidence"];
+        if(!jleft.is_number() || !jtop.is_number() || !jright.is_number() || !jbottom.is_number() || !jconf.is_number())
+            return false;
+
+        left       = jleft.as_float();
+        top        = jtop.as_float();
+        right      = jright.as_float();
+        bottom     = jbottom.as_float();
+        confidence = jconf.as_float();
+        return true;
+    }
+
+    bool read(const FastJson::Value& array, ObjectDetector::BoxArray& boxes){
+
+        boxes.clear();
+        if(!array.is_array()) return false;
+
+        boxes.reserve(array.size());
+        for(auto item = array.first_child(); item.valid(); item = item.next()){
+            ObjectDetector::Box box;
+            auto label = item["class_label"];
+            if(!read_rect(item, box.left, box.top, box.right, box.bottom, box.confidence) || !label.is_number())
+                return false;
+
+            box.class_label = label.as_int();
+            boxes.emplace_back(box);
+        }
+        return true;
+    }
+
+    bool read(const FastJson::Value& array, FaceDetector::BoxArray& boxes){
+
+        boxes.clear();
+        if(!array.is_array()) return false;
+
+        boxes.reserve(array.size());
+        for(auto item = array.first_child(); item.valid(); item = item.next()){
+            FaceDetector::Box box;
+            auto landmark = item["landmark"];
+            if(!read_rect(item, box.left, box.top, box.right, box.bottom, box.confidence) || !landmark.is_array() || landmark.size() != 10)
+                return false;
+
+            int i = 0;
+            for(auto point = landmark.first_child(); point.valid(); point = point.next())
+                box.landmark[i++] = point.as_float();
+            boxes.emplace_back(box);
+        }
+        return true;
+    }
+};
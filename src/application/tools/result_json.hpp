@@ -0,0 +1,28 @@
+
+
+#ifndef RESULT_JSON_HPP
+#define RESULT_JSON_HPP
+
+#include <common/json_fast.hpp>
+#include <common/object_detector.hpp>
+#include <common/face_detector.hpp>
+
+/* 检测结果与json的直接转换，不经过Json::Value
+   坐标保留2位小数，置信度保留4位小数
+   目标框：{"left":..,"top":..,"right":..,"bottom":..,"confidence":..,"class_label":..}
+   人脸框：{"left":..,"top":..,"right":..,"bottom":..,"confidence":..,"landmark":[x0,y0,...,x4,y4]} */
+namespace ResultJson{
+
+    // 写入一个数组，可以作为更大的文档的一部分，例如 writer.key("boxes"); ResultJson::write(writer, boxes);
+    void write(FastJson::Writer& writer, const ObjectDetector::BoxArray& boxes);
+    void write(FastJson::Writer& writer, const FaceDetector::BoxArray& boxes);
+
+    // 一帧的结果，{"frame":..,"boxes":[...]}，writer先被清空，返回writer中的内容
+    const std::string& frame_to_json(FastJson::Writer& writer, int64_t frame_index, const ObjectDetector::BoxArray& boxes);
+
+    // 缺少字段时返回false，boxes为已经解析的部分
+    bool read(const FastJson::Value& array, ObjectDetector::BoxArray& boxes);
+    bool read(const FastJson::Value& array, FaceDetector::BoxArray& boxes);
+};
+
+#endif // RESULT_JSON_HPP
@@ -0,0 +1,96 @@
+#include "unit_test.hpp"
+#include <common/ilogger.hpp>
+#include <vector>
+#include <exception>
+
+namespace UnitTest{
+
+    using namespace std;
+
+    struct TestCase{
+        string name;
+        TestFunction func;
+    };
+
+    // 静态初始化顺序不确定，注册表在第一次使用时构造
+    static vector<TestCase>& registry(){
+        static vector<TestCase> tests;
+        return tests;
+    }
+
+    static int current_failures_ = 0;
+
+    bool register_test(const char* name, const TestFunction& func){
+        registry().push_back({name, func});
+        return true;
+    }
+
+    void report_failure(const char* file, int line, const char* expression){
+        INFOE("    %s:%d check failed: %s", iLogger::file_name(file, true).c_str(), line, expression);
+        current_failures_++;
+    }
+
+    string temp_directory(){
+        return "unit_test.tmp/";
+    }
+
+    bool has_temp_file(const string& directory){
+        for(auto& file : iLogger::find_files(directory, "*", false, false)){
+            if(iLogger::file_name(file, true).find(".tmp") != string::npos)
+                return true;
+        }
+        return false;
+    }
+
+    // iLogger::rmtree只删除第一层的文件，测试的临时目录可能有多层
+    static void remove_temp_directory(){
+
+        auto directory = temp_directory();
+        for(auto& file : iLogger::find_files(directory, "*", false, true))
+            iLogger::delete_file(file);
+
+        auto dirs = iLogger::find_files(directory, "*", true, true);
+        for(int i = (int)dirs.size() - 1; i >= 0; --i)
+            iLogger::rmtree(dirs[i], true);
+        iLogger::rmtree(directory, true);
+    }
+
+    int run_all(const string& filter){
+
+        int num_run    = 0;
+        int num_failed = 0;
+        for(auto& test : registry()){
+            if(!iLogger::pattern_match(test.name.c_str(), filter.c_str()))
+                continue;
+
+            remove_temp_directory();
+            iLogger::mkdirs(temp_directory());
+
+            current_failures_ = 0;
+            auto tic = iLogger::timestamp_now_float();
+            try{
+                test.func();
+            }catch(const AssertFailed&){
+            }catch(const exception& e){
+                INFOE("    exception: %s", e.what());
+                current_failures_++;
+            }
+
+            float cost = iLogger::timestamp_now_float() - tic;
+            if(current_failures_ > 0){
+                INFOE("[FAILED] %s, %d checks failed, %.2f ms", test.name.c_str(), current_failures_, cost);
+                num_failed++;
+            }else{
+                INFO("[PASSED] %s, %.2f ms", test.name.c_str(), cost);
+            }
+            num_run++;
+        }
+
+        remove_temp_directory();
+        if(num_run == 0)
+            INFOW("No test matched %s", filter.c_str());
+
+        INFO("%d tests, %d passed, %d failed", num_run, num_run - num_failed, num_failed);
+        return num_failed;
+    }
+};
@@ -0,0 +1,47 @@
+
+#ifndef UNIT_TEST_HPP
+#define UNIT_TEST_HPP
+
+#include <string>
+#include <functional>
+
+/* 不需要GPU的单元测试，./pro unit_test [filter] 运行
+   每个测试用UNIT_TEST(name)定义，在静态初始化时注册，filter的规则与iLogger::pattern_match相同
+   UNIT_CHECK失败时记录文件和行号并继续执行，UNIT_ASSERT失败时结束当前测试 */
+namespace UnitTest{
+
+    typedef std::function<void()> TestFunction;
+
+    bool register_test(const char* name, const TestFunction& func);
+
+    // 记录一次检查失败，由UNIT_CHECK调用
+    void report_failure(const char* file, int line, const char* expression);
+
+    // 返回失败的测试个数
+    int run_all(const std::string& filter = "*");
+
+    // 测试用的临时目录，每个测试开始时清空
+    std::string temp_directory();
+
+    // directory下（不递归）是否有文件名包含.tmp的文件，用于检查原子写入后没有残留的临时文件
+    bool has_temp_file(const std::string& directory);
+
+    struct AssertFailed{};
+};
+
+#define UNIT_TEST_CONCAT_(a, b)     a##b
+#define UNIT_TEST_CONCAT(a, b)      UNIT_TEST_CONCAT_(a, b)
+
+#define UNIT_TEST(name)                                                                                     \
+    static void UNIT_TEST_CONCAT(unit_test_, name)();                                                       \
+    static bool UNIT_TEST_CONCAT(unit_test_registered_, name) =                                             \
+        UnitTest::register_test(#name, UNIT_TEST_CONCAT(unit_test_, name));                                 \
+    static void UNIT_TEST_CONCAT(unit_test_, name)()
+
+#define UNIT_CHECK(expression)                                                                              \
+    do{ if(!(expression)) UnitTest::report_failure(__FILE__, __LINE__, #expression); }while(0)
+
+#define UNIT_ASSERT(expression)                                                                             \
+    do{ if(!(expression)){ UnitTest::report_failure(__FILE__, __LINE__, #expression); throw UnitTest::AssertFailed(); } }while(0)
+
+#endif // UNIT_TEST_HPP
@@ -0,0 +1,554 @@
+
+#include "zmq_remote_infer.hpp"
+#include "zmq_remote_show.hpp"
+#include "zmq_result_stream.hpp"
+#include "zmq_u.hpp"
+#include <common/ilogger.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <string.h>
+
+using namespace std;
+
+namespace RemoteInfer{
+
+    static_assert(sizeof(RequestHeader) == 24, "RequestHeader layout");
+    static_assert(sizeof(ReplyHeader) == 24, "ReplyHeader layout");
+
+    // 接收一个完整的多段消息，没有消息时返回false
+    static bool recv_parts(zmq::socket_t& socket, vector<zmq::message_t>& parts){
+
+        parts.clear();
+        zmq::message_t part;
+        if(!socket.recv(part, zmq::recv_flags::dontwait))
+            return false;
+
+        bool more = part.more();
+        parts.emplace_back(std::move(part));
+        while(more){
+            zmq::message_t next;
+            socket.recv(next);
+            more = next.more();
+            parts.emplace_back(std::move(next));
+        }
+        return true;
+    }
+
+    static bool send_parts(zmq::socket_t& socket, vector<zmq::message_t>& parts, zmq::send_flags flags = zmq::send_flags::none){
+
+        for(size_t i = 0; i < parts.size(); ++i){
+            auto part_flags = i + 1 < parts.size() ? (flags | zmq::send_flags::sndmore) : flags;
+            if(!socket.send(parts[i], part_flags).has_value())
+                return false;
+        }
+        return true;
+    }
+
+    class ServerImpl : public Server{
+    public:
+        virtual ~ServerImpl(){
+            {
+                unique_lock<mutex> l(lock_);
+                run_ = false;
+            };
+            request_cond_.notify_all();
+            pending_cond_.notify_all();
+
+            for(auto& worker : workers_)
+                worker.join();
+
+            if(waiter_.joinable())  waiter_.join();
+            if(io_thread_.joinable()) io_thread_.join();
+        }
+
+        bool startup(const char* listen, const CommitFunction& commit, int num_threads){
+
+            commit_ = commit;
+            try{
+                auto& context = zmq_shared_context();
+                router_.reset(new zmq::socket_t(context, zmq::socket_type::router));
+                router_->set(zmq::sockopt::linger, 0);
+                router_->bind(listen);
+
+                // 回复由waiter线程产生，通过inproc交给io线程发送，ROUTER只在io线程中使用
+                auto address = iLogger::format("inproc://remote_infer_reply_%p", this);
+                reply_pull_.reset(new zmq::socket_t(context, zmq::socket_type::pull));
+                reply_pull_->bind(address);
+                reply_push_.reset(new zmq::socket_t(context, zmq::socket_type::push));
+                reply_push_->set(zmq::sockopt::linger, 0);
+                reply_push_->connect(address);
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+                router_.reset();
+                reply_pull_.reset();
+                reply_push_.reset();
+                return false;
+            }
+
+            io_thread_ = thread(&ServerImpl::io_loop, this);
+            waiter_    = thread(&ServerImpl::wait_loop, this);
+            for(int i = 0; i < std::max(1, num_threads); ++i)
+                workers_.emplace_back(&ServerImpl::worker, this);
+            return true;
+        }
+
+        virtual size_t num_requests() override{
+            return num_requests_;
+        }
+
+        virtual size_t num_failed() override{
+            return num_failed_;
+        }
+
+    private:
+        struct Request{
+            zmq::message_t identity;
+            RequestHeader header;
+            zmq::message_t payload;
+        };
+
+        struct Pending{
+            zmq::message_t identity;
+            uint64_t request_id = 0;
+            Status status = Status::Success;
+            shared_future<ObjectDetector::BoxArray> result;
+        };
+
+        void io_loop(){
+
+            vector<zmq::message_t> parts;
+            zmq_pollitem_t items[] = {
+                {router_->handle(),     0, ZMQ_POLLIN, 0},
+                {reply_pull_->handle(), 0, ZMQ_POLLIN, 0}
+            };
+
+            try{
+                while(run_){
+                    zmq::poll(items, 2, 100);
+
+                    if(items[0].revents & ZMQ_POLLIN){
+                        while(recv_parts(*router_, parts))
+                            on_request(parts);
+                    }
+
+                    if(items[1].revents & ZMQ_POLLIN){
+                        // 客户端已经断开或者队列满时丢弃
+                        while(recv_parts(*reply_pull_, parts))
+                            send_parts(*router_, parts, zmq::send_flags::dontwait);
+                    }
+                }
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+            }
+            router_.reset();
+            reply_pull_.reset();
+        }
+
+        void on_request(vector<zmq::message_t>& parts){
+
+            ++num_requests_;
+            if(parts.size() != 3 || parts[1].size() != sizeof(RequestHeader)){
+                INFOE("Invalid request, %d parts", (int)parts.size());
+                ++num_failed_;
+                return;
+            }
+
+            Request request;
+            request.identity = std::move(parts[0]);
+            memcpy(&request.header, parts[1].data(), sizeof(request.header));
+            request.payload  = std::move(parts[2]);
+            {
+                unique_lock<mutex> l(lock_);
+                requests_.emplace_back(std::move(request));
+            };
+            request_cond_.notify_one();
+        }
+
+        Status decode(const Request& request, cv::Mat& image){
+
+            auto& header = request.header;
+            if(header.magic != RequestMagic)
+                return Status::InvalidInput;
+
+            auto data = (unsigned char*)request.payload.data();
+            if(header.encoding == (int)Encoding::Raw){
+                if(header.width < 1 || header.height < 1 || request.payload.size() != (size_t)header.width * header.height * 3)
+                    return Status::InvalidInput;
+
+                // 直接引用消息的数据，commit返回前已经完成预处理
+                image = cv::Mat(header.height, header.width, CV_8UC3, data);
+                return Status::Success;
+            }
+
+            if(header.encoding == (int)Encoding::Jpeg){
+                image = cv::imdecode(cv::Mat(1, request.payload.size(), CV_8U, data), cv::IMREAD_COLOR);
+                return image.empty() ? Status::DecodeFailed : Status::Success;
+            }
+            return Status::InvalidInput;
+        }
+
+        void worker(){
+
+            while(true){
+                Request request;
+                {
+                    unique_lock<mutex> l(lock_);
+                    request_cond_.wait(l, [&](){return !run_ || !requests_.empty();});
+                    if(!run_) break;
+
+                    request = std::move(requests_.front());
+                    requests_.pop_front();
+                };
+
+                Pending pending;
+                pending.request_id = request.header.request_id;
+                pending.identity   = std::move(request.identity);
+
+                cv::Mat image;
+                pending.status = decode(request, image);
+                if(pending.status == Status::Success)
+                    pending.result = commit_(image);
+                else
+                    ++num_failed_;
+
+                {
+                    unique_lock<mutex> l(lock_);
+                    pendings_.emplace_back(std::move(pending));
+                };
+                pending_cond_.notify_one();
+            }
+        }
+
+        // 按提交顺序等待结果，InferController按顺序处理，先提交的先完成
+        void wait_loop(){
+
+            vector<zmq::message_t> parts(2);
+            while(true){
+                Pending pending;
+                {
+                    unique_lock<mutex> l(lock_);
+                    pending_cond_.wait(l, [&](){return !run_ || !pendings_.empty();});
+                    if(!run_ && pendings_.empty()) break;
+
+                    pending = std::move(pendings_.front());
+                    pendings_.pop_front();
+                };
+
+                ObjectDetector::BoxArray boxes;
+                if(pending.result.valid())
+                    boxes = pending.result.get();
+
+                ReplyHeader header;
+                header.magic      = ReplyMagic;
+                header.status     = (int)pending.status;
+                header.request_id = pending.request_id;
+                header.count      = boxes.size();
+                header.reserved   = 0;
+
+                zmq::message_t reply(sizeof(header) + boxes.size() * sizeof(ResultStream::ObjectBoxRecord));
+                auto records = (ResultStream::ObjectBoxRecord*)((unsigned char*)reply.data() + sizeof(header));
+                memcpy(reply.data(), &header, sizeof(header));
+                for(size_t i = 0; i < boxes.size(); ++i){
+                    auto& box = boxes[i];
+                    records[i].left        = box.left;
+                    records[i].top         = box.top;
+                    records[i].right       = box.right;
+                    records[i].bottom      = box.bottom;
+                    records[i].confidence  = box.confidence;
+                    records[i].class_label = box.class_label;
+                }
+
+                parts[0] = std::move(pending.identity);
+                parts[1] = std::move(reply);
+                try{
+                    send_parts(*reply_push_, parts);
+                }catch(zmq::error_t err){
+                    INFOE("ZMQ exception: %s", err.what());
+                }
+            }
+            reply_push_.reset();
+        }
+
+    private:
+        CommitFunction commit_;
+        shared_ptr<zmq::socket_t> router_;
+        shared_ptr<zmq::socket_t> reply_pull_;
+        shared_ptr<zmq::socket_t> reply_push_;
+        thread io_thread_;
+        thread waiter_;
+        vector<thread> workers_;
+        mutex lock_;
+        condition_variable request_cond_;
+        condition_variable pending_cond_;
+        deque<Request> requests_;
+        deque<Pending> pendings_;
+        atomic<bool> run_{true};
+        atomic<size_t> num_requests_{0};
+        atomic<size_t> num_failed_{0};
+    };
+
+    shared_ptr<Server> create_server(const char* listen, const CommitFunction& commit, int num_threads){
+
+        shared_ptr<ServerImpl> instance(new ServerImpl());
+        if(!instance->startup(listen, commit, num_threads)){
+            instance.reset();
+        }
+        return instance;
+    }
+
+    class ClientImpl : public Client{
+    public:
+        virtual ~ClientImpl(){
+            run_ = false;
+            if(io_thread_.joinable())
+                io_thread_.join();
+
+            {
+                unique_lock<mutex> l(send_lock_);
+                request_push_.reset();
+            };
+
+            // 没有返回的请求设置为空结果
+            unique_lock<mutex> l(pending_lock_);
+            for(auto& item : pendings_)
+                item.second.promise->set_value(ObjectDetector::BoxArray());
+            pendings_.clear();
+        }
+
+        bool startup(const char* server, Encoding encoding, int timeout_ms){
+
+            encoding_   = encoding;
+            timeout_ms_ = timeout_ms;
+            try{
+                auto& context = zmq_shared_context();
+                dealer_.reset(new zmq::socket_t(context, zmq::socket_type::dealer));
+                dealer_->set(zmq::sockopt::linger, 0);
+                dealer_->connect(server);
+
+                // commit可能来自多个线程，经过inproc交给io线程，DEALER只在io线程中使用
+                auto address = iLogger::format("inproc://remote_infer_request_%p", this);
+                request_pull_.reset(new zmq::socket_t(context, zmq::socket_type::pull));
+                request_pull_->bind(address);
+                request_push_.reset(new zmq::socket_t(context, zmq::socket_type::push));
+                request_push_->set(zmq::sockopt::linger, 0);
+                request_push_->connect(address);
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+                dealer_.reset();
+                request_pull_.reset();
+                request_push_.reset();
+                return false;
+            }
+
+            io_thread_ = thread(&ClientImpl::io_loop, this);
+            return true;
+        }
+
+        virtual shared_future<ObjectDetector::BoxArray> commit(const cv::Mat& image) override{
+
+            auto promise = make_shared<std::promise<ObjectDetector::BoxArray>>();
+            auto future  = promise->get_future().share();
+            if(image.empty() || image.type() != CV_8UC3){
+                INFOE("Image must be a non-empty CV_8UC3 image");
+                promise->set_value(ObjectDetector::BoxArray());
+                return future;
+            }
+
+            RequestHeader header;
+            header.magic      = RequestMagic;
+            header.encoding   = (int)encoding_;
+            header.request_id = next_request_id_++;
+            header.width      = image.cols;
+            header.height     = image.rows;
+
+            zmq::message_t payload;
+            if(encoding_ == Encoding::Jpeg){
+                vector<unsigned char> data;
+                if(!cv::imencode(".jpg", image, data)){
+                    INFOE("Encode image failed");
+                    promise->set_value(ObjectDetector::BoxArray());
+                    return future;
+                }
+                payload.rebuild(data.data(), data.size());
+            }else if(image.isContinuous()){
+                payload.rebuild(image.data, image.rows * image.cols * 3);
+            }else{
+                cv::Mat continuous = image.clone();
+                payload.rebuild(continuous.data, continuous.rows * continuous.cols * 3);
+            }
+
+            {
+                unique_lock<mutex> l(pending_lock_);
+                auto& item    = pendings_[header.request_id];
+                item.promise  = promise;
+                item.deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms_);
+            };
+
+            try{
+                unique_lock<mutex> l(send_lock_);
+                request_push_->send(zmq::const_buffer(&header, sizeof(header)), zmq::send_flags::sndmore);
+                request_push_->send(payload, zmq::send_flags::none);
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+                finish(header.request_id, ObjectDetector::BoxArray());
+            }
+            return future;
+        }
+
+        virtual vector<shared_future<ObjectDetector::BoxArray>> commits(const vector<cv::Mat>& images) override{
+
+            vector<shared_future<ObjectDetector::BoxArray>> output(images.size());
+            for(size_t i = 0; i < images.size(); ++i)
+                output[i] = commit(images[i]);
+            return output;
+        }
+
+    private:
+        struct Pending{
+            shared_ptr<std::promise<ObjectDetector::BoxArray>> promise;
+            chrono::steady_clock::time_point deadline;
+        };
+
+        void finish(uint64_t request_id, const ObjectDetector::BoxArray& boxes){
+
+            shared_ptr<promise<ObjectDetector::BoxArray>> promise;
+            {
+                unique_lock<mutex> l(pending_lock_);
+                auto iter = pendings_.find(request_id);
+
+                // 已经超时的请求
+                if(iter == pendings_.end())
+                    return;
+
+                promise = iter->second.promise;
+                pendings_.erase(iter);
+            };
+            promise->set_value(boxes);
+        }
+
+        void on_reply(const zmq::message_t& reply){
+
+            ReplyHeader header;
+            if(reply.size() < sizeof(header)){
+                INFOE("Invalid reply");
+                return;
+            }
+
+            memcpy(&header, reply.data(), sizeof(header));
+            if(header.magic != ReplyMagic || reply.size() != sizeof(header) + header.count * sizeof(ResultStream::ObjectBoxRecord)){
+                INFOE("Invalid reply");
+                return;
+            }
+
+            ObjectDetector::BoxArray boxes;
+            if(header.status != (int)Status::Success){
+                INFOE("Request %lld failed, status = %d", (long long)header.request_id, header.status);
+            }else{
+                boxes.resize(header.count);
+                auto records = (const ResultStream::ObjectBoxRecord*)((const unsigned char*)reply.data() + sizeof(header));
+                for(size_t i = 0; i < boxes.size(); ++i){
+                    ResultStream::ObjectBoxRecord record;
+                    memcpy(&record, records + i, sizeof(record));
+                    boxes[i] = ObjectDetector::Box(record.left, record.top, record.right, record.bottom, record.confidence, record.class_label);
+                }
+            }
+            finish(header.request_id, boxes);
+        }
+
+        void check_timeout(){
+
+            vector<shared_ptr<promise<ObjectDetector::BoxArray>>> expired;
+            auto now = chrono::steady_clock::now();
+            {
+                unique_lock<mutex> l(pending_lock_);
+                for(auto iter = pendings_.begin(); iter != pendings_.end();){
+                    if(iter->second.deadline < now){
+                        expired.emplace_back(iter->second.promise);
+                        iter = pendings_.erase(iter);
+                    }else{
+                        ++iter;
+                    }
+                }
+            };
+
+            if(!expired.empty())
+                INFOE("%d requests timeout", (int)expired.size());
+
+            for(auto& promise : expired)
+                promise->set_value(ObjectDetector::BoxArray());
+        }
+
+        void io_loop(){
+
+            vector<zmq::message_t> parts;
+            zmq_pollitem_t items[] = {
+                {dealer_->handle(),       0, ZMQ_POLLIN, 0},
+                {request_pull_->handle(), 0, ZMQ_POLLIN, 0}
+            };
+
+            auto last_check = chrono::steady_clock::now();
+            try{
+                while(run_){
+                    zmq::poll(items, 2, 100);
+
+                    if(items[0].revents & ZMQ_POLLIN){
+                        while(recv_parts(*dealer_, parts)){
+                            if(parts.size() == 1)
+                                on_reply(parts[0]);
+                        }
+                    }
+
+                    if(items[1].revents & ZMQ_POLLIN){
+                        while(recv_parts(*request_pull_, parts)){
+
+                            // 服务端没有连接时DEALER的队列会满，直接失败而不是阻塞
+                            if(!send_parts(*dealer_, parts, zmq::send_flags::dontwait)){
+                                RequestHeader header;
+                                memcpy(&header, parts[0].data(), sizeof(header));
+                                INFOE("Send request failed, server is not available");
+                                finish(header.request_id, ObjectDetector::BoxArray());
+                            }
+                        }
+                    }
+
+                    auto now = chrono::steady_clock::now();
+                    if(now - last_check > chrono::milliseconds(100)){
+                        check_timeout();
+                        last_check = now;
+                    }
+                }
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+            }
+            dealer_.reset();
+            request_pull_.reset();
+        }
+
+    private:
+        Encoding encoding_ = Encoding::Raw;
+        int timeout_ms_ = 5000;
+        shared_ptr<zmq::socket_t> dealer_;
+        shared_ptr<zmq::socket_t> request_pull_;
+        shared_ptr<zmq::socket_t> request_push_;
+        thread io_thread_;
+        mutex send_lock_;
+        mutex pending_lock_;
+        map<uint64_t, Pending> pendings_;
+        atomic<uint64_t> next_request_id_{0};
+        atomic<bool> run_{true};
+    };
+
+    shared_ptr<Client> create_client(const char* server, Encoding encoding, int timeout_ms){
+
+        shared_ptr<ClientImpl> instance(new ClientImpl());
+        if(!instance->startup(server, encoding, timeout_ms)){
+            instance.reset();
+        }
+        return instance;
+    }
+};
@@ -0,0 +1,79 @@
+
+
+#ifndef ZMQ_REMOTE_INFER_HPP
+#define ZMQ_REMOTE_INFER_HPP
+
+#include <memory>
+#include <vector>
+#include <future>
+#include <functional>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+#include <common/object_detector.hpp>
+
+/* 多个进程共享同一个检测器，避免每个进程各自加载engine占用显存
+   服务端为ROUTER，客户端为DEALER，请求异步返回。多个客户端的请求都提交到同一个InferController，由它合并为batch
+   请求：RequestHeader + 图像数据（jpeg等编码后的数据，或者BGR的原始像素）
+   回复：ReplyHeader + count个ResultStream::ObjectBoxRecord */
+namespace RemoteInfer{
+
+    const uint32_t RequestMagic = 0x51525452;  // "TRRQ"
+    const uint32_t ReplyMagic   = 0x50525452;  // "TRRP"
+
+    enum class Encoding : int{
+        Raw  = 0,   // BGR像素，不需要编解码，适合本机或者带宽足够的网络
+        Jpeg = 1    // 客户端编码jpeg，服务端解码
+    };
+
+    struct RequestHeader{
+        uint32_t magic;
+        int32_t encoding;
+        uint64_t request_id;
+        int32_t width, height;    // Raw时有效
+    };
+
+    enum class Status : int{
+        Success       = 0,
+        InvalidInput  = 1,
+        DecodeFailed  = 2
+    };
+
+    struct ReplyHeader{
+        uint32_t magic;
+        int32_t status;
+        uint64_t request_id;
+        uint32_t count;
+        uint32_t reserved;
+    };
+
+    // 服务端调用的提交函数，需要在返回前完成对image的读取（InferController的预处理在commit中完成）
+    typedef std::function<std::shared_future<ObjectDetector::BoxArray>(const cv::Mat& image)> CommitFunction;
+
+    class Server{
+    public:
+        virtual size_t num_requests() = 0;
+        virtual size_t num_failed() = 0;
+    };
+
+    // num_threads为解码和提交的线程数
+    std::shared_ptr<Server> create_server(const char* listen, const CommitFunction& commit, int num_threads = 4);
+
+    // 支持Yolo::Infer、CenterNet::Infer等commit(cv::Mat)返回shared_future<BoxArray>的检测器
+    template<typename _Infer>
+    std::shared_ptr<Server> create_server(const char* listen, const std::shared_ptr<_Infer>& infer, int num_threads = 4){
+        return create_server(listen, [infer](const cv::Mat& image){return infer->commit(image);}, num_threads);
+    }
+
+    // 与Yolo::Infer的接口一致。超时或者服务端返回错误时结果为空
+    class Client{
+    public:
+        virtual std::shared_future<ObjectDetector::BoxArray> commit(const cv::Mat& image) = 0;
+        virtual std::vector<std::shared_future<ObjectDetector::BoxArray>> commits(const std::vector<cv::Mat>& images) = 0;
+    };
+
+    std::shared_ptr<Client> create_client(
+        const char* server = "tcp://127.0.0.1:15560", Encoding encoding = Encoding::Raw, int timeout_ms = 5000
+    );
+};
+
+#endif // ZMQ_REMOTE_INFER_HPP
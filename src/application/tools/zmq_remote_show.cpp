@@ -1,24 +1,51 @@
-
 #include "zmq_remote_show.hpp"
 #include "zmq_u.hpp"
 #include <common/ilogger.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 using namespace std;
 
+zmq::context_t& zmq_shared_context(){
+
+    // 不析构，退出时还没有关闭的socket会让zmq_ctx_term一直等待
+    static zmq::context_t* context = new zmq::context_t();
+    return *context;
+}
+
 class ZMQRemoteShowImpl : public ZMQRemoteShow{
 public:
-    bool listen(const char* url){
+    virtual ~ZMQRemoteShowImpl(){
+        {
+            unique_lock<mutex> l(lock_);
+            run_ = false;
+        };
+        cond_.notify_one();
+        if(worker_.joinable())
+            worker_.join();
+    }
+
+    bool listen(const char* url, int jpeg_quality, float scale, ZMQShowMode mode){
         try{
-            context_.reset(new zmq::context_t());
-            socket_.reset(new zmq::socket_t(*context_.get(), zmq::socket_type::rep));
+            auto type = mode == ZMQShowMode::Push ? zmq::socket_type::push : zmq::socket_type::pub;
+            socket_.reset(new zmq::socket_t(zmq_shared_context(), type));
+
+            // 发送队列只保留很少的帧，慢的接收端丢帧而不是累积延迟。关闭时不等待没有发送的帧
+            socket_->set(zmq::sockopt::sndhwm, 2);
+            socket_->set(zmq::sockopt::linger, 0);
             socket_->bind(url);
-            return true;
         }catch(zmq::error_t err){
             INFOE("ZMQ exception: %s", err.what());
             socket_.reset();
-            context_.reset();
+            return false;
         }
-        return false;
+
+        jpeg_quality_ = jpeg_quality;
+        scale_        = scale;
+        worker_       = thread(&ZMQRemoteShowImpl::worker, this);
+        return true;
     }
 
     virtual void post(const void* data, int size) override{
@@ -28,27 +55,132 @@ public:
             return;
         }
 
-        zmq::message_t msg;
-        socket_->recv(msg);
-        socket_->send(zmq::message_t(data, size));
+        Frame frame;
+        frame.encoded.assign((const unsigned char*)data, (const unsigned char*)data + size);
+        hand_off(frame);
     }
 
     virtual void post(const cv::Mat& image) override{
 
-        vector<unsigned char> data;
-        cv::imencode(".jpg", image, data);
-        post(data.data(), data.size());
+        if(image.empty()){
+            INFOE("Empty image to post");
+            return;
+        }
+
+        // 调用者会复用image的缓冲区（例如VideoCapture的帧），只引用时后台线程可能编码到被覆盖的数据
+        Frame frame;
+        frame.image = image.clone();
+        hand_off(frame);
+    }
+
+    virtual void post(cv::Mat&& image) override{
+
+        if(image.empty()){
+            INFOE("Empty image to post");
+            return;
+        }
+
+        Frame frame;
+        frame.image = std::move(image);
+        hand_off(frame);
+    }
+
+    virtual size_t num_sent() override{
+        return num_sent_;
+    }
+
+    virtual size_t num_dropped() override{
+        return num_dropped_;
+    }
+
+private:
+    struct Frame{
+        cv::Mat image;
+        vector<unsigned char> encoded;
+    };
+
+    void hand_off(Frame& frame){
+
+        // 被替换的帧在锁外释放
+        Frame dropped;
+        {
+            unique_lock<mutex> l(lock_);
+            if(has_frame_){
+                dropped = std::move(pending_);
+                ++num_dropped_;
+            }
+            pending_   = std::move(frame);
+            has_frame_ = true;
+        };
+        cond_.notify_one();
+    }
+
+    void worker(){
+
+        vector<int> params{cv::IMWRITE_JPEG_QUALITY, jpeg_quality_};
+        vector<unsigned char> buffer;
+        cv::Mat scaled;
+
+        while(true){
+            Frame frame;
+            {
+                unique_lock<mutex> l(lock_);
+                cond_.wait(l, [&](){return !run_ || has_frame_;});
+                if(!run_) break;
+
+                frame      = std::move(pending_);
+                has_frame_ = false;
+            };
+
+            const vector<unsigned char>* data = &frame.encoded;
+            if(!frame.image.empty()){
+                const cv::Mat* image = &frame.image;
+                if(scale_ != 1.0f){
+                    cv::resize(frame.image, scaled, cv::Size(), scale_, scale_, cv::INTER_AREA);
+                    image = &scaled;
+                }
+
+                if(!cv::imencode(".jpg", *image, buffer, params)){
+                    INFOE("Encode image failed");
+                    ++num_dropped_;
+                    continue;
+                }
+                data = &buffer;
+            }
+
+            try{
+                // 没有接收端（PUSH）或者发送队列已满时直接丢弃
+                auto result = socket_->send(zmq::const_buffer(data->data(), data->size()), zmq::send_flags::dontwait);
+                if(result.has_value())
+                    ++num_sent_;
+                else
+                    ++num_dropped_;
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+                ++num_dropped_;
+            }
+        }
+        socket_.reset();
     }
 
 private:
-    shared_ptr<zmq::context_t> context_;
-    shared_ptr<zmq::socket_t>  socket_;
+    shared_ptr<zmq::socket_t> socket_;
+    thread worker_;
+    mutex lock_;
+    condition_variable cond_;
+    Frame pending_;
+    bool has_frame_ = false;
+    bool run_ = true;
+    int jpeg_quality_ = 90;
+    float scale_ = 1.0f;
+    atomic<size_t> num_sent_{0};
+    atomic<size_t> num_dropped_{0};
 };
 
-std::shared_ptr<ZMQRemoteShow> create_zmq_remote_show(const char* listen){
-    
+std::shared_ptr<ZMQRemoteShow> create_zmq_remote_show(const char* listen, int jpeg_quality, float scale, ZMQShowMode mode){
+
     shared_ptr<ZMQRemoteShowImpl> instance(new ZMQRemoteShowImpl());
-    if(!instance->listen(listen)){
+    if(!instance->listen(listen, jpeg_quality, scale, mode)){
         instance.reset();
     }
     return instance;
@@ -6,12 +6,39 @@
 #include <memory>
 #include <opencv2/opencv.hpp>
 
+namespace zmq{
+    class context_t;
+};
+
+enum class ZMQShowMode : int{
+    Publish = 0,    // PUB，可以有多个订阅者，没有订阅者或者订阅者太慢时丢帧
+    Push    = 1     // PUSH，多个接收者轮流接收
+};
+
+/* 调用线程只把帧交给后台线程，后台线程缩放、编码jpeg并以非阻塞方式发送
+   后台线程来不及处理时只保留最新的一帧，之前没有发送的帧被丢弃 */
 class ZMQRemoteShow{
 public:
+    // 复制data，适用于已经编码好的数据
     virtual void post(const void* data, int size) = 0;
+
+    // 复制image，post之后可以继续复用image的缓冲区
     virtual void post(const cv::Mat& image) = 0;
+
+    // 不复制，接管image的引用，适用于image.clone()或者之后不再修改的图像
+    virtual void post(cv::Mat&& image) = 0;
+
+    // PUB模式下订阅者的队列满时由zmq丢弃，这部分不计入num_dropped
+    virtual size_t num_sent() = 0;
+    virtual size_t num_dropped() = 0;
 };
 
-std::shared_ptr<ZMQRemoteShow> create_zmq_remote_show(const char* listen="tcp://0.0.0.0:15556");
+// 进程内共享的zmq context，使用inproc://地址时接收端需要使用同一个context
+zmq::context_t& zmq_shared_context();
+
+// 接收端见tools/show.py
+std::shared_ptr<ZMQRemoteShow> create_zmq_remote_show(
+    const char* listen="tcp://0.0.0.0:15556", int jpeg_quality = 90, float scale = 1.0f, ZMQShowMode mode = ZMQShowMode::Publish
+);
 
-#endif // ZMQ_REMOTE_SHOW_HPP
\ No newline at end of file
+#endif // ZMQ_REMOTE_SHOW_HPP
@@ -0,0 +1,315 @@
+
+#include "zmq_result_stream.hpp"
+#include "zmq_remote_show.hpp"
+#include "zmq_u.hpp"
+#include <common/ilogger.hpp>
+#include <chrono>
+#include <string.h>
+
+using namespace std;
+
+namespace ResultStream{
+
+    static_assert(sizeof(FrameHeader) == 32, "FrameHeader layout");
+    static_assert(sizeof(SectionHeader) == 8, "SectionHeader layout");
+    static_assert(sizeof(ObjectBoxRecord) == 24, "ObjectBoxRecord layout");
+    static_assert(sizeof(FaceBoxRecord) == 60, "FaceBoxRecord layout");
+    static_assert(sizeof(TrackRecord) == 28, "TrackRecord layout");
+    static_assert(sizeof(PoseKeypoint) == 12, "PoseKeypoint layout");
+
+    // 已知的段，记录比本版本的大时只取前面的字段，兼容以后追加字段
+    template<typename _T>
+    static bool read_records(const unsigned char* data, const SectionHeader& section, vector<_T>& output){
+        if(section.record_bytes < sizeof(_T))
+            return false;
+
+        output.resize(section.count);
+        for(uint32_t i = 0; i < section.count; ++i)
+            memcpy(&output[i], data + (size_t)i * section.record_bytes, sizeof(_T));
+        return true;
+    }
+
+    bool parse(const void* data, size_t size, Frame& output){
+
+        const unsigned char* begin = (const unsigned char*)data;
+        FrameHeader header;
+        if(data == nullptr || size < sizeof(header))
+            return false;
+
+        memcpy(&header, begin, sizeof(header));
+        if(header.magic != Magic || header.version != Version || header.payload_bytes != size - sizeof(header))
+            return false;
+
+        output = Frame();
+        output.frame_id     = header.frame_id;
+        output.timestamp_us = header.timestamp_us;
+
+        size_t offset = sizeof(header);
+        for(int i = 0; i < header.num_sections; ++i){
+            SectionHeader section;
+            if(size - offset < sizeof(section))
+                return false;
+
+            memcpy(&section, begin + offset, sizeof(section));
+            offset += sizeof(section);
+
+            size_t section_bytes = (size_t)section.record_bytes * section.count;
+            if(size - offset < section_bytes)
+                return false;
+
+            const unsigned char* records = begin + offset;
+            offset += section_bytes;
+
+            bool ok = true;
+            switch((SectionType)section.type){
+            case SectionType::ObjectBox: ok = read_records(records, section, output.objects); break;
+            case SectionType::FaceBox:   ok = read_records(records, section, output.faces);   break;
+            case SectionType::Track:     ok = read_records(records, section, output.tracks);  break;
+            case SectionType::Pose:{
+                if(section.record_bytes < sizeof(int32_t) || (section.record_bytes - sizeof(int32_t)) % sizeof(PoseKeypoint) != 0)
+                    return false;
+
+                int num_keypoints = (section.record_bytes - sizeof(int32_t)) / sizeof(PoseKeypoint);
+                output.num_keypoints = num_keypoints;
+                output.pose_owners.resize(section.count);
+                output.keypoints.resize((size_t)section.count * num_keypoints);
+                for(uint32_t j = 0; j < section.count; ++j){
+                    const unsigned char* record = records + (size_t)j * section.record_bytes;
+                    int32_t owner = 0;
+                    memcpy(&owner, record, sizeof(owner));
+                    output.pose_owners[j] = owner;
+                    memcpy(output.keypoints.data() + (size_t)j * num_keypoints, record + sizeof(owner), num_keypoints * sizeof(PoseKeypoint));
+                }
+                break;
+            }
+            default:
+                // 不认识的段直接跳过
+                break;
+            }
+
+            if(!ok) return false;
+        }
+        return offset == size;
+    }
+
+    class PublisherImpl : public Publisher{
+    public:
+        virtual ~PublisherImpl(){
+            socket_.reset();
+        }
+
+        bool listen(const char* url, int high_water_mark, Mode mode){
+            try{
+                auto type = mode == Mode::Push ? zmq::socket_type::push : zmq::socket_type::pub;
+                socket_.reset(new zmq::socket_t(zmq_shared_context(), type));
+                socket_->set(zmq::sockopt::sndhwm, high_water_mark);
+                socket_->set(zmq::sockopt::linger, 0);
+                socket_->bind(url);
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+                socket_.reset();
+                return false;
+            }
+            return true;
+        }
+
+        virtual void begin_frame(uint64_t frame_id, uint64_t timestamp_us) override{
+
+            if(timestamp_us == 0)
+                timestamp_us = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+            buffer_.resize(sizeof(FrameHeader));
+            header_.magic         = Magic;
+            header_.version       = Version;
+            header_.num_sections  = 0;
+            header_.frame_id      = frame_id;
+            header_.timestamp_us  = timestamp_us;
+            header_.payload_bytes = 0;
+            header_.reserved      = 0;
+            in_frame_ = true;
+        }
+
+        virtual void add(const ObjectDetector::BoxArray& boxes) override{
+
+            auto records = (ObjectBoxRecord*)append_section(SectionType::ObjectBox, sizeof(ObjectBoxRecord), boxes.size());
+            if(records == nullptr) return;
+
+            for(size_t i = 0; i < boxes.size(); ++i){
+                auto& box    = boxes[i];
+                auto& record = records[i];
+                record.left        = box.left;
+                record.top         = box.top;
+                record.right       = box.right;
+                record.bottom      = box.bottom;
+                record.confidence  = box.confidence;
+                record.class_label = box.class_label;
+            }
+        }
+
+        virtual void add(const FaceDetector::BoxArray& boxes) override{
+
+            auto records = (FaceBoxRecord*)append_section(SectionType::FaceBox, sizeof(FaceBoxRecord), boxes.size());
+            if(records == nullptr) return;
+
+            for(size_t i = 0; i < boxes.size(); ++i){
+                auto& box    = boxes[i];
+                auto& record = records[i];
+                record.left       = box.left;
+                record.top        = box.top;
+                record.right      = box.right;
+                record.bottom     = box.bottom;
+                record.confidence = box.confidence;
+                memcpy(record.landmark, box.landmark, sizeof(record.landmark));
+            }
+        }
+
+        virtual void add(const vector<DeepSORT::TrackObject*>& tracks, bool only_confirmed) override{
+
+            int count = 0;
+            for(auto& track : tracks){
+                if(!only_confirmed || is_visible(track))
+                    count++;
+            }
+
+            auto records = (TrackRecord*)append_section(SectionType::Track, sizeof(TrackRecord), count);
+            if(records == nullptr) return;
+
+            for(auto& track : tracks){
+                if(only_confirmed && !is_visible(track)) continue;
+
+                auto box     = track->last_position();
+                auto& record = *records++;
+                record.id                = track->id();
+                record.state             = (int32_t)track->state();
+                record.time_since_update = track->time_since_update();
+                record.left              = box.left;
+                record.top               = box.top;
+                record.right             = box.right;
+                record.bottom            = box.bottom;
+            }
+        }
+
+        virtual void add(const vector<vector<cv::Point3f>>& poses, const vector<int>& owners) override{
+
+            if(!owners.empty() && owners.size() != poses.size()){
+                INFOE("owners.size[%d] != poses.size[%d]", (int)owners.size(), (int)poses.size());
+                return;
+            }
+
+            // 固定记录大小，关键点数量不一致时按最多的补0
+            size_t num_keypoints = 0;
+            for(auto& pose : poses)
+                num_keypoints = std::max(num_keypoints, pose.size());
+
+            size_t record_bytes = sizeof(int32_t) + num_keypoints * sizeof(PoseKeypoint);
+            if(record_bytes > 0xFFFF){
+                INFOE("Too many keypoints: %d", (int)num_keypoints);
+                return;
+            }
+
+            auto records = append_section(SectionType::Pose, record_bytes, poses.size());
+            if(records == nullptr) return;
+
+            memset(records, 0, record_bytes * poses.size());
+            for(size_t i = 0; i < poses.size(); ++i){
+                unsigned char* record = records + i * record_bytes;
+                int32_t owner = owners.empty() ? (int32_t)i : owners[i];
+                memcpy(record, &owner, sizeof(owner));
+
+                auto keypoints = (PoseKeypoint*)(record + sizeof(owner));
+                for(size_t j = 0; j < poses[i].size(); ++j){
+                    keypoints[j].x          = poses[i][j].x;
+                    keypoints[j].y          = poses[i][j].y;
+                    keypoints[j].confidence = poses[i][j].z;
+                }
+            }
+        }
+
+        virtual bool end_frame() override{
+
+            if(!in_frame_){
+                INFOE("end_frame without begin_frame");
+                return false;
+            }
+            in_frame_ = false;
+
+            header_.payload_bytes = buffer_.size() - sizeof(FrameHeader);
+            memcpy(buffer_.data(), &header_, sizeof(header_));
+
+            try{
+                // 整帧一条消息，队列满时丢弃而不是阻塞推理线程
+                auto result = socket_->send(zmq::const_buffer(buffer_.data(), buffer_.size()), zmq::send_flags::dontwait);
+                if(!result.has_value()){
+                    ++num_dropped_;
+                    return false;
+                }
+            }catch(zmq::error_t err){
+                INFOE("ZMQ exception: %s", err.what());
+                ++num_dropped_;
+                return false;
+            }
+
+            ++num_sent_;
+            num_bytes_ += buffer_.size();
+            return true;
+        }
+
+        virtual size_t num_sent() override{
+            return num_sent_;
+        }
+
+        virtual size_t num_dropped() override{
+            return num_dropped_;
+        }
+
+        virtual size_t num_bytes() override{
+            return num_bytes_;
+        }
+
+    private:
+        static bool is_visible(const DeepSORT::TrackObject* track){
+            return track->state() == DeepSORT::State::Confirmed && track->time_since_update() == 0;
+        }
+
+        // 追加段头，返回记录区域的指针。空的段不写入
+        unsigned char* append_section(SectionType type, size_t record_bytes, size_t count){
+
+            if(!in_frame_){
+                INFOE("Add results without begin_frame");
+                return nullptr;
+            }
+
+            if(count == 0)
+                return nullptr;
+
+            SectionHeader section;
+            section.type         = (uint16_t)type;
+            section.record_bytes = (uint16_t)record_bytes;
+            section.count        = (uint32_t)count;
+
+            size_t offset = buffer_.size();
+            buffer_.resize(offset + sizeof(section) + record_bytes * count);
+            memcpy(buffer_.data() + offset, &section, sizeof(section));
+            header_.num_sections++;
+            return buffer_.data() + offset + sizeof(section);
+        }
+
+    private:
+        shared_ptr<zmq::socket_t> socket_;
+        vector<unsigned char> buffer_;
+        FrameHeader header_;
+        bool in_frame_     = false;
+        size_t num_sent_    = 0;
+        size_t num_dropped_ = 0;
+        size_t num_bytes_   = 0;
+    };
+
+    shared_ptr<Publisher> create_publisher(const char* listen, int high_water_mark, Mode mode){
+
+        shared_ptr<PublisherImpl> instance(new PublisherImpl());
+        if(!instance->listen(listen, high_water_mark, mode)){
+            instance.reset();
+        }
+        return instance;
+    }
+};
@@ -0,0 +1,112 @@
+
+
+#ifndef ZMQ_RESULT_STREAM_HPP
+#define ZMQ_RESULT_STREAM_HPP
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+#include <common/object_detector.hpp>
+#include <common/face_detector.hpp>
+#include "deepsort.hpp"
+
+/* 把检测、跟踪、姿态结果以固定布局的二进制格式通过zmq发布给下游服务
+   每帧为一条消息：FrameHeader + 若干段，每段为SectionHeader + count条固定大小的记录
+   所有字段为小端、4字节对齐，没有padding，python端见tools/result_subscriber.py */
+namespace ResultStream{
+
+    const uint32_t Magic   = 0x52545254;  // "TRTR"
+    const uint16_t Version = 1;
+
+    enum class SectionType : uint16_t{
+        ObjectBox = 1,
+        FaceBox   = 2,
+        Track     = 3,
+        Pose      = 4
+    };
+
+    struct FrameHeader{
+        uint32_t magic;
+        uint16_t version;
+        uint16_t num_sections;
+        uint64_t frame_id;
+        uint64_t timestamp_us;     // 微秒，unix时间
+        uint32_t payload_bytes;    // header之后所有段的字节数
+        uint32_t reserved;
+    };
+
+    struct SectionHeader{
+        uint16_t type;
+        uint16_t record_bytes;     // 每条记录的字节数，不认识的段可以按record_bytes * count跳过
+        uint32_t count;
+    };
+
+    struct ObjectBoxRecord{
+        float left, top, right, bottom, confidence;
+        int32_t class_label;
+    };
+
+    struct FaceBoxRecord{
+        float left, top, right, bottom, confidence;
+        float landmark[10];
+    };
+
+    struct TrackRecord{
+        int32_t id;
+        int32_t state;             // DeepSORT::State
+        int32_t time_since_update;
+        float left, top, right, bottom;
+    };
+
+    // 姿态记录为int32 owner + num_keypoints个PoseKeypoint，num_keypoints = (record_bytes - 4) / 12
+    struct PoseKeypoint{
+        float x, y, confidence;
+    };
+
+    struct Frame{
+        uint64_t frame_id     = 0;
+        uint64_t timestamp_us = 0;
+        std::vector<ObjectBoxRecord> objects;
+        std::vector<FaceBoxRecord> faces;
+        std::vector<TrackRecord> tracks;
+        int num_keypoints = 0;
+        std::vector<int> pose_owners;
+        std::vector<PoseKeypoint> keypoints;   // pose_owners.size() * num_keypoints
+    };
+
+    // 解析一条消息，格式不对时返回false
+    bool parse(const void* data, size_t size, Frame& output);
+
+    enum class Mode : int{
+        Publish = 0,    // PUB，订阅者的队列满时由zmq丢弃
+        Push    = 1     // PUSH，接收端的队列满时end_frame返回false，计入num_dropped
+    };
+
+    /* 同一个帧的结果在begin_frame和end_frame之间添加，end_frame时作为一条消息非阻塞发送
+       不是线程安全的，每个生产线程使用自己的Publisher */
+    class Publisher{
+    public:
+        // timestamp_us = 0时使用当前时间
+        virtual void begin_frame(uint64_t frame_id, uint64_t timestamp_us = 0) = 0;
+        virtual void add(const ObjectDetector::BoxArray& boxes) = 0;
+        virtual void add(const FaceDetector::BoxArray& boxes) = 0;
+
+        // only_confirmed = true时只发送确认状态且当前帧更新过的目标
+        virtual void add(const std::vector<DeepSORT::TrackObject*>& tracks, bool only_confirmed = true) = 0;
+
+        // owners为每个姿态对应的目标，例如track id或者box的索引，为空时使用0, 1, 2...
+        virtual void add(const std::vector<std::vector<cv::Point3f>>& poses, const std::vector<int>& owners = std::vector<int>()) = 0;
+        virtual bool end_frame() = 0;
+
+        virtual size_t num_sent() = 0;
+        virtual size_t num_dropped() = 0;
+        virtual size_t num_bytes() = 0;
+    };
+
+    std::shared_ptr<Publisher> create_publisher(
+        const char* listen = "tcp://0.0.0.0:15557", int high_water_mark = 100, Mode mode = Mode::Publish
+    );
+};
+
+#endif // ZMQ_RESULT_STREAM_HPP
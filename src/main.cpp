@@ -18,6 +18,22 @@ int app_plugin();
 int app_yolo_fast();
 int app_centernet();
 int app_dbface();
+int app_toposort_bench();
+int app_onnx_load_bench();
+int app_binio_bench();
+int app_remote_show_bench();
+int app_result_stream_bench();
+int app_remote_infer_server();
+int app_remote_infer_bench();
+int app_dataset_bench();
+int app_bench();
+int app_face_index_bench();
+int app_face_gallery_bench();
+int app_face_pipeline_bench();
+int app_tensor_diff(int argc, char** argv);
+int app_onnx_optimize(int argc, char** argv);
+int app_onnx_analyze(int argc, char** argv);
+int app_unit_test(int argc, char** argv);
 
 void test_all(){
     app_yolo();
@@ -66,6 +82,38 @@ int main(int argc, char** argv){
         app_lesson();
     }else if(strcmp(method, "plugin") == 0){
         app_plugin();
+    }else if(strcmp(method, "toposort_bench") == 0){
+        app_toposort_bench();
+    }else if(strcmp(method, "onnx_load_bench") == 0){
+        app_onnx_load_bench();
+    }else if(strcmp(method, "binio_bench") == 0){
+        app_binio_bench();
+    }else if(strcmp(method, "remote_show_bench") == 0){
+        app_remote_show_bench();
+    }else if(strcmp(method, "result_stream_bench") == 0){
+        app_result_stream_bench();
+    }else if(strcmp(method, "remote_infer_server") == 0){
+        app_remote_infer_server();
+    }else if(strcmp(method, "remote_infer_bench") == 0){
+        app_remote_infer_bench();
+    }else if(strcmp(method, "dataset_bench") == 0){
+        app_dataset_bench();
+    }else if(strcmp(method, "bench") == 0){
+        app_bench();
+    }else if(strcmp(method, "face_index_bench") == 0){
+        app_face_index_bench();
+    }else if(strcmp(method, "face_gallery_bench") == 0){
+        app_face_gallery_bench();
+    }else if(strcmp(method, "face_pipeline_bench") == 0){
+        app_face_pipeline_bench();
+    }else if(strcmp(method, "tensor_diff") == 0){
+        return app_tensor_diff(argc - 2, argv + 2);
+    }else if(strcmp(method, "onnx_optimize") == 0){
+        return app_onnx_optimize(argc - 2, argv + 2);
+    }else if(strcmp(method, "onnx_analyze") == 0){
+        return app_onnx_analyze(argc - 2, argv + 2);
+    }else if(strcmp(method, "unit_test") == 0){
+        return app_unit_test(argc - 2, argv + 2);
     }else if(strcmp(method, "test_all") == 0){
         test_all();
     }else{
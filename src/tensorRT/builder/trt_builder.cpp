@@ -1,5 +1,6 @@
 
 #include "trt_builder.hpp"
+#include "trt_calibration_loader.hpp"
 
 #include <cuda_runtime_api.h>
 #include <cublas_v2.h>
@@ -286,6 +287,26 @@ namespace TRT {
 		:dims_(dims){
 	}
 
+	// bucket中第index个输入的尺寸，没有指定的输入以及值为-1的维度使用base的尺寸，batch维度由调用者设置
+	static bool bucket_dims(const std::vector<InputDims>& setup, int index, const nvinfer1::Dims& base, nvinfer1::Dims& output){
+
+		output = base;
+		if(index >= setup.size())
+			return true;
+
+		auto& dims = setup[index].dims();
+		if(dims.size() != base.nbDims){
+			INFOE("Shape bucket dims %s mismatch with input %d dims %s", join_dims(dims).c_str(), index, dims_str(base).c_str());
+			return false;
+		}
+
+		for(int k = 1; k < dims.size(); ++k){
+			if(dims[k] != -1)
+				output.d[k] = dims[k];
+		}
+		return true;
+	}
+
 	ModelSource::ModelSource(const char* onnxmodel){
 		this->type_ = ModelSourceType::OnnX;
 		this->onnxmodel_ = onnxmodel;
@@ -323,15 +344,17 @@ namespace TRT {
 	class Int8EntropyCalibrator : public IInt8EntropyCalibrator2
 	{
 	public:
-		Int8EntropyCalibrator(const vector<string>& imagefiles, nvinfer1::Dims dims, const Int8Process& preprocess) {
+		Int8EntropyCalibrator(const vector<string>& imagefiles, nvinfer1::Dims dims, const Int8Process& preprocess, const Int8CalibrationConfig& config) {
 
 			Assert(preprocess != nullptr);
 			this->dims_ = dims;
-			this->allimgs_ = imagefiles;
-			this->preprocess_ = preprocess;
 			this->fromCalibratorData_ = false;
-			files_.resize(dims.d[0]);
-			checkCudaRuntime(cudaStreamCreate(&stream_));
+
+			// 预处理在loader的线程中提前进行，getBatch只需要等待准备好的batch
+			this->loader_ = create_calibration_loader(imagefiles, vector<int>(dims.d, dims.d + dims.nbDims), preprocess, config);
+			if (this->loader_ == nullptr) {
+				INFOE("Create calibration loader failed.");
+			}
 		}
 
 		Int8EntropyCalibrator(const vector<uint8_t>& entropyCalibratorData, nvinfer1::Dims dims, const Int8Process& preprocess) {
@@ -339,40 +362,22 @@ namespace TRT {
 
 			this->dims_ = dims;
 			this->entropyCalibratorData_ = entropyCalibratorData;
-			this->preprocess_ = preprocess;
 			this->fromCalibratorData_ = true;
-			files_.resize(dims.d[0]);
-			checkCudaRuntime(cudaStreamCreate(&stream_));
 		}
 
 		virtual ~Int8EntropyCalibrator(){
-			checkCudaRuntime(cudaStreamDestroy(stream_));
 		}
 
 		int getBatchSize() const noexcept {
 			return dims_.d[0];
 		}
 
-		bool next() {
-			int batch_size = dims_.d[0];
-			if (cursor_ + batch_size > allimgs_.size())
-				return false;
-
-			for(int i = 0; i < batch_size; ++i)
-				files_[i] = allimgs_[cursor_++];
-
-			if (!tensor_){
-				tensor_.reset(new Tensor(dims_.nbDims, dims_.d));
-				tensor_->set_stream(stream_);
-				tensor_->set_workspace(make_shared<TRT::MixMemory>());
-			}
-
-			preprocess_(cursor_, allimgs_.size(), files_, tensor_);
-			return true;
-		}
-
 		bool getBatch(void* bindings[], const char* names[], int nbBindings) noexcept {
-			if (!next()) return false;
+			if (loader_ == nullptr) return false;
+
+			// 上一个batch在这里释放，loader会在它的位置上预处理后续的batch
+			tensor_ = loader_->next();
+			if (tensor_ == nullptr) return false;
 			bindings[0] = tensor_->gpu();
 			return true;
 		}
@@ -396,16 +401,11 @@ namespace TRT {
 		}
 
 	private:
-		Int8Process preprocess_;
-		vector<string> allimgs_;
-		size_t batchCudaSize_ = 0;
-		int cursor_ = 0;
 		nvinfer1::Dims dims_;
-		vector<string> files_;
+		shared_ptr<CalibrationLoader> loader_;
 		shared_ptr<Tensor> tensor_;
 		vector<uint8_t> entropyCalibratorData_;
 		bool fromCalibratorData_ = false;
-		CUStream stream_ = nullptr;
 	};
 
 	bool compile(
@@ -416,7 +416,9 @@ namespace TRT {
 		std::vector<InputDims> inputsDimsSetup,
 		Int8Process int8process,
 		const std::string& int8ImageDirectory,
-		const std::string& int8EntropyCalibratorFile) {
+		const std::string& int8EntropyCalibratorFile,
+		std::vector<uint8_t>* timingCache,
+		const std::vector<ShapeBucket>& shapeBuckets) {
 
 		if (mode == Mode::INT8 && int8process == nullptr) {
 			INFOE("int8process must not nullptr, when in int8 mode.");
@@ -424,6 +426,7 @@ namespace TRT {
 		}
 
 		bool hasEntropyCalibrator = false;
+		auto calibrationConfig = get_int8_calibration_config();
 		vector<uint8_t> entropyCalibratorData;
 		vector<string> entropyCalibratorFiles;
 		if (mode == Mode::INT8) {
@@ -455,6 +458,12 @@ namespace TRT {
 					return false;
 				}
 
+				size_t numFoundImages = entropyCalibratorFiles.size();
+				entropyCalibratorFiles = subsample_calibration_files(entropyCalibratorFiles, calibrationConfig.max_images, calibrationConfig.seed);
+				if (entropyCalibratorFiles.size() < numFoundImages) {
+					INFO("Subsample %d of %d images for calibration, seed = %u", entropyCalibratorFiles.size(), numFoundImages, calibrationConfig.seed);
+				}
+
 				if(entropyCalibratorFiles.size() < maxBatchSize){
 					INFOW("Too few images provided, %d[provided] < %d[max batch size], image copy will be performed", entropyCalibratorFiles.size(), maxBatchSize);
 					for(int i = entropyCalibratorFiles.size(); i < maxBatchSize; ++i)
@@ -536,6 +545,8 @@ namespace TRT {
 		shared_ptr<Int8EntropyCalibrator> int8Calibrator;
 		if (mode == Mode::INT8) {
 			auto calibratorDims = inputDims;
+			if (!shapeBuckets.empty() && !bucket_dims(shapeBuckets[0].max_dims, 0, inputDims, calibratorDims))
+				return false;
 			calibratorDims.d[0] = maxBatchSize;
 
 			if (hasEntropyCalibrator) {
@@ -547,7 +558,7 @@ namespace TRT {
 			else {
 				INFO("Using image list[%d files]: %s", entropyCalibratorFiles.size(), int8ImageDirectory.c_str());
 				int8Calibrator.reset(new Int8EntropyCalibrator(
-					entropyCalibratorFiles, calibratorDims, int8process
+					entropyCalibratorFiles, calibratorDims, int8process, calibrationConfig
 				));
 			}
 			config->setInt8Calibrator(int8Calibrator.get());
@@ -617,17 +628,55 @@ namespace TRT {
 		builder->setMaxBatchSize(maxBatchSize);
 		config->setMaxWorkspaceSize(_1_GB);
 
-		auto profile = builder->createOptimizationProfile();
-		for(int i = 0; i < net_num_input; ++i){
-			auto input = network->getInput(i);
-			auto input_dims = input->getDimensions();
-			input_dims.d[0] = 1;
-			profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMIN, input_dims);
-			profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kOPT, input_dims);
-			input_dims.d[0] = maxBatchSize;
-			profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMAX, input_dims);
+		// 没有设置shape bucket时只有一个profile，使用网络输入的尺寸
+		vector<ShapeBucket> buckets = shapeBuckets;
+		if (buckets.empty())
+			buckets.emplace_back();
+
+		if (buckets.size() > 1)
+			INFO("Set %d optimization profiles:", buckets.size());
+
+		IOptimizationProfile* calibrationProfile = nullptr;
+		for(int ibucket = 0; ibucket < buckets.size(); ++ibucket){
+			auto& bucket = buckets[ibucket];
+			auto profile = builder->createOptimizationProfile();
+			for(int i = 0; i < net_num_input; ++i){
+				auto input = network->getInput(i);
+				nvinfer1::Dims min_dims, opt_dims, max_dims;
+				if (!bucket_dims(bucket.max_dims, i, input->getDimensions(), max_dims) ||
+					!bucket_dims(bucket.opt_dims, i, max_dims, opt_dims) ||
+					!bucket_dims(bucket.min_dims, i, max_dims, min_dims))
+					return false;
+
+				for(int k = 1; k < max_dims.nbDims; ++k){
+					if(max_dims.d[k] == -1){
+						INFOE("Input %s has dynamic dimensions %s, shape buckets must be set.", input->getName(), dims_str(max_dims).c_str());
+						return false;
+					}
+				}
+
+				min_dims.d[0] = 1;
+				opt_dims.d[0] = 1;
+				max_dims.d[0] = maxBatchSize;
+				profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMIN, min_dims);
+				profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kOPT, opt_dims);
+				profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMAX, max_dims);
+
+				if (buckets.size() > 1)
+					INFO("      %d.[%s] min = %s, opt = %s, max = %s", ibucket, input->getName(), dims_str(min_dims).c_str(), dims_str(opt_dims).c_str(), dims_str(max_dims).c_str());
+			}
+
+			if(!profile->isValid()){
+				INFOE("Optimization profile %d is invalid.", ibucket);
+				return false;
+			}
+			config->addOptimizationProfile(profile);
+			if(ibucket == 0) calibrationProfile = profile;
 		}
 
+		if (mode == Mode::INT8 && !shapeBuckets.empty())
+			config->setCalibrationProfile(calibrationProfile);
+
 		// not need
 		// for(int i = 0; i < net_num_output; ++i){
 		// 	auto output = network->getOutput(i);
@@ -638,11 +687,26 @@ namespace TRT {
 		// 	output_dims.d[0] = maxBatchSize;
 		// 	profile->setDimensions(output->getName(), nvinfer1::OptProfileSelector::kMAX, output_dims);
 		// }
-		config->addOptimizationProfile(profile);
 
-		// error on jetson
-		// auto timing_cache = shared_ptr<nvinfer1::ITimingCache>(config->createTimingCache(nullptr, 0), [](nvinfer1::ITimingCache* ptr){ptr->reset();});
-		// config->setTimingCache(*timing_cache, false);
+		// 之前默认开启时在jetson上报错，因此只在调用方提供timingCache时使用，创建失败则不使用cache继续编译
+		// ITimingCache从TensorRT 8开始提供，7.x时忽略timingCache
+#if NV_TENSORRT_MAJOR >= 8
+		shared_ptr<ITimingCache> timing_cache;
+		if (timingCache != nullptr) {
+			timing_cache.reset(config->createTimingCache(timingCache->data(), timingCache->size()), destroy_nvidia_pointer<ITimingCache>);
+			if (timing_cache == nullptr || !config->setTimingCache(*timing_cache, false)) {
+				INFOW("Can not use timing cache[%d bytes], build without it.", timingCache->size());
+				timing_cache.reset();
+			}
+			else {
+				INFO("Using timing cache[%d bytes]", timingCache->size());
+			}
+		}
+#else
+		if (timingCache != nullptr) {
+			INFOW("Timing cache requires TensorRT 8, build without it.");
+		}
+#endif
 		// config->setFlag(BuilderFlag::kGPU_FALLBACK);
 		// config->setDefaultDeviceType(DeviceType::kDLA);
 		// config->setDLACore(0);
@@ -668,6 +732,14 @@ namespace TRT {
 		}
 
 		INFO("Build done %lld ms !", iLogger::timestamp_now() - time_start);
+
+#if NV_TENSORRT_MAJOR >= 8
+		if (timing_cache != nullptr) {
+			shared_ptr<IHostMemory> cache_data(timing_cache->serialize(), destroy_nvidia_pointer<IHostMemory>);
+			if (cache_data != nullptr)
+				timingCache->assign((uint8_t*)cache_data->data(), (uint8_t*)cache_data->data() + cache_data->size());
+		}
+#endif
 		
 		// serialize the engine, then close everything down
 		shared_ptr<IHostMemory> seridata(engine->serialize(), destroy_nvidia_pointer<IHostMemory>);
@@ -678,4 +750,42 @@ namespace TRT {
 			return true;
 		}
 	}
+
+	bool merge_timing_cache(std::vector<uint8_t>& dst, const std::vector<uint8_t>& src) {
+
+#if NV_TENSORRT_MAJOR < 8
+		INFOW("Timing cache requires TensorRT 8, merge is not supported.");
+		return false;
+#else
+		if (src.empty()) return true;
+		if (dst.empty()) {
+			dst = src;
+			return true;
+		}
+
+		shared_ptr<IBuilder> builder(createInferBuilder(gLogger), destroy_nvidia_pointer<IBuilder>);
+		if (builder == nullptr) {
+			INFOE("Can not create builder.");
+			return false;
+		}
+
+		shared_ptr<IBuilderConfig> config(builder->createBuilderConfig(), destroy_nvidia_pointer<IBuilderConfig>);
+		shared_ptr<ITimingCache> dst_cache(config->createTimingCache(dst.data(), dst.size()), destroy_nvidia_pointer<ITimingCache>);
+		shared_ptr<ITimingCache> src_cache(config->createTimingCache(src.data(), src.size()), destroy_nvidia_pointer<ITimingCache>);
+		if (dst_cache == nullptr || src_cache == nullptr) {
+			INFOE("Can not create timing cache.");
+			return false;
+		}
+
+		if (!dst_cache->combine(*src_cache, false)) {
+			INFOE("Combine timing cache failed.");
+			return false;
+		}
+
+		shared_ptr<IHostMemory> cache_data(dst_cache->serialize(), destroy_nvidia_pointer<IHostMemory>);
+		if (cache_data == nullptr) return false;
+		dst.assign((uint8_t*)cache_data->data(), (uint8_t*)cache_data->data() + cache_data->size());
+		return true;
+#endif
+	}
 }; //namespace TRTBuilder
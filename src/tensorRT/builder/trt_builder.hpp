@@ -88,6 +88,21 @@ namespace TRT {
 		std::vector<int> dims_;
 	};
 
+	/** 一个shape bucket编译为一个optimization profile，推理时TRT::Infer选择能容纳输入尺寸的最小的profile
+	//   min_dims、opt_dims、max_dims中每个输入对应一个InputDims，第0维（batch）被忽略，由1~maxBatchSize决定
+	//   没有指定的输入以及值为-1的维度使用网络输入的尺寸，min_dims、opt_dims为空时等于max_dims（固定尺寸的bucket）
+	//   网络输入的对应维度需要是动态的，例如onnx导出时指定dynamic_axes，或者inputsDimsSetup设置为{{1, 3, -1, -1}} **/
+	struct ShapeBucket{
+		std::vector<InputDims> min_dims;
+		std::vector<InputDims> opt_dims;
+		std::vector<InputDims> max_dims;
+
+		ShapeBucket() = default;
+		ShapeBucket(const std::vector<InputDims>& dims):max_dims(dims){}
+		ShapeBucket(const std::vector<InputDims>& min, const std::vector<InputDims>& opt, const std::vector<InputDims>& max)
+			:min_dims(min), opt_dims(opt), max_dims(max){}
+	};
+
 	enum class Mode : int {
 		FP32,
 		FP16,
@@ -96,6 +111,7 @@ namespace TRT {
 
 	const char* mode_string(Mode type);
 
+	// hook只对调用线程中之后的一次TRT::compile生效，解析完onnx后自动清除
 	void set_layer_hook_reshape(const LayerHookFuncReshape& func);
 
 	/** 当处于INT8模式时，int8process必须制定
@@ -103,7 +119,10 @@ namespace TRT {
 	//     如果初次生成，指定了int8EntropyCalibratorFile，calibrator会保存到int8EntropyCalibratorFile指定的文件
 	//     如果已经生成过，指定了int8EntropyCalibratorFile，calibrator会从int8EntropyCalibratorFile指定的文件加载，而不是
 	//          从int8ImageDirectory读取图片再重新生成
-	//当处于FP32或者FP16时，int8process、int8ImageDirectory、int8EntropyCalibratorFile都不需要指定 **/
+	//当处于FP32或者FP16时，int8process、int8ImageDirectory、int8EntropyCalibratorFile都不需要指定
+	//timingCache不为nullptr时，用其内容（可以为空）作为timing cache编译，编译结束后写回更新后的cache，
+	//     同一设备上的多个模型共享cache可以省去重复的tactic测速，TensorRT 7.x时忽略
+	//shapeBuckets为空时只有一个使用网络输入尺寸的profile，否则每个bucket一个profile，INT8标定使用第一个bucket **/
 	bool compile(
 		Mode mode,
 		unsigned int maxBatchSize,
@@ -112,7 +131,12 @@ namespace TRT {
 		const std::vector<InputDims> inputsDimsSetup = {},
 		Int8Process int8process = nullptr,
 		const std::string& int8ImageDirectory = "",
-		const std::string& int8EntropyCalibratorFile = "");
+		const std::string& int8EntropyCalibratorFile = "",
+		std::vector<uint8_t>* timingCache = nullptr,
+		const std::vector<ShapeBucket>& shapeBuckets = {});
+
+	// 把src中的timing cache合并到dst，dst为空时直接复制。TensorRT 7.x不支持timing cache，返回false
+	bool merge_timing_cache(std::vector<uint8_t>& dst, const std::vector<uint8_t>& src);
 };
 
 #endif //TRT_BUILDER_HPP
\ No newline at end of file
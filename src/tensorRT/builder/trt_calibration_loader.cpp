@@ -0,0 +1,383 @@
+
+#include "trt_calibration_loader.hpp"
+#include <common/ilogger.hpp>
+#include <common/cuda_tools.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace TRT {
+
+	using namespace std;
+
+	static mutex g_config_lock;
+	static Int8CalibrationConfig g_config;
+	static thread_local shared_ptr<Int8CalibrationConfig> g_thread_config;
+
+	void set_int8_calibration_config(const Int8CalibrationConfig& config){
+		unique_lock<mutex> l(g_config_lock);
+		g_config = config;
+	}
+
+	void set_thread_int8_calibration_config(const Int8CalibrationConfig* config){
+		if(config)
+			g_thread_config = make_shared<Int8CalibrationConfig>(*config);
+		else
+			g_thread_config.reset();
+	}
+
+	Int8CalibrationConfig get_int8_calibration_config(){
+		if(g_thread_config)
+			return *g_thread_config;
+
+		unique_lock<mutex> l(g_config_lock);
+		return g_config;
+	}
+
+	vector<string> subsample_calibration_files(const vector<string>& files, int max_images, unsigned int seed){
+
+		// find_files的顺序取决于文件系统，先排序保证结果确定
+		vector<string> output = files;
+		std::sort(output.begin(), output.end());
+		if(max_images <= 0 || (int)output.size() <= max_images)
+			return output;
+
+		vector<pair<uint64_t, int>> order(output.size());
+		for(size_t i = 0; i < output.size(); ++i)
+			order[i] = make_pair(iLogger::hash64(output[i].data(), output[i].size(), seed), (int)i);
+
+		std::partial_sort(order.begin(), order.begin() + max_images, order.end());
+		order.resize(max_images);
+		std::sort(order.begin(), order.end(), [](const pair<uint64_t, int>& a, const pair<uint64_t, int>& b){
+			return a.second < b.second;
+		});
+
+		vector<string> selected(max_images);
+		for(int i = 0; i < max_images; ++i)
+			selected[i] = output[order[i].second];
+		return selected;
+	}
+
+	class DefaultCalibrationDevice : public CalibrationDevice{
+	public:
+		DefaultCalibrationDevice(){
+			checkCudaRuntime(cudaGetDevice(&device_id_));
+		}
+
+		virtual ~DefaultCalibrationDevice(){
+			CUDATools::AutoDevice auto_device(device_id_);
+			for(auto& stream : streams_)
+				checkCudaRuntime(cudaStreamDestroy(stream));
+		}
+
+		virtual shared_ptr<Tensor> create_tensor(const vector<int>& dims) override{
+			CUDATools::AutoDevice auto_device(device_id_);
+			CUStream stream = nullptr;
+			checkCudaRuntime(cudaStreamCreate(&stream));
+			streams_.emplace_back(stream);
+
+			shared_ptr<Tensor> tensor(new Tensor(dims));
+			tensor->set_stream(stream);
+			tensor->set_workspace(make_shared<MixMemory>());
+			return tensor;
+		}
+
+		virtual void bind_thread() override{
+			checkCudaRuntime(cudaSetDevice(device_id_));
+		}
+
+		virtual void upload(const shared_ptr<Tensor>& tensor) override{
+			tensor->gpu();
+			tensor->synchronize();
+		}
+
+	private:
+		int device_id_ = 0;
+		vector<CUStream> streams_;
+	};
+
+	shared_ptr<CalibrationDevice> create_default_calibration_device(){
+		return make_shared<DefaultCalibrationDevice>();
+	}
+
+	/** cache文件格式，全部为uint32
+	//   magic, version, key_low, key_high, num_batches, ndims, dims[ndims], 之后是num_batches个float的batch数据 **/
+	static const unsigned int kCacheMagic   = 0xCA1B0C01;
+	static const unsigned int kCacheVersion = 1;
+
+	class CalibrationLoaderImpl : public CalibrationLoader{
+	public:
+		struct Slot{
+			shared_ptr<Tensor> tensor;
+			int batch = -1;
+		};
+
+		virtual ~CalibrationLoaderImpl(){
+			{
+				unique_lock<mutex> l(lock_);
+				run_ = false;
+			}
+			cond_.notify_all();
+			for(auto& worker : workers_)
+				worker->join();
+
+			// 标定没有走完，不完整的cache不能使用
+			if(cache_writer_ != nullptr){
+				fclose(cache_writer_);
+				iLogger::delete_file(cache_temp_file_);
+			}
+
+			// tensor先于device释放，stream由device销毁
+			slots_.clear();
+			device_.reset();
+		}
+
+		bool startup(const vector<string>& files, const vector<int>& dims, const Int8Process& process, const Int8CalibrationConfig& config, shared_ptr<CalibrationDevice> device){
+
+			if(dims.empty() || dims[0] < 1){
+				INFOE("Invalid calibration dims.");
+				return false;
+			}
+
+			if(process == nullptr){
+				INFOE("Int8Process is nullptr.");
+				return false;
+			}
+
+			files_       = files;
+			dims_        = dims;
+			process_     = process;
+			batch_size_  = dims[0];
+			num_batches_ = files.size() / batch_size_;
+			batch_numel_ = 1;
+			for(auto& d : dims) batch_numel_ *= d;
+			device_      = device ? device : create_default_calibration_device();
+
+			if(!config.cache_file.empty()){
+				cache_file_ = config.cache_file;
+				cache_key_  = make_key();
+				if(open_cache()){
+					INFO("Using calibration tensor cache[%d batches]: %s", num_batches_, cache_file_.c_str());
+					from_cache_ = true;
+					create_slots(1);
+					return true;
+				}
+				if(!create_cache_writer())
+					INFOW("Can not create calibration tensor cache: %s", cache_file_.c_str());
+			}
+
+			int num_threads = std::max(0, config.num_threads);
+			create_slots(num_threads > 0 ? std::max(1, config.prefetch) + 1 : 1);
+
+			run_ = true;
+			for(int i = 0; i < num_threads && i < num_batches_; ++i)
+				workers_.emplace_back(new thread(&CalibrationLoaderImpl::worker, this));
+			return true;
+		}
+
+		virtual shared_ptr<Tensor> next() override{
+
+			if(cursor_ >= num_batches_){
+				finish_cache();
+				return nullptr;
+			}
+
+			int ibatch = cursor_++;
+			shared_ptr<Tensor> tensor;
+			if(from_cache_){
+				tensor = slots_[0].tensor;
+				const float* ptr = (const float*)((const char*)cache_mapping_->data() + cache_data_offset_) + ibatch * batch_numel_;
+				tensor->copy_from_cpu(0, ptr, batch_numel_);
+			}else if(workers_.empty()){
+				tensor = slots_[0].tensor;
+				process_batch(ibatch, tensor);
+			}else{
+				auto& slot = slots_[ibatch % slots_.size()];
+				unique_lock<mutex> l(lock_);
+
+				// 之前的batch已经被TensorRT用完，它们的位置可以给后续的batch使用
+				released_ = ibatch;
+				cond_.notify_all();
+				cond_.wait(l, [&](){return slot.batch == ibatch;});
+				tensor = slot.tensor;
+			}
+
+			if(cache_writer_ != nullptr){
+				if(fwrite(tensor->cpu(), 1, tensor->bytes(), cache_writer_) != (size_t)tensor->bytes()){
+					INFOW("Write calibration tensor cache failed, disable it.");
+					fclose(cache_writer_);
+					cache_writer_ = nullptr;
+					iLogger::delete_file(cache_temp_file_);
+				}
+			}
+
+			device_->upload(tensor);
+			return tensor;
+		}
+
+		virtual int num_batches() const override{return num_batches_;}
+		virtual bool from_cache() const override{return from_cache_;}
+
+	private:
+		void create_slots(int size){
+			slots_.resize(size);
+			for(auto& slot : slots_)
+				slot.tensor = device_->create_tensor(dims_);
+		}
+
+		void process_batch(int ibatch, shared_ptr<Tensor>& tensor){
+			auto begin = files_.begin() + ibatch * batch_size_;
+			vector<string> batch_files(begin, begin + batch_size_);
+			process_((ibatch + 1) * batch_size_, files_.size(), batch_files, tensor);
+			device_->upload(tensor);
+		}
+
+		void worker(){
+
+			device_->bind_thread();
+			int ring = slots_.size();
+			while(true){
+				int ibatch = 0;
+				{
+					unique_lock<mutex> l(lock_);
+					if(!run_ || next_batch_ >= num_batches_) break;
+
+					// batch按顺序分配，等待ring中对应的位置被释放
+					ibatch = next_batch_++;
+					cond_.wait(l, [&](){return !run_ || ibatch < released_ + ring;});
+					if(!run_) break;
+				}
+
+				auto& slot = slots_[ibatch % ring];
+				process_batch(ibatch, slot.tensor);
+				{
+					unique_lock<mutex> l(lock_);
+					slot.batch = ibatch;
+				}
+				cond_.notify_all();
+			}
+		}
+
+		// 文件列表、文件大小以及尺寸一致时，cache才有效
+		uint64_t make_key() const{
+			string config;
+			for(auto& d : dims_)
+				config += iLogger::format("%d,", d);
+
+			for(int i = 0; i < num_batches_ * batch_size_; ++i){
+				auto& file = files_[i];
+				config += iLogger::format("|%s:%lld", file.c_str(), (long long)iLogger::file_size(file));
+			}
+			return iLogger::hash64(config.data(), config.size());
+		}
+
+		vector<unsigned int> make_header() const{
+			vector<unsigned int> header{
+				kCacheMagic, kCacheVersion, (unsigned int)(cache_key_ & 0xFFFFFFFF), (unsigned int)(cache_key_ >> 32),
+				(unsigned int)num_batches_, (unsigned int)dims_.size()
+			};
+			header.insert(header.end(), dims_.begin(), dims_.end());
+			return header;
+		}
+
+		bool open_cache(){
+
+			if(!iLogger::exists(cache_file_) || num_batches_ == 0) return false;
+
+			auto mapping = iLogger::map_file(cache_file_);
+			if(mapping == nullptr) return false;
+
+			auto header = make_header();
+			size_t header_bytes = header.size() * sizeof(unsigned int);
+			size_t data_bytes   = (size_t)num_batches_ * batch_numel_ * sizeof(float);
+			if(mapping->size() != header_bytes + data_bytes || memcmp(mapping->data(), header.data(), header_bytes) != 0){
+				INFO("Calibration tensor cache %s is outdated, rebuild it.", cache_file_.c_str());
+				return false;
+			}
+
+			cache_mapping_     = mapping;
+			cache_data_offset_ = header_bytes;
+			return true;
+		}
+
+		bool create_cache_writer(){
+
+			if(num_batches_ == 0) return false;
+
+			string directory = iLogger::directory(cache_file_);
+			if(!directory.empty() && directory != "." && !iLogger::mkdirs(directory))
+				return false;
+
+			cache_temp_file_ = cache_file_ + ".tmp";
+			cache_writer_ = fopen(cache_temp_file_.c_str(), "wb");
+			if(cache_writer_ == nullptr) return false;
+
+			auto header = make_header();
+			if(fwrite(header.data(), sizeof(unsigned int), header.size(), cache_writer_) != header.size()){
+				fclose(cache_writer_);
+				cache_writer_ = nullptr;
+				iLogger::delete_file(cache_temp_file_);
+				return false;
+			}
+			return true;
+		}
+
+		void finish_cache(){
+
+			if(cache_writer_ == nullptr) return;
+
+			bool ok = fclose(cache_writer_) == 0;
+			cache_writer_ = nullptr;
+#if defined(U_OS_WINDOWS)
+			if(ok) ::remove(cache_file_.c_str());
+#endif
+			if(!ok || ::rename(cache_temp_file_.c_str(), cache_file_.c_str()) != 0){
+				INFOW("Save calibration tensor cache failed: %s", cache_file_.c_str());
+				iLogger::delete_file(cache_temp_file_);
+				return;
+			}
+			INFO("Save calibration tensor cache[%d batches] to: %s", num_batches_, cache_file_.c_str());
+		}
+
+	private:
+		vector<string> files_;
+		vector<int> dims_;
+		Int8Process process_;
+		int batch_size_   = 0;
+		int num_batches_  = 0;
+		size_t batch_numel_ = 0;
+		int cursor_       = 0;
+		shared_ptr<CalibrationDevice> device_;
+
+		vector<Slot> slots_;
+		vector<shared_ptr<thread>> workers_;
+		mutex lock_;
+		condition_variable cond_;
+		bool run_       = false;
+		int next_batch_ = 0;
+		int released_   = 0;
+
+		string cache_file_;
+		string cache_temp_file_;
+		uint64_t cache_key_ = 0;
+		FILE* cache_writer_ = nullptr;
+		shared_ptr<iLogger::MappedFile> cache_mapping_;
+		size_t cache_data_offset_ = 0;
+		bool from_cache_ = false;
+	};
+
+	shared_ptr<CalibrationLoader> create_calibration_loader(
+		const vector<string>& files, const vector<int>& dims, const Int8Process& process, const Int8CalibrationConfig& config,
+		shared_ptr<CalibrationDevice> device
+	){
+		shared_ptr<CalibrationLoaderImpl> instance(new CalibrationLoaderImpl());
+		if(!instance->startup(files, dims, process, config, device)){
+			instance.reset();
+		}
+		return instance;
+	}
+
+}; // namespace TRT
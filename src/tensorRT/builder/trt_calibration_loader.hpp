@@ -0,0 +1,75 @@
+
+
+#ifndef TRT_CALIBRATION_LOADER_HPP
+#define TRT_CALIBRATION_LOADER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <builder/trt_builder.hpp>
+
+namespace TRT {
+
+	/** INT8标定数据的加载
+	//   num_threads = 0（默认）时，在builder线程中同步调用Int8Process预处理
+	//   num_threads > 0时，后续的batch在线程池中调用Int8Process预处理到一组tensor（ring）中，builder线程只需要等待已经准备好的batch
+	//       每个tensor有独立的stream和workspace，Int8Process会被多个线程同时调用，只能使用传入的tensor
+	//       只有Int8Process是线程安全的（不修改捕获的状态、不是python中的函数）时才能开启
+	//   max_images > 0且图片数量超过时，按文件名的hash确定性地抽取max_images张，同样的目录每次抽到的图片相同
+	//   cache_file不为空时，预处理后的tensor保存到cache_file，下次编译时文件列表（路径和大小）、尺寸一致则直接映射cache_file，不再预处理
+	//       cache无法感知Int8Process的修改，修改预处理后请删除cache_file **/
+	struct Int8CalibrationConfig{
+		int num_threads = 0;
+		int prefetch    = 2;
+		int max_images  = 0;
+		unsigned int seed = 0;
+		std::string cache_file;
+	};
+
+	// 进程默认的配置
+	void set_int8_calibration_config(const Int8CalibrationConfig& config);
+
+	// 只对调用线程生效，优先于进程默认的配置，config为nullptr时取消。CompileService的工作线程用它应用每个任务的配置
+	void set_thread_int8_calibration_config(const Int8CalibrationConfig* config);
+
+	// 调用线程设置过配置时返回线程的配置，否则返回进程默认的配置
+	Int8CalibrationConfig get_int8_calibration_config();
+
+	// 文件名排序后抽样，max_images <= 0时只排序
+	std::vector<std::string> subsample_calibration_files(const std::vector<std::string>& files, int max_images, unsigned int seed = 0);
+
+	// 标定tensor所在的设备。默认使用创建loader时的GPU，每个tensor有独立的stream，可以替换成其他实现（例如不需要GPU的单元测试）
+	class CalibrationDevice{
+	public:
+		virtual std::shared_ptr<Tensor> create_tensor(const std::vector<int>& dims) = 0;
+
+		// 预处理线程开始时调用
+		virtual void bind_thread() = 0;
+
+		// 把预处理后的数据同步到设备上，返回时数据已经可以使用
+		virtual void upload(const std::shared_ptr<Tensor>& tensor) = 0;
+	};
+
+	std::shared_ptr<CalibrationDevice> create_default_calibration_device();
+
+	class CalibrationLoader{
+	public:
+		// 返回下一个batch，数据已经在GPU上并且同步完成，上一次返回的tensor在调用next后失效。没有数据时返回nullptr
+		virtual std::shared_ptr<Tensor> next() = 0;
+		virtual int num_batches() const = 0;
+		virtual bool from_cache() const = 0;
+	};
+
+	// dims为一个batch的尺寸，dims[0]为batch size，files的数量不足整数个batch时，多余的文件被忽略
+	// device为空时使用create_default_calibration_device()
+	std::shared_ptr<CalibrationLoader> create_calibration_loader(
+		const std::vector<std::string>& files,
+		const std::vector<int>& dims,
+		const Int8Process& process,
+		const Int8CalibrationConfig& config,
+		std::shared_ptr<CalibrationDevice> device = nullptr
+	);
+
+}; // namespace TRT
+
+#endif // TRT_CALIBRATION_LOADER_HPP
@@ -0,0 +1,329 @@
+
+#include "trt_compile_service.hpp"
+#include <common/ilogger.hpp>
+#include <common/cuda_tools.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <atomic>
+#include <stdio.h>
+
+#if defined(U_OS_LINUX)
+#	include <unistd.h>
+#elif defined(U_OS_WINDOWS)
+#	include <process.h>
+#endif
+
+namespace TRT {
+
+	using namespace std;
+
+	const char* compile_state_string(CompileState state){
+		switch(state){
+			case CompileState::Pending:   return "Pending";
+			case CompileState::Running:   return "Running";
+			case CompileState::Succeeded: return "Succeeded";
+			case CompileState::Failed:    return "Failed";
+			case CompileState::Cancelled: return "Cancelled";
+			default: return "UnknowCompileState";
+		}
+	}
+
+	class DefaultCompileBackend : public CompileBackend{
+	public:
+		virtual bool compile(const CompileJob& job, CompileOutput& output, vector<uint8_t>& timing_cache) override{
+			CUDATools::AutoDevice auto_device(job.device_id);
+
+			// hook和标定配置都是线程级的，每次都重新设置，上一个任务解析失败时留下的hook也会被覆盖
+			set_layer_hook_reshape(job.layerHookReshape);
+			set_thread_int8_calibration_config(job.int8CalibrationConfig.get());
+			bool ok = TRT::compile(
+				job.mode, job.maxBatchSize, job.source, output, job.inputsDimsSetup,
+				job.int8process, job.int8ImageDirectory, job.int8EntropyCalibratorFile, &timing_cache,
+				job.shapeBuckets
+			);
+			set_layer_hook_reshape(nullptr);
+			set_thread_int8_calibration_config(nullptr);
+			return ok;
+		}
+
+		virtual bool merge_timing_cache(vector<uint8_t>& dst, const vector<uint8_t>& src) override{
+			return TRT::merge_timing_cache(dst, src);
+		}
+	};
+
+	shared_ptr<CompileBackend> create_default_compile_backend(){
+		return make_shared<DefaultCompileBackend>();
+	}
+
+	static int current_pid(){
+#if defined(U_OS_WINDOWS)
+		return _getpid();
+#else
+		return getpid();
+#endif
+	}
+
+	// 同一个cache文件可能被多个进程或者同一进程的多个service同时保存，临时文件名用pid、线程和计数区分
+	static string unique_temp_file(const string& file){
+		static atomic<unsigned int> counter{0};
+		size_t thread_hash = hash<thread::id>()(this_thread::get_id());
+		return iLogger::format("%s.tmp.%d.%llx.%u", file.c_str(), current_pid(), (unsigned long long)thread_hash, ++counter);
+	}
+
+	class CompileTaskImpl : public CompileTask{
+	public:
+		CompileTaskImpl(const CompileJob& job)
+			:job_(job), output_(CompileOutputType::Memory){
+			future_ = promise_.get_future().share();
+		}
+
+		virtual const CompileJob& job() const override{return job_;}
+		virtual CompileState state() const override{return (CompileState)state_.load();}
+		virtual const vector<uint8_t>& data() const override{return output_.data();}
+		virtual long long time_cost() const override{return time_cost_;}
+		virtual shared_future<bool> future() const override{return future_;}
+		virtual bool wait() override{return future_.get();}
+
+		virtual void cancel() override{
+			cancelled_ = true;
+
+			// 只有Pending状态可以直接结束，Running的任务由工作线程在编译结束后处理
+			int expected = (int)CompileState::Pending;
+			if(state_.compare_exchange_strong(expected, (int)CompileState::Cancelled)){
+				if(on_finish_) on_finish_(*this);
+				promise_.set_value(false);
+			}
+		}
+
+		// 工作线程取到任务时调用，已经取消的任务返回false
+		bool begin(){
+			int expected = (int)CompileState::Pending;
+			return state_.compare_exchange_strong(expected, (int)CompileState::Running);
+		}
+
+		// 先回调再设置结果，wait返回时进度回调已经执行完
+		void finish(CompileState state){
+			state_ = (int)state;
+			if(on_finish_) on_finish_(*this);
+			promise_.set_value(state == CompileState::Succeeded);
+		}
+
+	public:
+		CompileJob job_;
+		CompileOutput output_;
+		atomic<int> state_{(int)CompileState::Pending};
+		atomic<bool> cancelled_{false};
+		long long time_cost_ = 0;
+		promise<bool> promise_;
+		shared_future<bool> future_;
+		function<void(CompileTaskImpl&)> on_finish_;
+	};
+
+	class CompileServiceImpl : public CompileService{
+	public:
+		virtual ~CompileServiceImpl(){
+			cancel_all();
+			{
+				unique_lock<mutex> l(jobs_lock_);
+				run_ = false;
+			}
+			cond_.notify_all();
+			for(auto& worker : workers_)
+				worker->join();
+
+			if(cache_dirty_)
+				save_timing_cache();
+		}
+
+		bool startup(int num_workers, const string& timing_cache_file, const CompileProgress& progress, shared_ptr<CompileBackend> backend){
+
+			if(num_workers < 1){
+				INFOE("num_workers must be greater than 0, got %d", num_workers);
+				return false;
+			}
+
+			timing_cache_file_ = timing_cache_file;
+			progress_ = progress;
+			backend_  = backend ? backend : create_default_compile_backend();
+			if(!timing_cache_file_.empty() && iLogger::exists(timing_cache_file_)){
+				timing_cache_ = iLogger::load_file(timing_cache_file_);
+				INFO("Load timing cache[%d bytes]: %s", timing_cache_.size(), timing_cache_file_.c_str());
+			}
+
+			run_ = true;
+			for(int i = 0; i < num_workers; ++i)
+				workers_.emplace_back(new thread(&CompileServiceImpl::worker, this));
+			return true;
+		}
+
+		virtual shared_ptr<CompileTask> submit(const CompileJob& job) override{
+
+			shared_ptr<CompileTaskImpl> task(new CompileTaskImpl(job));
+			if(task->job_.int8CalibrationConfig == nullptr)
+				task->job_.int8CalibrationConfig = make_shared<Int8CalibrationConfig>(get_int8_calibration_config());
+
+			task->on_finish_ = [this](CompileTaskImpl& t){notify_finish(t);};
+			{
+				unique_lock<mutex> l(jobs_lock_);
+				jobs_.push(task);
+				tasks_.emplace_back(task);
+				total_++;
+			}
+			cond_.notify_one();
+			return task;
+		}
+
+		virtual bool wait_all() override{
+
+			vector<shared_ptr<CompileTaskImpl>> tasks;
+			{
+				unique_lock<mutex> l(jobs_lock_);
+				tasks = tasks_;
+			}
+
+			bool ok = true;
+			for(auto& task : tasks)
+				ok = task->wait() && ok;
+			return ok;
+		}
+
+		virtual void cancel_all() override{
+
+			vector<shared_ptr<CompileTaskImpl>> tasks;
+			{
+				unique_lock<mutex> l(jobs_lock_);
+				tasks = tasks_;
+			}
+
+			for(auto& task : tasks)
+				task->cancel();
+		}
+
+		virtual vector<uint8_t> timing_cache() const override{
+			unique_lock<mutex> l(cache_lock_);
+			return timing_cache_;
+		}
+
+		virtual bool save_timing_cache() override{
+
+			if(timing_cache_file_.empty()) return false;
+
+			unique_lock<mutex> l(cache_lock_);
+			if(timing_cache_.empty()) return false;
+
+			// 先写临时文件再rename，其他进程不会读到写了一半的cache
+			string temp_file = unique_temp_file(timing_cache_file_);
+			if(!iLogger::save_file(temp_file, timing_cache_)){
+				INFOE("Save timing cache failed: %s", temp_file.c_str());
+				return false;
+			}
+#if defined(U_OS_WINDOWS)
+			::remove(timing_cache_file_.c_str());
+#endif
+			if(::rename(temp_file.c_str(), timing_cache_file_.c_str()) != 0){
+				INFOE("Rename %s to %s failed.", temp_file.c_str(), timing_cache_file_.c_str());
+				iLogger::delete_file(temp_file);
+				return false;
+			}
+			cache_dirty_ = false;
+			return true;
+		}
+
+	private:
+		void notify_progress(CompileTaskImpl& task, int finished){
+			if(progress_) progress_(task, finished, total_);
+		}
+
+		void notify_finish(CompileTaskImpl& task){
+			int finished = ++finished_;
+			INFO("Compile job [%s] %s, %d/%d finished", task.job_.name.c_str(), compile_state_string(task.state()), finished, total_.load());
+			notify_progress(task, finished);
+		}
+
+		void worker(){
+
+			while(true){
+				shared_ptr<CompileTaskImpl> task;
+				{
+					unique_lock<mutex> l(jobs_lock_);
+					cond_.wait(l, [&](){return !run_ || !jobs_.empty();});
+					if(!run_ && jobs_.empty()) break;
+
+					task = jobs_.front();
+					jobs_.pop();
+				}
+
+				if(!task->begin()) continue;
+				notify_progress(*task, finished_);
+				compile_task(*task);
+			}
+		}
+
+		void compile_task(CompileTaskImpl& task){
+
+			vector<uint8_t> local_cache = timing_cache();
+			auto time_start = iLogger::timestamp_now();
+			bool ok = backend_->compile(task.job_, task.output_, local_cache);
+			task.time_cost_ = iLogger::timestamp_now() - time_start;
+
+			CompileState state = ok ? CompileState::Succeeded : CompileState::Failed;
+			if(task.cancelled_){
+				state = CompileState::Cancelled;
+			}
+			else if(ok){
+				if(task.job_.saveto.type() == CompileOutputType::File){
+					ok = iLogger::save_file(task.job_.saveto.file(), task.output_.data());
+					if(!ok){
+						INFOE("Save engine failed: %s", task.job_.saveto.file().c_str());
+						state = CompileState::Failed;
+					}
+				}
+			}
+
+			// 失败或者取消的任务可能只测速了一部分，它的cache也是有效的，但这里保守起见只合并成功的
+			if(state == CompileState::Succeeded && !local_cache.empty()){
+				bool merged = false;
+				{
+					unique_lock<mutex> l(cache_lock_);
+					merged = backend_->merge_timing_cache(timing_cache_, local_cache);
+					cache_dirty_ = cache_dirty_ || merged;
+				}
+				if(!merged)
+					INFOW("Merge timing cache of [%s] failed.", task.job_.name.c_str());
+				else if(!timing_cache_file_.empty())
+					save_timing_cache();
+			}
+
+			task.finish(state);
+		}
+
+	private:
+		string timing_cache_file_;
+		CompileProgress progress_;
+		shared_ptr<CompileBackend> backend_;
+
+		vector<uint8_t> timing_cache_;
+		mutable mutex cache_lock_;
+		atomic<bool> cache_dirty_{false};
+
+		queue<shared_ptr<CompileTaskImpl>> jobs_;
+		vector<shared_ptr<CompileTaskImpl>> tasks_;
+		mutex jobs_lock_;
+		condition_variable cond_;
+		vector<shared_ptr<thread>> workers_;
+		bool run_ = false;
+		atomic<int> total_{0};
+		atomic<int> finished_{0};
+	};
+
+	shared_ptr<CompileService> create_compile_service(int num_workers, const string& timing_cache_file, const CompileProgress& progress, shared_ptr<CompileBackend> backend){
+		shared_ptr<CompileServiceImpl> instance(new CompileServiceImpl());
+		if(!instance->startup(num_workers, timing_cache_file, progress, backend)){
+			instance.reset();
+		}
+		return instance;
+	}
+
+}; // namespace TRT
@@ -0,0 +1,104 @@
+
+
+#ifndef TRT_COMPILE_SERVICE_HPP
+#define TRT_COMPILE_SERVICE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <functional>
+#include <builder/trt_builder.hpp>
+#include <builder/trt_calibration_loader.hpp>
+
+namespace TRT {
+
+	/** 多模型并行编译
+	//   submit提交的任务由num_workers个线程并行编译，每个任务返回CompileTask，可以等待、查询状态或者取消
+	//   所有任务共享一份timing cache：任务开始时取当前cache的副本，编译成功后合并回去，并写入timing_cache_file
+	//   下次启动时从timing_cache_file加载，同一设备上已经测速过的tactic不再重复测速
+	//   注意：set_layer_hook_reshape和set_thread_int8_calibration_config只对调用线程生效，工作线程看不到，
+	//   需要hook或者标定配置的任务请设置layerHookReshape和int8CalibrationConfig **/
+	struct CompileJob{
+		std::string name;
+		Mode mode = Mode::FP32;
+		unsigned int maxBatchSize = 1;
+		ModelSource source;
+		CompileOutput saveto;
+		std::vector<InputDims> inputsDimsSetup;
+		Int8Process int8process;
+		std::string int8ImageDirectory;
+		std::string int8EntropyCalibratorFile;
+		std::vector<ShapeBucket> shapeBuckets;
+		int device_id = 0;
+
+		// 只对这个任务生效的reshape hook
+		LayerHookFuncReshape layerHookReshape;
+
+		// 为空时submit会取调用线程的get_int8_calibration_config()
+		std::shared_ptr<Int8CalibrationConfig> int8CalibrationConfig;
+	};
+
+	enum class CompileState : int{
+		Pending,
+		Running,
+		Succeeded,
+		Failed,
+		Cancelled
+	};
+
+	const char* compile_state_string(CompileState state);
+
+	class CompileTask{
+	public:
+		virtual const CompileJob& job() const = 0;
+		virtual CompileState state() const = 0;
+
+		// saveto为Memory时，成功后的engine数据
+		virtual const std::vector<uint8_t>& data() const = 0;
+
+		// 编译耗时，ms
+		virtual long long time_cost() const = 0;
+
+		// 等待中的任务直接取消。TensorRT的编译无法中断，正在编译的任务会在编译结束后丢弃结果，并且不写入timing cache
+		virtual void cancel() = 0;
+
+		virtual std::shared_future<bool> future() const = 0;
+		virtual bool wait() = 0;
+	};
+
+	// 任务状态变化时调用，finished/total为已结束和已提交的任务数量。注意回调在工作线程中执行
+	typedef std::function<void(const CompileTask& task, int finished, int total)> CompileProgress;
+
+	// 实际执行编译的后端，默认调用TRT::compile，可以替换成其他实现。compile在工作线程中并发调用
+	class CompileBackend{
+	public:
+		virtual bool compile(const CompileJob& job, CompileOutput& output, std::vector<uint8_t>& timing_cache) = 0;
+		virtual bool merge_timing_cache(std::vector<uint8_t>& dst, const std::vector<uint8_t>& src) = 0;
+	};
+
+	class CompileService{
+	public:
+		virtual std::shared_ptr<CompileTask> submit(const CompileJob& job) = 0;
+
+		// 等待所有已提交的任务，全部成功时返回true
+		virtual bool wait_all() = 0;
+		virtual void cancel_all() = 0;
+
+		virtual std::vector<uint8_t> timing_cache() const = 0;
+		virtual bool save_timing_cache() = 0;
+	};
+
+	std::shared_ptr<CompileBackend> create_default_compile_backend();
+
+	// timing_cache_file为空时cache只在内存中共享，backend为空时使用create_default_compile_backend()
+	std::shared_ptr<CompileService> create_compile_service(
+		int num_workers = 2,
+		const std::string& timing_cache_file = "",
+		const CompileProgress& progress = nullptr,
+		std::shared_ptr<CompileBackend> backend = nullptr
+	);
+
+}; // namespace TRT
+
+#endif // TRT_COMPILE_SERVICE_HPP
@@ -0,0 +1,531 @@
+
+#include "trt_engine_cache.hpp"
+#include "trt_calibration_loader.hpp"
+#include <common/ilogger.hpp>
+#include <common/json.hpp>
+#include <common/cuda_tools.hpp>
+#include <NvInferVersion.h>
+#include <mutex>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#if defined(U_OS_LINUX)
+#	include <unistd.h>
+#	include <fcntl.h>
+#	include <errno.h>
+#	include <sys/file.h>
+#elif defined(U_OS_WINDOWS)
+#	include <process.h>
+#	include <Windows.h>
+#endif
+
+namespace TRT {
+
+	using namespace std;
+
+	static string hex64(uint64_t value){
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)value);
+		return buffer;
+	}
+
+	static void remove_member(Json::Value& object, const string& key){
+		Json::Value removed;
+		object.removeMember(key, &removed);
+	}
+
+	// 文件大小和纳秒精度的修改时间，同一秒内大小不变的重写也能区分
+	static bool file_stamp(const string& file, uint64_t& size, int64_t& mtime_ns){
+#if defined(U_OS_WINDOWS)
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if(!GetFileAttributesExA(file.c_str(), GetFileExInfoStandard, &attributes))
+			return false;
+
+		// FILETIME的单位是100ns
+		size     = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+		mtime_ns = (int64_t)((((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime) * 100);
+#else
+		struct stat st;
+		if(stat(file.c_str(), &st) != 0)
+			return false;
+
+		size     = st.st_size;
+		mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+		return true;
+	}
+
+	static int current_pid(){
+#if defined(U_OS_WINDOWS)
+		return _getpid();
+#else
+		return getpid();
+#endif
+	}
+
+	// 先写临时文件再rename，rename在同一个文件系统内是原子的
+	static bool atomic_save(const string& file, const void* data, size_t size){
+
+		string temp_file = iLogger::format("%s.tmp.%d", file.c_str(), current_pid());
+		if(!iLogger::save_file(temp_file, data, size)){
+			iLogger::delete_file(temp_file);
+			return false;
+		}
+
+#if defined(U_OS_WINDOWS)
+		::remove(file.c_str());
+#endif
+		if(::rename(temp_file.c_str(), file.c_str()) != 0){
+			INFOE("Rename %s to %s failed.", temp_file.c_str(), file.c_str());
+			iLogger::delete_file(temp_file);
+			return false;
+		}
+		return true;
+	}
+
+	// 跨进程的排他文件锁，析构时释放。加锁失败时只打印警告，不影响单进程使用
+	class FileLock{
+	public:
+		FileLock(const string& file){
+#if defined(U_OS_WINDOWS)
+			handle_ = CreateFileA(file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if(handle_ != INVALID_HANDLE_VALUE){
+				OVERLAPPED overlapped;
+				memset(&overlapped, 0, sizeof(overlapped));
+				locked_ = LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+			}
+#else
+			fd_ = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+			if(fd_ != -1){
+				int ret = 0;
+				do{
+					ret = ::flock(fd_, LOCK_EX);
+				}while(ret == -1 && errno == EINTR);
+				locked_ = ret == 0;
+			}
+#endif
+			if(!locked_)
+				INFOW("Lock %s failed, the engine cache is not protected against other processes.", file.c_str());
+		}
+
+		~FileLock(){
+#if defined(U_OS_WINDOWS)
+			if(handle_ != INVALID_HANDLE_VALUE){
+				if(locked_){
+					OVERLAPPED overlapped;
+					memset(&overlapped, 0, sizeof(overlapped));
+					UnlockFileEx(handle_, 0, MAXDWORD, MAXDWORD, &overlapped);
+				}
+				CloseHandle(handle_);
+			}
+#else
+			if(fd_ != -1){
+				if(locked_) ::flock(fd_, LOCK_UN);
+				::close(fd_);
+			}
+#endif
+		}
+
+	private:
+		FileLock(const FileLock&) = delete;
+		FileLock& operator = (const FileLock&) = delete;
+
+#if defined(U_OS_WINDOWS)
+		HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+		int fd_ = -1;
+#endif
+		bool locked_ = false;
+	};
+
+	// lookup只在内存中刷新访问时间，距离上次写manifest超过这个时间(ms)才顺带写入
+	static const uint64_t ACCESS_FLUSH_INTERVAL = 60 * 1000;
+
+	string current_platform(int device_id){
+		int runtime_version = 0;
+		cudaRuntimeGetVersion(&runtime_version);
+		return iLogger::format("sm%s-trt%d.%d.%d-cudart%d",
+			CUDATools::device_capability(device_id).c_str(),
+			NV_TENSORRT_MAJOR, NV_TENSORRT_MINOR, NV_TENSORRT_PATCH, runtime_version
+		);
+	}
+
+	class EngineCacheImpl : public EngineCache{
+	public:
+		virtual ~EngineCacheImpl(){
+			flush();
+		}
+
+		bool startup(const string& directory, size_t max_bytes, const string& platform){
+
+			directory_ = directory;
+			max_bytes_ = max_bytes;
+			platform_  = platform;
+			// 多个进程同时创建目录时mkdirs可能失败，目录已经存在即可
+			if(!iLogger::mkdirs(directory_) && !iLogger::exists(directory_)){
+				INFOE("Can not create engine cache directory: %s", directory_.c_str());
+				return false;
+			}
+
+			manifest_file_ = directory_ + "/manifest.json";
+			lock_file_     = directory_ + "/manifest.lock";
+
+			// 清理文件已经不存在的记录
+			std::unique_lock<mutex> l(lock_);
+			return commit_locked([&](){
+				auto& engines = manifest_["engines"];
+				for(auto& key : engines.getMemberNames()){
+					if(!iLogger::exists(file_of(key)))
+						remove_member(engines, key);
+				}
+			});
+		}
+
+		virtual const string& directory() const override{return directory_;}
+		virtual const string& platform() const override{return platform_;}
+
+		virtual string make_key(
+			const ModelSource& source, Mode mode, unsigned int maxBatchSize, const vector<InputDims>& inputsDimsSetup,
+			const string& int8ImageDirectory, const string& int8EntropyCalibratorFile
+		) override{
+
+			string stem;
+			uint64_t model_hash = 0;
+			if(source.type() == ModelSourceType::OnnX){
+				stem = iLogger::file_name(source.onnxmodel(), false);
+				if(!hash_source_file(source.onnxmodel(), model_hash))
+					return "";
+			}else{
+				stem = "data";
+				model_hash = iLogger::hash64(source.onnx_data(), source.onnx_data_size());
+			}
+
+			string config = iLogger::format("%s|%s|%u|%s", hex64(model_hash).c_str(), mode_string(mode), maxBatchSize, platform_.c_str());
+			for(auto& item : inputsDimsSetup){
+				config += "|";
+				for(auto& d : item.dims())
+					config += iLogger::format("%d,", d);
+			}
+
+			if(mode == Mode::INT8){
+				string calibration;
+				if(!make_calibration_config(int8ImageDirectory, int8EntropyCalibratorFile, calibration))
+					return "";
+				config += "|" + calibration;
+			}
+			return iLogger::format("%s-%s-%s", stem.c_str(), mode_string(mode), hex64(iLogger::hash64(config.data(), config.size())).c_str());
+		}
+
+		virtual string lookup(const string& key) override{
+
+			std::unique_lock<mutex> l(lock_);
+			string file = file_of(key);
+			auto& engines = manifest_["engines"];
+			if(!iLogger::exists(file)){
+				if(engines.isMember(key)){
+					commit_locked([&](){
+						remove_member(manifest_["engines"], key);
+					});
+				}
+				return "";
+			}
+
+			// manifest丢失或者由其他进程写入时，已存在的engine文件直接补录
+			Json::UInt64 now = iLogger::timestamp_now();
+			if(!engines.isMember(key) || !engines[key].isMember("bytes")){
+				commit_locked([&](){
+					auto& item = manifest_["engines"][key];
+					if(!item.isMember("bytes")){
+						item["bytes"] = (Json::UInt64)iLogger::file_size(file);
+						item["create_time"] = now;
+					}
+					item["last_access"] = now;
+				});
+				return file;
+			}
+
+			engines[key]["last_access"] = now;
+			pending_access_[key] = now;
+			if(now - last_commit_ >= ACCESS_FLUSH_INTERVAL)
+				commit_locked(nullptr);
+			return file;
+		}
+
+		virtual bool store(const string& key, const vector<uint8_t>& engine_data, const string& descript) override{
+
+			if(key.empty() || engine_data.empty()){
+				INFOE("Store engine failed, key or data is empty.");
+				return false;
+			}
+
+			std::unique_lock<mutex> l(lock_);
+			if(!atomic_save(file_of(key), engine_data.data(), engine_data.size()))
+				return false;
+
+			return commit_locked([&](){
+				Json::UInt64 now = iLogger::timestamp_now();
+				auto& item = manifest_["engines"][key];
+				item["bytes"] = (Json::UInt64)engine_data.size();
+				item["descript"] = descript;
+				item["create_time"] = now;
+				item["last_access"] = now;
+				evict_locked(key);
+			});
+		}
+
+		virtual bool remove(const string& key) override{
+			std::unique_lock<mutex> l(lock_);
+			bool removed = false;
+			commit_locked([&](){
+				removed = remove_locked(key);
+			});
+			return removed;
+		}
+
+		virtual int evict() override{
+			std::unique_lock<mutex> l(lock_);
+			int count = 0;
+			commit_locked([&](){
+				count = evict_locked("");
+			});
+			return count;
+		}
+
+		virtual bool flush() override{
+			std::unique_lock<mutex> l(lock_);
+			if(pending_access_.empty()) return true;
+			return commit_locked(nullptr);
+		}
+
+		virtual size_t total_bytes() const override{
+			std::unique_lock<mutex> l(lock_);
+			return total_bytes_locked();
+		}
+
+		virtual vector<EngineCacheEntry> entries() const override{
+
+			std::unique_lock<mutex> l(lock_);
+			vector<EngineCacheEntry> output;
+			auto& engines = manifest_["engines"];
+			for(auto& key : engines.getMemberNames()){
+				auto& item = engines[key];
+				EngineCacheEntry entry;
+				entry.key         = key;
+				entry.file        = file_of(key);
+				entry.descript    = item.get("descript", "").asString();
+				entry.bytes       = item.get("bytes", 0).asLargestUInt();
+				entry.create_time = item.get("create_time", 0).asLargestUInt();
+				entry.last_access = item.get("last_access", 0).asLargestUInt();
+				output.emplace_back(entry);
+			}
+
+			std::sort(output.begin(), output.end(), [](const EngineCacheEntry& a, const EngineCacheEntry& b){
+				return a.last_access > b.last_access;
+			});
+			return output;
+		}
+
+		virtual string get_or_compile(
+			Mode mode, unsigned int maxBatchSize, const ModelSource& source, const vector<InputDims>& inputsDimsSetup,
+			Int8Process int8process, const string& int8ImageDirectory, const string& int8EntropyCalibratorFile
+		) override{
+
+			string key = make_key(source, mode, maxBatchSize, inputsDimsSetup, int8ImageDirectory, int8EntropyCalibratorFile);
+			if(key.empty()) return "";
+
+			string file = lookup(key);
+			if(!file.empty()){
+				INFO("Engine cache hit: %s", file.c_str());
+				return file;
+			}
+
+			INFO("Engine cache miss, compile %s", key.c_str());
+			CompileOutput output(CompileOutputType::Memory);
+			if(!compile(mode, maxBatchSize, source, output, inputsDimsSetup, int8process, int8ImageDirectory, int8EntropyCalibratorFile))
+				return "";
+
+			// INT8编译后会写出entropy文件，下一次的key由entropy文件的内容决定，按新的key保存
+			if(mode == Mode::INT8 && !int8EntropyCalibratorFile.empty()){
+				key = make_key(source, mode, maxBatchSize, inputsDimsSetup, int8ImageDirectory, int8EntropyCalibratorFile);
+				if(key.empty()) return "";
+			}
+
+			string descript = iLogger::format("%s, %s, max batch %u", source.descript().c_str(), mode_string(mode), maxBatchSize);
+			if(!store(key, output.data(), descript))
+				return "";
+			return file_of(key);
+		}
+
+	private:
+		string file_of(const string& key) const{
+			return directory_ + "/" + key + ".trtmodel";
+		}
+
+		// 与TRT::compile选择标定数据的方式一致：entropy文件存在时只由它的内容决定，否则由抽样后的图片列表（路径、大小、修改时间）决定
+		// Int8Process无法hash，修改预处理后需要删除对应的engine
+		bool make_calibration_config(const string& int8ImageDirectory, const string& int8EntropyCalibratorFile, string& config){
+
+			if(!int8EntropyCalibratorFile.empty() && iLogger::exists(int8EntropyCalibratorFile)){
+				uint64_t entropy_hash = 0;
+				if(!hash_source_file(int8EntropyCalibratorFile, entropy_hash))
+					return false;
+
+				config = "entropy:" + hex64(entropy_hash);
+				return true;
+			}
+
+			auto calibration_config = get_int8_calibration_config();
+			auto files = iLogger::find_files(int8ImageDirectory, "*.jpg;*.png;*.bmp;*.jpeg;*.tiff");
+			files = subsample_calibration_files(files, calibration_config.max_images, calibration_config.seed);
+
+			string listing = iLogger::format("%d|%u", calibration_config.max_images, calibration_config.seed);
+			for(auto& file : files){
+				uint64_t size = 0;
+				int64_t mtime_ns = 0;
+				file_stamp(file, size, mtime_ns);
+				listing += iLogger::format("|%s,%llu,%lld", file.c_str(), (unsigned long long)size, (long long)mtime_ns);
+			}
+			config = "images:" + hex64(iLogger::hash64(listing.data(), listing.size()));
+			return true;
+		}
+
+		bool hash_source_file(const string& file, uint64_t& hash){
+
+			uint64_t size = 0;
+			int64_t mtime_ns = 0;
+			if(!file_stamp(file, size, mtime_ns)){
+				INFOE("Can not stat file: %s", file.c_str());
+				return false;
+			}
+
+			// 旧版本的manifest没有mtime_ns，会重新计算一次
+			std::unique_lock<mutex> l(lock_);
+			auto& sources = manifest_["sources"];
+			if(sources.isMember(file)){
+				auto& item = sources[file];
+				if(item.get("size", 0).asLargestUInt() == size && item.isMember("mtime_ns") && item["mtime_ns"].asLargestInt() == mtime_ns){
+					hash = strtoull(item.get("hash", "0").asCString(), nullptr, 16);
+					return true;
+				}
+			}
+
+			auto mapping = iLogger::map_file(file);
+			if(mapping == nullptr){
+				INFOE("Can not open file: %s", file.c_str());
+				return false;
+			}
+
+			hash = iLogger::hash64(mapping->data(), mapping->size());
+			commit_locked([&](){
+				auto& item = manifest_["sources"][file];
+				remove_member(item, "mtime");
+				item["size"]     = (Json::UInt64)size;
+				item["mtime_ns"] = (Json::Int64)mtime_ns;
+				item["hash"]     = hex64(hash);
+			});
+			return true;
+		}
+
+		bool remove_locked(const string& key){
+			if(!manifest_["engines"].isMember(key)) return false;
+			remove_member(manifest_["engines"], key);
+			iLogger::delete_file(file_of(key));
+			return true;
+		}
+
+		size_t total_bytes_locked() const{
+			size_t total = 0;
+			auto& engines = manifest_["engines"];
+			for(auto& key : engines.getMemberNames())
+				total += engines[key].get("bytes", 0).asLargestUInt();
+			return total;
+		}
+
+		// keep为刚写入的engine，不会被淘汰
+		int evict_locked(const string& keep){
+
+			if(max_bytes_ == 0) return 0;
+
+			size_t total = total_bytes_locked();
+			auto& engines = manifest_["engines"];
+			vector<pair<uint64_t, string>> order;
+			for(auto& key : engines.getMemberNames()){
+				if(key != keep)
+					order.emplace_back(engines[key].get("last_access", 0).asLargestUInt(), key);
+			}
+			std::sort(order.begin(), order.end());
+
+			int count = 0;
+			for(auto& item : order){
+				if(total <= max_bytes_) break;
+
+				total -= engines[item.second].get("bytes", 0).asLargestUInt();
+				INFO("Evict engine %s", item.second.c_str());
+				remove_locked(item.second);
+				count++;
+			}
+			return count;
+		}
+
+		void load_manifest(){
+
+			manifest_ = Json::Value(Json::objectValue);
+			if(iLogger::exists(manifest_file_)){
+				manifest_ = Json::parse_file(manifest_file_);
+				if(!manifest_.isObject()){
+					INFOW("Engine cache manifest %s is broken, reset it.", manifest_file_.c_str());
+					manifest_ = Json::Value(Json::objectValue);
+				}
+			}
+			manifest_["version"] = 1;
+		}
+
+		/* 多个进程可以共享同一个缓存目录，manifest的修改都在文件锁内完成：
+		   重新读取磁盘上的manifest，合并延迟的访问时间，再执行modify并写回，不会覆盖其他进程的记录 */
+		bool commit_locked(const function<void()>& modify){
+
+			FileLock file_lock(lock_file_);
+			load_manifest();
+
+			auto& engines = manifest_["engines"];
+			for(auto& item : pending_access_){
+				if(!engines.isMember(item.first)) continue;
+
+				auto& entry = engines[item.first];
+				if(entry.get("last_access", 0).asLargestUInt() < item.second)
+					entry["last_access"] = (Json::UInt64)item.second;
+			}
+			pending_access_.clear();
+
+			if(modify) modify();
+			last_commit_ = iLogger::timestamp_now();
+
+			string data = manifest_.toStyledString();
+			return atomic_save(manifest_file_, data.data(), data.size());
+		}
+
+	private:
+		string directory_;
+		string platform_;
+		string manifest_file_;
+		string lock_file_;
+		size_t max_bytes_ = 0;
+		uint64_t last_commit_ = 0;
+		map<string, uint64_t> pending_access_;
+		Json::Value manifest_{Json::objectValue};
+		mutable mutex lock_;
+	};
+
+	shared_ptr<EngineCache> create_engine_cache(const string& directory, size_t max_bytes, const string& platform){
+		shared_ptr<EngineCacheImpl> instance(new EngineCacheImpl());
+		if(!instance->startup(directory, max_bytes, platform.empty() ? current_platform() : platform)){
+			instance.reset();
+		}
+		return instance;
+	}
+
+}; // namespace TRT
@@ -0,0 +1,76 @@
+
+
+#ifndef TRT_ENGINE_CACHE_HPP
+#define TRT_ENGINE_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <builder/trt_builder.hpp>
+
+namespace TRT {
+
+	/** engine缓存
+	//   key由onnx内容的hash、Mode、maxBatchSize、InputDims、INT8的标定数据以及platform（设备算力、TensorRT/CUDA版本）共同决定
+	//   onnx修改、换GPU、升级TensorRT后key都会变化，旧的engine不会被误用
+	//   engine文件写入时先写临时文件再rename，保证不会读到写了一半的文件
+	//   directory下的manifest.json记录每个engine的大小、访问时间等信息，超出max_bytes时按LRU淘汰
+	//   lookup只在内存中刷新访问时间，在下一次写manifest、flush或析构时合并写入
+	//   manifest的读-改-写都在manifest.lock的文件锁内完成，多个进程可以共享同一个directory **/
+	struct EngineCacheEntry{
+		std::string key;
+		std::string file;
+		std::string descript;
+		size_t bytes = 0;
+		uint64_t create_time = 0;   // ms
+		uint64_t last_access = 0;
+	};
+
+	class EngineCache{
+	public:
+		virtual const std::string& directory() const = 0;
+		virtual const std::string& platform() const = 0;
+
+		// source为文件时，hash按(路径、大小、纳秒精度的修改时间)缓存在manifest中，未修改的onnx不会重复计算
+		// INT8时key还包含标定数据：entropy文件存在时为它的内容，否则为抽样后的图片列表。Int8Process的修改无法感知
+		virtual std::string make_key(
+			const ModelSource& source, Mode mode, unsigned int maxBatchSize,
+			const std::vector<InputDims>& inputsDimsSetup = {},
+			const std::string& int8ImageDirectory = "",
+			const std::string& int8EntropyCalibratorFile = ""
+		) = 0;
+
+		// 命中时刷新访问时间，返回engine文件路径，否则返回空字符串
+		virtual std::string lookup(const std::string& key) = 0;
+		virtual bool store(const std::string& key, const std::vector<uint8_t>& engine_data, const std::string& descript = "") = 0;
+		virtual bool remove(const std::string& key) = 0;
+
+		// 淘汰最久未访问的engine，直到总大小不超过max_bytes，返回淘汰的数量
+		virtual int evict() = 0;
+
+		// 把lookup延迟的访问时间写入manifest
+		virtual bool flush() = 0;
+		virtual size_t total_bytes() const = 0;
+		virtual std::vector<EngineCacheEntry> entries() const = 0;
+
+		// 缓存命中直接返回路径，否则调用TRT::compile编译并写入缓存，失败返回空字符串
+		virtual std::string get_or_compile(
+			Mode mode,
+			unsigned int maxBatchSize,
+			const ModelSource& source,
+			const std::vector<InputDims>& inputsDimsSetup = {},
+			Int8Process int8process = nullptr,
+			const std::string& int8ImageDirectory = "",
+			const std::string& int8EntropyCalibratorFile = ""
+		) = 0;
+	};
+
+	// 设备算力以及TensorRT、CUDA的版本，例如 sm8.6-trt8.0.1-cudart10020
+	std::string current_platform(int device_id = 0);
+
+	// max_bytes = 0 时不限制大小，platform为空时使用current_platform()
+	std::shared_ptr<EngineCache> create_engine_cache(const std::string& directory, size_t max_bytes = 0, const std::string& platform = "");
+
+}; // namespace TRT
+
+#endif // TRT_ENGINE_CACHE_HPP
@@ -35,6 +35,8 @@
 #	include <sys/types.h>
 #	include <sys/stat.h>
 #	include <unistd.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
 #   include <stdarg.h>
 #	define strtok_s  strtok_r
 #endif
@@ -626,6 +628,107 @@ namespace iLogger{
         return data;
     }
 
+    MappedFile::~MappedFile(){
+        close();
+    }
+
+    bool MappedFile::open(const string& file){
+
+        close();
+#if defined(U_OS_LINUX)
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if(fd == -1)
+            return false;
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size == 0){
+            ::close(fd);
+            return false;
+        }
+
+        // 映射建立后文件描述符可以直接关闭
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if(ptr == MAP_FAILED)
+            return false;
+
+        data_ = ptr;
+        size_ = st.st_size;
+#elif defined(U_OS_WINDOWS)
+        HANDLE hfile = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(hfile == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER length;
+        if(!GetFileSizeEx(hfile, &length) || length.QuadPart == 0){
+            CloseHandle(hfile);
+            return false;
+        }
+
+        HANDLE hmapping = CreateFileMappingA(hfile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(hmapping == nullptr){
+            CloseHandle(hfile);
+            return false;
+        }
+
+        void* ptr = MapViewOfFile(hmapping, FILE_MAP_READ, 0, 0, 0);
+        if(ptr == nullptr){
+            CloseHandle(hmapping);
+            CloseHandle(hfile);
+            return false;
+        }
+
+        data_           = ptr;
+        size_           = length.QuadPart;
+        file_handle_    = hfile;
+        mapping_handle_ = hmapping;
+#endif
+        file_ = file;
+        return true;
+    }
+
+    void MappedFile::close(){
+
+        if(data_ == nullptr) return;
+#if defined(U_OS_LINUX)
+        munmap(data_, size_);
+#elif defined(U_OS_WINDOWS)
+        UnmapViewOfFile(data_);
+        CloseHandle((HANDLE)mapping_handle_);
+        CloseHandle((HANDLE)file_handle_);
+        mapping_handle_ = nullptr;
+        file_handle_    = nullptr;
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        file_.clear();
+    }
+
+    bool MappedFile::advise(MapAdvice advice) const{
+
+        if(data_ == nullptr) return false;
+#if defined(U_OS_LINUX)
+        int flag = MADV_NORMAL;
+        switch(advice){
+            case MapAdvice::Sequential: flag = MADV_SEQUENTIAL; break;
+            case MapAdvice::WillNeed:   flag = MADV_WILLNEED;   break;
+            case MapAdvice::DontNeed:   flag = MADV_DONTNEED;   break;
+            default: break;
+        }
+        return madvise(data_, size_, flag) == 0;
+#else
+        return true;
+#endif
+    }
+
+    shared_ptr<MappedFile> map_file(const string& file){
+        shared_ptr<MappedFile> output(new MappedFile());
+        if(!output->open(file))
+            output.reset();
+        return output;
+    }
+
     bool alphabet_equal(char a, char b, bool ignore_case){
         if (ignore_case){
             a = a > 'a' and a < 'z' ? a - 'a' + 'A' : a;
@@ -1079,6 +1182,36 @@ namespace iLogger{
         return encode_result;
     }
 
+    uint64_t hash64(const void* data, size_t size, uint64_t seed){
+
+        const uint64_t m = 0xc6a4a7935bd1e995ULL;
+        const int r = 47;
+        uint64_t h = seed ^ (size * m);
+
+        const uint8_t* p = (const uint8_t*)data;
+        const uint8_t* end = p + (size / 8) * 8;
+        for(; p != end; p += 8){
+            uint64_t k;
+            memcpy(&k, p, 8);
+            k *= m; k ^= k >> r; k *= m;
+            h ^= k; h *= m;
+        }
+
+        switch(size & 7){
+            case 7: h ^= uint64_t(p[6]) << 48;
+            case 6: h ^= uint64_t(p[5]) << 40;
+            case 5: h ^= uint64_t(p[4]) << 32;
+            case 4: h ^= uint64_t(p[3]) << 24;
+            case 3: h ^= uint64_t(p[2]) << 16;
+            case 2: h ^= uint64_t(p[1]) << 8;
+            case 1: h ^= uint64_t(p[0]);
+                h *= m;
+        };
+
+        h ^= h >> r; h *= m; h ^= h >> r;
+        return h;
+    }
+
     bool delete_file(const string& path){
 #ifdef U_OS_WINDOWS
 		return DeleteFileA(path.c_str());
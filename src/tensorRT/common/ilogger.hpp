@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <memory>
 #include <time.h>
 
 
@@ -60,6 +61,45 @@ namespace iLogger{
     string load_text_file(const string& file);
     size_t file_size(const string& file);
 
+    // 映射区域的访问方式提示（madvise），Windows下没有对应的实现，会被忽略
+    enum class MapAdvice : int{
+        Normal     = 0,
+        Sequential = 1,     // 顺序读取，内核加大预读
+        WillNeed   = 2,     // 马上要使用，提前异步读入
+        DontNeed   = 3      // 暂时不再使用，释放已经读入的页，再次访问时重新从文件读取，对data的修改会丢失
+    };
+
+    // 文件的内存映射，析构时自动解除映射
+    // 映射是只读的（PROT_READ），需要修改数据时先复制，直接写入data会导致访问错误
+    class MappedFile{
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator = (const MappedFile&) = delete;
+        ~MappedFile();
+
+        bool open(const string& file);
+        void close();
+        bool advise(MapAdvice advice) const;
+
+        void* data() const{return data_;}
+        size_t size() const{return size_;}
+        bool empty() const{return data_ == nullptr;}
+        const string& file() const{return file_;}
+
+    private:
+        void* data_  = nullptr;
+        size_t size_ = 0;
+        string file_;
+#if defined(U_OS_WINDOWS)
+        void* file_handle_    = nullptr;
+        void* mapping_handle_ = nullptr;
+#endif
+    };
+
+    // 映射失败返回nullptr
+    shared_ptr<MappedFile> map_file(const string& file);
+
     bool begin_with(const string& str, const string& with);
 	bool end_with(const string& str, const string& with);
     vector<string> split_string(const string& str, const std::string& spstr);
@@ -98,6 +138,9 @@ namespace iLogger{
     string base64_decode(const string& base64);
     string base64_encode(const void* data, size_t size);
 
+    // MurmurHash64A，结果与平台无关，可以用于缓存的key
+    uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
     inline int upbound(int n, int align = 32){return (n + align - 1) / align * align;}
     string join_dims(const vector<int64_t>& dims);
 };
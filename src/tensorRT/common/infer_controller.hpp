@@ -109,7 +109,24 @@ public:
 protected:
     virtual void worker(std::promise<bool>& result) = 0;
     virtual bool preprocess(Job& job, const Input& input) = 0;
+
+    // engine有多个optimization profile时，返回job所属的bucket（通常是TRT::select_profile的结果）
+    // get_jobs_and_wait只把同一个bucket的job组成一个batch，返回-1表示不区分
+    virtual int job_bucket(const Job& job){
+        return -1;
+    }
     
+    // forward失败（例如没有profile能容纳输入的尺寸）时，job返回空的结果，不能解码输出tensor中上一次推理留下的数据
+    void fail_jobs(std::vector<Job>& jobs){
+        for(auto& job : jobs){
+            if(job.mono_tensor)
+                job.mono_tensor->release();
+            if(job.pro)
+                job.pro->set_value(Output());
+        }
+        jobs.clear();
+    }
+
     virtual bool get_jobs_and_wait(std::vector<Job>& fetch_jobs, int max_size){
 
         std::unique_lock<std::mutex> l(jobs_lock_);
@@ -120,10 +137,26 @@ protected:
         if(!run_) return false;
         
         fetch_jobs.clear();
-        for(int i = 0; i < max_size && !jobs_.empty(); ++i){
-            fetch_jobs.emplace_back(std::move(jobs_.front()));
+        int bucket = job_bucket(jobs_.front());
+        if(bucket == -1){
+            for(int i = 0; i < max_size && !jobs_.empty(); ++i){
+                fetch_jobs.emplace_back(std::move(jobs_.front()));
+                jobs_.pop();
+            }
+            return true;
+        }
+
+        // 取出与第一个job同一个bucket的job，其余的按原来的顺序留在队列中
+        std::queue<Job> others;
+        while(!jobs_.empty()){
+            auto& job = jobs_.front();
+            if((int)fetch_jobs.size() < max_size && job_bucket(job) == bucket)
+                fetch_jobs.emplace_back(std::move(job));
+            else
+                others.emplace(std::move(job));
             jobs_.pop();
         }
+        std::swap(jobs_, others);
         return true;
     }
 
@@ -0,0 +1,777 @@
+
+#include "json_fast.hpp"
+#include "ilogger.hpp"
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace FastJson{
+
+    using namespace std;
+
+    static const int MAX_DEPTH = 512;
+    static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+    static const double exact_pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    static const uint64_t integer_pow10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull
+    };
+
+    static inline bool is_digit(char c){
+        return c >= '0' && c <= '9';
+    }
+
+    static inline int hex_value(char c){
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static char* encode_utf8(char* output, uint32_t code){
+        if(code < 0x80){
+            *output++ = code;
+        }else if(code < 0x800){
+            *output++ = 0xC0 | (code >> 6);
+            *output++ = 0x80 | (code & 0x3F);
+        }else if(code < 0x10000){
+            *output++ = 0xE0 | (code >> 12);
+            *output++ = 0x80 | ((code >> 6) & 0x3F);
+            *output++ = 0x80 | (code & 0x3F);
+        }else{
+            *output++ = 0xF0 | (code >> 18);
+            *output++ = 0x80 | ((code >> 12) & 0x3F);
+            *output++ = 0x80 | ((code >> 6) & 0x3F);
+            *output++ = 0x80 | (code & 0x3F);
+        }
+        return output;
+    }
+
+    // 递归下降解析，_Handler可以是虚接口Handler，也可以是DocumentBuilder（没有虚函数调用的开销）
+    template<typename _Handler>
+    class Parser{
+    public:
+        Parser(char* buffer, size_t size, _Handler& handler)
+        :begin_(buffer), p_(buffer), end_(buffer + size), handler_(handler){}
+
+        bool run(string* error){
+            skip_whitespace();
+            if(!parse_value(0) || !(skip_whitespace(), p_ == end_ || fail("unexpected trailing characters"))){
+                if(error) *error = error_;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        inline char peek() const{
+            return p_ < end_ ? *p_ : 0;
+        }
+
+        inline void skip_whitespace(){
+            while(p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+                ++p_;
+        }
+
+        bool fail(const char* message){
+            if(error_.empty())
+                error_ = iLogger::format("%s at offset %d", message, (int)(p_ - begin_));
+            return false;
+        }
+
+        bool parse_value(int depth){
+
+            switch(peek()){
+                case '{': return parse_object(depth);
+                case '[': return parse_array(depth);
+                case '"': {
+                    const char* str = nullptr;
+                    size_t length   = 0;
+                    if(!parse_string(str, length)) return false;
+                    return handler_.string(str, length) || fail("terminated by handler");
+                }
+                case 't': return parse_literal("true", 4)  && (handler_.boolean(true)  || fail("terminated by handler"));
+                case 'f': return parse_literal("false", 5) && (handler_.boolean(false) || fail("terminated by handler"));
+                case 'n': return parse_literal("null", 4)  && (handler_.null()         || fail("terminated by handler"));
+                case 0:   return fail("unexpected end of input");
+                default:  return parse_number();
+            }
+        }
+
+        bool parse_literal(const char* literal, size_t length){
+            if((size_t)(end_ - p_) < length || memcmp(p_, literal, length) != 0)
+                return fail("invalid literal");
+            p_ += length;
+            return true;
+        }
+
+        bool parse_object(int depth){
+
+            if(depth >= MAX_DEPTH) return fail("nesting too deep");
+            ++p_;
+            if(!handler_.start_object()) return fail("terminated by handler");
+
+            skip_whitespace();
+            size_t num_members = 0;
+            if(peek() == '}'){
+                ++p_;
+                return handler_.end_object(0) || fail("terminated by handler");
+            }
+
+            while(true){
+                if(peek() != '"') return fail("expect member name");
+
+                const char* name = nullptr;
+                size_t length    = 0;
+                if(!parse_string(name, length)) return false;
+                if(!handler_.key(name, length)) return fail("terminated by handler");
+
+                skip_whitespace();
+                if(peek() != ':') return fail("expect ':'");
+                ++p_;
+                skip_whitespace();
+
+                if(!parse_value(depth + 1)) return false;
+                ++num_members;
+
+                skip_whitespace();
+                char c = peek();
+                if(c == ','){
+                    ++p_;
+                    skip_whitespace();
+                }else if(c == '}'){
+                    ++p_;
+                    return handler_.end_object(num_members) || fail("terminated by handler");
+                }else{
+                    return fail("expect ',' or '}'");
+                }
+            }
+        }
+
+        bool parse_array(int depth){
+
+            if(depth >= MAX_DEPTH) return fail("nesting too deep");
+            ++p_;
+            if(!handler_.start_array()) return fail("terminated by handler");
+
+            skip_whitespace();
+            size_t num_elements = 0;
+            if(peek() == ']'){
+                ++p_;
+                return handler_.end_array(0) || fail("terminated by handler");
+            }
+
+            while(true){
+                if(!parse_value(depth + 1)) return false;
+                ++num_elements;
+
+                skip_whitespace();
+                char c = peek();
+                if(c == ','){
+                    ++p_;
+                    skip_whitespace();
+                }else if(c == ']'){
+                    ++p_;
+                    return handler_.end_array(num_elements) || fail("terminated by handler");
+                }else{
+                    return fail("expect ',' or ']'");
+                }
+            }
+        }
+
+        bool parse_hex4(uint32_t& code){
+            if(end_ - p_ < 4) return fail("invalid unicode escape");
+
+            code = 0;
+            for(int i = 0; i < 4; ++i){
+                int v = hex_value(p_[i]);
+                if(v < 0) return fail("invalid unicode escape");
+                code = (code << 4) | v;
+            }
+            p_ += 4;
+            return true;
+        }
+
+        // 反转义后的长度不超过原来的长度，直接写回输入缓冲区，并把结尾的引号（或之前的位置）改为0
+        bool parse_string(const char*& str, size_t& length){
+
+            ++p_;
+            char* start = p_;
+            while(p_ < end_){
+                unsigned char c = *p_;
+                if(c == '"' || c == '\\' || c < 0x20) break;
+                ++p_;
+            }
+
+            char* output = p_;
+            while(true){
+                if(p_ >= end_) return fail("unterminated string");
+
+                char c = *p_;
+                if(c == '"'){
+                    *output = 0;
+                    str     = start;
+                    length  = output - start;
+                    ++p_;
+                    return true;
+                }
+
+                if(c == '\\'){
+                    ++p_;
+                    if(p_ >= end_) return fail("unterminated string");
+
+                    char e = *p_++;
+                    switch(e){
+                        case '"':  *output++ = '"';  break;
+                        case '\\': *output++ = '\\'; break;
+                        case '/':  *output++ = '/';  break;
+                        case 'b':  *output++ = '\b'; break;
+                        case 'f':  *output++ = '\f'; break;
+                        case 'n':  *output++ = '\n'; break;
+                        case 'r':  *output++ = '\r'; break;
+                        case 't':  *output++ = '\t'; break;
+                        case 'u': {
+                            uint32_t code = 0;
+                            if(!parse_hex4(code)) return false;
+
+                            if(code >= 0xD800 && code <= 0xDBFF){
+                                uint32_t low = 0;
+                                if(end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u') return fail("invalid surrogate pair");
+                                p_ += 2;
+                                if(!parse_hex4(low)) return false;
+                                if(low < 0xDC00 || low > 0xDFFF) return fail("invalid surrogate pair");
+                                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            }else if(code >= 0xDC00 && code <= 0xDFFF){
+                                return fail("invalid surrogate pair");
+                            }
+                            output = encode_utf8(output, code);
+                            break;
+                        }
+                        default:
+                            --p_;
+                            return fail("invalid escape");
+                    }
+                    continue;
+                }
+
+                if((unsigned char)c < 0x20) return fail("control character in string");
+                *output++ = c;
+                ++p_;
+            }
+        }
+
+        bool parse_number(){
+
+            const char* start = p_;
+            bool negative = false;
+            if(peek() == '-'){
+                negative = true;
+                ++p_;
+            }
+
+            uint64_t mantissa = 0;
+            int num_digits    = 0;
+            int exponent      = 0;
+            bool truncated    = false;
+            bool is_integer   = true;
+
+            if(peek() == '0'){
+                ++p_;
+            }else if(is_digit(peek())){
+                while(p_ < end_ && is_digit(*p_)){
+                    if(num_digits < 19){
+                        mantissa = mantissa * 10 + (*p_ - '0');
+                        num_digits++;
+                    }else{
+                        truncated = true;
+                    }
+                    ++p_;
+                }
+            }else{
+                return fail("invalid value");
+            }
+
+            if(peek() == '.'){
+                is_integer = false;
+                ++p_;
+                if(!is_digit(peek())) return fail("invalid number");
+
+                while(p_ < end_ && is_digit(*p_)){
+                    if(num_digits < 19){
+                        mantissa = mantissa * 10 + (*p_ - '0');
+                        if(mantissa != 0) num_digits++;
+                        exponent--;
+                    }else{
+                        truncated = true;
+                    }
+                    ++p_;
+                }
+            }
+
+            char c = peek();
+            if(c == 'e' || c == 'E'){
+                is_integer = false;
+                ++p_;
+
+                bool negative_exponent = false;
+                if(peek() == '+' || peek() == '-'){
+                    negative_exponent = peek() == '-';
+                    ++p_;
+                }
+                if(!is_digit(peek())) return fail("invalid number");
+
+                int value = 0;
+                while(p_ < end_ && is_digit(*p_)){
+                    if(value < 100000) value = value * 10 + (*p_ - '0');
+                    ++p_;
+                }
+                exponent += negative_exponent ? -value : value;
+            }
+
+            double number   = 0;
+            int64_t integer = 0;
+            if(is_integer && !truncated && mantissa <= (uint64_t)INT64_MAX){
+                integer = negative ? -(int64_t)mantissa : (int64_t)mantissa;
+                number  = (double)integer;
+            }else if(!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22){
+                // 尾数和10的幂都可以精确表示为double，一次乘除的结果是正确舍入的
+                is_integer = false;
+                number = (double)mantissa;
+                number = exponent < 0 ? number / exact_pow10[-exponent] : number * exact_pow10[exponent];
+                if(negative) number = -number;
+            }else{
+                // 有效数字太多或者指数太大时使用strtod，输入缓冲区不一定以0结尾，需要复制
+                is_integer = false;
+                string text(start, p_ - start);
+                number = strtod(text.c_str(), nullptr);
+            }
+
+            return handler_.number(number, integer, is_integer) || fail("terminated by handler");
+        }
+
+    private:
+        const char* begin_ = nullptr;
+        char* p_           = nullptr;
+        const char* end_   = nullptr;
+        _Handler& handler_;
+        string error_;
+    };
+
+    bool parse_sax(char* buffer, size_t size, Handler& handler, string* error){
+        Parser<Handler> parser(buffer, size, handler);
+        return parser.run(error);
+    }
+
+    // 把SAX事件转换为Document中连续存放的节点，子节点紧跟在父节点之后（前序）
+    class DocumentBuilder{
+    public:
+        DocumentBuilder(Document& doc):nodes_(doc.nodes_), stack_(doc.stack_){
+            nodes_.clear();
+            stack_.clear();
+        }
+
+        bool null()                   {add(Type::Null); return true;}
+        bool boolean(bool value)      {add(value ? Type::True : Type::False); return true;}
+        bool number(double value, int64_t integer, bool is_integer){
+            auto& node      = add(Type::Number);
+            node.number     = value;
+            node.integer    = integer;
+            node.is_integer = is_integer;
+            return true;
+        }
+
+        bool string(const char* str, size_t length){
+            auto& node = add(Type::String);
+            node.str   = str;
+            node.size  = length;
+            return true;
+        }
+
+        bool key(const char* str, size_t length){
+            name_        = str;
+            name_length_ = length;
+            return true;
+        }
+
+        bool start_object()                {return start(Type::Object);}
+        bool end_object(size_t num_members){return end(num_members);}
+        bool start_array()                 {return start(Type::Array);}
+        bool end_array(size_t num_elements){return end(num_elements);}
+
+    private:
+        Document::Node& add(Type type){
+            nodes_.emplace_back();
+            auto& node  = nodes_.back();
+            node.type   = type;
+            node.end    = nodes_.size();
+            node.parent = stack_.empty() ? NO_PARENT : stack_.back();
+            if(name_){
+                node.name        = name_;
+                node.name_length = name_length_;
+                name_            = nullptr;
+            }
+            return node;
+        }
+
+        bool start(Type type){
+            uint32_t index = nodes_.size();
+            add(type);
+            stack_.push_back(index);
+            return true;
+        }
+
+        bool end(size_t num_children){
+            uint32_t index     = stack_.back();
+            stack_.pop_back();
+            nodes_[index].size = num_children;
+            nodes_[index].end  = nodes_.size();
+            return true;
+        }
+
+    private:
+        vector<Document::Node>& nodes_;
+        vector<uint32_t>& stack_;
+        const char* name_   = nullptr;
+        size_t name_length_ = 0;
+    };
+
+    bool Document::parse_insitu(char* buffer, size_t size){
+
+        error_.clear();
+        DocumentBuilder builder(*this);
+        Parser<DocumentBuilder> parser(buffer, size, builder);
+        if(!parser.run(&error_)){
+            nodes_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool Document::parse(const char* data, size_t size){
+        buffer_.resize(size + 1);
+        memcpy(buffer_.data(), data, size);
+        buffer_[size] = 0;
+        return parse_insitu(buffer_.data(), size);
+    }
+
+    bool Document::parse_file(const string& file){
+
+        FILE* f = fopen(file.c_str(), "rb");
+        if(f == nullptr){
+            error_ = iLogger::format("Open %s failed", file.c_str());
+            nodes_.clear();
+            return false;
+        }
+
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        buffer_.resize(size > 0 ? size + 1 : 1);
+        size_t nread = size > 0 ? fread(buffer_.data(), 1, size, f) : 0;
+        fclose(f);
+
+        buffer_[nread] = 0;
+        return parse_insitu(buffer_.data(), nread);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    Type Value::type() const{
+        return doc_ ? doc_->nodes_[index_].type : Type::Null;
+    }
+
+    size_t Value::size() const{
+        if(!doc_) return 0;
+
+        auto& node = doc_->nodes_[index_];
+        if(node.type == Type::Array || node.type == Type::Object || node.type == Type::String)
+            return node.size;
+        return 0;
+    }
+
+    Value Value::operator[](int index) const{
+        if(!is_array() || index < 0 || index >= (int)size())
+            return Value();
+
+        auto& nodes    = doc_->nodes_;
+        uint32_t child = index_ + 1;
+        for(int i = 0; i < index; ++i)
+            child = nodes[child].end;
+        return Value(doc_, child);
+    }
+
+    Value Value::operator[](const char* name) const{
+        if(!is_object()) return Value();
+
+        auto& nodes    = doc_->nodes_;
+        size_t length  = strlen(name);
+        uint32_t child = index_ + 1;
+        for(uint32_t i = 0; i < nodes[index_].size; ++i){
+            auto& node = nodes[child];
+            if(node.name_length == length && memcmp(node.name, name, length) == 0)
+                return Value(doc_, child);
+            child = node.end;
+        }
+        return Value();
+    }
+
+    Value Value::first_child() const{
+        if((!is_array() && !is_object()) || size() == 0)
+            return Value();
+        return Value(doc_, index_ + 1);
+    }
+
+    Value Value::next() const{
+        if(!doc_) return Value();
+
+        auto& nodes = doc_->nodes_;
+        auto& node  = nodes[index_];
+        if(node.parent == NO_PARENT || node.end >= nodes[node.parent].end)
+            return Value();
+        return Value(doc_, node.end);
+    }
+
+    const char* Value::name() const{
+        if(!doc_ || doc_->nodes_[index_].name == nullptr) return "";
+        return doc_->nodes_[index_].name;
+    }
+
+    bool Value::as_bool(bool default_value) const{
+        auto t = type();
+        if(t == Type::True)  return true;
+        if(t == Type::False) return false;
+        return default_value;
+    }
+
+    // 超出范围的数值截断到最大、最小值
+    int Value::as_int(int default_value) const{
+        int64_t value = as_int64(default_value);
+        return (int)std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, value));
+    }
+
+    int64_t Value::as_int64(int64_t default_value) const{
+        if(!is_number()) return default_value;
+
+        auto& node = doc_->nodes_[index_];
+        if(node.is_integer) return node.integer;
+
+        // 浮点数转换超出范围是未定义行为，先检查NaN和范围。2^63可以用double精确表示
+        double number = node.number;
+        if(std::isnan(number))                  return default_value;
+        if(number >= 9223372036854775808.0)     return INT64_MAX;
+        if(number <= -9223372036854775808.0)    return INT64_MIN;
+        return (int64_t)number;
+    }
+
+    float Value::as_float(float default_value) const{
+        return (float)as_double(default_value);
+    }
+
+    double Value::as_double(double default_value) const{
+        if(!is_number()) return default_value;
+        return doc_->nodes_[index_].number;
+    }
+
+    const char* Value::as_cstr(const char* default_value) const{
+        if(!is_string()) return default_value;
+        return doc_->nodes_[index_].str;
+    }
+
+    string Value::as_string(const string& default_value) const{
+        if(!is_string()) return default_value;
+
+        auto& node = doc_->nodes_[index_];
+        return string(node.str, node.size);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    static inline char* write_uint64(char* end, uint64_t value){
+        do{
+            *--end = '0' + value % 10;
+            value /= 10;
+        }while(value);
+        return end;
+    }
+
+    void Writer::clear(){
+        buffer_.clear();
+        depth_      = 0;
+        need_comma_ = false;
+    }
+
+    void Writer::prefix(){
+        if(need_comma_)
+            buffer_.push_back(',');
+    }
+
+    Writer& Writer::begin_object(){
+        prefix();
+        buffer_.push_back('{');
+        depth_++;
+        need_comma_ = false;
+        return *this;
+    }
+
+    Writer& Writer::end_object(){
+        buffer_.push_back('}');
+        depth_--;
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::begin_array(){
+        prefix();
+        buffer_.push_back('[');
+        depth_++;
+        need_comma_ = false;
+        return *this;
+    }
+
+    Writer& Writer::end_array(){
+        buffer_.push_back(']');
+        depth_--;
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::key(const char* name, size_t length){
+        prefix();
+        write_string(name, length);
+        buffer_.push_back(':');
+        need_comma_ = false;
+        return *this;
+    }
+
+    Writer& Writer::null(){
+        prefix();
+        buffer_.append("null", 4);
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::value(bool v){
+        prefix();
+        if(v) buffer_.append("true", 4);
+        else  buffer_.append("false", 5);
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::value(int64_t v){
+        prefix();
+        char text[24];
+        char* end   = text + sizeof(text);
+        uint64_t u  = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+        char* begin = write_uint64(end, u);
+        if(v < 0) *--begin = '-';
+        buffer_.append(begin, end - begin);
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::value(uint64_t v){
+        prefix();
+        char text[24];
+        char* end   = text + sizeof(text);
+        char* begin = write_uint64(end, v);
+        buffer_.append(begin, end - begin);
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::value(double v, int decimals){
+
+        // json没有inf、nan，与Json::FastWriter不同，这里写为null保证输出总是合法的json
+        if(!std::isfinite(v))
+            return null();
+
+        prefix();
+        need_comma_ = true;
+        if(decimals >= 0){
+            decimals = std::min(decimals, 9);
+            double scaled = std::fabs(v) * integer_pow10[decimals];
+            if(scaled < 9e18){
+                uint64_t rounded  = (uint64_t)(scaled + 0.5);
+                uint64_t integral = rounded / integer_pow10[decimals];
+                uint64_t fraction = rounded % integer_pow10[decimals];
+
+                char text[48];
+                char* end = text + sizeof(text);
+                char* p   = end;
+                if(fraction != 0){
+                    int width = decimals;
+                    while(fraction % 10 == 0){
+                        fraction /= 10;
+                        width--;
+                    }
+                    char* digits = write_uint64(end, fraction);
+                    p = digits;
+                    for(int i = end - digits; i < width; ++i)
+                        *--p = '0';
+                    *--p = '.';
+                }
+                p = write_uint64(p, integral);
+                if(v < 0 && rounded != 0) *--p = '-';
+                buffer_.append(p, end - p);
+                return *this;
+            }
+            decimals = -17;
+        }
+
+        char text[32];
+        int n = snprintf(text, sizeof(text), "%.*g", -decimals, v);
+        buffer_.append(text, n);
+        return *this;
+    }
+
+    Writer& Writer::value(const char* v, size_t length){
+        prefix();
+        write_string(v, length);
+        need_comma_ = true;
+        return *this;
+    }
+
+    Writer& Writer::raw(const char* json, size_t length){
+        prefix();
+        buffer_.append(json, length);
+        need_comma_ = true;
+        return *this;
+    }
+
+    void Writer::write_string(const char* str, size_t length){
+
+        static const char hex[] = "0123456789abcdef";
+        buffer_.push_back('"');
+
+        const char* run = str;
+        const char* end = str + length;
+        for(const char* p = str; p < end; ++p){
+            unsigned char c = *p;
+            if(c >= 0x20 && c != '"' && c != '\\')
+                continue;
+
+            buffer_.append(run, p - run);
+            run = p + 1;
+            switch(c){
+                case '"':  buffer_.append("\\\"", 2); break;
+                case '\\': buffer_.append("\\\\", 2); break;
+                case '\n': buffer_.append("\\n", 2);  break;
+                case '\r': buffer_.append("\\r", 2);  break;
+                case '\t': buffer_.append("\\t", 2);  break;
+                case '\b': buffer_.append("\\b", 2);  break;
+                case '\f': buffer_.append("\\f", 2);  break;
+                default: {
+                    char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                    buffer_.append(escaped, 6);
+                    break;
+                }
+            }
+        }
+        buffer_.append(run, end - run);
+        buffer_.push_back('"');
+    }
+};
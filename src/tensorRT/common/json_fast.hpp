@@ -0,0 +1,197 @@
+#ifndef JSON_FAST_HPP
+#define JSON_FAST_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+/* 与Json::Value并存的高吞吐json层，用于每帧的结果导出、大的标注/配置文件读取
+   Reader：就地（in-situ）解析，字符串直接在输入缓冲区中反转义并以0结尾，不为每个值分配内存
+           Document把所有节点保存在一个连续的数组中，重复解析时复用内存
+   Writer：流式写入到可复用的std::string，不构建树 */
+namespace FastJson{
+
+    enum class Type : uint8_t{
+        Null   = 0,
+        False  = 1,
+        True   = 2,
+        Number = 3,
+        String = 4,
+        Array  = 5,
+        Object = 6
+    };
+
+    // SAX接口，返回false时终止解析。str、key指向就地反转义后的缓冲区，以0结尾，length不包含结尾的0
+    class Handler{
+    public:
+        virtual bool null() = 0;
+        virtual bool boolean(bool value) = 0;
+        virtual bool number(double value, int64_t integer, bool is_integer) = 0;
+        virtual bool string(const char* str, size_t length) = 0;
+        virtual bool key(const char* str, size_t length) = 0;
+        virtual bool start_object() = 0;
+        virtual bool end_object(size_t num_members) = 0;
+        virtual bool start_array() = 0;
+        virtual bool end_array(size_t num_elements) = 0;
+    };
+
+    // buffer在解析时被修改。error不为空时保存错误信息（包含出错的位置）
+    bool parse_sax(char* buffer, size_t size, Handler& handler, std::string* error = nullptr);
+
+    class Document;
+
+    // 指向Document中节点的轻量引用，Document析构或者重新解析后失效
+    // 不存在的成员、越界的下标得到的Value，valid()为false，as_xxx返回默认值
+    class Value{
+    public:
+        Value() = default;
+
+        bool valid()     const{return doc_ != nullptr;}
+        Type type()      const;
+        bool is_null()   const{return type() == Type::Null;}
+        bool is_bool()   const{return type() == Type::True || type() == Type::False;}
+        bool is_number() const{return type() == Type::Number;}
+        bool is_string() const{return type() == Type::String;}
+        bool is_array()  const{return type() == Type::Array;}
+        bool is_object() const{return type() == Type::Object;}
+
+        // 数组的元素个数、对象的成员个数、字符串的长度
+        size_t size() const;
+
+        // 按下标、名字查找都是线性的，遍历时使用first_child/next
+        Value operator[](int index) const;
+        Value operator[](const char* name) const;
+        Value operator[](const std::string& name) const{return (*this)[name.c_str()];}
+        bool has_member(const char* name) const{return (*this)[name].valid();}
+
+        Value first_child() const;
+        Value next() const;
+        const char* name() const;       // 对象成员的名字，其它情况为空字符串
+
+        // 数值超出整数的范围时截断到最大、最小值，NaN返回default_value
+        bool as_bool(bool default_value = false) const;
+        int as_int(int default_value = 0) const;
+        int64_t as_int64(int64_t default_value = 0) const;
+        float as_float(float default_value = 0) const;
+        double as_double(double default_value = 0) const;
+        const char* as_cstr(const char* default_value = "") const;
+        std::string as_string(const std::string& default_value = "") const;
+
+    private:
+        friend class Document;
+        Value(const Document* doc, uint32_t index):doc_(doc), index_(index){}
+
+        const Document* doc_ = nullptr;
+        uint32_t index_ = 0;
+    };
+
+    class Document{
+    public:
+        // buffer在解析时被修改，Document使用期间buffer必须有效
+        bool parse_insitu(char* buffer, size_t size);
+
+        // 复制到内部的缓冲区后就地解析，缓冲区在多次解析之间复用
+        bool parse(const char* data, size_t size);
+        bool parse(const std::string& text){return parse(text.data(), text.size());}
+        bool parse_file(const std::string& file);
+
+        Value root() const{return nodes_.empty() ? Value() : Value(this, 0);}
+        const std::string& error() const{return error_;}
+        size_t num_nodes() const{return nodes_.size();}
+
+    private:
+        friend class Value;
+        friend class DocumentBuilder;
+
+        struct Node{
+            Type type       = Type::Null;
+            bool is_integer = false;
+            uint32_t size   = 0;        // 子节点个数或者字符串长度
+            uint32_t end    = 0;        // 子树结束的位置，下一个兄弟节点的下标
+            uint32_t parent = 0;
+            uint32_t name_length = 0;
+            const char* name     = nullptr;
+            union{
+                double number;
+                const char* str;
+            };
+            int64_t integer = 0;
+
+            Node(){number = 0;}
+        };
+
+        std::vector<Node> nodes_;
+        std::vector<uint32_t> stack_;
+        std::vector<char> buffer_;
+        std::string error_;
+    };
+
+    class Writer{
+    public:
+        // decimals < 0时浮点数保留17位有效数字（与Json::FastWriter一致），否则保留decimals位小数并去掉末尾的0
+        Writer(int decimals = -1):decimals_(decimals){}
+
+        // 清空内容，保留已经分配的内存
+        void clear();
+        void reserve(size_t bytes){buffer_.reserve(bytes);}
+
+        Writer& begin_object();
+        Writer& end_object();
+        Writer& begin_array();
+        Writer& end_array();
+
+        Writer& key(const char* name, size_t length);
+        Writer& key(const char* name){return key(name, strlen(name));}
+        Writer& key(const std::string& name){return key(name.data(), name.size());}
+
+        Writer& null();
+        Writer& value(bool v);
+        Writer& value(int v){return value((int64_t)v);}
+        Writer& value(unsigned int v){return value((uint64_t)v);}
+        Writer& value(int64_t v);
+        Writer& value(uint64_t v);
+        Writer& value(float v){return decimals_ < 0 ? value(v, -9) : value((double)v, decimals_);}
+        Writer& value(double v){return value(v, decimals_ < 0 ? -17 : decimals_);}
+        Writer& value(const char* v, size_t length);
+        Writer& value(const char* v){return value(v, strlen(v));}
+        Writer& value(const std::string& v){return value(v.data(), v.size());}
+
+        // decimals >= 0时保留decimals位小数，< 0时保留-decimals位有效数字
+        Writer& value(double v, int decimals);
+
+        // 直接写入已经序列化好的json
+        Writer& raw(const char* json, size_t length);
+
+        template<typename _T>
+        Writer& member(const char* name, const _T& v){
+            key(name);
+            return value(v);
+        }
+
+        Writer& member(const char* name, double v, int decimals){
+            key(name);
+            return value(v, decimals);
+        }
+
+        const std::string& str() const{return buffer_;}
+        std::string& buffer(){return buffer_;}
+        const char* data() const{return buffer_.data();}
+        size_t size() const{return buffer_.size();}
+
+        // 所有的对象、数组都已经结束
+        bool complete() const{return depth_ == 0 && !buffer_.empty();}
+
+    private:
+        void prefix();
+        void write_string(const char* str, size_t length);
+
+        std::string buffer_;
+        int decimals_   = -1;
+        int depth_      = 0;
+        bool need_comma_ = false;
+    };
+};
+
+#endif // JSON_FAST_HPP
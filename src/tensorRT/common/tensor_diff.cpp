@@ -0,0 +1,543 @@
+
+#include "tensor_diff.hpp"
+#include "json_fast.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TENSOR_DIFF_SSE2
+#endif
+
+namespace TensorDiff{
+
+    using namespace std;
+
+    static const unsigned int TENSOR_MAGIC = 0xFCCFE2E2;
+    static const size_t CHUNK_SIZE = 16384;
+
+    // float16转float的查找表，不依赖CUDA的__half2float
+    static const float* half_table(){
+
+        static vector<float> table = [](){
+            vector<float> output(65536);
+            for(uint32_t h = 0; h < 65536; ++h){
+                uint32_t sign     = (h & 0x8000) << 16;
+                uint32_t exponent = (h >> 10) & 0x1F;
+                uint32_t mantissa = h & 0x3FF;
+                uint32_t bits     = 0;
+                if(exponent == 0){
+                    if(mantissa == 0){
+                        bits = sign;
+                    }else{
+                        // 非规格化数，规格化到float
+                        exponent = 127 - 15 + 1;
+                        while((mantissa & 0x400) == 0){
+                            mantissa <<= 1;
+                            exponent--;
+                        }
+                        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+                    }
+                }else if(exponent == 31){
+                    bits = sign | 0x7F800000 | (mantissa << 13);
+                }else{
+                    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+                }
+                memcpy(&output[h], &bits, sizeof(bits));
+            }
+            return output;
+        }();
+        return table.data();
+    }
+
+    static int element_size(DataType dtype){
+        return dtype == DataType::Float16 ? 2 : 4;
+    }
+
+    bool load_tensor(const string& file, TensorFile& tensor, string* error){
+
+        auto fail = [&](const string& message){
+            if(error) *error = message;
+            return false;
+        };
+
+        auto mapped = iLogger::map_file(file);
+        if(mapped == nullptr)
+            return fail(iLogger::format("Open %s failed", file.c_str()));
+
+        const unsigned int* head = (const unsigned int*)mapped->data();
+        size_t size = mapped->size();
+        if(size < sizeof(unsigned int) * 3 || head[0] != TENSOR_MAGIC)
+            return fail(iLogger::format("%s is not a tensor file", file.c_str()));
+
+        unsigned int ndims = head[1];
+        unsigned int dtype = head[2];
+        size_t header_bytes = sizeof(unsigned int) * (3 + (size_t)ndims);
+        if(ndims > 16 || size < header_bytes)
+            return fail(iLogger::format("%s has invalid ndims %d", file.c_str(), ndims));
+
+        if(dtype != (int)DataType::Float && dtype != (int)DataType::Float16)
+            return fail(iLogger::format("%s has unsupported dtype %d", file.c_str(), dtype));
+
+        const int* dims = (const int*)(head + 3);
+        size_t numel    = 1;
+        for(unsigned int i = 0; i < ndims; ++i){
+            if(dims[i] < 0)
+                return fail(iLogger::format("%s has invalid dims", file.c_str()));
+            numel *= dims[i];
+        }
+
+        if(size != header_bytes + numel * element_size((DataType)dtype))
+            return fail(iLogger::format("%s size %lld does not match shape", file.c_str(), (long long)size));
+
+        mapped->advise(iLogger::MapAdvice::Sequential);
+        tensor.file  = mapped;
+        tensor.dims  = vector<int>(dims, dims + ndims);
+        tensor.dtype = (DataType)dtype;
+        tensor.data  = (const char*)mapped->data() + header_bytes;
+        tensor.numel = numel;
+        return true;
+    }
+
+    // 一段数据的统计，分段统计后合并
+    struct Accumulator{
+        double sum_abs = 0;
+        double sum_sq  = 0;
+        double dot     = 0;
+        double norm_a  = 0;
+        double norm_b  = 0;
+        float max_abs  = -1;
+        size_t max_index    = 0;
+        size_t num_mismatch = 0;
+        size_t num_nan      = 0;
+        int topk = 0;
+        vector<Mismatch> heap;      // 最小堆，堆顶是topk中误差最小的
+
+        static bool greater(const Mismatch& x, const Mismatch& y){
+            return x.abs_error > y.abs_error;
+        }
+
+        // 误差超过这个值时才需要更新max_abs或者topk，误差为0的位置不进入topk
+        inline float threshold() const{
+            if(topk <= 0) return max_abs;
+            return (int)heap.size() < topk ? std::min(0.0f, max_abs) : heap.front().abs_error;
+        }
+
+        void update(size_t index, float a, float b, float abs_error){
+
+            if(abs_error > max_abs){
+                max_abs   = abs_error;
+                max_index = index;
+            }
+
+            if(topk <= 0 || abs_error <= 0) return;
+            if((int)heap.size() < topk){
+                heap.emplace_back(index, a, b, abs_error);
+                push_heap(heap.begin(), heap.end(), greater);
+            }else if(abs_error > heap.front().abs_error){
+                pop_heap(heap.begin(), heap.end(), greater);
+                heap.back() = Mismatch(index, a, b, abs_error);
+                push_heap(heap.begin(), heap.end(), greater);
+            }
+        }
+
+        inline void accumulate_one(size_t index, float a, float b, float atol, float rtol){
+
+            if(!std::isfinite(a) || !std::isfinite(b)){
+                num_nan++;
+                num_mismatch++;
+                return;
+            }
+
+            float abs_error = std::fabs(a - b);
+            sum_abs += abs_error;
+            sum_sq  += (double)abs_error * abs_error;
+            dot     += (double)a * b;
+            norm_a  += (double)a * a;
+            norm_b  += (double)b * b;
+            if(abs_error > atol + rtol * std::fabs(b))
+                num_mismatch++;
+
+            if(abs_error > threshold())
+                update(index, a, b, abs_error);
+        }
+
+        void merge(const Accumulator& other){
+            sum_abs      += other.sum_abs;
+            sum_sq       += other.sum_sq;
+            dot          += other.dot;
+            norm_a       += other.norm_a;
+            norm_b       += other.norm_b;
+            num_mismatch += other.num_mismatch;
+            num_nan      += other.num_nan;
+            if(other.max_abs > max_abs){
+                max_abs   = other.max_abs;
+                max_index = other.max_index;
+            }
+
+            for(auto& item : other.heap){
+                if(item.abs_error > threshold() || (int)heap.size() < topk)
+                    update(item.index, item.a, item.b, item.abs_error);
+            }
+        }
+    };
+
+    static void accumulate(Accumulator& acc, const float* a, const float* b, size_t n, size_t offset, float atol, float rtol){
+
+        size_t i = 0;
+#ifdef TENSOR_DIFF_SSE2
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 inf      = _mm_set1_ps(INFINITY);
+        const __m128 vatol    = _mm_set1_ps(atol);
+        const __m128 vrtol    = _mm_set1_ps(rtol);
+        __m128d sum_abs = _mm_setzero_pd(), sum_sq = _mm_setzero_pd(), dot = _mm_setzero_pd();
+        __m128d norm_a  = _mm_setzero_pd(), norm_b = _mm_setzero_pd();
+
+        for(; i + 4 <= n; i += 4){
+            __m128 va  = _mm_loadu_ps(a + i);
+            __m128 vb  = _mm_loadu_ps(b + i);
+            __m128 aba = _mm_and_ps(va, abs_mask);
+            __m128 abb = _mm_and_ps(vb, abs_mask);
+
+            // nan、inf很少见，整组交给标量处理
+            __m128 finite = _mm_and_ps(_mm_cmplt_ps(aba, inf), _mm_cmplt_ps(abb, inf));
+            if(_mm_movemask_ps(finite) != 0xF){
+                for(int k = 0; k < 4; ++k)
+                    acc.accumulate_one(offset + i + k, a[i + k], b[i + k], atol, rtol);
+                continue;
+            }
+
+            __m128 d = _mm_and_ps(_mm_sub_ps(va, vb), abs_mask);
+
+            // 累加使用double，避免大张量的精度损失
+            __m128d d_lo = _mm_cvtps_pd(d);
+            __m128d d_hi = _mm_cvtps_pd(_mm_movehl_ps(d, d));
+            __m128d a_lo = _mm_cvtps_pd(va);
+            __m128d a_hi = _mm_cvtps_pd(_mm_movehl_ps(va, va));
+            __m128d b_lo = _mm_cvtps_pd(vb);
+            __m128d b_hi = _mm_cvtps_pd(_mm_movehl_ps(vb, vb));
+            sum_abs = _mm_add_pd(sum_abs, _mm_add_pd(d_lo, d_hi));
+            sum_sq  = _mm_add_pd(sum_sq,  _mm_add_pd(_mm_mul_pd(d_lo, d_lo), _mm_mul_pd(d_hi, d_hi)));
+            dot     = _mm_add_pd(dot,     _mm_add_pd(_mm_mul_pd(a_lo, b_lo), _mm_mul_pd(a_hi, b_hi)));
+            norm_a  = _mm_add_pd(norm_a,  _mm_add_pd(_mm_mul_pd(a_lo, a_lo), _mm_mul_pd(a_hi, a_hi)));
+            norm_b  = _mm_add_pd(norm_b,  _mm_add_pd(_mm_mul_pd(b_lo, b_lo), _mm_mul_pd(b_hi, b_hi)));
+
+            __m128 tolerance = _mm_add_ps(vatol, _mm_mul_ps(vrtol, abb));
+            acc.num_mismatch += __builtin_popcount(_mm_movemask_ps(_mm_cmpgt_ps(d, tolerance)));
+
+            int update_mask = _mm_movemask_ps(_mm_cmpgt_ps(d, _mm_set1_ps(acc.threshold())));
+            if(update_mask){
+                float errors[4];
+                _mm_storeu_ps(errors, d);
+                for(int k = 0; k < 4; ++k){
+                    if((update_mask & (1 << k)) && errors[k] > acc.threshold())
+                        acc.update(offset + i + k, a[i + k], b[i + k], errors[k]);
+                }
+            }
+        }
+
+        double values[2];
+        _mm_storeu_pd(values, sum_abs); acc.sum_abs += values[0] + values[1];
+        _mm_storeu_pd(values, sum_sq);  acc.sum_sq  += values[0] + values[1];
+        _mm_storeu_pd(values, dot);     acc.dot     += values[0] + values[1];
+        _mm_storeu_pd(values, norm_a);  acc.norm_a  += values[0] + values[1];
+        _mm_storeu_pd(values, norm_b);  acc.norm_b  += values[0] + values[1];
+#endif
+
+        for(; i < n; ++i)
+            acc.accumulate_one(offset + i, a[i], b[i], atol, rtol);
+    }
+
+    // 返回[begin, end)的float指针，float16时转换到buffer中
+    static const float* as_float(const void* data, DataType dtype, size_t begin, size_t end, vector<float>& buffer){
+
+        if(dtype == DataType::Float)
+            return (const float*)data + begin;
+
+        const float* table    = half_table();
+        const uint16_t* input = (const uint16_t*)data + begin;
+        buffer.resize(end - begin);
+        for(size_t i = 0; i < end - begin; ++i)
+            buffer[i] = table[input[i]];
+        return buffer.data();
+    }
+
+    static void accumulate_range(Accumulator& acc, const void* a, DataType a_type, const void* b, DataType b_type, size_t begin, size_t end, const Config& config){
+
+        vector<float> buffer_a, buffer_b;
+        for(size_t chunk = begin; chunk < end; chunk += CHUNK_SIZE){
+            size_t chunk_end = std::min(end, chunk + CHUNK_SIZE);
+            const float* pa  = as_float(a, a_type, chunk, chunk_end, buffer_a);
+            const float* pb  = as_float(b, b_type, chunk, chunk_end, buffer_b);
+            accumulate(acc, pa, pb, chunk_end - chunk, chunk, config.atol, config.rtol);
+        }
+    }
+
+    static int resolve_threads(int num_threads){
+        if(num_threads > 0) return num_threads;
+        return std::max(1, (int)thread::hardware_concurrency());
+    }
+
+    static void evaluate(Result& result, const Config& config){
+        result.pass =
+            result.error.empty() && result.num_nan == 0 &&
+            (config.max_abs_error < 0 || result.max_abs_error <= config.max_abs_error) &&
+            (config.min_cosine < 0 || result.cosine >= config.min_cosine) &&
+            (config.max_mismatch_rate < 0 || result.mismatch_rate() <= config.max_mismatch_rate);
+    }
+
+    Result compare(const void* a, DataType a_type, const void* b, DataType b_type, size_t numel, const Config& config, int num_threads){
+
+        // 每个线程至少处理1M个元素，小张量不值得开线程
+        size_t min_per_thread = 1 << 20;
+        num_threads = std::max(1, std::min(num_threads, (int)((numel + min_per_thread - 1) / min_per_thread)));
+
+        vector<Accumulator> accs(num_threads);
+        for(auto& acc : accs)
+            acc.topk = config.topk;
+
+        size_t per_thread = (numel + num_threads - 1) / num_threads;
+        if(num_threads == 1){
+            accumulate_range(accs[0], a, a_type, b, b_type, 0, numel, config);
+        }else{
+            vector<thread> threads;
+            for(int i = 0; i < num_threads; ++i){
+                size_t begin = std::min(numel, i * per_thread);
+                size_t end   = std::min(numel, begin + per_thread);
+                threads.emplace_back(accumulate_range, ref(accs[i]), a, a_type, b, b_type, begin, end, cref(config));
+            }
+            for(auto& t : threads)
+                t.join();
+        }
+
+        auto& acc = accs[0];
+        for(int i = 1; i < num_threads; ++i)
+            acc.merge(accs[i]);
+
+        Result result;
+        result.numel        = numel;
+        result.num_mismatch = acc.num_mismatch;
+        result.num_nan      = acc.num_nan;
+
+        size_t num_valid = numel - acc.num_nan;
+        if(num_valid > 0){
+            result.max_abs_error  = std::max(0.0f, acc.max_abs);
+            result.max_index      = acc.max_index;
+            result.mean_abs_error = acc.sum_abs / num_valid;
+            result.rmse           = std::sqrt(acc.sum_sq / num_valid);
+        }
+
+        // 两边都是0向量时认为相同
+        if(acc.norm_a == 0 && acc.norm_b == 0)
+            result.cosine = 1;
+        else if(acc.norm_a == 0 || acc.norm_b == 0)
+            result.cosine = 0;
+        else
+            result.cosine = acc.dot / std::sqrt(acc.norm_a * acc.norm_b);
+
+        result.topk = acc.heap;
+        std::sort(result.topk.begin(), result.topk.end(), Accumulator::greater);
+        evaluate(result, config);
+        return result;
+    }
+
+    static Result compare_files_impl(const string& file_a, const string& file_b, const Config& config, int num_threads){
+
+        Result result;
+        TensorFile a, b;
+        if(!load_tensor(file_a, a, &result.error) || !load_tensor(file_b, b, &result.error)){
+            result.file_a = file_a;
+            result.file_b = file_b;
+            return result;
+        }
+
+        if(a.dims != b.dims){
+            result.file_a = file_a;
+            result.file_b = file_b;
+            result.dims   = a.dims;
+            result.error  = iLogger::format("Shape mismatch, %s vs %s", shape_string(a.dims).c_str(), shape_string(b.dims).c_str());
+            return result;
+        }
+
+        result        = compare(a.data, a.dtype, b.data, b.dtype, a.numel, config, num_threads);
+        result.file_a = file_a;
+        result.file_b = file_b;
+        result.dims   = a.dims;
+        return result;
+    }
+
+    Result compare_files(const string& file_a, const string& file_b, const Config& config){
+        auto result = compare_files_impl(file_a, file_b, config, resolve_threads(config.num_threads));
+        result.name = iLogger::file_name(file_a);
+        return result;
+    }
+
+    static string with_slash(const string& directory){
+        if(directory.empty()) return "./";
+        char back = directory.back();
+        return back == '/' || back == '\\' ? directory : directory + "/";
+    }
+
+    vector<Result> compare_directories(const string& dir_a, const string& dir_b, const Config& config, const string& filter){
+
+        string prefix_a = with_slash(dir_a);
+        string prefix_b = with_slash(dir_b);
+        auto files_a = iLogger::find_files(prefix_a, filter, false, true);
+        auto files_b = iLogger::find_files(prefix_b, filter, false, true);
+
+        vector<string> names_a, names_b;
+        for(auto& file : files_a) names_a.emplace_back(file.substr(prefix_a.size()));
+        for(auto& file : files_b) names_b.emplace_back(file.substr(prefix_b.size()));
+        std::sort(names_a.begin(), names_a.end());
+        std::sort(names_b.begin(), names_b.end());
+
+        vector<string> names;
+        std::set_union(names_a.begin(), names_a.end(), names_b.begin(), names_b.end(), back_inserter(names));
+
+        vector<Result> results(names.size());
+        atomic<int> next_index{0};
+        auto worker = [&](){
+            int index = 0;
+            while((index = next_index++) < (int)names.size()){
+                auto& name   = names[index];
+                auto& result = results[index];
+                bool in_a = binary_search(names_a.begin(), names_a.end(), name);
+                bool in_b = binary_search(names_b.begin(), names_b.end(), name);
+                if(in_a && in_b){
+                    // 文件之间已经并行，每个文件只用一个线程
+                    result = compare_files_impl(prefix_a + name, prefix_b + name, config, 1);
+                }else{
+                    result.file_a = in_a ? prefix_a + name : "";
+                    result.file_b = in_b ? prefix_b + name : "";
+                    result.error  = iLogger::format("Only in %s", in_a ? dir_a.c_str() : dir_b.c_str());
+                }
+                result.name = name;
+            }
+        };
+
+        int num_threads = std::min(resolve_threads(config.num_threads), std::max(1, (int)names.size()));
+        vector<thread> threads;
+        for(int i = 0; i < num_threads; ++i)
+            threads.emplace_back(worker);
+
+        for(auto& t : threads)
+            t.join();
+        return results;
+    }
+
+    string shape_string(const vector<int>& dims){
+        string output;
+        for(size_t i = 0; i < dims.size(); ++i)
+            output += iLogger::format(i == 0 ? "%d" : "x%d", dims[i]);
+        return output.empty() ? "scalar" : output;
+    }
+
+    string index_string(size_t index, const vector<int>& dims){
+
+        vector<int> coords(dims.size());
+        for(int i = (int)dims.size() - 1; i >= 0; --i){
+            if(dims[i] <= 0) break;
+            coords[i] = index % dims[i];
+            index    /= dims[i];
+        }
+
+        string output = "[";
+        for(size_t i = 0; i < coords.size(); ++i)
+            output += iLogger::format(i == 0 ? "%d" : ",%d", coords[i]);
+        return output + "]";
+    }
+
+    string summary(const vector<Result>& results, bool show_topk){
+
+        string output = iLogger::format(
+            "%s%s%s%s%s%s%s\n",
+            iLogger::align_blank("name", 36).c_str(), iLogger::align_blank("shape", 20).c_str(),
+            iLogger::align_blank("max_abs", 12).c_str(), iLogger::align_blank("mean_abs", 12).c_str(),
+            iLogger::align_blank("cosine", 12).c_str(), iLogger::align_blank("mismatch", 20).c_str(), "result"
+        );
+
+        int num_pass = 0;
+        for(auto& result : results){
+            num_pass += result.pass;
+            if(!result.error.empty()){
+                output += iLogger::format("%s%s\n", iLogger::align_blank(result.name, 36).c_str(), result.error.c_str());
+                continue;
+            }
+
+            string mismatch = iLogger::format("%lld (%.3f%%)", (long long)result.num_mismatch, result.mismatch_rate() * 100);
+            output += iLogger::format(
+                "%s%s%s%s%s%s%s\n",
+                iLogger::align_blank(result.name, 36).c_str(), iLogger::align_blank(shape_string(result.dims), 20).c_str(),
+                iLogger::align_blank(iLogger::format("%.4e", result.max_abs_error), 12).c_str(),
+                iLogger::align_blank(iLogger::format("%.4e", result.mean_abs_error), 12).c_str(),
+                iLogger::align_blank(iLogger::format("%.6f", result.cosine), 12).c_str(),
+                iLogger::align_blank(mismatch, 20).c_str(), result.pass ? "PASS" : "FAIL"
+            );
+
+            if(result.num_nan > 0)
+                output += iLogger::format("    %lld nan/inf\n", (long long)result.num_nan);
+
+            if(show_topk && !result.pass){
+                for(auto& item : result.topk){
+                    output += iLogger::format(
+                        "    %s a = %g, b = %g, |a - b| = %g\n",
+                        index_string(item.index, result.dims).c_str(), item.a, item.b, item.abs_error
+                    );
+                }
+            }
+        }
+        output += iLogger::format("%d files, %d passed, %d failed", (int)results.size(), num_pass, (int)results.size() - num_pass);
+        return output;
+    }
+
+    string to_json(const vector<Result>& results){
+
+        FastJson::Writer writer;
+        writer.begin_object();
+        writer.key("results").begin_array();
+        for(auto& result : results){
+            writer.begin_object();
+            writer.member("name",   result.name);
+            writer.member("file_a", result.file_a);
+            writer.member("file_b", result.file_b);
+            writer.member("pass",   result.pass);
+            if(!result.error.empty()){
+                writer.member("error", result.error);
+                writer.end_object();
+                continue;
+            }
+
+            writer.key("dims").begin_array();
+            for(auto d : result.dims)
+                writer.value(d);
+            writer.end_array();
+
+            writer.member("numel",          (uint64_t)result.numel);
+            writer.member("max_abs_error",  result.max_abs_error);
+            writer.member("max_index",      index_string(result.max_index, result.dims));
+            writer.member("mean_abs_error", result.mean_abs_error);
+            writer.member("rmse",           result.rmse);
+            writer.member("cosine",         result.cosine);
+            writer.member("num_mismatch",   (uint64_t)result.num_mismatch);
+            writer.member("num_nan",        (uint64_t)result.num_nan);
+
+            writer.key("topk").begin_array();
+            for(auto& item : result.topk){
+                writer.begin_object();
+                writer.member("index",     index_string(item.index, result.dims));
+                writer.member("a",         item.a);
+                writer.member("b",         item.b);
+                writer.member("abs_error", item.abs_error);
+                writer.end_object();
+            }
+            writer.end_array();
+            writer.end_object();
+        }
+        writer.end_array();
+        writer.end_object();
+        return writer.str();
+    }
+};
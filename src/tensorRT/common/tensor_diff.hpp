@@ -0,0 +1,87 @@
+#ifndef TENSOR_DIFF_HPP
+#define TENSOR_DIFF_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "ilogger.hpp"
+
+/* 比较Tensor::save_to_file保存的张量，例如FP16/INT8引擎与FP32引擎的输出
+   文件通过mmap读取，误差统计使用SSE2，多个文件由多个线程并行比较，只使用CPU，不需要CUDA
+   文件格式：uint32 magic(0xFCCFE2E2)、ndims、dtype，ndims个int32的维度，然后是数据 */
+namespace TensorDiff{
+
+    enum class DataType : int{
+        Float   = 0,        // 与TRT::DataType一致
+        Float16 = 1
+    };
+
+    struct TensorFile{
+        std::shared_ptr<iLogger::MappedFile> file;
+        std::vector<int> dims;
+        DataType dtype    = DataType::Float;
+        const void* data  = nullptr;
+        size_t numel      = 0;
+    };
+
+    bool load_tensor(const std::string& file, TensorFile& tensor, std::string* error = nullptr);
+
+    struct Config{
+        int topk   = 10;            // 保存误差最大的topk个位置
+        float atol = 1e-3f;         // |a - b| > atol + rtol * |b| 记为不匹配，b为参考（例如FP32）
+        float rtol = 1e-3f;
+        int num_threads = 0;        // <= 0时使用CPU核数
+
+        // 判定是否通过，小于0表示不检查
+        double max_abs_error     = -1;
+        double min_cosine        = -1;
+        double max_mismatch_rate = -1;
+    };
+
+    struct Mismatch{
+        size_t index = 0;           // 展开后的下标
+        float a = 0, b = 0;
+        float abs_error = 0;
+
+        Mismatch() = default;
+        Mismatch(size_t index, float a, float b, float abs_error):index(index), a(a), b(b), abs_error(abs_error){}
+    };
+
+    struct Result{
+        std::string name;
+        std::string file_a, file_b;
+        std::string error;          // 读取失败、形状不一致时不为空
+        std::vector<int> dims;
+        size_t numel          = 0;
+        double max_abs_error  = 0;
+        size_t max_index      = 0;
+        double mean_abs_error = 0;
+        double rmse           = 0;
+        double cosine         = 0;
+        size_t num_mismatch   = 0;
+        size_t num_nan        = 0;  // 任意一边是nan或者inf的个数，也计入num_mismatch
+        std::vector<Mismatch> topk; // 按误差从大到小，只包含误差大于0的位置
+        bool pass = false;
+
+        double mismatch_rate() const{return numel > 0 ? (double)num_mismatch / numel : 0;}
+    };
+
+    // a、b的长度为numel，num_threads > 1时把数据分段并行统计
+    Result compare(const void* a, DataType a_type, const void* b, DataType b_type, size_t numel, const Config& config = Config(), int num_threads = 1);
+    Result compare_files(const std::string& file_a, const std::string& file_b, const Config& config = Config());
+
+    // 按相对路径配对dir_a、dir_b中的文件，只在一边存在的文件记为错误，文件之间并行比较
+    std::vector<Result> compare_directories(const std::string& dir_a, const std::string& dir_b, const Config& config = Config(), const std::string& filter = "*");
+
+    // 展开后的下标转换为各个维度的坐标，例如[0,12,3]
+    std::string index_string(size_t index, const std::vector<int>& dims);
+
+    // 形状，例如1x3x640x640，没有维度时为scalar
+    std::string shape_string(const std::vector<int>& dims);
+
+    std::string summary(const std::vector<Result>& results, bool show_topk = true);
+    std::string to_json(const std::vector<Result>& results);
+};
+
+#endif // TENSOR_DIFF_HPP
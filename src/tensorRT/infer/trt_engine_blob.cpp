@@ -0,0 +1,65 @@
+
+#include "trt_engine_blob.hpp"
+#include <mutex>
+#include <map>
+
+namespace TRT {
+
+	using namespace std;
+
+	struct EngineBlobEntry{
+		weak_ptr<iLogger::MappedFile> mapping;
+		size_t size   = 0;
+		time_t modify = 0;
+	};
+
+	static mutex g_blobs_lock;
+	static map<string, EngineBlobEntry> g_blobs;
+
+	shared_ptr<iLogger::MappedFile> acquire_engine_blob(const string& file){
+
+		if(!iLogger::exists(file))
+			return nullptr;
+
+		size_t size   = iLogger::file_size(file);
+		time_t modify = iLogger::last_modify(file);
+
+		unique_lock<mutex> l(g_blobs_lock);
+		auto iter = g_blobs.find(file);
+		if(iter != g_blobs.end() && iter->second.size == size && iter->second.modify == modify){
+			auto mapping = iter->second.mapping.lock();
+			if(mapping != nullptr)
+				return mapping;
+		}
+
+		// 顺便清理已经没有使用者的记录
+		for(auto it = g_blobs.begin(); it != g_blobs.end();){
+			if(it->second.mapping.expired())
+				it = g_blobs.erase(it);
+			else
+				++it;
+		}
+
+		auto mapping = iLogger::map_file(file);
+		if(mapping == nullptr)
+			return nullptr;
+
+		auto& entry   = g_blobs[file];
+		entry.mapping = mapping;
+		entry.size    = size;
+		entry.modify  = modify;
+		return mapping;
+	}
+
+	int num_engine_blobs(){
+
+		unique_lock<mutex> l(g_blobs_lock);
+		int count = 0;
+		for(auto& item : g_blobs){
+			if(!item.second.mapping.expired())
+				++count;
+		}
+		return count;
+	}
+
+}; // namespace TRT
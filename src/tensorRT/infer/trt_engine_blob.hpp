@@ -0,0 +1,25 @@
+
+
+#ifndef TRT_ENGINE_BLOB_HPP
+#define TRT_ENGINE_BLOB_HPP
+
+#include <string>
+#include <memory>
+#include <common/ilogger.hpp>
+
+namespace TRT {
+
+	/** 进程内共享的engine文件映射
+	//   同一个文件（按路径）只映射一次，同时加载的多个Infer从同一个映射反序列化，不需要把engine读到vector中
+	//   registry只保存weak_ptr，所有使用者释放后映射自动解除。Infer只在反序列化期间持有映射，加载完成后立即释放
+	//   文件的大小或修改时间变化后会重新映射。使用rename替换文件时，已经持有旧映射的使用者不受影响
+	//   注意：持有映射期间文件被原地改写（截断后重写）时，访问映射会触发SIGBUS，不要长期持有返回值
+	//   映射是共享的，使用者不能修改data **/
+	std::shared_ptr<iLogger::MappedFile> acquire_engine_blob(const std::string& file);
+
+	// 当前仍然被使用的映射数量
+	int num_engine_blobs();
+
+}; // namespace TRT
+
+#endif // TRT_ENGINE_BLOB_HPP
@@ -8,6 +8,7 @@
 #include <NvInferPlugin.h>
 #include <cuda_fp16.h>
 #include <common/cuda_tools.hpp>
+#include <infer/trt_engine_blob.hpp>
 
 using namespace nvinfer1;
 using namespace std;
@@ -56,7 +57,7 @@ namespace TRT {
 			stream_ = stream;
 		}
 
-		bool build_model(const void* pdata, size_t size) {
+		bool build_model(const void* pdata, size_t size, EngineLoadTiming* timing = nullptr) {
 			destroy();
 
 			if(pdata == nullptr || size == 0)
@@ -67,6 +68,7 @@ namespace TRT {
 			if(stream_ == nullptr)
 				return false;
 
+			auto tic = iLogger::timestamp_now_float();
 			runtime_ = shared_ptr<IRuntime>(createInferRuntime(gLogger), destroy_nvidia_pointer<IRuntime>);
 			if (runtime_ == nullptr)
 				return false;
@@ -75,8 +77,13 @@ namespace TRT {
 			if (engine_ == nullptr)
 				return false;
 
+			auto toc = iLogger::timestamp_now_float();
 			//runtime_->setDLACore(0);
 			context_ = shared_ptr<IExecutionContext>(engine_->createExecutionContext(), destroy_nvidia_pointer<IExecutionContext>);
+			if(timing){
+				timing->deserialize = toc - tic;
+				timing->context     = iLogger::timestamp_now_float() - toc;
+			}
 			return context_ != nullptr;
 		}
 
@@ -106,7 +113,7 @@ namespace TRT {
 		virtual bool load(const std::string& file);
 		virtual bool load_from_memory(const void* pdata, size_t size);
 		virtual void destroy();
-		virtual void forward(bool sync) override;
+		virtual bool forward(bool sync) override;
 		virtual int get_max_batch_size() override;
 		virtual CUStream get_stream() override;
 		virtual void set_stream(CUStream stream) override;
@@ -123,6 +130,10 @@ namespace TRT {
 		virtual void set_input (int index, std::shared_ptr<Tensor> tensor) override;
 		virtual void set_output(int index, std::shared_ptr<Tensor> tensor) override;
 		virtual std::shared_ptr<std::vector<uint8_t>> serial_engine() override;
+		virtual int num_profiles() override;
+		virtual int get_current_profile() override;
+		virtual const ProfileTable& get_profiles() override;
+		virtual const EngineLoadTiming& get_load_timing() override;
 
 		virtual void print() override;
 
@@ -131,6 +142,7 @@ namespace TRT {
 		virtual int device() override;
 
 	private:
+		bool build_from_memory(const void* pdata, size_t size);
 		void build_engine_input_and_outputs_mapper();
 
 	private:
@@ -146,6 +158,11 @@ namespace TRT {
 		std::vector<void*> bindingsPtr_;
 		std::shared_ptr<MixMemory> workspace_;
 		int device_ = -1;
+		int num_profiles_ = 1;
+		int bindings_per_profile_ = 0;
+		int current_profile_ = 0;
+		ProfileTable profiles_;
+		EngineLoadTiming load_timing_;
 	};
 
 	////////////////////////////////////////////////////////////////////////////////////
@@ -179,53 +196,81 @@ namespace TRT {
 			auto& name = outputs_name_[i];
 			INFO("\t\t%d.%s : shape {%s}", i, name.c_str(), tensor->shape_string());
 		}
+
+		if(num_profiles_ > 1){
+			INFO("\tProfiles: %d", num_profiles_);
+			for(int p = 0; p < num_profiles_; ++p){
+				for(int i = 0; i < profiles_[p].size(); ++i)
+					INFO("\t\t%d.%s : %s", p, inputs_name_[i].c_str(), profile_shape_string(profiles_[p][i]).c_str());
+			}
+		}
 	}
 
 	std::shared_ptr<std::vector<uint8_t>> InferImpl::serial_engine() {
+
 		auto memory = this->context_->engine_->serialize();
 		auto output = make_shared<std::vector<uint8_t>>((uint8_t*)memory->data(), (uint8_t*)memory->data()+memory->size());
 		memory->destroy();
 		return output;
 	}
 
-	bool InferImpl::load_from_memory(const void* pdata, size_t size) {
-
-		destroy();
-		if (pdata == nullptr || size == 0)
-			return false;
+	bool InferImpl::build_from_memory(const void* pdata, size_t size) {
 
 		context_.reset(new EngineContext());
 
 		//build model
-		if (!context_->build_model(pdata, size)) {
+		if (!context_->build_model(pdata, size, &load_timing_)) {
 			context_.reset();
 			return false;
 		}
 
+		auto tic = iLogger::timestamp_now_float();
 		workspace_.reset(new MixMemory());
 		cudaGetDevice(&device_);
 		build_engine_input_and_outputs_mapper();
+		load_timing_.bindings = iLogger::timestamp_now_float() - tic;
+		return true;
+	}
+
+	bool InferImpl::load_from_memory(const void* pdata, size_t size) {
+
+		destroy();
+		if (pdata == nullptr || size == 0)
+			return false;
+
+		auto tic = iLogger::timestamp_now_float();
+		load_timing_ = EngineLoadTiming();
+		if(!build_from_memory(pdata, size))
+			return false;
+
+		load_timing_.total = iLogger::timestamp_now_float() - tic;
 		return true;
 	}
 
 	bool InferImpl::load(const std::string& file) {
 
 		destroy();
-		auto data = iLogger::load_file(file);
-		if (data.empty())
+		auto tic = iLogger::timestamp_now_float();
+		load_timing_ = EngineLoadTiming();
+
+		auto blob = acquire_engine_blob(file);
+		if (blob == nullptr)
 			return false;
 
-		context_.reset(new EngineContext());
+		// 反序列化时顺序读取整个文件，提前让内核预读
+		blob->advise(iLogger::MapAdvice::Sequential);
+		blob->advise(iLogger::MapAdvice::WillNeed);
+		load_timing_.map = iLogger::timestamp_now_float() - tic;
 
-		//build model
-		if (!context_->build_model(data.data(), data.size())) {
-			context_.reset();
+		if(!build_from_memory(blob->data(), blob->size()))
 			return false;
-		}
 
-		workspace_.reset(new MixMemory());
-		cudaGetDevice(&device_);
-		build_engine_input_and_outputs_mapper();
+		// engine已经拷贝到TensorRT中，返回后不再持有映射，之后重新编译覆盖文件不会影响这个Infer
+		load_timing_.total = iLogger::timestamp_now_float() - tic;
+		INFOV("Load engine %s[%.2f MB], map %.2f ms, deserialize %.2f ms, context %.2f ms, bindings %.2f ms, total %.2f ms",
+			file.c_str(), blob->size() / 1024.0f / 1024.0f, load_timing_.map, load_timing_.deserialize,
+			load_timing_.context, load_timing_.bindings, load_timing_.total
+		);
 		return true;
 	}
 
@@ -244,12 +289,70 @@ namespace TRT {
 		}
 	}
 
+	// setOptimizationProfileAsync从TensorRT 8开始提供，7.x使用同步的setOptimizationProfile
+	static bool set_optimization_profile(EngineContext* context, int profile) {
+#if NV_TENSORRT_MAJOR >= 8
+		return context->context_->setOptimizationProfileAsync(profile, context->stream_);
+#else
+		return context->context_->setOptimizationProfile(profile);
+#endif
+	}
+
+	static vector<int> convert_to_vector(const nvinfer1::Dims& dims){
+		return vector<int>(dims.d, dims.d + dims.nbDims);
+	}
+
 	void InferImpl::build_engine_input_and_outputs_mapper() {
 		
 		EngineContext* context = (EngineContext*)this->context_.get();
 		int nbBindings = context->engine_->getNbBindings();
 		int max_batchsize = context->engine_->getMaxBatchSize();
 
+		// 每个profile有独立的一组binding，第p个profile的第i个binding序号为 p * bindings_per_profile_ + i
+		num_profiles_ = std::max(1, context->engine_->getNbOptimizationProfiles());
+		bindings_per_profile_ = nbBindings / num_profiles_;
+		current_profile_ = 0;
+		profiles_.assign(num_profiles_, {});
+
+		bool has_dynamic_dims = false;
+		for (int i = 0; i < bindings_per_profile_; ++i) {
+			if (!context->engine_->bindingIsInput(i)) continue;
+
+			auto dims = context->engine_->getBindingDimensions(i);
+			for (int k = 1; k < dims.nbDims; ++k)
+				has_dynamic_dims = has_dynamic_dims || dims.d[k] == -1;
+
+			for (int p = 0; p < num_profiles_; ++p) {
+				int index = p * bindings_per_profile_ + i;
+				ProfileShape shape;
+				shape.min = convert_to_vector(context->engine_->getProfileDimensions(index, p, nvinfer1::OptProfileSelector::kMIN));
+				shape.opt = convert_to_vector(context->engine_->getProfileDimensions(index, p, nvinfer1::OptProfileSelector::kOPT));
+				shape.max = convert_to_vector(context->engine_->getProfileDimensions(index, p, nvinfer1::OptProfileSelector::kMAX));
+				profiles_[p].emplace_back(shape);
+			}
+		}
+
+		// 动态尺寸的tensor按最大的profile分配，输出的尺寸由context根据输入的尺寸推断
+		int largest = 0;
+		for (int p = 1; p < num_profiles_; ++p) {
+			size_t volume = 0, largest_volume = 0;
+			for (auto& shape : profiles_[p]) volume += shape.max_volume();
+			for (auto& shape : profiles_[largest]) largest_volume += shape.max_volume();
+			if (volume > largest_volume) largest = p;
+		}
+
+		if (has_dynamic_dims) {
+			set_optimization_profile(context, largest);
+			current_profile_ = largest;
+
+			for (int i = 0; i < bindings_per_profile_; ++i) {
+				if (!context->engine_->bindingIsInput(i)) continue;
+
+				int index = largest * bindings_per_profile_ + i;
+				context->context_->setBindingDimensions(index, context->engine_->getProfileDimensions(index, largest, nvinfer1::OptProfileSelector::kMAX));
+			}
+		}
+
 		inputs_.clear();
 		inputs_name_.clear();
 		outputs_.clear();
@@ -257,11 +360,16 @@ namespace TRT {
 		orderdBlobs_.clear();
 		bindingsPtr_.clear();
 		blobsNameMapper_.clear();
-		for (int i = 0; i < nbBindings; ++i) {
+		inputs_map_to_ordered_index_.clear();
+		outputs_map_to_ordered_index_.clear();
+		for (int i = 0; i < bindings_per_profile_; ++i) {
 
 			auto dims = context->engine_->getBindingDimensions(i);
 			auto type = context->engine_->getBindingDataType(i);
 			const char* bindingName = context->engine_->getBindingName(i);
+			if (has_dynamic_dims)
+				dims = context->context_->getBindingDimensions(largest * bindings_per_profile_ + i);
+
 			dims.d[0] = max_batchsize;
 			auto newTensor = make_shared<Tensor>(dims.nbDims, dims.d, convert_trt_datatype(type));
 			newTensor->set_stream(this->context_->stream_);
@@ -281,7 +389,7 @@ namespace TRT {
 			blobsNameMapper_[bindingName] = i;
 			orderdBlobs_.push_back(newTensor);
 		}
-		bindingsPtr_.resize(orderdBlobs_.size());
+		bindingsPtr_.resize(nbBindings);
 	}
 
 	void InferImpl::set_stream(CUStream stream){
@@ -311,26 +419,57 @@ namespace TRT {
 		return std::find(inputs_name_.begin(), inputs_name_.end(), name) != inputs_name_.end();
 	}
 
-	void InferImpl::forward(bool sync) {
+	bool InferImpl::forward(bool sync) {
 
 		EngineContext* context = (EngineContext*)context_.get();
 		int inputBatchSize = inputs_[0]->size(0);
-		for(int i = 0; i < context->engine_->getNbBindings(); ++i){
-			auto dims = context->engine_->getBindingDimensions(i);
-			auto type = context->engine_->getBindingDataType(i);
+
+		int profile = 0;
+		if(num_profiles_ > 1){
+			vector<vector<int>> inputs_dims(inputs_.size());
+			for(int i = 0; i < inputs_.size(); ++i)
+				inputs_dims[i] = inputs_[i]->dims();
+
+			profile = select_profile(profiles_, inputs_dims);
+			if(profile == -1){
+				INFOE("No optimization profile can hold input shape {%s}", inputs_[0]->shape_string());
+				return false;
+			}
+		}
+
+		if(profile != current_profile_){
+			if(!set_optimization_profile(context, profile)){
+				INFOE("Set optimization profile %d failed.", profile);
+				return false;
+			}
+			current_profile_ = profile;
+		}
+
+		int binding_offset = profile * bindings_per_profile_;
+		for(int i = 0; i < bindings_per_profile_; ++i){
+			auto dims = context->engine_->getBindingDimensions(binding_offset + i);
+			auto type = context->engine_->getBindingDataType(binding_offset + i);
 			dims.d[0] = inputBatchSize;
-			if(context->engine_->bindingIsInput(i)){
-				context->context_->setBindingDimensions(i, dims);
+			if(context->engine_->bindingIsInput(binding_offset + i)){
+
+				// 动态的维度使用输入tensor的尺寸
+				auto& tensor = orderdBlobs_[i];
+				for(int k = 1; k < dims.nbDims && k < tensor->ndims(); ++k){
+					if(dims.d[k] == -1) dims.d[k] = tensor->size(k);
+				}
+				context->context_->setBindingDimensions(binding_offset + i, dims);
 			}
 		}
 
 		for (int i = 0; i < outputs_.size(); ++i) {
-			outputs_[i]->resize_single_dim(0, inputBatchSize);
+			auto dims = context->context_->getBindingDimensions(binding_offset + outputs_map_to_ordered_index_[i]);
+			outputs_[i]->resize(dims.nbDims, dims.d);
 			outputs_[i]->to_gpu(false);
 		}
 
+		std::fill(bindingsPtr_.begin(), bindingsPtr_.end(), nullptr);
 		for (int i = 0; i < orderdBlobs_.size(); ++i)
-			bindingsPtr_[i] = orderdBlobs_[i]->gpu();
+			bindingsPtr_[binding_offset + i] = orderdBlobs_[i]->gpu();
 
 		void** bindingsptr = bindingsPtr_.data();
 		//bool execute_result = context->context_->enqueue(inputBatchSize, bindingsptr, context->stream_, nullptr);
@@ -343,6 +482,7 @@ namespace TRT {
 		if (sync) {
 			synchronize();
 		}
+		return execute_result;
 	}
 
 	std::shared_ptr<MixMemory> InferImpl::get_workspace() {
@@ -398,6 +538,22 @@ namespace TRT {
 		return this->context_->engine_->getMaxBatchSize();
 	}
 
+	int InferImpl::num_profiles() {
+		return num_profiles_;
+	}
+
+	int InferImpl::get_current_profile() {
+		return current_profile_;
+	}
+
+	const ProfileTable& InferImpl::get_profiles() {
+		return profiles_;
+	}
+
+	const EngineLoadTiming& InferImpl::get_load_timing() {
+		return load_timing_;
+	}
+
 	std::shared_ptr<Tensor> InferImpl::tensor(const std::string& name) {
 		Assert(this->blobsNameMapper_.find(name) != this->blobsNameMapper_.end());
 		return orderdBlobs_[blobsNameMapper_[name]];
@@ -8,12 +8,23 @@
 #include <vector>
 #include <map>
 #include <common/trt_tensor.hpp>
+#include <infer/trt_profile.hpp>
 
 namespace TRT {
 
+	// load_infer各阶段的耗时，单位ms
+	struct EngineLoadTiming{
+		float map         = 0;		// 映射engine文件，load_infer_from_memory时为0
+		float deserialize = 0;		// 创建runtime并反序列化engine
+		float context     = 0;		// 创建execution context
+		float bindings    = 0;		// 创建输入输出tensor
+		float total       = 0;
+	};
+
 	class Infer {
 	public:
-		virtual void     forward(bool sync = true) = 0;
+		// 没有profile能容纳输入的尺寸或者enqueue失败时返回false，此时输出tensor的内容无效
+		virtual bool     forward(bool sync = true) = 0;
 		virtual int      get_max_batch_size() = 0;
 		virtual void     set_stream(CUStream stream) = 0;
 		virtual CUStream get_stream() = 0;
@@ -34,6 +45,13 @@ namespace TRT {
 		virtual void set_input (int index, std::shared_ptr<Tensor> tensor) = 0;
 		virtual void set_output(int index, std::shared_ptr<Tensor> tensor) = 0;
 		virtual std::shared_ptr<std::vector<uint8_t>> serial_engine() = 0;
+
+		// engine有多个optimization profile时，forward根据输入tensor的尺寸选择能容纳它的最小的profile
+		virtual int  num_profiles() = 0;
+		virtual int  get_current_profile() = 0;
+		virtual const ProfileTable& get_profiles() = 0;
+
+		virtual const EngineLoadTiming& get_load_timing() = 0;
 	};
 
 	struct DeviceMemorySummary {
@@ -47,6 +65,8 @@ namespace TRT {
 	
 	void set_device(int device_id);
 	std::shared_ptr<Infer> load_infer_from_memory(const void* pdata, size_t size);
+
+	// engine文件通过内存映射加载，同一进程中同时加载同一个文件的多个Infer共享一个映射，加载完成后释放映射（见trt_engine_blob.hpp）
 	std::shared_ptr<Infer> load_infer(const std::string& file);
 	bool init_nv_plugins();
 
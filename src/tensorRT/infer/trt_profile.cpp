@@ -0,0 +1,59 @@
+
+#include "trt_profile.hpp"
+#include <common/ilogger.hpp>
+
+namespace TRT {
+
+	using namespace std;
+
+	bool ProfileShape::contains(const vector<int>& dims) const{
+
+		if(dims.size() != min.size() || dims.size() != max.size())
+			return false;
+
+		for(size_t i = 0; i < dims.size(); ++i){
+			if(dims[i] < min[i] || dims[i] > max[i])
+				return false;
+		}
+		return true;
+	}
+
+	size_t ProfileShape::max_volume() const{
+		size_t volume = 1;
+		for(auto& d : max)
+			volume *= d;
+		return volume;
+	}
+
+	int select_profile(const ProfileTable& profiles, const vector<vector<int>>& inputs_dims){
+
+		int selected = -1;
+		size_t selected_volume = 0;
+		for(size_t p = 0; p < profiles.size(); ++p){
+			auto& shapes = profiles[p];
+			if(shapes.size() != inputs_dims.size())
+				continue;
+
+			bool fit = true;
+			size_t volume = 0;
+			for(size_t i = 0; i < shapes.size() && fit; ++i){
+				fit = shapes[i].contains(inputs_dims[i]);
+				volume += shapes[i].max_volume();
+			}
+
+			if(fit && (selected == -1 || volume < selected_volume)){
+				selected = p;
+				selected_volume = volume;
+			}
+		}
+		return selected;
+	}
+
+	string profile_shape_string(const ProfileShape& shape){
+		auto dims_string = [](const vector<int>& dims){
+			return iLogger::join_dims(vector<int64_t>(dims.begin(), dims.end()));
+		};
+		return iLogger::format("min = %s, opt = %s, max = %s", dims_string(shape.min).c_str(), dims_string(shape.opt).c_str(), dims_string(shape.max).c_str());
+	}
+
+}; // namespace TRT
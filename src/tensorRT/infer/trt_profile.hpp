@@ -0,0 +1,32 @@
+
+
+#ifndef TRT_PROFILE_HPP
+#define TRT_PROFILE_HPP
+
+#include <string>
+#include <vector>
+
+namespace TRT {
+
+	// optimization profile中一个输入的尺寸范围，包含batch维度
+	struct ProfileShape{
+		std::vector<int> min;
+		std::vector<int> opt;
+		std::vector<int> max;
+
+		bool contains(const std::vector<int>& dims) const;
+		size_t max_volume() const;
+	};
+
+	// profiles[p][i]为第p个profile中第i个输入的范围
+	typedef std::vector<std::vector<ProfileShape>> ProfileTable;
+
+	/** 选择能容纳所有输入尺寸的profile中最小的一个（按max尺寸的元素数量），相同时取序号小的
+	//   没有合适的profile时返回-1 **/
+	int select_profile(const ProfileTable& profiles, const std::vector<std::vector<int>>& inputs_dims);
+
+	std::string profile_shape_string(const ProfileShape& shape);
+
+}; // namespace TRT
+
+#endif // TRT_PROFILE_HPP
@@ -0,0 +1,551 @@
+
+#include "onnx_analyzer.hpp"
+#include "onnx_graph.hpp"
+#include <common/ilogger.hpp>
+#include <common/json.hpp>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <algorithm>
+#include <limits>
+
+namespace ONNXOptimizer{
+
+    using namespace std;
+
+    static const unordered_set<string> g_activations{
+        "Relu", "Sigmoid", "Tanh", "LeakyRelu", "Elu", "Selu", "Clip", "HardSigmoid",
+        "Softplus", "Softsign", "ThresholdedRelu", "PRelu", "HardSwish"
+    };
+
+    static const unordered_set<string> g_shuffles{
+        "Reshape", "Transpose", "Squeeze", "Unsqueeze", "Flatten"
+    };
+
+    // 只搬运数据、不做计算的算子
+    static const unordered_set<string> g_data_movements{
+        "Reshape", "Transpose", "Squeeze", "Unsqueeze", "Flatten", "Identity", "Concat", "Split", "Slice",
+        "Gather", "GatherElements", "GatherND", "Pad", "Expand", "Tile", "Shape", "Size", "Cast", "Constant",
+        "ConstantOfShape", "Range", "Dropout", "DepthToSpace", "SpaceToDepth", "ScatterND", "ScatterElements"
+    };
+
+    static bool is_weighted(const string& op){
+        return op == "Conv" || op == "ConvTranspose" || op == "Gemm" || op == "MatMul";
+    }
+
+    double NodeCost::intensity() const{
+        size_t bytes = input_bytes + output_bytes + weight_bytes;
+        return bytes == 0 ? 0 : flops / bytes;
+    }
+
+    const char* sort_by_name(SortBy by){
+        switch(by){
+            case SortBy::Order:      return "order";
+            case SortBy::FLOPs:      return "flops";
+            case SortBy::Activation: return "activation";
+            case SortBy::Weight:     return "weight";
+            case SortBy::Intensity:  return "intensity";
+            default: return "unknow";
+        }
+    }
+
+    class GraphCostAnalyzer{
+    public:
+        GraphCostAnalyzer(const onnx::GraphProto& graph, const AnalyzeOptions& options)
+            :graph_(graph), options_(options){}
+
+        AnalysisReport run(){
+
+            AnalysisReport report;
+            report.graph_name = graph_.name();
+            report.num_nodes  = graph_.node_size();
+
+            collect_initializers(report);
+            build_input_shapes();
+            infos_ = infer_shapes(graph_, false, &constants_, &input_shapes_);
+            collect_consumers();
+
+            report.nodes.resize(graph_.node_size());
+            for(int i = 0; i < graph_.node_size(); ++i){
+                auto& node = graph_.node(i);
+                auto& cost = report.nodes[i];
+                cost.index   = i;
+                cost.name    = node.name().empty() ? iLogger::format("%s_%d", node.op_type().c_str(), i) : node.name();
+                cost.op_type = node.op_type();
+                measure(node, cost);
+                fusion_hints(i, node, cost);
+
+                if(!cost.shape_known) report.num_unknown_shapes++;
+                report.num_fusion_hints       += cost.fusion_hints.size();
+                report.total_flops            += cost.flops;
+                report.total_activation_bytes += cost.output_bytes;
+            }
+
+            report.peak_activation_bytes = peak_activation();
+            summarize_ops(report);
+            return report;
+        }
+
+    private:
+        void collect_initializers(AnalysisReport& report){
+
+            for(auto& initializer : graph_.initializer()){
+                size_t bytes = shape_numel(tensor_dims(initializer)) * dtype_size(initializer.data_type());
+                weights_[initializer.name()] = bytes;
+                report.total_weight_bytes   += bytes;
+
+                // 只有小的整数常量（Reshape的shape、Slice的starts等）对形状推导有用，大的权重不需要展开
+                int dtype = initializer.data_type();
+                bool is_integer = dtype == onnx::TensorProto::INT64 || dtype == onnx::TensorProto::INT32;
+                Constant value;
+                if(is_integer && shape_numel(tensor_dims(initializer)) <= 1024 && tensor_to_constant(initializer, value))
+                    constants_[initializer.name()] = value;
+            }
+
+            for(auto& node : graph_.node()){
+                if(node.op_type() != "Constant" || node.output_size() != 1) continue;
+
+                auto attr = find_attribute(node, "value");
+                Constant value;
+                if(attr && attr->has_t() && tensor_to_constant(attr->t(), value) && value.is_integer())
+                    constants_[node.output(0)] = value;
+            }
+        }
+
+        void build_input_shapes(){
+
+            for(auto& input : graph_.input()){
+                if(weights_.count(input.name())) continue;
+
+                auto iter = options_.input_shapes.find(input.name());
+                if(iter != options_.input_shapes.end()){
+                    input_shapes_[input.name()] = iter->second;
+                    continue;
+                }
+
+                auto shape = value_info_shape(input);
+                if(!shape.empty()) shape[0] = options_.batch_size;
+                input_shapes_[input.name()] = shape;
+            }
+        }
+
+        void collect_consumers(){
+            for(int i = 0; i < graph_.node_size(); ++i){
+                for(auto& name : graph_.node(i).input()){
+                    if(!name.empty()) consumers_[name].push_back(i);
+                }
+            }
+
+            for(auto& output : graph_.output())
+                graph_outputs_.insert(output.name());
+        }
+
+        const TensorInfo* static_info(const string& name) const{
+            auto iter = infos_.find(name);
+            if(iter == infos_.end() || !iter->second.has_shape || !iter->second.is_static()) return nullptr;
+            return &iter->second;
+        }
+
+        size_t tensor_bytes(const string& name) const{
+            auto info = static_info(name);
+            if(info == nullptr) return 0;
+
+            // 类型未知时按float计算
+            int size = dtype_size(info->dtype);
+            return shape_numel(info->shape) * (size == 0 ? 4 : size);
+        }
+
+        void measure(const onnx::NodeProto& node, NodeCost& cost){
+
+            cost.shape_known = true;
+            for(auto& name : node.input()){
+                if(name.empty()) continue;
+
+                if(weights_.count(name)) cost.weight_bytes += weights_[name];
+                else                     cost.input_bytes  += tensor_bytes(name);
+            }
+
+            vector<string> shapes;
+            for(auto& name : node.output()){
+                if(name.empty()) continue;
+
+                auto info = static_info(name);
+                if(info == nullptr){
+                    cost.shape_known = false;
+                    shapes.push_back("?");
+                    continue;
+                }
+                cost.output_bytes += tensor_bytes(name);
+                shapes.push_back(shape_string(info->shape));
+            }
+
+            for(size_t i = 0; i < shapes.size(); ++i)
+                cost.output_shape += (i == 0 ? "" : ", ") + shapes[i];
+
+            if(cost.shape_known)
+                cost.flops = node_flops(node);
+        }
+
+        double node_flops(const onnx::NodeProto& node) const{
+
+            auto& op = node.op_type();
+            auto shape_of = [&](int i) -> Shape {
+                if(i >= node.input_size()) return Shape();
+                auto info = static_info(node.input(i));
+                return info ? info->shape : Shape();
+            };
+
+            auto out  = static_info(node.output(0));
+            double ny = out ? (double)shape_numel(out->shape) : 0;
+            if(g_data_movements.count(op)) return 0;
+
+            if(op == "Conv" || op == "ConvTranspose"){
+                auto x = shape_of(0);
+                auto w = shape_of(1);
+                if(w.empty() || w[0] == 0 || x.empty()) return 0;
+
+                // Conv的权重为[Cout, Cin/group, k...]，每个输出元素做numel(w)/Cout次乘加
+                // ConvTranspose的权重为[Cin, Cout/group, k...]，每个输入元素做numel(w)/Cin次乘加
+                double per_element = (double)shape_numel(w) / w[0];
+                double macs = op == "Conv" ? ny * per_element : shape_numel(x) * per_element;
+                return 2 * macs + (node.input_size() > 2 ? ny : 0);
+            }
+
+            if(op == "Gemm"){
+                auto a = shape_of(0);
+                if(a.size() != 2) return 0;
+
+                int64_t k = attribute_int(node, "transA", 0) ? a[0] : a[1];
+                return 2 * ny * k + (node.input_size() > 2 ? ny : 0);
+            }
+
+            if(op == "MatMul"){
+                auto a = shape_of(0);
+                if(a.empty()) return 0;
+                return 2 * ny * a.back();
+            }
+
+            if(op == "MaxPool" || op == "AveragePool" || op == "LpPool"){
+                double kernel = 1;
+                for(auto& k : attribute_ints(node, "kernel_shape"))
+                    kernel *= k;
+                return ny * kernel;
+            }
+
+            if(op == "GlobalAveragePool" || op == "GlobalMaxPool" || op == "ArgMax" || op == "ArgMin" || iLogger::begin_with(op, "Reduce"))
+                return (double)shape_numel(shape_of(0));
+
+            if(op == "Softmax" || op == "LogSoftmax")
+                return 3 * ny;
+
+            if(op == "BatchNormalization")
+                return 2 * ny;
+
+            if(op == "InstanceNormalization" || op == "LayerNormalization")
+                return 5 * ny;
+
+            if(op == "LRN")
+                return ny * attribute_int(node, "size", 1);
+
+            if(op == "Sum" || op == "Mean" || op == "Max" || op == "Min")
+                return ny * std::max(1, node.input_size() - 1);
+
+            // 逐元素的算子、Resize以及其他未知的算子，按每个输出元素一次运算估计
+            return ny;
+        }
+
+        int producer_of(const string& name) const{
+            auto iter = producers_.find(name);
+            return iter == producers_.end() ? -1 : iter->second;
+        }
+
+        const vector<int>& consumers_of(const string& name) const{
+            static const vector<int> empty;
+            auto iter = consumers_.find(name);
+            return iter == consumers_.end() ? empty : iter->second;
+        }
+
+        void fusion_hints(int index, const onnx::NodeProto& node, NodeCost& cost){
+
+            auto& op = node.op_type();
+            for(auto& output : node.output())
+                producers_[output] = index;
+
+            auto producer_op = [&](int input) -> string {
+                if(input >= node.input_size()) return string();
+                int p = producer_of(node.input(input));
+                return p == -1 ? string() : graph_.node(p).op_type();
+            };
+
+            if(is_weighted(op) && node.output_size() == 1){
+                auto& consumers = consumers_of(node.output(0));
+                if(consumers.size() > 1){
+                    for(int c : consumers){
+                        auto& consumer = graph_.node(c).op_type();
+                        if(g_activations.count(consumer) || consumer == "BatchNormalization"){
+                            cost.fusion_hints.push_back(iLogger::format(
+                                "output has %d consumers, %s cannot be fused into %s", (int)consumers.size(), consumer.c_str(), op.c_str()
+                            ));
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if(op == "BatchNormalization"){
+                int p = node.input_size() > 0 ? producer_of(node.input(0)) : -1;
+                bool fused = p != -1 && (graph_.node(p).op_type() == "Conv" || graph_.node(p).op_type() == "ConvTranspose") &&
+                             consumers_of(node.input(0)).size() == 1;
+                if(!fused)
+                    cost.fusion_hints.push_back("not directly after a single-consumer Conv, runs as a separate scale layer");
+            }
+
+            if(g_shuffles.count(op) && node.output_size() == 1){
+                auto from = producer_op(0);
+                auto& consumers = consumers_of(node.output(0));
+                if(is_weighted(from) && consumers.size() == 1){
+                    auto& to = graph_.node(consumers[0]).op_type();
+                    if(g_activations.count(to) || to == "BatchNormalization" || to == "Add")
+                        cost.fusion_hints.push_back(iLogger::format("%s between %s and %s blocks their fusion", op.c_str(), from.c_str(), to.c_str()));
+                }
+            }
+
+            if(op == "Erf")
+                cost.fusion_hints.push_back("decomposed GELU (Div-Erf-Add-Mul), runs as several elementwise layers");
+
+            if(op == "Softplus" && node.output_size() == 1){
+                for(int c : consumers_of(node.output(0))){
+                    if(graph_.node(c).op_type() == "Tanh"){
+                        cost.fusion_hints.push_back("decomposed Mish (Softplus-Tanh-Mul), runs as several layers");
+                        break;
+                    }
+                }
+            }
+
+            if(op == "Shape")
+                cost.fusion_hints.push_back("runtime shape computation, try ONNXOptimizer (ShapeSimplify) or export with static shapes");
+
+            if(op == "Cast"){
+                int to = attribute_int(node, "to", 0);
+                if(to == onnx::TensorProto::INT64 || to == onnx::TensorProto::DOUBLE)
+                    cost.fusion_hints.push_back("Cast to INT64/DOUBLE is not supported by TensorRT");
+            }
+
+            if(op == "Plugin" || (!node.domain().empty() && node.domain() != "ai.onnx"))
+                cost.fusion_hints.push_back("plugin layer, no fusion with neighbouring layers");
+        }
+
+        size_t peak_activation() const{
+
+            unordered_map<string, int> last_use;
+            for(auto& item : consumers_)
+                last_use[item.first] = item.second.back();
+
+            size_t alive = 0, peak = 0;
+            for(auto& input : graph_.input()){
+                if(!weights_.count(input.name()))
+                    alive += tensor_bytes(input.name());
+            }
+            peak = alive;
+
+            for(int i = 0; i < graph_.node_size(); ++i){
+                auto& node = graph_.node(i);
+                for(auto& output : node.output()){
+                    if(!output.empty()) alive += tensor_bytes(output);
+                }
+                peak = std::max(peak, alive);
+
+                // 最后一次使用之后释放，graph的输出一直保留
+                unordered_set<string> released;
+                for(auto& name : node.input()){
+                    if(name.empty() || weights_.count(name) || graph_outputs_.count(name) || released.count(name)) continue;
+
+                    auto iter = last_use.find(name);
+                    if(iter != last_use.end() && iter->second == i){
+                        alive -= std::min(alive, tensor_bytes(name));
+                        released.insert(name);
+                    }
+                }
+
+                // 没有被使用的输出立即释放
+                for(auto& output : node.output()){
+                    if(!output.empty() && !consumers_.count(output) && !graph_outputs_.count(output))
+                        alive -= std::min(alive, tensor_bytes(output));
+                }
+            }
+            return peak;
+        }
+
+        void summarize_ops(AnalysisReport& report) const{
+
+            map<string, OpSummary> ops;
+            for(auto& node : report.nodes){
+                auto& item = ops[node.op_type];
+                item.op_type       = node.op_type;
+                item.count        += 1;
+                item.flops        += node.flops;
+                item.output_bytes += node.output_bytes;
+                item.weight_bytes += node.weight_bytes;
+            }
+
+            for(auto& item : ops)
+                report.ops.push_back(item.second);
+
+            std::stable_sort(report.ops.begin(), report.ops.end(), [](const OpSummary& a, const OpSummary& b){
+                return a.flops > b.flops;
+            });
+        }
+
+    private:
+        const onnx::GraphProto& graph_;
+        AnalyzeOptions options_;
+        TensorInfoMap infos_;
+        unordered_map<string, Constant> constants_;
+        unordered_map<string, Shape> input_shapes_;
+        unordered_map<string, size_t> weights_;
+        unordered_map<string, vector<int>> consumers_;
+        unordered_map<string, int> producers_;
+        unordered_set<string> graph_outputs_;
+    };
+
+    vector<NodeCost> AnalysisReport::sorted(SortBy by) const{
+
+        vector<NodeCost> output = nodes;
+        auto key = [by](const NodeCost& node) -> double {
+            switch(by){
+                case SortBy::FLOPs:      return node.flops;
+                case SortBy::Activation: return node.output_bytes;
+                case SortBy::Weight:     return node.weight_bytes;
+                case SortBy::Intensity:  return -node.intensity();   // 强度低的（受带宽限制的）排在前面
+                default:                 return -node.index;
+            }
+        };
+
+        std::stable_sort(output.begin(), output.end(), [&](const NodeCost& a, const NodeCost& b){
+            return key(a) > key(b);
+        });
+        return output;
+    }
+
+    static string mb_string(size_t bytes){
+        return iLogger::format("%.2f", bytes / 1024.0 / 1024.0);
+    }
+
+    string AnalysisReport::text(SortBy by, int top) const{
+
+        string output = iLogger::format(
+            "Graph %s: %d nodes (%d unknown shapes), %.3f GFLOPs, weights %s MB, activations %s MB (peak %s MB), %d fusion hints",
+            graph_name.c_str(), num_nodes, num_unknown_shapes, total_flops / 1e9, mb_string(total_weight_bytes).c_str(),
+            mb_string(total_activation_bytes).c_str(), mb_string(peak_activation_bytes).c_str(), num_fusion_hints
+        );
+
+        auto list  = sorted(by);
+        int count  = top <= 0 ? list.size() : std::min((int)list.size(), top);
+        output += iLogger::format("\nNodes sorted by %s (%d of %d):", sort_by_name(by), count, (int)list.size());
+        output += iLogger::format("\n    %s %s %s %s %s %s %s %s",
+            iLogger::align_blank("index", 6).c_str(), iLogger::align_blank("name", 32).c_str(), iLogger::align_blank("op", 20).c_str(),
+            iLogger::align_blank("output", 24).c_str(), iLogger::align_blank("GFLOPs", 10).c_str(), iLogger::align_blank("flops%", 8).c_str(),
+            iLogger::align_blank("act MB", 10).c_str(), "weight MB"
+        );
+
+        for(int i = 0; i < count; ++i){
+            auto& node = list[i];
+            output += iLogger::format("\n    %s %s %s %s %s %s %s %s",
+                iLogger::align_blank(to_string(node.index), 6).c_str(), iLogger::align_blank(node.name, 32).c_str(),
+                iLogger::align_blank(node.op_type, 20).c_str(), iLogger::align_blank(node.shape_known ? node.output_shape : "?", 24).c_str(),
+                iLogger::align_blank(iLogger::format("%.4f", node.flops / 1e9), 10).c_str(),
+                iLogger::align_blank(iLogger::format("%.2f", total_flops > 0 ? node.flops / total_flops * 100 : 0), 8).c_str(),
+                iLogger::align_blank(mb_string(node.output_bytes), 10).c_str(), mb_string(node.weight_bytes).c_str()
+            );
+        }
+
+        output += "\nOps:";
+        for(auto& item : ops){
+            output += iLogger::format("\n    %s x%-5d %.4f GFLOPs (%.2f%%), act %s MB, weight %s MB",
+                iLogger::align_blank(item.op_type, 20).c_str(), item.count, item.flops / 1e9,
+                total_flops > 0 ? item.flops / total_flops * 100 : 0, mb_string(item.output_bytes).c_str(), mb_string(item.weight_bytes).c_str()
+            );
+        }
+
+        if(num_fusion_hints > 0){
+            output += "\nFusion hints:";
+            for(auto& node : nodes){
+                for(auto& hint : node.fusion_hints)
+                    output += iLogger::format("\n    [%d] %s(%s): %s", node.index, node.name.c_str(), node.op_type.c_str(), hint.c_str());
+            }
+        }
+        return output;
+    }
+
+    string AnalysisReport::json(SortBy by) const{
+
+        Json::Value root(Json::objectValue);
+        root["graph"]                  = graph_name;
+        root["num_nodes"]              = num_nodes;
+        root["num_unknown_shapes"]     = num_unknown_shapes;
+        root["num_fusion_hints"]       = num_fusion_hints;
+        root["total_flops"]            = total_flops;
+        root["total_weight_bytes"]     = (Json::UInt64)total_weight_bytes;
+        root["total_activation_bytes"] = (Json::UInt64)total_activation_bytes;
+        root["peak_activation_bytes"]  = (Json::UInt64)peak_activation_bytes;
+        root["sort_by"]                = sort_by_name(by);
+
+        auto& jnodes = root["nodes"] = Json::Value(Json::arrayValue);
+        for(auto& node : sorted(by)){
+            Json::Value item(Json::objectValue);
+            item["index"]        = node.index;
+            item["name"]         = node.name;
+            item["op_type"]      = node.op_type;
+            item["output_shape"] = node.output_shape;
+            item["shape_known"]  = node.shape_known;
+            item["flops"]        = node.flops;
+            item["input_bytes"]  = (Json::UInt64)node.input_bytes;
+            item["output_bytes"] = (Json::UInt64)node.output_bytes;
+            item["weight_bytes"] = (Json::UInt64)node.weight_bytes;
+            item["intensity"]    = node.intensity();
+
+            auto& hints = item["fusion_hints"] = Json::Value(Json::arrayValue);
+            for(auto& hint : node.fusion_hints)
+                hints.append(hint);
+            jnodes.append(item);
+        }
+
+        auto& jops = root["ops"] = Json::Value(Json::arrayValue);
+        for(auto& op : ops){
+            Json::Value item(Json::objectValue);
+            item["op_type"]      = op.op_type;
+            item["count"]        = op.count;
+            item["flops"]        = op.flops;
+            item["output_bytes"] = (Json::UInt64)op.output_bytes;
+            item["weight_bytes"] = (Json::UInt64)op.weight_bytes;
+            jops.append(item);
+        }
+        return root.toStyledString();
+    }
+
+    AnalysisReport analyze(const onnx::ModelProto& model, const AnalyzeOptions& options){
+        GraphCostAnalyzer analyzer(model.graph(), options);
+        return analyzer.run();
+    }
+
+    bool analyze_file(const string& onnx_file, AnalysisReport& report, const AnalyzeOptions& options){
+
+        auto mapping = iLogger::map_file(onnx_file);
+        if(mapping == nullptr){
+            INFOE("Map onnx file %s failed.", onnx_file.c_str());
+            return false;
+        }
+
+        onnx::ModelProto model;
+        google::protobuf::io::ArrayInputStream raw_input(mapping->data(), mapping->size());
+        google::protobuf::io::CodedInputStream coded_input(&raw_input);
+        coded_input.SetTotalBytesLimit(std::numeric_limits<int>::max());
+        if(!model.ParseFromCodedStream(&coded_input)){
+            INFOE("Parse onnx file %s failed.", onnx_file.c_str());
+            return false;
+        }
+
+        report = analyze(model, options);
+        return true;
+    }
+
+}; // namespace ONNXOptimizer
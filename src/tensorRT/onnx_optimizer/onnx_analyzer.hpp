@@ -0,0 +1,87 @@
+#ifndef ONNX_ANALYZER_HPP
+#define ONNX_ANALYZER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace onnx{
+    class ModelProto;
+};
+
+/**
+ * @brief 编译之前在CPU上估计onnx模型的开销，不需要GPU和TensorRT
+ * 基于onnx_graph的形状推导，统计每个节点的FLOPs（一次乘加计为2）、输出激活和权重的字节数，
+ * 并标记常见的会阻止TensorRT层融合的结构。报告可以按不同的列排序，输出为文本或者JSON
+ * 形状推导失败的节点（例如Reshape的shape在运行时计算）FLOPs记为0，可以先用ONNXOptimizer::optimize简化
+ */
+namespace ONNXOptimizer{
+
+    struct AnalyzeOptions{
+        // graph.input的第0维按batch_size计算，与TRT::compile一致
+        int batch_size = 1;
+
+        // 指定输入的完整形状（包括batch），优先于batch_size，其他动态的维度需要在这里指定
+        std::map<std::string, std::vector<int64_t>> input_shapes;
+    };
+
+    struct NodeCost{
+        int index = 0;                  // 在graph.node中的序号
+        std::string name;
+        std::string op_type;
+        std::string output_shape;
+        bool shape_known    = false;
+        double flops        = 0;
+        size_t input_bytes  = 0;        // 非权重输入的字节数
+        size_t output_bytes = 0;        // 输出激活的字节数
+        size_t weight_bytes = 0;        // 输入中initializer的字节数
+        std::vector<std::string> fusion_hints;
+
+        // FLOPs / 读写的字节数，越小越受显存带宽限制
+        double intensity() const;
+    };
+
+    struct OpSummary{
+        std::string op_type;
+        int count           = 0;
+        double flops        = 0;
+        size_t output_bytes = 0;
+        size_t weight_bytes = 0;
+    };
+
+    enum class SortBy : int{
+        Order      = 0,
+        FLOPs      = 1,
+        Activation = 2,
+        Weight     = 3,
+        Intensity  = 4
+    };
+
+    const char* sort_by_name(SortBy by);
+
+    struct AnalysisReport{
+        std::string graph_name;
+        int num_nodes                 = 0;
+        int num_unknown_shapes        = 0;
+        int num_fusion_hints          = 0;
+        double total_flops            = 0;
+        size_t total_weight_bytes     = 0;   // 所有initializer
+        size_t total_activation_bytes = 0;   // 所有节点输出之和
+        size_t peak_activation_bytes  = 0;   // 按节点顺序执行、张量在最后一次使用后释放时，同时存在的激活的最大值
+        std::vector<NodeCost> nodes;         // graph.node的顺序
+        std::vector<OpSummary> ops;          // 按FLOPs降序
+
+        std::vector<NodeCost> sorted(SortBy by) const;
+
+        // top <= 0时输出全部节点
+        std::string text(SortBy by = SortBy::FLOPs, int top = 20) const;
+        std::string json(SortBy by = SortBy::Order) const;
+    };
+
+    AnalysisReport analyze(const onnx::ModelProto& model, const AnalyzeOptions& options = AnalyzeOptions());
+    bool analyze_file(const std::string& onnx_file, AnalysisReport& report, const AnalyzeOptions& options = AnalyzeOptions());
+
+}; // namespace ONNXOptimizer
+
+#endif // ONNX_ANALYZER_HPP
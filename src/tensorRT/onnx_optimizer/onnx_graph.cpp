@@ -0,0 +1,883 @@
+
+#include "onnx_graph.hpp"
+#include <common/ilogger.hpp>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace ONNXOptimizer{
+
+    using namespace std;
+
+    bool Constant::is_integer() const{
+        return dtype != onnx::TensorProto::FLOAT && dtype != onnx::TensorProto::DOUBLE;
+    }
+
+    size_t Constant::numel() const{
+        return is_integer() ? ints.size() : floats.size();
+    }
+
+    int64_t Constant::int_at(size_t i) const{
+        return is_integer() ? ints[i] : (int64_t)floats[i];
+    }
+
+    double Constant::float_at(size_t i) const{
+        return is_integer() ? (double)ints[i] : floats[i];
+    }
+
+    void Constant::resize(size_t n){
+        if(is_integer()){
+            ints.resize(n);
+            floats.clear();
+        }else{
+            floats.resize(n);
+            ints.clear();
+        }
+    }
+
+    bool TensorInfo::is_static() const{
+        if(!has_shape) return false;
+        for(auto& d : shape)
+            if(d < 0) return false;
+        return true;
+    }
+
+    size_t shape_numel(const Shape& shape){
+        size_t n = 1;
+        for(auto& d : shape){
+            if(d < 0) return 0;
+            n *= d;
+        }
+        return n;
+    }
+
+    string shape_string(const Shape& shape){
+        return iLogger::join_dims(shape);
+    }
+
+    int dtype_size(int dtype){
+        switch(dtype){
+            case onnx::TensorProto::FLOAT:   return 4;
+            case onnx::TensorProto::DOUBLE:  return 8;
+            case onnx::TensorProto::INT32:   return 4;
+            case onnx::TensorProto::INT64:   return 8;
+            case onnx::TensorProto::INT16:   return 2;
+            case onnx::TensorProto::UINT16:  return 2;
+            case onnx::TensorProto::FLOAT16: return 2;
+            case onnx::TensorProto::BFLOAT16:return 2;
+            case onnx::TensorProto::INT8:    return 1;
+            case onnx::TensorProto::UINT8:   return 1;
+            case onnx::TensorProto::BOOL:    return 1;
+            case onnx::TensorProto::UINT32:  return 4;
+            case onnx::TensorProto::UINT64:  return 8;
+            default: return 0;
+        }
+    }
+
+    bool is_foldable_dtype(int dtype){
+        return dtype == onnx::TensorProto::FLOAT || dtype == onnx::TensorProto::DOUBLE ||
+               dtype == onnx::TensorProto::INT32 || dtype == onnx::TensorProto::INT64 ||
+               dtype == onnx::TensorProto::BOOL;
+    }
+
+    Shape tensor_dims(const onnx::TensorProto& tensor){
+        return Shape(tensor.dims().begin(), tensor.dims().end());
+    }
+
+    Shape value_info_shape(const onnx::ValueInfoProto& info){
+        Shape output;
+        auto& shape = info.type().tensor_type().shape();
+        for(int i = 0; i < shape.dim_size(); ++i){
+            auto& dim = shape.dim(i);
+            output.push_back(dim.has_dim_value() && dim.dim_value() > 0 ? dim.dim_value() : -1);
+        }
+        return output;
+    }
+
+    template<typename _T>
+    static void read_raw(const string& raw, size_t n, vector<int64_t>& output){
+        const _T* p = (const _T*)raw.data();
+        output.resize(n);
+        for(size_t i = 0; i < n; ++i)
+            output[i] = p[i];
+    }
+
+    template<typename _T>
+    static void read_raw(const string& raw, size_t n, vector<double>& output){
+        const _T* p = (const _T*)raw.data();
+        output.resize(n);
+        for(size_t i = 0; i < n; ++i)
+            output[i] = p[i];
+    }
+
+    bool tensor_to_constant(const onnx::TensorProto& tensor, Constant& output){
+
+        if(tensor.data_location() == onnx::TensorProto::EXTERNAL)
+            return false;
+
+        int dtype = tensor.data_type();
+        if(!is_foldable_dtype(dtype))
+            return false;
+
+        output.dtype = dtype;
+        output.dims  = tensor_dims(tensor);
+        size_t n     = shape_numel(output.dims);
+        output.ints.clear();
+        output.floats.clear();
+
+        if(!tensor.raw_data().empty()){
+            if(tensor.raw_data().size() != n * dtype_size(dtype)){
+                INFOE("Initializer %s raw_data size mismatch, %d != %d", tensor.name().c_str(), (int)tensor.raw_data().size(), (int)(n * dtype_size(dtype)));
+                return false;
+            }
+
+            auto& raw = tensor.raw_data();
+            switch(dtype){
+                case onnx::TensorProto::FLOAT:  read_raw<float>(raw, n, output.floats);   break;
+                case onnx::TensorProto::DOUBLE: read_raw<double>(raw, n, output.floats);  break;
+                case onnx::TensorProto::INT32:  read_raw<int32_t>(raw, n, output.ints);   break;
+                case onnx::TensorProto::INT64:  read_raw<int64_t>(raw, n, output.ints);   break;
+                case onnx::TensorProto::BOOL:   read_raw<uint8_t>(raw, n, output.ints);   break;
+            }
+            return true;
+        }
+
+        switch(dtype){
+            case onnx::TensorProto::FLOAT:  output.floats.assign(tensor.float_data().begin(),  tensor.float_data().end());  break;
+            case onnx::TensorProto::DOUBLE: output.floats.assign(tensor.double_data().begin(), tensor.double_data().end()); break;
+            case onnx::TensorProto::INT64:  output.ints.assign(tensor.int64_data().begin(),    tensor.int64_data().end());  break;
+            case onnx::TensorProto::INT32:
+            case onnx::TensorProto::BOOL:   output.ints.assign(tensor.int32_data().begin(),    tensor.int32_data().end());  break;
+        }
+        return output.numel() == n;
+    }
+
+    template<typename _T, typename _Source>
+    static void write_raw(const vector<_Source>& values, string& raw){
+        raw.resize(values.size() * sizeof(_T));
+        _T* p = (_T*)&raw[0];
+        for(size_t i = 0; i < values.size(); ++i)
+            p[i] = (_T)values[i];
+    }
+
+    void constant_to_tensor(const Constant& value, const string& name, onnx::TensorProto& output){
+
+        output.Clear();
+        output.set_name(name);
+        output.set_data_type(value.dtype);
+        for(auto& d : value.dims)
+            output.add_dims(d);
+
+        string* raw = output.mutable_raw_data();
+        switch(value.dtype){
+            case onnx::TensorProto::FLOAT:  write_raw<float>(value.floats, *raw);   break;
+            case onnx::TensorProto::DOUBLE: write_raw<double>(value.floats, *raw);  break;
+            case onnx::TensorProto::INT32:  write_raw<int32_t>(value.ints, *raw);   break;
+            case onnx::TensorProto::INT64:  write_raw<int64_t>(value.ints, *raw);   break;
+            case onnx::TensorProto::BOOL:   write_raw<uint8_t>(value.ints, *raw);   break;
+        }
+    }
+
+    const onnx::AttributeProto* find_attribute(const onnx::NodeProto& node, const string& name){
+        for(auto& attr : node.attribute()){
+            if(attr.name() == name)
+                return &attr;
+        }
+        return nullptr;
+    }
+
+    int64_t attribute_int(const onnx::NodeProto& node, const string& name, int64_t default_value){
+        auto attr = find_attribute(node, name);
+        return attr ? attr->i() : default_value;
+    }
+
+    float attribute_float(const onnx::NodeProto& node, const string& name, float default_value){
+        auto attr = find_attribute(node, name);
+        return attr ? attr->f() : default_value;
+    }
+
+    vector<int64_t> attribute_ints(const onnx::NodeProto& node, const string& name){
+        auto attr = find_attribute(node, name);
+        if(attr == nullptr) return {};
+        return vector<int64_t>(attr->ints().begin(), attr->ints().end());
+    }
+
+    string attribute_string(const onnx::NodeProto& node, const string& name, const string& default_value){
+        auto attr = find_attribute(node, name);
+        return attr ? attr->s() : default_value;
+    }
+
+    static void collect_graph_names(const onnx::GraphProto& graph, unordered_set<string>& names){
+        for(auto& node : graph.node()){
+            for(auto& input : node.input())
+                names.insert(input);
+
+            for(auto& attr : node.attribute()){
+                if(attr.has_g())
+                    collect_graph_names(attr.g(), names);
+
+                for(auto& g : attr.graphs())
+                    collect_graph_names(g, names);
+            }
+        }
+        for(auto& output : graph.output())
+            names.insert(output.name());
+    }
+
+    void collect_subgraph_references(const onnx::GraphProto& graph, unordered_set<string>& names){
+        for(auto& node : graph.node()){
+            for(auto& attr : node.attribute()){
+                if(attr.has_g())
+                    collect_graph_names(attr.g(), names);
+
+                for(auto& g : attr.graphs())
+                    collect_graph_names(g, names);
+            }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // shape inference
+    static int64_t normalize_axis(int64_t axis, int64_t rank){
+        return axis < 0 ? axis + rank : axis;
+    }
+
+    static bool broadcast_shapes(const Shape& a, const Shape& b, Shape& output){
+        size_t rank = max(a.size(), b.size());
+        output.resize(rank);
+        for(size_t i = 0; i < rank; ++i){
+            int64_t da = i < rank - a.size() ? 1 : a[i - (rank - a.size())];
+            int64_t db = i < rank - b.size() ? 1 : b[i - (rank - b.size())];
+            if(da == 1)       output[i] = db;
+            else if(db == 1)  output[i] = da;
+            else if(da == -1) output[i] = db;
+            else if(db == -1) output[i] = da;
+            else if(da == db) output[i] = da;
+            else return false;
+        }
+        return true;
+    }
+
+    static const Constant* find_constant(const unordered_map<string, Constant>* constants, const string& name){
+        if(constants == nullptr) return nullptr;
+        auto iter = constants->find(name);
+        return iter == constants->end() ? nullptr : &iter->second;
+    }
+
+    static bool constant_ints(const unordered_map<string, Constant>* constants, const string& name, vector<int64_t>& output){
+        auto c = find_constant(constants, name);
+        if(c == nullptr) return false;
+
+        output.resize(c->numel());
+        for(size_t i = 0; i < output.size(); ++i)
+            output[i] = c->int_at(i);
+        return true;
+    }
+
+    static bool pool_output_shape(const onnx::NodeProto& node, const Shape& x, const Shape& kernel, int64_t channels, Shape& output){
+
+        int nspatial = kernel.size();
+        if(x.size() != nspatial + 2) return false;
+
+        auto pads      = attribute_ints(node, "pads");
+        auto strides   = attribute_ints(node, "strides");
+        auto dilations = attribute_ints(node, "dilations");
+        auto auto_pad  = attribute_string(node, "auto_pad", "NOTSET");
+        bool ceil_mode = attribute_int(node, "ceil_mode", 0) != 0;
+
+        output.resize(x.size());
+        output[0] = x[0];
+        output[1] = channels;
+        for(int i = 0; i < nspatial; ++i){
+            int64_t in = x[i + 2];
+            int64_t s  = i < strides.size()   ? strides[i]   : 1;
+            int64_t d  = i < dilations.size() ? dilations[i] : 1;
+            if(in < 0){
+                output[i + 2] = -1;
+                continue;
+            }
+
+            if(auto_pad == "SAME_UPPER" || auto_pad == "SAME_LOWER"){
+                output[i + 2] = (in + s - 1) / s;
+                continue;
+            }
+
+            int64_t pad = 0;
+            if(auto_pad == "NOTSET" && pads.size() == nspatial * 2)
+                pad = pads[i] + pads[i + nspatial];
+
+            int64_t effective = d * (kernel[i] - 1) + 1;
+            int64_t numerator = in + pad - effective;
+            output[i + 2] = (ceil_mode ? (numerator + s - 1) / s : numerator / s) + 1;
+        }
+        return true;
+    }
+
+    static bool infer_node(
+        const onnx::NodeProto& node, TensorInfoMap& infos,
+        const unordered_map<string, Constant>* constants
+    ){
+        auto& op = node.op_type();
+        auto input_info = [&](int i) -> const TensorInfo* {
+            if(i >= node.input_size() || node.input(i).empty()) return nullptr;
+            auto iter = infos.find(node.input(i));
+            return iter == infos.end() ? nullptr : &iter->second;
+        };
+
+        auto set_output = [&](int i, int dtype, const Shape& shape){
+            if(i >= node.output_size() || node.output(i).empty()) return;
+            auto& info     = infos[node.output(i)];
+            info.dtype     = dtype;
+            info.shape     = shape;
+            info.has_shape = true;
+        };
+
+        auto x = input_info(0);
+        static const unordered_set<string> unary_ops{
+            "Relu", "Sigmoid", "Tanh", "LeakyRelu", "Elu", "Selu", "Clip", "Identity", "Dropout", "Softmax", "LogSoftmax",
+            "BatchNormalization", "InstanceNormalization", "HardSigmoid", "HardSwish", "Mish", "Softplus", "Softsign",
+            "Exp", "Log", "Sqrt", "Neg", "Abs", "Erf", "Floor", "Ceil", "Round", "Sign", "Not", "Reciprocal", "PRelu",
+            "LRN", "Sin", "Cos", "ThresholdedRelu", "Celu", "Gelu", "CumSum", "DequantizeLinear", "QuantizeLinear"
+        };
+
+        static const unordered_set<string> broadcast_ops{
+            "Add", "Sub", "Mul", "Div", "Pow", "Max", "Min", "Sum", "Mean", "Where", "Mod",
+            "Equal", "Less", "Greater", "LessOrEqual", "GreaterOrEqual", "And", "Or", "Xor", "BitShift"
+        };
+
+        static const unordered_set<string> compare_ops{
+            "Equal", "Less", "Greater", "LessOrEqual", "GreaterOrEqual", "And", "Or", "Xor", "Not"
+        };
+
+        if(op == "Constant"){
+            auto attr = find_attribute(node, "value");
+            if(attr && attr->has_t()){
+                set_output(0, attr->t().data_type(), tensor_dims(attr->t()));
+            }else if(find_attribute(node, "value_float")){
+                set_output(0, onnx::TensorProto::FLOAT, {});
+            }else if(find_attribute(node, "value_int")){
+                set_output(0, onnx::TensorProto::INT64, {});
+            }else if((attr = find_attribute(node, "value_floats"))){
+                set_output(0, onnx::TensorProto::FLOAT, {(int64_t)attr->floats_size()});
+            }else if((attr = find_attribute(node, "value_ints"))){
+                set_output(0, onnx::TensorProto::INT64, {(int64_t)attr->ints_size()});
+            }else{
+                return false;
+            }
+            return true;
+        }
+
+        if(op == "Shape"){
+            if(!x || !x->has_shape) return false;
+            int64_t rank  = x->shape.size();
+            int64_t start = normalize_axis(attribute_int(node, "start", 0), rank);
+            int64_t end   = find_attribute(node, "end") ? normalize_axis(attribute_int(node, "end", rank), rank) : rank;
+            start = max<int64_t>(0, min(start, rank));
+            end   = max<int64_t>(start, min(end, rank));
+            set_output(0, onnx::TensorProto::INT64, {end - start});
+            return true;
+        }
+
+        if(op == "Cast"){
+            if(!x || !x->has_shape) return false;
+            set_output(0, attribute_int(node, "to", onnx::TensorProto::FLOAT), x->shape);
+            return true;
+        }
+
+        if(unary_ops.count(op)){
+            if(!x || !x->has_shape) return false;
+            set_output(0, compare_ops.count(op) ? onnx::TensorProto::BOOL : x->dtype, x->shape);
+            if(op == "Dropout" && node.output_size() > 1)
+                set_output(1, onnx::TensorProto::BOOL, x->shape);
+            return true;
+        }
+
+        if(broadcast_ops.count(op)){
+            Shape output;
+            int dtype = onnx::TensorProto::UNDEFINED;
+            for(int i = 0; i < node.input_size(); ++i){
+                auto info = input_info(i);
+                if(!info || !info->has_shape) return false;
+
+                Shape next;
+                if(i == 0) next = info->shape;
+                else if(!broadcast_shapes(output, info->shape, next)) return false;
+                output.swap(next);
+
+                // Where的第0个输入是condition
+                if((op != "Where" && i == 0) || (op == "Where" && i == 1))
+                    dtype = info->dtype;
+            }
+            set_output(0, compare_ops.count(op) ? onnx::TensorProto::BOOL : dtype, output);
+            return true;
+        }
+
+        if(op == "Conv" || op == "MaxPool" || op == "AveragePool" || op == "LpPool"){
+            if(!x || !x->has_shape) return false;
+
+            Shape kernel   = attribute_ints(node, "kernel_shape");
+            int64_t channels = x->shape.size() > 1 ? x->shape[1] : -1;
+            if(op == "Conv"){
+                auto w = input_info(1);
+                if(!w || !w->has_shape || w->shape.size() < 3) return false;
+                channels = w->shape[0];
+                if(kernel.empty())
+                    kernel.assign(w->shape.begin() + 2, w->shape.end());
+            }
+
+            Shape output;
+            if(kernel.empty() || !pool_output_shape(node, x->shape, kernel, channels, output))
+                return false;
+
+            set_output(0, x->dtype, output);
+            if(op == "MaxPool" && node.output_size() > 1)
+                set_output(1, onnx::TensorProto::INT64, output);
+            return true;
+        }
+
+        if(op == "ConvTranspose"){
+            auto w = input_info(1);
+            if(!x || !x->has_shape || !w || !w->has_shape || w->shape.size() < 3) return false;
+
+            int nspatial    = w->shape.size() - 2;
+            auto pads       = attribute_ints(node, "pads");
+            auto strides    = attribute_ints(node, "strides");
+            auto dilations  = attribute_ints(node, "dilations");
+            auto out_pads   = attribute_ints(node, "output_padding");
+            auto out_shape  = attribute_ints(node, "output_shape");
+            int64_t group   = attribute_int(node, "group", 1);
+            if(x->shape.size() != nspatial + 2) return false;
+
+            Shape output(x->shape.size());
+            output[0] = x->shape[0];
+            output[1] = w->shape[1] * group;
+            for(int i = 0; i < nspatial; ++i){
+                int64_t in = x->shape[i + 2];
+                if(i < out_shape.size()){
+                    output[i + 2] = out_shape[i];
+                }else if(in < 0){
+                    output[i + 2] = -1;
+                }else{
+                    int64_t s   = i < strides.size()   ? strides[i]   : 1;
+                    int64_t d   = i < dilations.size() ? dilations[i] : 1;
+                    int64_t op_ = i < out_pads.size()  ? out_pads[i]  : 0;
+                    int64_t pad = pads.size() == nspatial * 2 ? pads[i] + pads[i + nspatial] : 0;
+                    output[i + 2] = s * (in - 1) + op_ + ((w->shape[i + 2] - 1) * d + 1) - pad;
+                }
+            }
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "GlobalAveragePool" || op == "GlobalMaxPool"){
+            if(!x || !x->has_shape || x->shape.size() < 2) return false;
+            Shape output = x->shape;
+            for(size_t i = 2; i < output.size(); ++i)
+                output[i] = 1;
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Gemm"){
+            auto b = input_info(1);
+            if(!x || !x->has_shape || !b || !b->has_shape || x->shape.size() != 2 || b->shape.size() != 2) return false;
+
+            bool ta = attribute_int(node, "transA", 0) != 0;
+            bool tb = attribute_int(node, "transB", 0) != 0;
+            set_output(0, x->dtype, {ta ? x->shape[1] : x->shape[0], tb ? b->shape[0] : b->shape[1]});
+            return true;
+        }
+
+        if(op == "MatMul"){
+            auto b = input_info(1);
+            if(!x || !x->has_shape || !b || !b->has_shape || x->shape.empty() || b->shape.empty()) return false;
+
+            Shape a_shape = x->shape;
+            Shape b_shape = b->shape;
+            bool a_vector = a_shape.size() == 1;
+            bool b_vector = b_shape.size() == 1;
+            if(a_vector) a_shape.insert(a_shape.begin(), 1);
+            if(b_vector) b_shape.push_back(1);
+
+            Shape batch;
+            Shape a_batch(a_shape.begin(), a_shape.end() - 2);
+            Shape b_batch(b_shape.begin(), b_shape.end() - 2);
+            if(!broadcast_shapes(a_batch, b_batch, batch)) return false;
+
+            Shape output = batch;
+            if(!a_vector) output.push_back(a_shape[a_shape.size() - 2]);
+            if(!b_vector) output.push_back(b_shape.back());
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Flatten"){
+            if(!x || !x->has_shape) return false;
+            int64_t rank = x->shape.size();
+            int64_t axis = normalize_axis(attribute_int(node, "axis", 1), rank);
+            int64_t left  = shape_numel(Shape(x->shape.begin(), x->shape.begin() + axis));
+            int64_t right = shape_numel(Shape(x->shape.begin() + axis, x->shape.end()));
+            set_output(0, x->dtype, {left == 0 ? -1 : left, right == 0 ? -1 : right});
+            return true;
+        }
+
+        if(op == "Reshape"){
+            vector<int64_t> target;
+            if(!x || !x->has_shape || !constant_ints(constants, node.input(1), target)) return false;
+
+            bool allowzero = attribute_int(node, "allowzero", 0) != 0;
+            Shape output(target.size());
+            int infer_index = -1;
+            for(size_t i = 0; i < target.size(); ++i){
+                if(target[i] == 0 && !allowzero)
+                    output[i] = i < x->shape.size() ? x->shape[i] : -1;
+                else if(target[i] == -1){
+                    infer_index = i;
+                    output[i]   = -1;
+                }else
+                    output[i] = target[i];
+            }
+
+            if(infer_index != -1){
+                size_t total = shape_numel(x->shape);
+                Shape others = output;
+                others.erase(others.begin() + infer_index);
+                size_t known = shape_numel(others);
+                if(total > 0 && known > 0)
+                    output[infer_index] = total / known;
+            }
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Transpose"){
+            if(!x || !x->has_shape) return false;
+            auto perm = attribute_ints(node, "perm");
+            int64_t rank = x->shape.size();
+            if(perm.empty()){
+                for(int64_t i = rank - 1; i >= 0; --i)
+                    perm.push_back(i);
+            }
+            if(perm.size() != rank) return false;
+
+            Shape output(rank);
+            for(int64_t i = 0; i < rank; ++i)
+                output[i] = x->shape[normalize_axis(perm[i], rank)];
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Concat"){
+            if(!x || !x->has_shape) return false;
+            int64_t rank = x->shape.size();
+            int64_t axis = normalize_axis(attribute_int(node, "axis", 0), rank);
+            if(axis < 0 || axis >= rank) return false;
+
+            Shape output = x->shape;
+            for(int i = 1; i < node.input_size(); ++i){
+                auto info = input_info(i);
+                if(!info || !info->has_shape || info->shape.size() != rank) return false;
+
+                for(int64_t j = 0; j < rank; ++j){
+                    if(j == axis){
+                        output[j] = (output[j] < 0 || info->shape[j] < 0) ? -1 : output[j] + info->shape[j];
+                    }else if(output[j] < 0){
+                        output[j] = info->shape[j];
+                    }
+                }
+            }
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Unsqueeze" || op == "Squeeze"){
+            if(!x || !x->has_shape) return false;
+
+            vector<int64_t> axes = attribute_ints(node, "axes");
+            if(node.input_size() > 1 && !node.input(1).empty() && !constant_ints(constants, node.input(1), axes))
+                return false;
+
+            Shape output = x->shape;
+            if(op == "Unsqueeze"){
+                int64_t rank = x->shape.size() + axes.size();
+                for(auto& a : axes) a = normalize_axis(a, rank);
+                sort(axes.begin(), axes.end());
+                for(auto& a : axes){
+                    if(a > output.size()) return false;
+                    output.insert(output.begin() + a, 1);
+                }
+            }else{
+                int64_t rank = x->shape.size();
+                output.clear();
+                for(int64_t i = 0; i < rank; ++i){
+                    bool squeeze = false;
+                    if(axes.empty()){
+                        if(x->shape[i] < 0) return false;
+                        squeeze = x->shape[i] == 1;
+                    }else{
+                        for(auto& a : axes)
+                            squeeze |= normalize_axis(a, rank) == i;
+                    }
+                    if(!squeeze) output.push_back(x->shape[i]);
+                }
+            }
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Slice"){
+            if(!x || !x->has_shape) return false;
+
+            vector<int64_t> starts, ends, axes, steps;
+            if(node.input_size() > 1){
+                if(!constant_ints(constants, node.input(1), starts) || !constant_ints(constants, node.input(2), ends))
+                    return false;
+                if(node.input_size() > 3 && !node.input(3).empty() && !constant_ints(constants, node.input(3), axes))
+                    return false;
+                if(node.input_size() > 4 && !node.input(4).empty() && !constant_ints(constants, node.input(4), steps))
+                    return false;
+            }else{
+                starts = attribute_ints(node, "starts");
+                ends   = attribute_ints(node, "ends");
+                axes   = attribute_ints(node, "axes");
+            }
+
+            int64_t rank = x->shape.size();
+            if(axes.empty()){
+                for(size_t i = 0; i < starts.size(); ++i)
+                    axes.push_back(i);
+            }
+
+            Shape output = x->shape;
+            for(size_t i = 0; i < axes.size() && i < starts.size() && i < ends.size(); ++i){
+                int64_t axis = normalize_axis(axes[i], rank);
+                int64_t dim  = x->shape[axis];
+                int64_t step = i < steps.size() ? steps[i] : 1;
+                if(dim < 0 || step == 0){
+                    output[axis] = -1;
+                    continue;
+                }
+
+                int64_t s = starts[i] < 0 ? starts[i] + dim : starts[i];
+                int64_t e = ends[i]   < 0 ? ends[i]   + dim : ends[i];
+                if(step > 0){
+                    s = max<int64_t>(0, min(s, dim));
+                    e = max<int64_t>(0, min(e, dim));
+                    output[axis] = e > s ? (e - s + step - 1) / step : 0;
+                }else{
+                    s = max<int64_t>(-1, min(s, dim - 1));
+                    e = max<int64_t>(-1, min(e, dim - 1));
+                    output[axis] = s > e ? (s - e - step - 1) / -step : 0;
+                }
+            }
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Split"){
+            if(!x || !x->has_shape) return false;
+            int64_t rank = x->shape.size();
+            int64_t axis = normalize_axis(attribute_int(node, "axis", 0), rank);
+            vector<int64_t> split = attribute_ints(node, "split");
+            if(node.input_size() > 1 && !node.input(1).empty() && !constant_ints(constants, node.input(1), split))
+                return false;
+
+            int noutput = node.output_size();
+            if(split.empty()){
+                int64_t dim = x->shape[axis];
+                split.assign(noutput, dim < 0 ? -1 : dim / noutput);
+            }
+
+            for(int i = 0; i < noutput && i < split.size(); ++i){
+                Shape output = x->shape;
+                output[axis] = split[i];
+                set_output(i, x->dtype, output);
+            }
+            return true;
+        }
+
+        if(op == "Resize" || op == "Upsample"){
+            if(!x || !x->has_shape) return false;
+
+            vector<int64_t> sizes;
+            auto scales_name = op == "Upsample" ? (node.input_size() > 1 ? node.input(1) : string())
+                                                : (node.input_size() > 2 ? node.input(2) : string());
+            Shape output = x->shape;
+            if(op == "Resize" && node.input_size() > 3 && constant_ints(constants, node.input(3), sizes) && sizes.size() == x->shape.size()){
+                output.assign(sizes.begin(), sizes.end());
+            }else{
+                auto scales = find_constant(constants, scales_name);
+                if(scales == nullptr || scales->numel() != x->shape.size()) return false;
+
+                for(size_t i = 0; i < output.size(); ++i)
+                    output[i] = output[i] < 0 ? -1 : (int64_t)(output[i] * scales->float_at(i));
+            }
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "ReduceMean" || op == "ReduceSum" || op == "ReduceMax" || op == "ReduceMin" || op == "ReduceProd" ||
+           op == "ReduceL2" || op == "ReduceL1" || op == "ArgMax" || op == "ArgMin"){
+            if(!x || !x->has_shape) return false;
+
+            int64_t rank     = x->shape.size();
+            bool keepdims    = attribute_int(node, "keepdims", 1) != 0;
+            vector<int64_t> axes;
+            if(op == "ArgMax" || op == "ArgMin"){
+                axes.push_back(attribute_int(node, "axis", 0));
+            }else{
+                axes = attribute_ints(node, "axes");
+                if(node.input_size() > 1 && !node.input(1).empty() && !constant_ints(constants, node.input(1), axes))
+                    return false;
+            }
+
+            Shape output;
+            for(int64_t i = 0; i < rank; ++i){
+                bool reduce = axes.empty();
+                for(auto& a : axes)
+                    reduce |= normalize_axis(a, rank) == i;
+
+                if(!reduce)
+                    output.push_back(x->shape[i]);
+                else if(keepdims)
+                    output.push_back(1);
+            }
+            bool arg = op == "ArgMax" || op == "ArgMin";
+            set_output(0, arg ? onnx::TensorProto::INT64 : x->dtype, output);
+            return true;
+        }
+
+        if(op == "Gather"){
+            auto indices = input_info(1);
+            if(!x || !x->has_shape || !indices || !indices->has_shape) return false;
+
+            int64_t rank = x->shape.size();
+            int64_t axis = normalize_axis(attribute_int(node, "axis", 0), rank);
+            Shape output(x->shape.begin(), x->shape.begin() + axis);
+            output.insert(output.end(), indices->shape.begin(), indices->shape.end());
+            output.insert(output.end(), x->shape.begin() + axis + 1, x->shape.end());
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Pad"){
+            if(!x || !x->has_shape) return false;
+
+            vector<int64_t> pads = attribute_ints(node, "pads");
+            if(node.input_size() > 1 && !node.input(1).empty() && !constant_ints(constants, node.input(1), pads))
+                return false;
+
+            int64_t rank = x->shape.size();
+            if(pads.size() != rank * 2) return false;
+
+            Shape output = x->shape;
+            for(int64_t i = 0; i < rank; ++i)
+                output[i] = output[i] < 0 ? -1 : output[i] + pads[i] + pads[i + rank];
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Expand"){
+            vector<int64_t> target;
+            if(!x || !x->has_shape || !constant_ints(constants, node.input(1), target)) return false;
+
+            Shape output;
+            if(!broadcast_shapes(x->shape, Shape(target.begin(), target.end()), output)) return false;
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "Tile"){
+            vector<int64_t> repeats;
+            if(!x || !x->has_shape || !constant_ints(constants, node.input(1), repeats) || repeats.size() != x->shape.size()) return false;
+
+            Shape output = x->shape;
+            for(size_t i = 0; i < output.size(); ++i)
+                output[i] = output[i] < 0 ? -1 : output[i] * repeats[i];
+            set_output(0, x->dtype, output);
+            return true;
+        }
+
+        if(op == "ConstantOfShape"){
+            vector<int64_t> target;
+            if(!constant_ints(constants, node.input(0), target)) return false;
+
+            auto attr  = find_attribute(node, "value");
+            int dtype  = attr && attr->has_t() ? attr->t().data_type() : onnx::TensorProto::FLOAT;
+            set_output(0, dtype, Shape(target.begin(), target.end()));
+            return true;
+        }
+
+        if(op == "Range"){
+            auto start = find_constant(constants, node.input(0));
+            auto limit = find_constant(constants, node.input(1));
+            auto delta = find_constant(constants, node.input(2));
+            if(!start || !limit || !delta || start->numel() != 1 || limit->numel() != 1 || delta->numel() != 1) return false;
+
+            double n = ceil((limit->float_at(0) - start->float_at(0)) / delta->float_at(0));
+            set_output(0, start->dtype, {max<int64_t>(0, (int64_t)n)});
+            return true;
+        }
+        return false;
+    }
+
+    TensorInfoMap infer_shapes(
+        const onnx::GraphProto& graph, bool dynamic_batch,
+        const unordered_map<string, Constant>* constants,
+        const unordered_map<string, Shape>* input_shapes
+    ){
+        TensorInfoMap infos;
+        for(auto& initializer : graph.initializer()){
+            auto& info     = infos[initializer.name()];
+            info.dtype     = initializer.data_type();
+            info.shape     = tensor_dims(initializer);
+            info.has_shape = true;
+        }
+
+        for(auto& input : graph.input()){
+            if(infos.count(input.name())) continue;
+
+            auto& info     = infos[input.name()];
+            info.dtype     = input.type().tensor_type().elem_type();
+            info.has_shape = input.type().tensor_type().has_shape();
+            info.shape     = value_info_shape(input);
+            if(dynamic_batch && !info.shape.empty())
+                info.shape[0] = -1;
+
+            if(input_shapes){
+                auto iter = input_shapes->find(input.name());
+                if(iter != input_shapes->end()){
+                    info.shape     = iter->second;
+                    info.has_shape = true;
+                }
+            }
+        }
+
+        unordered_map<string, const onnx::ValueInfoProto*> value_infos;
+        for(auto& info : graph.value_info())
+            value_infos[info.name()] = &info;
+
+        for(auto& node : graph.node()){
+            if(infer_node(node, infos, constants)) continue;
+
+            // 推导失败的算子输出记为未知形状，后续依赖它的算子也会失败
+            // dynamic_batch = false时，用value_info里的形状作为补充
+            for(auto& output : node.output()){
+                if(output.empty()) continue;
+
+                auto& item = infos[output];
+                auto iter  = value_infos.find(output);
+                if(iter == value_infos.end()) continue;
+
+                auto& tensor_type = iter->second->type().tensor_type();
+                item.dtype = tensor_type.elem_type();
+                if(!dynamic_batch && tensor_type.has_shape()){
+                    item.shape     = value_info_shape(*iter->second);
+                    item.has_shape = true;
+                }
+            }
+        }
+        return infos;
+    }
+
+}; // namespace ONNXOptimizer
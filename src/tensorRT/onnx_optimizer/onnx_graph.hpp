@@ -0,0 +1,77 @@
+#ifndef ONNX_GRAPH_HPP
+#define ONNX_GRAPH_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <onnx/onnx_pb.h>
+
+/**
+ * @brief onnx图的CPU侧公共工具：常量张量的读写、属性读取、以及常见算子的形状推导
+ * 形状中-1表示未知（动态）的维度
+ */
+namespace ONNXOptimizer{
+
+    typedef std::vector<int64_t> Shape;
+
+    // 可以在CPU上参与计算的常量，整数类型存放在ints，浮点类型存放在floats
+    struct Constant{
+        int dtype = onnx::TensorProto::FLOAT;
+        Shape dims;
+        std::vector<int64_t> ints;
+        std::vector<double>  floats;
+
+        bool is_integer() const;
+        size_t numel() const;
+        int64_t int_at(size_t i) const;
+        double float_at(size_t i) const;
+        void resize(size_t n);
+    };
+
+    struct TensorInfo{
+        int dtype      = onnx::TensorProto::UNDEFINED;
+        bool has_shape = false;
+        Shape shape;
+
+        bool is_static() const;
+    };
+
+    typedef std::unordered_map<std::string, TensorInfo> TensorInfoMap;
+
+    size_t shape_numel(const Shape& shape);
+    std::string shape_string(const Shape& shape);
+    int dtype_size(int dtype);
+    bool is_foldable_dtype(int dtype);
+
+    // 读取TensorProto到Constant，不支持的类型或者外部数据返回false
+    bool tensor_to_constant(const onnx::TensorProto& tensor, Constant& output);
+    void constant_to_tensor(const Constant& value, const std::string& name, onnx::TensorProto& output);
+
+    Shape tensor_dims(const onnx::TensorProto& tensor);
+    Shape value_info_shape(const onnx::ValueInfoProto& info);
+
+    const onnx::AttributeProto* find_attribute(const onnx::NodeProto& node, const std::string& name);
+    int64_t attribute_int(const onnx::NodeProto& node, const std::string& name, int64_t default_value);
+    float attribute_float(const onnx::NodeProto& node, const std::string& name, float default_value);
+    std::vector<int64_t> attribute_ints(const onnx::NodeProto& node, const std::string& name);
+    std::string attribute_string(const onnx::NodeProto& node, const std::string& name, const std::string& default_value = "");
+
+    // 所有子图（Loop/If/Scan的graph属性）里引用的名字，这些名字不允许被重命名
+    void collect_subgraph_references(const onnx::GraphProto& graph, std::unordered_set<std::string>& names);
+
+    /**
+     * 对图做一次前向的形状推导
+     * dynamic_batch = true时，graph.input的第0维视为动态，并且不信任value_info里的形状（导出时batch常被固定为1）
+     * constants 提供已知常量（Reshape的shape等）的值，可以为nullptr
+     * input_shapes 指定graph.input的形状，优先于dynamic_batch和graph中记录的形状，可以为nullptr
+     */
+    TensorInfoMap infer_shapes(
+        const onnx::GraphProto& graph, bool dynamic_batch = true,
+        const std::unordered_map<std::string, Constant>* constants = nullptr,
+        const std::unordered_map<std::string, Shape>* input_shapes = nullptr
+    );
+
+}; // namespace ONNXOptimizer
+
+#endif // ONNX_GRAPH_HPP
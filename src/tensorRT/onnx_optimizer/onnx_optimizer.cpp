@@ -0,0 +1,1183 @@
+
+#include "onnx_optimizer.hpp"
+#include "onnx_graph.hpp"
+#include <common/ilogger.hpp>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <math.h>
+
+namespace ONNXOptimizer{
+
+    using namespace std;
+
+    const char* pass_name(Pass pass){
+        switch(pass){
+            case Pass::ExporterCleanup:     return "ExporterCleanup";
+            case Pass::ConstantFolding:     return "ConstantFolding";
+            case Pass::EliminateIdentity:   return "EliminateIdentity";
+            case Pass::ShapeSimplify:       return "ShapeSimplify";
+            case Pass::DeadNodeElimination: return "DeadNodeElimination";
+            default: return "UnknowPass";
+        }
+    }
+
+    string Report::summary() const{
+        string output = iLogger::format(
+            "nodes %d -> %d, initializers %d -> %d, model %.2f MB -> %.2f MB, %d iterations, %.2f ms",
+            num_nodes_before, num_nodes_after, num_initializers_before, num_initializers_after,
+            model_bytes_before / 1024.0f / 1024.0f, model_bytes_after / 1024.0f / 1024.0f, num_iterations, time_ms
+        );
+
+        for(auto& item : passes)
+            output += iLogger::format("\n    %s %d changes, %.2f ms", iLogger::align_blank(pass_name(item.pass), 20).c_str(), item.num_changes, item.time_ms);
+        return output;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // constant evaluation
+    static vector<int64_t> compute_strides(const Shape& dims){
+        vector<int64_t> strides(dims.size(), 1);
+        for(int i = (int)dims.size() - 2; i >= 0; --i)
+            strides[i] = strides[i + 1] * dims[i + 1];
+        return strides;
+    }
+
+    static bool next_index(vector<int64_t>& index, const Shape& dims){
+        for(int i = (int)dims.size() - 1; i >= 0; --i){
+            if(++index[i] < dims[i]) return true;
+            index[i] = 0;
+        }
+        return false;
+    }
+
+    static void copy_element(const Constant& src, size_t isrc, Constant& dst, size_t idst){
+        if(dst.is_integer()) dst.ints[idst]   = src.int_at(isrc);
+        else                 dst.floats[idst] = src.float_at(isrc);
+    }
+
+    static int64_t normalize_axis(int64_t axis, int64_t rank){
+        return axis < 0 ? axis + rank : axis;
+    }
+
+    static bool constant_axes(const onnx::NodeProto& node, const vector<const Constant*>& inputs, int index, vector<int64_t>& axes){
+        axes = attribute_ints(node, "axes");
+        if(index < (int)inputs.size() && inputs[index]){
+            axes.resize(inputs[index]->numel());
+            for(size_t i = 0; i < axes.size(); ++i)
+                axes[i] = inputs[index]->int_at(i);
+        }
+        return true;
+    }
+
+    static bool eval_binary(const string& op, const Constant& a, const Constant& b, Constant& output){
+
+        if(a.is_integer() != b.is_integer()) return false;
+
+        size_t rank = max(a.dims.size(), b.dims.size());
+        Shape dims(rank), sa(rank, 1), sb(rank, 1);
+        for(size_t i = 0; i < rank; ++i){
+            int64_t da = i < rank - a.dims.size() ? 1 : a.dims[i - (rank - a.dims.size())];
+            int64_t db = i < rank - b.dims.size() ? 1 : b.dims[i - (rank - b.dims.size())];
+            if(da != db && da != 1 && db != 1) return false;
+            dims[i] = max(da, db);
+            sa[i] = da;
+            sb[i] = db;
+        }
+
+        auto stride_a = compute_strides(sa);
+        auto stride_b = compute_strides(sb);
+        for(size_t i = 0; i < rank; ++i){
+            if(sa[i] == 1) stride_a[i] = 0;
+            if(sb[i] == 1) stride_b[i] = 0;
+        }
+
+        output.dtype = a.dtype;
+        output.dims  = dims;
+        size_t n     = shape_numel(dims);
+        output.resize(n);
+        if(n == 0) return true;
+
+        vector<int64_t> index(rank, 0);
+        for(size_t i = 0; i < n; ++i){
+            size_t ia = 0, ib = 0;
+            for(size_t j = 0; j < rank; ++j){
+                ia += index[j] * stride_a[j];
+                ib += index[j] * stride_b[j];
+            }
+
+            if(output.is_integer()){
+                int64_t x = a.ints[ia], y = b.ints[ib];
+                if(op == "Add")      output.ints[i] = x + y;
+                else if(op == "Sub") output.ints[i] = x - y;
+                else if(op == "Mul") output.ints[i] = x * y;
+                else if(op == "Div"){
+                    if(y == 0) return false;
+                    output.ints[i] = x / y;
+                }
+            }else{
+                double x = a.floats[ia], y = b.floats[ib];
+                if(op == "Add")      output.floats[i] = x + y;
+                else if(op == "Sub") output.floats[i] = x - y;
+                else if(op == "Mul") output.floats[i] = x * y;
+                else if(op == "Div") output.floats[i] = x / y;
+            }
+            next_index(index, dims);
+        }
+        return true;
+    }
+
+    static bool eval_gather(const onnx::NodeProto& node, const Constant& data, const Constant& indices, Constant& output){
+
+        int64_t rank = data.dims.size();
+        if(rank == 0) return false;
+
+        int64_t axis     = normalize_axis(attribute_int(node, "axis", 0), rank);
+        int64_t axis_dim = data.dims[axis];
+        size_t outer     = shape_numel(Shape(data.dims.begin(), data.dims.begin() + axis));
+        size_t inner     = shape_numel(Shape(data.dims.begin() + axis + 1, data.dims.end()));
+        size_t nindices  = indices.numel();
+
+        output.dtype = data.dtype;
+        output.dims.assign(data.dims.begin(), data.dims.begin() + axis);
+        output.dims.insert(output.dims.end(), indices.dims.begin(), indices.dims.end());
+        output.dims.insert(output.dims.end(), data.dims.begin() + axis + 1, data.dims.end());
+        output.resize(outer * nindices * inner);
+
+        for(size_t o = 0; o < outer; ++o){
+            for(size_t j = 0; j < nindices; ++j){
+                int64_t index = indices.int_at(j);
+                if(index < 0) index += axis_dim;
+                if(index < 0 || index >= axis_dim) return false;
+
+                size_t src = (o * axis_dim + index) * inner;
+                size_t dst = (o * nindices + j) * inner;
+                for(size_t k = 0; k < inner; ++k)
+                    copy_element(data, src + k, output, dst + k);
+            }
+        }
+        return true;
+    }
+
+    static bool eval_slice(const onnx::NodeProto& node, const vector<const Constant*>& inputs, Constant& output){
+
+        auto& data = *inputs[0];
+        vector<int64_t> starts, ends, axes, steps;
+        auto read = [&](int i, vector<int64_t>& values){
+            if(i >= (int)inputs.size() || inputs[i] == nullptr) return;
+            values.resize(inputs[i]->numel());
+            for(size_t k = 0; k < values.size(); ++k)
+                values[k] = inputs[i]->int_at(k);
+        };
+
+        if(inputs.size() > 1){
+            read(1, starts); read(2, ends); read(3, axes); read(4, steps);
+        }else{
+            starts = attribute_ints(node, "starts");
+            ends   = attribute_ints(node, "ends");
+            axes   = attribute_ints(node, "axes");
+        }
+
+        int64_t rank = data.dims.size();
+        if(axes.empty()){
+            for(size_t i = 0; i < starts.size(); ++i)
+                axes.push_back(i);
+        }
+        if(starts.size() != ends.size() || axes.size() != starts.size()) return false;
+
+        vector<int64_t> begin(rank, 0), step(rank, 1);
+        Shape dims = data.dims;
+        for(size_t i = 0; i < axes.size(); ++i){
+            int64_t axis = normalize_axis(axes[i], rank);
+            if(axis < 0 || axis >= rank) return false;
+
+            int64_t dim = data.dims[axis];
+            int64_t st  = i < steps.size() ? steps[i] : 1;
+            if(st == 0) return false;
+
+            int64_t s = starts[i] < 0 ? starts[i] + dim : starts[i];
+            int64_t e = ends[i]   < 0 ? ends[i]   + dim : ends[i];
+            int64_t count = 0;
+            if(st > 0){
+                s = max<int64_t>(0, min(s, dim));
+                e = max<int64_t>(0, min(e, dim));
+                count = e > s ? (e - s + st - 1) / st : 0;
+            }else{
+                s = max<int64_t>(-1, min(s, dim - 1));
+                e = max<int64_t>(-1, min(e, dim - 1));
+                count = s > e ? (s - e - st - 1) / -st : 0;
+            }
+            begin[axis] = s;
+            step[axis]  = st;
+            dims[axis]  = count;
+        }
+
+        output.dtype = data.dtype;
+        output.dims  = dims;
+        size_t n     = shape_numel(dims);
+        output.resize(n);
+        if(n == 0) return true;
+
+        auto strides = compute_strides(data.dims);
+        vector<int64_t> index(rank, 0);
+        for(size_t i = 0; i < n; ++i){
+            size_t src = 0;
+            for(int64_t j = 0; j < rank; ++j)
+                src += (begin[j] + index[j] * step[j]) * strides[j];
+            copy_element(data, src, output, i);
+            next_index(index, dims);
+        }
+        return true;
+    }
+
+    static bool eval_concat(const onnx::NodeProto& node, const vector<const Constant*>& inputs, Constant& output){
+
+        auto& first  = *inputs[0];
+        int64_t rank = first.dims.size();
+        int64_t axis = normalize_axis(attribute_int(node, "axis", 0), rank);
+        if(axis < 0 || axis >= rank) return false;
+
+        output.dtype = first.dtype;
+        output.dims  = first.dims;
+        output.dims[axis] = 0;
+        for(auto& item : inputs){
+            if((int64_t)item->dims.size() != rank || item->is_integer() != first.is_integer()) return false;
+            output.dims[axis] += item->dims[axis];
+        }
+
+        size_t outer = shape_numel(Shape(first.dims.begin(), first.dims.begin() + axis));
+        output.resize(shape_numel(output.dims));
+
+        size_t cursor = 0;
+        for(size_t o = 0; o < outer; ++o){
+            for(auto& item : inputs){
+                size_t block = shape_numel(Shape(item->dims.begin() + axis, item->dims.end()));
+                for(size_t k = 0; k < block; ++k)
+                    copy_element(*item, o * block + k, output, cursor++);
+            }
+        }
+        return true;
+    }
+
+    static bool eval_transpose(const onnx::NodeProto& node, const Constant& data, Constant& output){
+
+        int64_t rank = data.dims.size();
+        auto perm    = attribute_ints(node, "perm");
+        if(perm.empty()){
+            for(int64_t i = rank - 1; i >= 0; --i)
+                perm.push_back(i);
+        }
+        if((int64_t)perm.size() != rank) return false;
+
+        output.dtype = data.dtype;
+        output.dims.resize(rank);
+        for(int64_t i = 0; i < rank; ++i)
+            output.dims[i] = data.dims[perm[i]];
+
+        size_t n = data.numel();
+        output.resize(n);
+        if(n == 0) return true;
+
+        auto strides = compute_strides(data.dims);
+        vector<int64_t> index(rank, 0);
+        for(size_t i = 0; i < n; ++i){
+            size_t src = 0;
+            for(int64_t j = 0; j < rank; ++j)
+                src += index[j] * strides[perm[j]];
+            copy_element(data, src, output, i);
+            next_index(index, output.dims);
+        }
+        return true;
+    }
+
+    static bool eval_reshape(const onnx::NodeProto& node, const Constant& data, const Constant& shape, Constant& output){
+
+        bool allowzero = attribute_int(node, "allowzero", 0) != 0;
+        Shape dims(shape.numel());
+        int infer_index = -1;
+        for(size_t i = 0; i < dims.size(); ++i){
+            int64_t v = shape.int_at(i);
+            if(v == 0 && !allowzero){
+                if(i >= data.dims.size()) return false;
+                v = data.dims[i];
+            }else if(v == -1){
+                if(infer_index != -1) return false;
+                infer_index = i;
+                v = 1;
+            }
+            dims[i] = v;
+        }
+
+        size_t n = data.numel();
+        if(infer_index != -1){
+            size_t known = shape_numel(dims);
+            if(known == 0) return false;
+            dims[infer_index] = n / known;
+        }
+
+        if(shape_numel(dims) != n) return false;
+        output      = data;
+        output.dims = dims;
+        return true;
+    }
+
+    static bool eval_cast(const Constant& data, int to, Constant& output){
+        if(!is_foldable_dtype(to)) return false;
+
+        output.dtype = to;
+        output.dims  = data.dims;
+        size_t n     = data.numel();
+        output.resize(n);
+        for(size_t i = 0; i < n; ++i){
+            if(to == onnx::TensorProto::BOOL)
+                output.ints[i] = data.float_at(i) != 0;
+            else if(output.is_integer())
+                output.ints[i] = data.is_integer() ? data.ints[i] : (int64_t)data.floats[i];
+            else
+                output.floats[i] = to == onnx::TensorProto::FLOAT ? (float)data.float_at(i) : data.float_at(i);
+        }
+        return true;
+    }
+
+    // 输入全部为常量时计算节点输出，不支持的算子返回false
+    static bool eval_node(const onnx::NodeProto& node, const vector<const Constant*>& inputs, vector<Constant>& outputs){
+
+        auto& op = node.op_type();
+        outputs.resize(1);
+        auto& output = outputs[0];
+
+        if(inputs.empty() || inputs[0] == nullptr){
+            if(op != "Constant") return false;
+        }
+
+        if(op == "Identity"){
+            output = *inputs[0];
+            return true;
+        }
+
+        if(op == "Cast")
+            return eval_cast(*inputs[0], attribute_int(node, "to", onnx::TensorProto::FLOAT), output);
+
+        if(op == "Add" || op == "Sub" || op == "Mul" || op == "Div"){
+            if(inputs.size() != 2 || !inputs[1]) return false;
+            return eval_binary(op, *inputs[0], *inputs[1], output);
+        }
+
+        if(op == "Gather"){
+            if(inputs.size() != 2 || !inputs[1]) return false;
+            return eval_gather(node, *inputs[0], *inputs[1], output);
+        }
+
+        if(op == "Slice")
+            return eval_slice(node, inputs, output);
+
+        if(op == "Concat"){
+            for(auto& item : inputs)
+                if(item == nullptr) return false;
+            return eval_concat(node, inputs, output);
+        }
+
+        if(op == "Transpose")
+            return eval_transpose(node, *inputs[0], output);
+
+        if(op == "Reshape"){
+            if(inputs.size() != 2 || !inputs[1]) return false;
+            return eval_reshape(node, *inputs[0], *inputs[1], output);
+        }
+
+        if(op == "Flatten"){
+            auto& data   = *inputs[0];
+            int64_t rank = data.dims.size();
+            int64_t axis = normalize_axis(attribute_int(node, "axis", 1), rank);
+            output = data;
+            output.dims = {
+                (int64_t)shape_numel(Shape(data.dims.begin(), data.dims.begin() + axis)),
+                (int64_t)shape_numel(Shape(data.dims.begin() + axis, data.dims.end()))
+            };
+            return true;
+        }
+
+        if(op == "Unsqueeze" || op == "Squeeze"){
+            auto& data = *inputs[0];
+            vector<int64_t> axes;
+            constant_axes(node, inputs, 1, axes);
+
+            output = data;
+            if(op == "Unsqueeze"){
+                int64_t rank = data.dims.size() + axes.size();
+                for(auto& a : axes) a = normalize_axis(a, rank);
+                sort(axes.begin(), axes.end());
+                for(auto& a : axes){
+                    if(a < 0 || a > (int64_t)output.dims.size()) return false;
+                    output.dims.insert(output.dims.begin() + a, 1);
+                }
+            }else{
+                int64_t rank = data.dims.size();
+                output.dims.clear();
+                for(int64_t i = 0; i < rank; ++i){
+                    bool squeeze = axes.empty() && data.dims[i] == 1;
+                    for(auto& a : axes)
+                        squeeze |= normalize_axis(a, rank) == i;
+
+                    if(squeeze && data.dims[i] != 1) return false;
+                    if(!squeeze) output.dims.push_back(data.dims[i]);
+                }
+            }
+            return true;
+        }
+
+        if(op == "ConstantOfShape"){
+            auto& shape = *inputs[0];
+            output.dtype = onnx::TensorProto::FLOAT;
+            output.dims.resize(shape.numel());
+            for(size_t i = 0; i < output.dims.size(); ++i)
+                output.dims[i] = shape.int_at(i);
+
+            Constant value;
+            value.floats = {0};
+            auto attr = find_attribute(node, "value");
+            if(attr && attr->has_t() && !tensor_to_constant(attr->t(), value))
+                return false;
+
+            if(value.numel() != 1) return false;
+            output.dtype = value.dtype;
+            output.resize(shape_numel(output.dims));
+            for(size_t i = 0; i < output.numel(); ++i)
+                copy_element(value, 0, output, i);
+            return true;
+        }
+
+        if(op == "Range"){
+            if(inputs.size() != 3 || !inputs[1] || !inputs[2]) return false;
+            auto& start = *inputs[0];
+            auto& limit = *inputs[1];
+            auto& delta = *inputs[2];
+            if(start.numel() != 1 || limit.numel() != 1 || delta.numel() != 1 || delta.float_at(0) == 0) return false;
+
+            int64_t n = max<int64_t>(0, (int64_t)ceil((limit.float_at(0) - start.float_at(0)) / delta.float_at(0)));
+            output.dtype = start.dtype;
+            output.dims  = {n};
+            output.resize(n);
+            for(int64_t i = 0; i < n; ++i){
+                if(output.is_integer()) output.ints[i]   = start.ints[0] + i * delta.int_at(0);
+                else                    output.floats[i] = start.floats[0] + i * delta.float_at(0);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // graph helpers
+    class GraphEditor{
+    public:
+        GraphEditor(onnx::GraphProto* graph, int64_t ir_version, const Options& options)
+        :graph_(graph), ir_version_(ir_version), options_(options){
+            refresh();
+        }
+
+        void refresh(){
+            protected_.clear();
+            for(auto& output : graph_->output())
+                protected_.insert(output.name());
+            collect_subgraph_references(*graph_, protected_);
+
+            initializers_.clear();
+            for(int i = 0; i < graph_->initializer_size(); ++i)
+                initializers_[graph_->initializer(i).name()] = i;
+
+            producers_.clear();
+            for(int i = 0; i < graph_->node_size(); ++i){
+                for(auto& output : graph_->node(i).output())
+                    producers_[output] = i;
+            }
+
+            constants_.clear();
+            renames_.clear();
+            removed_.assign(graph_->node_size(), false);
+        }
+
+        bool is_protected(const string& name) const{
+            return protected_.count(name) > 0;
+        }
+
+        const onnx::TensorProto* initializer(const string& name) const{
+            auto iter = initializers_.find(name);
+            return iter == initializers_.end() ? nullptr : &graph_->initializer(iter->second);
+        }
+
+        const onnx::NodeProto* producer(const string& name) const{
+            auto iter = producers_.find(name);
+            if(iter == producers_.end() || removed_[iter->second]) return nullptr;
+            return &graph_->node(iter->second);
+        }
+
+        // 常量值的缓存，第一次访问时从initializer解析
+        const Constant* constant(const string& name){
+            auto iter = constants_.find(name);
+            if(iter != constants_.end()) return &iter->second;
+
+            auto tensor = initializer(name);
+            if(tensor == nullptr) return nullptr;
+
+            if(shape_numel(tensor_dims(*tensor)) > options_.max_fold_elements)
+                return nullptr;
+
+            Constant value;
+            if(!tensor_to_constant(*tensor, value)) return nullptr;
+            return &(constants_[name] = std::move(value));
+        }
+
+        void add_initializer(const string& name, const Constant& value){
+            auto tensor = graph_->add_initializer();
+            constant_to_tensor(value, name, *tensor);
+            initializers_[name] = graph_->initializer_size() - 1;
+            constants_[name] = value;
+            add_initializer_input(*tensor);
+        }
+
+        void add_initializer(const onnx::TensorProto& tensor){
+            graph_->add_initializer()->CopyFrom(tensor);
+            initializers_[tensor.name()] = graph_->initializer_size() - 1;
+            add_initializer_input(tensor);
+        }
+
+        // ir_version < 4时，initializer必须同时出现在graph.input中
+        bool initializer_in_input() const{
+            return ir_version_ < 4;
+        }
+
+        // 把所有对from的引用改为to
+        void rename(const string& from, const string& to){
+            renames_[from] = resolve(to);
+        }
+
+        string resolve(const string& name) const{
+            auto iter = renames_.find(name);
+            string output = name;
+            while(iter != renames_.end()){
+                output = iter->second;
+                iter = renames_.find(output);
+            }
+            return output;
+        }
+
+        void resolve_inputs(onnx::NodeProto& node) const{
+            if(renames_.empty()) return;
+            for(int i = 0; i < node.input_size(); ++i){
+                if(node.input(i).empty()) continue;
+                auto name = resolve(node.input(i));
+                if(name != node.input(i))
+                    node.set_input(i, name);
+            }
+        }
+
+        void remove_node(int index){
+            removed_[index] = true;
+        }
+
+        // 节点的所有输出都没有被保护时，才允许删除或者重命名
+        bool removable(const onnx::NodeProto& node) const{
+            for(auto& output : node.output())
+                if(is_protected(output)) return false;
+            return true;
+        }
+
+        // 应用重命名并删除标记的节点
+        void commit(){
+            google::protobuf::RepeatedPtrField<onnx::NodeProto> kept;
+            kept.Reserve(graph_->node_size());
+            for(int i = 0; i < graph_->node_size(); ++i){
+                if(removed_[i]) continue;
+
+                auto node = graph_->mutable_node(i);
+                resolve_inputs(*node);
+                kept.Add()->Swap(node);
+            }
+            graph_->mutable_node()->Swap(&kept);
+            refresh();
+        }
+
+        onnx::GraphProto* graph(){return graph_;}
+
+    private:
+        void add_initializer_input(const onnx::TensorProto& tensor){
+            if(!initializer_in_input()) return;
+
+            auto input = graph_->add_input();
+            input->set_name(tensor.name());
+            auto type = input->mutable_type()->mutable_tensor_type();
+            type->set_elem_type(tensor.data_type());
+
+            auto shape = type->mutable_shape();
+            for(auto& dim : tensor.dims())
+                shape->add_dim()->set_dim_value(dim);
+        }
+
+    private:
+        onnx::GraphProto* graph_ = nullptr;
+        int64_t ir_version_ = 0;
+        const Options& options_;
+        unordered_set<string> protected_;
+        unordered_map<string, int> initializers_;
+        unordered_map<string, int> producers_;
+        unordered_map<string, Constant> constants_;
+        unordered_map<string, string> renames_;
+        vector<bool> removed_;
+    };
+
+    static bool constant_from_attribute(const onnx::NodeProto& node, Constant& value, onnx::TensorProto* raw_tensor){
+        const onnx::AttributeProto* attr = nullptr;
+        if((attr = find_attribute(node, "value")) && attr->has_t()){
+            raw_tensor->CopyFrom(attr->t());
+            return true;
+        }
+
+        if((attr = find_attribute(node, "value_float"))){
+            value.dtype  = onnx::TensorProto::FLOAT;
+            value.floats = {attr->f()};
+        }else if((attr = find_attribute(node, "value_int"))){
+            value.dtype = onnx::TensorProto::INT64;
+            value.ints  = {attr->i()};
+        }else if((attr = find_attribute(node, "value_floats"))){
+            value.dtype = onnx::TensorProto::FLOAT;
+            value.dims  = {(int64_t)attr->floats_size()};
+            value.floats.assign(attr->floats().begin(), attr->floats().end());
+        }else if((attr = find_attribute(node, "value_ints"))){
+            value.dtype = onnx::TensorProto::INT64;
+            value.dims  = {(int64_t)attr->ints_size()};
+            value.ints.assign(attr->ints().begin(), attr->ints().end());
+        }else{
+            return false;
+        }
+        constant_to_tensor(value, "", *raw_tensor);
+        return true;
+    }
+
+    static size_t hash_initializer(const onnx::TensorProto& tensor){
+        size_t h = std::hash<string>()(tensor.raw_data());
+        h ^= tensor.data_type() + 0x9e3779b9 + (h << 6) + (h >> 2);
+        for(auto& d : tensor.dims())
+            h ^= std::hash<int64_t>()(d) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+
+    static bool same_initializer(const onnx::TensorProto& a, const onnx::TensorProto& b){
+        if(a.data_type() != b.data_type() || a.dims_size() != b.dims_size()) return false;
+        for(int i = 0; i < a.dims_size(); ++i)
+            if(a.dims(i) != b.dims(i)) return false;
+        return a.raw_data() == b.raw_data();
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+    // passes
+    static int pass_exporter_cleanup(GraphEditor& editor, const Options& options){
+
+        auto graph  = editor.graph();
+        int changes = 0;
+
+        if(options.strip_doc_string){
+            for(auto& node : *graph->mutable_node()){
+                if(!node.doc_string().empty()){
+                    node.clear_doc_string();
+                    changes++;
+                }
+            }
+        }
+
+        for(int i = 0; i < graph->node_size(); ++i){
+            auto& node = *graph->mutable_node(i);
+            editor.resolve_inputs(node);
+            if(!editor.removable(node)) continue;
+
+            if(node.op_type() == "Constant" && node.output_size() == 1){
+                Constant value;
+                onnx::TensorProto tensor;
+                if(!constant_from_attribute(node, value, &tensor)) continue;
+
+                tensor.set_name(node.output(0));
+                editor.add_initializer(tensor);
+                editor.remove_node(i);
+                changes++;
+            }else if(node.op_type() == "Dropout" && node.input_size() > 0){
+                // 推理阶段Dropout等价于Identity，mask输出被使用时保留
+                bool mask_used = node.output_size() > 1 && !node.output(1).empty() && editor.is_protected(node.output(1));
+                for(int j = i + 1; j < graph->node_size() && !mask_used && node.output_size() > 1; ++j){
+                    for(auto& input : graph->node(j).input())
+                        mask_used |= input == node.output(1);
+                }
+                if(mask_used) continue;
+
+                editor.rename(node.output(0), node.input(0));
+                editor.remove_node(i);
+                changes++;
+            }
+        }
+
+        // 旧版本导出器会把initializer也列在graph.input里，ir_version >= 4时才允许删除
+        if(!editor.initializer_in_input()){
+            google::protobuf::RepeatedPtrField<onnx::ValueInfoProto> inputs;
+            for(auto& input : *graph->mutable_input()){
+                if(editor.initializer(input.name())){
+                    changes++;
+                    continue;
+                }
+                inputs.Add()->Swap(&input);
+            }
+            graph->mutable_input()->Swap(&inputs);
+        }
+
+        // 内容完全相同的initializer合并为一个
+        unordered_map<size_t, vector<int>> buckets;
+        for(int i = 0; i < graph->initializer_size(); ++i){
+            auto& tensor = graph->initializer(i);
+            if(tensor.raw_data().empty() || editor.is_protected(tensor.name())) continue;
+
+            auto& bucket = buckets[hash_initializer(tensor)];
+            bool merged  = false;
+            for(auto& j : bucket){
+                if(same_initializer(graph->initializer(j), tensor)){
+                    editor.rename(tensor.name(), graph->initializer(j).name());
+                    merged = true;
+                    changes++;
+                    break;
+                }
+            }
+            if(!merged) bucket.push_back(i);
+        }
+
+        editor.commit();
+        return changes;
+    }
+
+    static int pass_constant_folding(GraphEditor& editor, const Options& options){
+
+        static const unordered_set<string> foldable{
+            "Identity", "Cast", "Add", "Sub", "Mul", "Div", "Gather", "Slice", "Concat", "Transpose",
+            "Reshape", "Flatten", "Unsqueeze", "Squeeze", "ConstantOfShape", "Range", "Shape"
+        };
+
+        auto graph  = editor.graph();
+        int changes = 0;
+        for(int i = 0; i < graph->node_size(); ++i){
+            auto& node = *graph->mutable_node(i);
+            editor.resolve_inputs(node);
+            if(!foldable.count(node.op_type()) || !editor.removable(node) || node.input_size() == 0) continue;
+
+            // Shape只需要常量的维度
+            if(node.op_type() == "Shape"){
+                auto tensor = editor.initializer(node.input(0));
+                if(tensor == nullptr) continue;
+
+                Constant value;
+                Shape dims    = tensor_dims(*tensor);
+                int64_t rank  = dims.size();
+                int64_t start = normalize_axis(attribute_int(node, "start", 0), rank);
+                int64_t end   = find_attribute(node, "end") ? normalize_axis(attribute_int(node, "end", rank), rank) : rank;
+                start = max<int64_t>(0, min(start, rank));
+                end   = max<int64_t>(start, min(end, rank));
+
+                value.dtype = onnx::TensorProto::INT64;
+                value.dims  = {end - start};
+                value.ints.assign(dims.begin() + start, dims.begin() + end);
+                editor.add_initializer(node.output(0), value);
+                editor.remove_node(i);
+                changes++;
+                continue;
+            }
+
+            vector<const Constant*> inputs(node.input_size(), nullptr);
+            bool all_constant = true;
+            for(int j = 0; j < node.input_size() && all_constant; ++j){
+                if(node.input(j).empty()) continue;
+                inputs[j]    = editor.constant(node.input(j));
+                all_constant = inputs[j] != nullptr;
+            }
+            if(!all_constant) continue;
+
+            vector<Constant> outputs;
+            if(!eval_node(node, inputs, outputs) || (int)outputs.size() != node.output_size())
+                continue;
+
+            bool too_large = false;
+            for(auto& output : outputs)
+                too_large |= output.numel() > options.max_fold_elements;
+            if(too_large) continue;
+
+            for(size_t j = 0; j < outputs.size(); ++j)
+                editor.add_initializer(node.output(j), outputs[j]);
+
+            editor.remove_node(i);
+            changes++;
+        }
+
+        editor.commit();
+        return changes;
+    }
+
+    // 无损的类型扩展，Cast(Cast(x, wide), origin)可以直接消除
+    static bool is_lossless_cast(int from, int to){
+        if(from == to) return true;
+        switch(from){
+            case onnx::TensorProto::FLOAT16: return to == onnx::TensorProto::FLOAT || to == onnx::TensorProto::DOUBLE;
+            case onnx::TensorProto::FLOAT:   return to == onnx::TensorProto::DOUBLE;
+            case onnx::TensorProto::INT8:
+            case onnx::TensorProto::INT16:   return to == onnx::TensorProto::INT32 || to == onnx::TensorProto::INT64;
+            case onnx::TensorProto::INT32:   return to == onnx::TensorProto::INT64;
+            case onnx::TensorProto::BOOL:    return to == onnx::TensorProto::INT32 || to == onnx::TensorProto::INT64;
+            default: return false;
+        }
+    }
+
+    static bool node_axes(GraphEditor& editor, const onnx::NodeProto& node, vector<int64_t>& axes){
+        axes = attribute_ints(node, "axes");
+        if(node.input_size() > 1 && !node.input(1).empty()){
+            auto value = editor.constant(node.input(1));
+            if(value == nullptr) return false;
+
+            axes.resize(value->numel());
+            for(size_t i = 0; i < axes.size(); ++i)
+                axes[i] = value->int_at(i);
+        }
+
+        for(auto& a : axes)
+            if(a < 0) return false;
+        return !axes.empty();
+    }
+
+    static int pass_eliminate_identity(GraphEditor& editor, const Options& options){
+
+        auto graph  = editor.graph();
+        auto infos  = infer_shapes(*graph, options.dynamic_batch);
+        int changes = 0;
+
+        auto dtype_of = [&](const string& name){
+            auto iter = infos.find(name);
+            return iter == infos.end() ? (int)onnx::TensorProto::UNDEFINED : iter->second.dtype;
+        };
+
+        for(int i = 0; i < graph->node_size(); ++i){
+            auto& node = *graph->mutable_node(i);
+            editor.resolve_inputs(node);
+            if(!editor.removable(node) || node.input_size() == 0 || node.output_size() != 1) continue;
+
+            auto& op = node.op_type();
+            if(op == "Identity"){
+                editor.rename(node.output(0), node.input(0));
+                editor.remove_node(i);
+                changes++;
+            }else if(op == "Cast"){
+                int to   = attribute_int(node, "to", onnx::TensorProto::UNDEFINED);
+                int from = dtype_of(node.input(0));
+                if(from != onnx::TensorProto::UNDEFINED && from == to){
+                    editor.rename(node.output(0), node.input(0));
+                    editor.remove_node(i);
+                    changes++;
+                    continue;
+                }
+
+                auto prev = editor.producer(node.input(0));
+                if(prev && prev->op_type() == "Cast"){
+                    int origin = dtype_of(prev->input(0));
+                    int middle = attribute_int(*prev, "to", onnx::TensorProto::UNDEFINED);
+                    if(origin != onnx::TensorProto::UNDEFINED && origin == to && is_lossless_cast(origin, middle)){
+                        editor.rename(node.output(0), prev->input(0));
+                        editor.remove_node(i);
+                        changes++;
+                    }
+                }
+            }else if(op == "Squeeze" || op == "Unsqueeze"){
+                // Unsqueeze->Squeeze、Squeeze->Unsqueeze 使用相同的axes时互相抵消
+                auto prev = editor.producer(node.input(0));
+                const char* inverse = op == "Squeeze" ? "Unsqueeze" : "Squeeze";
+                if(!prev || prev->op_type() != inverse) continue;
+
+                vector<int64_t> axes, prev_axes;
+                if(!node_axes(editor, node, axes) || !node_axes(editor, *prev, prev_axes)) continue;
+
+                sort(axes.begin(), axes.end());
+                sort(prev_axes.begin(), prev_axes.end());
+                if(axes != prev_axes) continue;
+
+                editor.rename(node.output(0), prev->input(0));
+                editor.remove_node(i);
+                changes++;
+            }else if(op == "Reshape"){
+                // Reshape(Reshape(x, s1), s2) -> Reshape(x, s2)，要求s2是常量且不依赖输入维度(没有0)
+                auto prev = editor.producer(node.input(0));
+                if(!prev || prev->op_type() != "Reshape" || node.input_size() < 2) continue;
+
+                auto shape = editor.constant(node.input(1));
+                if(shape == nullptr) continue;
+
+                bool has_zero = false;
+                for(size_t j = 0; j < shape->numel(); ++j)
+                    has_zero |= shape->int_at(j) == 0;
+
+                if(has_zero && attribute_int(node, "allowzero", 0) == 0) continue;
+                node.set_input(0, prev->input(0));
+                changes++;
+            }
+        }
+
+        editor.commit();
+        return changes;
+    }
+
+    static int pass_shape_simplify(GraphEditor& editor, const Options& options){
+
+        auto graph = editor.graph();
+        unordered_map<string, Constant> constants;
+        for(auto& initializer : graph->initializer()){
+            auto value = editor.constant(initializer.name());
+            if(value && value->is_integer())
+                constants[initializer.name()] = *value;
+        }
+
+        auto infos  = infer_shapes(*graph, options.dynamic_batch, &constants);
+        int changes = 0;
+
+        auto shape_of = [&](const string& name) -> const TensorInfo* {
+            auto iter = infos.find(name);
+            return iter == infos.end() || !iter->second.has_shape ? nullptr : &iter->second;
+        };
+
+        for(int i = 0; i < graph->node_size(); ++i){
+            auto& node = *graph->mutable_node(i);
+            editor.resolve_inputs(node);
+            if(!editor.removable(node) || node.input_size() == 0 || node.output_size() != 1) continue;
+
+            auto& op = node.op_type();
+            if(op == "Shape"){
+                auto info = shape_of(node.input(0));
+                if(!info || !info->is_static()) continue;
+
+                int64_t rank  = info->shape.size();
+                int64_t start = normalize_axis(attribute_int(node, "start", 0), rank);
+                int64_t end   = find_attribute(node, "end") ? normalize_axis(attribute_int(node, "end", rank), rank) : rank;
+                start = max<int64_t>(0, min(start, rank));
+                end   = max<int64_t>(start, min(end, rank));
+
+                Constant value;
+                value.dtype = onnx::TensorProto::INT64;
+                value.dims  = {end - start};
+                value.ints.assign(info->shape.begin() + start, info->shape.begin() + end);
+                editor.add_initializer(node.output(0), value);
+                editor.remove_node(i);
+                changes++;
+            }else if(op == "Gather" && node.input_size() == 2){
+                // Gather(Shape(x), idx)，只要取到的维度是静态的就可以折叠，不要求x整体静态
+                auto prev    = editor.producer(node.input(0));
+                auto indices = editor.constant(node.input(1));
+                if(!prev || prev->op_type() != "Shape" || !indices || find_attribute(*prev, "start") || find_attribute(*prev, "end")) continue;
+
+                auto info = shape_of(prev->input(0));
+                if(!info) continue;
+
+                int64_t rank = info->shape.size();
+                Constant value;
+                value.dtype = onnx::TensorProto::INT64;
+                value.dims  = indices->dims;
+                value.ints.resize(indices->numel());
+
+                bool known = true;
+                for(size_t j = 0; j < indices->numel() && known; ++j){
+                    int64_t index = normalize_axis(indices->int_at(j), rank);
+                    known = index >= 0 && index < rank && info->shape[index] >= 0;
+                    if(known) value.ints[j] = info->shape[index];
+                }
+                if(!known) continue;
+
+                editor.add_initializer(node.output(0), value);
+                editor.remove_node(i);
+                changes++;
+            }else if(op == "Reshape" && node.input_size() == 2){
+                // 目标形状与输入形状相同的Reshape是Identity
+                auto info   = shape_of(node.input(0));
+                auto output = shape_of(node.output(0));
+                if(!info || !output || !info->is_static() || !output->is_static() || info->shape != output->shape) continue;
+
+                editor.rename(node.output(0), node.input(0));
+                editor.remove_node(i);
+                changes++;
+            }
+        }
+
+        editor.commit();
+        return changes;
+    }
+
+    // 不需要参数，保留Options与PassFunction的签名一致
+    static int pass_dead_node_elimination(GraphEditor& editor, const Options&){
+
+        auto graph = editor.graph();
+        unordered_set<string> live;
+        for(auto& output : graph->output())
+            live.insert(output.name());
+        collect_subgraph_references(*graph, live);
+
+        // 节点一般是拓扑有序的，一次逆序遍历即可，否则重复直到稳定
+        vector<bool> alive(graph->node_size(), false);
+        bool updated = true;
+        while(updated){
+            updated = false;
+            for(int i = graph->node_size() - 1; i >= 0; --i){
+                if(alive[i]) continue;
+
+                auto& node = graph->node(i);
+                bool used  = false;
+                for(auto& output : node.output())
+                    used |= !output.empty() && live.count(output);
+
+                if(!used) continue;
+                alive[i] = true;
+                updated  = true;
+                for(auto& input : node.input())
+                    live.insert(input);
+            }
+        }
+
+        int changes = 0;
+        for(int i = 0; i < graph->node_size(); ++i){
+            if(!alive[i]){
+                editor.remove_node(i);
+                changes++;
+            }
+        }
+
+        google::protobuf::RepeatedPtrField<onnx::TensorProto> initializers;
+        unordered_set<string> removed_initializers;
+        for(auto& initializer : *graph->mutable_initializer()){
+            if(!live.count(initializer.name())){
+                removed_initializers.insert(initializer.name());
+                changes++;
+                continue;
+            }
+            initializers.Add()->Swap(&initializer);
+        }
+        graph->mutable_initializer()->Swap(&initializers);
+
+        // 与initializer对应的graph.input一起删除，否则会变成多余的网络输入
+        if(editor.initializer_in_input() && !removed_initializers.empty()){
+            google::protobuf::RepeatedPtrField<onnx::ValueInfoProto> inputs;
+            for(auto& input : *graph->mutable_input()){
+                if(removed_initializers.count(input.name())) continue;
+                inputs.Add()->Swap(&input);
+            }
+            graph->mutable_input()->Swap(&inputs);
+        }
+
+        google::protobuf::RepeatedPtrField<onnx::ValueInfoProto> value_infos;
+        for(auto& info : *graph->mutable_value_info()){
+            if(!live.count(info.name())) continue;
+            value_infos.Add()->Swap(&info);
+        }
+        graph->mutable_value_info()->Swap(&value_infos);
+
+        editor.commit();
+        return changes;
+    }
+
+    typedef int (*PassFunction)(GraphEditor& editor, const Options& options);
+    static PassFunction get_pass_function(Pass pass){
+        switch(pass){
+            case Pass::ExporterCleanup:     return pass_exporter_cleanup;
+            case Pass::ConstantFolding:     return pass_constant_folding;
+            case Pass::EliminateIdentity:   return pass_eliminate_identity;
+            case Pass::ShapeSimplify:       return pass_shape_simplify;
+            case Pass::DeadNodeElimination: return pass_dead_node_elimination;
+            default: return nullptr;
+        }
+    }
+
+    Report optimize(onnx::ModelProto& model, const Options& options){
+
+        Report report;
+        auto graph  = model.mutable_graph();
+        auto tstart = iLogger::timestamp_now_float();
+        report.num_nodes_before        = graph->node_size();
+        report.num_initializers_before = graph->initializer_size();
+        report.model_bytes_before      = model.ByteSizeLong();
+
+        for(auto& pass : options.passes){
+            PassReport item;
+            item.pass = pass;
+            report.passes.push_back(item);
+        }
+
+        GraphEditor editor(graph, model.ir_version(), options);
+        for(int iteration = 0; iteration < options.max_iterations; ++iteration){
+
+            int changes = 0;
+            for(auto& item : report.passes){
+                auto func = get_pass_function(item.pass);
+                if(func == nullptr){
+                    INFOE("Unknow pass %d", (int)item.pass);
+                    continue;
+                }
+
+                auto begin = iLogger::timestamp_now_float();
+                int count  = func(editor, options);
+                item.time_ms     += iLogger::timestamp_now_float() - begin;
+                item.num_changes += count;
+                changes          += count;
+            }
+
+            report.num_iterations++;
+            if(changes == 0) break;
+        }
+
+        report.num_nodes_after        = graph->node_size();
+        report.num_initializers_after = graph->initializer_size();
+        report.model_bytes_after      = model.ByteSizeLong();
+        report.time_ms                = iLogger::timestamp_now_float() - tstart;
+        return report;
+    }
+
+    bool optimize_data(const void* data, size_t size, string& output, Report* report, const Options& options){
+
+        if(data == nullptr || size == 0){
+            INFOE("Optimize onnx data failed, data is empty.");
+            return false;
+        }
+
+        onnx::ModelProto model;
+        google::protobuf::io::ArrayInputStream raw_input(data, size);
+        google::protobuf::io::CodedInputStream coded_input(&raw_input);
+        coded_input.SetTotalBytesLimit(std::numeric_limits<int>::max());
+        if(!model.ParseFromCodedStream(&coded_input)){
+            INFOE("Parse onnx data failed, size = %lld", (long long)size);
+            return false;
+        }
+
+        auto result = optimize(model, options);
+        if(report) *report = result;
+
+        if(!model.SerializeToString(&output)){
+            INFOE("Serialize optimized onnx failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool optimize_file(const string& onnx_file, const string& save_to, Report* report, const Options& options){
+
+        auto data = iLogger::load_file(onnx_file);
+        if(data.empty()){
+            INFOE("Load onnx file %s failed.", onnx_file.c_str());
+            return false;
+        }
+
+        Report result;
+        string output;
+        if(!optimize_data(data.data(), data.size(), output, &result, options))
+            return false;
+
+        INFO("Optimize %s -> %s, %s", onnx_file.c_str(), save_to.c_str(), result.summary().c_str());
+        if(report) *report = result;
+        return iLogger::save_file(save_to, output);
+    }
+
+}; // namespace ONNXOptimizer
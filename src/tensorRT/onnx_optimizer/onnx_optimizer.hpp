@@ -0,0 +1,78 @@
+#ifndef ONNX_OPTIMIZER_HPP
+#define ONNX_OPTIMIZER_HPP
+
+#include <string>
+#include <vector>
+
+namespace onnx{
+    class ModelProto;
+};
+
+/**
+ * @brief 在TRT::compile之前，对onnx做纯CPU的图优化
+ * 仅依赖onnx-ml.pb.h，不需要GPU，可以对构造的ModelProto直接测试
+ *   ExporterCleanup      导出器残留清理，Constant节点转initializer、Dropout、重复的initializer、graph.input中的initializer、doc_string
+ *   ConstantFolding      常量折叠，输入全部是常量的节点直接计算为initializer
+ *   EliminateIdentity    Identity/Cast/Unsqueeze-Squeeze/Reshape-Reshape 链的消除
+ *   ShapeSimplify        Shape/Gather(Shape) 在维度静态已知时替换为常量
+ *   DeadNodeElimination  删除输出未被使用的节点，以及未使用的initializer、value_info
+ */
+namespace ONNXOptimizer{
+
+    enum class Pass : int{
+        ExporterCleanup     = 0,
+        ConstantFolding     = 1,
+        EliminateIdentity   = 2,
+        ShapeSimplify       = 3,
+        DeadNodeElimination = 4
+    };
+
+    const char* pass_name(Pass pass);
+
+    struct Options{
+        std::vector<Pass> passes{
+            Pass::ExporterCleanup, Pass::ConstantFolding, Pass::EliminateIdentity,
+            Pass::ShapeSimplify, Pass::DeadNodeElimination
+        };
+
+        // 重复执行passes，直到图不再变化或者达到max_iterations
+        int max_iterations = 8;
+
+        // 超过这个元素数量的常量不参与折叠，避免把大的权重展开成float计算
+        size_t max_fold_elements = 1 << 20;
+
+        // TRT::compile会把所有输入的第0维设置为-1，因此默认把第0维看作动态，不折叠
+        bool dynamic_batch = true;
+
+        bool strip_doc_string = true;
+    };
+
+    struct PassReport{
+        Pass pass;
+        int num_changes  = 0;
+        double time_ms   = 0;
+    };
+
+    struct Report{
+        int num_nodes_before        = 0;
+        int num_nodes_after         = 0;
+        int num_initializers_before = 0;
+        int num_initializers_after  = 0;
+        size_t model_bytes_before   = 0;
+        size_t model_bytes_after    = 0;
+        int num_iterations          = 0;
+        double time_ms              = 0;
+        std::vector<PassReport> passes;
+
+        std::string summary() const;
+    };
+
+    Report optimize(onnx::ModelProto& model, const Options& options = Options());
+
+    // 对序列化的onnx数据做优化，结果序列化到output
+    bool optimize_data(const void* data, size_t size, std::string& output, Report* report = nullptr, const Options& options = Options());
+    bool optimize_file(const std::string& onnx_file, const std::string& save_to, Report* report = nullptr, const Options& options = Options());
+
+}; // namespace ONNXOptimizer
+
+#endif // ONNX_OPTIMIZER_HPP
@@ -27,7 +27,8 @@
 
 typedef std::function<std::vector<int64_t>(const std::string& name, const std::vector<int64_t>& shape)> layerhook_func_reshape;
 
-static layerhook_func_reshape g_layerhook_func_reshape;
+// The hook is per thread, so models compiled on different threads do not see each other's hook
+static thread_local layerhook_func_reshape g_layerhook_func_reshape;
 extern "C" TENSORRTAPI void register_layerhook_reshape(const layerhook_func_reshape& func){
     g_layerhook_func_reshape = func;
 }
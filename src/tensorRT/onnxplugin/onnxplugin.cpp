@@ -1,6 +1,7 @@
 
 #include "onnxplugin.hpp"
 #include <string>
+#include <algorithm>
 
 using namespace nvinfer1;
 using namespace std;
@@ -70,14 +71,7 @@ namespace ONNXPlugin {
 
 	int LayerConfig::serialize() {
 
-		Plugin::BinIO out;
-		out << workspace_size_;
-		out << usage_dtype_;
-		out << max_batch_size_;
-		out << usage_plugin_format_;
-		out << info_;
-
-		out << (int)weights_.size();
+		size_t weights_bytes = 0;
 		for (int i = 0; i < weights_.size(); ++i) {
 
 			if (usage_dtype_ == TRT::DataType::Float) {
@@ -89,14 +83,27 @@ namespace ONNXPlugin {
 			else{
 				INFOE("unsupport datatype: %d", (int)usage_dtype_);
 			}
+			weights_bytes += weights_[i]->bytes();
+		}
 
+		// 权重占绝大部分，提前分配好，避免写入时反复扩容复制
+		Plugin::BinIO out;
+		out.reserve(weights_bytes + 4096);
+		out << workspace_size_;
+		out << usage_dtype_;
+		out << max_batch_size_;
+		out << usage_plugin_format_;
+		out << info_;
+
+		out << (int)weights_.size();
+		for (int i = 0; i < weights_.size(); ++i) {
 			out << weights_[i]->dims();
 			out << weights_[i]->type();
 			out.write((char*)weights_[i]->cpu(), weights_[i]->bytes());
 		}
 
 		seril(out);
-		serialize_data_ = out.writedMemory();
+		serialize_data_ = out.releaseMemory();
 		return serialize_data_.size();
 	}
 
@@ -111,6 +118,10 @@ namespace ONNXPlugin {
 
 		int nbWeights = 0;
 		in >> nbWeights;
+		if (!in.checkLength(nbWeights, sizeof(int))) {
+			weights_.clear();
+			return;
+		}
 
 		weights_.resize(nbWeights);
 		for (int i = 0; i < nbWeights; ++i) {
@@ -120,6 +131,12 @@ namespace ONNXPlugin {
 			TRT::DataType dt;
 			in >> dt;
 
+			// 损坏的数据不能用来分配tensor，尺寸需要与剩余的数据相符
+			if (!in.opstate() || !in.checkShape(dims, std::max(0, TRT::data_type_size(dt)))) {
+				weights_.clear();
+				return;
+			}
+
 			weights_[i].reset(new TRT::Tensor(dims, dt));
 			in.read(weights_[i]->cpu(), weights_[i]->bytes());
 			weights_[i]->gpu();
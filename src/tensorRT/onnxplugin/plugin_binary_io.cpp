@@ -1,7 +1,8 @@
-
 #include "plugin_binary_io.hpp"
 #include "ilogger.hpp"
 #include <string.h>
+#include <stdarg.h>
+#include <limits>
 
 namespace Plugin{
 
@@ -12,89 +13,224 @@ namespace Plugin{
 	}
 
 	bool BinIO::opened(){
-		if (flag_ == MemoryRead)
+		if (flag_ == MemoryRead || flag_ == MappedRead)
 			return memoryRead_ != nullptr;
+		else if (flag_ == FileRead || flag_ == FileWrite)
+			return file_ != nullptr;
 		else if (flag_ == MemoryWrite)
 			return true;
 		return false;
 	}
 
+	bool BinIO::isReadMode() const{
+		return flag_ == MemoryRead || flag_ == MappedRead || flag_ == FileRead;
+	}
+
+	void BinIO::setError(const char* fmt, ...){
+
+		// 只保留第一个错误，后续的错误通常是它引起的
+		if (!opstate_) return;
+
+		char buffer[1000];
+		va_list vl;
+		va_start(vl, fmt);
+		vsnprintf(buffer, sizeof(buffer), fmt, vl);
+		va_end(vl);
+
+		opstate_ = false;
+		error_   = buffer;
+		INFOE("BinIO: %s", buffer);
+	}
+
 	void BinIO::close(){
-        if (flag_ == MemoryRead) {
-			memoryRead_ = nullptr;
-			memoryCursor_ = 0;
-			memoryLength_ = -1;
-		}
-		else if (flag_ == MemoryWrite) {
-			memoryWrite_.clear();
-			memoryCursor_ = 0;
-			memoryLength_ = -1;
+
+		if (file_) {
+			if (fclose(file_) != 0 && flag_ == FileWrite)
+				setError("Close file failed, data may be incomplete");
+			file_ = nullptr;
 		}
+
+		mapping_.reset();
+		memoryRead_ = nullptr;
+		memoryWrite_.clear();
+		spanBuffer_.clear();
+		cursor_ = 0;
+		length_ = 0;
+	}
+
+	size_t BinIO::size() const{
+		return isReadMode() ? length_ : cursor_;
 	}
 
-	string BinIO::readData(int numBytes){
+	string BinIO::readData(size_t numBytes){
+
 		string output;
-		output.resize(numBytes);
+		if (!opstate_) return output;
+
+		// 先检查长度再分配，错误的长度不会导致分配巨大的内存
+		if (isReadMode() && numBytes > length_ - cursor_) {
+			setError("Read out of range, need %lld bytes at %lld, but only %lld available", (long long)numBytes, (long long)cursor_, (long long)(length_ - cursor_));
+			return output;
+		}
 
-		int readlen = read((void*)output.data(), output.size());
+		output.resize(numBytes);
+		size_t readlen = read((void*)output.data(), output.size());
 		output.resize(readlen);
 		return output;
 	}
 
-	int BinIO::read(void* pdata, size_t length){
-
-        if (flag_ == MemoryRead) {
-			if (memoryLength_ != -1) {
-				
-				if (memoryLength_ < memoryCursor_ + length) {
-					int remain = memoryLength_ - memoryCursor_;
-					if (remain > 0) {
-						memcpy(pdata, memoryRead_ + memoryCursor_, remain);
-						memoryCursor_ += remain;
-						return remain;
-					}
-					else {
-						return -1;
-					}
-				}
-			}
-			memcpy(pdata, memoryRead_ + memoryCursor_, length);
-			memoryCursor_ += length;
-			return length;
+	size_t BinIO::read(void* pdata, size_t length){
+
+		if (!opstate_ || length == 0) return 0;
+		if (!isReadMode() || !opened()) {
+			setError("Read on a stream that is not opened for reading");
+			return 0;
+		}
+
+		size_t remain = length_ - cursor_;
+		size_t readlen = length > remain ? remain : length;
+		if (flag_ == FileRead) {
+			readlen = fread(pdata, 1, readlen, file_);
 		}
 		else {
-			return -1;
+			memcpy(pdata, memoryRead_ + cursor_, readlen);
 		}
+
+		cursor_ += readlen;
+		if (readlen < length)
+			setError("Read out of range, need %lld bytes at %lld, but only %lld available", (long long)length, (long long)(cursor_ - readlen), (long long)readlen);
+		return readlen;
 	}
-	
-	bool BinIO::eof(){
-		if (!opened()) return true;
 
-		if (flag_ == MemoryRead){
-			return this->memoryCursor_ >= this->memoryLength_;
+	const void* BinIO::readSpan(size_t length){
+
+		if (!opstate_) return nullptr;
+		if (!isReadMode() || !opened()) {
+			setError("Read on a stream that is not opened for reading");
+			return nullptr;
 		}
-		else if (flag_ == MemoryWrite){
+
+		if (length > length_ - cursor_) {
+			setError("Read span out of range, need %lld bytes at %lld, but only %lld available", (long long)length, (long long)cursor_, (long long)(length_ - cursor_));
+			return nullptr;
+		}
+
+		if (flag_ == FileRead) {
+			spanBuffer_.resize(length);
+			if (read(spanBuffer_.data(), length) != length)
+				return nullptr;
+			return spanBuffer_.data();
+		}
+
+		const char* ptr = memoryRead_ + cursor_;
+		cursor_ += length;
+		return ptr;
+	}
+
+	bool BinIO::checkLength(int length, size_t elementSize){
+
+		if (!opstate_) return false;
+		if (length < 0) {
+			setError("Invalid length %d at %lld", length, (long long)cursor_);
 			return false;
 		}
-		else {
-			opstate_ = false;
-			INFO("Unsupport flag: %d", flag_);
-			return true;
+
+		if (isReadMode() && elementSize > 0 && (size_t)length > (length_ - cursor_) / elementSize) {
+			setError("Length %d x %d bytes at %lld exceeds the remaining %lld bytes", length, (int)elementSize, (long long)cursor_, (long long)(length_ - cursor_));
+			return false;
 		}
+		return true;
+	}
+
+	bool BinIO::checkShape(const vector<int>& dims, size_t elementSize){
+
+		if (!opstate_) return false;
+		if (elementSize == 0) {
+			setError("Invalid element size at %lld", (long long)cursor_);
+			return false;
+		}
+
+		// 逐个维度累乘，超过剩余数据时立即停止，不会溢出
+		size_t remain = isReadMode() ? length_ - cursor_ : numeric_limits<size_t>::max();
+		size_t bytes  = elementSize;
+		for (size_t i = 0; i < dims.size(); ++i) {
+			if (dims[i] < 0) {
+				setError("Invalid dim[%d] = %d at %lld", (int)i, dims[i], (long long)cursor_);
+				return false;
+			}
+
+			if (dims[i] > 0 && bytes > remain / (size_t)dims[i]) {
+				setError("Shape at %lld exceeds the remaining %lld bytes", (long long)cursor_, (long long)remain);
+				return false;
+			}
+			bytes *= dims[i];
+		}
+
+		if (bytes > remain) {
+			setError("Shape at %lld exceeds the remaining %lld bytes", (long long)cursor_, (long long)remain);
+			return false;
+		}
+		return true;
 	}
 
-	int BinIO::write(const void* pdata, size_t length){
+	bool BinIO::writeLength(size_t length){
 
+		if (length > (size_t)numeric_limits<int>::max()) {
+			setError("Length %lld exceeds the int length prefix", (long long)length);
+			return false;
+		}
+		(*this) << (int)length;
+		return opstate_;
+	}
+
+	bool BinIO::eof(){
+		if (!opened()) return true;
+
+		if (isReadMode()){
+			return !opstate_ || cursor_ >= length_;
+		}
+		return false;
+	}
+
+	void BinIO::reserve(size_t bytes){
+		if (flag_ == MemoryWrite && bytes > memoryWrite_.capacity())
+			memoryWrite_.reserve(bytes);
+	}
+
+	string BinIO::releaseMemory(){
+		string output;
+		output.swap(memoryWrite_);
+		cursor_ = 0;
+		return output;
+	}
+
+	size_t BinIO::write(const void* pdata, size_t length){
+
+		if (!opstate_ || length == 0) return 0;
 		if (flag_ == MemoryWrite) {
-			memoryWrite_.append((char*)pdata, (char*)pdata + length);
+
+			// 按2倍预先分配，避免大量小的写入反复重新分配
+			size_t need = memoryWrite_.size() + length;
+			if (need > memoryWrite_.capacity())
+				memoryWrite_.reserve(std::max(need, memoryWrite_.capacity() * 2));
+
+			memoryWrite_.append((const char*)pdata, length);
+			cursor_ += length;
 			return length;
 		}
-		else {
-			return -1;
+		else if (flag_ == FileWrite && file_ != nullptr) {
+			size_t writelen = fwrite(pdata, 1, length, file_);
+			cursor_ += writelen;
+			if (writelen != length)
+				setError("Write file failed, %lld of %lld bytes written", (long long)writelen, (long long)length);
+			return writelen;
 		}
+
+		setError("Write on a stream that is not opened for writing");
+		return 0;
 	}
 
-	int BinIO::writeData(const string& data){
+	size_t BinIO::writeData(const string& data){
 		return write(data.data(), data.size());
 	}
 
@@ -102,6 +238,10 @@ namespace Plugin{
 		//read
 		int length = 0;
 		(*this) >> length;
+		if (!checkLength(length, 1)) {
+			value.clear();
+			return *this;
+		}
 		value = readData(length);
 		return *this;
 	}
@@ -120,21 +260,23 @@ namespace Plugin{
 
 	BinIO& BinIO::operator << (const string& value){
 		//write
-		(*this) << (int)value.size();
-		writeData(value);
+		if (writeLength(value.size()))
+			writeData(value);
 		return *this;
 	}
 
 	BinIO& BinIO::operator << (const char* value){
 
-		int length = strlen(value);
-		(*this) << (int)length;
-		write(value, length);
+		size_t length = strlen(value);
+		if (writeLength(length))
+			write(value, length);
 		return *this;
 	}
 
 	BinIO& BinIO::operator << (const vector<string>& value){
-		(*this) << (int)value.size();
+		if (!writeLength(value.size()))
+			return *this;
+
 		for (int i = 0; i < value.size(); ++i){
 			(*this) << value[i];
 		}
@@ -142,33 +284,88 @@ namespace Plugin{
 	}
 
 	BinIO& BinIO::operator >> (vector<string>& value){
-		int num;
+		int num = 0;
 		(*this) >> num;
 
+		// 每个字符串至少有一个int的长度前缀
+		if (!checkLength(num, sizeof(int))) {
+			value.clear();
+			return *this;
+		}
+
 		value.resize(num);
 		for (int i = 0; i < value.size(); ++i)
 			(*this) >> value[i];
 		return *this;
 	}
 
-	bool BinIO::openMemoryRead(const void* ptr, int memoryLength) {
+	bool BinIO::openMemoryRead(const void* ptr, size_t memoryLength) {
 		close();
 
+		flag_ = MemoryRead;
+		opstate_ = true;
+		error_.clear();
 		if (!ptr) return false;
+
 		memoryRead_ = (const char*)ptr;
-		memoryCursor_ = 0;
-		memoryLength_ = memoryLength;
-		flag_ = MemoryRead;
+		length_ = memoryLength;
 		return true;
 	}
 
-	void BinIO::openMemoryWrite() {
+	void BinIO::openMemoryWrite(size_t reserveBytes) {
 		close();
 
-		memoryWrite_.clear();
-		memoryCursor_ = 0;
-		memoryLength_ = -1;
 		flag_ = MemoryWrite;
+		opstate_ = true;
+		error_.clear();
+		reserve(reserveBytes);
+	}
+
+	bool BinIO::openFileRead(const string& file) {
+		close();
+
+		flag_ = FileRead;
+		opstate_ = true;
+		error_.clear();
+		file_ = fopen(file.c_str(), "rb");
+		if (file_ == nullptr) {
+			setError("Open %s failed", file.c_str());
+			return false;
+		}
+		length_ = iLogger::file_size(file);
+		return true;
+	}
+
+	bool BinIO::openFileWrite(const string& file) {
+		close();
+
+		flag_ = FileWrite;
+		opstate_ = true;
+		error_.clear();
+		file_ = fopen(file.c_str(), "wb");
+		if (file_ == nullptr) {
+			setError("Open %s failed", file.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool BinIO::openMappedRead(const string& file) {
+		close();
+
+		flag_ = MappedRead;
+		opstate_ = true;
+		error_.clear();
+		mapping_ = iLogger::map_file(file);
+		if (mapping_ == nullptr) {
+			setError("Map %s failed", file.c_str());
+			return false;
+		}
+
+		mapping_->advise(iLogger::MapAdvice::Sequential);
+		memoryRead_ = (const char*)mapping_->data();
+		length_ = mapping_->size();
+		return true;
 	}
 
 }; // namespace Plugin
\ No newline at end of file
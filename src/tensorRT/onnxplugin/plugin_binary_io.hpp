@@ -3,32 +3,69 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <stdio.h>
+
+namespace iLogger{
+    class MappedFile;
+};
 
 namespace Plugin{
 
+    /** 插件序列化使用的二进制读写
+    //   MemoryRead、MappedRead：从内存（或文件映射）读取，readSpan直接返回数据的指针，不需要复制
+    //   MemoryWrite：写入内存，空间按2倍增长，已知大小时可以用reserve提前分配，releaseMemory取走数据不复制
+    //   FileRead、FileWrite：流式读写文件，数据不需要全部放在内存中
+    //   长度和偏移都是size_t，可以超过2GB。字符串、vector的长度前缀仍然是int，与之前序列化的数据兼容
+    //   读越界、长度前缀非法、文件读写失败时进入错误状态（opstate() == false），之后的读写都不再进行 **/
     class BinIO {
     public:
         enum Head {
-            MemoryRead = 1,
-            MemoryWrite = 2
+            MemoryRead  = 1,
+            MemoryWrite = 2,
+            FileRead    = 3,
+            FileWrite   = 4,
+            MappedRead  = 5
         };
 
         BinIO() { openMemoryWrite(); }
-        BinIO(const void* ptr, int memoryLength = -1) { openMemoryRead(ptr, memoryLength); }
+        BinIO(const void* ptr, size_t memoryLength) { openMemoryRead(ptr, memoryLength); }
+        BinIO(const BinIO&) = delete;
+        BinIO& operator = (const BinIO&) = delete;
         virtual ~BinIO();
+
         bool opened();
-        bool openMemoryRead(const void* ptr, int memoryLength = -1);
-        void openMemoryWrite();
-        const std::string& writedMemory() { return memoryWrite_; }
+        bool openMemoryRead(const void* ptr, size_t memoryLength);
+        void openMemoryWrite(size_t reserveBytes = 0);
+        bool openFileRead(const std::string& file);
+        bool openFileWrite(const std::string& file);
+        bool openMappedRead(const std::string& file);
         void close();
-        int write(const void* pdata, size_t length);
-        int writeData(const std::string& data);
-        int read(void* pdata, size_t length);
-        std::string readData(int numBytes);
+
+        const std::string& writedMemory() { return memoryWrite_; }
+
+        // 取走写入的数据，之后writedMemory为空
+        std::string releaseMemory();
+        void reserve(size_t bytes);
+
+        size_t write(const void* pdata, size_t length);
+        size_t writeData(const std::string& data);
+        size_t read(void* pdata, size_t length);
+
+        // 返回length字节数据的指针并前进，失败返回nullptr
+        // 内存、映射模式下直接指向源数据，文件模式下指向内部缓冲区，在下一次readSpan之前有效
+        const void* readSpan(size_t length);
+        std::string readData(size_t numBytes);
         int readInt();
         float readFloat();
         bool eof();
 
+        Head mode() const { return flag_; }
+        size_t tell() const { return cursor_; }
+
+        // 读模式下为数据的总长度，写模式下为已经写入的长度
+        size_t size() const;
+
         BinIO& operator >> (std::string& value);
         BinIO& operator << (const std::string& value);
         BinIO& operator << (const char* value);
@@ -39,6 +76,10 @@ namespace Plugin{
         BinIO& operator >> (std::vector<_T>& value) {
             int length = 0;
             (*this) >> length;
+            if (!checkLength(length, sizeof(_T))) {
+                value.clear();
+                return *this;
+            }
 
             value.resize(length);
             read(value.data(), length * sizeof(_T));
@@ -47,7 +88,9 @@ namespace Plugin{
 
         template<typename _T>
         BinIO& operator << (const std::vector<_T>& value) {
-            (*this) << (int)value.size();
+            if (!writeLength(value.size()))
+                return *this;
+
             write(value.data(), sizeof(_T) * value.size());
             return *this;
         }
@@ -68,14 +111,32 @@ namespace Plugin{
             return opstate_;
         }
 
+        const std::string& error() const {
+            return error_;
+        }
+
+        // 读取的数量前缀是否合法（非负，并且length个elementSize字节的元素不超过剩余的数据），不合法时进入错误状态
+        bool checkLength(int length, size_t elementSize);
+
+        // 读取的tensor尺寸是否合法（每个维度非负，元素个数乘以elementSize不溢出并且不超过剩余的数据），不合法时进入错误状态
+        bool checkShape(const std::vector<int>& dims, size_t elementSize);
+
+    private:
+        bool isReadMode() const;
+        bool writeLength(size_t length);
+        void setError(const char* fmt, ...);
+
     private:
-        size_t readModeEndSEEK_ = 0;
         std::string memoryWrite_;
         const char* memoryRead_ = nullptr;
-        int memoryCursor_ = 0;
-        int memoryLength_ = -1;
+        size_t cursor_ = 0;
+        size_t length_ = 0;
+        FILE* file_ = nullptr;
+        std::shared_ptr<iLogger::MappedFile> mapping_;
+        std::vector<char> spanBuffer_;
         Head flag_ = MemoryWrite;
         bool opstate_ = true;
+        std::string error_;
     };
 }; // namespace Plugin
 
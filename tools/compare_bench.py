@@ -0,0 +1,61 @@
+import argparse
+import json
+import shutil
+import sys
+
+# 比较./pro bench输出的bench.result.json与基线，耗时增加超过阈值的case标记为回归，存在回归时返回1
+# 基线需要在同一台机器上生成：python tools/compare_bench.py --update workspace/bench.baseline.json workspace/bench.result.json
+
+def load_results(file):
+    with open(file, "r") as f:
+        root = json.load(f)
+    return {item["name"]: item for item in root["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare microbenchmark results against a baseline")
+    parser.add_argument("baseline", help="baseline json, e.g. workspace/bench.baseline.json")
+    parser.add_argument("current", help="current json, e.g. workspace/bench.result.json")
+    parser.add_argument("--metric", default="p50_ms", help="metric to compare, default p50_ms")
+    parser.add_argument("--threshold", type=float, default=0.1, help="relative slowdown flagged as regression, default 0.1")
+    parser.add_argument("--update", action="store_true", help="copy current to baseline and exit")
+    args = parser.parse_args()
+
+    if args.update:
+        shutil.copyfile(args.current, args.baseline)
+        print(f"Baseline updated: {args.baseline}")
+        return 0
+
+    baseline = load_results(args.baseline)
+    current  = load_results(args.current)
+
+    regressions = []
+    print(f"{'name':<36}{'baseline':>12}{'current':>12}{'change':>10}")
+    for name, item in current.items():
+        if name not in baseline:
+            print(f"{name:<36}{'-':>12}{item[args.metric]:>12.4f}{'new':>10}")
+            continue
+
+        old_value = baseline[name][args.metric]
+        new_value = item[args.metric]
+        change    = (new_value - old_value) / old_value if old_value > 0 else 0
+        flag      = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print(f"{name:<36}{old_value:>12.4f}{new_value:>12.4f}{change * 100:>9.1f}%{flag}")
+
+    for name in baseline:
+        if name not in current:
+            print(f"{name:<36}{baseline[name][args.metric]:>12.4f}{'-':>12}{'missing':>10}")
+
+    if regressions:
+        print(f"{len(regressions)} regression(s) over {args.threshold * 100:.0f}% on {args.metric}: {', '.join(regressions)}")
+        return 1
+
+    print(f"No regression over {args.threshold * 100:.0f}% on {args.metric}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
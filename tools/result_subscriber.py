@@ -0,0 +1,51 @@
+
+# 配合src/application/tools/zmq_result_stream.hpp接收检测、跟踪、姿态结果
+# pip install zmq
+import zmq
+import struct
+import numpy as np
+
+MAGIC   = 0x52545254
+VERSION = 1
+
+frame_header   = struct.Struct("<IHHQQII")
+section_header = struct.Struct("<HHI")
+
+object_box_dtype = np.dtype([("left", "<f4"), ("top", "<f4"), ("right", "<f4"), ("bottom", "<f4"), ("confidence", "<f4"), ("class_label", "<i4")])
+face_box_dtype   = np.dtype([("left", "<f4"), ("top", "<f4"), ("right", "<f4"), ("bottom", "<f4"), ("confidence", "<f4"), ("landmark", "<f4", (5, 2))])
+track_dtype      = np.dtype([("id", "<i4"), ("state", "<i4"), ("time_since_update", "<i4"), ("left", "<f4"), ("top", "<f4"), ("right", "<f4"), ("bottom", "<f4")])
+
+def parse(message):
+    magic, version, num_sections, frame_id, timestamp_us, payload_bytes, _ = frame_header.unpack_from(message, 0)
+    if magic != MAGIC or version != VERSION or payload_bytes != len(message) - frame_header.size:
+        raise ValueError("Invalid result message")
+
+    result = {"frame_id": frame_id, "timestamp_us": timestamp_us}
+    offset = frame_header.size
+    for _ in range(num_sections):
+        section_type, record_bytes, count = section_header.unpack_from(message, offset)
+        offset += section_header.size
+        records = np.frombuffer(message, dtype=np.uint8, count=record_bytes * count, offset=offset).reshape(count, record_bytes)
+        offset += record_bytes * count
+
+        if section_type == 1:
+            result["objects"] = records[:, :object_box_dtype.itemsize].copy().view(object_box_dtype).reshape(-1)
+        elif section_type == 2:
+            result["faces"] = records[:, :face_box_dtype.itemsize].copy().view(face_box_dtype).reshape(-1)
+        elif section_type == 3:
+            result["tracks"] = records[:, :track_dtype.itemsize].copy().view(track_dtype).reshape(-1)
+        elif section_type == 4:
+            num_keypoints = (record_bytes - 4) // 12
+            result["pose_owners"] = records[:, :4].copy().view("<i4").reshape(-1)
+            result["poses"] = records[:, 4:].copy().view("<f4").reshape(count, num_keypoints, 3)
+    return result
+
+if __name__ == "__main__":
+    context = zmq.Context()
+    socket = context.socket(zmq.SUB)
+    socket.setsockopt(zmq.SUBSCRIBE, b"")
+    socket.connect("tcp://127.0.0.1:15557")
+
+    while True:
+        result = parse(socket.recv())
+        print(f"frame {result['frame_id']}: objects {len(result.get('objects', []))}, faces {len(result.get('faces', []))}, tracks {len(result.get('tracks', []))}, poses {len(result.get('poses', []))}")
@@ -1,21 +1,20 @@
 
-# 配合/data/sxai/tensorRT/src/application/app_fall_recognize.cpp中的zmq remote实现远程显示服务器画面的效果
+# 配合src/application/tools/zmq_remote_show.hpp实现远程显示服务器画面的效果
 # pip install zmq
 import zmq
 import sys
 import numpy as np
 import cv2
 
+# 服务端为PUB，只接收最新的帧，处理不过来时服务端丢帧，不会累积延迟
 context = zmq.Context()
-socket = context.socket(zmq.REQ)
+socket = context.socket(zmq.SUB)
+socket.setsockopt(zmq.RCVHWM, 2)
+socket.setsockopt(zmq.SUBSCRIBE, b"")
 socket.connect("tcp://192.168.16.109:15556")
 
 while True:
-    socket.send(b"a")
     message = socket.recv()
-    if len(message) == 1 and message == b'x':
-    	break
-
     image = np.frombuffer(message, dtype=np.uint8)
     image = cv2.imdecode(image, 1)
     